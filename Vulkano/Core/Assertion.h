@@ -14,12 +14,12 @@
 #define checkf(condition, text, ...) \
     do { \
     if (!(condition)) { \
-    VK_LOG(LOG_ERROR, text, __VA_ARGS__); \
+    VK_LOG(LOG_ERROR, text, ##__VA_ARGS__); \
     std::terminate(); \
     } \
     } while (false)
 
 #define fatal(text, ...) \
-    VK_LOG(LOG_ERROR, text, __VA_ARGS__); \
+    VK_LOG(LOG_ERROR, text, ##__VA_ARGS__); \
     std::terminate()
     
\ No newline at end of file
@@ -0,0 +1,184 @@
+﻿#include "FileWatcher.h"
+#include <algorithm>
+#include "VulkanoLog.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+FFileWatcher::~FFileWatcher()
+{
+    Reset();
+}
+
+#ifdef _WIN32
+
+bool FFileWatcher::Watch(const std::string& Directory)
+{
+    HANDLE ChangeHandle = FindFirstChangeNotificationA(Directory.c_str(), TRUE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+    if (ChangeHandle == INVALID_HANDLE_VALUE)
+    {
+        VK_LOG(LOG_WARNING, "Can't watch %s", Directory.c_str());
+        return false;
+    }
+
+    FWatchedDirectory& Watched = Directories.emplace_back();
+    Watched.Path = Directory;
+    Watched.ChangeHandle = ChangeHandle;
+    // Baseline timestamps, nothing is reported for files that existed before
+    ScanDirectory(Watched, nullptr);
+    return true;
+}
+
+void FFileWatcher::Poll(std::vector<std::string>& OutChangedFiles)
+{
+    for (FWatchedDirectory& Directory : Directories)
+    {
+        // The notification only says something changed, the scan finds what
+        if (WaitForSingleObject(Directory.ChangeHandle, 0) == WAIT_OBJECT_0)
+        {
+            ScanDirectory(Directory, &OutChangedFiles);
+            FindNextChangeNotification(Directory.ChangeHandle);
+        }
+    }
+}
+
+void FFileWatcher::Reset()
+{
+    for (FWatchedDirectory& Directory : Directories)
+    {
+        FindCloseChangeNotification(Directory.ChangeHandle);
+    }
+    Directories.clear();
+}
+
+void FFileWatcher::ScanDirectory(FWatchedDirectory& Directory, std::vector<std::string>* OutChangedFiles)
+{
+    std::error_code Error;
+    for (const std::filesystem::directory_entry& Entry : std::filesystem::recursive_directory_iterator(Directory.Path, Error))
+    {
+        if (!Entry.is_regular_file(Error))
+        {
+            continue;
+        }
+        const std::string Path = Entry.path().string();
+        const std::filesystem::file_time_type WriteTime = Entry.last_write_time(Error);
+        auto Found = Directory.WriteTimes.find(Path);
+        if (Found == Directory.WriteTimes.end() || Found->second != WriteTime)
+        {
+            Directory.WriteTimes[Path] = WriteTime;
+            if (OutChangedFiles)
+            {
+                OutChangedFiles->push_back(Path);
+            }
+        }
+    }
+}
+
+#else
+
+bool FFileWatcher::Watch(const std::string& Directory)
+{
+    if (InotifyDescriptor < 0)
+    {
+        InotifyDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (InotifyDescriptor < 0)
+        {
+            VK_LOG(LOG_WARNING, "inotify is not available, %s is not watched", Directory.c_str());
+            return false;
+        }
+    }
+
+    // inotify is not recursive, every subdirectory gets its own watch
+    if (!AddWatch(Directory))
+    {
+        return false;
+    }
+    std::error_code Error;
+    for (const std::filesystem::directory_entry& Entry : std::filesystem::recursive_directory_iterator(Directory, Error))
+    {
+        if (Entry.is_directory(Error))
+        {
+            AddWatch(Entry.path().string());
+        }
+    }
+    return true;
+}
+
+bool FFileWatcher::AddWatch(const std::string& Directory)
+{
+    const int WatchDescriptor = inotify_add_watch(InotifyDescriptor, Directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    if (WatchDescriptor < 0)
+    {
+        VK_LOG(LOG_WARNING, "Can't watch %s", Directory.c_str());
+        return false;
+    }
+
+    FWatchedDirectory& Watched = Directories.emplace_back();
+    Watched.Path = Directory;
+    Watched.WatchDescriptor = WatchDescriptor;
+    return true;
+}
+
+void FFileWatcher::Poll(std::vector<std::string>& OutChangedFiles)
+{
+    if (InotifyDescriptor < 0)
+    {
+        return;
+    }
+
+    alignas(inotify_event) char Buffer[4096];
+    const size_t FirstChange = OutChangedFiles.size();
+    ssize_t Length = 0;
+    while ((Length = read(InotifyDescriptor, Buffer, sizeof(Buffer))) > 0)
+    {
+        for (ssize_t Offset = 0; Offset < Length;)
+        {
+            const inotify_event* Event = reinterpret_cast<const inotify_event*>(Buffer + Offset);
+            Offset += sizeof(inotify_event) + Event->len;
+
+            auto Found = std::find_if(Directories.begin(), Directories.end(), [Event](const FWatchedDirectory& Directory)
+            {
+                return Directory.WatchDescriptor == Event->wd;
+            });
+            if (Found == Directories.end() || Event->len == 0)
+            {
+                continue;
+            }
+
+            const std::string Path = Found->Path + "/" + Event->name;
+            if (Event->mask & IN_ISDIR)
+            {
+                // New subdirectories are picked up, their files show up once written
+                if (Event->mask & (IN_CREATE | IN_MOVED_TO))
+                {
+                    AddWatch(Path);
+                }
+            }
+            else if (Event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+            {
+                // Created files are reported once their writer closes them
+                OutChangedFiles.push_back(Path);
+            }
+        }
+    }
+
+    // Editors often write a file more than once per save
+    std::sort(OutChangedFiles.begin() + FirstChange, OutChangedFiles.end());
+    OutChangedFiles.erase(std::unique(OutChangedFiles.begin() + FirstChange, OutChangedFiles.end()), OutChangedFiles.end());
+}
+
+void FFileWatcher::Reset()
+{
+    if (InotifyDescriptor >= 0)
+    {
+        close(InotifyDescriptor);
+        InotifyDescriptor = -1;
+    }
+    Directories.clear();
+}
+
+#endif
@@ -0,0 +1,43 @@
+﻿#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+// Non blocking directory watcher, meant to be polled once per frame for hot reloading.
+// inotify on Linux, change notifications plus a timestamp scan on Windows
+class FFileWatcher
+{
+public:
+    FFileWatcher() = default;
+    FFileWatcher(const FFileWatcher&) = delete;
+    FFileWatcher& operator=(const FFileWatcher&) = delete;
+    ~FFileWatcher();
+
+    // Subdirectories are watched too
+    bool Watch(const std::string& Directory);
+    // Files written, created or renamed into the watched directories since the last poll, each reported once
+    void Poll(std::vector<std::string>& OutChangedFiles);
+    void Reset();
+
+private:
+    struct FWatchedDirectory
+    {
+        std::string Path;
+#ifdef _WIN32
+        void* ChangeHandle = nullptr;
+        std::map<std::string, std::filesystem::file_time_type> WriteTimes;
+#else
+        int WatchDescriptor = -1;
+#endif
+    };
+
+#ifdef _WIN32
+    static void ScanDirectory(FWatchedDirectory& Directory, std::vector<std::string>* OutChangedFiles);
+#else
+    bool AddWatch(const std::string& Directory);
+    int InotifyDescriptor = -1;
+#endif
+    std::vector<FWatchedDirectory> Directories;
+};
@@ -0,0 +1,127 @@
+﻿#include "JobSystem.h"
+
+#include <algorithm>
+
+FJobSystem* FJobSystem::Get()
+{
+    static FJobSystem* Instance;
+    if(!Instance)
+    {
+        Instance = new FJobSystem();
+    }
+    return Instance;
+}
+
+FJobSystem::FJobSystem()
+{
+    // Leave one core to the calling thread
+    const uint32_t HardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    const uint32_t WorkerNum = HardwareThreads - 1;
+    Workers.reserve(WorkerNum);
+    for (uint32_t Index = 0; Index < WorkerNum; ++Index)
+    {
+        Workers.emplace_back(&FJobSystem::WorkerLoop, this);
+    }
+}
+
+FJobSystem::~FJobSystem()
+{
+    Shutdown();
+}
+
+void FJobSystem::Shutdown()
+{
+    {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        bExit = true;
+    }
+    WakeCondition.notify_all();
+    for (std::thread& Worker : Workers)
+    {
+        if (Worker.joinable())
+        {
+            Worker.join();
+        }
+    }
+    Workers.clear();
+}
+
+uint32_t FJobSystem::GetWorkerNum() const
+{
+    return static_cast<uint32_t>(Workers.size());
+}
+
+void FJobSystem::ParallelFor(uint32_t InNum, uint32_t InBatchSize, const FRangeFunction& InFunction)
+{
+    if (InNum == 0)
+    {
+        return;
+    }
+    InBatchSize = std::max(InBatchSize, 1u);
+    
+    std::unique_lock<std::mutex> LoopLock(LoopMutex, std::try_to_lock);
+    if (!LoopLock.owns_lock() || Workers.empty() || InNum <= InBatchSize)
+    {
+        InFunction(0, InNum);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        Function = &InFunction;
+        Num = InNum;
+        BatchSize = InBatchSize;
+        BatchNum = (InNum + InBatchSize - 1) / InBatchSize;
+        NextBatch.store(0, std::memory_order_relaxed);
+        ++Generation;
+    }
+    WakeCondition.notify_all();
+
+    RunBatches();
+
+    // Every batch is claimed once RunBatches returns, wait for the workers still running theirs
+    std::unique_lock<std::mutex> Lock(Mutex);
+    DoneCondition.wait(Lock, [this]() { return BusyWorkers == 0; });
+    Function = nullptr;
+}
+
+void FJobSystem::RunBatches()
+{
+    for (;;)
+    {
+        const uint32_t Batch = NextBatch.fetch_add(1, std::memory_order_relaxed);
+        if (Batch >= BatchNum)
+        {
+            break;
+        }
+        const uint32_t Begin = Batch * BatchSize;
+        const uint32_t End = std::min(Begin + BatchSize, Num);
+        (*Function)(Begin, End);
+    }
+}
+
+void FJobSystem::WorkerLoop()
+{
+    uint64_t SeenGeneration = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> Lock(Mutex);
+            WakeCondition.wait(Lock, [this, SeenGeneration]() { return bExit || Generation != SeenGeneration; });
+            if (bExit)
+            {
+                return;
+            }
+            SeenGeneration = Generation;
+            ++BusyWorkers;
+        }
+
+        RunBatches();
+
+        {
+            std::lock_guard<std::mutex> Lock(Mutex);
+            --BusyWorkers;
+        }
+        DoneCondition.notify_one();
+    }
+}
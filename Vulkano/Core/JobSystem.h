@@ -0,0 +1,45 @@
+﻿#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads for data parallel loops, the calling thread works on the loop as well
+class FJobSystem
+{
+public:
+    using FRangeFunction = std::function<void(uint32_t Begin, uint32_t End)>;
+
+    static FJobSystem* Get();
+    // Splits [0, Num) into ranges of at most BatchSize and returns once all of them ran.
+    // Runs inline when the pool is busy with another loop, so nested and concurrent calls are safe.
+    void ParallelFor(uint32_t Num, uint32_t BatchSize, const FRangeFunction& Function);
+    uint32_t GetWorkerNum() const;
+    void Shutdown();
+
+private:
+    FJobSystem();
+    ~FJobSystem();
+    void WorkerLoop();
+    void RunBatches();
+
+private:
+    std::vector<std::thread> Workers;
+    std::mutex LoopMutex;
+    std::mutex Mutex;
+    std::condition_variable WakeCondition;
+    std::condition_variable DoneCondition;
+    bool bExit = false;
+    uint64_t Generation = 0;
+    uint32_t BusyWorkers = 0;
+
+    // Current loop, written under Mutex before Generation is bumped
+    const FRangeFunction* Function = nullptr;
+    uint32_t Num = 0;
+    uint32_t BatchSize = 0;
+    uint32_t BatchNum = 0;
+    std::atomic<uint32_t> NextBatch{0};
+};
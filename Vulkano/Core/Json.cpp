@@ -0,0 +1,458 @@
+﻿#include "Json.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+    const FJsonValue NullValue;
+    const std::string EmptyString;
+
+    class FJsonParser
+    {
+    public:
+        explicit FJsonParser(const std::string& InText) : Text(InText) {}
+
+        bool ParseDocument(FJsonValue& OutValue)
+        {
+            if (!ParseValue(OutValue, 0))
+            {
+                return false;
+            }
+            SkipWhitespace();
+            return Position == Text.size();
+        }
+
+    private:
+        static constexpr uint32_t MaxDepth = 64;
+
+        void SkipWhitespace()
+        {
+            while (Position < Text.size() && (Text[Position] == ' ' || Text[Position] == '\t' || Text[Position] == '\n' || Text[Position] == '\r'))
+            {
+                ++Position;
+            }
+        }
+
+        bool Consume(const char* Literal)
+        {
+            size_t Length = 0;
+            while (Literal[Length] != 0)
+            {
+                ++Length;
+            }
+            if (Text.compare(Position, Length, Literal) != 0)
+            {
+                return false;
+            }
+            Position += Length;
+            return true;
+        }
+
+        bool ParseValue(FJsonValue& OutValue, uint32_t Depth)
+        {
+            SkipWhitespace();
+            if (Position >= Text.size() || Depth > MaxDepth)
+            {
+                return false;
+            }
+
+            const char Character = Text[Position];
+            if (Character == '{')
+            {
+                return ParseObject(OutValue, Depth);
+            }
+            if (Character == '[')
+            {
+                return ParseArray(OutValue, Depth);
+            }
+            if (Character == '"')
+            {
+                std::string String;
+                if (!ParseString(String))
+                {
+                    return false;
+                }
+                OutValue = FJsonValue(String);
+                return true;
+            }
+            if (Consume("true"))
+            {
+                OutValue = FJsonValue(true);
+                return true;
+            }
+            if (Consume("false"))
+            {
+                OutValue = FJsonValue(false);
+                return true;
+            }
+            if (Consume("null"))
+            {
+                OutValue = FJsonValue();
+                return true;
+            }
+            return ParseNumber(OutValue);
+        }
+
+        bool ParseNumber(FJsonValue& OutValue)
+        {
+            const char* Begin = Text.c_str() + Position;
+            char* End = nullptr;
+            const double Value = strtod(Begin, &End);
+            if (End == Begin)
+            {
+                return false;
+            }
+            Position += End - Begin;
+            OutValue = FJsonValue(Value);
+            return true;
+        }
+
+        bool ParseString(std::string& OutString)
+        {
+            // Opening quote
+            ++Position;
+            while (Position < Text.size())
+            {
+                const char Character = Text[Position++];
+                if (Character == '"')
+                {
+                    return true;
+                }
+                if (Character != '\\')
+                {
+                    OutString.push_back(Character);
+                    continue;
+                }
+                if (Position >= Text.size())
+                {
+                    return false;
+                }
+
+                const char Escape = Text[Position++];
+                switch (Escape)
+                {
+                case '"': OutString.push_back('"'); break;
+                case '\\': OutString.push_back('\\'); break;
+                case '/': OutString.push_back('/'); break;
+                case 'b': OutString.push_back('\b'); break;
+                case 'f': OutString.push_back('\f'); break;
+                case 'n': OutString.push_back('\n'); break;
+                case 'r': OutString.push_back('\r'); break;
+                case 't': OutString.push_back('\t'); break;
+                case 'u':
+                {
+                    if (Position + 4 > Text.size())
+                    {
+                        return false;
+                    }
+                    // Basic multilingual plane only, written back as UTF-8
+                    const uint32_t Code = static_cast<uint32_t>(strtoul(Text.substr(Position, 4).c_str(), nullptr, 16));
+                    Position += 4;
+                    if (Code < 0x80)
+                    {
+                        OutString.push_back(static_cast<char>(Code));
+                    }
+                    else if (Code < 0x800)
+                    {
+                        OutString.push_back(static_cast<char>(0xC0 | (Code >> 6)));
+                        OutString.push_back(static_cast<char>(0x80 | (Code & 0x3F)));
+                    }
+                    else
+                    {
+                        OutString.push_back(static_cast<char>(0xE0 | (Code >> 12)));
+                        OutString.push_back(static_cast<char>(0x80 | ((Code >> 6) & 0x3F)));
+                        OutString.push_back(static_cast<char>(0x80 | (Code & 0x3F)));
+                    }
+                    break;
+                }
+                default:
+                    return false;
+                }
+            }
+            return false;
+        }
+
+        bool ParseArray(FJsonValue& OutValue, uint32_t Depth)
+        {
+            OutValue = FJsonValue::MakeArray();
+            ++Position;
+            SkipWhitespace();
+            if (Position < Text.size() && Text[Position] == ']')
+            {
+                ++Position;
+                return true;
+            }
+            for (;;)
+            {
+                FJsonValue Element;
+                if (!ParseValue(Element, Depth + 1))
+                {
+                    return false;
+                }
+                OutValue.Append(Element);
+                SkipWhitespace();
+                if (Position >= Text.size())
+                {
+                    return false;
+                }
+                const char Character = Text[Position++];
+                if (Character == ']')
+                {
+                    return true;
+                }
+                if (Character != ',')
+                {
+                    return false;
+                }
+            }
+        }
+
+        bool ParseObject(FJsonValue& OutValue, uint32_t Depth)
+        {
+            OutValue = FJsonValue::MakeObject();
+            ++Position;
+            SkipWhitespace();
+            if (Position < Text.size() && Text[Position] == '}')
+            {
+                ++Position;
+                return true;
+            }
+            for (;;)
+            {
+                SkipWhitespace();
+                std::string Key;
+                if (Position >= Text.size() || Text[Position] != '"' || !ParseString(Key))
+                {
+                    return false;
+                }
+                SkipWhitespace();
+                if (Position >= Text.size() || Text[Position++] != ':')
+                {
+                    return false;
+                }
+                FJsonValue Field;
+                if (!ParseValue(Field, Depth + 1))
+                {
+                    return false;
+                }
+                OutValue.SetField(Key, Field);
+                SkipWhitespace();
+                if (Position >= Text.size())
+                {
+                    return false;
+                }
+                const char Character = Text[Position++];
+                if (Character == '}')
+                {
+                    return true;
+                }
+                if (Character != ',')
+                {
+                    return false;
+                }
+            }
+        }
+
+    private:
+        const std::string& Text;
+        size_t Position = 0;
+    };
+
+    void SerializeString(const std::string& String, std::string& Out)
+    {
+        Out.push_back('"');
+        for (const char Character : String)
+        {
+            switch (Character)
+            {
+            case '"': Out += "\\\""; break;
+            case '\\': Out += "\\\\"; break;
+            case '\n': Out += "\\n"; break;
+            case '\r': Out += "\\r"; break;
+            case '\t': Out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(Character) < 0x20)
+                {
+                    char Escaped[8];
+                    snprintf(Escaped, sizeof(Escaped), "\\u%04x", Character);
+                    Out += Escaped;
+                }
+                else
+                {
+                    Out.push_back(Character);
+                }
+            }
+        }
+        Out.push_back('"');
+    }
+}
+
+FJsonValue::FJsonValue(bool bValue) : Type(EJsonType::Bool), bBool(bValue) {}
+FJsonValue::FJsonValue(double Value) : Type(EJsonType::Number), Number(Value) {}
+FJsonValue::FJsonValue(int Value) : Type(EJsonType::Number), Number(Value) {}
+FJsonValue::FJsonValue(uint32_t Value) : Type(EJsonType::Number), Number(Value) {}
+FJsonValue::FJsonValue(uint64_t Value) : Type(EJsonType::Number), Number(static_cast<double>(Value)) {}
+FJsonValue::FJsonValue(const char* Value) : Type(EJsonType::String), String(Value) {}
+FJsonValue::FJsonValue(const std::string& Value) : Type(EJsonType::String), String(Value) {}
+
+FJsonValue FJsonValue::MakeArray()
+{
+    FJsonValue Value;
+    Value.Type = EJsonType::Array;
+    return Value;
+}
+
+FJsonValue FJsonValue::MakeObject()
+{
+    FJsonValue Value;
+    Value.Type = EJsonType::Object;
+    return Value;
+}
+
+bool FJsonValue::Parse(const std::string& Text, FJsonValue& OutValue)
+{
+    FJsonParser Parser(Text);
+    if (!Parser.ParseDocument(OutValue))
+    {
+        OutValue = FJsonValue();
+        return false;
+    }
+    return true;
+}
+
+EJsonType FJsonValue::GetType() const
+{
+    return Type;
+}
+
+bool FJsonValue::IsNull() const
+{
+    return Type == EJsonType::Null;
+}
+
+bool FJsonValue::GetBool(bool bDefault) const
+{
+    return Type == EJsonType::Bool ? bBool : bDefault;
+}
+
+double FJsonValue::GetNumber(double Default) const
+{
+    return Type == EJsonType::Number ? Number : Default;
+}
+
+const std::string& FJsonValue::GetString() const
+{
+    return Type == EJsonType::String ? String : EmptyString;
+}
+
+size_t FJsonValue::GetSize() const
+{
+    return Type == EJsonType::Array ? Array.size() : 0;
+}
+
+const FJsonValue& FJsonValue::operator[](size_t Index) const
+{
+    return Type == EJsonType::Array && Index < Array.size() ? Array[Index] : NullValue;
+}
+
+FJsonValue& FJsonValue::Append(const FJsonValue& Value)
+{
+    Type = EJsonType::Array;
+    Array.push_back(Value);
+    return Array.back();
+}
+
+bool FJsonValue::HasField(const std::string& Key) const
+{
+    return Type == EJsonType::Object && Object.count(Key) != 0;
+}
+
+const FJsonValue& FJsonValue::GetField(const std::string& Key) const
+{
+    if (Type != EJsonType::Object)
+    {
+        return NullValue;
+    }
+    auto It = Object.find(Key);
+    return It != Object.end() ? It->second : NullValue;
+}
+
+FJsonValue& FJsonValue::SetField(const std::string& Key, const FJsonValue& Value)
+{
+    Type = EJsonType::Object;
+    FJsonValue& Field = Object[Key];
+    Field = Value;
+    return Field;
+}
+
+const std::map<std::string, FJsonValue>& FJsonValue::GetFields() const
+{
+    return Object;
+}
+
+std::string FJsonValue::Serialize() const
+{
+    std::string Out;
+    SerializeTo(Out);
+    return Out;
+}
+
+void FJsonValue::SerializeTo(std::string& Out) const
+{
+    switch (Type)
+    {
+    case EJsonType::Null:
+        Out += "null";
+        break;
+    case EJsonType::Bool:
+        Out += bBool ? "true" : "false";
+        break;
+    case EJsonType::Number:
+    {
+        // Not representable in JSON, written as null so the document stays valid
+        if (!std::isfinite(Number))
+        {
+            Out += "null";
+            break;
+        }
+        char Buffer[32];
+        snprintf(Buffer, sizeof(Buffer), "%.15g", Number);
+        Out += Buffer;
+        break;
+    }
+    case EJsonType::String:
+        SerializeString(String, Out);
+        break;
+    case EJsonType::Array:
+        Out.push_back('[');
+        for (size_t Index = 0; Index < Array.size(); ++Index)
+        {
+            if (Index > 0)
+            {
+                Out.push_back(',');
+            }
+            Array[Index].SerializeTo(Out);
+        }
+        Out.push_back(']');
+        break;
+    case EJsonType::Object:
+    {
+        Out.push_back('{');
+        bool bFirst = true;
+        for (const auto& Field : Object)
+        {
+            if (!bFirst)
+            {
+                Out.push_back(',');
+            }
+            bFirst = false;
+            SerializeString(Field.first, Out);
+            Out.push_back(':');
+            Field.second.SerializeTo(Out);
+        }
+        Out.push_back('}');
+        break;
+    }
+    }
+}
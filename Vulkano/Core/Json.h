@@ -0,0 +1,66 @@
+﻿#pragma once
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum class EJsonType : uint8_t
+{
+    Null,
+    Bool,
+    Number,
+    String,
+    Array,
+    Object
+};
+
+// Small JSON document for tool output (perf history, benchmark results), not meant for large files
+class FJsonValue
+{
+public:
+    FJsonValue() = default;
+    FJsonValue(bool bValue);
+    FJsonValue(double Value);
+    FJsonValue(int Value);
+    FJsonValue(uint32_t Value);
+    FJsonValue(uint64_t Value);
+    FJsonValue(const char* Value);
+    FJsonValue(const std::string& Value);
+
+    static FJsonValue MakeArray();
+    static FJsonValue MakeObject();
+    // False on malformed input, OutValue is left null
+    static bool Parse(const std::string& Text, FJsonValue& OutValue);
+
+    EJsonType GetType() const;
+    bool IsNull() const;
+    bool GetBool(bool bDefault = false) const;
+    double GetNumber(double Default = 0.0) const;
+    const std::string& GetString() const;
+
+    // Array access
+    size_t GetSize() const;
+    const FJsonValue& operator[](size_t Index) const;
+    FJsonValue& Append(const FJsonValue& Value);
+
+    // Object access, missing keys read as null
+    bool HasField(const std::string& Key) const;
+    const FJsonValue& GetField(const std::string& Key) const;
+    FJsonValue& SetField(const std::string& Key, const FJsonValue& Value);
+    const std::map<std::string, FJsonValue>& GetFields() const;
+
+    // Compact single line output, so documents can be appended as JSON lines
+    std::string Serialize() const;
+
+private:
+    void SerializeTo(std::string& Out) const;
+
+private:
+    EJsonType Type = EJsonType::Null;
+    bool bBool = false;
+    double Number = 0.0;
+    std::string String;
+    std::vector<FJsonValue> Array;
+    std::map<std::string, FJsonValue> Object;
+};
@@ -1,4 +1,5 @@
 ﻿#include "Paths.h"
+#include <algorithm>
 #include <codecvt>
 #include <fstream>
 #include <locale>
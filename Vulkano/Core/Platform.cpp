@@ -0,0 +1,112 @@
+﻿#include "Platform.h"
+#include <cstdio>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <time.h>
+#endif
+
+#ifdef _WIN32
+
+uint64_t FPlatform::GetMicroseconds()
+{
+    static const int64_t Frequency = []()
+    {
+        LARGE_INTEGER Value;
+        QueryPerformanceFrequency(&Value);
+        return Value.QuadPart;
+    }();
+
+    LARGE_INTEGER Value;
+    QueryPerformanceCounter(&Value);
+    return static_cast<uint64_t>(Value.QuadPart / Frequency * 1000000 + Value.QuadPart % Frequency * 1000000 / Frequency);
+}
+
+void FPlatform::SleepMicroseconds(uint64_t Microseconds)
+{
+    // Millisecond granularity, callers that need better spin the rest
+    Sleep(static_cast<DWORD>(Microseconds / 1000));
+}
+
+void FPlatform::CpuPause()
+{
+    YieldProcessor();
+}
+
+uint64_t FPlatform::GetThreadCpuNanoseconds()
+{
+    FILETIME CreationTime, ExitTime, KernelTime, UserTime;
+    GetThreadTimes(GetCurrentThread(), &CreationTime, &ExitTime, &KernelTime, &UserTime);
+    const uint64_t Kernel = (static_cast<uint64_t>(KernelTime.dwHighDateTime) << 32) | KernelTime.dwLowDateTime;
+    const uint64_t User = (static_cast<uint64_t>(UserTime.dwHighDateTime) << 32) | UserTime.dwLowDateTime;
+    // 100 ns units
+    return (Kernel + User) * 100;
+}
+
+void FPlatform::GetLocalTime(std::time_t Time, std::tm& OutTime)
+{
+    localtime_s(&OutTime, &Time);
+}
+
+void FPlatform::GetUtcTime(std::time_t Time, std::tm& OutTime)
+{
+    gmtime_s(&OutTime, &Time);
+}
+
+bool FPlatform::AskYesNo(const std::string& Title, const std::string& Message)
+{
+    return MessageBoxA(NULL, Message.c_str(), Title.c_str(), MB_ICONQUESTION | MB_YESNO) == IDYES;
+}
+
+#else
+
+uint64_t FPlatform::GetMicroseconds()
+{
+    timespec Time;
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+    return static_cast<uint64_t>(Time.tv_sec) * 1000000 + static_cast<uint64_t>(Time.tv_nsec) / 1000;
+}
+
+void FPlatform::SleepMicroseconds(uint64_t Microseconds)
+{
+    timespec Duration;
+    Duration.tv_sec = static_cast<time_t>(Microseconds / 1000000);
+    Duration.tv_nsec = static_cast<long>(Microseconds % 1000000 * 1000);
+    nanosleep(&Duration, nullptr);
+}
+
+void FPlatform::CpuPause()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+uint64_t FPlatform::GetThreadCpuNanoseconds()
+{
+    timespec Time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &Time);
+    return static_cast<uint64_t>(Time.tv_sec) * 1000000000ull + static_cast<uint64_t>(Time.tv_nsec);
+}
+
+void FPlatform::GetLocalTime(std::time_t Time, std::tm& OutTime)
+{
+    localtime_r(&Time, &OutTime);
+}
+
+void FPlatform::GetUtcTime(std::time_t Time, std::tm& OutTime)
+{
+    gmtime_r(&Time, &OutTime);
+}
+
+bool FPlatform::AskYesNo(const std::string& Title, const std::string& Message)
+{
+    // Render farm nodes have nobody to answer, the question goes to the log
+    fprintf(stderr, "%s\n%s\n", Title.c_str(), Message.c_str());
+    return false;
+}
+
+#endif
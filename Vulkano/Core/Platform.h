@@ -0,0 +1,22 @@
+﻿#pragma once
+#include <cstdint>
+#include <ctime>
+#include <string>
+
+// OS services used by the engine outside of windowing, one implementation per platform in Platform.cpp
+class FPlatform
+{
+public:
+    // Monotonic clock
+    static uint64_t GetMicroseconds();
+    static void SleepMicroseconds(uint64_t Microseconds);
+    // Spin wait hint
+    static void CpuPause();
+    static uint64_t GetThreadCpuNanoseconds();
+
+    static void GetLocalTime(std::time_t Time, std::tm& OutTime);
+    static void GetUtcTime(std::time_t Time, std::tm& OutTime);
+
+    // Modal yes/no question, without a desktop the answer is always no
+    static bool AskYesNo(const std::string& Title, const std::string& Message);
+};
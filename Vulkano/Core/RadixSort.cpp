@@ -0,0 +1,129 @@
+﻿#include "RadixSort.h"
+
+#include <algorithm>
+#include "Assertion.h"
+#include "JobSystem.h"
+
+namespace
+{
+    constexpr uint32_t RadixBits = 8;
+    constexpr uint32_t BucketNum = 1 << RadixBits;
+    constexpr uint32_t PassNum = 64 / RadixBits;
+    // Below this a single thread is faster than splitting the histograms
+    constexpr uint32_t MinParallelSize = 1 << 16;
+    constexpr uint32_t ChunkSize = 1 << 15;
+}
+
+void RadixSort(std::vector<uint64_t>& Keys, std::vector<uint32_t>& Values)
+{
+    checkf(Keys.size() == Values.size(), "RadixSort key and value counts differ %zu %zu", Keys.size(), Values.size());
+    const uint32_t Num = static_cast<uint32_t>(Keys.size());
+    if (Num < 2)
+    {
+        return;
+    }
+
+    const uint32_t ChunkNum = Num < MinParallelSize ? 1 : (Num + ChunkSize - 1) / ChunkSize;
+    const uint32_t ChunkLength = (Num + ChunkNum - 1) / ChunkNum;
+
+    // Digit counts of every pass in one read, a pass where all keys share the digit is skipped
+    std::vector<uint32_t> PassHistograms(ChunkNum * PassNum * BucketNum, 0);
+    FJobSystem::Get()->ParallelFor(ChunkNum, 1, [&](uint32_t ChunkBegin, uint32_t ChunkEnd)
+    {
+        for (uint32_t Chunk = ChunkBegin; Chunk < ChunkEnd; ++Chunk)
+        {
+            uint32_t* Histogram = PassHistograms.data() + Chunk * PassNum * BucketNum;
+            const uint32_t End = std::min((Chunk + 1) * ChunkLength, Num);
+            for (uint32_t Index = Chunk * ChunkLength; Index < End; ++Index)
+            {
+                const uint64_t Key = Keys[Index];
+                for (uint32_t Pass = 0; Pass < PassNum; ++Pass)
+                {
+                    Histogram[Pass * BucketNum + ((Key >> (Pass * RadixBits)) & (BucketNum - 1))]++;
+                }
+            }
+        }
+    });
+    bool bSkipPass[PassNum] = {};
+    for (uint32_t Pass = 0; Pass < PassNum; ++Pass)
+    {
+        for (uint32_t Bucket = 0; Bucket < BucketNum && !bSkipPass[Pass]; ++Bucket)
+        {
+            uint32_t BucketTotal = 0;
+            for (uint32_t Chunk = 0; Chunk < ChunkNum; ++Chunk)
+            {
+                BucketTotal += PassHistograms[(Chunk * PassNum + Pass) * BucketNum + Bucket];
+            }
+            bSkipPass[Pass] = BucketTotal == Num;
+        }
+    }
+
+    std::vector<uint64_t> ScratchKeys(Num);
+    std::vector<uint32_t> ScratchValues(Num);
+    std::vector<uint32_t> Offsets(ChunkNum * BucketNum);
+    bool bFirstPass = true;
+    for (uint32_t Pass = 0; Pass < PassNum; ++Pass)
+    {
+        if (bSkipPass[Pass])
+        {
+            continue;
+        }
+        const uint32_t Shift = Pass * RadixBits;
+
+        // Chunks hold different keys after every scatter, so only the first pass reuses the counts above
+        if (bFirstPass)
+        {
+            for (uint32_t Chunk = 0; Chunk < ChunkNum; ++Chunk)
+            {
+                std::copy_n(PassHistograms.data() + (Chunk * PassNum + Pass) * BucketNum, BucketNum, Offsets.data() + Chunk * BucketNum);
+            }
+            bFirstPass = false;
+        }
+        else
+        {
+            std::fill(Offsets.begin(), Offsets.end(), 0);
+            FJobSystem::Get()->ParallelFor(ChunkNum, 1, [&](uint32_t ChunkBegin, uint32_t ChunkEnd)
+            {
+                for (uint32_t Chunk = ChunkBegin; Chunk < ChunkEnd; ++Chunk)
+                {
+                    uint32_t* Histogram = Offsets.data() + Chunk * BucketNum;
+                    const uint32_t End = std::min((Chunk + 1) * ChunkLength, Num);
+                    for (uint32_t Index = Chunk * ChunkLength; Index < End; ++Index)
+                    {
+                        Histogram[(Keys[Index] >> Shift) & (BucketNum - 1)]++;
+                    }
+                }
+            });
+        }
+
+        // Counts to write offsets, bucket major then chunk order keeps the sort stable
+        uint32_t Sum = 0;
+        for (uint32_t Bucket = 0; Bucket < BucketNum; ++Bucket)
+        {
+            for (uint32_t Chunk = 0; Chunk < ChunkNum; ++Chunk)
+            {
+                const uint32_t Count = Offsets[Chunk * BucketNum + Bucket];
+                Offsets[Chunk * BucketNum + Bucket] = Sum;
+                Sum += Count;
+            }
+        }
+
+        FJobSystem::Get()->ParallelFor(ChunkNum, 1, [&](uint32_t ChunkBegin, uint32_t ChunkEnd)
+        {
+            for (uint32_t Chunk = ChunkBegin; Chunk < ChunkEnd; ++Chunk)
+            {
+                uint32_t* ChunkOffsets = Offsets.data() + Chunk * BucketNum;
+                const uint32_t End = std::min((Chunk + 1) * ChunkLength, Num);
+                for (uint32_t Index = Chunk * ChunkLength; Index < End; ++Index)
+                {
+                    const uint64_t Key = Keys[Index];
+                    const uint32_t Target = ChunkOffsets[(Key >> Shift) & (BucketNum - 1)]++;
+                    ScratchKeys[Target] = Key;
+                    ScratchValues[Target] = Values[Index];
+                }
+            }
+        });
+        Keys.swap(ScratchKeys);
+        Values.swap(ScratchValues);
+    }
+}
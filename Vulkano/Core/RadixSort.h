@@ -0,0 +1,7 @@
+﻿#pragma once
+#include <cstdint>
+#include <vector>
+
+// Stable LSD radix sort of 64-bit keys carrying a 32-bit payload, 8 bits per pass.
+// Passes where every key shares the same digit are skipped, histograms and scatters run on FJobSystem.
+void RadixSort(std::vector<uint64_t>& Keys, std::vector<uint32_t>& Values);
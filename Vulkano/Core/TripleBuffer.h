@@ -0,0 +1,49 @@
+﻿#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single producer / single consumer mailbox. The writer fills its slot and publishes it,
+// the reader always picks the most recent published slot, neither side ever waits for the other.
+template <typename T>
+class TTripleBuffer
+{
+public:
+    // Writer side
+    T& GetWriteBuffer()
+    {
+        return Slots[WriteIndex];
+    }
+
+    void Publish()
+    {
+        WriteIndex = Shared.exchange(WriteIndex | DirtyBit, std::memory_order_acq_rel) & IndexMask;
+    }
+
+    // Reader side, false keeps the previous read buffer
+    bool Acquire()
+    {
+        if(!(Shared.load(std::memory_order_relaxed) & DirtyBit))
+        {
+            return false;
+        }
+        ReadIndex = Shared.exchange(ReadIndex, std::memory_order_acq_rel) & IndexMask;
+        return true;
+    }
+
+    const T& GetReadBuffer() const
+    {
+        return Slots[ReadIndex];
+    }
+
+private:
+    enum : uint8_t
+    {
+        IndexMask = 0x3,
+        DirtyBit = 0x4
+    };
+
+    T Slots[3];
+    uint8_t WriteIndex = 0;
+    uint8_t ReadIndex = 1;
+    std::atomic<uint8_t> Shared{2};
+};
@@ -1,10 +1,10 @@
 ﻿#pragma once
 #include <chrono>
 #include <cstdio>
-#include <windows.h>
 #include <cstdarg>
 #include <iomanip>
 #include <sstream>
+#include "Platform.h"
 
 // Enum for log types
 enum LogType {
@@ -24,7 +24,7 @@ inline std::string GetCurrentTimestamp()
     
     // Convert to a tm structure
     std::tm now_tm;
-    localtime_s(&now_tm, &now_time_t);
+    FPlatform::GetLocalTime(now_time_t, now_tm);
     
     // Get the milliseconds part
     auto now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()) % 1000;
@@ -0,0 +1,626 @@
+﻿#include "Bvh.h"
+
+#include <algorithm>
+#include <immintrin.h>
+#include "Core/Assertion.h"
+#include "Core/JobSystem.h"
+
+namespace
+{
+    constexpr uint32_t BinNum = 16;
+    // Ranges below this are built as one job
+    constexpr uint32_t MinSubtreeSize = 4096;
+    constexpr uint32_t MaxStackSize = 256;
+
+    struct FBinaryNode
+    {
+        FBoundingBox Bounds;
+        // Children for inner nodes, Count > 0 marks a leaf over [First, First + Count)
+        uint32_t Left = 0;
+        uint32_t Right = 0;
+        uint32_t First = 0;
+        uint32_t Count = 0;
+    };
+
+    struct FSubtreeTask
+    {
+        uint32_t Node;
+        uint32_t Begin;
+        uint32_t End;
+    };
+
+    struct FBuildContext
+    {
+        const std::vector<FBoundingBox>& Bounds;
+        std::vector<glm::vec3> Centroids;
+        std::vector<uint32_t>& Indices;
+        uint32_t SubtreeSize;
+    };
+
+    FBoundingBox EmptyBounds()
+    {
+        return {glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX)};
+    }
+
+    void Grow(FBoundingBox& Bounds, const FBoundingBox& Other)
+    {
+        Bounds.Min = glm::min(Bounds.Min, Other.Min);
+        Bounds.Max = glm::max(Bounds.Max, Other.Max);
+    }
+
+    float HalfArea(const FBoundingBox& Bounds)
+    {
+        const glm::vec3 Size = glm::max(Bounds.Max - Bounds.Min, glm::vec3(0.0f));
+        return Size.x * Size.y + Size.y * Size.z + Size.z * Size.x;
+    }
+
+    void SetChildBounds(FBvhNode& Node, uint32_t Slot, const FBoundingBox& Bounds)
+    {
+        Node.MinX[Slot] = Bounds.Min.x;
+        Node.MinY[Slot] = Bounds.Min.y;
+        Node.MinZ[Slot] = Bounds.Min.z;
+        Node.MaxX[Slot] = Bounds.Max.x;
+        Node.MaxY[Slot] = Bounds.Max.y;
+        Node.MaxZ[Slot] = Bounds.Max.z;
+    }
+
+    FBoundingBox GetNodeBounds(const FBvhNode& Node)
+    {
+        FBoundingBox Bounds = EmptyBounds();
+        for (uint32_t Slot = 0; Slot < 4; ++Slot)
+        {
+            Grow(Bounds, {{Node.MinX[Slot], Node.MinY[Slot], Node.MinZ[Slot]}, {Node.MaxX[Slot], Node.MaxY[Slot], Node.MaxZ[Slot]}});
+        }
+        return Bounds;
+    }
+
+    bool IntersectRayBox(const FBoundingBox& Box, const glm::vec3& Origin, const glm::vec3& InvDirection, float MaxDistance, float& OutDistance)
+    {
+        const glm::vec3 T0 = (Box.Min - Origin) * InvDirection;
+        const glm::vec3 T1 = (Box.Max - Origin) * InvDirection;
+        const glm::vec3 Near = glm::min(T0, T1);
+        const glm::vec3 Far = glm::max(T0, T1);
+        const float Enter = std::max(std::max(Near.x, Near.y), std::max(Near.z, 0.0f));
+        const float Exit = std::min(std::min(Far.x, Far.y), std::min(Far.z, MaxDistance));
+        OutDistance = Enter;
+        return Enter <= Exit;
+    }
+
+    // Binned SAH over the centroid bounds on all three axes, false when no plane separates the centroids
+    bool FindSplit(const FBuildContext& Context, uint32_t Begin, uint32_t End, int& OutAxis, float& OutSplit)
+    {
+        FBoundingBox CentroidBounds = EmptyBounds();
+        for (uint32_t Index = Begin; Index < End; ++Index)
+        {
+            const glm::vec3& Centroid = Context.Centroids[Context.Indices[Index]];
+            CentroidBounds.Min = glm::min(CentroidBounds.Min, Centroid);
+            CentroidBounds.Max = glm::max(CentroidBounds.Max, Centroid);
+        }
+
+        float BestCost = FLT_MAX;
+        for (int Axis = 0; Axis < 3; ++Axis)
+        {
+            const float AxisMin = CentroidBounds.Min[Axis];
+            const float AxisExtent = CentroidBounds.Max[Axis] - AxisMin;
+            if (AxisExtent <= 0.0f)
+            {
+                continue;
+            }
+            
+            FBoundingBox BinBounds[BinNum];
+            uint32_t BinCounts[BinNum] = {};
+            std::fill(std::begin(BinBounds), std::end(BinBounds), EmptyBounds());
+            const float Scale = BinNum / AxisExtent;
+            for (uint32_t Index = Begin; Index < End; ++Index)
+            {
+                const uint32_t Primitive = Context.Indices[Index];
+                const uint32_t Bin = std::min(static_cast<uint32_t>((Context.Centroids[Primitive][Axis] - AxisMin) * Scale), BinNum - 1);
+                BinCounts[Bin]++;
+                Grow(BinBounds[Bin], Context.Bounds[Primitive]);
+            }
+
+            // Sweep from the right for the right side areas, then evaluate every plane from the left
+            float RightAreas[BinNum - 1];
+            FBoundingBox RightBounds = EmptyBounds();
+            for (uint32_t Bin = BinNum - 1; Bin > 0; --Bin)
+            {
+                Grow(RightBounds, BinBounds[Bin]);
+                RightAreas[Bin - 1] = HalfArea(RightBounds);
+            }
+            FBoundingBox LeftBounds = EmptyBounds();
+            uint32_t LeftCount = 0;
+            for (uint32_t Bin = 0; Bin < BinNum - 1; ++Bin)
+            {
+                Grow(LeftBounds, BinBounds[Bin]);
+                LeftCount += BinCounts[Bin];
+                const uint32_t RightCount = (End - Begin) - LeftCount;
+                if (LeftCount == 0 || RightCount == 0)
+                {
+                    continue;
+                }
+                const float Cost = HalfArea(LeftBounds) * LeftCount + RightAreas[Bin] * RightCount;
+                if (Cost < BestCost)
+                {
+                    BestCost = Cost;
+                    OutAxis = Axis;
+                    OutSplit = AxisMin + (Bin + 1) / Scale;
+                }
+            }
+        }
+
+        return BestCost != FLT_MAX;
+    }
+
+    uint32_t BuildRecursive(FBuildContext& Context, std::vector<FBinaryNode>& Nodes, uint32_t Begin, uint32_t End, std::vector<FSubtreeTask>* Tasks)
+    {
+        const uint32_t NodeIndex = static_cast<uint32_t>(Nodes.size());
+        Nodes.emplace_back();
+        
+        FBoundingBox Bounds = EmptyBounds();
+        for (uint32_t Index = Begin; Index < End; ++Index)
+        {
+            Grow(Bounds, Context.Bounds[Context.Indices[Index]]);
+        }
+        Nodes[NodeIndex].Bounds = Bounds;
+
+        const uint32_t Count = End - Begin;
+        if (Count <= FBvh::MaxLeafSize)
+        {
+            Nodes[NodeIndex].First = Begin;
+            Nodes[NodeIndex].Count = Count;
+            return NodeIndex;
+        }
+        // Deferred to a job, the placeholder is replaced by the subtree root when the jobs are merged
+        if (Tasks && Count <= Context.SubtreeSize)
+        {
+            Tasks->push_back({NodeIndex, Begin, End});
+            return NodeIndex;
+        }
+
+        int Axis = 0;
+        float Split = 0.0f;
+        uint32_t Middle;
+        if (FindSplit(Context, Begin, End, Axis, Split))
+        {
+            uint32_t* Partition = std::partition(Context.Indices.data() + Begin, Context.Indices.data() + End, [&Context, Axis, Split](uint32_t Primitive)
+            {
+                return Context.Centroids[Primitive][Axis] < Split;
+            });
+            Middle = static_cast<uint32_t>(Partition - Context.Indices.data());
+        }
+        else
+        {
+            Middle = End;
+        }
+        if (Middle == Begin || Middle == End)
+        {
+            // Coincident centroids, split in the middle so leaves stay small
+            Middle = Begin + Count / 2;
+        }
+
+        const uint32_t Left = BuildRecursive(Context, Nodes, Begin, Middle, Tasks);
+        const uint32_t Right = BuildRecursive(Context, Nodes, Middle, End, Tasks);
+        Nodes[NodeIndex].Left = Left;
+        Nodes[NodeIndex].Right = Right;
+        return NodeIndex;
+    }
+
+    // Pulls the largest grandchildren up until the node has four children, nodes are allocated in preorder
+    uint32_t Collapse(const std::vector<FBinaryNode>& BinaryNodes, uint32_t BinaryIndex, std::vector<FBvhNode>& Nodes)
+    {
+        const uint32_t NodeIndex = static_cast<uint32_t>(Nodes.size());
+        Nodes.emplace_back();
+
+        uint32_t Children[4];
+        uint32_t ChildNum = 0;
+        const FBinaryNode& Root = BinaryNodes[BinaryIndex];
+        if (Root.Count > 0)
+        {
+            Children[ChildNum++] = BinaryIndex;
+        }
+        else
+        {
+            Children[ChildNum++] = Root.Left;
+            Children[ChildNum++] = Root.Right;
+        }
+        while (ChildNum < 4)
+        {
+            int Largest = -1;
+            float LargestArea = -1.0f;
+            for (uint32_t Slot = 0; Slot < ChildNum; ++Slot)
+            {
+                const FBinaryNode& Child = BinaryNodes[Children[Slot]];
+                const float Area = HalfArea(Child.Bounds);
+                if (Child.Count == 0 && Area > LargestArea)
+                {
+                    Largest = static_cast<int>(Slot);
+                    LargestArea = Area;
+                }
+            }
+            if (Largest < 0)
+            {
+                break;
+            }
+            const FBinaryNode& Opened = BinaryNodes[Children[Largest]];
+            Children[Largest] = Opened.Left;
+            Children[ChildNum++] = Opened.Right;
+        }
+
+        for (uint32_t Slot = 0; Slot < 4; ++Slot)
+        {
+            if (Slot >= ChildNum)
+            {
+                SetChildBounds(Nodes[NodeIndex], Slot, EmptyBounds());
+                Nodes[NodeIndex].Children[Slot] = FBvh::EmptyChild;
+                Nodes[NodeIndex].Counts[Slot] = 0;
+                continue;
+            }
+            const FBinaryNode& Child = BinaryNodes[Children[Slot]];
+            uint32_t ChildIndex = Child.First;
+            if (Child.Count == 0)
+            {
+                ChildIndex = Collapse(BinaryNodes, Children[Slot], Nodes);
+            }
+            // Collapse may grow the array, index again
+            FBvhNode& Node = Nodes[NodeIndex];
+            SetChildBounds(Node, Slot, Child.Bounds);
+            Node.Children[Slot] = ChildIndex;
+            Node.Counts[Slot] = static_cast<uint8_t>(Child.Count);
+        }
+        return NodeIndex;
+    }
+
+    void ToBoxes(const FSceneBounds& Bounds, std::vector<FBoundingBox>& OutBoxes)
+    {
+        OutBoxes.resize(Bounds.Num());
+        for (size_t Index = 0; Index < Bounds.Num(); ++Index)
+        {
+            const glm::vec3 Center(Bounds.CenterX[Index], Bounds.CenterY[Index], Bounds.CenterZ[Index]);
+            const glm::vec3 Extent(Bounds.ExtentX[Index], Bounds.ExtentY[Index], Bounds.ExtentZ[Index]);
+            OutBoxes[Index] = {Center - Extent, Center + Extent};
+        }
+    }
+}
+
+void FBvh::Build(const std::vector<FBoundingBox>& PrimitiveBounds)
+{
+    Clear();
+    const uint32_t Num = static_cast<uint32_t>(PrimitiveBounds.size());
+    if (Num == 0)
+    {
+        return;
+    }
+    Primitives = PrimitiveBounds;
+    PrimitiveIndices.resize(Num);
+    for (uint32_t Index = 0; Index < Num; ++Index)
+    {
+        PrimitiveIndices[Index] = Index;
+    }
+
+    // Enough subtrees to keep every worker busy while the serial top stays shallow
+    const uint32_t TaskNum = (FJobSystem::Get()->GetWorkerNum() + 1) * 4;
+    FBuildContext Context{Primitives, std::vector<glm::vec3>(Num), PrimitiveIndices, std::max(Num / TaskNum, MinSubtreeSize)};
+    for (uint32_t Index = 0; Index < Num; ++Index)
+    {
+        Context.Centroids[Index] = (Primitives[Index].Min + Primitives[Index].Max) * 0.5f;
+    }
+
+    std::vector<FBinaryNode> BinaryNodes;
+    BinaryNodes.reserve(Num / 2);
+    std::vector<FSubtreeTask> Tasks;
+    BuildRecursive(Context, BinaryNodes, 0, Num, &Tasks);
+
+    // Subtrees only touch their own index range, each builds into its own array
+    std::vector<std::vector<FBinaryNode>> SubtreeNodes(Tasks.size());
+    FJobSystem::Get()->ParallelFor(static_cast<uint32_t>(Tasks.size()), 1, [&](uint32_t TaskBegin, uint32_t TaskEnd)
+    {
+        for (uint32_t Task = TaskBegin; Task < TaskEnd; ++Task)
+        {
+            BuildRecursive(Context, SubtreeNodes[Task], Tasks[Task].Begin, Tasks[Task].End, nullptr);
+        }
+    });
+    for (size_t Task = 0; Task < Tasks.size(); ++Task)
+    {
+        const uint32_t Offset = static_cast<uint32_t>(BinaryNodes.size());
+        for (FBinaryNode& Node : SubtreeNodes[Task])
+        {
+            if (Node.Count == 0)
+            {
+                Node.Left += Offset;
+                Node.Right += Offset;
+            }
+        }
+        BinaryNodes.insert(BinaryNodes.end(), SubtreeNodes[Task].begin(), SubtreeNodes[Task].end());
+        // The subtree root is duplicated into the placeholder, its original copy is never referenced
+        BinaryNodes[Tasks[Task].Node] = BinaryNodes[Offset];
+    }
+
+    Nodes.reserve(BinaryNodes.size() / 2 + 1);
+    Collapse(BinaryNodes, 0, Nodes);
+}
+
+void FBvh::Build(const FSceneBounds& Bounds)
+{
+    std::vector<FBoundingBox> Boxes;
+    ToBoxes(Bounds, Boxes);
+    Build(Boxes);
+}
+
+void FBvh::Refit(const std::vector<FBoundingBox>& PrimitiveBounds)
+{
+    checkf(PrimitiveBounds.size() == Primitives.size(), "FBvh::Refit primitive count changed from %zu to %zu", Primitives.size(), PrimitiveBounds.size());
+    Primitives = PrimitiveBounds;
+    RefitNodes();
+}
+
+void FBvh::Refit(const FSceneBounds& Bounds)
+{
+    checkf(Bounds.Num() == Primitives.size(), "FBvh::Refit primitive count changed from %zu to %zu", Primitives.size(), Bounds.Num());
+    ToBoxes(Bounds, Primitives);
+    RefitNodes();
+}
+
+void FBvh::RefitNodes()
+{
+    // Children always come after their parent, so a reverse sweep sees every child first
+    for (size_t NodeIndex = Nodes.size(); NodeIndex-- > 0;)
+    {
+        FBvhNode& Node = Nodes[NodeIndex];
+        for (uint32_t Slot = 0; Slot < 4; ++Slot)
+        {
+            if (Node.Children[Slot] == EmptyChild)
+            {
+                continue;
+            }
+            FBoundingBox Bounds = EmptyBounds();
+            if (Node.Counts[Slot] > 0)
+            {
+                for (uint32_t Index = 0; Index < Node.Counts[Slot]; ++Index)
+                {
+                    Grow(Bounds, Primitives[PrimitiveIndices[Node.Children[Slot] + Index]]);
+                }
+            }
+            else
+            {
+                Bounds = GetNodeBounds(Nodes[Node.Children[Slot]]);
+            }
+            SetChildBounds(Node, Slot, Bounds);
+        }
+    }
+}
+
+void FBvh::Clear()
+{
+    Nodes.clear();
+    PrimitiveIndices.clear();
+    Primitives.clear();
+}
+
+void FBvh::QueryAabb(const FBoundingBox& Box, std::vector<uint32_t>& OutPrimitives) const
+{
+    OutPrimitives.clear();
+    if (Nodes.empty())
+    {
+        return;
+    }
+
+    const __m128 BoxMinX = _mm_set1_ps(Box.Min.x);
+    const __m128 BoxMinY = _mm_set1_ps(Box.Min.y);
+    const __m128 BoxMinZ = _mm_set1_ps(Box.Min.z);
+    const __m128 BoxMaxX = _mm_set1_ps(Box.Max.x);
+    const __m128 BoxMaxY = _mm_set1_ps(Box.Max.y);
+    const __m128 BoxMaxZ = _mm_set1_ps(Box.Max.z);
+
+    uint32_t Stack[MaxStackSize];
+    uint32_t StackSize = 0;
+    Stack[StackSize++] = 0;
+    while (StackSize > 0)
+    {
+        const FBvhNode& Node = Nodes[Stack[--StackSize]];
+        __m128 Overlap = _mm_and_ps(_mm_cmple_ps(_mm_load_ps(Node.MinX), BoxMaxX), _mm_cmpge_ps(_mm_load_ps(Node.MaxX), BoxMinX));
+        Overlap = _mm_and_ps(Overlap, _mm_and_ps(_mm_cmple_ps(_mm_load_ps(Node.MinY), BoxMaxY), _mm_cmpge_ps(_mm_load_ps(Node.MaxY), BoxMinY)));
+        Overlap = _mm_and_ps(Overlap, _mm_and_ps(_mm_cmple_ps(_mm_load_ps(Node.MinZ), BoxMaxZ), _mm_cmpge_ps(_mm_load_ps(Node.MaxZ), BoxMinZ)));
+        const int Mask = _mm_movemask_ps(Overlap);
+        
+        for (uint32_t Slot = 0; Slot < 4; ++Slot)
+        {
+            if (!(Mask & (1 << Slot)))
+            {
+                continue;
+            }
+            if (Node.Counts[Slot] == 0)
+            {
+                checkf(StackSize < MaxStackSize, "FBvh::QueryAabb traversal stack overflow");
+                Stack[StackSize++] = Node.Children[Slot];
+                continue;
+            }
+            for (uint32_t Index = 0; Index < Node.Counts[Slot]; ++Index)
+            {
+                const uint32_t Primitive = PrimitiveIndices[Node.Children[Slot] + Index];
+                const FBoundingBox& Bounds = Primitives[Primitive];
+                if (glm::all(glm::lessThanEqual(Bounds.Min, Box.Max)) && glm::all(glm::greaterThanEqual(Bounds.Max, Box.Min)))
+                {
+                    OutPrimitives.push_back(Primitive);
+                }
+            }
+        }
+    }
+}
+
+void FBvh::QueryFrustum(const FFrustum& Frustum, std::vector<uint32_t>& OutPrimitives) const
+{
+    OutPrimitives.clear();
+    if (Nodes.empty())
+    {
+        return;
+    }
+
+    const __m128 Half = _mm_set1_ps(0.5f);
+    const __m128 Zero = _mm_setzero_ps();
+    uint32_t Stack[MaxStackSize];
+    uint32_t StackSize = 0;
+    Stack[StackSize++] = 0;
+    while (StackSize > 0)
+    {
+        const FBvhNode& Node = Nodes[Stack[--StackSize]];
+        const __m128 MinX = _mm_load_ps(Node.MinX);
+        const __m128 MinY = _mm_load_ps(Node.MinY);
+        const __m128 MinZ = _mm_load_ps(Node.MinZ);
+        const __m128 MaxX = _mm_load_ps(Node.MaxX);
+        const __m128 MaxY = _mm_load_ps(Node.MaxY);
+        const __m128 MaxZ = _mm_load_ps(Node.MaxZ);
+        const __m128 CenterX = _mm_mul_ps(_mm_add_ps(MinX, MaxX), Half);
+        const __m128 CenterY = _mm_mul_ps(_mm_add_ps(MinY, MaxY), Half);
+        const __m128 CenterZ = _mm_mul_ps(_mm_add_ps(MinZ, MaxZ), Half);
+        const __m128 ExtentX = _mm_mul_ps(_mm_sub_ps(MaxX, MinX), Half);
+        const __m128 ExtentY = _mm_mul_ps(_mm_sub_ps(MaxY, MinY), Half);
+        const __m128 ExtentZ = _mm_mul_ps(_mm_sub_ps(MaxZ, MinZ), Half);
+        
+        // Unused slots have negative extents and always end up behind a plane
+        __m128 Outside = _mm_cmplt_ps(ExtentX, Zero);
+        for (const glm::vec4& Plane : Frustum.Planes)
+        {
+            __m128 Distance = _mm_add_ps(_mm_mul_ps(CenterX, _mm_set1_ps(Plane.x)), _mm_set1_ps(Plane.w));
+            Distance = _mm_add_ps(Distance, _mm_mul_ps(CenterY, _mm_set1_ps(Plane.y)));
+            Distance = _mm_add_ps(Distance, _mm_mul_ps(CenterZ, _mm_set1_ps(Plane.z)));
+            Distance = _mm_add_ps(Distance, _mm_mul_ps(ExtentX, _mm_set1_ps(std::abs(Plane.x))));
+            Distance = _mm_add_ps(Distance, _mm_mul_ps(ExtentY, _mm_set1_ps(std::abs(Plane.y))));
+            Distance = _mm_add_ps(Distance, _mm_mul_ps(ExtentZ, _mm_set1_ps(std::abs(Plane.z))));
+            Outside = _mm_or_ps(Outside, _mm_cmplt_ps(Distance, Zero));
+        }
+        const int Mask = ~_mm_movemask_ps(Outside);
+
+        for (uint32_t Slot = 0; Slot < 4; ++Slot)
+        {
+            if (!(Mask & (1 << Slot)))
+            {
+                continue;
+            }
+            if (Node.Counts[Slot] == 0)
+            {
+                checkf(StackSize < MaxStackSize, "FBvh::QueryFrustum traversal stack overflow");
+                Stack[StackSize++] = Node.Children[Slot];
+                continue;
+            }
+            // Leaves are small, their primitives are returned without a second test
+            for (uint32_t Index = 0; Index < Node.Counts[Slot]; ++Index)
+            {
+                OutPrimitives.push_back(PrimitiveIndices[Node.Children[Slot] + Index]);
+            }
+        }
+    }
+}
+
+bool FBvh::Raycast(const FBvhRay& Ray, FBvhHit& OutHit, const FRayPrimitiveTest& PrimitiveTest) const
+{
+    OutHit = FBvhHit();
+    if (Nodes.empty())
+    {
+        return false;
+    }
+
+    const glm::vec3 InvDirection = 1.0f / Ray.Direction;
+    const __m128 OriginX = _mm_set1_ps(Ray.Origin.x);
+    const __m128 OriginY = _mm_set1_ps(Ray.Origin.y);
+    const __m128 OriginZ = _mm_set1_ps(Ray.Origin.z);
+    const __m128 InvX = _mm_set1_ps(InvDirection.x);
+    const __m128 InvY = _mm_set1_ps(InvDirection.y);
+    const __m128 InvZ = _mm_set1_ps(InvDirection.z);
+    float Closest = Ray.MaxDistance;
+
+    struct FStackEntry
+    {
+        uint32_t Node;
+        float Distance;
+    };
+    FStackEntry Stack[MaxStackSize];
+    uint32_t StackSize = 0;
+    Stack[StackSize++] = {0, 0.0f};
+    while (StackSize > 0)
+    {
+        const FStackEntry Entry = Stack[--StackSize];
+        if (Entry.Distance > Closest)
+        {
+            continue;
+        }
+        const FBvhNode& Node = Nodes[Entry.Node];
+
+        // Slab test on all four children
+        const __m128 X0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(Node.MinX), OriginX), InvX);
+        const __m128 X1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(Node.MaxX), OriginX), InvX);
+        const __m128 Y0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(Node.MinY), OriginY), InvY);
+        const __m128 Y1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(Node.MaxY), OriginY), InvY);
+        const __m128 Z0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(Node.MinZ), OriginZ), InvZ);
+        const __m128 Z1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(Node.MaxZ), OriginZ), InvZ);
+        __m128 Enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(X0, X1), _mm_min_ps(Y0, Y1)), _mm_max_ps(_mm_min_ps(Z0, Z1), _mm_setzero_ps()));
+        __m128 Exit = _mm_min_ps(_mm_min_ps(_mm_max_ps(X0, X1), _mm_max_ps(Y0, Y1)), _mm_min_ps(_mm_max_ps(Z0, Z1), _mm_set1_ps(Closest)));
+        // Unused slots are inverted boxes and never pass
+        const __m128 Valid = _mm_cmple_ps(_mm_load_ps(Node.MinX), _mm_load_ps(Node.MaxX));
+        const int Mask = _mm_movemask_ps(_mm_and_ps(_mm_cmple_ps(Enter, Exit), Valid));
+        alignas(16) float EnterDistances[4];
+        _mm_store_ps(EnterDistances, Enter);
+
+        // Push far children first so the nearest is visited next
+        FStackEntry Hits[4];
+        uint32_t HitNum = 0;
+        for (uint32_t Slot = 0; Slot < 4; ++Slot)
+        {
+            if (!(Mask & (1 << Slot)))
+            {
+                continue;
+            }
+            if (Node.Counts[Slot] == 0)
+            {
+                uint32_t Insert = HitNum++;
+                while (Insert > 0 && Hits[Insert - 1].Distance < EnterDistances[Slot])
+                {
+                    Hits[Insert] = Hits[Insert - 1];
+                    --Insert;
+                }
+                Hits[Insert] = {Node.Children[Slot], EnterDistances[Slot]};
+                continue;
+            }
+            for (uint32_t Index = 0; Index < Node.Counts[Slot]; ++Index)
+            {
+                const uint32_t Primitive = PrimitiveIndices[Node.Children[Slot] + Index];
+                float Distance = Closest;
+                bool bHit;
+                if (PrimitiveTest)
+                {
+                    bHit = PrimitiveTest(Primitive, Ray, Distance);
+                }
+                else
+                {
+                    bHit = IntersectRayBox(Primitives[Primitive], Ray.Origin, InvDirection, Closest, Distance);
+                }
+                if (bHit && Distance <= Closest)
+                {
+                    Closest = Distance;
+                    OutHit.Primitive = Primitive;
+                    OutHit.Distance = Distance;
+                }
+            }
+        }
+        checkf(StackSize + HitNum <= MaxStackSize, "FBvh::Raycast traversal stack overflow");
+        for (uint32_t Hit = 0; Hit < HitNum; ++Hit)
+        {
+            Stack[StackSize++] = Hits[Hit];
+        }
+    }
+    return OutHit.Primitive != UINT32_MAX;
+}
+
+bool FBvh::IsEmpty() const
+{
+    return Nodes.empty();
+}
+
+uint32_t FBvh::GetNodeNum() const
+{
+    return static_cast<uint32_t>(Nodes.size());
+}
+
+FBoundingBox FBvh::GetBounds() const
+{
+    return Nodes.empty() ? FBoundingBox() : GetNodeBounds(Nodes[0]);
+}
@@ -0,0 +1,71 @@
+﻿#pragma once
+#include <cfloat>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "Engine/FrustumCulling.h"
+#include "Engine/Scene.h"
+#include "glm/glm.hpp"
+
+// Four children stored as SoA so one SSE test covers the whole node, two cache lines per node.
+// Unused slots carry inverted bounds and fail every test.
+struct alignas(64) FBvhNode
+{
+    float MinX[4];
+    float MinY[4];
+    float MinZ[4];
+    float MaxX[4];
+    float MaxY[4];
+    float MaxZ[4];
+    // Inner child: node index, leaf child: first entry in the primitive index list
+    uint32_t Children[4];
+    // Primitives of a leaf child, 0 for inner and unused children
+    uint8_t Counts[4];
+};
+
+struct FBvhRay
+{
+    glm::vec3 Origin = glm::vec3(0.0f);
+    glm::vec3 Direction = glm::vec3(0.0f, 0.0f, 1.0f);
+    float MaxDistance = FLT_MAX;
+};
+
+struct FBvhHit
+{
+    uint32_t Primitive = UINT32_MAX;
+    float Distance = FLT_MAX;
+};
+
+// BVH4 over primitive bounds, built top-down with binned SAH and collapsed from a binary tree.
+// Subtrees below the top levels are built in parallel on FJobSystem.
+class FBvh
+{
+public:
+    static constexpr uint32_t EmptyChild = UINT32_MAX;
+    static constexpr uint32_t MaxLeafSize = 4;
+    // Exact hit test for ray casts, shortens Distance and returns true on a closer hit. Primitive bounds are used without one
+    using FRayPrimitiveTest = std::function<bool(uint32_t Primitive, const FBvhRay& Ray, float& Distance)>;
+
+    void Build(const std::vector<FBoundingBox>& PrimitiveBounds);
+    void Build(const FSceneBounds& Bounds);
+    // Moves node bounds to the new primitive bounds keeping the tree shape, rebuild once objects moved far
+    void Refit(const std::vector<FBoundingBox>& PrimitiveBounds);
+    void Refit(const FSceneBounds& Bounds);
+    void Clear();
+
+    void QueryAabb(const FBoundingBox& Box, std::vector<uint32_t>& OutPrimitives) const;
+    void QueryFrustum(const FFrustum& Frustum, std::vector<uint32_t>& OutPrimitives) const;
+    bool Raycast(const FBvhRay& Ray, FBvhHit& OutHit, const FRayPrimitiveTest& PrimitiveTest = nullptr) const;
+
+    bool IsEmpty() const;
+    uint32_t GetNodeNum() const;
+    FBoundingBox GetBounds() const;
+
+private:
+    void RefitNodes();
+
+private:
+    std::vector<FBvhNode> Nodes;
+    std::vector<uint32_t> PrimitiveIndices;
+    std::vector<FBoundingBox> Primitives;
+};
@@ -87,3 +87,18 @@ bool FFbxImport::GetStaticMeshData(const std::string FilePath, std::vector<FStat
     pManager->Destroy();
     return true;
 }
+
+FBoundingBox FFbxImport::GetStaticMeshBounds(const std::vector<FStaticMeshVertex>& Vertices)
+{
+    if (Vertices.empty())
+    {
+        return {};
+    }
+    FBoundingBox Bounds{Vertices[0].Position, Vertices[0].Position};
+    for (const FStaticMeshVertex& Vertex : Vertices)
+    {
+        Bounds.Min = glm::min(Bounds.Min, Vertex.Position);
+        Bounds.Max = glm::max(Bounds.Max, Vertex.Position);
+    }
+    return Bounds;
+}
@@ -1,6 +1,7 @@
 ﻿#pragma once
 #include <string>
 #include <vector>
+#include "Engine/Scene.h"
 #include "Render/VertexInputs.h"
 
 class FFbxImport
@@ -10,4 +11,6 @@ public:
         const std::string FilePath,
         std::vector<FStaticMeshVertex>& Vertices,
         std::vector<uint32_t>& Indices);
+    // Object space bounds, used as the local bounds of scene entities and BVH primitives
+    static FBoundingBox GetStaticMeshBounds(const std::vector<FStaticMeshVertex>& Vertices);
 };
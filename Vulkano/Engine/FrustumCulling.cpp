@@ -0,0 +1,301 @@
+﻿#include "FrustumCulling.h"
+
+#include <algorithm>
+#include <cstring>
+#include <immintrin.h>
+#include "Core/JobSystem.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define CULLING_TARGET_AVX2
+#else
+#include <cpuid.h>
+#define CULLING_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+ECullingPath FFrustumCulling::SupportedPath = FFrustumCulling::DetectPath();
+ECullingPath FFrustumCulling::Path          = FFrustumCulling::SupportedPath;
+
+namespace
+{
+    // Objects per job, each job compacts into its own slice of the output
+    constexpr uint32_t CullBatchSize = 16384;
+
+    struct FPlaneData
+    {
+        float NormalX[6];
+        float NormalY[6];
+        float NormalZ[6];
+        float AbsNormalX[6];
+        float AbsNormalY[6];
+        float AbsNormalZ[6];
+        float Distance[6];
+    };
+
+    FPlaneData MakePlaneData(const FFrustum& Frustum)
+    {
+        FPlaneData Data;
+        for (int Plane = 0; Plane < 6; ++Plane)
+        {
+            const glm::vec4& P = Frustum.Planes[Plane];
+            Data.NormalX[Plane] = P.x;
+            Data.NormalY[Plane] = P.y;
+            Data.NormalZ[Plane] = P.z;
+            Data.AbsNormalX[Plane] = std::abs(P.x);
+            Data.AbsNormalY[Plane] = std::abs(P.y);
+            Data.AbsNormalZ[Plane] = std::abs(P.z);
+            Data.Distance[Plane] = P.w;
+        }
+        return Data;
+    }
+
+    // Box radius along the plane normal, a box is outside when it lies fully behind any plane.
+    // Sums in the same order as the SIMD paths so every path agrees on bounds touching a plane
+    inline bool IsVisibleScalar(const FPlaneData& Planes, const FSceneBounds& Bounds, ECullingVolume Volume, uint32_t Index)
+    {
+        const float X = Bounds.CenterX[Index];
+        const float Y = Bounds.CenterY[Index];
+        const float Z = Bounds.CenterZ[Index];
+        for (int Plane = 0; Plane < 6; ++Plane)
+        {
+            float Distance = X * Planes.NormalX[Plane] + Planes.Distance[Plane];
+            Distance += Y * Planes.NormalY[Plane];
+            Distance += Z * Planes.NormalZ[Plane];
+            if (Volume == ECullingVolume::Sphere)
+            {
+                Distance += Bounds.Radius[Index];
+            }
+            else
+            {
+                Distance += Bounds.ExtentX[Index] * Planes.AbsNormalX[Plane];
+                Distance += Bounds.ExtentY[Index] * Planes.AbsNormalY[Plane];
+                Distance += Bounds.ExtentZ[Index] * Planes.AbsNormalZ[Plane];
+            }
+            if (Distance < 0.0f)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    uint32_t CullScalar(const FPlaneData& Planes, const FSceneBounds& Bounds, ECullingVolume Volume, uint32_t Begin, uint32_t End, uint32_t* OutIndices)
+    {
+        uint32_t Count = 0;
+        for (uint32_t Index = Begin; Index < End; ++Index)
+        {
+            OutIndices[Count] = Index;
+            Count += IsVisibleScalar(Planes, Bounds, Volume, Index) ? 1 : 0;
+        }
+        return Count;
+    }
+
+    uint32_t CullSSE(const FPlaneData& Planes, const FSceneBounds& Bounds, ECullingVolume Volume, uint32_t Begin, uint32_t End, uint32_t* OutIndices)
+    {
+        const bool bSphere = Volume == ECullingVolume::Sphere;
+        const __m128 Zero = _mm_setzero_ps();
+        uint32_t Count = 0;
+        uint32_t Index = Begin;
+        for (; Index + 4 <= End; Index += 4)
+        {
+            const __m128 X = _mm_loadu_ps(&Bounds.CenterX[Index]);
+            const __m128 Y = _mm_loadu_ps(&Bounds.CenterY[Index]);
+            const __m128 Z = _mm_loadu_ps(&Bounds.CenterZ[Index]);
+            __m128 Outside = _mm_setzero_ps();
+            if (bSphere)
+            {
+                const __m128 R = _mm_loadu_ps(&Bounds.Radius[Index]);
+                for (int Plane = 0; Plane < 6; ++Plane)
+                {
+                    __m128 Distance = _mm_add_ps(_mm_mul_ps(X, _mm_set1_ps(Planes.NormalX[Plane])), _mm_set1_ps(Planes.Distance[Plane]));
+                    Distance = _mm_add_ps(Distance, _mm_mul_ps(Y, _mm_set1_ps(Planes.NormalY[Plane])));
+                    Distance = _mm_add_ps(Distance, _mm_mul_ps(Z, _mm_set1_ps(Planes.NormalZ[Plane])));
+                    Outside = _mm_or_ps(Outside, _mm_cmplt_ps(_mm_add_ps(Distance, R), Zero));
+                }
+            }
+            else
+            {
+                const __m128 EX = _mm_loadu_ps(&Bounds.ExtentX[Index]);
+                const __m128 EY = _mm_loadu_ps(&Bounds.ExtentY[Index]);
+                const __m128 EZ = _mm_loadu_ps(&Bounds.ExtentZ[Index]);
+                for (int Plane = 0; Plane < 6; ++Plane)
+                {
+                    __m128 Distance = _mm_add_ps(_mm_mul_ps(X, _mm_set1_ps(Planes.NormalX[Plane])), _mm_set1_ps(Planes.Distance[Plane]));
+                    Distance = _mm_add_ps(Distance, _mm_mul_ps(Y, _mm_set1_ps(Planes.NormalY[Plane])));
+                    Distance = _mm_add_ps(Distance, _mm_mul_ps(Z, _mm_set1_ps(Planes.NormalZ[Plane])));
+                    Distance = _mm_add_ps(Distance, _mm_mul_ps(EX, _mm_set1_ps(Planes.AbsNormalX[Plane])));
+                    Distance = _mm_add_ps(Distance, _mm_mul_ps(EY, _mm_set1_ps(Planes.AbsNormalY[Plane])));
+                    Distance = _mm_add_ps(Distance, _mm_mul_ps(EZ, _mm_set1_ps(Planes.AbsNormalZ[Plane])));
+                    Outside = _mm_or_ps(Outside, _mm_cmplt_ps(Distance, Zero));
+                }
+            }
+            // Branchless compaction, every lane is written and only visible ones advance the cursor
+            const int Visible = ~_mm_movemask_ps(Outside);
+            for (uint32_t Lane = 0; Lane < 4; ++Lane)
+            {
+                OutIndices[Count] = Index + Lane;
+                Count += (Visible >> Lane) & 1;
+            }
+        }
+        return Count + CullScalar(Planes, Bounds, Volume, Index, End, OutIndices + Count);
+    }
+
+    CULLING_TARGET_AVX2 uint32_t CullAVX2(const FPlaneData& Planes, const FSceneBounds& Bounds, ECullingVolume Volume, uint32_t Begin, uint32_t End, uint32_t* OutIndices)
+    {
+        const bool bSphere = Volume == ECullingVolume::Sphere;
+        const __m256 Zero = _mm256_setzero_ps();
+        uint32_t Count = 0;
+        uint32_t Index = Begin;
+        for (; Index + 8 <= End; Index += 8)
+        {
+            const __m256 X = _mm256_loadu_ps(&Bounds.CenterX[Index]);
+            const __m256 Y = _mm256_loadu_ps(&Bounds.CenterY[Index]);
+            const __m256 Z = _mm256_loadu_ps(&Bounds.CenterZ[Index]);
+            __m256 Outside = _mm256_setzero_ps();
+            if (bSphere)
+            {
+                const __m256 R = _mm256_loadu_ps(&Bounds.Radius[Index]);
+                for (int Plane = 0; Plane < 6; ++Plane)
+                {
+                    __m256 Distance = _mm256_add_ps(_mm256_mul_ps(X, _mm256_set1_ps(Planes.NormalX[Plane])), _mm256_set1_ps(Planes.Distance[Plane]));
+                    Distance = _mm256_add_ps(Distance, _mm256_mul_ps(Y, _mm256_set1_ps(Planes.NormalY[Plane])));
+                    Distance = _mm256_add_ps(Distance, _mm256_mul_ps(Z, _mm256_set1_ps(Planes.NormalZ[Plane])));
+                    Outside = _mm256_or_ps(Outside, _mm256_cmp_ps(_mm256_add_ps(Distance, R), Zero, _CMP_LT_OQ));
+                }
+            }
+            else
+            {
+                const __m256 EX = _mm256_loadu_ps(&Bounds.ExtentX[Index]);
+                const __m256 EY = _mm256_loadu_ps(&Bounds.ExtentY[Index]);
+                const __m256 EZ = _mm256_loadu_ps(&Bounds.ExtentZ[Index]);
+                for (int Plane = 0; Plane < 6; ++Plane)
+                {
+                    __m256 Distance = _mm256_add_ps(_mm256_mul_ps(X, _mm256_set1_ps(Planes.NormalX[Plane])), _mm256_set1_ps(Planes.Distance[Plane]));
+                    Distance = _mm256_add_ps(Distance, _mm256_mul_ps(Y, _mm256_set1_ps(Planes.NormalY[Plane])));
+                    Distance = _mm256_add_ps(Distance, _mm256_mul_ps(Z, _mm256_set1_ps(Planes.NormalZ[Plane])));
+                    Distance = _mm256_add_ps(Distance, _mm256_mul_ps(EX, _mm256_set1_ps(Planes.AbsNormalX[Plane])));
+                    Distance = _mm256_add_ps(Distance, _mm256_mul_ps(EY, _mm256_set1_ps(Planes.AbsNormalY[Plane])));
+                    Distance = _mm256_add_ps(Distance, _mm256_mul_ps(EZ, _mm256_set1_ps(Planes.AbsNormalZ[Plane])));
+                    Outside = _mm256_or_ps(Outside, _mm256_cmp_ps(Distance, Zero, _CMP_LT_OQ));
+                }
+            }
+            const int Visible = ~_mm256_movemask_ps(Outside);
+            for (uint32_t Lane = 0; Lane < 8; ++Lane)
+            {
+                OutIndices[Count] = Index + Lane;
+                Count += (Visible >> Lane) & 1;
+            }
+        }
+        return Count + CullSSE(Planes, Bounds, Volume, Index, End, OutIndices + Count);
+    }
+}
+
+FFrustum FFrustum::FromViewProjection(const glm::mat4& ViewProjection)
+{
+    // Gribb/Hartmann, planes are combinations of the clip matrix rows
+    const glm::mat4 M = glm::transpose(ViewProjection);
+    FFrustum Frustum;
+    Frustum.Planes[0] = M[3] + M[0];
+    Frustum.Planes[1] = M[3] - M[0];
+    Frustum.Planes[2] = M[3] + M[1];
+    Frustum.Planes[3] = M[3] - M[1];
+    // Exact for glm's default [-w, w] clip depth, slightly conservative for a [0, w] projection
+    Frustum.Planes[4] = M[3] + M[2];
+    Frustum.Planes[5] = M[3] - M[2];
+    for (glm::vec4& Plane : Frustum.Planes)
+    {
+        Plane /= glm::length(glm::vec3(Plane));
+    }
+    return Frustum;
+}
+
+ECullingPath FFrustumCulling::DetectPath()
+{
+    int Registers[4] = {};
+#if defined(_MSC_VER)
+    __cpuid(Registers, 0);
+    const int MaxLeaf = Registers[0];
+    __cpuid(Registers, 1);
+#else
+    unsigned int Eax, Ebx, Ecx, Edx;
+    const int MaxLeaf = static_cast<int>(__get_cpuid_max(0, nullptr));
+    __cpuid(1, Eax, Ebx, Ecx, Edx);
+    Registers[2] = static_cast<int>(Ecx);
+#endif
+    // AVX needs the OS to save the YMM registers, checked through OSXSAVE + XCR0
+    const bool bOSXSave = (Registers[2] & (1 << 27)) != 0;
+    const bool bAVX = (Registers[2] & (1 << 28)) != 0;
+    if (MaxLeaf < 7 || !bOSXSave || !bAVX)
+    {
+        return ECullingPath::SSE;
+    }
+#if defined(_MSC_VER)
+    const unsigned long long XCR0 = _xgetbv(0);
+    __cpuidex(Registers, 7, 0);
+#else
+    unsigned int XCR0Low, XCR0High;
+    __asm__("xgetbv" : "=a"(XCR0Low), "=d"(XCR0High) : "c"(0));
+    const unsigned long long XCR0 = (static_cast<unsigned long long>(XCR0High) << 32) | XCR0Low;
+    __cpuid_count(7, 0, Eax, Ebx, Ecx, Edx);
+    Registers[1] = static_cast<int>(Ebx);
+#endif
+    const bool bYMMSaved = (XCR0 & 0x6) == 0x6;
+    const bool bAVX2 = (Registers[1] & (1 << 5)) != 0;
+    return bYMMSaved && bAVX2 ? ECullingPath::AVX2 : ECullingPath::SSE;
+}
+
+ECullingPath FFrustumCulling::GetPath()
+{
+    return Path;
+}
+
+void FFrustumCulling::SetPath(ECullingPath InPath)
+{
+    Path = static_cast<uint8_t>(InPath) <= static_cast<uint8_t>(SupportedPath) ? InPath : SupportedPath;
+}
+
+uint32_t FFrustumCulling::CullRange(const FFrustum& Frustum, const FSceneBounds& Bounds, ECullingVolume Volume, uint32_t Begin, uint32_t End, uint32_t* OutIndices)
+{
+    const FPlaneData Planes = MakePlaneData(Frustum);
+    switch (Path)
+    {
+    case ECullingPath::AVX2:
+        return CullAVX2(Planes, Bounds, Volume, Begin, End, OutIndices);
+    case ECullingPath::SSE:
+        return CullSSE(Planes, Bounds, Volume, Begin, End, OutIndices);
+    default:
+        return CullScalar(Planes, Bounds, Volume, Begin, End, OutIndices);
+    }
+}
+
+uint32_t FFrustumCulling::Cull(const FFrustum& Frustum, const FSceneBounds& Bounds, ECullingVolume Volume, std::vector<uint32_t>& OutVisibleIndices)
+{
+    const uint32_t Num = static_cast<uint32_t>(Bounds.Num());
+    OutVisibleIndices.resize(Num);
+    if (Num == 0)
+    {
+        return 0;
+    }
+
+    // Every batch compacts into its own slice, the slices are then packed front to back
+    const uint32_t BatchNum = (Num + CullBatchSize - 1) / CullBatchSize;
+    std::vector<uint32_t> BatchCounts(BatchNum);
+    FJobSystem::Get()->ParallelFor(BatchNum, 1, [&](uint32_t BatchBegin, uint32_t BatchEnd)
+    {
+        for (uint32_t Batch = BatchBegin; Batch < BatchEnd; ++Batch)
+        {
+            const uint32_t Begin = Batch * CullBatchSize;
+            const uint32_t End = std::min(Begin + CullBatchSize, Num);
+            BatchCounts[Batch] = CullRange(Frustum, Bounds, Volume, Begin, End, OutVisibleIndices.data() + Begin);
+        }
+    });
+
+    uint32_t Count = BatchCounts[0];
+    for (uint32_t Batch = 1; Batch < BatchNum; ++Batch)
+    {
+        std::memmove(OutVisibleIndices.data() + Count, OutVisibleIndices.data() + Batch * CullBatchSize, BatchCounts[Batch] * sizeof(uint32_t));
+        Count += BatchCounts[Batch];
+    }
+    OutVisibleIndices.resize(Count);
+    return Count;
+}
@@ -0,0 +1,46 @@
+﻿#pragma once
+#include <cstdint>
+#include <vector>
+#include "Engine/Scene.h"
+#include "glm/glm.hpp"
+
+// Six normalized planes pointing inwards, a point is inside when dot(Plane.xyz, P) + Plane.w >= 0
+struct FFrustum
+{
+    static FFrustum FromViewProjection(const glm::mat4& ViewProjection);
+    
+    glm::vec4 Planes[6];
+};
+
+enum class ECullingVolume : uint8_t
+{
+    Box,
+    Sphere,
+};
+
+enum class ECullingPath : uint8_t
+{
+    Scalar,
+    SSE,
+    AVX2,
+};
+
+// Tests SoA bounds against a frustum 4 (SSE) or 8 (AVX2) objects at a time.
+// The widest path the CPU supports is picked once at startup.
+class FFrustumCulling
+{
+public:
+    // Writes the indices of visible bounds in ascending order, returns their count
+    static uint32_t Cull(const FFrustum& Frustum, const FSceneBounds& Bounds, ECullingVolume Volume, std::vector<uint32_t>& OutVisibleIndices);
+    static ECullingPath GetPath();
+    // Overrides the detected path, falls back to the detected one when the CPU lacks it
+    static void SetPath(ECullingPath Path);
+
+private:
+    static ECullingPath DetectPath();
+    static uint32_t CullRange(const FFrustum& Frustum, const FSceneBounds& Bounds, ECullingVolume Volume, uint32_t Begin, uint32_t End, uint32_t* OutIndices);
+    
+private:
+    static ECullingPath SupportedPath;
+    static ECullingPath Path;
+};
@@ -0,0 +1,176 @@
+﻿#include "ImageCompare.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <vector>
+
+namespace
+{
+    constexpr uint32_t SSIMWindow = 8;
+    constexpr uint32_t SSIMStride = 4;
+
+    void ToLuma(const FImage& Image, std::vector<float>& OutLuma)
+    {
+        OutLuma.resize(static_cast<size_t>(Image.Width) * Image.Height);
+        for (size_t Index = 0; Index < OutLuma.size(); ++Index)
+        {
+            const uint8_t* Pixel = &Image.Pixels[Index * 4];
+            OutLuma[Index] = 0.299f * Pixel[0] + 0.587f * Pixel[1] + 0.114f * Pixel[2];
+        }
+    }
+}
+
+FImageCompareResult FImageCompare::Compare(const FImage& Golden, const FImage& Image, const FImageCompareThresholds& Thresholds, FImage* OutDiff)
+{
+    FImageCompareResult Result;
+    Result.bSizeMatches = Golden.Width == Image.Width && Golden.Height == Image.Height;
+    if (!Result.bSizeMatches || Golden.Pixels.empty())
+    {
+        return Result;
+    }
+
+    if (OutDiff)
+    {
+        OutDiff->Width = Image.Width;
+        OutDiff->Height = Image.Height;
+        OutDiff->Pixels.resize(Image.Pixels.size());
+    }
+
+    const size_t PixelNum = static_cast<size_t>(Image.Width) * Image.Height;
+    for (size_t Index = 0; Index < PixelNum; ++Index)
+    {
+        uint32_t PixelDifference = 0;
+        for (uint32_t Channel = 0; Channel < 4; ++Channel)
+        {
+            const uint32_t Difference = static_cast<uint32_t>(std::abs(Golden.Pixels[Index * 4 + Channel] - Image.Pixels[Index * 4 + Channel]));
+            PixelDifference = std::max(PixelDifference, Difference);
+            if (OutDiff && Channel < 3)
+            {
+                OutDiff->Pixels[Index * 4 + Channel] = static_cast<uint8_t>(std::min(255u, Difference * 8));
+            }
+        }
+        if (OutDiff)
+        {
+            OutDiff->Pixels[Index * 4 + 3] = 255;
+        }
+        Result.MaxDifference = std::max(Result.MaxDifference, PixelDifference);
+        Result.DifferentPixels += PixelDifference > Thresholds.PixelTolerance ? 1 : 0;
+    }
+
+    Result.PSNR = ComputePSNR(Golden, Image);
+    Result.SSIM = ComputeSSIM(Golden, Image);
+    Result.bPassed = Result.PSNR >= Thresholds.MinPSNR
+        && Result.SSIM >= Thresholds.MinSSIM
+        && static_cast<double>(Result.DifferentPixels) / PixelNum <= Thresholds.MaxDifferentPixelRatio;
+    return Result;
+}
+
+double FImageCompare::ComputePSNR(const FImage& A, const FImage& B)
+{
+    if (A.Width != B.Width || A.Height != B.Height || A.Pixels.empty())
+    {
+        return 0.0;
+    }
+
+    // Alpha is ignored, render targets don't agree on what they leave there
+    uint64_t SquaredError = 0;
+    for (size_t Index = 0; Index < A.Pixels.size(); Index += 4)
+    {
+        for (uint32_t Channel = 0; Channel < 3; ++Channel)
+        {
+            const int32_t Difference = A.Pixels[Index + Channel] - B.Pixels[Index + Channel];
+            SquaredError += static_cast<uint64_t>(Difference * Difference);
+        }
+    }
+    if (SquaredError == 0)
+    {
+        return std::numeric_limits<double>::infinity();
+    }
+    const double MeanSquaredError = static_cast<double>(SquaredError) / (A.Pixels.size() / 4 * 3);
+    return 10.0 * std::log10(255.0 * 255.0 / MeanSquaredError);
+}
+
+double FImageCompare::ComputeSSIM(const FImage& A, const FImage& B)
+{
+    if (A.Width != B.Width || A.Height != B.Height || A.Pixels.empty())
+    {
+        return 0.0;
+    }
+
+    std::vector<float> LumaA, LumaB;
+    ToLuma(A, LumaA);
+    ToLuma(B, LumaB);
+
+    // Standard constants for 8 bit data, K1 = 0.01 and K2 = 0.03
+    const double C1 = (0.01 * 255.0) * (0.01 * 255.0);
+    const double C2 = (0.03 * 255.0) * (0.03 * 255.0);
+    const uint32_t Window = std::min({SSIMWindow, A.Width, A.Height});
+
+    double SSIMSum = 0.0;
+    uint32_t WindowNum = 0;
+    for (uint32_t Y = 0; Y + Window <= A.Height; Y += SSIMStride)
+    {
+        for (uint32_t X = 0; X + Window <= A.Width; X += SSIMStride)
+        {
+            double SumA = 0.0, SumB = 0.0, SumAA = 0.0, SumBB = 0.0, SumAB = 0.0;
+            for (uint32_t WindowY = 0; WindowY < Window; ++WindowY)
+            {
+                const size_t Row = static_cast<size_t>(Y + WindowY) * A.Width + X;
+                for (uint32_t WindowX = 0; WindowX < Window; ++WindowX)
+                {
+                    const double ValueA = LumaA[Row + WindowX];
+                    const double ValueB = LumaB[Row + WindowX];
+                    SumA += ValueA;
+                    SumB += ValueB;
+                    SumAA += ValueA * ValueA;
+                    SumBB += ValueB * ValueB;
+                    SumAB += ValueA * ValueB;
+                }
+            }
+
+            const double Count = static_cast<double>(Window) * Window;
+            const double MeanA = SumA / Count;
+            const double MeanB = SumB / Count;
+            const double VarianceA = SumAA / Count - MeanA * MeanA;
+            const double VarianceB = SumBB / Count - MeanB * MeanB;
+            const double Covariance = SumAB / Count - MeanA * MeanB;
+            SSIMSum += ((2.0 * MeanA * MeanB + C1) * (2.0 * Covariance + C2)) / ((MeanA * MeanA + MeanB * MeanB + C1) * (VarianceA + VarianceB + C2));
+            ++WindowNum;
+        }
+    }
+    return WindowNum > 0 ? SSIMSum / WindowNum : 1.0;
+}
+
+bool FImageCompare::SaveTga(const std::string& FilePath, const FImage& Image)
+{
+    std::ofstream File(FilePath, std::ios::binary | std::ios::out);
+    if (!File.is_open())
+    {
+        return false;
+    }
+
+    // Uncompressed true color, 8 alpha bits, top left origin
+    uint8_t Header[18] = {};
+    Header[2] = 2;
+    Header[12] = static_cast<uint8_t>(Image.Width & 0xFF);
+    Header[13] = static_cast<uint8_t>(Image.Width >> 8);
+    Header[14] = static_cast<uint8_t>(Image.Height & 0xFF);
+    Header[15] = static_cast<uint8_t>(Image.Height >> 8);
+    Header[16] = 32;
+    Header[17] = 0x28;
+    File.write(reinterpret_cast<const char*>(Header), sizeof(Header));
+
+    std::vector<uint8_t> Pixels(Image.Pixels.size());
+    for (size_t Index = 0; Index < Pixels.size(); Index += 4)
+    {
+        Pixels[Index + 0] = Image.Pixels[Index + 2];
+        Pixels[Index + 1] = Image.Pixels[Index + 1];
+        Pixels[Index + 2] = Image.Pixels[Index + 0];
+        Pixels[Index + 3] = Image.Pixels[Index + 3];
+    }
+    File.write(reinterpret_cast<const char*>(Pixels.data()), Pixels.size());
+    return File.good();
+}
@@ -0,0 +1,39 @@
+﻿#pragma once
+#include <cstdint>
+#include <string>
+#include "Engine/ImageDecoder.h"
+
+struct FImageCompareThresholds
+{
+    // Lower bound over the RGB channels, identical images report infinity
+    double MinPSNR = 40.0;
+    // Mean structural similarity of the luma, 1 is identical
+    double MinSSIM = 0.98;
+    // Per channel difference a pixel may have before it counts as different
+    uint32_t PixelTolerance = 2;
+    double MaxDifferentPixelRatio = 0.001;
+};
+
+struct FImageCompareResult
+{
+    bool bSizeMatches = false;
+    double PSNR = 0.0;
+    double SSIM = 0.0;
+    uint32_t MaxDifference = 0;
+    uint64_t DifferentPixels = 0;
+    bool bPassed = false;
+};
+
+// Golden image comparison for render regression captures. PSNR catches broad shifts, SSIM structural ones
+// such as a missing object, the pixel count isolated outliers.
+class FImageCompare
+{
+public:
+    // OutDiff, when given, gets the absolute difference scaled up so small errors show
+    static FImageCompareResult Compare(const FImage& Golden, const FImage& Image, const FImageCompareThresholds& Thresholds, FImage* OutDiff = nullptr);
+    static double ComputePSNR(const FImage& A, const FImage& B);
+    static double ComputeSSIM(const FImage& A, const FImage& B);
+
+    // Uncompressed 32 bit TGA, what FImageDecoder reads back for goldens
+    static bool SaveTga(const std::string& FilePath, const FImage& Image);
+};
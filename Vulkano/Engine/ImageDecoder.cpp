@@ -0,0 +1,691 @@
+﻿#include "ImageDecoder.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "Core/Paths.h"
+#include "Core/VulkanoLog.h"
+
+namespace
+{
+    uint32_t ReadBigEndian32(const uint8_t* Data)
+    {
+        return (uint32_t(Data[0]) << 24) | (uint32_t(Data[1]) << 16) | (uint32_t(Data[2]) << 8) | uint32_t(Data[3]);
+    }
+
+    uint32_t ReadLittleEndian16(const uint8_t* Data)
+    {
+        return uint32_t(Data[0]) | (uint32_t(Data[1]) << 8);
+    }
+
+    uint32_t ReadLittleEndian32(const uint8_t* Data)
+    {
+        return uint32_t(Data[0]) | (uint32_t(Data[1]) << 8) | (uint32_t(Data[2]) << 16) | (uint32_t(Data[3]) << 24);
+    }
+
+    // Deflate bit stream, least significant bit first
+    struct FBitReader
+    {
+        const uint8_t* Data = nullptr;
+        size_t Size = 0;
+        size_t Position = 0;
+        uint32_t BitBuffer = 0;
+        uint32_t BitCount = 0;
+        bool bOverflow = false;
+
+        uint32_t Bits(uint32_t Count)
+        {
+            uint32_t Value = BitBuffer;
+            while (BitCount < Count)
+            {
+                if (Position >= Size)
+                {
+                    bOverflow = true;
+                    return 0;
+                }
+                Value |= uint32_t(Data[Position++]) << BitCount;
+                BitCount += 8;
+            }
+            BitBuffer = Value >> Count;
+            BitCount -= Count;
+            return Value & ((1u << Count) - 1);
+        }
+    };
+
+    // Canonical Huffman code as code counts per length and symbols in code order
+    struct FHuffman
+    {
+        uint16_t Counts[16];
+        uint16_t Symbols[288];
+    };
+
+    void BuildHuffman(FHuffman& Huffman, const uint8_t* Lengths, uint32_t Num)
+    {
+        memset(Huffman.Counts, 0, sizeof(Huffman.Counts));
+        for (uint32_t Symbol = 0; Symbol < Num; ++Symbol)
+        {
+            Huffman.Counts[Lengths[Symbol]]++;
+        }
+        uint16_t Offsets[16];
+        Offsets[1] = 0;
+        for (uint32_t Length = 1; Length < 15; ++Length)
+        {
+            Offsets[Length + 1] = Offsets[Length] + Huffman.Counts[Length];
+        }
+        for (uint32_t Symbol = 0; Symbol < Num; ++Symbol)
+        {
+            if (Lengths[Symbol] != 0)
+            {
+                Huffman.Symbols[Offsets[Lengths[Symbol]]++] = static_cast<uint16_t>(Symbol);
+            }
+        }
+    }
+
+    int DecodeSymbol(FBitReader& Reader, const FHuffman& Huffman)
+    {
+        int Code = 0;
+        int First = 0;
+        int Index = 0;
+        for (uint32_t Length = 1; Length < 16; ++Length)
+        {
+            Code |= Reader.Bits(1);
+            const int Count = Huffman.Counts[Length];
+            if (Code - Count < First)
+            {
+                return Huffman.Symbols[Index + (Code - First)];
+            }
+            Index += Count;
+            First += Count;
+            First <<= 1;
+            Code <<= 1;
+        }
+        return -1;
+    }
+
+    constexpr uint16_t LengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    constexpr uint8_t LengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    constexpr uint16_t DistanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+    constexpr uint8_t DistanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+    bool InflateCodes(FBitReader& Reader, const FHuffman& LengthCodes, const FHuffman& DistanceCodes, std::vector<uint8_t>& Out)
+    {
+        for (;;)
+        {
+            const int Symbol = DecodeSymbol(Reader, LengthCodes);
+            if (Symbol < 0 || Reader.bOverflow)
+            {
+                return false;
+            }
+            if (Symbol < 256)
+            {
+                Out.push_back(static_cast<uint8_t>(Symbol));
+                continue;
+            }
+            if (Symbol == 256)
+            {
+                return true;
+            }
+
+            const int LengthSymbol = Symbol - 257;
+            if (LengthSymbol >= 29)
+            {
+                return false;
+            }
+            const uint32_t Length = LengthBase[LengthSymbol] + Reader.Bits(LengthExtra[LengthSymbol]);
+            const int DistanceSymbol = DecodeSymbol(Reader, DistanceCodes);
+            if (DistanceSymbol < 0 || DistanceSymbol >= 30)
+            {
+                return false;
+            }
+            const size_t Distance = DistanceBase[DistanceSymbol] + Reader.Bits(DistanceExtra[DistanceSymbol]);
+            if (Distance > Out.size() || Reader.bOverflow)
+            {
+                return false;
+            }
+            // Byte by byte, matches may overlap the bytes they produce
+            const size_t Start = Out.size() - Distance;
+            for (uint32_t Index = 0; Index < Length; ++Index)
+            {
+                Out.push_back(Out[Start + Index]);
+            }
+        }
+    }
+
+    // zlib wrapped deflate, the adler checksum is not verified
+    bool Inflate(const uint8_t* Data, size_t Size, std::vector<uint8_t>& Out)
+    {
+        if (Size < 2 || (Data[0] & 0x0F) != 8 || ((Data[0] << 8) | Data[1]) % 31 != 0)
+        {
+            return false;
+        }
+
+        FBitReader Reader;
+        Reader.Data = Data + 2;
+        Reader.Size = Size - 2;
+
+        uint32_t bFinal = 0;
+        do
+        {
+            bFinal = Reader.Bits(1);
+            const uint32_t Type = Reader.Bits(2);
+            if (Type == 0)
+            {
+                // Stored block, starts at the next byte
+                Reader.BitBuffer = 0;
+                Reader.BitCount = 0;
+                if (Reader.Position + 4 > Reader.Size)
+                {
+                    return false;
+                }
+                const uint32_t Length = ReadLittleEndian16(Reader.Data + Reader.Position);
+                const uint32_t InvLength = ReadLittleEndian16(Reader.Data + Reader.Position + 2);
+                Reader.Position += 4;
+                if (Length != (~InvLength & 0xFFFF) || Reader.Position + Length > Reader.Size)
+                {
+                    return false;
+                }
+                Out.insert(Out.end(), Reader.Data + Reader.Position, Reader.Data + Reader.Position + Length);
+                Reader.Position += Length;
+            }
+            else if (Type == 1)
+            {
+                uint8_t Lengths[288 + 30];
+                memset(Lengths, 8, 144);
+                memset(Lengths + 144, 9, 112);
+                memset(Lengths + 256, 7, 24);
+                memset(Lengths + 280, 8, 8);
+                memset(Lengths + 288, 5, 30);
+                FHuffman LengthCodes, DistanceCodes;
+                BuildHuffman(LengthCodes, Lengths, 288);
+                BuildHuffman(DistanceCodes, Lengths + 288, 30);
+                if (!InflateCodes(Reader, LengthCodes, DistanceCodes, Out))
+                {
+                    return false;
+                }
+            }
+            else if (Type == 2)
+            {
+                const uint32_t LengthNum = Reader.Bits(5) + 257;
+                const uint32_t DistanceNum = Reader.Bits(5) + 1;
+                const uint32_t CodeLengthNum = Reader.Bits(4) + 4;
+                if (LengthNum > 286 || DistanceNum > 30)
+                {
+                    return false;
+                }
+
+                static constexpr uint8_t CodeLengthOrder[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+                uint8_t Lengths[288 + 30] = {};
+                for (uint32_t Index = 0; Index < CodeLengthNum; ++Index)
+                {
+                    Lengths[CodeLengthOrder[Index]] = static_cast<uint8_t>(Reader.Bits(3));
+                }
+                FHuffman CodeLengthCodes;
+                BuildHuffman(CodeLengthCodes, Lengths, 19);
+
+                memset(Lengths, 0, sizeof(Lengths));
+                uint32_t Index = 0;
+                while (Index < LengthNum + DistanceNum)
+                {
+                    const int Symbol = DecodeSymbol(Reader, CodeLengthCodes);
+                    if (Symbol < 0 || Reader.bOverflow)
+                    {
+                        return false;
+                    }
+                    if (Symbol < 16)
+                    {
+                        Lengths[Index++] = static_cast<uint8_t>(Symbol);
+                        continue;
+                    }
+
+                    uint8_t Repeated = 0;
+                    uint32_t Repeat = 0;
+                    if (Symbol == 16)
+                    {
+                        if (Index == 0)
+                        {
+                            return false;
+                        }
+                        Repeated = Lengths[Index - 1];
+                        Repeat = 3 + Reader.Bits(2);
+                    }
+                    else if (Symbol == 17)
+                    {
+                        Repeat = 3 + Reader.Bits(3);
+                    }
+                    else
+                    {
+                        Repeat = 11 + Reader.Bits(7);
+                    }
+                    if (Index + Repeat > LengthNum + DistanceNum)
+                    {
+                        return false;
+                    }
+                    memset(Lengths + Index, Repeated, Repeat);
+                    Index += Repeat;
+                }
+
+                FHuffman LengthCodes, DistanceCodes;
+                BuildHuffman(LengthCodes, Lengths, LengthNum);
+                BuildHuffman(DistanceCodes, Lengths + LengthNum, DistanceNum);
+                if (!InflateCodes(Reader, LengthCodes, DistanceCodes, Out))
+                {
+                    return false;
+                }
+            }
+            else
+            {
+                return false;
+            }
+        }
+        while (!bFinal && !Reader.bOverflow);
+
+        return !Reader.bOverflow;
+    }
+
+    uint8_t Paeth(uint8_t A, uint8_t B, uint8_t C)
+    {
+        const int P = int(A) + int(B) - int(C);
+        const int PA = std::abs(P - int(A));
+        const int PB = std::abs(P - int(B));
+        const int PC = std::abs(P - int(C));
+        if (PA <= PB && PA <= PC)
+        {
+            return A;
+        }
+        return PB <= PC ? B : C;
+    }
+}
+
+bool FImageDecoder::Decode(const std::string& FilePath, FImage& OutImage)
+{
+    const std::string Data = FPaths::LoadFileToString(FilePath);
+    if (Data.empty())
+    {
+        VK_LOG(LOG_WARNING, "FImageDecoder::Decode Could not read %s", FilePath.c_str());
+        return false;
+    }
+    if (!Decode(reinterpret_cast<const uint8_t*>(Data.data()), Data.size(), OutImage))
+    {
+        VK_LOG(LOG_WARNING, "FImageDecoder::Decode Unsupported or corrupt image %s", FilePath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool FImageDecoder::Decode(const uint8_t* Data, size_t Size, FImage& OutImage)
+{
+    static constexpr uint8_t PngSignature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    if (Size >= 8 && memcmp(Data, PngSignature, 8) == 0)
+    {
+        return DecodePng(Data, Size, OutImage);
+    }
+    if (Size >= 2 && Data[0] == 'B' && Data[1] == 'M')
+    {
+        return DecodeBmp(Data, Size, OutImage);
+    }
+    // TGA has no signature, it is the fallback
+    return DecodeTga(Data, Size, OutImage);
+}
+
+bool FImageDecoder::DecodePng(const uint8_t* Data, size_t Size, FImage& OutImage)
+{
+    uint32_t Width = 0, Height = 0, BitDepth = 0, ColorType = 0, Interlace = 0;
+    std::vector<uint8_t> Compressed;
+    uint8_t Palette[256][4] = {};
+    uint32_t PaletteSize = 0;
+    bool bColorKey = false;
+    uint16_t ColorKey[3] = {};
+
+    size_t Position = 8;
+    while (Position + 12 <= Size)
+    {
+        const uint32_t Length = ReadBigEndian32(Data + Position);
+        const uint8_t* Type = Data + Position + 4;
+        const uint8_t* Chunk = Data + Position + 8;
+        if (Length > Size - Position - 12)
+        {
+            return false;
+        }
+
+        if (memcmp(Type, "IHDR", 4) == 0 && Length >= 13)
+        {
+            Width = ReadBigEndian32(Chunk);
+            Height = ReadBigEndian32(Chunk + 4);
+            BitDepth = Chunk[8];
+            ColorType = Chunk[9];
+            Interlace = Chunk[12];
+        }
+        else if (memcmp(Type, "PLTE", 4) == 0)
+        {
+            PaletteSize = std::min(Length / 3, 256u);
+            for (uint32_t Index = 0; Index < PaletteSize; ++Index)
+            {
+                Palette[Index][0] = Chunk[Index * 3];
+                Palette[Index][1] = Chunk[Index * 3 + 1];
+                Palette[Index][2] = Chunk[Index * 3 + 2];
+                Palette[Index][3] = 255;
+            }
+        }
+        else if (memcmp(Type, "tRNS", 4) == 0)
+        {
+            if (ColorType == 3)
+            {
+                for (uint32_t Index = 0; Index < std::min(Length, 256u); ++Index)
+                {
+                    Palette[Index][3] = Chunk[Index];
+                }
+            }
+            else if (ColorType == 0 && Length >= 2)
+            {
+                bColorKey = true;
+                ColorKey[0] = static_cast<uint16_t>((Chunk[0] << 8) | Chunk[1]);
+            }
+            else if (ColorType == 2 && Length >= 6)
+            {
+                bColorKey = true;
+                for (uint32_t Channel = 0; Channel < 3; ++Channel)
+                {
+                    ColorKey[Channel] = static_cast<uint16_t>((Chunk[Channel * 2] << 8) | Chunk[Channel * 2 + 1]);
+                }
+            }
+        }
+        else if (memcmp(Type, "IDAT", 4) == 0)
+        {
+            Compressed.insert(Compressed.end(), Chunk, Chunk + Length);
+        }
+        else if (memcmp(Type, "IEND", 4) == 0)
+        {
+            break;
+        }
+        Position += Length + 12;
+    }
+
+    uint32_t Channels = 0;
+    switch (ColorType)
+    {
+    case 0: Channels = 1; break;
+    case 2: Channels = 3; break;
+    case 3: Channels = 1; break;
+    case 4: Channels = 2; break;
+    case 6: Channels = 4; break;
+    default: return false;
+    }
+    const bool bValidDepth = BitDepth == 8 || BitDepth == 16 || ((ColorType == 0 || ColorType == 3) && BitDepth < 8 && BitDepth > 0 && (8 % BitDepth) == 0);
+    if (Width == 0 || Height == 0 || Interlace != 0 || !bValidDepth || (ColorType == 3 && PaletteSize == 0))
+    {
+        return false;
+    }
+
+    std::vector<uint8_t> Raw;
+    if (!Inflate(Compressed.data(), Compressed.size(), Raw))
+    {
+        return false;
+    }
+
+    const uint32_t BitsPerPixel = Channels * BitDepth;
+    const size_t Stride = (static_cast<size_t>(Width) * BitsPerPixel + 7) / 8;
+    const size_t FilterBytes = std::max(1u, BitsPerPixel / 8);
+    if (Raw.size() < (Stride + 1) * Height)
+    {
+        return false;
+    }
+
+    // Undo the per-row filters in place, the filter byte is left in front of each row
+    for (uint32_t Row = 0; Row < Height; ++Row)
+    {
+        uint8_t* Line = &Raw[Row * (Stride + 1) + 1];
+        const uint8_t* Previous = Row > 0 ? &Raw[(Row - 1) * (Stride + 1) + 1] : nullptr;
+        const uint8_t Filter = Line[-1];
+        for (size_t Index = 0; Index < Stride; ++Index)
+        {
+            const uint8_t Left = Index >= FilterBytes ? Line[Index - FilterBytes] : 0;
+            const uint8_t Up = Previous ? Previous[Index] : 0;
+            const uint8_t UpLeft = Previous && Index >= FilterBytes ? Previous[Index - FilterBytes] : 0;
+            switch (Filter)
+            {
+            case 0: break;
+            case 1: Line[Index] += Left; break;
+            case 2: Line[Index] += Up; break;
+            case 3: Line[Index] += static_cast<uint8_t>((uint32_t(Left) + uint32_t(Up)) / 2); break;
+            case 4: Line[Index] += Paeth(Left, Up, UpLeft); break;
+            default: return false;
+            }
+        }
+    }
+
+    OutImage.Width = Width;
+    OutImage.Height = Height;
+    OutImage.Pixels.resize(static_cast<size_t>(Width) * Height * 4);
+    const uint32_t MaxValue = (1u << BitDepth) - 1;
+    for (uint32_t Row = 0; Row < Height; ++Row)
+    {
+        const uint8_t* Line = &Raw[Row * (Stride + 1) + 1];
+        uint8_t* Out = &OutImage.Pixels[static_cast<size_t>(Row) * Width * 4];
+        for (uint32_t Column = 0; Column < Width; ++Column)
+        {
+            uint16_t Samples[4] = {};
+            for (uint32_t Channel = 0; Channel < Channels; ++Channel)
+            {
+                const size_t Sample = static_cast<size_t>(Column) * Channels + Channel;
+                if (BitDepth == 16)
+                {
+                    Samples[Channel] = static_cast<uint16_t>((Line[Sample * 2] << 8) | Line[Sample * 2 + 1]);
+                }
+                else if (BitDepth == 8)
+                {
+                    Samples[Channel] = Line[Sample];
+                }
+                else
+                {
+                    const size_t Bit = Sample * BitDepth;
+                    Samples[Channel] = static_cast<uint16_t>((Line[Bit / 8] >> (8 - BitDepth - Bit % 8)) & MaxValue);
+                }
+            }
+
+            auto ToByte = [&](uint16_t Value) -> uint8_t
+            {
+                if (BitDepth == 16)
+                {
+                    return static_cast<uint8_t>(Value >> 8);
+                }
+                return static_cast<uint8_t>(Value * 255 / MaxValue);
+            };
+            uint8_t* Pixel = Out + Column * 4;
+            switch (ColorType)
+            {
+            case 0:
+                Pixel[0] = Pixel[1] = Pixel[2] = ToByte(Samples[0]);
+                Pixel[3] = bColorKey && Samples[0] == ColorKey[0] ? 0 : 255;
+                break;
+            case 2:
+                Pixel[0] = ToByte(Samples[0]);
+                Pixel[1] = ToByte(Samples[1]);
+                Pixel[2] = ToByte(Samples[2]);
+                Pixel[3] = bColorKey && Samples[0] == ColorKey[0] && Samples[1] == ColorKey[1] && Samples[2] == ColorKey[2] ? 0 : 255;
+                break;
+            case 3:
+                memcpy(Pixel, Palette[Samples[0] & 0xFF], 4);
+                break;
+            case 4:
+                Pixel[0] = Pixel[1] = Pixel[2] = ToByte(Samples[0]);
+                Pixel[3] = ToByte(Samples[1]);
+                break;
+            case 6:
+                for (uint32_t Channel = 0; Channel < 4; ++Channel)
+                {
+                    Pixel[Channel] = ToByte(Samples[Channel]);
+                }
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+bool FImageDecoder::DecodeTga(const uint8_t* Data, size_t Size, FImage& OutImage)
+{
+    if (Size < 18)
+    {
+        return false;
+    }
+    const uint32_t IdLength = Data[0];
+    const uint32_t ColorMapType = Data[1];
+    const uint32_t ImageType = Data[2];
+    const uint32_t ColorMapLength = ReadLittleEndian16(Data + 5);
+    const uint32_t ColorMapDepth = Data[7];
+    const uint32_t Width = ReadLittleEndian16(Data + 12);
+    const uint32_t Height = ReadLittleEndian16(Data + 14);
+    const uint32_t BitsPerPixel = Data[16];
+    const bool bTopDown = (Data[17] & 0x20) != 0;
+
+    const bool bGray = ImageType == 3 || ImageType == 11;
+    const bool bRle = ImageType == 10 || ImageType == 11;
+    if ((ImageType != 2 && ImageType != 3 && ImageType != 10 && ImageType != 11) || Width == 0 || Height == 0)
+    {
+        return false;
+    }
+    if ((bGray && BitsPerPixel != 8) || (!bGray && BitsPerPixel != 24 && BitsPerPixel != 32))
+    {
+        return false;
+    }
+
+    const uint32_t BytesPerPixel = BitsPerPixel / 8;
+    size_t Position = 18 + IdLength + (ColorMapType == 1 ? ColorMapLength * ((ColorMapDepth + 7) / 8) : 0);
+    const size_t PixelNum = static_cast<size_t>(Width) * Height;
+
+    OutImage.Width = Width;
+    OutImage.Height = Height;
+    OutImage.Pixels.resize(PixelNum * 4);
+
+    auto StorePixel = [&](size_t Index, const uint8_t* Source)
+    {
+        // Rows are stored bottom up unless the descriptor says otherwise
+        const size_t Row = Index / Width;
+        const size_t Column = Index % Width;
+        uint8_t* Pixel = &OutImage.Pixels[((bTopDown ? Row : Height - 1 - Row) * Width + Column) * 4];
+        if (bGray)
+        {
+            Pixel[0] = Pixel[1] = Pixel[2] = Source[0];
+            Pixel[3] = 255;
+        }
+        else
+        {
+            Pixel[0] = Source[2];
+            Pixel[1] = Source[1];
+            Pixel[2] = Source[0];
+            Pixel[3] = BytesPerPixel == 4 ? Source[3] : 255;
+        }
+    };
+
+    size_t Index = 0;
+    while (Index < PixelNum)
+    {
+        uint32_t Run = 1;
+        bool bRepeat = false;
+        if (bRle)
+        {
+            if (Position >= Size)
+            {
+                return false;
+            }
+            const uint8_t Packet = Data[Position++];
+            Run = (Packet & 0x7F) + 1;
+            bRepeat = (Packet & 0x80) != 0;
+        }
+        if (bRepeat)
+        {
+            if (Position + BytesPerPixel > Size)
+            {
+                return false;
+            }
+            for (uint32_t Repeat = 0; Repeat < Run && Index < PixelNum; ++Repeat)
+            {
+                StorePixel(Index++, Data + Position);
+            }
+            Position += BytesPerPixel;
+        }
+        else
+        {
+            for (uint32_t Repeat = 0; Repeat < Run && Index < PixelNum; ++Repeat)
+            {
+                if (Position + BytesPerPixel > Size)
+                {
+                    return false;
+                }
+                StorePixel(Index++, Data + Position);
+                Position += BytesPerPixel;
+            }
+        }
+    }
+    return true;
+}
+
+bool FImageDecoder::DecodeBmp(const uint8_t* Data, size_t Size, FImage& OutImage)
+{
+    if (Size < 54)
+    {
+        return false;
+    }
+    const uint32_t PixelOffset = ReadLittleEndian32(Data + 10);
+    const uint32_t HeaderSize = ReadLittleEndian32(Data + 14);
+    const int32_t Width = static_cast<int32_t>(ReadLittleEndian32(Data + 18));
+    const int32_t Height = static_cast<int32_t>(ReadLittleEndian32(Data + 22));
+    const uint32_t BitsPerPixel = ReadLittleEndian16(Data + 28);
+    const uint32_t Compression = ReadLittleEndian32(Data + 30);
+
+    // Uncompressed 24 bit or 32 bit BGRA, bit fields only with the standard masks
+    if (Width <= 0 || Height == 0 || (BitsPerPixel != 24 && BitsPerPixel != 32))
+    {
+        return false;
+    }
+    if (Compression == 3)
+    {
+        if (BitsPerPixel != 32 || HeaderSize < 52 || ReadLittleEndian32(Data + 54) != 0x00FF0000 ||
+            ReadLittleEndian32(Data + 58) != 0x0000FF00 || ReadLittleEndian32(Data + 62) != 0x000000FF)
+        {
+            return false;
+        }
+    }
+    else if (Compression != 0)
+    {
+        return false;
+    }
+
+    const uint32_t AbsHeight = static_cast<uint32_t>(std::abs(Height));
+    const uint32_t BytesPerPixel = BitsPerPixel / 8;
+    const size_t Stride = (static_cast<size_t>(Width) * BytesPerPixel + 3) & ~size_t(3);
+    if (PixelOffset + Stride * AbsHeight > Size)
+    {
+        return false;
+    }
+
+    OutImage.Width = static_cast<uint32_t>(Width);
+    OutImage.Height = AbsHeight;
+    OutImage.Pixels.resize(static_cast<size_t>(Width) * AbsHeight * 4);
+    bool bAnyAlpha = false;
+    for (uint32_t Row = 0; Row < AbsHeight; ++Row)
+    {
+        // Positive heights are stored bottom up
+        const uint8_t* Line = Data + PixelOffset + Stride * (Height > 0 ? AbsHeight - 1 - Row : Row);
+        uint8_t* Out = &OutImage.Pixels[static_cast<size_t>(Row) * Width * 4];
+        for (int32_t Column = 0; Column < Width; ++Column)
+        {
+            const uint8_t* Source = Line + Column * BytesPerPixel;
+            Out[Column * 4 + 0] = Source[2];
+            Out[Column * 4 + 1] = Source[1];
+            Out[Column * 4 + 2] = Source[0];
+            Out[Column * 4 + 3] = BytesPerPixel == 4 ? Source[3] : 255;
+            bAnyAlpha |= BytesPerPixel == 4 && Source[3] != 0;
+        }
+    }
+
+    // Plain 32 bit bitmaps usually leave the fourth byte at zero
+    if (BytesPerPixel == 4 && Compression == 0 && !bAnyAlpha)
+    {
+        for (size_t Index = 3; Index < OutImage.Pixels.size(); Index += 4)
+        {
+            OutImage.Pixels[Index] = 255;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,26 @@
+﻿#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 8 bit RGBA pixels, rows top to bottom
+struct FImage
+{
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    std::vector<uint8_t> Pixels;
+};
+
+// Source image decoding for the texture cooker: PNG (non interlaced, any color type), TGA (raw and RLE) and BMP (24 / 32 bit).
+// 16 bit channels are reduced to 8 bit.
+class FImageDecoder
+{
+public:
+    static bool Decode(const std::string& FilePath, FImage& OutImage);
+    static bool Decode(const uint8_t* Data, size_t Size, FImage& OutImage);
+
+private:
+    static bool DecodePng(const uint8_t* Data, size_t Size, FImage& OutImage);
+    static bool DecodeTga(const uint8_t* Data, size_t Size, FImage& OutImage);
+    static bool DecodeBmp(const uint8_t* Data, size_t Size, FImage& OutImage);
+};
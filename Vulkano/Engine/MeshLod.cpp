@@ -0,0 +1,487 @@
+﻿#include "MeshLod.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+#include "Core/Assertion.h"
+
+namespace
+{
+    constexpr uint32_t CookedMeshMagic = 0x444C4B56; // "VKLD"
+    constexpr uint32_t CookedMeshVersion = 1;
+
+    // Symmetric 4x4 plane quadric, doubles so small errors don't cancel out
+    struct FQuadric
+    {
+        double A00 = 0.0, A01 = 0.0, A02 = 0.0, A03 = 0.0;
+        double A11 = 0.0, A12 = 0.0, A13 = 0.0;
+        double A22 = 0.0, A23 = 0.0;
+        double A33 = 0.0;
+        // Summed triangle area, turns the area weighted error back into a squared distance
+        double Weight = 0.0;
+
+        void AddPlane(const glm::dvec3& Normal, double Distance, double Area)
+        {
+            A00 += Area * Normal.x * Normal.x; A01 += Area * Normal.x * Normal.y; A02 += Area * Normal.x * Normal.z; A03 += Area * Normal.x * Distance;
+            A11 += Area * Normal.y * Normal.y; A12 += Area * Normal.y * Normal.z; A13 += Area * Normal.y * Distance;
+            A22 += Area * Normal.z * Normal.z; A23 += Area * Normal.z * Distance;
+            A33 += Area * Distance * Distance;
+            Weight += Area;
+        }
+
+        void Add(const FQuadric& Other)
+        {
+            A00 += Other.A00; A01 += Other.A01; A02 += Other.A02; A03 += Other.A03;
+            A11 += Other.A11; A12 += Other.A12; A13 += Other.A13;
+            A22 += Other.A22; A23 += Other.A23;
+            A33 += Other.A33;
+            Weight += Other.Weight;
+        }
+
+        double Evaluate(const glm::dvec3& P) const
+        {
+            const double Error =
+                A00 * P.x * P.x + 2.0 * A01 * P.x * P.y + 2.0 * A02 * P.x * P.z + 2.0 * A03 * P.x +
+                A11 * P.y * P.y + 2.0 * A12 * P.y * P.z + 2.0 * A13 * P.y +
+                A22 * P.z * P.z + 2.0 * A23 * P.z +
+                A33;
+            return Error > 0.0 ? Error : 0.0;
+        }
+    };
+
+    struct FCollapse
+    {
+        uint32_t From;
+        uint32_t To;
+        double Cost;
+    };
+
+    struct FPositionKey
+    {
+        uint32_t Bits[3];
+
+        bool operator==(const FPositionKey& Other) const
+        {
+            return Bits[0] == Other.Bits[0] && Bits[1] == Other.Bits[1] && Bits[2] == Other.Bits[2];
+        }
+    };
+
+    struct FPositionKeyHash
+    {
+        size_t operator()(const FPositionKey& Key) const
+        {
+            return (Key.Bits[0] * 73856093u) ^ (Key.Bits[1] * 19349663u) ^ (Key.Bits[2] * 83492791u);
+        }
+    };
+
+    double AttributeDistance(const FStaticMeshVertex& A, const FStaticMeshVertex& B)
+    {
+        const glm::vec3 Normal = A.Normal - B.Normal;
+        const glm::vec2 UV = A.UV0 - B.UV0;
+        const glm::vec3 Color = A.Color - B.Color;
+        return glm::dot(Normal, Normal) + glm::dot(UV, UV) + glm::dot(Color, Color);
+    }
+
+    // Vertices that must stay: on open borders or sharing a position with another vertex (attribute seams)
+    void FindLockedVertices(const std::vector<FStaticMeshVertex>& Vertices, const std::vector<uint32_t>& Indices, std::vector<uint8_t>& OutLocked)
+    {
+        OutLocked.assign(Vertices.size(), 0);
+
+        std::unordered_map<FPositionKey, uint32_t, FPositionKeyHash> FirstVertex;
+        FirstVertex.reserve(Vertices.size());
+        for (uint32_t Index = 0; Index < Vertices.size(); ++Index)
+        {
+            FPositionKey Key;
+            memcpy(Key.Bits, &Vertices[Index].Position, sizeof(Key.Bits));
+            auto Result = FirstVertex.emplace(Key, Index);
+            if (!Result.second)
+            {
+                OutLocked[Index] = 1;
+                OutLocked[Result.first->second] = 1;
+            }
+        }
+
+        std::unordered_map<uint64_t, uint32_t> EdgeUses;
+        EdgeUses.reserve(Indices.size());
+        for (size_t Index = 0; Index < Indices.size(); Index += 3)
+        {
+            for (uint32_t Corner = 0; Corner < 3; ++Corner)
+            {
+                const uint32_t A = Indices[Index + Corner];
+                const uint32_t B = Indices[Index + (Corner + 1) % 3];
+                const uint64_t Key = (static_cast<uint64_t>(std::min(A, B)) << 32) | std::max(A, B);
+                EdgeUses[Key]++;
+            }
+        }
+        for (const auto& Edge : EdgeUses)
+        {
+            if (Edge.second == 1)
+            {
+                OutLocked[Edge.first >> 32] = 1;
+                OutLocked[Edge.first & 0xFFFFFFFFu] = 1;
+            }
+        }
+    }
+
+    glm::dvec3 TriangleNormal(const glm::dvec3& A, const glm::dvec3& B, const glm::dvec3& C)
+    {
+        return glm::cross(B - A, C - A);
+    }
+}
+
+float FMeshSimplifier::Simplify(
+    const std::vector<FStaticMeshVertex>& Vertices,
+    const std::vector<uint32_t>& Indices,
+    uint32_t TargetIndexCount,
+    float MaxError,
+    float AttributeWeight,
+    std::vector<uint32_t>& OutIndices)
+{
+    checkf(Indices.size() % 3 == 0, "FMeshSimplifier::Simplify index count %zu is not a triangle list", Indices.size());
+    OutIndices = Indices;
+    if (Indices.size() <= TargetIndexCount || Vertices.empty())
+    {
+        return 0.0f;
+    }
+
+    // Work in a unit sized space so the attribute weight doesn't depend on the mesh scale
+    glm::vec3 Min = Vertices[0].Position;
+    glm::vec3 Max = Vertices[0].Position;
+    for (const FStaticMeshVertex& Vertex : Vertices)
+    {
+        Min = glm::min(Min, Vertex.Position);
+        Max = glm::max(Max, Vertex.Position);
+    }
+    const glm::vec3 Size = Max - Min;
+    const double Extent = std::max(std::max(Size.x, Size.y), std::max(Size.z, 1e-6f));
+    const double InvExtent = 1.0 / Extent;
+    const double MaxNormalizedError = MaxError * InvExtent;
+
+    const uint32_t VertexNum = static_cast<uint32_t>(Vertices.size());
+    std::vector<glm::dvec3> Positions(VertexNum);
+    for (uint32_t Index = 0; Index < VertexNum; ++Index)
+    {
+        Positions[Index] = glm::dvec3(Vertices[Index].Position - Min) * InvExtent;
+    }
+
+    std::vector<uint8_t> Locked;
+    FindLockedVertices(Vertices, Indices, Locked);
+
+    std::vector<FQuadric> Quadrics(VertexNum);
+    for (size_t Index = 0; Index < Indices.size(); Index += 3)
+    {
+        const uint32_t A = Indices[Index], B = Indices[Index + 1], C = Indices[Index + 2];
+        glm::dvec3 Normal = TriangleNormal(Positions[A], Positions[B], Positions[C]);
+        const double Length = glm::length(Normal);
+        if (Length <= 0.0)
+        {
+            continue;
+        }
+        Normal /= Length;
+        const double Distance = -glm::dot(Normal, Positions[A]);
+        const double Area = Length * 0.5;
+        Quadrics[A].AddPlane(Normal, Distance, Area);
+        Quadrics[B].AddPlane(Normal, Distance, Area);
+        Quadrics[C].AddPlane(Normal, Distance, Area);
+    }
+
+    std::vector<uint32_t> Remap(VertexNum);
+    std::vector<uint8_t> Touched(VertexNum);
+    std::vector<uint32_t> TriangleOffsets(VertexNum + 1);
+    std::vector<uint32_t> VertexTriangles;
+    std::vector<FCollapse> Collapses;
+    double ResultError = 0.0;
+
+    // Each pass sorts all edge collapses by cost and applies the cheapest ones that don't share a vertex
+    while (OutIndices.size() > TargetIndexCount)
+    {
+        const uint32_t TriangleNum = static_cast<uint32_t>(OutIndices.size() / 3);
+
+        // Vertex to triangle adjacency of the current mesh
+        std::fill(TriangleOffsets.begin(), TriangleOffsets.end(), 0);
+        for (uint32_t Index : OutIndices)
+        {
+            TriangleOffsets[Index + 1]++;
+        }
+        for (uint32_t Index = 0; Index < VertexNum; ++Index)
+        {
+            TriangleOffsets[Index + 1] += TriangleOffsets[Index];
+        }
+        VertexTriangles.resize(OutIndices.size());
+        {
+            std::vector<uint32_t> Cursor(TriangleOffsets.begin(), TriangleOffsets.end() - 1);
+            for (uint32_t Index = 0; Index < OutIndices.size(); ++Index)
+            {
+                VertexTriangles[Cursor[OutIndices[Index]]++] = Index / 3;
+            }
+        }
+
+        Collapses.clear();
+        for (uint32_t Triangle = 0; Triangle < TriangleNum; ++Triangle)
+        {
+            for (uint32_t Corner = 0; Corner < 3; ++Corner)
+            {
+                const uint32_t A = OutIndices[Triangle * 3 + Corner];
+                const uint32_t B = OutIndices[Triangle * 3 + (Corner + 1) % 3];
+                for (uint32_t Direction = 0; Direction < 2; ++Direction)
+                {
+                    const uint32_t From = Direction == 0 ? A : B;
+                    const uint32_t To = Direction == 0 ? B : A;
+                    if (Locked[From])
+                    {
+                        continue;
+                    }
+                    FQuadric Merged = Quadrics[From];
+                    Merged.Add(Quadrics[To]);
+                    const double Cost = Merged.Evaluate(Positions[To]) +
+                        AttributeWeight * Quadrics[From].Weight * AttributeDistance(Vertices[From], Vertices[To]);
+                    Collapses.push_back({From, To, Cost});
+                }
+            }
+        }
+        if (Collapses.empty())
+        {
+            break;
+        }
+        std::sort(Collapses.begin(), Collapses.end(), [](const FCollapse& A, const FCollapse& B) { return A.Cost < B.Cost; });
+
+        for (uint32_t Index = 0; Index < VertexNum; ++Index)
+        {
+            Remap[Index] = Index;
+        }
+        std::fill(Touched.begin(), Touched.end(), 0);
+
+        // Every collapse removes about two triangles, stop at the goal so the target isn't overshot
+        const uint32_t TriangleGoal = TriangleNum - TargetIndexCount / 3;
+        uint32_t RemovedTriangles = 0;
+        for (const FCollapse& Collapse : Collapses)
+        {
+            if (RemovedTriangles >= TriangleGoal)
+            {
+                break;
+            }
+            if (Touched[Collapse.From] || Touched[Collapse.To])
+            {
+                continue;
+            }
+
+            FQuadric Merged = Quadrics[Collapse.From];
+            Merged.Add(Quadrics[Collapse.To]);
+            const double Error = Merged.Weight > 0.0 ? std::sqrt(Merged.Evaluate(Positions[Collapse.To]) / Merged.Weight) : 0.0;
+            if (Error > MaxNormalizedError)
+            {
+                continue;
+            }
+
+            // Reject collapses that flip a remaining triangle around From
+            bool bFlips = false;
+            uint32_t Removed = 0;
+            for (uint32_t Offset = TriangleOffsets[Collapse.From]; Offset < TriangleOffsets[Collapse.From + 1] && !bFlips; ++Offset)
+            {
+                const uint32_t* Triangle = &OutIndices[VertexTriangles[Offset] * 3];
+                const uint32_t A = Remap[Triangle[0]], B = Remap[Triangle[1]], C = Remap[Triangle[2]];
+                if (A == B || B == C || C == A)
+                {
+                    continue;
+                }
+                if (A == Collapse.To || B == Collapse.To || C == Collapse.To)
+                {
+                    Removed++;
+                    continue;
+                }
+                const glm::dvec3 Before = TriangleNormal(Positions[A], Positions[B], Positions[C]);
+                const glm::dvec3 After = TriangleNormal(
+                    Positions[A == Collapse.From ? Collapse.To : A],
+                    Positions[B == Collapse.From ? Collapse.To : B],
+                    Positions[C == Collapse.From ? Collapse.To : C]);
+                bFlips = glm::dot(Before, After) <= 0.0;
+            }
+            if (bFlips)
+            {
+                continue;
+            }
+
+            Remap[Collapse.From] = Collapse.To;
+            Quadrics[Collapse.To] = Merged;
+            Touched[Collapse.From] = 1;
+            Touched[Collapse.To] = 1;
+            RemovedTriangles += Removed;
+            ResultError = std::max(ResultError, Error);
+        }
+        if (RemovedTriangles == 0)
+        {
+            break;
+        }
+
+        size_t Write = 0;
+        for (size_t Index = 0; Index < OutIndices.size(); Index += 3)
+        {
+            const uint32_t A = Remap[OutIndices[Index]], B = Remap[OutIndices[Index + 1]], C = Remap[OutIndices[Index + 2]];
+            if (A != B && B != C && C != A)
+            {
+                OutIndices[Write++] = A;
+                OutIndices[Write++] = B;
+                OutIndices[Write++] = C;
+            }
+        }
+        OutIndices.resize(Write);
+    }
+
+    return static_cast<float>(ResultError * Extent);
+}
+
+FStaticMeshLodChain FMeshSimplifier::BuildLodChain(
+    const std::vector<FStaticMeshVertex>& Vertices,
+    const std::vector<uint32_t>& Indices,
+    const FMeshLodSettings& Settings)
+{
+    FStaticMeshLodChain Chain;
+    Chain.Vertices = Vertices;
+    Chain.Indices = Indices;
+    Chain.Lods.push_back({0, static_cast<uint32_t>(Indices.size()), 0.0f});
+    if (Vertices.empty())
+    {
+        return Chain;
+    }
+
+    glm::vec3 Min = Vertices[0].Position;
+    glm::vec3 Max = Vertices[0].Position;
+    for (const FStaticMeshVertex& Vertex : Vertices)
+    {
+        Min = glm::min(Min, Vertex.Position);
+        Max = glm::max(Max, Vertex.Position);
+    }
+    const glm::vec3 Size = Max - Min;
+    const float MaxError = Settings.MaxRelativeError * std::max(std::max(Size.x, Size.y), Size.z);
+
+    // Each level is simplified from the previous one, its deviation from LOD 0 is bounded by the summed errors
+    std::vector<uint32_t> Previous = Indices;
+    std::vector<uint32_t> Simplified;
+    float Error = 0.0f;
+    while (Chain.Lods.size() < Settings.MaxLods && Error < MaxError)
+    {
+        const uint32_t Target = static_cast<uint32_t>(Previous.size() / 3 * Settings.ReductionRatio) * 3;
+        const float LevelError = Simplify(Vertices, Previous, Target, MaxError - Error, Settings.AttributeWeight, Simplified);
+        if (Simplified.empty() || Simplified.size() > Previous.size() * (1.0f - Settings.MinReduction))
+        {
+            break;
+        }
+
+        Error += LevelError;
+        Chain.Lods.push_back({static_cast<uint32_t>(Chain.Indices.size()), static_cast<uint32_t>(Simplified.size()), Error});
+        Chain.Indices.insert(Chain.Indices.end(), Simplified.begin(), Simplified.end());
+        Previous.swap(Simplified);
+    }
+    return Chain;
+}
+
+bool FMeshSimplifier::SaveCookedMesh(const std::string& FilePath, const FStaticMeshLodChain& Chain)
+{
+    std::ofstream File(FilePath, std::ios::binary | std::ios::out);
+    if (!File.is_open())
+    {
+        return false;
+    }
+
+    const uint32_t Header[5] = {
+        CookedMeshMagic,
+        CookedMeshVersion,
+        static_cast<uint32_t>(Chain.Vertices.size()),
+        static_cast<uint32_t>(Chain.Indices.size()),
+        static_cast<uint32_t>(Chain.Lods.size())};
+    File.write(reinterpret_cast<const char*>(Header), sizeof(Header));
+    File.write(reinterpret_cast<const char*>(Chain.Vertices.data()), Chain.Vertices.size() * sizeof(FStaticMeshVertex));
+    File.write(reinterpret_cast<const char*>(Chain.Indices.data()), Chain.Indices.size() * sizeof(uint32_t));
+    File.write(reinterpret_cast<const char*>(Chain.Lods.data()), Chain.Lods.size() * sizeof(FStaticMeshLod));
+    return File.good();
+}
+
+bool FMeshSimplifier::LoadCookedMesh(const std::string& FilePath, FStaticMeshLodChain& OutChain)
+{
+    std::ifstream File(FilePath, std::ios::binary | std::ios::in);
+    if (!File.is_open())
+    {
+        return false;
+    }
+
+    uint32_t Header[5] = {};
+    File.read(reinterpret_cast<char*>(Header), sizeof(Header));
+    if (!File.good() || Header[0] != CookedMeshMagic || Header[1] != CookedMeshVersion)
+    {
+        return false;
+    }
+
+    OutChain.Vertices.resize(Header[2]);
+    OutChain.Indices.resize(Header[3]);
+    OutChain.Lods.resize(Header[4]);
+    File.read(reinterpret_cast<char*>(OutChain.Vertices.data()), OutChain.Vertices.size() * sizeof(FStaticMeshVertex));
+    File.read(reinterpret_cast<char*>(OutChain.Indices.data()), OutChain.Indices.size() * sizeof(uint32_t));
+    File.read(reinterpret_cast<char*>(OutChain.Lods.data()), OutChain.Lods.size() * sizeof(FStaticMeshLod));
+    return File.good();
+}
+
+float FLodSelector::GetProjectionScale(const glm::mat4& ProjectionMatrix, uint32_t ViewportHeight)
+{
+    // [1][1] is 1 / tan(FovY / 2), negative when the projection flips Y for Vulkan
+    return std::abs(ProjectionMatrix[1][1]) * ViewportHeight * 0.5f;
+}
+
+float FLodSelector::GetScreenError(float WorldError, float Distance, float ProjectionScale)
+{
+    if (Distance <= 1e-4f)
+    {
+        return WorldError > 0.0f ? FLT_MAX : 0.0f;
+    }
+    return WorldError * ProjectionScale / Distance;
+}
+
+uint32_t FLodSelector::SelectLod(
+    const std::vector<FStaticMeshLod>& Lods,
+    float Distance,
+    float WorldScale,
+    float ProjectionScale,
+    float ThresholdPixels,
+    uint32_t CurrentLod,
+    float Hysteresis)
+{
+    if (Lods.empty())
+    {
+        return 0;
+    }
+    const uint32_t LodNum = static_cast<uint32_t>(Lods.size());
+    CurrentLod = std::min(CurrentLod, LodNum - 1);
+    auto ScreenError = [&](uint32_t Lod) { return GetScreenError(Lods[Lod].Error * WorldScale, Distance, ProjectionScale); };
+
+    // Errors grow with the level, the coarsest one under the threshold wins
+    uint32_t Desired = 0;
+    for (uint32_t Lod = LodNum; Lod-- > 0;)
+    {
+        if (ScreenError(Lod) <= ThresholdPixels)
+        {
+            Desired = Lod;
+            break;
+        }
+    }
+
+    if (Desired > CurrentLod)
+    {
+        // Coarser only once the level is comfortably under the threshold
+        const float Lower = ThresholdPixels * (1.0f - Hysteresis);
+        for (uint32_t Lod = Desired; Lod > CurrentLod; --Lod)
+        {
+            if (ScreenError(Lod) <= Lower)
+            {
+                return Lod;
+            }
+        }
+        return CurrentLod;
+    }
+    if (Desired < CurrentLod && ScreenError(CurrentLod) > ThresholdPixels * (1.0f + Hysteresis))
+    {
+        return Desired;
+    }
+    return CurrentLod;
+}
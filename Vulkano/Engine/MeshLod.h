@@ -0,0 +1,81 @@
+﻿#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Render/VertexInputs.h"
+
+// One level of detail, a range of the chain's index buffer over the shared vertices
+struct FStaticMeshLod
+{
+    uint32_t FirstIndex = 0;
+    uint32_t IndexCount = 0;
+    // Object space distance the surface may deviate from LOD 0, grows with every level
+    float Error = 0.0f;
+};
+
+struct FStaticMeshLodChain
+{
+    std::vector<FStaticMeshVertex> Vertices;
+    std::vector<uint32_t> Indices;
+    std::vector<FStaticMeshLod> Lods;
+};
+
+struct FMeshLodSettings
+{
+    uint32_t MaxLods = 5;
+    // Target triangle count of each level relative to the previous one
+    float ReductionRatio = 0.5f;
+    // Stops the chain once a level would deviate further than this, relative to the mesh extent
+    float MaxRelativeError = 0.1f;
+    // Weight of normal, UV and color differences against the geometric error
+    float AttributeWeight = 0.05f;
+    // A level that removes less than this share of the previous one's triangles ends the chain
+    float MinReduction = 0.1f;
+};
+
+// Offline LOD chain generation with quadric error metric edge collapse.
+// Collapses are half-edge so every level indexes the LOD 0 vertex buffer; open borders and
+// UV / normal seams are locked. Attribute differences of the collapsed vertex are added to the
+// quadric error so collapses across shading discontinuities come last.
+class FMeshSimplifier
+{
+public:
+    // Simplifies a triangle list towards TargetIndexCount, returns the object space error of the result
+    static float Simplify(
+        const std::vector<FStaticMeshVertex>& Vertices,
+        const std::vector<uint32_t>& Indices,
+        uint32_t TargetIndexCount,
+        float MaxError,
+        float AttributeWeight,
+        std::vector<uint32_t>& OutIndices);
+
+    static FStaticMeshLodChain BuildLodChain(
+        const std::vector<FStaticMeshVertex>& Vertices,
+        const std::vector<uint32_t>& Indices,
+        const FMeshLodSettings& Settings = {});
+
+    // Cooked mesh container holding the vertices, all LOD index ranges and their errors
+    static bool SaveCookedMesh(const std::string& FilePath, const FStaticMeshLodChain& Chain);
+    static bool LoadCookedMesh(const std::string& FilePath, FStaticMeshLodChain& OutChain);
+};
+
+// Runtime LOD selection from projected screen-space error.
+// A level's error in pixels is Error * ProjectionScale / Distance, the coarsest level under the
+// threshold is chosen. Hysteresis widens the threshold around the current level against popping.
+class FLodSelector
+{
+public:
+    // Pixels per world unit at distance 1: ViewportHeight / (2 tan(FovY / 2)), read from the projection matrix
+    static float GetProjectionScale(const glm::mat4& ProjectionMatrix, uint32_t ViewportHeight);
+    static float GetScreenError(float WorldError, float Distance, float ProjectionScale);
+
+    // WorldScale is the largest scale of the instance's world matrix
+    static uint32_t SelectLod(
+        const std::vector<FStaticMeshLod>& Lods,
+        float Distance,
+        float WorldScale,
+        float ProjectionScale,
+        float ThresholdPixels,
+        uint32_t CurrentLod,
+        float Hysteresis = 0.2f);
+};
@@ -0,0 +1,359 @@
+﻿#include "OcclusionCulling.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <immintrin.h>
+#include "Core/Assertion.h"
+#include "Core/JobSystem.h"
+
+namespace
+{
+    // Vertices closer than this are not projected, triangles touching the near plane are dropped as occluders
+    constexpr float MinClipW = 1e-4f;
+    constexpr float ClearDepth = FLT_MAX;
+    constexpr uint32_t TestBatchSize = 4096;
+}
+
+void FOcclusionCuller::Init(uint32_t InWidth, uint32_t InHeight)
+{
+    TilesX = std::max((InWidth + TileWidth - 1) / TileWidth, 1u);
+    TilesY = std::max((InHeight + TileHeight - 1) / TileHeight, 1u);
+    Width = TilesX * TileWidth;
+    Height = TilesY * TileHeight;
+    TileBins.resize(TilesX * TilesY);
+
+    HiZ.clear();
+    uint32_t LevelWidth = Width;
+    uint32_t LevelHeight = Height;
+    for (;;)
+    {
+        HiZ.push_back({LevelWidth, LevelHeight, std::vector<float>(LevelWidth * LevelHeight, ClearDepth)});
+        if (LevelWidth == 1 && LevelHeight == 1)
+        {
+            break;
+        }
+        LevelWidth = std::max((LevelWidth + 1) / 2, 1u);
+        LevelHeight = std::max((LevelHeight + 1) / 2, 1u);
+    }
+}
+
+uint32_t FOcclusionCuller::RegisterOccluderMesh(const std::vector<glm::vec3>& Positions, const std::vector<uint32_t>& Indices)
+{
+    checkf(Indices.size() % 3 == 0, "FOcclusionCuller::RegisterOccluderMesh index count %zu is not a triangle list", Indices.size());
+    Meshes.push_back({Positions, Indices});
+    return static_cast<uint32_t>(Meshes.size() - 1);
+}
+
+void FOcclusionCuller::BeginFrame(const glm::mat4& InViewProjection)
+{
+    check(Width > 0);
+    ViewProjection = InViewProjection;
+    Instances.clear();
+}
+
+void FOcclusionCuller::AddOccluder(uint32_t MeshId, const glm::mat4& WorldMatrix)
+{
+    check(MeshId < Meshes.size());
+    Instances.push_back({MeshId, WorldMatrix});
+}
+
+bool FOcclusionCuller::HasOccluders() const
+{
+    return !Instances.empty();
+}
+
+void FOcclusionCuller::Rasterize()
+{
+    SetupTriangles();
+    FJobSystem::Get()->ParallelFor(TilesX * TilesY, 1, [this](uint32_t Begin, uint32_t End)
+    {
+        for (uint32_t Tile = Begin; Tile < End; ++Tile)
+        {
+            RasterizeTile(Tile);
+        }
+    });
+    BuildHiZ();
+}
+
+void FOcclusionCuller::SetupTriangles()
+{
+    Triangles.clear();
+    for (std::vector<uint32_t>& Bin : TileBins)
+    {
+        Bin.clear();
+    }
+
+    const glm::vec2 ScreenScale(Width * 0.5f, Height * 0.5f);
+    std::vector<glm::vec4> ClipPositions;
+    for (const FOccluderInstance& Instance : Instances)
+    {
+        const FOccluderMesh& Mesh = Meshes[Instance.MeshId];
+        const glm::mat4 WorldViewProjection = ViewProjection * Instance.WorldMatrix;
+        ClipPositions.resize(Mesh.Positions.size());
+        for (size_t Vertex = 0; Vertex < Mesh.Positions.size(); ++Vertex)
+        {
+            ClipPositions[Vertex] = WorldViewProjection * glm::vec4(Mesh.Positions[Vertex], 1.0f);
+        }
+
+        for (size_t Index = 0; Index < Mesh.Indices.size(); Index += 3)
+        {
+            const glm::vec4& A = ClipPositions[Mesh.Indices[Index]];
+            const glm::vec4& B = ClipPositions[Mesh.Indices[Index + 1]];
+            const glm::vec4& C = ClipPositions[Mesh.Indices[Index + 2]];
+            if (A.w < MinClipW || B.w < MinClipW || C.w < MinClipW)
+            {
+                continue;
+            }
+
+            FScreenTriangle Triangle;
+            const glm::vec4* Clip[3] = {&A, &B, &C};
+            for (int Corner = 0; Corner < 3; ++Corner)
+            {
+                const glm::vec3 Ndc = glm::vec3(*Clip[Corner]) / Clip[Corner]->w;
+                Triangle.Vertices[Corner] = glm::vec3((Ndc.x + 1.0f) * ScreenScale.x, (Ndc.y + 1.0f) * ScreenScale.y, Ndc.z);
+            }
+            
+            const glm::vec3& V0 = Triangle.Vertices[0];
+            const glm::vec3& V1 = Triangle.Vertices[1];
+            const glm::vec3& V2 = Triangle.Vertices[2];
+            const float MinX = std::min({V0.x, V1.x, V2.x});
+            const float MaxX = std::max({V0.x, V1.x, V2.x});
+            const float MinY = std::min({V0.y, V1.y, V2.y});
+            const float MaxY = std::max({V0.y, V1.y, V2.y});
+            if (MaxX < 0.0f || MaxY < 0.0f || MinX >= Width || MinY >= Height)
+            {
+                continue;
+            }
+
+            const uint32_t TriangleIndex = static_cast<uint32_t>(Triangles.size());
+            Triangles.push_back(Triangle);
+            const uint32_t TileMinX = static_cast<uint32_t>(std::max(MinX, 0.0f)) / TileWidth;
+            const uint32_t TileMaxX = std::min(static_cast<uint32_t>(MaxX) / TileWidth, TilesX - 1);
+            const uint32_t TileMinY = static_cast<uint32_t>(std::max(MinY, 0.0f)) / TileHeight;
+            const uint32_t TileMaxY = std::min(static_cast<uint32_t>(MaxY) / TileHeight, TilesY - 1);
+            for (uint32_t TileY = TileMinY; TileY <= TileMaxY; ++TileY)
+            {
+                for (uint32_t TileX = TileMinX; TileX <= TileMaxX; ++TileX)
+                {
+                    TileBins[TileY * TilesX + TileX].push_back(TriangleIndex);
+                }
+            }
+        }
+    }
+}
+
+void FOcclusionCuller::RasterizeTile(uint32_t Tile)
+{
+    const uint32_t TileX0 = (Tile % TilesX) * TileWidth;
+    const uint32_t TileY0 = (Tile / TilesX) * TileHeight;
+    float* Depth = HiZ[0].Depth.data();
+    for (uint32_t Row = 0; Row < TileHeight; ++Row)
+    {
+        std::fill_n(Depth + (TileY0 + Row) * Width + TileX0, TileWidth, ClearDepth);
+    }
+
+    const __m128 LaneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    for (uint32_t TriangleIndex : TileBins[Tile])
+    {
+        const FScreenTriangle& Triangle = Triangles[TriangleIndex];
+        glm::vec3 V0 = Triangle.Vertices[0];
+        glm::vec3 V1 = Triangle.Vertices[1];
+        glm::vec3 V2 = Triangle.Vertices[2];
+        float Area = (V1.x - V0.x) * (V2.y - V0.y) - (V2.x - V0.x) * (V1.y - V0.y);
+        if (std::abs(Area) < 1e-6f)
+        {
+            continue;
+        }
+        // Occluders are two sided, flip to one winding so the edge functions are positive inside
+        if (Area < 0.0f)
+        {
+            std::swap(V1, V2);
+            Area = -Area;
+        }
+
+        // Edge i is positive on the inner side of the edge opposite to vertex i
+        const float EdgeA[3] = {V1.y - V2.y, V2.y - V0.y, V0.y - V1.y};
+        const float EdgeB[3] = {V2.x - V1.x, V0.x - V2.x, V1.x - V0.x};
+        const float EdgeC[3] = {V1.x * V2.y - V2.x * V1.y, V2.x * V0.y - V0.x * V2.y, V0.x * V1.y - V1.x * V0.y};
+        // Depth is linear in screen space, z = ZX * x + ZY * y + Z0
+        const float InvArea = 1.0f / Area;
+        const float ZX = (EdgeA[0] * V0.z + EdgeA[1] * V1.z + EdgeA[2] * V2.z) * InvArea;
+        const float ZY = (EdgeB[0] * V0.z + EdgeB[1] * V1.z + EdgeB[2] * V2.z) * InvArea;
+        const float Z0 = (EdgeC[0] * V0.z + EdgeC[1] * V1.z + EdgeC[2] * V2.z) * InvArea;
+
+        // Triangle bounds clipped to the tile, x aligned to 4 pixels for SSE
+        const int32_t MinX = std::max(static_cast<int32_t>(std::min({V0.x, V1.x, V2.x})), static_cast<int32_t>(TileX0)) & ~3;
+        const int32_t MaxX = std::min(static_cast<int32_t>(std::max({V0.x, V1.x, V2.x})) + 1, static_cast<int32_t>(TileX0 + TileWidth));
+        const int32_t MinY = std::max(static_cast<int32_t>(std::min({V0.y, V1.y, V2.y})), static_cast<int32_t>(TileY0));
+        const int32_t MaxY = std::min(static_cast<int32_t>(std::max({V0.y, V1.y, V2.y})) + 1, static_cast<int32_t>(TileY0 + TileHeight));
+
+        const __m128 A0 = _mm_set1_ps(EdgeA[0]), A1 = _mm_set1_ps(EdgeA[1]), A2 = _mm_set1_ps(EdgeA[2]);
+        const __m128 ZXs = _mm_set1_ps(ZX);
+        const __m128 Zero = _mm_setzero_ps();
+        for (int32_t Y = MinY; Y < MaxY; ++Y)
+        {
+            const float PixelY = Y + 0.5f;
+            const __m128 RowE0 = _mm_set1_ps(EdgeB[0] * PixelY + EdgeC[0]);
+            const __m128 RowE1 = _mm_set1_ps(EdgeB[1] * PixelY + EdgeC[1]);
+            const __m128 RowE2 = _mm_set1_ps(EdgeB[2] * PixelY + EdgeC[2]);
+            const __m128 RowZ = _mm_set1_ps(ZY * PixelY + Z0);
+            float* DepthRow = Depth + Y * Width;
+            for (int32_t X = MinX; X < MaxX; X += 4)
+            {
+                const __m128 PixelX = _mm_add_ps(_mm_set1_ps(static_cast<float>(X)), LaneOffsets);
+                const __m128 E0 = _mm_add_ps(_mm_mul_ps(A0, PixelX), RowE0);
+                const __m128 E1 = _mm_add_ps(_mm_mul_ps(A1, PixelX), RowE1);
+                const __m128 E2 = _mm_add_ps(_mm_mul_ps(A2, PixelX), RowE2);
+                const __m128 Inside = _mm_and_ps(_mm_cmpge_ps(E0, Zero), _mm_and_ps(_mm_cmpge_ps(E1, Zero), _mm_cmpge_ps(E2, Zero)));
+                if (_mm_movemask_ps(Inside) == 0)
+                {
+                    continue;
+                }
+                const __m128 Z = _mm_add_ps(_mm_mul_ps(ZXs, PixelX), RowZ);
+                const __m128 Current = _mm_loadu_ps(DepthRow + X);
+                const __m128 Closest = _mm_min_ps(Current, Z);
+                _mm_storeu_ps(DepthRow + X, _mm_or_ps(_mm_and_ps(Inside, Closest), _mm_andnot_ps(Inside, Current)));
+            }
+        }
+    }
+}
+
+void FOcclusionCuller::BuildHiZ()
+{
+    for (size_t Level = 1; Level < HiZ.size(); ++Level)
+    {
+        const FHiZLevel& Source = HiZ[Level - 1];
+        FHiZLevel& Target = HiZ[Level];
+        FJobSystem::Get()->ParallelFor(Target.Height, 16, [&Source, &Target](uint32_t Begin, uint32_t End)
+        {
+            for (uint32_t Y = Begin; Y < End; ++Y)
+            {
+                // Odd sizes clamp, the last row / column is folded into the texel next to it
+                const uint32_t Y0 = std::min(Y * 2, Source.Height - 1);
+                const uint32_t Y1 = std::min(Y * 2 + 1, Source.Height - 1);
+                for (uint32_t X = 0; X < Target.Width; ++X)
+                {
+                    const uint32_t X0 = std::min(X * 2, Source.Width - 1);
+                    const uint32_t X1 = std::min(X * 2 + 1, Source.Width - 1);
+                    const float Max0 = std::max(Source.Depth[Y0 * Source.Width + X0], Source.Depth[Y0 * Source.Width + X1]);
+                    const float Max1 = std::max(Source.Depth[Y1 * Source.Width + X0], Source.Depth[Y1 * Source.Width + X1]);
+                    Target.Depth[Y * Target.Width + X] = std::max(Max0, Max1);
+                }
+            }
+        });
+    }
+}
+
+bool FOcclusionCuller::IsVisible(const glm::vec3& Center, const glm::vec3& Extent) const
+{
+    if (Instances.empty())
+    {
+        return true;
+    }
+
+    glm::vec2 ScreenMin(FLT_MAX);
+    glm::vec2 ScreenMax(-FLT_MAX);
+    float NearestDepth = FLT_MAX;
+    // The projection is linear before the divide, corners are the clip center plus signed clip axes
+    const glm::vec4 ClipCenter = ViewProjection * glm::vec4(Center, 1.0f);
+    const glm::vec4 ClipAxisX = ViewProjection[0] * Extent.x;
+    const glm::vec4 ClipAxisY = ViewProjection[1] * Extent.y;
+    const glm::vec4 ClipAxisZ = ViewProjection[2] * Extent.z;
+    for (int Corner = 0; Corner < 8; ++Corner)
+    {
+        const glm::vec4 Clip = ClipCenter +
+            ((Corner & 1) ? ClipAxisX : -ClipAxisX) +
+            ((Corner & 2) ? ClipAxisY : -ClipAxisY) +
+            ((Corner & 4) ? ClipAxisZ : -ClipAxisZ);
+        // Crossing the near plane, too close to decide
+        if (Clip.w < MinClipW)
+        {
+            return true;
+        }
+        const glm::vec3 Ndc = glm::vec3(Clip) / Clip.w;
+        ScreenMin = glm::min(ScreenMin, glm::vec2(Ndc));
+        ScreenMax = glm::max(ScreenMax, glm::vec2(Ndc));
+        NearestDepth = std::min(NearestDepth, Ndc.z);
+    }
+
+    const glm::vec2 ScreenScale(Width * 0.5f, Height * 0.5f);
+    ScreenMin = glm::clamp((ScreenMin + 1.0f) * ScreenScale, glm::vec2(0.0f), glm::vec2(Width - 1.0f, Height - 1.0f));
+    ScreenMax = glm::clamp((ScreenMax + 1.0f) * ScreenScale, glm::vec2(0.0f), glm::vec2(Width - 1.0f, Height - 1.0f));
+
+    // The level where the rectangle spans at most two texels per axis
+    const float Size = std::max(ScreenMax.x - ScreenMin.x, ScreenMax.y - ScreenMin.y);
+    uint32_t Level = Size > 1.0f ? static_cast<uint32_t>(std::ceil(std::log2(Size))) : 0;
+    Level = std::min(Level, static_cast<uint32_t>(HiZ.size() - 1));
+    const FHiZLevel& HiZLevel = HiZ[Level];
+    const uint32_t MinX = static_cast<uint32_t>(ScreenMin.x) >> Level;
+    const uint32_t MinY = static_cast<uint32_t>(ScreenMin.y) >> Level;
+    const uint32_t MaxX = std::min(static_cast<uint32_t>(ScreenMax.x) >> Level, HiZLevel.Width - 1);
+    const uint32_t MaxY = std::min(static_cast<uint32_t>(ScreenMax.y) >> Level, HiZLevel.Height - 1);
+    for (uint32_t Y = MinY; Y <= MaxY; ++Y)
+    {
+        for (uint32_t X = MinX; X <= MaxX; ++X)
+        {
+            if (NearestDepth <= HiZLevel.Depth[Y * HiZLevel.Width + X])
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+uint32_t FOcclusionCuller::FilterVisible(const FSceneBounds& Bounds, std::vector<uint32_t>& InOutIndices) const
+{
+    if (Instances.empty())
+    {
+        return static_cast<uint32_t>(InOutIndices.size());
+    }
+
+    // Compacts each batch in place, then packs the batches like the frustum culler
+    const uint32_t Num = static_cast<uint32_t>(InOutIndices.size());
+    const uint32_t BatchNum = (Num + TestBatchSize - 1) / TestBatchSize;
+    std::vector<uint32_t> BatchCounts(BatchNum);
+    FJobSystem::Get()->ParallelFor(BatchNum, 1, [&](uint32_t BatchBegin, uint32_t BatchEnd)
+    {
+        for (uint32_t Batch = BatchBegin; Batch < BatchEnd; ++Batch)
+        {
+            const uint32_t Begin = Batch * TestBatchSize;
+            const uint32_t End = std::min(Begin + TestBatchSize, Num);
+            uint32_t Count = 0;
+            for (uint32_t Candidate = Begin; Candidate < End; ++Candidate)
+            {
+                const uint32_t Index = InOutIndices[Candidate];
+                const glm::vec3 Center(Bounds.CenterX[Index], Bounds.CenterY[Index], Bounds.CenterZ[Index]);
+                const glm::vec3 Extent(Bounds.ExtentX[Index], Bounds.ExtentY[Index], Bounds.ExtentZ[Index]);
+                InOutIndices[Begin + Count] = Index;
+                Count += IsVisible(Center, Extent) ? 1 : 0;
+            }
+            BatchCounts[Batch] = Count;
+        }
+    });
+
+    uint32_t Count = 0;
+    for (uint32_t Batch = 0; Batch < BatchNum; ++Batch)
+    {
+        std::memmove(InOutIndices.data() + Count, InOutIndices.data() + Batch * TestBatchSize, BatchCounts[Batch] * sizeof(uint32_t));
+        Count += BatchCounts[Batch];
+    }
+    InOutIndices.resize(Count);
+    return Count;
+}
+
+uint32_t FOcclusionCuller::GetWidth() const
+{
+    return Width;
+}
+
+uint32_t FOcclusionCuller::GetHeight() const
+{
+    return Height;
+}
+
+const std::vector<float>& FOcclusionCuller::GetDepth() const
+{
+    return HiZ[0].Depth;
+}
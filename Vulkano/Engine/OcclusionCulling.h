@@ -0,0 +1,78 @@
+﻿#pragma once
+#include <cstdint>
+#include <vector>
+#include "Engine/Scene.h"
+#include "glm/glm.hpp"
+
+// Software occlusion culling. Occluder triangles are rasterized into a small depth buffer,
+// one job per screen tile, then reduced into a max-depth pyramid that candidate bounds are tested against.
+// Everything is conservative, anything that cannot be decided counts as visible.
+class FOcclusionCuller
+{
+public:
+    static constexpr uint32_t TileWidth = 64;
+    static constexpr uint32_t TileHeight = 32;
+
+    // Sizes round up to whole tiles
+    void Init(uint32_t InWidth = 320, uint32_t InHeight = 192);
+    uint32_t RegisterOccluderMesh(const std::vector<glm::vec3>& Positions, const std::vector<uint32_t>& Indices);
+
+    void BeginFrame(const glm::mat4& ViewProjection);
+    void AddOccluder(uint32_t MeshId, const glm::mat4& WorldMatrix);
+    // Rasterizes every occluder added this frame and builds the pyramid
+    void Rasterize();
+    
+    bool HasOccluders() const;
+    bool IsVisible(const glm::vec3& Center, const glm::vec3& Extent) const;
+    // Keeps the candidates whose bounds are not hidden behind occluders, order is preserved
+    uint32_t FilterVisible(const FSceneBounds& Bounds, std::vector<uint32_t>& InOutIndices) const;
+
+    uint32_t GetWidth() const;
+    uint32_t GetHeight() const;
+    const std::vector<float>& GetDepth() const;
+
+private:
+    struct FOccluderMesh
+    {
+        std::vector<glm::vec3> Positions;
+        std::vector<uint32_t> Indices;
+    };
+
+    struct FOccluderInstance
+    {
+        uint32_t MeshId;
+        glm::mat4 WorldMatrix;
+    };
+
+    // Screen space vertices, x/y in pixels and z = clip z / w
+    struct FScreenTriangle
+    {
+        glm::vec3 Vertices[3];
+    };
+
+    void SetupTriangles();
+    void RasterizeTile(uint32_t Tile);
+    void BuildHiZ();
+
+private:
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    uint32_t TilesX = 0;
+    uint32_t TilesY = 0;
+    glm::mat4 ViewProjection = glm::mat4(1.0f);
+
+    std::vector<FOccluderMesh> Meshes;
+    std::vector<FOccluderInstance> Instances;
+    std::vector<FScreenTriangle> Triangles;
+    // Triangle indices overlapping each tile
+    std::vector<std::vector<uint32_t>> TileBins;
+
+    // Level 0 is the depth buffer, each level above keeps the farthest depth of 2x2 texels
+    struct FHiZLevel
+    {
+        uint32_t Width;
+        uint32_t Height;
+        std::vector<float> Depth;
+    };
+    std::vector<FHiZLevel> HiZ;
+};
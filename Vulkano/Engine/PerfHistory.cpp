@@ -0,0 +1,179 @@
+﻿#include "PerfHistory.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include "Core/Json.h"
+#include "Core/Platform.h"
+#include "Core/VulkanoLog.h"
+
+namespace
+{
+    double Median(std::vector<double>& Values)
+    {
+        if (Values.empty())
+        {
+            return 0.0;
+        }
+        const size_t Middle = Values.size() / 2;
+        std::nth_element(Values.begin(), Values.begin() + Middle, Values.end());
+        return Values[Middle];
+    }
+
+    FJsonValue ToJson(const FPerfRecord& Record)
+    {
+        FJsonValue Passes = FJsonValue::MakeArray();
+        for (const FPerfPassRecord& Pass : Record.Passes)
+        {
+            FJsonValue PassJson = FJsonValue::MakeObject();
+            PassJson.SetField("name", Pass.Name);
+            PassJson.SetField("gpu_ms", Pass.GpuMilliseconds);
+            PassJson.SetField("cpu_ms", Pass.CpuMilliseconds);
+            Passes.Append(PassJson);
+        }
+
+        FJsonValue Json = FJsonValue::MakeObject();
+        Json.SetField("scene", Record.Scene);
+        Json.SetField("timestamp", Record.Timestamp);
+        Json.SetField("device", Record.Device);
+        Json.SetField("frames", Record.FrameNum);
+        Json.SetField("frame_ms", Record.FrameMilliseconds);
+        Json.SetField("frame_p95_ms", Record.FrameP95Milliseconds);
+        Json.SetField("passes", Passes);
+        return Json;
+    }
+
+    FPerfRecord FromJson(const FJsonValue& Json)
+    {
+        FPerfRecord Record;
+        Record.Scene = Json.GetField("scene").GetString();
+        Record.Timestamp = Json.GetField("timestamp").GetString();
+        Record.Device = Json.GetField("device").GetString();
+        Record.FrameNum = static_cast<uint32_t>(Json.GetField("frames").GetNumber());
+        Record.FrameMilliseconds = Json.GetField("frame_ms").GetNumber();
+        Record.FrameP95Milliseconds = Json.GetField("frame_p95_ms").GetNumber();
+        const FJsonValue& Passes = Json.GetField("passes");
+        for (size_t Index = 0; Index < Passes.GetSize(); ++Index)
+        {
+            FPerfPassRecord& Pass = Record.Passes.emplace_back();
+            Pass.Name = Passes[Index].GetField("name").GetString();
+            Pass.GpuMilliseconds = Passes[Index].GetField("gpu_ms").GetNumber();
+            Pass.CpuMilliseconds = Passes[Index].GetField("cpu_ms").GetNumber();
+        }
+        return Record;
+    }
+}
+
+std::string FPerfHistory::MakeTimestamp()
+{
+    const std::time_t Now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    std::tm Utc = {};
+    FPlatform::GetUtcTime(Now, Utc);
+    char Buffer[32];
+    strftime(Buffer, sizeof(Buffer), "%Y-%m-%dT%H:%M:%SZ", &Utc);
+    return Buffer;
+}
+
+bool FPerfHistory::Load(const std::string& FilePath)
+{
+    Records.clear();
+    std::ifstream File(FilePath);
+    if (!File.is_open())
+    {
+        // No history yet, the first run becomes the baseline
+        return false;
+    }
+
+    std::string Line;
+    uint32_t LineNumber = 0;
+    while (std::getline(File, Line))
+    {
+        ++LineNumber;
+        if (Line.find_first_not_of(" \t\r") == std::string::npos)
+        {
+            continue;
+        }
+        FJsonValue Json;
+        if (!FJsonValue::Parse(Line, Json))
+        {
+            VK_LOG(LOG_WARNING, "Skipping malformed perf history line %u in %s", LineNumber, FilePath.c_str());
+            continue;
+        }
+        Records.push_back(FromJson(Json));
+    }
+    return true;
+}
+
+bool FPerfHistory::Append(const std::string& FilePath, const FPerfRecord& Record)
+{
+    std::ofstream File(FilePath, std::ios::out | std::ios::app);
+    if (!File.is_open())
+    {
+        return false;
+    }
+    File << ToJson(Record).Serialize() << '\n';
+    return File.good();
+}
+
+FPerfCheckResult FPerfHistory::Check(const FPerfRecord& Record, const FPerfThresholds& Thresholds) const
+{
+    FPerfCheckResult Result;
+
+    // Newest runs of the same scene on the same device
+    std::vector<const FPerfRecord*> Baseline;
+    for (auto It = Records.rbegin(); It != Records.rend() && Baseline.size() < Thresholds.BaselineRuns; ++It)
+    {
+        if (It->Scene == Record.Scene && It->Device == Record.Device)
+        {
+            Baseline.push_back(&*It);
+        }
+    }
+    if (Baseline.empty())
+    {
+        return Result;
+    }
+    Result.bHasBaseline = true;
+
+    auto CheckValue = [&](const std::string& What, double Current, std::vector<double>& History)
+    {
+        const double Reference = Median(History);
+        if (Reference > 0.0 && Current > Reference * (1.0 + Thresholds.MaxRegression))
+        {
+            char Message[256];
+            snprintf(Message, sizeof(Message), "%s: %.3f ms, baseline %.3f ms (+%.1f%%)", What.c_str(), Current, Reference, (Current / Reference - 1.0) * 100.0);
+            Result.Regressions.push_back(Message);
+            Result.bPassed = false;
+        }
+    };
+
+    std::vector<double> History;
+    for (const FPerfRecord* Previous : Baseline)
+    {
+        History.push_back(Previous->FrameMilliseconds);
+    }
+    CheckValue(Record.Scene + " frame", Record.FrameMilliseconds, History);
+
+    for (const FPerfPassRecord& Pass : Record.Passes)
+    {
+        History.clear();
+        for (const FPerfRecord* Previous : Baseline)
+        {
+            for (const FPerfPassRecord& PreviousPass : Previous->Passes)
+            {
+                if (PreviousPass.Name == Pass.Name && PreviousPass.GpuMilliseconds >= Thresholds.MinPassMilliseconds)
+                {
+                    History.push_back(PreviousPass.GpuMilliseconds);
+                }
+            }
+        }
+        CheckValue(Record.Scene + " pass " + Pass.Name + " GPU", Pass.GpuMilliseconds, History);
+    }
+    return Result;
+}
+
+const std::vector<FPerfRecord>& FPerfHistory::GetRecords() const
+{
+    return Records;
+}
@@ -0,0 +1,59 @@
+﻿#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct FPerfPassRecord
+{
+    std::string Name;
+    double GpuMilliseconds = 0.0;
+    double CpuMilliseconds = 0.0;
+};
+
+// One scene of one regression run, medians over the measured frames
+struct FPerfRecord
+{
+    std::string Scene;
+    // UTC, ISO 8601
+    std::string Timestamp;
+    std::string Device;
+    uint32_t FrameNum = 0;
+    double FrameMilliseconds = 0.0;
+    double FrameP95Milliseconds = 0.0;
+    std::vector<FPerfPassRecord> Passes;
+};
+
+struct FPerfThresholds
+{
+    // Allowed slowdown against the baseline, 0.1 is 10%
+    double MaxRegression = 0.1;
+    // Median of this many previous runs of the same scene is the baseline
+    uint32_t BaselineRuns = 5;
+    // Passes faster than this are noise and never fail the run
+    double MinPassMilliseconds = 0.05;
+};
+
+struct FPerfCheckResult
+{
+    bool bHasBaseline = false;
+    bool bPassed = true;
+    std::vector<std::string> Regressions;
+};
+
+// Frame and pass timings of regression runs kept as JSON lines, one record per scene and run.
+// Appending never rewrites earlier runs so the file can be versioned or collected by CI.
+class FPerfHistory
+{
+public:
+    static std::string MakeTimestamp();
+
+    bool Load(const std::string& FilePath);
+    static bool Append(const std::string& FilePath, const FPerfRecord& Record);
+
+    // Compares against earlier records of the same scene and device, checked before Append so the run isn't its own baseline
+    FPerfCheckResult Check(const FPerfRecord& Record, const FPerfThresholds& Thresholds) const;
+    const std::vector<FPerfRecord>& GetRecords() const;
+
+private:
+    std::vector<FPerfRecord> Records;
+};
@@ -0,0 +1,342 @@
+﻿#include "Scene.h"
+
+#include <algorithm>
+#include <type_traits>
+#include "Core/Assertion.h"
+#include "Core/JobSystem.h"
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+#include "glm/simd/common.h"
+#endif
+
+namespace
+{
+    // Entities per job, small enough to balance wide levels and large enough to hide the dispatch
+    constexpr uint32_t UpdateBatchSize = 4096;
+
+    // Out = Parent * Local, column major like glm
+    inline void MultiplyMatrix(const glm::mat4& Parent, const glm::mat4& Local, glm::mat4& Out)
+    {
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+        const glm_vec4 P0 = _mm_loadu_ps(&Parent[0][0]);
+        const glm_vec4 P1 = _mm_loadu_ps(&Parent[1][0]);
+        const glm_vec4 P2 = _mm_loadu_ps(&Parent[2][0]);
+        const glm_vec4 P3 = _mm_loadu_ps(&Parent[3][0]);
+        for (int Column = 0; Column < 4; ++Column)
+        {
+            const float* L = &Local[Column][0];
+            glm_vec4 Result = glm_vec4_mul(P0, _mm_set1_ps(L[0]));
+            Result = glm_vec4_fma(P1, _mm_set1_ps(L[1]), Result);
+            Result = glm_vec4_fma(P2, _mm_set1_ps(L[2]), Result);
+            Result = glm_vec4_fma(P3, _mm_set1_ps(L[3]), Result);
+            _mm_storeu_ps(&Out[Column][0], Result);
+        }
+#else
+        Out = Parent * Local;
+#endif
+    }
+
+    // Translation * Rotation * Scale without building the three matrices
+    inline void ComposeMatrix(const glm::vec3& Position, const glm::quat& Rotation, const glm::vec3& Scale, glm::mat4& Out)
+    {
+        const glm::mat3 R = glm::mat3_cast(Rotation);
+        Out[0] = glm::vec4(R[0] * Scale.x, 0.0f);
+        Out[1] = glm::vec4(R[1] * Scale.y, 0.0f);
+        Out[2] = glm::vec4(R[2] * Scale.z, 0.0f);
+        Out[3] = glm::vec4(Position, 1.0f);
+    }
+}
+
+void FSceneBounds::Resize(size_t Num)
+{
+    CenterX.resize(Num);
+    CenterY.resize(Num);
+    CenterZ.resize(Num);
+    ExtentX.resize(Num);
+    ExtentY.resize(Num);
+    ExtentZ.resize(Num);
+    Radius.resize(Num);
+}
+
+void FScene::Reserve(uint32_t Num)
+{
+    LocalPositions.reserve(Num);
+    LocalRotations.reserve(Num);
+    LocalScales.reserve(Num);
+    LocalBoundsCenters.reserve(Num);
+    LocalBoundsExtents.reserve(Num);
+    ParentIndices.reserve(Num);
+    Depths.reserve(Num);
+    Flags.reserve(Num);
+    LocalMatrices.reserve(Num);
+    WorldMatrices.reserve(Num);
+    EntityToIndex.reserve(Num);
+    IndexToEntity.reserve(Num);
+}
+
+FEntityId FScene::CreateEntity(FEntityId Parent, const FBoundingBox& LocalBounds)
+{
+    const FEntityId Entity = static_cast<FEntityId>(EntityToIndex.size());
+    const uint32_t Index = static_cast<uint32_t>(IndexToEntity.size());
+    
+    uint32_t ParentIndex = InvalidEntity;
+    uint16_t Depth = 0;
+    if (Parent != InvalidEntity)
+    {
+        ParentIndex = GetIndex(Parent);
+        checkf(Depths[ParentIndex] < UINT16_MAX, "FScene::CreateEntity hierarchy is too deep");
+        Depth = Depths[ParentIndex] + 1;
+    }
+    // Appending keeps depth order unless the new entity is shallower than the last one
+    if (!Depths.empty() && Depth < Depths.back())
+    {
+        bOrderDirty = true;
+    }
+
+    LocalPositions.emplace_back(0.0f);
+    LocalRotations.emplace_back(1.0f, 0.0f, 0.0f, 0.0f);
+    LocalScales.emplace_back(1.0f);
+    LocalBoundsCenters.push_back((LocalBounds.Min + LocalBounds.Max) * 0.5f);
+    LocalBoundsExtents.push_back((LocalBounds.Max - LocalBounds.Min) * 0.5f);
+    ParentIndices.push_back(ParentIndex);
+    Depths.push_back(Depth);
+    Flags.push_back(LocalDirty);
+    LocalMatrices.emplace_back(1.0f);
+    WorldMatrices.emplace_back(1.0f);
+    WorldBounds.Resize(Index + 1);
+    EntityToIndex.push_back(Index);
+    IndexToEntity.push_back(Entity);
+
+    if (!bOrderDirty)
+    {
+        if (LevelOffsets.empty())
+        {
+            LevelOffsets.push_back(0);
+        }
+        if (Depth + 1u >= LevelOffsets.size())
+        {
+            LevelOffsets.push_back(Index);
+        }
+        LevelOffsets.back() = Index + 1;
+    }
+    bAnyDirty = true;
+    return Entity;
+}
+
+void FScene::SetLocalTransform(FEntityId Entity, const glm::vec3& Position, const glm::quat& Rotation, const glm::vec3& Scale)
+{
+    const uint32_t Index = GetIndex(Entity);
+    LocalPositions[Index] = Position;
+    LocalRotations[Index] = Rotation;
+    LocalScales[Index] = Scale;
+    MarkDirty(Index);
+}
+
+void FScene::SetLocalPosition(FEntityId Entity, const glm::vec3& Position)
+{
+    const uint32_t Index = GetIndex(Entity);
+    LocalPositions[Index] = Position;
+    MarkDirty(Index);
+}
+
+void FScene::SetLocalRotation(FEntityId Entity, const glm::quat& Rotation)
+{
+    const uint32_t Index = GetIndex(Entity);
+    LocalRotations[Index] = Rotation;
+    MarkDirty(Index);
+}
+
+void FScene::SetLocalScale(FEntityId Entity, const glm::vec3& Scale)
+{
+    const uint32_t Index = GetIndex(Entity);
+    LocalScales[Index] = Scale;
+    MarkDirty(Index);
+}
+
+void FScene::SetLocalBounds(FEntityId Entity, const FBoundingBox& LocalBounds)
+{
+    const uint32_t Index = GetIndex(Entity);
+    LocalBoundsCenters[Index] = (LocalBounds.Min + LocalBounds.Max) * 0.5f;
+    LocalBoundsExtents[Index] = (LocalBounds.Max - LocalBounds.Min) * 0.5f;
+    MarkDirty(Index);
+}
+
+void FScene::MarkDirty(uint32_t Index)
+{
+    Flags[Index] |= LocalDirty;
+    bAnyDirty = true;
+}
+
+void FScene::UpdateWorldTransforms()
+{
+    if (bOrderDirty)
+    {
+        SortByDepth();
+    }
+    if (!bAnyDirty)
+    {
+        return;
+    }
+
+    // A level only reads the level above it, so entities within a level update in parallel
+    for (size_t Level = 0; Level + 1 < LevelOffsets.size(); ++Level)
+    {
+        const uint32_t Begin = LevelOffsets[Level];
+        const uint32_t End = LevelOffsets[Level + 1];
+        FJobSystem::Get()->ParallelFor(End - Begin, UpdateBatchSize, [this, Begin](uint32_t RangeBegin, uint32_t RangeEnd)
+        {
+            UpdateRange(Begin + RangeBegin, Begin + RangeEnd);
+        });
+    }
+    bAnyDirty = false;
+}
+
+void FScene::UpdateRange(uint32_t Begin, uint32_t End)
+{
+    for (uint32_t Index = Begin; Index < End; ++Index)
+    {
+        const uint8_t EntityFlags = Flags[Index];
+        const uint32_t ParentIndex = ParentIndices[Index];
+        const bool bParentChanged = ParentIndex != InvalidEntity && (Flags[ParentIndex] & WorldChanged);
+        if (!(EntityFlags & LocalDirty) && !bParentChanged)
+        {
+            // Clears last update's WorldChanged
+            Flags[Index] = 0;
+            continue;
+        }
+
+        if (EntityFlags & LocalDirty)
+        {
+            ComposeMatrix(LocalPositions[Index], LocalRotations[Index], LocalScales[Index], LocalMatrices[Index]);
+        }
+        glm::mat4& World = WorldMatrices[Index];
+        if (ParentIndex == InvalidEntity)
+        {
+            World = LocalMatrices[Index];
+        }
+        else
+        {
+            MultiplyMatrix(WorldMatrices[ParentIndex], LocalMatrices[Index], World);
+        }
+
+        // Arvo's method, the world extent is the local extent through the absolute rotation/scale
+        const glm::vec3& Center = LocalBoundsCenters[Index];
+        const glm::vec3& Extent = LocalBoundsExtents[Index];
+        const glm::vec3 WorldCenter = glm::vec3(World * glm::vec4(Center, 1.0f));
+        const glm::vec3 WorldExtent =
+            glm::abs(glm::vec3(World[0])) * Extent.x +
+            glm::abs(glm::vec3(World[1])) * Extent.y +
+            glm::abs(glm::vec3(World[2])) * Extent.z;
+        WorldBounds.CenterX[Index] = WorldCenter.x;
+        WorldBounds.CenterY[Index] = WorldCenter.y;
+        WorldBounds.CenterZ[Index] = WorldCenter.z;
+        WorldBounds.ExtentX[Index] = WorldExtent.x;
+        WorldBounds.ExtentY[Index] = WorldExtent.y;
+        WorldBounds.ExtentZ[Index] = WorldExtent.z;
+        WorldBounds.Radius[Index] = glm::length(WorldExtent);
+        
+        Flags[Index] = WorldChanged;
+    }
+}
+
+void FScene::SortByDepth()
+{
+    const uint32_t Num = GetEntityNum();
+    const uint16_t MaxDepth = *std::max_element(Depths.begin(), Depths.end());
+
+    // Counting sort keeps creation order inside a level
+    LevelOffsets.assign(MaxDepth + 2u, 0);
+    for (uint16_t Depth : Depths)
+    {
+        LevelOffsets[Depth + 1u]++;
+    }
+    for (size_t Level = 1; Level < LevelOffsets.size(); ++Level)
+    {
+        LevelOffsets[Level] += LevelOffsets[Level - 1];
+    }
+    std::vector<uint32_t> NewIndices(Num);
+    {
+        std::vector<uint32_t> Cursors(LevelOffsets.begin(), LevelOffsets.end() - 1);
+        for (uint32_t Index = 0; Index < Num; ++Index)
+        {
+            NewIndices[Index] = Cursors[Depths[Index]]++;
+        }
+    }
+
+    auto Permute = [&NewIndices, Num](auto& Array)
+    {
+        std::remove_reference_t<decltype(Array)> Sorted(Num);
+        for (uint32_t Index = 0; Index < Num; ++Index)
+        {
+            Sorted[NewIndices[Index]] = Array[Index];
+        }
+        Array.swap(Sorted);
+    };
+    Permute(LocalPositions);
+    Permute(LocalRotations);
+    Permute(LocalScales);
+    Permute(LocalBoundsCenters);
+    Permute(LocalBoundsExtents);
+    Permute(Depths);
+    Permute(Flags);
+    Permute(LocalMatrices);
+    Permute(WorldMatrices);
+    Permute(WorldBounds.CenterX);
+    Permute(WorldBounds.CenterY);
+    Permute(WorldBounds.CenterZ);
+    Permute(WorldBounds.ExtentX);
+    Permute(WorldBounds.ExtentY);
+    Permute(WorldBounds.ExtentZ);
+    Permute(WorldBounds.Radius);
+    Permute(IndexToEntity);
+    Permute(ParentIndices);
+    for (uint32_t& ParentIndex : ParentIndices)
+    {
+        if (ParentIndex != InvalidEntity)
+        {
+            ParentIndex = NewIndices[ParentIndex];
+        }
+    }
+    for (uint32_t Index = 0; Index < Num; ++Index)
+    {
+        EntityToIndex[IndexToEntity[Index]] = Index;
+    }
+    bOrderDirty = false;
+}
+
+uint32_t FScene::GetEntityNum() const
+{
+    return static_cast<uint32_t>(IndexToEntity.size());
+}
+
+uint32_t FScene::GetIndex(FEntityId Entity) const
+{
+    check(Entity < EntityToIndex.size());
+    return EntityToIndex[Entity];
+}
+
+FEntityId FScene::GetEntity(uint32_t Index) const
+{
+    return IndexToEntity[Index];
+}
+
+FEntityId FScene::GetParent(FEntityId Entity) const
+{
+    const uint32_t ParentIndex = ParentIndices[GetIndex(Entity)];
+    return ParentIndex == InvalidEntity ? InvalidEntity : IndexToEntity[ParentIndex];
+}
+
+const glm::mat4& FScene::GetWorldMatrix(FEntityId Entity) const
+{
+    return WorldMatrices[GetIndex(Entity)];
+}
+
+const std::vector<glm::mat4>& FScene::GetWorldMatrices() const
+{
+    return WorldMatrices;
+}
+
+const FSceneBounds& FScene::GetWorldBounds() const
+{
+    return WorldBounds;
+}
@@ -0,0 +1,89 @@
+﻿#pragma once
+#include <cstdint>
+#include <vector>
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+using FEntityId = uint32_t;
+constexpr FEntityId InvalidEntity = UINT32_MAX;
+
+struct FBoundingBox
+{
+    glm::vec3 Min = glm::vec3(0.0f);
+    glm::vec3 Max = glm::vec3(0.0f);
+};
+
+// World space bounds in SoA form, one float stream per component so culling can load several objects at once
+struct FSceneBounds
+{
+    void Resize(size_t Num);
+    size_t Num() const { return Radius.size(); }
+    
+    std::vector<float> CenterX;
+    std::vector<float> CenterY;
+    std::vector<float> CenterZ;
+    std::vector<float> ExtentX;
+    std::vector<float> ExtentY;
+    std::vector<float> ExtentZ;
+    std::vector<float> Radius;
+};
+
+// Data oriented transform hierarchy. Entities live in structure-of-arrays storage sorted by hierarchy depth,
+// so every parent is updated before its children in one linear pass per level.
+// Entity ids are stable, storage indices change whenever the order is rebuilt.
+class FScene
+{
+public:
+    void Reserve(uint32_t Num);
+    FEntityId CreateEntity(FEntityId Parent = InvalidEntity, const FBoundingBox& LocalBounds = {});
+    
+    void SetLocalTransform(FEntityId Entity, const glm::vec3& Position, const glm::quat& Rotation, const glm::vec3& Scale);
+    void SetLocalPosition(FEntityId Entity, const glm::vec3& Position);
+    void SetLocalRotation(FEntityId Entity, const glm::quat& Rotation);
+    void SetLocalScale(FEntityId Entity, const glm::vec3& Scale);
+    void SetLocalBounds(FEntityId Entity, const FBoundingBox& LocalBounds);
+
+    // Recomputes world matrices and bounds of dirty entities and everything below them
+    void UpdateWorldTransforms();
+
+    uint32_t GetEntityNum() const;
+    uint32_t GetIndex(FEntityId Entity) const;
+    FEntityId GetEntity(uint32_t Index) const;
+    FEntityId GetParent(FEntityId Entity) const;
+    const glm::mat4& GetWorldMatrix(FEntityId Entity) const;
+    // Indexed by storage index, valid after UpdateWorldTransforms
+    const std::vector<glm::mat4>& GetWorldMatrices() const;
+    const FSceneBounds& GetWorldBounds() const;
+
+private:
+    void MarkDirty(uint32_t Index);
+    void SortByDepth();
+    void UpdateRange(uint32_t Begin, uint32_t End);
+
+private:
+    enum EFlags : uint8_t
+    {
+        LocalDirty   = 1 << 0,
+        WorldChanged = 1 << 1,
+    };
+    
+    // Per storage index
+    std::vector<glm::vec3> LocalPositions;
+    std::vector<glm::quat> LocalRotations;
+    std::vector<glm::vec3> LocalScales;
+    std::vector<glm::vec3> LocalBoundsCenters;
+    std::vector<glm::vec3> LocalBoundsExtents;
+    std::vector<uint32_t> ParentIndices;
+    std::vector<uint16_t> Depths;
+    std::vector<uint8_t> Flags;
+    std::vector<glm::mat4> LocalMatrices;
+    std::vector<glm::mat4> WorldMatrices;
+    FSceneBounds WorldBounds;
+
+    std::vector<uint32_t> EntityToIndex;
+    std::vector<FEntityId> IndexToEntity;
+    // First storage index of every depth, plus one past the end
+    std::vector<uint32_t> LevelOffsets;
+    bool bOrderDirty = false;
+    bool bAnyDirty = false;
+};
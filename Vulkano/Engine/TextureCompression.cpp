@@ -0,0 +1,687 @@
+﻿#include "TextureCompression.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <immintrin.h>
+#include "Core/Assertion.h"
+#include "Core/JobSystem.h"
+
+namespace
+{
+    // Block pixels as SoA floats, one SSE register holds a channel of 4 pixels
+    struct alignas(16) FBlockPixels
+    {
+        float Channels[4][16];
+    };
+
+    struct FColor
+    {
+        float Values[4];
+    };
+
+    void LoadBlock(const uint8_t* Pixels, FBlockPixels& OutBlock)
+    {
+        for (uint32_t Pixel = 0; Pixel < 16; ++Pixel)
+        {
+            for (uint32_t Channel = 0; Channel < 4; ++Channel)
+            {
+                OutBlock.Channels[Channel][Pixel] = Pixels[Pixel * 4 + Channel];
+            }
+        }
+    }
+
+    // Nearest palette entry per pixel by weighted squared distance, returns the summed error
+    float SelectIndices(const FBlockPixels& Block, const FColor* Palette, uint32_t PaletteNum, const float* Weights, uint8_t* OutIndices)
+    {
+        const __m128 Weight0 = _mm_set1_ps(Weights[0]);
+        const __m128 Weight1 = _mm_set1_ps(Weights[1]);
+        const __m128 Weight2 = _mm_set1_ps(Weights[2]);
+        const __m128 Weight3 = _mm_set1_ps(Weights[3]);
+        __m128 TotalError = _mm_setzero_ps();
+        for (uint32_t Group = 0; Group < 16; Group += 4)
+        {
+            const __m128 C0 = _mm_load_ps(&Block.Channels[0][Group]);
+            const __m128 C1 = _mm_load_ps(&Block.Channels[1][Group]);
+            const __m128 C2 = _mm_load_ps(&Block.Channels[2][Group]);
+            const __m128 C3 = _mm_load_ps(&Block.Channels[3][Group]);
+            __m128 BestError = _mm_set1_ps(FLT_MAX);
+            __m128i BestIndex = _mm_setzero_si128();
+            for (uint32_t Entry = 0; Entry < PaletteNum; ++Entry)
+            {
+                const __m128 D0 = _mm_sub_ps(C0, _mm_set1_ps(Palette[Entry].Values[0]));
+                const __m128 D1 = _mm_sub_ps(C1, _mm_set1_ps(Palette[Entry].Values[1]));
+                const __m128 D2 = _mm_sub_ps(C2, _mm_set1_ps(Palette[Entry].Values[2]));
+                const __m128 D3 = _mm_sub_ps(C3, _mm_set1_ps(Palette[Entry].Values[3]));
+                __m128 Error = _mm_mul_ps(_mm_mul_ps(D0, D0), Weight0);
+                Error = _mm_add_ps(Error, _mm_mul_ps(_mm_mul_ps(D1, D1), Weight1));
+                Error = _mm_add_ps(Error, _mm_mul_ps(_mm_mul_ps(D2, D2), Weight2));
+                Error = _mm_add_ps(Error, _mm_mul_ps(_mm_mul_ps(D3, D3), Weight3));
+
+                const __m128i Closer = _mm_castps_si128(_mm_cmplt_ps(Error, BestError));
+                BestIndex = _mm_or_si128(_mm_and_si128(Closer, _mm_set1_epi32(static_cast<int>(Entry))), _mm_andnot_si128(Closer, BestIndex));
+                BestError = _mm_min_ps(Error, BestError);
+            }
+            alignas(16) int32_t Indices[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(Indices), BestIndex);
+            for (uint32_t Lane = 0; Lane < 4; ++Lane)
+            {
+                OutIndices[Group + Lane] = static_cast<uint8_t>(Indices[Lane]);
+            }
+            TotalError = _mm_add_ps(TotalError, BestError);
+        }
+        alignas(16) float Errors[4];
+        _mm_store_ps(Errors, TotalError);
+        return Errors[0] + Errors[1] + Errors[2] + Errors[3];
+    }
+
+    // Endpoints along the principal axis of the weighted channels, spanning the pixels' projections
+    void PrincipalEndpoints(const FBlockPixels& Block, uint32_t ChannelNum, FColor& OutStart, FColor& OutEnd)
+    {
+        float Mean[4] = {};
+        for (uint32_t Channel = 0; Channel < ChannelNum; ++Channel)
+        {
+            for (uint32_t Pixel = 0; Pixel < 16; ++Pixel)
+            {
+                Mean[Channel] += Block.Channels[Channel][Pixel];
+            }
+            Mean[Channel] /= 16.0f;
+        }
+
+        float Covariance[4][4] = {};
+        for (uint32_t Pixel = 0; Pixel < 16; ++Pixel)
+        {
+            for (uint32_t Row = 0; Row < ChannelNum; ++Row)
+            {
+                for (uint32_t Column = Row; Column < ChannelNum; ++Column)
+                {
+                    Covariance[Row][Column] += (Block.Channels[Row][Pixel] - Mean[Row]) * (Block.Channels[Column][Pixel] - Mean[Column]);
+                }
+            }
+        }
+        for (uint32_t Row = 0; Row < ChannelNum; ++Row)
+        {
+            for (uint32_t Column = 0; Column < Row; ++Column)
+            {
+                Covariance[Row][Column] = Covariance[Column][Row];
+            }
+        }
+
+        // Power iteration, seeded with the diagonal so a dominant channel converges at once
+        float Axis[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+        for (uint32_t Channel = 0; Channel < ChannelNum; ++Channel)
+        {
+            Axis[Channel] = Covariance[Channel][Channel] + 1e-3f * (Channel + 1);
+        }
+        for (uint32_t Iteration = 0; Iteration < 8; ++Iteration)
+        {
+            float Next[4] = {};
+            float Length = 0.0f;
+            for (uint32_t Row = 0; Row < ChannelNum; ++Row)
+            {
+                for (uint32_t Column = 0; Column < ChannelNum; ++Column)
+                {
+                    Next[Row] += Covariance[Row][Column] * Axis[Column];
+                }
+                Length = std::max(Length, std::abs(Next[Row]));
+            }
+            if (Length < 1e-6f)
+            {
+                break;
+            }
+            for (uint32_t Channel = 0; Channel < ChannelNum; ++Channel)
+            {
+                Axis[Channel] = Next[Channel] / Length;
+            }
+        }
+        float AxisLengthSquared = 0.0f;
+        for (uint32_t Channel = 0; Channel < ChannelNum; ++Channel)
+        {
+            AxisLengthSquared += Axis[Channel] * Axis[Channel];
+        }
+
+        float MinProjection = FLT_MAX;
+        float MaxProjection = -FLT_MAX;
+        for (uint32_t Pixel = 0; Pixel < 16; ++Pixel)
+        {
+            float Projection = 0.0f;
+            for (uint32_t Channel = 0; Channel < ChannelNum; ++Channel)
+            {
+                Projection += (Block.Channels[Channel][Pixel] - Mean[Channel]) * Axis[Channel];
+            }
+            MinProjection = std::min(MinProjection, Projection);
+            MaxProjection = std::max(MaxProjection, Projection);
+        }
+        const float Scale = AxisLengthSquared > 0.0f ? 1.0f / AxisLengthSquared : 0.0f;
+        for (uint32_t Channel = 0; Channel < 4; ++Channel)
+        {
+            const float Direction = Channel < ChannelNum ? Axis[Channel] * Scale : 0.0f;
+            OutStart.Values[Channel] = std::clamp(Mean[Channel] + Direction * MinProjection, 0.0f, 255.0f);
+            OutEnd.Values[Channel] = std::clamp(Mean[Channel] + Direction * MaxProjection, 0.0f, 255.0f);
+        }
+    }
+
+    // Least squares endpoints for fixed interpolation weights, false when the weights are degenerate
+    bool FitEndpoints(const FBlockPixels& Block, const float* Weights, uint32_t ChannelNum, FColor& OutStart, FColor& OutEnd)
+    {
+        float AA = 0.0f, AB = 0.0f, BB = 0.0f;
+        float AX[4] = {}, BX[4] = {};
+        for (uint32_t Pixel = 0; Pixel < 16; ++Pixel)
+        {
+            const float B = Weights[Pixel];
+            const float A = 1.0f - B;
+            AA += A * A;
+            AB += A * B;
+            BB += B * B;
+            for (uint32_t Channel = 0; Channel < ChannelNum; ++Channel)
+            {
+                AX[Channel] += A * Block.Channels[Channel][Pixel];
+                BX[Channel] += B * Block.Channels[Channel][Pixel];
+            }
+        }
+        const float Determinant = AA * BB - AB * AB;
+        if (std::abs(Determinant) < 1e-6f)
+        {
+            return false;
+        }
+        const float InvDeterminant = 1.0f / Determinant;
+        for (uint32_t Channel = 0; Channel < ChannelNum; ++Channel)
+        {
+            OutStart.Values[Channel] = std::clamp((AX[Channel] * BB - BX[Channel] * AB) * InvDeterminant, 0.0f, 255.0f);
+            OutEnd.Values[Channel] = std::clamp((BX[Channel] * AA - AX[Channel] * AB) * InvDeterminant, 0.0f, 255.0f);
+        }
+        return true;
+    }
+
+    uint16_t QuantizeRGB565(const FColor& Color)
+    {
+        const uint32_t R = static_cast<uint32_t>(Color.Values[0] * 31.0f / 255.0f + 0.5f);
+        const uint32_t G = static_cast<uint32_t>(Color.Values[1] * 63.0f / 255.0f + 0.5f);
+        const uint32_t B = static_cast<uint32_t>(Color.Values[2] * 31.0f / 255.0f + 0.5f);
+        return static_cast<uint16_t>((R << 11) | (G << 5) | B);
+    }
+
+    FColor ExpandRGB565(uint16_t Value)
+    {
+        const uint32_t R = (Value >> 11) & 31;
+        const uint32_t G = (Value >> 5) & 63;
+        const uint32_t B = Value & 31;
+        return {{static_cast<float>((R << 3) | (R >> 2)), static_cast<float>((G << 2) | (G >> 4)), static_cast<float>((B << 3) | (B >> 2)), 255.0f}};
+    }
+
+    // Four color mode only, BC3 color blocks can't use the punch-through mode anyway
+    float EncodeColorEndpoints(const FBlockPixels& Block, uint16_t Color0, uint16_t Color1, uint8_t* OutIndices)
+    {
+        static constexpr float ColorWeights[4] = {1.0f, 1.0f, 1.0f, 0.0f};
+        const FColor Start = ExpandRGB565(Color0);
+        const FColor End = ExpandRGB565(Color1);
+        FColor Palette[4] = {Start, End, {}, {}};
+        for (uint32_t Channel = 0; Channel < 4; ++Channel)
+        {
+            Palette[2].Values[Channel] = (2.0f * Start.Values[Channel] + End.Values[Channel]) / 3.0f;
+            Palette[3].Values[Channel] = (Start.Values[Channel] + 2.0f * End.Values[Channel]) / 3.0f;
+        }
+        return SelectIndices(Block, Palette, 4, ColorWeights, OutIndices);
+    }
+
+    void EncodeColorBlock(const FBlockPixels& Block, uint8_t* OutBlock)
+    {
+        FColor Start, End;
+        PrincipalEndpoints(Block, 3, Start, End);
+        uint16_t Color0 = QuantizeRGB565(End);
+        uint16_t Color1 = QuantizeRGB565(Start);
+        uint8_t Indices[16];
+        float Error = EncodeColorEndpoints(Block, Color0, Color1, Indices);
+
+        // One least squares refinement over the chosen indices
+        static constexpr float IndexWeights[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+        float Weights[16];
+        for (uint32_t Pixel = 0; Pixel < 16; ++Pixel)
+        {
+            Weights[Pixel] = IndexWeights[Indices[Pixel]];
+        }
+        FColor FitStart, FitEnd;
+        if (FitEndpoints(Block, Weights, 3, FitStart, FitEnd))
+        {
+            const uint16_t FitColor0 = QuantizeRGB565(FitStart);
+            const uint16_t FitColor1 = QuantizeRGB565(FitEnd);
+            uint8_t FitIndices[16];
+            const float FitError = EncodeColorEndpoints(Block, FitColor0, FitColor1, FitIndices);
+            if (FitError < Error)
+            {
+                Color0 = FitColor0;
+                Color1 = FitColor1;
+                memcpy(Indices, FitIndices, sizeof(Indices));
+            }
+        }
+
+        // Four color mode needs Color0 > Color1, swapping the endpoints mirrors the indices
+        if (Color0 < Color1)
+        {
+            std::swap(Color0, Color1);
+            static constexpr uint8_t Swapped[4] = {1, 0, 3, 2};
+            for (uint8_t& Index : Indices)
+            {
+                Index = Swapped[Index];
+            }
+        }
+        else if (Color0 == Color1)
+        {
+            memset(Indices, 0, sizeof(Indices));
+        }
+
+        uint32_t IndexBits = 0;
+        for (uint32_t Pixel = 0; Pixel < 16; ++Pixel)
+        {
+            IndexBits |= static_cast<uint32_t>(Indices[Pixel]) << (Pixel * 2);
+        }
+        memcpy(OutBlock, &Color0, 2);
+        memcpy(OutBlock + 2, &Color1, 2);
+        memcpy(OutBlock + 4, &IndexBits, 4);
+    }
+
+    void EncodeSingleChannel(const uint8_t* Pixels, uint32_t Channel, uint8_t* OutBlock)
+    {
+        uint8_t Min = 255, Max = 0;
+        for (uint32_t Pixel = 0; Pixel < 16; ++Pixel)
+        {
+            Min = std::min(Min, Pixels[Pixel * 4 + Channel]);
+            Max = std::max(Max, Pixels[Pixel * 4 + Channel]);
+        }
+        OutBlock[0] = Max;
+        OutBlock[1] = Min;
+
+        uint64_t IndexBits = 0;
+        if (Max > Min)
+        {
+            // Eight value mode: index 0 is Max, 1 is Min, 2..7 step from Max to Min
+            static constexpr uint8_t RampToIndex[8] = {0, 2, 3, 4, 5, 6, 7, 1};
+            const float Range = static_cast<float>(Max - Min);
+            for (uint32_t Pixel = 0; Pixel < 16; ++Pixel)
+            {
+                const float Position = (Max - Pixels[Pixel * 4 + Channel]) * 7.0f / Range;
+                const uint32_t Ramp = static_cast<uint32_t>(Position + 0.5f);
+                IndexBits |= static_cast<uint64_t>(RampToIndex[Ramp]) << (Pixel * 3);
+            }
+        }
+        memcpy(OutBlock + 2, &IndexBits, 6);
+    }
+
+    // BC7 mode 6 interpolation weights
+    constexpr uint32_t BC7Weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    struct FBC7Endpoints
+    {
+        uint8_t Values[2][4];
+        uint8_t PBits[2];
+    };
+
+    float EvaluateBC7(const FBlockPixels& Block, const FBC7Endpoints& Endpoints, uint8_t* OutIndices)
+    {
+        static constexpr float ChannelWeights[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+        FColor Palette[16];
+        for (uint32_t Entry = 0; Entry < 16; ++Entry)
+        {
+            for (uint32_t Channel = 0; Channel < 4; ++Channel)
+            {
+                const uint32_t Start = (Endpoints.Values[0][Channel] << 1) | Endpoints.PBits[0];
+                const uint32_t End = (Endpoints.Values[1][Channel] << 1) | Endpoints.PBits[1];
+                Palette[Entry].Values[Channel] = static_cast<float>(((64 - BC7Weights[Entry]) * Start + BC7Weights[Entry] * End + 32) >> 6);
+            }
+        }
+        return SelectIndices(Block, Palette, 16, ChannelWeights, OutIndices);
+    }
+
+    // Tries all p-bit pairs for the float endpoints and keeps the best quantization
+    float QuantizeBC7(const FBlockPixels& Block, const FColor& Start, const FColor& End, FBC7Endpoints& OutEndpoints, uint8_t* OutIndices)
+    {
+        float BestError = FLT_MAX;
+        for (uint32_t PBits = 0; PBits < 4; ++PBits)
+        {
+            FBC7Endpoints Endpoints;
+            Endpoints.PBits[0] = PBits & 1;
+            Endpoints.PBits[1] = PBits >> 1;
+            for (uint32_t Channel = 0; Channel < 4; ++Channel)
+            {
+                Endpoints.Values[0][Channel] = static_cast<uint8_t>(std::clamp((Start.Values[Channel] - Endpoints.PBits[0]) * 0.5f + 0.5f, 0.0f, 127.0f));
+                Endpoints.Values[1][Channel] = static_cast<uint8_t>(std::clamp((End.Values[Channel] - Endpoints.PBits[1]) * 0.5f + 0.5f, 0.0f, 127.0f));
+            }
+            uint8_t Indices[16];
+            const float Error = EvaluateBC7(Block, Endpoints, Indices);
+            if (Error < BestError)
+            {
+                BestError = Error;
+                OutEndpoints = Endpoints;
+                memcpy(OutIndices, Indices, 16);
+            }
+        }
+        return BestError;
+    }
+
+    // Appends Count bits LSB first
+    struct FBitWriter
+    {
+        uint8_t* Data;
+        uint32_t Position = 0;
+
+        void Write(uint32_t Value, uint32_t Count)
+        {
+            for (uint32_t Bit = 0; Bit < Count; ++Bit, ++Position)
+            {
+                Data[Position / 8] |= static_cast<uint8_t>(((Value >> Bit) & 1) << (Position % 8));
+            }
+        }
+    };
+
+    struct FBitReader
+    {
+        const uint8_t* Data;
+        uint32_t Position = 0;
+
+        uint32_t Read(uint32_t Count)
+        {
+            uint32_t Value = 0;
+            for (uint32_t Bit = 0; Bit < Count; ++Bit, ++Position)
+            {
+                Value |= static_cast<uint32_t>((Data[Position / 8] >> (Position % 8)) & 1) << Bit;
+            }
+            return Value;
+        }
+    };
+
+    // Writes the RGB of 16 pixels, BC3 color blocks always use the four color mode
+    void DecodeColorBlock(const uint8_t* Block, bool bAllowThreeColor, uint8_t* OutPixels)
+    {
+        uint16_t Color0, Color1;
+        uint32_t IndexBits;
+        memcpy(&Color0, Block, 2);
+        memcpy(&Color1, Block + 2, 2);
+        memcpy(&IndexBits, Block + 4, 4);
+
+        const FColor Start = ExpandRGB565(Color0);
+        const FColor End = ExpandRGB565(Color1);
+        const bool bFourColor = Color0 > Color1 || !bAllowThreeColor;
+        uint8_t Palette[4][4];
+        for (uint32_t Channel = 0; Channel < 3; ++Channel)
+        {
+            const uint32_t A = static_cast<uint32_t>(Start.Values[Channel]);
+            const uint32_t B = static_cast<uint32_t>(End.Values[Channel]);
+            Palette[0][Channel] = static_cast<uint8_t>(A);
+            Palette[1][Channel] = static_cast<uint8_t>(B);
+            Palette[2][Channel] = static_cast<uint8_t>(bFourColor ? (2 * A + B + 1) / 3 : (A + B) / 2);
+            Palette[3][Channel] = static_cast<uint8_t>(bFourColor ? (A + 2 * B + 1) / 3 : 0);
+        }
+        for (uint32_t Entry = 0; Entry < 4; ++Entry)
+        {
+            Palette[Entry][3] = bFourColor || Entry < 3 ? 255 : 0;
+        }
+        for (uint32_t Pixel = 0; Pixel < 16; ++Pixel)
+        {
+            memcpy(&OutPixels[Pixel * 4], Palette[(IndexBits >> (Pixel * 2)) & 3], bAllowThreeColor ? 4 : 3);
+        }
+    }
+
+    void DecodeSingleChannel(const uint8_t* Block, uint32_t Channel, uint8_t* OutPixels)
+    {
+        const uint32_t Value0 = Block[0];
+        const uint32_t Value1 = Block[1];
+        uint64_t IndexBits = 0;
+        memcpy(&IndexBits, Block + 2, 6);
+
+        uint8_t Palette[8] = {static_cast<uint8_t>(Value0), static_cast<uint8_t>(Value1)};
+        if (Value0 > Value1)
+        {
+            for (uint32_t Entry = 2; Entry < 8; ++Entry)
+            {
+                Palette[Entry] = static_cast<uint8_t>(((8 - Entry) * Value0 + (Entry - 1) * Value1 + 3) / 7);
+            }
+        }
+        else
+        {
+            for (uint32_t Entry = 2; Entry < 6; ++Entry)
+            {
+                Palette[Entry] = static_cast<uint8_t>(((6 - Entry) * Value0 + (Entry - 1) * Value1 + 2) / 5);
+            }
+            Palette[6] = 0;
+            Palette[7] = 255;
+        }
+        for (uint32_t Pixel = 0; Pixel < 16; ++Pixel)
+        {
+            OutPixels[Pixel * 4 + Channel] = Palette[(IndexBits >> (Pixel * 3)) & 7];
+        }
+    }
+
+    void DecodeBC7Block(const uint8_t* Block, uint8_t* OutPixels)
+    {
+        // Mode 6 is six zero bits followed by a one
+        if ((Block[0] & 0x7f) != 0x40)
+        {
+            memset(OutPixels, 0, 16 * 4);
+            return;
+        }
+
+        FBitReader Reader{Block, 7};
+        uint32_t Endpoints[2][4];
+        for (uint32_t Channel = 0; Channel < 4; ++Channel)
+        {
+            Endpoints[0][Channel] = Reader.Read(7);
+            Endpoints[1][Channel] = Reader.Read(7);
+        }
+        const uint32_t PBits[2] = {Reader.Read(1), Reader.Read(1)};
+        for (uint32_t Pixel = 0; Pixel < 16; ++Pixel)
+        {
+            const uint32_t Weight = BC7Weights[Reader.Read(Pixel == 0 ? 3 : 4)];
+            for (uint32_t Channel = 0; Channel < 4; ++Channel)
+            {
+                const uint32_t Start = (Endpoints[0][Channel] << 1) | PBits[0];
+                const uint32_t End = (Endpoints[1][Channel] << 1) | PBits[1];
+                OutPixels[Pixel * 4 + Channel] = static_cast<uint8_t>(((64 - Weight) * Start + Weight * End + 32) >> 6);
+            }
+        }
+    }
+}
+
+uint32_t FTextureCompressor::GetBlockBytes(ETextureCompression Compression)
+{
+    switch (Compression)
+    {
+    case ETextureCompression::BC1:
+    case ETextureCompression::BC4:
+        return 8;
+    case ETextureCompression::BC3:
+    case ETextureCompression::BC5:
+    case ETextureCompression::BC7:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+VkFormat FTextureCompressor::GetFormat(ETextureCompression Compression, bool bSRGB)
+{
+    switch (Compression)
+    {
+    case ETextureCompression::BC1: return bSRGB ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    case ETextureCompression::BC3: return bSRGB ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+    case ETextureCompression::BC4: return VK_FORMAT_BC4_UNORM_BLOCK;
+    case ETextureCompression::BC5: return VK_FORMAT_BC5_UNORM_BLOCK;
+    case ETextureCompression::BC7: return bSRGB ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+    default: return bSRGB ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+    }
+}
+
+void FTextureCompressor::EncodeBC1(const uint8_t* Pixels, uint8_t* OutBlock)
+{
+    FBlockPixels Block;
+    LoadBlock(Pixels, Block);
+    EncodeColorBlock(Block, OutBlock);
+}
+
+void FTextureCompressor::EncodeBC3(const uint8_t* Pixels, uint8_t* OutBlock)
+{
+    EncodeSingleChannel(Pixels, 3, OutBlock);
+    FBlockPixels Block;
+    LoadBlock(Pixels, Block);
+    EncodeColorBlock(Block, OutBlock + 8);
+}
+
+void FTextureCompressor::EncodeBC4(const uint8_t* Pixels, uint32_t Channel, uint8_t* OutBlock)
+{
+    EncodeSingleChannel(Pixels, Channel, OutBlock);
+}
+
+void FTextureCompressor::EncodeBC5(const uint8_t* Pixels, uint8_t* OutBlock)
+{
+    EncodeSingleChannel(Pixels, 0, OutBlock);
+    EncodeSingleChannel(Pixels, 1, OutBlock + 8);
+}
+
+void FTextureCompressor::EncodeBC7(const uint8_t* Pixels, uint8_t* OutBlock)
+{
+    FBlockPixels Block;
+    LoadBlock(Pixels, Block);
+
+    FColor Start, End;
+    PrincipalEndpoints(Block, 4, Start, End);
+    FBC7Endpoints Endpoints;
+    uint8_t Indices[16];
+    float Error = QuantizeBC7(Block, Start, End, Endpoints, Indices);
+
+    // Refit the endpoints to the chosen weights, keep whichever quantizes better
+    for (uint32_t Iteration = 0; Iteration < 2; ++Iteration)
+    {
+        float Weights[16];
+        for (uint32_t Pixel = 0; Pixel < 16; ++Pixel)
+        {
+            Weights[Pixel] = BC7Weights[Indices[Pixel]] / 64.0f;
+        }
+        FColor FitStart, FitEnd;
+        if (!FitEndpoints(Block, Weights, 4, FitStart, FitEnd))
+        {
+            break;
+        }
+        FBC7Endpoints FitEndpointsResult;
+        uint8_t FitIndices[16];
+        const float FitError = QuantizeBC7(Block, FitStart, FitEnd, FitEndpointsResult, FitIndices);
+        if (FitError >= Error)
+        {
+            break;
+        }
+        Error = FitError;
+        Endpoints = FitEndpointsResult;
+        memcpy(Indices, FitIndices, sizeof(Indices));
+    }
+
+    // The anchor index drops its top bit, swapping the endpoints mirrors the indices
+    if (Indices[0] & 8)
+    {
+        std::swap(Endpoints.Values[0], Endpoints.Values[1]);
+        std::swap(Endpoints.PBits[0], Endpoints.PBits[1]);
+        for (uint8_t& Index : Indices)
+        {
+            Index = 15 - Index;
+        }
+    }
+
+    memset(OutBlock, 0, 16);
+    FBitWriter Writer{OutBlock};
+    Writer.Write(1u << 6, 7);
+    for (uint32_t Channel = 0; Channel < 4; ++Channel)
+    {
+        Writer.Write(Endpoints.Values[0][Channel], 7);
+        Writer.Write(Endpoints.Values[1][Channel], 7);
+    }
+    Writer.Write(Endpoints.PBits[0], 1);
+    Writer.Write(Endpoints.PBits[1], 1);
+    Writer.Write(Indices[0], 3);
+    for (uint32_t Pixel = 1; Pixel < 16; ++Pixel)
+    {
+        Writer.Write(Indices[Pixel], 4);
+    }
+}
+
+void FTextureCompressor::CompressImage(const uint8_t* Pixels, uint32_t Width, uint32_t Height, ETextureCompression Compression, std::vector<uint8_t>& OutData)
+{
+    const uint32_t BlockBytes = GetBlockBytes(Compression);
+    checkf(BlockBytes > 0, "FTextureCompressor::CompressImage %u is not a block format", static_cast<uint32_t>(Compression));
+
+    const uint32_t BlocksX = (Width + 3) / 4;
+    const uint32_t BlocksY = (Height + 3) / 4;
+    OutData.resize(static_cast<size_t>(BlocksX) * BlocksY * BlockBytes);
+
+    FJobSystem::Get()->ParallelFor(BlocksY, 4, [&](uint32_t Begin, uint32_t End)
+    {
+        uint8_t BlockPixels[16 * 4];
+        for (uint32_t BlockY = Begin; BlockY < End; ++BlockY)
+        {
+            for (uint32_t BlockX = 0; BlockX < BlocksX; ++BlockX)
+            {
+                for (uint32_t Y = 0; Y < 4; ++Y)
+                {
+                    const uint32_t SourceY = std::min(BlockY * 4 + Y, Height - 1);
+                    for (uint32_t X = 0; X < 4; ++X)
+                    {
+                        const uint32_t SourceX = std::min(BlockX * 4 + X, Width - 1);
+                        memcpy(&BlockPixels[(Y * 4 + X) * 4], &Pixels[(static_cast<size_t>(SourceY) * Width + SourceX) * 4], 4);
+                    }
+                }
+
+                uint8_t* Block = &OutData[(static_cast<size_t>(BlockY) * BlocksX + BlockX) * BlockBytes];
+                switch (Compression)
+                {
+                case ETextureCompression::BC1: EncodeBC1(BlockPixels, Block); break;
+                case ETextureCompression::BC3: EncodeBC3(BlockPixels, Block); break;
+                case ETextureCompression::BC4: EncodeBC4(BlockPixels, 0, Block); break;
+                case ETextureCompression::BC5: EncodeBC5(BlockPixels, Block); break;
+                case ETextureCompression::BC7: EncodeBC7(BlockPixels, Block); break;
+                default: break;
+                }
+            }
+        }
+    });
+}
+
+void FTextureCompressor::DecompressImage(const uint8_t* Data, uint32_t Width, uint32_t Height, ETextureCompression Compression, std::vector<uint8_t>& OutPixels)
+{
+    const uint32_t BlockBytes = GetBlockBytes(Compression);
+    checkf(BlockBytes > 0, "FTextureCompressor::DecompressImage %u is not a block format", static_cast<uint32_t>(Compression));
+
+    const uint32_t BlocksX = (Width + 3) / 4;
+    const uint32_t BlocksY = (Height + 3) / 4;
+    OutPixels.resize(static_cast<size_t>(Width) * Height * 4);
+
+    uint8_t BlockPixels[16 * 4];
+    for (uint32_t BlockY = 0; BlockY < BlocksY; ++BlockY)
+    {
+        for (uint32_t BlockX = 0; BlockX < BlocksX; ++BlockX)
+        {
+            const uint8_t* Block = &Data[(static_cast<size_t>(BlockY) * BlocksX + BlockX) * BlockBytes];
+            for (uint32_t Pixel = 0; Pixel < 16; ++Pixel)
+            {
+                BlockPixels[Pixel * 4 + 0] = 0;
+                BlockPixels[Pixel * 4 + 1] = 0;
+                BlockPixels[Pixel * 4 + 2] = 0;
+                BlockPixels[Pixel * 4 + 3] = 255;
+            }
+            switch (Compression)
+            {
+            case ETextureCompression::BC1: DecodeColorBlock(Block, true, BlockPixels); break;
+            case ETextureCompression::BC3: DecodeSingleChannel(Block, 3, BlockPixels); DecodeColorBlock(Block + 8, false, BlockPixels); break;
+            case ETextureCompression::BC4: DecodeSingleChannel(Block, 0, BlockPixels); break;
+            case ETextureCompression::BC5: DecodeSingleChannel(Block, 0, BlockPixels); DecodeSingleChannel(Block + 8, 1, BlockPixels); break;
+            case ETextureCompression::BC7: DecodeBC7Block(Block, BlockPixels); break;
+            default: break;
+            }
+
+            // Edge blocks only write the pixels inside the image
+            for (uint32_t Y = 0; Y < 4 && BlockY * 4 + Y < Height; ++Y)
+            {
+                for (uint32_t X = 0; X < 4 && BlockX * 4 + X < Width; ++X)
+                {
+                    memcpy(&OutPixels[(static_cast<size_t>(BlockY * 4 + Y) * Width + BlockX * 4 + X) * 4], &BlockPixels[(Y * 4 + X) * 4], 4);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,42 @@
+﻿#pragma once
+#include <cstdint>
+#include <vector>
+#include "vulkan/vulkan_core.h"
+
+enum class ETextureCompression : uint8_t
+{
+    None,
+    // RGB, 4 bpp
+    BC1,
+    // RGBA with BC4 alpha, 8 bpp
+    BC3,
+    // Single channel from red, 4 bpp
+    BC4,
+    // Two channels from red and green, normal maps, 8 bpp
+    BC5,
+    // RGBA, 8 bpp
+    BC7,
+};
+
+// CPU block compression of RGBA8 images. Palette index selection runs 4 pixels per SSE lane group,
+// images are split into block rows on FJobSystem.
+// BC7 only uses mode 6 (single subset, 7.7.7.7 + p-bit endpoints, 4 bit indices).
+class FTextureCompressor
+{
+public:
+    static uint32_t GetBlockBytes(ETextureCompression Compression);
+    static VkFormat GetFormat(ETextureCompression Compression, bool bSRGB);
+
+    // 16 RGBA8 pixels of a 4x4 block, rows top to bottom
+    static void EncodeBC1(const uint8_t* Pixels, uint8_t* OutBlock);
+    static void EncodeBC3(const uint8_t* Pixels, uint8_t* OutBlock);
+    static void EncodeBC4(const uint8_t* Pixels, uint32_t Channel, uint8_t* OutBlock);
+    static void EncodeBC5(const uint8_t* Pixels, uint8_t* OutBlock);
+    static void EncodeBC7(const uint8_t* Pixels, uint8_t* OutBlock);
+
+    // Edge blocks of sizes that aren't a multiple of 4 repeat the last row and column
+    static void CompressImage(const uint8_t* Pixels, uint32_t Width, uint32_t Height, ETextureCompression Compression, std::vector<uint8_t>& OutData);
+    // Reference decoder to measure encode quality. Channels a format doesn't store read like a sampler returns them,
+    // 0 for color and 255 for alpha. BC7 only decodes mode 6, the one mode EncodeBC7 writes, other blocks decode to 0
+    static void DecompressImage(const uint8_t* Data, uint32_t Width, uint32_t Height, ETextureCompression Compression, std::vector<uint8_t>& OutPixels);
+};
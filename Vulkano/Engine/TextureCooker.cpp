@@ -0,0 +1,304 @@
+﻿#include "TextureCooker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include "Core/JobSystem.h"
+#include "Core/VulkanoLog.h"
+
+namespace
+{
+    constexpr uint32_t CookedTextureMagic = 0x58544B56; // "VKTX"
+    constexpr uint32_t CookedTextureVersion = 1;
+
+    struct FCookedTextureHeader
+    {
+        uint32_t Magic;
+        uint32_t Version;
+        uint32_t Format;
+        uint32_t Width;
+        uint32_t Height;
+        uint32_t MipNum;
+    };
+
+    // Linear float RGBA image used while filtering
+    struct FFloatImage
+    {
+        uint32_t Width = 0;
+        uint32_t Height = 0;
+        std::vector<float> Pixels;
+    };
+
+    float SRGBToLinear(float Value)
+    {
+        return Value <= 0.04045f ? Value / 12.92f : std::pow((Value + 0.055f) / 1.055f, 2.4f);
+    }
+
+    float LinearToSRGB(float Value)
+    {
+        return Value <= 0.0031308f ? Value * 12.92f : 1.055f * std::pow(Value, 1.0f / 2.4f) - 0.055f;
+    }
+
+    struct FFilterTap
+    {
+        uint32_t Source;
+        float Weight;
+    };
+
+    // Taps of each destination pixel, weighted by how much of the source pixel its footprint covers
+    void BuildFilterTaps(uint32_t SourceSize, uint32_t DestinationSize, std::vector<uint32_t>& OutOffsets, std::vector<FFilterTap>& OutTaps)
+    {
+        const double Ratio = static_cast<double>(SourceSize) / DestinationSize;
+        OutOffsets.assign(DestinationSize + 1, 0);
+        OutTaps.clear();
+        for (uint32_t Destination = 0; Destination < DestinationSize; ++Destination)
+        {
+            const double Begin = Destination * Ratio;
+            const double End = Begin + Ratio;
+            for (uint32_t Source = static_cast<uint32_t>(Begin); Source < SourceSize && Source < End; ++Source)
+            {
+                const double Coverage = std::min<double>(Source + 1, End) - std::max<double>(Source, Begin);
+                if (Coverage > 1e-6)
+                {
+                    OutTaps.push_back({Source, static_cast<float>(Coverage / Ratio)});
+                }
+            }
+            OutOffsets[Destination + 1] = static_cast<uint32_t>(OutTaps.size());
+        }
+    }
+
+    void Downsample(const FFloatImage& Source, FFloatImage& OutImage)
+    {
+        OutImage.Width = std::max(1u, Source.Width / 2);
+        OutImage.Height = std::max(1u, Source.Height / 2);
+        OutImage.Pixels.assign(static_cast<size_t>(OutImage.Width) * OutImage.Height * 4, 0.0f);
+
+        std::vector<uint32_t> OffsetsX, OffsetsY;
+        std::vector<FFilterTap> TapsX, TapsY;
+        BuildFilterTaps(Source.Width, OutImage.Width, OffsetsX, TapsX);
+        BuildFilterTaps(Source.Height, OutImage.Height, OffsetsY, TapsY);
+
+        FJobSystem::Get()->ParallelFor(OutImage.Height, 16, [&](uint32_t Begin, uint32_t End)
+        {
+            std::vector<float> Row(static_cast<size_t>(Source.Width) * 4);
+            for (uint32_t Y = Begin; Y < End; ++Y)
+            {
+                // Vertical taps into one source row, then horizontal taps out of it
+                std::fill(Row.begin(), Row.end(), 0.0f);
+                for (uint32_t TapY = OffsetsY[Y]; TapY < OffsetsY[Y + 1]; ++TapY)
+                {
+                    const float* SourceRow = &Source.Pixels[static_cast<size_t>(TapsY[TapY].Source) * Source.Width * 4];
+                    const float Weight = TapsY[TapY].Weight;
+                    for (size_t Index = 0; Index < Row.size(); ++Index)
+                    {
+                        Row[Index] += SourceRow[Index] * Weight;
+                    }
+                }
+
+                float* OutRow = &OutImage.Pixels[static_cast<size_t>(Y) * OutImage.Width * 4];
+                for (uint32_t X = 0; X < OutImage.Width; ++X)
+                {
+                    for (uint32_t TapX = OffsetsX[X]; TapX < OffsetsX[X + 1]; ++TapX)
+                    {
+                        const float* SourcePixel = &Row[static_cast<size_t>(TapsX[TapX].Source) * 4];
+                        const float Weight = TapsX[TapX].Weight;
+                        for (uint32_t Channel = 0; Channel < 4; ++Channel)
+                        {
+                            OutRow[X * 4 + Channel] += SourcePixel[Channel] * Weight;
+                        }
+                    }
+                }
+            }
+        });
+    }
+
+    void ToFloat(const FImage& Image, bool bSRGB, bool bNormalMap, FFloatImage& OutImage)
+    {
+        float ToLinear[256];
+        for (uint32_t Value = 0; Value < 256; ++Value)
+        {
+            ToLinear[Value] = bSRGB ? SRGBToLinear(Value / 255.0f) : Value / 255.0f;
+        }
+
+        OutImage.Width = Image.Width;
+        OutImage.Height = Image.Height;
+        OutImage.Pixels.resize(Image.Pixels.size());
+        for (size_t Index = 0; Index < Image.Pixels.size(); Index += 4)
+        {
+            for (uint32_t Channel = 0; Channel < 3; ++Channel)
+            {
+                const uint8_t Value = Image.Pixels[Index + Channel];
+                OutImage.Pixels[Index + Channel] = bNormalMap ? Value / 127.5f - 1.0f : ToLinear[Value];
+            }
+            OutImage.Pixels[Index + 3] = Image.Pixels[Index + 3] / 255.0f;
+        }
+    }
+
+    void ToBytes(const FFloatImage& Image, bool bSRGB, bool bNormalMap, FImage& OutImage)
+    {
+        OutImage.Width = Image.Width;
+        OutImage.Height = Image.Height;
+        OutImage.Pixels.resize(Image.Pixels.size());
+        for (size_t Index = 0; Index < Image.Pixels.size(); Index += 4)
+        {
+            float Color[3] = {Image.Pixels[Index], Image.Pixels[Index + 1], Image.Pixels[Index + 2]};
+            if (bNormalMap)
+            {
+                const float Length = std::sqrt(Color[0] * Color[0] + Color[1] * Color[1] + Color[2] * Color[2]);
+                const float Scale = Length > 1e-6f ? 1.0f / Length : 0.0f;
+                for (float& Value : Color)
+                {
+                    Value = Value * Scale * 0.5f + 0.5f;
+                }
+            }
+            else if (bSRGB)
+            {
+                for (float& Value : Color)
+                {
+                    Value = LinearToSRGB(std::clamp(Value, 0.0f, 1.0f));
+                }
+            }
+            for (uint32_t Channel = 0; Channel < 3; ++Channel)
+            {
+                OutImage.Pixels[Index + Channel] = static_cast<uint8_t>(std::clamp(Color[Channel], 0.0f, 1.0f) * 255.0f + 0.5f);
+            }
+            OutImage.Pixels[Index + 3] = static_cast<uint8_t>(std::clamp(Image.Pixels[Index + 3], 0.0f, 1.0f) * 255.0f + 0.5f);
+        }
+    }
+}
+
+bool FTextureCooker::CookTexture(const std::string& SourcePath, const FTextureCookSettings& Settings, FCookedTexture& OutTexture)
+{
+    FImage Image;
+    if (!FImageDecoder::Decode(SourcePath, Image))
+    {
+        return false;
+    }
+    CookImage(Image, Settings, OutTexture);
+    VK_LOG(LOG_INFO, "Cooked %s %ux%u, %zu mips, %zu bytes", SourcePath.c_str(), OutTexture.Width, OutTexture.Height, OutTexture.Mips.size(), OutTexture.Data.size());
+    return true;
+}
+
+void FTextureCooker::CookImage(const FImage& Image, const FTextureCookSettings& Settings, FCookedTexture& OutTexture)
+{
+    const bool bSRGB = Settings.bSRGB && !Settings.bNormalMap;
+    std::vector<FImage> Mips;
+    if (Settings.bGenerateMips)
+    {
+        GenerateMips(Image, bSRGB, Settings.bNormalMap, Mips);
+    }
+    else
+    {
+        Mips.push_back(Image);
+    }
+
+    OutTexture.Format = FTextureCompressor::GetFormat(Settings.Compression, bSRGB);
+    OutTexture.Width = Image.Width;
+    OutTexture.Height = Image.Height;
+    OutTexture.Mips.clear();
+    OutTexture.Data.clear();
+
+    std::vector<uint8_t> Compressed;
+    for (const FImage& Mip : Mips)
+    {
+        const std::vector<uint8_t>* Level = &Mip.Pixels;
+        if (Settings.Compression != ETextureCompression::None)
+        {
+            FTextureCompressor::CompressImage(Mip.Pixels.data(), Mip.Width, Mip.Height, Settings.Compression, Compressed);
+            Level = &Compressed;
+        }
+
+        FCookedMip CookedMip;
+        CookedMip.Width = Mip.Width;
+        CookedMip.Height = Mip.Height;
+        CookedMip.Offset = (OutTexture.Data.size() + MipAlignment - 1) & ~static_cast<uint64_t>(MipAlignment - 1);
+        CookedMip.Size = Level->size();
+        OutTexture.Data.resize(CookedMip.Offset + CookedMip.Size);
+        memcpy(OutTexture.Data.data() + CookedMip.Offset, Level->data(), Level->size());
+        OutTexture.Mips.push_back(CookedMip);
+    }
+}
+
+void FTextureCooker::GenerateMips(const FImage& Image, bool bSRGB, bool bNormalMap, std::vector<FImage>& OutMips)
+{
+    OutMips.clear();
+    OutMips.push_back(Image);
+
+    // Every level is filtered from the previous float level, only the stored copies are quantized
+    FFloatImage Level;
+    ToFloat(Image, bSRGB, bNormalMap, Level);
+    while (Level.Width > 1 || Level.Height > 1)
+    {
+        FFloatImage Next;
+        Downsample(Level, Next);
+        ToBytes(Next, bSRGB, bNormalMap, OutMips.emplace_back());
+        Level = std::move(Next);
+    }
+}
+
+bool FTextureCooker::SaveCookedTexture(const std::string& FilePath, const FCookedTexture& Texture)
+{
+    std::ofstream File(FilePath, std::ios::binary | std::ios::out);
+    if (!File.is_open())
+    {
+        return false;
+    }
+
+    const FCookedTextureHeader Header = {
+        CookedTextureMagic,
+        CookedTextureVersion,
+        static_cast<uint32_t>(Texture.Format),
+        Texture.Width,
+        Texture.Height,
+        static_cast<uint32_t>(Texture.Mips.size())};
+    const uint64_t DataSize = Texture.Data.size();
+    File.write(reinterpret_cast<const char*>(&Header), sizeof(Header));
+    File.write(reinterpret_cast<const char*>(Texture.Mips.data()), Texture.Mips.size() * sizeof(FCookedMip));
+    File.write(reinterpret_cast<const char*>(&DataSize), sizeof(DataSize));
+    File.write(reinterpret_cast<const char*>(Texture.Data.data()), Texture.Data.size());
+    return File.good();
+}
+
+bool FTextureCooker::LoadCookedTexture(const std::string& FilePath, FCookedTexture& OutTexture)
+{
+    std::ifstream File(FilePath, std::ios::binary | std::ios::in);
+    if (!File.is_open())
+    {
+        return false;
+    }
+
+    FCookedTextureHeader Header = {};
+    File.read(reinterpret_cast<char*>(&Header), sizeof(Header));
+    if (!File.good() || Header.Magic != CookedTextureMagic || Header.Version != CookedTextureVersion)
+    {
+        return false;
+    }
+
+    uint64_t DataSize = 0;
+    OutTexture.Format = static_cast<VkFormat>(Header.Format);
+    OutTexture.Width = Header.Width;
+    OutTexture.Height = Header.Height;
+    OutTexture.Mips.resize(Header.MipNum);
+    File.read(reinterpret_cast<char*>(OutTexture.Mips.data()), OutTexture.Mips.size() * sizeof(FCookedMip));
+    File.read(reinterpret_cast<char*>(&DataSize), sizeof(DataSize));
+    if (!File.good())
+    {
+        return false;
+    }
+    OutTexture.Data.resize(DataSize);
+    File.read(reinterpret_cast<char*>(OutTexture.Data.data()), DataSize);
+    if (!File.good())
+    {
+        return false;
+    }
+
+    for (const FCookedMip& Mip : OutTexture.Mips)
+    {
+        if (Mip.Offset + Mip.Size > DataSize)
+        {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,52 @@
+﻿#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Engine/ImageDecoder.h"
+#include "Engine/TextureCompression.h"
+#include "vulkan/vulkan_core.h"
+
+struct FTextureCookSettings
+{
+    ETextureCompression Compression = ETextureCompression::BC7;
+    // Color data, mips are filtered in linear space and the texture is sampled as sRGB
+    bool bSRGB = true;
+    bool bGenerateMips = true;
+    // Tangent space normals, renormalized after filtering
+    bool bNormalMap = false;
+};
+
+struct FCookedMip
+{
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    // Byte range in FCookedTexture::Data, aligned for buffer to image copies
+    uint64_t Offset = 0;
+    uint64_t Size = 0;
+};
+
+// Cooked texture ready for upload: one staging copy of Data and a buffer to image copy per mip
+struct FCookedTexture
+{
+    VkFormat Format = VK_FORMAT_UNDEFINED;
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    std::vector<FCookedMip> Mips;
+    std::vector<uint8_t> Data;
+};
+
+// Offline texture pipeline: decode, linear space mip chain, block compression and a small KTX2 style container.
+// The container is a header, a level index and the level data in the GPU's block layout.
+class FTextureCooker
+{
+public:
+    static constexpr uint32_t MipAlignment = 16;
+
+    static bool CookTexture(const std::string& SourcePath, const FTextureCookSettings& Settings, FCookedTexture& OutTexture);
+    static void CookImage(const FImage& Image, const FTextureCookSettings& Settings, FCookedTexture& OutTexture);
+    // Box filter over the exact source footprint, so odd sizes don't shift the image
+    static void GenerateMips(const FImage& Image, bool bSRGB, bool bNormalMap, std::vector<FImage>& OutMips);
+
+    static bool SaveCookedTexture(const std::string& FilePath, const FCookedTexture& Texture);
+    static bool LoadCookedTexture(const std::string& FilePath, FCookedTexture& OutTexture);
+};
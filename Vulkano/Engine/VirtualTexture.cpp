@@ -0,0 +1,617 @@
+﻿#include "VirtualTexture.h"
+
+#include <algorithm>
+#include "Core/Assertion.h"
+
+uint32_t FVirtualPageId::Pack(uint32_t Texture, uint32_t Mip, uint32_t X, uint32_t Y)
+{
+    return (X & 0x3FF) | ((Y & 0x3FF) << 10) | ((Mip & 0xF) << 20) | ((Texture & 0xFF) << 24);
+}
+
+uint32_t FVirtualPageId::GetTexture(uint32_t PageId)
+{
+    return PageId >> 24;
+}
+
+uint32_t FVirtualPageId::GetMip(uint32_t PageId)
+{
+    return (PageId >> 20) & 0xF;
+}
+
+uint32_t FVirtualPageId::GetX(uint32_t PageId)
+{
+    return PageId & 0x3FF;
+}
+
+uint32_t FVirtualPageId::GetY(uint32_t PageId)
+{
+    return (PageId >> 10) & 0x3FF;
+}
+
+void FVirtualPageCache::Init(uint32_t SlotNum)
+{
+    Slots.assign(SlotNum, FSlot());
+    FreeSlots.resize(SlotNum);
+    // Handed out from the back, slot 0 first
+    for (uint32_t Slot = 0; Slot < SlotNum; ++Slot)
+    {
+        FreeSlots[Slot] = SlotNum - 1 - Slot;
+    }
+    PageToSlot.clear();
+    PageToSlot.reserve(SlotNum);
+    Head = InvalidSlot;
+    Tail = InvalidSlot;
+}
+
+uint32_t FVirtualPageCache::Find(uint32_t PageId) const
+{
+    auto It = PageToSlot.find(PageId);
+    return It != PageToSlot.end() ? It->second : InvalidSlot;
+}
+
+void FVirtualPageCache::Touch(uint32_t Slot, uint64_t Frame)
+{
+    FSlot& Entry = Slots[Slot];
+    Entry.LastUsedFrame = Frame;
+    if (!Entry.bLocked && Tail != Slot)
+    {
+        Unlink(Slot);
+        PushBack(Slot);
+    }
+}
+
+uint32_t FVirtualPageCache::Allocate(uint32_t PageId, uint64_t Frame, uint32_t& OutEvictedPageId)
+{
+    checkf(Find(PageId) == InvalidSlot, "FVirtualPageCache::Allocate page %08x is already resident", PageId);
+    OutEvictedPageId = FVirtualPageId::Invalid;
+
+    uint32_t Slot = InvalidSlot;
+    if (!FreeSlots.empty())
+    {
+        Slot = FreeSlots.back();
+        FreeSlots.pop_back();
+    }
+    else
+    {
+        if (Head == InvalidSlot || Slots[Head].LastUsedFrame >= Frame)
+        {
+            return InvalidSlot;
+        }
+        Slot = Head;
+        Unlink(Slot);
+        OutEvictedPageId = Slots[Slot].PageId;
+        PageToSlot.erase(OutEvictedPageId);
+    }
+
+    FSlot& Entry = Slots[Slot];
+    Entry.PageId = PageId;
+    Entry.LastUsedFrame = Frame;
+    Entry.bLocked = false;
+    PageToSlot.emplace(PageId, Slot);
+    PushBack(Slot);
+    return Slot;
+}
+
+void FVirtualPageCache::Free(uint32_t PageId)
+{
+    const uint32_t Slot = Find(PageId);
+    if (Slot == InvalidSlot)
+    {
+        return;
+    }
+    FSlot& Entry = Slots[Slot];
+    if (!Entry.bLocked)
+    {
+        Unlink(Slot);
+    }
+    Entry = FSlot();
+    PageToSlot.erase(PageId);
+    FreeSlots.push_back(Slot);
+}
+
+void FVirtualPageCache::Lock(uint32_t Slot)
+{
+    FSlot& Entry = Slots[Slot];
+    if (!Entry.bLocked)
+    {
+        Unlink(Slot);
+        Entry.bLocked = true;
+    }
+}
+
+uint32_t FVirtualPageCache::GetPageId(uint32_t Slot) const
+{
+    return Slots[Slot].PageId;
+}
+
+uint32_t FVirtualPageCache::GetSlotNum() const
+{
+    return static_cast<uint32_t>(Slots.size());
+}
+
+uint32_t FVirtualPageCache::GetResidentNum() const
+{
+    return static_cast<uint32_t>(PageToSlot.size());
+}
+
+void FVirtualPageCache::Unlink(uint32_t Slot)
+{
+    FSlot& Entry = Slots[Slot];
+    if (Entry.Previous != InvalidSlot)
+    {
+        Slots[Entry.Previous].Next = Entry.Next;
+    }
+    else
+    {
+        Head = Entry.Next;
+    }
+    if (Entry.Next != InvalidSlot)
+    {
+        Slots[Entry.Next].Previous = Entry.Previous;
+    }
+    else
+    {
+        Tail = Entry.Previous;
+    }
+    Entry.Previous = InvalidSlot;
+    Entry.Next = InvalidSlot;
+}
+
+void FVirtualPageCache::PushBack(uint32_t Slot)
+{
+    FSlot& Entry = Slots[Slot];
+    Entry.Previous = Tail;
+    Entry.Next = InvalidSlot;
+    if (Tail != InvalidSlot)
+    {
+        Slots[Tail].Next = Slot;
+    }
+    else
+    {
+        Head = Slot;
+    }
+    Tail = Slot;
+}
+
+uint32_t FVirtualPageTable::MakeEntry(uint32_t Slot, uint32_t Mip)
+{
+    return (Slot & 0xFFFFFF) | (Mip << 24);
+}
+
+uint32_t FVirtualPageTable::GetEntrySlot(uint32_t Entry)
+{
+    return Entry & 0xFFFFFF;
+}
+
+uint32_t FVirtualPageTable::GetEntryMip(uint32_t Entry)
+{
+    return Entry >> 24;
+}
+
+void FVirtualPageTable::Init(uint32_t InPagesX, uint32_t InPagesY, uint32_t InMipLevels)
+{
+    PagesX = InPagesX;
+    PagesY = InPagesY;
+    Levels.resize(InMipLevels);
+    DirtyRects.assign(InMipLevels, FDirtyRect());
+    for (uint32_t Mip = 0; Mip < InMipLevels; ++Mip)
+    {
+        Levels[Mip].assign(static_cast<size_t>(GetPagesX(Mip)) * GetPagesY(Mip), FVirtualPageId::Invalid);
+        // Everything starts dirty so the first upload writes the whole table
+        DirtyRects[Mip] = {0, 0, GetPagesX(Mip) - 1, GetPagesY(Mip) - 1};
+    }
+}
+
+void FVirtualPageTable::MapPage(uint32_t Mip, uint32_t X, uint32_t Y, uint32_t Slot)
+{
+    const uint32_t Entry = MakeEntry(Slot, Mip);
+    SetEntry(Mip, X, Y, Entry);
+
+    // Finer entries under this page switch over when they fell back to something coarser
+    for (uint32_t Level = Mip; Level-- > 0;)
+    {
+        const uint32_t Shift = Mip - Level;
+        const uint32_t EndX = std::min((X + 1) << Shift, GetPagesX(Level));
+        const uint32_t EndY = std::min((Y + 1) << Shift, GetPagesY(Level));
+        for (uint32_t PageY = Y << Shift; PageY < EndY; ++PageY)
+        {
+            for (uint32_t PageX = X << Shift; PageX < EndX; ++PageX)
+            {
+                const uint32_t Current = GetEntry(Level, PageX, PageY);
+                if (Current == FVirtualPageId::Invalid || GetEntryMip(Current) > Mip)
+                {
+                    SetEntry(Level, PageX, PageY, Entry);
+                }
+            }
+        }
+    }
+}
+
+void FVirtualPageTable::UnmapPage(uint32_t Mip, uint32_t X, uint32_t Y)
+{
+    const uint32_t Fallback = Mip + 1 < GetMipLevels() ? GetEntry(Mip + 1, std::min(X / 2, GetPagesX(Mip + 1) - 1), std::min(Y / 2, GetPagesY(Mip + 1) - 1)) : FVirtualPageId::Invalid;
+
+    // Only this page maps to Mip inside its own footprint
+    for (uint32_t Level = Mip + 1; Level-- > 0;)
+    {
+        const uint32_t Shift = Mip - Level;
+        const uint32_t EndX = std::min((X + 1) << Shift, GetPagesX(Level));
+        const uint32_t EndY = std::min((Y + 1) << Shift, GetPagesY(Level));
+        for (uint32_t PageY = Y << Shift; PageY < EndY; ++PageY)
+        {
+            for (uint32_t PageX = X << Shift; PageX < EndX; ++PageX)
+            {
+                const uint32_t Current = GetEntry(Level, PageX, PageY);
+                if (Current != FVirtualPageId::Invalid && GetEntryMip(Current) == Mip)
+                {
+                    SetEntry(Level, PageX, PageY, Fallback);
+                }
+            }
+        }
+    }
+}
+
+uint32_t FVirtualPageTable::GetEntry(uint32_t Mip, uint32_t X, uint32_t Y) const
+{
+    return Levels[Mip][static_cast<size_t>(Y) * GetPagesX(Mip) + X];
+}
+
+uint32_t FVirtualPageTable::GetPagesX(uint32_t Mip) const
+{
+    return std::max(1u, PagesX >> Mip);
+}
+
+uint32_t FVirtualPageTable::GetPagesY(uint32_t Mip) const
+{
+    return std::max(1u, PagesY >> Mip);
+}
+
+uint32_t FVirtualPageTable::GetMipLevels() const
+{
+    return static_cast<uint32_t>(Levels.size());
+}
+
+const std::vector<uint32_t>& FVirtualPageTable::GetLevel(uint32_t Mip) const
+{
+    return Levels[Mip];
+}
+
+const FVirtualPageTable::FDirtyRect& FVirtualPageTable::GetDirtyRect(uint32_t Mip) const
+{
+    return DirtyRects[Mip];
+}
+
+void FVirtualPageTable::ClearDirty()
+{
+    std::fill(DirtyRects.begin(), DirtyRects.end(), FDirtyRect());
+}
+
+void FVirtualPageTable::SetEntry(uint32_t Mip, uint32_t X, uint32_t Y, uint32_t Entry)
+{
+    uint32_t& Current = Levels[Mip][static_cast<size_t>(Y) * GetPagesX(Mip) + X];
+    if (Current == Entry)
+    {
+        return;
+    }
+    Current = Entry;
+    FDirtyRect& Dirty = DirtyRects[Mip];
+    Dirty.MinX = std::min(Dirty.MinX, X);
+    Dirty.MinY = std::min(Dirty.MinY, Y);
+    Dirty.MaxX = std::max(Dirty.MaxX, X);
+    Dirty.MaxY = std::max(Dirty.MaxY, Y);
+}
+
+FVirtualTextureStreamer::~FVirtualTextureStreamer()
+{
+    Stop();
+}
+
+void FVirtualTextureStreamer::Start(const FPageLoader& InLoader, uint32_t InPageBytes)
+{
+    check(!Thread.joinable());
+    Loader = InLoader;
+    PageBytes = InPageBytes;
+    bExit = false;
+    Thread = std::thread(&FVirtualTextureStreamer::LoaderLoop, this);
+}
+
+void FVirtualTextureStreamer::Stop()
+{
+    if (!Thread.joinable())
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        bExit = true;
+        Queue.clear();
+    }
+    WakeCondition.notify_all();
+    Thread.join();
+    InFlight.clear();
+    Completed.clear();
+}
+
+void FVirtualTextureStreamer::Request(uint32_t PageId)
+{
+    {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        if (!InFlight.insert(PageId).second)
+        {
+            return;
+        }
+        Queue.push_back(PageId);
+    }
+    WakeCondition.notify_one();
+}
+
+void FVirtualTextureStreamer::CollectCompleted(std::vector<FStreamedPage>& OutPages)
+{
+    std::lock_guard<std::mutex> Lock(Mutex);
+    for (FStreamedPage& Page : Completed)
+    {
+        InFlight.erase(Page.PageId);
+        OutPages.push_back(std::move(Page));
+    }
+    Completed.clear();
+}
+
+bool FVirtualTextureStreamer::IsInFlight(uint32_t PageId) const
+{
+    std::lock_guard<std::mutex> Lock(Mutex);
+    return InFlight.count(PageId) != 0;
+}
+
+uint32_t FVirtualTextureStreamer::GetInFlightNum() const
+{
+    std::lock_guard<std::mutex> Lock(Mutex);
+    return static_cast<uint32_t>(InFlight.size());
+}
+
+void FVirtualTextureStreamer::LoaderLoop()
+{
+    for (;;)
+    {
+        uint32_t PageId;
+        {
+            std::unique_lock<std::mutex> Lock(Mutex);
+            WakeCondition.wait(Lock, [this]() { return bExit || !Queue.empty(); });
+            if (bExit)
+            {
+                return;
+            }
+            PageId = Queue.front();
+            Queue.pop_front();
+        }
+
+        // The loader runs unlocked, it usually waits on disk
+        FStreamedPage Page;
+        Page.PageId = PageId;
+        Page.Pixels.resize(PageBytes);
+        Page.bLoaded = Loader(PageId, Page.Pixels.data());
+
+        std::lock_guard<std::mutex> Lock(Mutex);
+        Completed.push_back(std::move(Page));
+    }
+}
+
+FVirtualTextureSystem::~FVirtualTextureSystem()
+{
+    Shutdown();
+}
+
+void FVirtualTextureSystem::Init(const FVirtualTextureSettings& InSettings, const FVirtualTextureStreamer::FPageLoader& Loader)
+{
+    Settings = InSettings;
+    checkf(Settings.AtlasPagesX * Settings.AtlasPagesY <= 0xFFFFFF, "FVirtualTextureSystem::Init atlas of %u slots doesn't fit a page table entry", Settings.AtlasPagesX * Settings.AtlasPagesY);
+    Cache.Init(Settings.AtlasPagesX * Settings.AtlasPagesY);
+    Textures.clear();
+    Textures.reserve(FVirtualPageId::MaxTextures);
+    Streamer.Start(Loader, GetPageBytes());
+}
+
+void FVirtualTextureSystem::Shutdown()
+{
+    Streamer.Stop();
+    Textures.clear();
+    Deferred.clear();
+}
+
+uint32_t FVirtualTextureSystem::CreateVirtualTexture(uint32_t Width, uint32_t Height)
+{
+    uint32_t TextureId = 0;
+    while (TextureId < Textures.size() && Textures[TextureId].bValid)
+    {
+        ++TextureId;
+    }
+    checkf(TextureId < FVirtualPageId::MaxTextures, "FVirtualTextureSystem::CreateVirtualTexture out of texture ids");
+    if (TextureId == Textures.size())
+    {
+        Textures.emplace_back();
+    }
+
+    const uint32_t PagesX = (Width + Settings.PageSize - 1) / Settings.PageSize;
+    const uint32_t PagesY = (Height + Settings.PageSize - 1) / Settings.PageSize;
+    checkf(PagesX <= FVirtualPageId::MaxPages && PagesY <= FVirtualPageId::MaxPages, "FVirtualTextureSystem::CreateVirtualTexture %ux%u is too large", Width, Height);
+    uint32_t MipLevels = 1;
+    while ((std::max(PagesX, PagesY) >> (MipLevels - 1)) > 1 && MipLevels < FVirtualPageId::MaxMips)
+    {
+        ++MipLevels;
+    }
+
+    FVirtualTextureEntry& Entry = Textures[TextureId];
+    Entry.bValid = true;
+    Entry.Width = Width;
+    Entry.Height = Height;
+    Entry.PageTable.Init(PagesX, PagesY, MipLevels);
+
+    // The single page of the last mip is the fallback for everything, stream it right away
+    Streamer.Request(FVirtualPageId::Pack(TextureId, MipLevels - 1, 0, 0));
+    return TextureId;
+}
+
+void FVirtualTextureSystem::DestroyVirtualTexture(uint32_t TextureId)
+{
+    check(IsValidTexture(TextureId));
+    for (uint32_t Slot = 0; Slot < Cache.GetSlotNum(); ++Slot)
+    {
+        const uint32_t PageId = Cache.GetPageId(Slot);
+        if (PageId != FVirtualPageId::Invalid && FVirtualPageId::GetTexture(PageId) == TextureId)
+        {
+            Cache.Free(PageId);
+        }
+    }
+    Textures[TextureId] = FVirtualTextureEntry();
+}
+
+void FVirtualTextureSystem::ProcessFeedback(const uint32_t* Feedback, size_t Num)
+{
+    Requests.assign(Feedback, Feedback + Num);
+    std::sort(Requests.begin(), Requests.end());
+    Requests.erase(std::unique(Requests.begin(), Requests.end()), Requests.end());
+    while (!Requests.empty() && Requests.back() == FVirtualPageId::Invalid)
+    {
+        Requests.pop_back();
+    }
+
+    // Resident pages only get their LRU position refreshed, the rest become streaming requests
+    size_t MissingNum = 0;
+    for (uint32_t PageId : Requests)
+    {
+        if (!IsValidPage(PageId))
+        {
+            continue;
+        }
+        const uint32_t Slot = Cache.Find(PageId);
+        if (Slot != FVirtualPageCache::InvalidSlot)
+        {
+            Cache.Touch(Slot, Frame);
+        }
+        else
+        {
+            Requests[MissingNum++] = PageId;
+        }
+    }
+    Requests.resize(MissingNum);
+    RequestedPages = static_cast<uint32_t>(MissingNum);
+
+    // Coarse pages first, they cover the most screen and are the fallback for the finer ones
+    std::sort(Requests.begin(), Requests.end(), [](uint32_t A, uint32_t B)
+    {
+        return FVirtualPageId::GetMip(A) > FVirtualPageId::GetMip(B);
+    });
+    const size_t RequestNum = std::min<size_t>(Requests.size(), Settings.MaxRequestsPerFrame);
+    for (size_t Index = 0; Index < RequestNum; ++Index)
+    {
+        Streamer.Request(Requests[Index]);
+    }
+}
+
+void FVirtualTextureSystem::Update(std::vector<FVirtualPageUpload>& OutUploads)
+{
+    OutUploads.clear();
+    Streamer.CollectCompleted(Deferred);
+
+    // Same coarse first order as the requests, what doesn't fit this frame waits for the next one
+    std::stable_sort(Deferred.begin(), Deferred.end(), [](const FStreamedPage& A, const FStreamedPage& B)
+    {
+        return FVirtualPageId::GetMip(A.PageId) > FVirtualPageId::GetMip(B.PageId);
+    });
+
+    size_t Kept = 0;
+    for (size_t Index = 0; Index < Deferred.size(); ++Index)
+    {
+        FStreamedPage& Page = Deferred[Index];
+        if (!Page.bLoaded || !IsValidPage(Page.PageId) || Cache.Find(Page.PageId) != FVirtualPageCache::InvalidSlot)
+        {
+            continue;
+        }
+
+        uint32_t Slot = FVirtualPageCache::InvalidSlot;
+        uint32_t Evicted = FVirtualPageId::Invalid;
+        if (OutUploads.size() < Settings.MaxUploadsPerFrame)
+        {
+            Slot = Cache.Allocate(Page.PageId, Frame, Evicted);
+        }
+        if (Slot == FVirtualPageCache::InvalidSlot)
+        {
+            Deferred[Kept++] = std::move(Page);
+            continue;
+        }
+
+        if (Evicted != FVirtualPageId::Invalid)
+        {
+            Textures[FVirtualPageId::GetTexture(Evicted)].PageTable.UnmapPage(FVirtualPageId::GetMip(Evicted), FVirtualPageId::GetX(Evicted), FVirtualPageId::GetY(Evicted));
+            Evictions++;
+        }
+
+        const uint32_t TextureId = FVirtualPageId::GetTexture(Page.PageId);
+        const uint32_t Mip = FVirtualPageId::GetMip(Page.PageId);
+        FVirtualPageTable& PageTable = Textures[TextureId].PageTable;
+        PageTable.MapPage(Mip, FVirtualPageId::GetX(Page.PageId), FVirtualPageId::GetY(Page.PageId), Slot);
+        if (Mip + 1 == PageTable.GetMipLevels())
+        {
+            Cache.Lock(Slot);
+        }
+        OutUploads.push_back({Slot, std::move(Page.Pixels)});
+    }
+    Deferred.resize(Kept);
+    Frame++;
+}
+
+bool FVirtualTextureSystem::IsValidTexture(uint32_t TextureId) const
+{
+    return TextureId < Textures.size() && Textures[TextureId].bValid;
+}
+
+const FVirtualPageTable& FVirtualTextureSystem::GetPageTable(uint32_t TextureId) const
+{
+    return Textures[TextureId].PageTable;
+}
+
+FVirtualPageTable& FVirtualTextureSystem::GetPageTable(uint32_t TextureId)
+{
+    return Textures[TextureId].PageTable;
+}
+
+const FVirtualTextureSettings& FVirtualTextureSystem::GetSettings() const
+{
+    return Settings;
+}
+
+uint32_t FVirtualTextureSystem::GetSlotTexels() const
+{
+    return Settings.PageSize + 2 * Settings.BorderSize;
+}
+
+uint32_t FVirtualTextureSystem::GetPageBytes() const
+{
+    return GetSlotTexels() * GetSlotTexels() * 4;
+}
+
+uint64_t FVirtualTextureSystem::GetFrame() const
+{
+    return Frame;
+}
+
+FVirtualTextureStats FVirtualTextureSystem::GetStats() const
+{
+    FVirtualTextureStats Stats;
+    Stats.RequestedPages = RequestedPages;
+    Stats.ResidentPages = Cache.GetResidentNum();
+    Stats.InFlightPages = Streamer.GetInFlightNum();
+    Stats.Evictions = Evictions;
+    return Stats;
+}
+
+bool FVirtualTextureSystem::IsValidPage(uint32_t PageId) const
+{
+    const uint32_t TextureId = FVirtualPageId::GetTexture(PageId);
+    if (!IsValidTexture(TextureId))
+    {
+        return false;
+    }
+    const FVirtualPageTable& PageTable = Textures[TextureId].PageTable;
+    const uint32_t Mip = FVirtualPageId::GetMip(PageId);
+    return Mip < PageTable.GetMipLevels() && FVirtualPageId::GetX(PageId) < PageTable.GetPagesX(Mip) && FVirtualPageId::GetY(PageId) < PageTable.GetPagesY(Mip);
+}
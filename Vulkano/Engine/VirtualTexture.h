@@ -0,0 +1,229 @@
+﻿#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Page ids as the feedback pass writes them: X (10) | Y (10) | Mip (4) | Texture (8).
+// All bits set marks a pixel without a request.
+struct FVirtualPageId
+{
+    static constexpr uint32_t Invalid = UINT32_MAX;
+    static constexpr uint32_t MaxTextures = 255;
+    static constexpr uint32_t MaxMips = 16;
+    static constexpr uint32_t MaxPages = 1024;
+
+    static uint32_t Pack(uint32_t Texture, uint32_t Mip, uint32_t X, uint32_t Y);
+    static uint32_t GetTexture(uint32_t PageId);
+    static uint32_t GetMip(uint32_t PageId);
+    static uint32_t GetX(uint32_t PageId);
+    static uint32_t GetY(uint32_t PageId);
+};
+
+// Fixed number of atlas slots with least recently used replacement.
+// Locked pages (the coarsest mip of every texture) are never evicted so sampling always has a fallback.
+class FVirtualPageCache
+{
+public:
+    static constexpr uint32_t InvalidSlot = UINT32_MAX;
+
+    void Init(uint32_t SlotNum);
+    uint32_t Find(uint32_t PageId) const;
+    // Marks a resident page as used in Frame, it becomes the most recently used
+    void Touch(uint32_t Slot, uint64_t Frame);
+    // Takes a free slot or evicts the least recently used page. Pages used in Frame are kept,
+    // InvalidSlot is returned instead so a full working set doesn't thrash.
+    uint32_t Allocate(uint32_t PageId, uint64_t Frame, uint32_t& OutEvictedPageId);
+    void Free(uint32_t PageId);
+    void Lock(uint32_t Slot);
+
+    uint32_t GetPageId(uint32_t Slot) const;
+    uint32_t GetSlotNum() const;
+    uint32_t GetResidentNum() const;
+
+private:
+    void Unlink(uint32_t Slot);
+    void PushBack(uint32_t Slot);
+
+private:
+    struct FSlot
+    {
+        uint32_t PageId = FVirtualPageId::Invalid;
+        uint32_t Previous = InvalidSlot;
+        uint32_t Next = InvalidSlot;
+        uint64_t LastUsedFrame = 0;
+        bool bLocked = false;
+    };
+
+    std::vector<FSlot> Slots;
+    std::vector<uint32_t> FreeSlots;
+    std::unordered_map<uint32_t, uint32_t> PageToSlot;
+    // Least recently used at the head
+    uint32_t Head = InvalidSlot;
+    uint32_t Tail = InvalidSlot;
+};
+
+// CPU copy of one texture's indirection table, one entry per page and mip.
+// Entries point at the finest resident page covering them: slot (24) | mip (8), Invalid when nothing is resident.
+class FVirtualPageTable
+{
+public:
+    struct FDirtyRect
+    {
+        uint32_t MinX = UINT32_MAX;
+        uint32_t MinY = UINT32_MAX;
+        uint32_t MaxX = 0;
+        uint32_t MaxY = 0;
+
+        bool IsEmpty() const { return MinX > MaxX; }
+    };
+
+    static uint32_t MakeEntry(uint32_t Slot, uint32_t Mip);
+    static uint32_t GetEntrySlot(uint32_t Entry);
+    static uint32_t GetEntryMip(uint32_t Entry);
+
+    void Init(uint32_t InPagesX, uint32_t InPagesY, uint32_t InMipLevels);
+    // Points the page and every finer entry that used a coarser fallback at Slot
+    void MapPage(uint32_t Mip, uint32_t X, uint32_t Y, uint32_t Slot);
+    // Entries that used the page fall back to its parent's entry
+    void UnmapPage(uint32_t Mip, uint32_t X, uint32_t Y);
+
+    uint32_t GetEntry(uint32_t Mip, uint32_t X, uint32_t Y) const;
+    uint32_t GetPagesX(uint32_t Mip) const;
+    uint32_t GetPagesY(uint32_t Mip) const;
+    uint32_t GetMipLevels() const;
+    const std::vector<uint32_t>& GetLevel(uint32_t Mip) const;
+    const FDirtyRect& GetDirtyRect(uint32_t Mip) const;
+    void ClearDirty();
+
+private:
+    void SetEntry(uint32_t Mip, uint32_t X, uint32_t Y, uint32_t Entry);
+
+private:
+    uint32_t PagesX = 0;
+    uint32_t PagesY = 0;
+    std::vector<std::vector<uint32_t>> Levels;
+    std::vector<FDirtyRect> DirtyRects;
+};
+
+struct FStreamedPage
+{
+    uint32_t PageId = FVirtualPageId::Invalid;
+    bool bLoaded = false;
+    std::vector<uint8_t> Pixels;
+};
+
+// Loads page pixels on a background thread, the render thread queues requests and collects finished pages
+class FVirtualTextureStreamer
+{
+public:
+    // Fills PageBytes of RGBA8 pixels including the page border, false when the page can't be loaded
+    using FPageLoader = std::function<bool(uint32_t PageId, uint8_t* OutPixels)>;
+
+    ~FVirtualTextureStreamer();
+    void Start(const FPageLoader& InLoader, uint32_t InPageBytes);
+    void Stop();
+    // Duplicates of queued or loading pages are ignored
+    void Request(uint32_t PageId);
+    void CollectCompleted(std::vector<FStreamedPage>& OutPages);
+    bool IsInFlight(uint32_t PageId) const;
+    uint32_t GetInFlightNum() const;
+
+private:
+    void LoaderLoop();
+
+private:
+    FPageLoader Loader;
+    uint32_t PageBytes = 0;
+    std::thread Thread;
+    mutable std::mutex Mutex;
+    std::condition_variable WakeCondition;
+    std::deque<uint32_t> Queue;
+    std::vector<FStreamedPage> Completed;
+    std::unordered_set<uint32_t> InFlight;
+    bool bExit = false;
+};
+
+struct FVirtualTextureSettings
+{
+    // Texels of a page without the border, the atlas stores PageSize + 2 * BorderSize per slot
+    uint32_t PageSize = 128;
+    uint32_t BorderSize = 4;
+    // Atlas size in slots, resident memory stays bounded by it regardless of the texture count
+    uint32_t AtlasPagesX = 32;
+    uint32_t AtlasPagesY = 32;
+    uint32_t MaxRequestsPerFrame = 64;
+    uint32_t MaxUploadsPerFrame = 16;
+};
+
+// Atlas slot to fill with loaded pixels this frame
+struct FVirtualPageUpload
+{
+    uint32_t Slot;
+    std::vector<uint8_t> Pixels;
+};
+
+struct FVirtualTextureStats
+{
+    uint32_t RequestedPages = 0;
+    uint32_t ResidentPages = 0;
+    uint32_t InFlightPages = 0;
+    uint64_t Evictions = 0;
+};
+
+// Page request processing for virtual textures: feedback in, prioritized streaming requests, LRU residency
+// and page table updates out. Has no GPU dependency, FVirtualTextureRenderer moves the results to the GPU.
+class FVirtualTextureSystem
+{
+public:
+    ~FVirtualTextureSystem();
+    void Init(const FVirtualTextureSettings& InSettings, const FVirtualTextureStreamer::FPageLoader& Loader);
+    void Shutdown();
+
+    // Size in texels, returns the texture id used in page ids
+    uint32_t CreateVirtualTexture(uint32_t Width, uint32_t Height);
+    void DestroyVirtualTexture(uint32_t TextureId);
+
+    // Page ids written by one frame's feedback pass, duplicates and Invalid entries are fine
+    void ProcessFeedback(const uint32_t* Feedback, size_t Num);
+    // Takes loaded pages into the atlas, evicting the least recently used ones, and ends the frame
+    void Update(std::vector<FVirtualPageUpload>& OutUploads);
+
+    bool IsValidTexture(uint32_t TextureId) const;
+    const FVirtualPageTable& GetPageTable(uint32_t TextureId) const;
+    FVirtualPageTable& GetPageTable(uint32_t TextureId);
+    const FVirtualTextureSettings& GetSettings() const;
+    uint32_t GetSlotTexels() const;
+    uint32_t GetPageBytes() const;
+    uint64_t GetFrame() const;
+    FVirtualTextureStats GetStats() const;
+
+private:
+    bool IsValidPage(uint32_t PageId) const;
+
+private:
+    struct FVirtualTextureEntry
+    {
+        bool bValid = false;
+        uint32_t Width = 0;
+        uint32_t Height = 0;
+        FVirtualPageTable PageTable;
+    };
+
+    FVirtualTextureSettings Settings;
+    FVirtualPageCache Cache;
+    FVirtualTextureStreamer Streamer;
+    std::vector<FVirtualTextureEntry> Textures;
+    std::vector<uint32_t> Requests;
+    // Loaded pages that found no free slot yet
+    std::vector<FStreamedPage> Deferred;
+    uint64_t Frame = 1;
+    uint32_t RequestedPages = 0;
+    uint64_t Evictions = 0;
+};
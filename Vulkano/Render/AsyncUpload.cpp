@@ -0,0 +1,525 @@
+﻿#include "AsyncUpload.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iterator>
+#include "VulkanInterface.h"
+#include "Core/Assertion.h"
+#include "Core/VulkanoLog.h"
+
+std::thread                                 FAsyncUpload::UploadThread;
+std::mutex                                  FAsyncUpload::Mutex;
+std::condition_variable                     FAsyncUpload::WakeCondition;
+std::condition_variable                     FAsyncUpload::FlushCondition;
+bool                                        FAsyncUpload::bExit = false;
+std::deque<FAsyncUpload::FUploadRequest>    FAsyncUpload::PendingRequests;
+std::vector<FAsyncUpload::FUploadBatch>     FAsyncUpload::CompletedBatches;
+uint64_t                                    FAsyncUpload::NextId = 1;
+uint64_t                                    FAsyncUpload::CompletedId = 0;
+FUploadStats                                FAsyncUpload::Stats;
+std::atomic<uint64_t>                       FAsyncUpload::AcquiredId{0};
+VkCommandPool                               FAsyncUpload::CommandPool = VK_NULL_HANDLE;
+std::vector<VkCommandBuffer>                FAsyncUpload::FreeCommandBuffers;
+std::deque<FAsyncUpload::FUploadBatch>      FAsyncUpload::InFlightBatches;
+FAsyncUpload::FStagingBuffer                FAsyncUpload::Staging;
+FStagingRing                                FAsyncUpload::StagingRing;
+
+// Finished batches are polled at this rate while anything is in flight on the transfer queue
+static constexpr std::chrono::milliseconds PollInterval(1);
+
+void FAsyncUpload::Init()
+{
+    bExit = false;
+    NextId = 1;
+    CompletedId = 0;
+    AcquiredId = 0;
+    Stats = {};
+    StagingRing.Init(StagingSize, StagingAlignment);
+    Staging = CreateStagingBuffer(StagingSize);
+
+    if (!FVulkan::SupportsAsyncTransfer())
+    {
+        return;
+    }
+
+    VkCommandPoolCreateInfo PoolInfo{};
+    PoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    PoolInfo.queueFamilyIndex = FVulkan::GetQueue(EQueueType::Transfer).GetFamilyIndex();
+    PoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    if (vkCreateCommandPool(FVulkan::GetDevice(), &PoolInfo, nullptr, &CommandPool) != VK_SUCCESS)
+    {
+        fatal("FAsyncUpload::Init Fail creating transfer command pool");
+    }
+
+    // Command pools and the transfer queue are only touched by this thread from now on
+    UploadThread = std::thread(&FAsyncUpload::UploadThreadLoop);
+}
+
+void FAsyncUpload::Release()
+{
+    if (UploadThread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> Lock(Mutex);
+            bExit = true;
+        }
+        WakeCondition.notify_all();
+        UploadThread.join();
+        FVulkan::GetQueue(EQueueType::Transfer).WaitIdle();
+    }
+
+    for (FUploadBatch& Batch : InFlightBatches)
+    {
+        for (FStagingBuffer& Oversized : Batch.OversizedStaging)
+        {
+            DestroyStagingBuffer(Oversized);
+        }
+    }
+    InFlightBatches.clear();
+
+    // Destroying the pool frees every command buffer allocated from it
+    if (CommandPool != VK_NULL_HANDLE)
+    {
+        vkDestroyCommandPool(FVulkan::GetDevice(), CommandPool, nullptr);
+        CommandPool = VK_NULL_HANDLE;
+    }
+    FreeCommandBuffers.clear();
+    DestroyStagingBuffer(Staging);
+
+    std::lock_guard<std::mutex> Lock(Mutex);
+    if (Stats.Uploads > 0)
+    {
+        VK_LOG(LOG_INFO, "Async upload: %llu uploads, %llu KB in %llu batches, %llu oversized", static_cast<unsigned long long>(Stats.Uploads),
+            static_cast<unsigned long long>(Stats.UploadedBytes / 1024), static_cast<unsigned long long>(Stats.Batches), static_cast<unsigned long long>(Stats.OversizedUploads));
+    }
+    PendingRequests.clear();
+    CompletedBatches.clear();
+}
+
+uint64_t FAsyncUpload::UploadBuffer(const std::shared_ptr<FVulkanBuffer>& Buffer, std::vector<uint8_t> Data)
+{
+    check(Buffer && Buffer->IsValid() && !Data.empty());
+
+    FUploadRequest Request;
+    Request.Buffer = Buffer;
+    Request.Data = std::move(Data);
+    return Enqueue(std::move(Request));
+}
+
+uint64_t FAsyncUpload::UploadTexture(const std::shared_ptr<FVulkanTexture>& Texture, std::vector<uint8_t> Data, const std::vector<VkBufferImageCopy>& Regions, VkImageLayout Layout)
+{
+    check(Texture && Texture->IsValid() && !Data.empty() && !Regions.empty());
+    checkf(Texture->Usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT, "FAsyncUpload::UploadTexture %s was created without TRANSFER_DST usage", Texture->ResourceName.c_str());
+
+    FUploadRequest Request;
+    Request.Texture = Texture;
+    Request.Data = std::move(Data);
+    Request.Regions = Regions;
+    Request.Layout = Layout;
+    return Enqueue(std::move(Request));
+}
+
+void FAsyncUpload::AcquireCompleted()
+{
+    if (!FVulkan::SupportsAsyncTransfer())
+    {
+        // Same queue, the copies go ahead of everything else recorded in this command buffer
+        RetireBatches();
+        std::deque<FUploadRequest> Requests;
+        {
+            std::lock_guard<std::mutex> Lock(Mutex);
+            Requests.swap(PendingRequests);
+        }
+        if (Requests.empty())
+        {
+            return;
+        }
+
+        FUploadBatch Batch;
+        Batch.Queue = EQueueType::Graphics;
+        Batch.CommandBuffer = FVulkan::GetGraphicsBuffer();
+        Batch.Value = FVulkan::GetQueue(EQueueType::Graphics).GetNextValue();
+        while (!Requests.empty() && RecordRequest(Batch, Requests.front()))
+        {
+            Requests.pop_front();
+        }
+
+        std::lock_guard<std::mutex> Lock(Mutex);
+        if (!Batch.Requests.empty())
+        {
+            VkMemoryBarrier Barrier{};
+            Barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            Barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+            vkCmdPipelineBarrier(Batch.CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &Barrier, 0, nullptr, 0, nullptr);
+            AcquiredId.store(Batch.LastId, std::memory_order_release);
+
+            Stats.Uploads += Batch.Requests.size();
+            Stats.UploadedBytes += Batch.Bytes;
+            Stats.Batches++;
+            Stats.OversizedUploads += Batch.OversizedStaging.size();
+            InFlightBatches.push_back(std::move(Batch));
+        }
+
+        // What didn't fit the staging ring goes first next frame
+        PendingRequests.insert(PendingRequests.begin(), std::make_move_iterator(Requests.begin()), std::make_move_iterator(Requests.end()));
+        return;
+    }
+
+    std::vector<FUploadBatch> Batches;
+    {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        Batches.swap(CompletedBatches);
+    }
+    if (Batches.empty())
+    {
+        return;
+    }
+
+    // Same transfers as the release recorded by SubmitBatch, both halves have to match
+    for (const FUploadBatch& Batch : Batches)
+    {
+        for (const FQueueOwnershipTransfer& Transfer : GetOwnershipTransfers(Batch))
+        {
+            FVulkan::AcquireQueueOwnership(EQueueType::Transfer, EQueueType::Graphics, Transfer);
+        }
+    }
+
+    // The batches already completed, this only orders the release before the acquire on the graphics timeline
+    FVulkan::GetQueue(EQueueType::Graphics).AddDependency({EQueueType::Transfer, Batches.back().Value}, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    AcquiredId.store(Batches.back().LastId, std::memory_order_release);
+}
+
+bool FAsyncUpload::IsReady(uint64_t UploadId)
+{
+    return UploadId != 0 && UploadId <= AcquiredId.load(std::memory_order_acquire);
+}
+
+void FAsyncUpload::Flush()
+{
+    // Without the transfer queue everything pending is recorded by the next graphics command buffer anyway
+    if (!FVulkan::SupportsAsyncTransfer())
+    {
+        return;
+    }
+
+    std::unique_lock<std::mutex> Lock(Mutex);
+    const uint64_t LastId = NextId - 1;
+    FlushCondition.wait(Lock, [LastId] { return CompletedId >= LastId; });
+}
+
+FUploadStats FAsyncUpload::GetStats()
+{
+    std::lock_guard<std::mutex> Lock(Mutex);
+    return Stats;
+}
+
+uint64_t FAsyncUpload::Enqueue(FUploadRequest&& Request)
+{
+    uint64_t UploadId = 0;
+    {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        UploadId = NextId++;
+        Request.Id = UploadId;
+        PendingRequests.push_back(std::move(Request));
+    }
+    WakeCondition.notify_one();
+    return UploadId;
+}
+
+void FAsyncUpload::UploadThreadLoop()
+{
+    std::unique_lock<std::mutex> Lock(Mutex);
+    while (!bExit)
+    {
+        // Sleeps until the next upload, but keeps polling while batches are in flight so they get acquired
+        auto HasWork_Lambda([] { return bExit || !PendingRequests.empty(); });
+        if (InFlightBatches.empty())
+        {
+            WakeCondition.wait(Lock, HasWork_Lambda);
+        }
+        else
+        {
+            WakeCondition.wait_for(Lock, PollInterval, HasWork_Lambda);
+        }
+        if (bExit)
+        {
+            break;
+        }
+
+        std::deque<FUploadRequest> Requests;
+        Requests.swap(PendingRequests);
+        Lock.unlock();
+
+        RetireBatches();
+        SubmitRequests(Requests);
+
+        Lock.lock();
+    }
+}
+
+void FAsyncUpload::SubmitRequests(std::deque<FUploadRequest>& Requests)
+{
+    FUploadBatch Batch;
+    while (!Requests.empty())
+    {
+        if (Batch.CommandBuffer == VK_NULL_HANDLE)
+        {
+            BeginBatch(Batch);
+        }
+        if (RecordRequest(Batch, Requests.front()))
+        {
+            Requests.pop_front();
+            continue;
+        }
+
+        // Staging ring is full, submit what is recorded or wait for the oldest batch to give its range back
+        if (!Batch.Requests.empty())
+        {
+            SubmitBatch(Batch);
+            Batch = FUploadBatch();
+        }
+        else
+        {
+            checkf(!InFlightBatches.empty(), "FAsyncUpload::SubmitRequests Staging ring is full with nothing in flight");
+            FVulkan::GetQueue(EQueueType::Transfer).Wait(InFlightBatches.front().Value);
+        }
+        RetireBatches();
+    }
+
+    if (!Batch.Requests.empty())
+    {
+        SubmitBatch(Batch);
+    }
+    else if (Batch.CommandBuffer != VK_NULL_HANDLE)
+    {
+        vkEndCommandBuffer(Batch.CommandBuffer);
+        FreeCommandBuffers.push_back(Batch.CommandBuffer);
+    }
+}
+
+void FAsyncUpload::BeginBatch(FUploadBatch& Batch)
+{
+    Batch.Queue = EQueueType::Transfer;
+    if (FreeCommandBuffers.empty())
+    {
+        VkCommandBufferAllocateInfo AllocInfo{};
+        AllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        AllocInfo.commandPool = CommandPool;
+        AllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        AllocInfo.commandBufferCount = 1;
+        VkCommandBuffer CommandBuffer = VK_NULL_HANDLE;
+        if (vkAllocateCommandBuffers(FVulkan::GetDevice(), &AllocInfo, &CommandBuffer) != VK_SUCCESS)
+        {
+            fatal("FAsyncUpload::BeginBatch Fail creating transfer command buffer");
+        }
+        FreeCommandBuffers.push_back(CommandBuffer);
+    }
+    Batch.CommandBuffer = FreeCommandBuffers.back();
+    FreeCommandBuffers.pop_back();
+
+    VkCommandBufferBeginInfo BeginInfo{};
+    BeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    BeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(Batch.CommandBuffer, &BeginInfo);
+}
+
+void FAsyncUpload::SubmitBatch(FUploadBatch& Batch)
+{
+    // Hands the targets to the graphics family, AcquireCompleted records the matching acquire
+    for (const FQueueOwnershipTransfer& Transfer : GetOwnershipTransfers(Batch))
+    {
+        FVulkan::RecordOwnershipBarrier(Batch.CommandBuffer, EQueueType::Transfer, EQueueType::Graphics, Transfer, true);
+    }
+    vkEndCommandBuffer(Batch.CommandBuffer);
+    Batch.Value = FVulkan::GetQueue(EQueueType::Transfer).Submit(&Batch.CommandBuffer, 1);
+
+    {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        Stats.Uploads += Batch.Requests.size();
+        Stats.UploadedBytes += Batch.Bytes;
+        Stats.Batches++;
+        Stats.OversizedUploads += Batch.OversizedStaging.size();
+    }
+    InFlightBatches.push_back(std::move(Batch));
+}
+
+bool FAsyncUpload::RecordRequest(FUploadBatch& Batch, FUploadRequest& Request)
+{
+    const VkDeviceSize Size = Request.Data.size();
+    VkBuffer Source = Staging.Buffer;
+    VkDeviceSize Offset = 0;
+    uint8_t* Destination = nullptr;
+    if (StagingRing.IsOversized(Size))
+    {
+        Batch.OversizedStaging.push_back(CreateStagingBuffer(Size));
+        Source = Batch.OversizedStaging.back().Buffer;
+        Destination = Batch.OversizedStaging.back().MappedData;
+    }
+    else if (StagingRing.Allocate(Size, Offset))
+    {
+        Batch.bStaged = true;
+        Batch.StagingEnd = StagingRing.GetHead();
+        Destination = Staging.MappedData + Offset;
+    }
+    else
+    {
+        return false;
+    }
+    memcpy(Destination, Request.Data.data(), Size);
+
+    if (Request.Buffer)
+    {
+        VkBufferCopy Region{};
+        Region.srcOffset = Offset;
+        Region.dstOffset = 0;
+        Region.size = Size;
+        vkCmdCopyBuffer(Batch.CommandBuffer, Source, Request.Buffer->Buffer, 1, &Region);
+    }
+    else
+    {
+        // The old content is discarded, the transfer queue can start writing without owning the texture
+        const std::shared_ptr<FVulkanTexture>& Texture = Request.Texture;
+        VkImageMemoryBarrier Barrier{};
+        Barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        Barrier.srcAccessMask = 0;
+        Barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        Barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        Barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        Barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        Barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        Barrier.image = Texture->Image;
+        Barrier.subresourceRange.aspectMask = Texture->AspectFlags;
+        Barrier.subresourceRange.baseMipLevel = 0;
+        Barrier.subresourceRange.levelCount = Texture->MipLevels;
+        Barrier.subresourceRange.baseArrayLayer = 0;
+        Barrier.subresourceRange.layerCount = Texture->ArrayLayers;
+        vkCmdPipelineBarrier(Batch.CommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &Barrier);
+
+        for (VkBufferImageCopy& Region : Request.Regions)
+        {
+            Region.bufferOffset += Offset;
+        }
+        vkCmdCopyBufferToImage(Batch.CommandBuffer, Source, Texture->Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(Request.Regions.size()), Request.Regions.data());
+
+        Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        Barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        Barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        Barrier.newLayout = Request.Layout;
+        vkCmdPipelineBarrier(Batch.CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &Barrier);
+    }
+
+    Batch.Bytes += Size;
+    Batch.LastId = Request.Id;
+    Request.Data = std::vector<uint8_t>();
+    Request.Regions.clear();
+    Batch.Requests.push_back(std::move(Request));
+    return true;
+}
+
+void FAsyncUpload::RetireBatches()
+{
+    std::vector<FUploadBatch> Finished;
+    while (!InFlightBatches.empty() && FVulkan::GetQueue(InFlightBatches.front().Queue).IsComplete(InFlightBatches.front().Value))
+    {
+        FUploadBatch& Batch = InFlightBatches.front();
+        if (Batch.bStaged)
+        {
+            StagingRing.Release(Batch.StagingEnd);
+        }
+        for (FStagingBuffer& Oversized : Batch.OversizedStaging)
+        {
+            DestroyStagingBuffer(Oversized);
+        }
+        Batch.OversizedStaging.clear();
+        if (Batch.Queue == EQueueType::Transfer)
+        {
+            FreeCommandBuffers.push_back(Batch.CommandBuffer);
+        }
+        Finished.push_back(std::move(Batch));
+        InFlightBatches.pop_front();
+    }
+
+    // Graphics batches were usable as soon as they were recorded, transfer ones still wait for the acquire
+    if (Finished.empty() || !FVulkan::SupportsAsyncTransfer())
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> Lock(Mutex);
+    CompletedId = Finished.back().LastId;
+    CompletedBatches.insert(CompletedBatches.end(), std::make_move_iterator(Finished.begin()), std::make_move_iterator(Finished.end()));
+    FlushCondition.notify_all();
+}
+
+std::vector<FQueueOwnershipTransfer> FAsyncUpload::GetOwnershipTransfers(const FUploadBatch& Batch)
+{
+    std::vector<FQueueOwnershipTransfer> Transfers;
+    for (const FUploadRequest& Request : Batch.Requests)
+    {
+        // Buffers have no layout, they join whichever transfer comes first
+        auto It = std::find_if(Transfers.begin(), Transfers.end(), [&Request](const FQueueOwnershipTransfer& Transfer)
+        {
+            return !Request.Texture || Transfer.TextureLayout == Request.Layout;
+        });
+        if (It == Transfers.end())
+        {
+            It = Transfers.emplace(Transfers.end());
+            It->TextureLayout = Request.Texture ? Request.Layout : VK_IMAGE_LAYOUT_GENERAL;
+        }
+
+        if (Request.Texture)
+        {
+            It->Textures.push_back(Request.Texture);
+        }
+        else
+        {
+            It->Buffers.push_back(Request.Buffer);
+        }
+    }
+    return Transfers;
+}
+
+FAsyncUpload::FStagingBuffer FAsyncUpload::CreateStagingBuffer(VkDeviceSize Size)
+{
+    FStagingBuffer Result;
+    Result.Size = Size;
+
+    VkBufferCreateInfo BufferCreateInfo{};
+    BufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    BufferCreateInfo.size = Size;
+    BufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    BufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(FVulkan::GetDevice(), &BufferCreateInfo, nullptr, &Result.Buffer) != VK_SUCCESS)
+    {
+        fatal("FAsyncUpload::CreateStagingBuffer Fail creating staging buffer size: %i", static_cast<int>(Size));
+    }
+
+    VkMemoryRequirements MemRequirements;
+    vkGetBufferMemoryRequirements(FVulkan::GetDevice(), Result.Buffer, &MemRequirements);
+
+    VkMemoryAllocateInfo MemoryAllocateInfo{};
+    MemoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    MemoryAllocateInfo.allocationSize = MemRequirements.size;
+    MemoryAllocateInfo.memoryTypeIndex = FVulkan::FindMemoryType(FVulkan::GetPhysicalDevice(), MemRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (vkAllocateMemory(FVulkan::GetDevice(), &MemoryAllocateInfo, nullptr, &Result.Memory) != VK_SUCCESS)
+    {
+        fatal("FAsyncUpload::CreateStagingBuffer Fail allocating staging memory size: %i", static_cast<int>(Size));
+    }
+    vkBindBufferMemory(FVulkan::GetDevice(), Result.Buffer, Result.Memory, 0);
+
+    void* Data = nullptr;
+    vkMapMemory(FVulkan::GetDevice(), Result.Memory, 0, VK_WHOLE_SIZE, 0, &Data);
+    Result.MappedData = static_cast<uint8_t*>(Data);
+    return Result;
+}
+
+void FAsyncUpload::DestroyStagingBuffer(FStagingBuffer& Buffer)
+{
+    if (Buffer.Buffer != VK_NULL_HANDLE)
+    {
+        vkDestroyBuffer(FVulkan::GetDevice(), Buffer.Buffer, nullptr);
+        vkFreeMemory(FVulkan::GetDevice(), Buffer.Memory, nullptr);
+    }
+    Buffer = FStagingBuffer();
+}
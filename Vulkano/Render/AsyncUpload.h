@@ -0,0 +1,125 @@
+﻿#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "RenderResources.h"
+#include "StagingRing.h"
+#include "VulkanQueue.h"
+#include "vulkan/vulkan_core.h"
+
+struct FUploadStats
+{
+    uint64_t Uploads = 0;
+    uint64_t UploadedBytes = 0;
+    uint64_t Batches = 0;
+    // Uploads bigger than the staging ring, they get a staging buffer of their own
+    uint64_t OversizedUploads = 0;
+};
+
+// Mesh and texture uploads on the dedicated transfer queue. A submission thread stages the data, records the copies
+// and releases the targets to the graphics family, the graphics command buffer acquires whatever finished when it is reset.
+// Completion is tracked on the transfer timeline so streaming never takes graphics queue time.
+// Without a transfer-only family the copies are recorded at the start of the next graphics command buffer instead.
+// Targets must not be in use by the GPU, an upload replaces their whole content and owns them until acquired.
+class FAsyncUpload
+{
+public:
+    enum
+    {
+        StagingSize = 32 * 1024 * 1024,
+        // Covers the texel block size of every format and the optimal copy offset of common devices
+        StagingAlignment = 256
+    };
+
+    static void Init();
+    static void Release();
+
+    // Data fills the buffer from its start, returns the id IsReady is asked with
+    static uint64_t UploadBuffer(const std::shared_ptr<FVulkanBuffer>& Buffer, std::vector<uint8_t> Data);
+    // Region buffer offsets are relative to Data, the texture is left in Layout
+    static uint64_t UploadTexture(const std::shared_ptr<FVulkanTexture>& Texture, std::vector<uint8_t> Data, const std::vector<VkBufferImageCopy>& Regions, VkImageLayout Layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    // Called once the graphics command buffer started recording, acquires the finished uploads and never waits
+    static void AcquireCompleted();
+    // True once commands recorded on the graphics command buffer can read the upload target
+    static bool IsReady(uint64_t UploadId);
+    // Blocks until everything uploaded so far finished on the transfer queue, for loading screens and tools.
+    // The targets still belong to the transfer family, IsReady turns true once the next AcquireCompleted took them over
+    static void Flush();
+    static FUploadStats GetStats();
+
+private:
+    struct FUploadRequest
+    {
+        uint64_t Id = 0;
+        std::shared_ptr<FVulkanBuffer> Buffer;
+        std::shared_ptr<FVulkanTexture> Texture;
+        std::vector<uint8_t> Data;
+        std::vector<VkBufferImageCopy> Regions;
+        VkImageLayout Layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    };
+
+    struct FStagingBuffer
+    {
+        VkBuffer Buffer = VK_NULL_HANDLE;
+        VkDeviceMemory Memory = VK_NULL_HANDLE;
+        uint8_t* MappedData = nullptr;
+        VkDeviceSize Size = 0;
+    };
+
+    // One submission, its staging range goes back to the ring once Value completes on Queue
+    struct FUploadBatch
+    {
+        EQueueType Queue = EQueueType::Transfer;
+        VkCommandBuffer CommandBuffer = VK_NULL_HANDLE;
+        uint64_t Value = 0;
+        uint64_t LastId = 0;
+        uint64_t Bytes = 0;
+        // Ring head after the last staged request, released when the batch retires
+        bool bStaged = false;
+        VkDeviceSize StagingEnd = 0;
+        std::vector<FStagingBuffer> OversizedStaging;
+        // Targets only, the data is dropped once it is staged
+        std::vector<FUploadRequest> Requests;
+    };
+
+    static uint64_t Enqueue(FUploadRequest&& Request);
+    static void UploadThreadLoop();
+    static void SubmitRequests(std::deque<FUploadRequest>& Requests);
+    static void BeginBatch(FUploadBatch& Batch);
+    static void SubmitBatch(FUploadBatch& Batch);
+    // Stages Request and records its copy into Batch, false when the staging ring is full
+    static bool RecordRequest(FUploadBatch& Batch, FUploadRequest& Request);
+    // Frees the staging and command buffers of finished batches, oldest first
+    static void RetireBatches();
+    // Texture uploads leave in different layouts, release and acquire need one transfer per layout
+    static std::vector<FQueueOwnershipTransfer> GetOwnershipTransfers(const FUploadBatch& Batch);
+    static FStagingBuffer CreateStagingBuffer(VkDeviceSize Size);
+    static void DestroyStagingBuffer(FStagingBuffer& Buffer);
+
+private:
+    static std::thread UploadThread;
+    static std::mutex Mutex;
+    static std::condition_variable WakeCondition;
+    static std::condition_variable FlushCondition;
+    static bool bExit;
+    // Guarded by Mutex
+    static std::deque<FUploadRequest> PendingRequests;
+    static std::vector<FUploadBatch> CompletedBatches;
+    static uint64_t NextId;
+    static uint64_t CompletedId;
+    static FUploadStats Stats;
+    static std::atomic<uint64_t> AcquiredId;
+
+    // Owned by the upload thread, or by the render thread without a dedicated transfer queue
+    static VkCommandPool CommandPool;
+    static std::vector<VkCommandBuffer> FreeCommandBuffers;
+    static std::deque<FUploadBatch> InFlightBatches;
+    static FStagingBuffer Staging;
+    static FStagingRing StagingRing;
+};
@@ -0,0 +1,310 @@
+﻿#include "BindlessHeap.h"
+#include <algorithm>
+#include "DeletionQueue.h"
+#include "UniformStreamAllocator.h"
+#include "VulkanInterface.h"
+#include "Core/Assertion.h"
+#include "Core/VulkanoLog.h"
+
+std::mutex                                  FBindlessHeap::HeapMutex;
+FBindlessSlotAllocator                      FBindlessHeap::Allocators[static_cast<uint32_t>(EBindlessType::Num)];
+std::vector<FBindlessHeap::FPendingWrite>   FBindlessHeap::PendingWrites;
+VkDescriptorPool                            FBindlessHeap::DescriptorPool = VK_NULL_HANDLE;
+VkDescriptorSetLayout                       FBindlessHeap::DescriptorSetLayout = VK_NULL_HANDLE;
+VkDescriptorSet                             FBindlessHeap::DescriptorSet = VK_NULL_HANDLE;
+VkPipelineLayout                            FBindlessHeap::PipelineLayout = VK_NULL_HANDLE;
+
+static const VkDescriptorType GBindlessDescriptorTypes[] = {
+    VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    VK_DESCRIPTOR_TYPE_SAMPLER,
+};
+
+void FBindlessSlotAllocator::Init(uint32_t InCapacity)
+{
+    Capacity = InCapacity;
+    NextFresh = 0;
+    AllocatedNum = 0;
+    FreeSlots.clear();
+    PendingSlots.clear();
+}
+
+uint32_t FBindlessSlotAllocator::Allocate()
+{
+    uint32_t Index = UINT32_MAX;
+    if(!FreeSlots.empty())
+    {
+        Index = FreeSlots.back();
+        FreeSlots.pop_back();
+    }
+    else if(NextFresh < Capacity)
+    {
+        Index = NextFresh++;
+    }
+
+    if(Index != UINT32_MAX)
+    {
+        AllocatedNum++;
+    }
+    return Index;
+}
+
+void FBindlessSlotAllocator::Free(uint32_t Index, uint64_t RetireValue)
+{
+    if(Index < Capacity)
+    {
+        PendingSlots.push_back({Index, RetireValue});
+        AllocatedNum--;
+    }
+}
+
+void FBindlessSlotAllocator::ReleaseRetired(uint64_t CompletedValue)
+{
+    size_t Kept = 0;
+    for (size_t i = 0; i < PendingSlots.size(); ++i)
+    {
+        if(PendingSlots[i].RetireValue <= CompletedValue)
+        {
+            FreeSlots.push_back(PendingSlots[i].Index);
+        }
+        else
+        {
+            PendingSlots[Kept++] = PendingSlots[i];
+        }
+    }
+    PendingSlots.resize(Kept);
+}
+
+uint32_t FBindlessSlotAllocator::GetCapacity() const
+{
+    return Capacity;
+}
+
+uint32_t FBindlessSlotAllocator::GetAllocatedNum() const
+{
+    return AllocatedNum;
+}
+
+void FBindlessHeap::Init()
+{
+    VkPhysicalDeviceVulkan12Properties Properties12{};
+    Properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+    VkPhysicalDeviceProperties2 Properties{};
+    Properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    Properties.pNext = &Properties12;
+    vkGetPhysicalDeviceProperties2(FVulkan::GetPhysicalDevice(), &Properties);
+
+    // Stay well under the update-after-bind limits, software devices report small ones
+    uint32_t Capacities[static_cast<uint32_t>(EBindlessType::Num)];
+    // Every binding is visible to all stages, so the per stage limits apply as well as the per set ones
+    Capacities[static_cast<uint32_t>(EBindlessType::SampledImage)] = std::min({65536u, Properties12.maxDescriptorSetUpdateAfterBindSampledImages,
+        Properties12.maxPerStageDescriptorUpdateAfterBindSampledImages});
+    Capacities[static_cast<uint32_t>(EBindlessType::StorageBuffer)] = std::min({65536u, Properties12.maxDescriptorSetUpdateAfterBindStorageBuffers,
+        Properties12.maxPerStageDescriptorUpdateAfterBindStorageBuffers});
+    Capacities[static_cast<uint32_t>(EBindlessType::Sampler)] = std::min({2048u, Properties12.maxDescriptorSetUpdateAfterBindSamplers,
+        Properties12.maxPerStageDescriptorUpdateAfterBindSamplers});
+
+    // The sum is capped per stage too, scaled down evenly leaving room for the other sets of the pipeline layouts
+    constexpr uint32_t ReservedStageResources = 256;
+    const uint32_t StageResources = Properties12.maxPerStageUpdateAfterBindResources;
+    const uint64_t StageBudget = StageResources > ReservedStageResources ? StageResources - ReservedStageResources : 0;
+    uint64_t CapacitySum = 0;
+    for (uint32_t Capacity : Capacities)
+    {
+        CapacitySum += Capacity;
+    }
+    if (CapacitySum > StageBudget)
+    {
+        for (uint32_t& Capacity : Capacities)
+        {
+            Capacity = std::max(1u, static_cast<uint32_t>(Capacity * StageBudget / CapacitySum));
+        }
+    }
+
+    std::vector<VkDescriptorSetLayoutBinding> Bindings;
+    std::vector<VkDescriptorBindingFlags> BindingFlags;
+    std::vector<VkDescriptorPoolSize> PoolSizes;
+    for (uint32_t i = 0; i < static_cast<uint32_t>(EBindlessType::Num); ++i)
+    {
+        Allocators[i].Init(Capacities[i]);
+
+        VkDescriptorSetLayoutBinding& Binding = Bindings.emplace_back();
+        Binding = {};
+        Binding.binding = i;
+        Binding.descriptorType = GBindlessDescriptorTypes[i];
+        Binding.descriptorCount = Capacities[i];
+        Binding.stageFlags = VK_SHADER_STAGE_ALL;
+
+        BindingFlags.push_back(VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT);
+        PoolSizes.push_back({GBindlessDescriptorTypes[i], Capacities[i]});
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo BindingFlagsCreateInfo{};
+    BindingFlagsCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    BindingFlagsCreateInfo.bindingCount = static_cast<uint32_t>(BindingFlags.size());
+    BindingFlagsCreateInfo.pBindingFlags = BindingFlags.data();
+
+    VkDescriptorSetLayoutCreateInfo SetLayoutCreateInfo{};
+    SetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    SetLayoutCreateInfo.pNext = &BindingFlagsCreateInfo;
+    SetLayoutCreateInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    SetLayoutCreateInfo.bindingCount = static_cast<uint32_t>(Bindings.size());
+    SetLayoutCreateInfo.pBindings = Bindings.data();
+    if(vkCreateDescriptorSetLayout(FVulkan::GetDevice(), &SetLayoutCreateInfo, nullptr, &DescriptorSetLayout) != VK_SUCCESS)
+    {
+        fatal("FBindlessHeap::Init Fail creating bindless descriptor set layout");
+    }
+
+    VkDescriptorPoolCreateInfo PoolCreateInfo{};
+    PoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    PoolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    PoolCreateInfo.maxSets = 1;
+    PoolCreateInfo.poolSizeCount = static_cast<uint32_t>(PoolSizes.size());
+    PoolCreateInfo.pPoolSizes = PoolSizes.data();
+    if(vkCreateDescriptorPool(FVulkan::GetDevice(), &PoolCreateInfo, nullptr, &DescriptorPool) != VK_SUCCESS)
+    {
+        fatal("FBindlessHeap::Init Fail creating bindless descriptor pool");
+    }
+
+    VkDescriptorSetAllocateInfo AllocateInfo{};
+    AllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    AllocateInfo.descriptorPool = DescriptorPool;
+    AllocateInfo.descriptorSetCount = 1;
+    AllocateInfo.pSetLayouts = &DescriptorSetLayout;
+    if(vkAllocateDescriptorSets(FVulkan::GetDevice(), &AllocateInfo, &DescriptorSet) != VK_SUCCESS)
+    {
+        fatal("FBindlessHeap::Init Fail allocating bindless descriptor set");
+    }
+
+    VkPushConstantRange PushConstantRange{};
+    PushConstantRange.stageFlags = VK_SHADER_STAGE_ALL;
+    PushConstantRange.offset = 0;
+    PushConstantRange.size = MaxPushConstantSize;
+
+    VkPipelineLayoutCreateInfo PipelineLayoutCreateInfo{};
+    PipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    const VkDescriptorSetLayout SetLayouts[] = {DescriptorSetLayout, FUniformStreamAllocator::GetDescriptorSetLayout()};
+    PipelineLayoutCreateInfo.setLayoutCount = 2;
+    PipelineLayoutCreateInfo.pSetLayouts = SetLayouts;
+    PipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+    PipelineLayoutCreateInfo.pPushConstantRanges = &PushConstantRange;
+    if(vkCreatePipelineLayout(FVulkan::GetDevice(), &PipelineLayoutCreateInfo, nullptr, &PipelineLayout) != VK_SUCCESS)
+    {
+        fatal("FBindlessHeap::Init Fail creating bindless pipeline layout");
+    }
+
+    VK_LOG(LOG_INFO, "Bindless heap created, images: %i, buffers: %i, samplers: %i",
+        Capacities[static_cast<uint32_t>(EBindlessType::SampledImage)],
+        Capacities[static_cast<uint32_t>(EBindlessType::StorageBuffer)],
+        Capacities[static_cast<uint32_t>(EBindlessType::Sampler)]);
+}
+
+void FBindlessHeap::Release()
+{
+    std::lock_guard<std::mutex> Lock(HeapMutex);
+    PendingWrites.clear();
+
+    FDeletionQueue::Enqueue(EDeferredResourceType::PipelineLayout, PipelineLayout);
+    FDeletionQueue::Enqueue(EDeferredResourceType::DescriptorPool, DescriptorPool);
+    FDeletionQueue::Enqueue(EDeferredResourceType::DescriptorSetLayout, DescriptorSetLayout);
+    PipelineLayout = VK_NULL_HANDLE;
+    DescriptorPool = VK_NULL_HANDLE;
+    DescriptorSetLayout = VK_NULL_HANDLE;
+    DescriptorSet = VK_NULL_HANDLE;
+}
+
+uint32_t FBindlessHeap::Register(EBindlessType Type, const VkDescriptorImageInfo& ImageInfo, const VkDescriptorBufferInfo& BufferInfo)
+{
+    std::lock_guard<std::mutex> Lock(HeapMutex);
+    uint32_t Index = Allocators[static_cast<uint32_t>(Type)].Allocate();
+    if(Index == UINT32_MAX)
+    {
+        fatal("FBindlessHeap::Register Bindless heap is full for type %i", static_cast<int>(Type));
+    }
+    PendingWrites.push_back({Type, Index, ImageInfo, BufferInfo});
+    return Index;
+}
+
+uint32_t FBindlessHeap::RegisterTexture(VkImageView ImageView, VkImageLayout Layout)
+{
+    return Register(EBindlessType::SampledImage, {VK_NULL_HANDLE, ImageView, Layout}, {});
+}
+
+uint32_t FBindlessHeap::RegisterBuffer(VkBuffer Buffer, VkDeviceSize Offset, VkDeviceSize Range)
+{
+    return Register(EBindlessType::StorageBuffer, {}, {Buffer, Offset, Range});
+}
+
+uint32_t FBindlessHeap::RegisterSampler(VkSampler Sampler)
+{
+    return Register(EBindlessType::Sampler, {Sampler, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_UNDEFINED}, {});
+}
+
+void FBindlessHeap::Unregister(EBindlessType Type, uint32_t Index)
+{
+    std::lock_guard<std::mutex> Lock(HeapMutex);
+
+    // A write still waiting for the flush would point at a destroyed object
+    PendingWrites.erase(std::remove_if(PendingWrites.begin(), PendingWrites.end(), [Type, Index](const FPendingWrite& Write)
+    {
+        return Write.Type == Type && Write.Index == Index;
+    }), PendingWrites.end());
+
+    Allocators[static_cast<uint32_t>(Type)].Free(Index, GetDeferredRetireValue());
+}
+
+void FBindlessHeap::FlushUpdates()
+{
+    std::lock_guard<std::mutex> Lock(HeapMutex);
+    if(PendingWrites.empty() || DescriptorSet == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    std::vector<VkWriteDescriptorSet> Writes;
+    Writes.reserve(PendingWrites.size());
+    for(const FPendingWrite& Pending : PendingWrites)
+    {
+        VkWriteDescriptorSet& Write = Writes.emplace_back();
+        Write = {};
+        Write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        Write.dstSet = DescriptorSet;
+        Write.dstBinding = static_cast<uint32_t>(Pending.Type);
+        Write.dstArrayElement = Pending.Index;
+        Write.descriptorCount = 1;
+        Write.descriptorType = GBindlessDescriptorTypes[static_cast<uint32_t>(Pending.Type)];
+        Write.pImageInfo = Pending.Type == EBindlessType::StorageBuffer ? nullptr : &Pending.ImageInfo;
+        Write.pBufferInfo = Pending.Type == EBindlessType::StorageBuffer ? &Pending.BufferInfo : nullptr;
+    }
+    vkUpdateDescriptorSets(FVulkan::GetDevice(), static_cast<uint32_t>(Writes.size()), Writes.data(), 0, nullptr);
+    PendingWrites.clear();
+}
+
+void FBindlessHeap::ReleaseRetired(uint64_t CompletedValue)
+{
+    std::lock_guard<std::mutex> Lock(HeapMutex);
+    for(FBindlessSlotAllocator& Allocator : Allocators)
+    {
+        Allocator.ReleaseRetired(CompletedValue);
+    }
+}
+
+void FBindlessHeap::Bind(VkCommandBuffer CommandBuffer, VkPipelineBindPoint BindPoint)
+{
+    vkCmdBindDescriptorSets(CommandBuffer, BindPoint, PipelineLayout, BindlessSetIndex, 1, &DescriptorSet, 0, nullptr);
+}
+
+const VkPipelineLayout& FBindlessHeap::GetPipelineLayout()
+{
+    return PipelineLayout;
+}
+
+const VkDescriptorSetLayout& FBindlessHeap::GetDescriptorSetLayout()
+{
+    return DescriptorSetLayout;
+}
+
+bool FBindlessHeap::IsValid()
+{
+    return DescriptorSet != VK_NULL_HANDLE;
+}
@@ -0,0 +1,89 @@
+﻿#pragma once
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "vulkan/vulkan_core.h"
+
+enum class EBindlessType : uint8_t
+{
+    SampledImage,
+    StorageBuffer,
+    Sampler,
+    Num
+};
+
+// Hands out slots of one descriptor array, freed slots come back once the GPU can no longer read them
+class FBindlessSlotAllocator
+{
+public:
+    void Init(uint32_t InCapacity);
+    uint32_t Allocate();
+    void Free(uint32_t Index, uint64_t RetireValue);
+    void ReleaseRetired(uint64_t CompletedValue);
+    uint32_t GetCapacity() const;
+    uint32_t GetAllocatedNum() const;
+
+private:
+    struct FPendingSlot
+    {
+        uint32_t Index;
+        uint64_t RetireValue;
+    };
+
+    uint32_t Capacity = 0;
+    uint32_t NextFresh = 0;
+    uint32_t AllocatedNum = 0;
+    std::vector<uint32_t> FreeSlots;
+    std::vector<FPendingSlot> PendingSlots;
+};
+
+// Global descriptor-indexing heap, every pipeline shares one layout and reads resources through push constant indices.
+// Set 1 of the shared layout is the dynamic uniform buffer of FUniformStreamAllocator.
+class FBindlessHeap
+{
+public:
+    enum
+    {
+        MaxPushConstantSize = 128,
+        BindlessSetIndex = 0,
+        UniformSetIndex = 1
+    };
+
+    static void Init();
+    static void Release();
+
+    static uint32_t RegisterTexture(VkImageView ImageView, VkImageLayout Layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    static uint32_t RegisterBuffer(VkBuffer Buffer, VkDeviceSize Offset = 0, VkDeviceSize Range = VK_WHOLE_SIZE);
+    static uint32_t RegisterSampler(VkSampler Sampler);
+    static void Unregister(EBindlessType Type, uint32_t Index);
+
+    // Writes every registration since the last flush in one vkUpdateDescriptorSets
+    static void FlushUpdates();
+    static void ReleaseRetired(uint64_t CompletedValue);
+    static void Bind(VkCommandBuffer CommandBuffer, VkPipelineBindPoint BindPoint);
+
+    static const VkPipelineLayout& GetPipelineLayout();
+    static const VkDescriptorSetLayout& GetDescriptorSetLayout();
+    static bool IsValid();
+
+private:
+    struct FPendingWrite
+    {
+        EBindlessType Type;
+        uint32_t Index;
+        VkDescriptorImageInfo ImageInfo;
+        VkDescriptorBufferInfo BufferInfo;
+    };
+
+    static uint32_t Register(EBindlessType Type, const VkDescriptorImageInfo& ImageInfo, const VkDescriptorBufferInfo& BufferInfo);
+
+private:
+    static std::mutex HeapMutex;
+    static FBindlessSlotAllocator Allocators[static_cast<uint32_t>(EBindlessType::Num)];
+    static std::vector<FPendingWrite> PendingWrites;
+
+    static VkDescriptorPool DescriptorPool;
+    static VkDescriptorSetLayout DescriptorSetLayout;
+    static VkDescriptorSet DescriptorSet;
+    static VkPipelineLayout PipelineLayout;
+};
@@ -0,0 +1,96 @@
+﻿#include "DeletionQueue.h"
+#include "VulkanInterface.h"
+
+std::mutex                                      FDeletionQueue::QueueMutex;
+std::vector<FDeletionQueue::FDeferredObject>    FDeletionQueue::PendingObjects;
+
+uint64_t GetDeferredRetireValue()
+{
+    return FVulkan::GetQueue(EQueueType::Graphics).GetNextValue();
+}
+
+void FDeletionQueue::Enqueue(EDeferredResourceType Type, uint64_t Handle, uint64_t RetireValue)
+{
+    std::lock_guard<std::mutex> Lock(QueueMutex);
+    PendingObjects.push_back({Type, Handle, RetireValue});
+}
+
+void FDeletionQueue::ReleaseRetired(uint64_t CompletedValue)
+{
+    std::lock_guard<std::mutex> Lock(QueueMutex);
+
+    // Destroy in submission order and compact the survivors in place
+    size_t Kept = 0;
+    for (size_t i = 0; i < PendingObjects.size(); ++i)
+    {
+        if(PendingObjects[i].RetireValue <= CompletedValue)
+        {
+            Destroy(PendingObjects[i]);
+        }
+        else
+        {
+            PendingObjects[Kept++] = PendingObjects[i];
+        }
+    }
+    PendingObjects.resize(Kept);
+}
+
+void FDeletionQueue::Flush()
+{
+    std::lock_guard<std::mutex> Lock(QueueMutex);
+    for(const FDeferredObject& Object : PendingObjects)
+    {
+        Destroy(Object);
+    }
+    PendingObjects.clear();
+}
+
+size_t FDeletionQueue::GetPendingNum()
+{
+    std::lock_guard<std::mutex> Lock(QueueMutex);
+    return PendingObjects.size();
+}
+
+void FDeletionQueue::Destroy(const FDeferredObject& Object)
+{
+    VkDevice Device = FVulkan::GetDevice();
+    switch (Object.Type)
+    {
+    case EDeferredResourceType::Buffer:
+        vkDestroyBuffer(Device, (VkBuffer)Object.Handle, nullptr);
+        break;
+    case EDeferredResourceType::Image:
+        vkDestroyImage(Device, (VkImage)Object.Handle, nullptr);
+        break;
+    case EDeferredResourceType::ImageView:
+        vkDestroyImageView(Device, (VkImageView)Object.Handle, nullptr);
+        break;
+    case EDeferredResourceType::Memory:
+        vkFreeMemory(Device, (VkDeviceMemory)Object.Handle, nullptr);
+        break;
+    case EDeferredResourceType::Sampler:
+        vkDestroySampler(Device, (VkSampler)Object.Handle, nullptr);
+        break;
+    case EDeferredResourceType::Framebuffer:
+        vkDestroyFramebuffer(Device, (VkFramebuffer)Object.Handle, nullptr);
+        break;
+    case EDeferredResourceType::RenderPass:
+        vkDestroyRenderPass(Device, (VkRenderPass)Object.Handle, nullptr);
+        break;
+    case EDeferredResourceType::Pipeline:
+        vkDestroyPipeline(Device, (VkPipeline)Object.Handle, nullptr);
+        break;
+    case EDeferredResourceType::PipelineLayout:
+        vkDestroyPipelineLayout(Device, (VkPipelineLayout)Object.Handle, nullptr);
+        break;
+    case EDeferredResourceType::DescriptorSetLayout:
+        vkDestroyDescriptorSetLayout(Device, (VkDescriptorSetLayout)Object.Handle, nullptr);
+        break;
+    case EDeferredResourceType::DescriptorPool:
+        vkDestroyDescriptorPool(Device, (VkDescriptorPool)Object.Handle, nullptr);
+        break;
+    case EDeferredResourceType::SwapChain:
+        vkDestroySwapchainKHR(Device, (VkSwapchainKHR)Object.Handle, nullptr);
+        break;
+    }
+}
@@ -0,0 +1,62 @@
+﻿#pragma once
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "vulkan/vulkan_core.h"
+
+enum class EDeferredResourceType : uint8_t
+{
+    Buffer,
+    Image,
+    ImageView,
+    Memory,
+    Sampler,
+    Framebuffer,
+    RenderPass,
+    Pipeline,
+    PipelineLayout,
+    DescriptorSetLayout,
+    DescriptorPool,
+    SwapChain,
+};
+
+// Holds GPU objects until the frame that last used them has retired, so releasing a resource never stalls the device
+class FDeletionQueue
+{
+public:
+    static void Enqueue(EDeferredResourceType Type, uint64_t Handle, uint64_t RetireValue);
+    template<typename HandleType>
+    static void Enqueue(EDeferredResourceType Type, HandleType Handle);
+
+    // Destroys every object whose retire value is lower or equal than the completed one
+    static void ReleaseRetired(uint64_t CompletedValue);
+    // Destroys everything, only valid once the device is idle
+    static void Flush();
+    static size_t GetPendingNum();
+
+private:
+    struct FDeferredObject
+    {
+        EDeferredResourceType Type;
+        uint64_t Handle;
+        uint64_t RetireValue;
+    };
+
+    static void Destroy(const FDeferredObject& Object);
+
+private:
+    static std::mutex QueueMutex;
+    static std::vector<FDeferredObject> PendingObjects;
+};
+
+// Resources released now may still be referenced by the next graphics submission
+uint64_t GetDeferredRetireValue();
+
+template <typename HandleType>
+void FDeletionQueue::Enqueue(EDeferredResourceType Type, HandleType Handle)
+{
+    if(Handle != VK_NULL_HANDLE)
+    {
+        Enqueue(Type, (uint64_t)Handle, GetDeferredRetireValue());
+    }
+}
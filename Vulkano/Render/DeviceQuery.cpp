@@ -0,0 +1,85 @@
+﻿#include "DeviceSelection.h"
+#include <algorithm>
+#include <cstring>
+
+// The only part of the device selection that calls Vulkan, the scoring in DeviceSelection.cpp links without a loader
+
+FPhysicalDeviceInfo FDeviceSelector::Query(VkPhysicalDevice PhysicalDevice, VkSurfaceKHR Surface)
+{
+    FPhysicalDeviceInfo Info;
+
+    // deviceUUID is what vulkaninfo prints and stays the same across driver updates
+    VkPhysicalDeviceIDProperties IDProperties{};
+    IDProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+    VkPhysicalDeviceProperties2 Properties{};
+    Properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    Properties.pNext = &IDProperties;
+    vkGetPhysicalDeviceProperties2(PhysicalDevice, &Properties);
+    Info.Name = Properties.properties.deviceName;
+    Info.Type = Properties.properties.deviceType;
+    Info.ApiVersion = Properties.properties.apiVersion;
+    memcpy(Info.UUID.data(), IDProperties.deviceUUID, VK_UUID_SIZE);
+
+    VkPhysicalDeviceMemoryProperties MemoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(PhysicalDevice, &MemoryProperties);
+    for (uint32_t Heap = 0; Heap < MemoryProperties.memoryHeapCount; ++Heap)
+    {
+        if (MemoryProperties.memoryHeaps[Heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+        {
+            Info.DeviceLocalHeapSize = std::max(Info.DeviceLocalHeapSize, MemoryProperties.memoryHeaps[Heap].size);
+        }
+    }
+
+    uint32_t ExtensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(PhysicalDevice, nullptr, &ExtensionCount, nullptr);
+    std::vector<VkExtensionProperties> Extensions(ExtensionCount);
+    vkEnumerateDeviceExtensionProperties(PhysicalDevice, nullptr, &ExtensionCount, Extensions.data());
+    for (const VkExtensionProperties& Extension : Extensions)
+    {
+        Info.Extensions.push_back(Extension.extensionName);
+    }
+
+    uint32_t FamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(PhysicalDevice, &FamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> Families(FamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(PhysicalDevice, &FamilyCount, Families.data());
+    for (uint32_t Family = 0; Family < FamilyCount; ++Family)
+    {
+        FPhysicalDeviceInfo::FQueueFamily& QueueFamily = Info.QueueFamilies.emplace_back();
+        QueueFamily.Flags = Families[Family].queueFlags;
+        QueueFamily.QueueCount = Families[Family].queueCount;
+        if (Surface != VK_NULL_HANDLE)
+        {
+            VkBool32 bSupported = VK_FALSE;
+            vkGetPhysicalDeviceSurfaceSupportKHR(PhysicalDevice, Family, Surface, &bSupported);
+            QueueFamily.bPresent = bSupported == VK_TRUE;
+        }
+    }
+
+    // The 1.2/1.3 feature structs are only valid on devices that report those versions
+    if (Info.ApiVersion >= VK_API_VERSION_1_2)
+    {
+        VkPhysicalDeviceVulkan13Features Features13{};
+        Features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+        VkPhysicalDeviceVulkan12Features Features12{};
+        Features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        Features12.pNext = Info.ApiVersion >= VK_API_VERSION_1_3 ? &Features13 : nullptr;
+        VkPhysicalDeviceFeatures2 Features{};
+        Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        Features.pNext = &Features12;
+        vkGetPhysicalDeviceFeatures2(PhysicalDevice, &Features);
+
+        Info.bSamplerAnisotropy = Features.features.samplerAnisotropy == VK_TRUE;
+        Info.bTimelineSemaphore = Features12.timelineSemaphore == VK_TRUE;
+        Info.bImagelessFramebuffer = Features12.imagelessFramebuffer == VK_TRUE;
+        Info.bDynamicRendering = Info.ApiVersion >= VK_API_VERSION_1_3 && Features13.dynamicRendering == VK_TRUE;
+        Info.bDescriptorIndexing = Features12.descriptorIndexing &&
+            Features12.runtimeDescriptorArray &&
+            Features12.descriptorBindingPartiallyBound &&
+            Features12.descriptorBindingSampledImageUpdateAfterBind &&
+            Features12.descriptorBindingStorageBufferUpdateAfterBind &&
+            Features12.shaderSampledImageArrayNonUniformIndexing &&
+            Features12.shaderStorageBufferArrayNonUniformIndexing;
+    }
+    return Info;
+}
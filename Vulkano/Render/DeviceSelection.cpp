@@ -0,0 +1,175 @@
+﻿#include "DeviceSelection.h"
+#include <algorithm>
+#include <cctype>
+#include "Core/VulkanoLog.h"
+
+namespace
+{
+    // Type decides first, memory and capability scores together stay below the gap between two types
+    constexpr int64_t DiscreteScore         = 400000;
+    constexpr int64_t IntegratedScore       = 300000;
+    constexpr int64_t VirtualScore          = 200000;
+    constexpr int64_t CpuScore              = 100000;
+    constexpr int64_t MaxHeapScore          = 40000;
+    constexpr int64_t Vulkan13Score         = 1000;
+    constexpr int64_t DynamicRenderingScore = 2000;
+    constexpr int64_t PresentWaitScore      = 500;
+    constexpr int64_t TransferFamilyScore   = 3000;
+    constexpr int64_t ComputeFamilyScore    = 2000;
+    constexpr int64_t GraphicsPresentScore  = 1000;
+
+    std::string ToLower(std::string Text)
+    {
+        std::transform(Text.begin(), Text.end(), Text.begin(), [](unsigned char Character) { return static_cast<char>(std::tolower(Character)); });
+        return Text;
+    }
+}
+
+bool FPhysicalDeviceInfo::HasExtension(const char* ExtensionName) const
+{
+    return std::find(Extensions.begin(), Extensions.end(), ExtensionName) != Extensions.end();
+}
+
+FDeviceScore FDeviceSelector::Score(const FPhysicalDeviceInfo& Info, bool bRequirePresent)
+{
+    FDeviceScore Result;
+
+    bool bGraphics = false;
+    bool bPresent = false;
+    bool bGraphicsPresent = false;
+    bool bTransferFamily = false;
+    bool bComputeFamily = false;
+    for (const FPhysicalDeviceInfo::FQueueFamily& Family : Info.QueueFamilies)
+    {
+        if (Family.QueueCount == 0)
+        {
+            continue;
+        }
+        const bool bFamilyGraphics = (Family.Flags & VK_QUEUE_GRAPHICS_BIT) != 0;
+        const bool bFamilyCompute = (Family.Flags & VK_QUEUE_COMPUTE_BIT) != 0;
+        bGraphics |= bFamilyGraphics;
+        bPresent |= Family.bPresent;
+        bGraphicsPresent |= bFamilyGraphics && Family.bPresent;
+        // Copy engines, uploads on them don't take graphics queue time
+        bTransferFamily |= (Family.Flags & VK_QUEUE_TRANSFER_BIT) && !bFamilyGraphics && !bFamilyCompute;
+        bComputeFamily |= bFamilyCompute && !bFamilyGraphics;
+    }
+
+    // Same requirements CreateVulkanDevice enforces
+    if (Info.ApiVersion < VK_API_VERSION_1_2)
+    {
+        Result.Reason = "Vulkan 1.2 is not supported";
+    }
+    else if (!bGraphics)
+    {
+        Result.Reason = "no graphics queue family";
+    }
+    else if (bRequirePresent && (!bPresent || !Info.HasExtension(VK_KHR_SWAPCHAIN_EXTENSION_NAME)))
+    {
+        Result.Reason = "can't present to the window";
+    }
+    else if (!Info.bTimelineSemaphore)
+    {
+        Result.Reason = "no timeline semaphores";
+    }
+    else if (!Info.bDescriptorIndexing)
+    {
+        Result.Reason = "no descriptor indexing";
+    }
+    else if (!Info.bDynamicRendering && !Info.bImagelessFramebuffer)
+    {
+        Result.Reason = "neither dynamic rendering nor imageless frame buffers";
+    }
+    else if (!Info.bSamplerAnisotropy)
+    {
+        Result.Reason = "no sampler anisotropy";
+    }
+    if (!Result.Reason.empty())
+    {
+        return Result;
+    }
+
+    Result.bSuitable = true;
+    switch (Info.Type)
+    {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:   Result.Score += DiscreteScore; break;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: Result.Score += IntegratedScore; break;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:    Result.Score += VirtualScore; break;
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:            Result.Score += CpuScore; break;
+    default: break;
+    }
+
+    // One point per MiB
+    Result.Score += std::min(static_cast<int64_t>(Info.DeviceLocalHeapSize >> 20), MaxHeapScore);
+    Result.Score += Info.ApiVersion >= VK_API_VERSION_1_3 ? Vulkan13Score : 0;
+    Result.Score += Info.bDynamicRendering ? DynamicRenderingScore : 0;
+    Result.Score += bTransferFamily ? TransferFamilyScore : 0;
+    Result.Score += bComputeFamily ? ComputeFamilyScore : 0;
+    if (bRequirePresent)
+    {
+        // Presenting from the graphics family needs no extra queue submission
+        Result.Score += bGraphicsPresent ? GraphicsPresentScore : 0;
+        Result.Score += Info.HasExtension(VK_KHR_PRESENT_ID_EXTENSION_NAME) && Info.HasExtension(VK_KHR_PRESENT_WAIT_EXTENSION_NAME) ? PresentWaitScore : 0;
+    }
+    return Result;
+}
+
+int32_t FDeviceSelector::Select(const std::vector<FPhysicalDeviceInfo>& Devices, const std::string& Preferred, bool bRequirePresent)
+{
+    int32_t BestIndex = -1;
+    int32_t PreferredIndex = -1;
+    int64_t BestScore = 0;
+    for (size_t Index = 0; Index < Devices.size(); ++Index)
+    {
+        const FPhysicalDeviceInfo& Info = Devices[Index];
+        const FDeviceScore DeviceScore = Score(Info, bRequirePresent);
+        const bool bPreferred = !Preferred.empty() && MatchesPreferred(Info, Preferred);
+        if (!DeviceScore.bSuitable)
+        {
+            VK_LOG(bPreferred ? LOG_WARNING : LOG_INFO, "Device [%s] %s is unsuitable, %s", Info.Name.c_str(), FormatUUID(Info.UUID).c_str(), DeviceScore.Reason.c_str());
+            continue;
+        }
+
+        VK_LOG(LOG_INFO, "Device [%s] %s Type: %i API: %u.%u score %lld", Info.Name.c_str(), FormatUUID(Info.UUID).c_str(), static_cast<int>(Info.Type),
+            VK_API_VERSION_MAJOR(Info.ApiVersion), VK_API_VERSION_MINOR(Info.ApiVersion), static_cast<long long>(DeviceScore.Score));
+        if (bPreferred && PreferredIndex < 0)
+        {
+            PreferredIndex = static_cast<int32_t>(Index);
+        }
+        // Ties keep the enumeration order
+        if (BestIndex < 0 || DeviceScore.Score > BestScore)
+        {
+            BestIndex = static_cast<int32_t>(Index);
+            BestScore = DeviceScore.Score;
+        }
+    }
+
+    if (!Preferred.empty() && PreferredIndex < 0)
+    {
+        VK_LOG(LOG_WARNING, "No suitable device matches %s, using the best scored one", Preferred.c_str());
+    }
+    return PreferredIndex >= 0 ? PreferredIndex : BestIndex;
+}
+
+std::string FDeviceSelector::FormatUUID(const std::array<uint8_t, VK_UUID_SIZE>& UUID)
+{
+    // 8-4-4-4-12 like the tools print it
+    static const char* Digits = "0123456789abcdef";
+    std::string Text;
+    for (size_t Index = 0; Index < UUID.size(); ++Index)
+    {
+        if (Index == 4 || Index == 6 || Index == 8 || Index == 10)
+        {
+            Text += '-';
+        }
+        Text += Digits[UUID[Index] >> 4];
+        Text += Digits[UUID[Index] & 0xf];
+    }
+    return Text;
+}
+
+bool FDeviceSelector::MatchesPreferred(const FPhysicalDeviceInfo& Info, const std::string& Preferred)
+{
+    const std::string LowerPreferred = ToLower(Preferred);
+    return ToLower(FormatUUID(Info.UUID)) == LowerPreferred || ToLower(Info.Name).find(LowerPreferred) != std::string::npos;
+}
@@ -0,0 +1,63 @@
+﻿#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "vulkan/vulkan_core.h"
+
+// What the scoring needs to know about a physical device. Filled from Vulkan by Query, or by hand to
+// check the scoring against made up property tables without a GPU
+struct FPhysicalDeviceInfo
+{
+    struct FQueueFamily
+    {
+        VkQueueFlags Flags = 0;
+        uint32_t QueueCount = 0;
+        bool bPresent = false;
+    };
+
+    std::string Name;
+    std::array<uint8_t, VK_UUID_SIZE> UUID = {};
+    VkPhysicalDeviceType Type = VK_PHYSICAL_DEVICE_TYPE_OTHER;
+    uint32_t ApiVersion = 0;
+    // Largest DEVICE_LOCAL heap, integrated devices report the shared system memory here
+    VkDeviceSize DeviceLocalHeapSize = 0;
+    std::vector<std::string> Extensions;
+    std::vector<FQueueFamily> QueueFamilies;
+
+    bool bTimelineSemaphore = false;
+    // Every descriptor indexing feature the bindless heap uses
+    bool bDescriptorIndexing = false;
+    bool bDynamicRendering = false;
+    bool bImagelessFramebuffer = false;
+    bool bSamplerAnisotropy = false;
+
+    bool HasExtension(const char* ExtensionName) const;
+};
+
+struct FDeviceScore
+{
+    bool bSuitable = false;
+    int64_t Score = 0;
+    // First missing requirement of unsuitable devices
+    std::string Reason;
+};
+
+// Picks the physical device, the first device is often the integrated or software one on hybrid laptops and multi GPU servers.
+// Devices missing what CreateVulkanDevice requires are rejected, the rest are ranked by type, then memory, then capabilities
+class FDeviceSelector
+{
+public:
+    // bRequirePresent needs a family with present support and the swap chain extension
+    static FDeviceScore Score(const FPhysicalDeviceInfo& Info, bool bRequirePresent);
+    // Preferred is a device name, matched case insensitive as a substring, or a UUID as printed by FormatUUID.
+    // A preferred device that is missing or unsuitable falls back to the best score. -1 when nothing is suitable
+    static int32_t Select(const std::vector<FPhysicalDeviceInfo>& Devices, const std::string& Preferred, bool bRequirePresent);
+
+    // Surface may be VK_NULL_HANDLE, no family supports present then. Defined in DeviceQuery.cpp
+    static FPhysicalDeviceInfo Query(VkPhysicalDevice PhysicalDevice, VkSurfaceKHR Surface);
+    static std::string FormatUUID(const std::array<uint8_t, VK_UUID_SIZE>& UUID);
+
+private:
+    static bool MatchesPreferred(const FPhysicalDeviceInfo& Info, const std::string& Preferred);
+};
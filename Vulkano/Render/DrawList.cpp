@@ -0,0 +1,242 @@
+﻿#include "DrawList.h"
+
+#include <cstring>
+#include "VulkanInterface.h"
+#include "Core/Assertion.h"
+#include "Core/RadixSort.h"
+
+uint64_t FDrawSortKey::Make(uint32_t Pipeline, uint32_t Material, uint32_t VertexBuffer, float ViewDepth, bool bBackToFront)
+{
+    // Positive floats order like their bit patterns, the top bits keep the exponent and part of the mantissa
+    float Depth = ViewDepth > 0.0f ? ViewDepth : 0.0f;
+    uint32_t DepthBitsValue;
+    memcpy(&DepthBitsValue, &Depth, sizeof(Depth));
+    uint64_t DepthKey = DepthBitsValue >> (32 - DepthBits - 1);
+    if (bBackToFront)
+    {
+        DepthKey = ~DepthKey;
+    }
+    DepthKey &= (1ull << DepthBits) - 1;
+
+    uint64_t Key = static_cast<uint64_t>(Pipeline & ((1u << PipelineBits) - 1)) << (MaterialBits + VertexBufferBits + DepthBits);
+    Key |= static_cast<uint64_t>(Material & ((1u << MaterialBits) - 1)) << (VertexBufferBits + DepthBits);
+    Key |= static_cast<uint64_t>(VertexBuffer & ((1u << VertexBufferBits) - 1)) << DepthBits;
+    return Key | DepthKey;
+}
+
+// True when the pipeline reads per-instance data from the stream Submit binds
+static bool ReadsInstanceStream(const FGraphicsPipelineInitializer& Pipeline)
+{
+    const VkPipelineVertexInputStateCreateInfo& VertexInput = Pipeline.VertexInput->GetInputVertexState();
+    for (uint32_t Index = 0; Index < VertexInput.vertexBindingDescriptionCount; ++Index)
+    {
+        const VkVertexInputBindingDescription& Binding = VertexInput.pVertexBindingDescriptions[Index];
+        if (Binding.binding == FDrawList::InstanceStreamIndex && Binding.inputRate == VK_VERTEX_INPUT_RATE_INSTANCE)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void FDrawList::Reset()
+{
+    Pipelines.clear();
+    Materials.clear();
+    VertexBuffers.clear();
+    VertexBufferIds.clear();
+    Commands.clear();
+    SortKeys.clear();
+    SortedCommands.clear();
+    Instances.clear();
+    BatchedInstances.clear();
+    Batches.clear();
+}
+
+uint32_t FDrawList::AddPipeline(const FGraphicsPipelineInitializer& Initializer)
+{
+    // Only a handful of pipelines per pass, a linear search is enough
+    for (size_t Index = 0; Index < Pipelines.size(); ++Index)
+    {
+        const FGraphicsPipelineInitializer& Pipeline = Pipelines[Index];
+        if (Pipeline.VertexShader == Initializer.VertexShader && Pipeline.PixelShader == Initializer.PixelShader &&
+            Pipeline.PrimitiveTopology == Initializer.PrimitiveTopology && Pipeline.VertexInput == Initializer.VertexInput &&
+            Pipeline.State == Initializer.State && Pipeline.RenderPass == Initializer.RenderPass)
+        {
+            return static_cast<uint32_t>(Index);
+        }
+    }
+    checkf(Pipelines.size() < (1u << FDrawSortKey::PipelineBits), "FDrawList::AddPipeline too many pipelines %zu", Pipelines.size());
+    Pipelines.push_back(Initializer);
+    return static_cast<uint32_t>(Pipelines.size() - 1);
+}
+
+uint32_t FDrawList::AddMaterial(const void* PushConstants, uint32_t Size)
+{
+    checkf(Size <= MaxMaterialSize, "FDrawList::AddMaterial material constants too large %u", Size);
+    checkf(Materials.size() < (1u << FDrawSortKey::MaterialBits), "FDrawList::AddMaterial too many materials %zu", Materials.size());
+    FMaterial& Material = Materials.emplace_back();
+    memcpy(Material.PushConstants, PushConstants, Size);
+    Material.Size = Size;
+    return static_cast<uint32_t>(Materials.size() - 1);
+}
+
+uint32_t FDrawList::AddVertexBuffer(const std::shared_ptr<FVulkanBuffer>& Buffer)
+{
+    auto It = VertexBufferIds.find(Buffer.get());
+    if (It != VertexBufferIds.end())
+    {
+        return It->second;
+    }
+    checkf(VertexBuffers.size() < (1u << FDrawSortKey::VertexBufferBits), "FDrawList::AddVertexBuffer too many vertex buffers %zu", VertexBuffers.size());
+    const uint32_t Id = static_cast<uint32_t>(VertexBuffers.size());
+    VertexBuffers.push_back(Buffer);
+    VertexBufferIds.emplace(Buffer.get(), Id);
+    return Id;
+}
+
+void FDrawList::AddDraw(const FDrawCommand& Command)
+{
+    check(Command.PipelineId < Pipelines.size() && Command.VertexBufferId < VertexBuffers.size());
+    // Only instanced draws fill the instance stream, a plain draw would read whatever is bound there
+    checkf(!ReadsInstanceStream(Pipelines[Command.PipelineId]), "FDrawList::AddDraw pipeline %u reads the instance stream, use AddInstancedDraw", Command.PipelineId);
+    Commands.push_back(Command);
+}
+
+void FDrawList::AddInstancedDraw(const FDrawCommand& Command, const FInstanceData& Instance)
+{
+    check(Command.PipelineId < Pipelines.size() && Command.VertexBufferId < VertexBuffers.size());
+    checkf(ReadsInstanceStream(Pipelines[Command.PipelineId]), "FDrawList::AddInstancedDraw pipeline %u has no instance rate binding %u", Command.PipelineId, InstanceStreamIndex);
+    FDrawCommand& Added = Commands.emplace_back(Command);
+    Added.InstanceCount = 1;
+    Added.InstanceIndex = static_cast<uint32_t>(Instances.size());
+    Instances.push_back(Instance);
+}
+
+void FDrawList::SetBackToFront(bool bInBackToFront)
+{
+    bBackToFront = bInBackToFront;
+}
+
+void FDrawList::Sort()
+{
+    const uint32_t Num = GetDrawNum();
+    SortKeys.resize(Num);
+    SortedCommands.resize(Num);
+    for (uint32_t Index = 0; Index < Num; ++Index)
+    {
+        const FDrawCommand& Command = Commands[Index];
+        uint64_t Key = FDrawSortKey::Make(Command.PipelineId, Command.MaterialId, Command.VertexBufferId, Command.ViewDepth, bBackToFront);
+        if (Command.IsInstanced())
+        {
+            // Instances are not depth sorted, the low bits group the same vertex range so they end up adjacent
+            const uint64_t DepthMask = (1ull << FDrawSortKey::DepthBits) - 1;
+            const uint64_t RangeHash = (Command.BaseVertex * 0x9E3779B1u) ^ (Command.VertexCount * 0x85EBCA77u);
+            Key = (Key & ~DepthMask) | ((RangeHash >> 12) & DepthMask);
+        }
+        SortKeys[Index] = Key;
+        SortedCommands[Index] = Index;
+    }
+    RadixSort(SortKeys, SortedCommands);
+    BuildBatches();
+}
+
+void FDrawList::BuildBatches()
+{
+    Batches.clear();
+    BatchedInstances.clear();
+    BatchedInstances.reserve(Instances.size());
+
+    const uint32_t Num = static_cast<uint32_t>(SortedCommands.size());
+    uint32_t Begin = 0;
+    while (Begin < Num)
+    {
+        const FDrawCommand& First = Commands[SortedCommands[Begin]];
+        uint32_t End = Begin + 1;
+        if (!First.IsInstanced())
+        {
+            Batches.push_back({SortedCommands[Begin], 0, First.InstanceCount});
+            Begin = End;
+            continue;
+        }
+
+        // Hash collisions can interleave different meshes, a batch only spans identical neighbours
+        while (End < Num)
+        {
+            const FDrawCommand& Next = Commands[SortedCommands[End]];
+            if (!Next.IsInstanced() || Next.PipelineId != First.PipelineId || Next.MaterialId != First.MaterialId ||
+                Next.VertexBufferId != First.VertexBufferId || Next.BaseVertex != First.BaseVertex ||
+                Next.VertexCount != First.VertexCount || Next.Uniforms.Offset != First.Uniforms.Offset ||
+                Next.Uniforms.Size != First.Uniforms.Size)
+            {
+                break;
+            }
+            ++End;
+        }
+
+        const uint32_t FirstInstance = static_cast<uint32_t>(BatchedInstances.size());
+        for (uint32_t Index = Begin; Index < End; ++Index)
+        {
+            BatchedInstances.push_back(Instances[Commands[SortedCommands[Index]].InstanceIndex]);
+        }
+        Batches.push_back({SortedCommands[Begin], FirstInstance, End - Begin});
+        Begin = End;
+    }
+}
+
+void FDrawList::Submit() const
+{
+    checkf(SortedCommands.size() == Commands.size(), "FDrawList::Submit called without Sort");
+
+    // Every batch reads the same instance stream, firstInstance selects its range
+    if (!BatchedInstances.empty())
+    {
+        const uint32_t Size = static_cast<uint32_t>(BatchedInstances.size() * sizeof(FInstanceData));
+        FUniformAllocation Allocation = FVulkan::AllocateInstanceData(Size);
+        memcpy(Allocation.Data, BatchedInstances.data(), Size);
+        FVulkan::BindInstanceStream(InstanceStreamIndex, Allocation);
+    }
+
+    // FVulkan skips rebinding what the command buffer already has, pipelines are also tracked here to skip the PSO lookup
+    uint32_t CurrentPipeline = UINT32_MAX;
+    uint32_t CurrentMaterial = UINT32_MAX;
+    for (const FDrawBatch& Batch : Batches)
+    {
+        const FDrawCommand& Command = Commands[Batch.CommandIndex];
+        if (Command.PipelineId != CurrentPipeline)
+        {
+            FVulkan::SetGraphicsPipeline(Pipelines[Command.PipelineId]);
+            CurrentPipeline = Command.PipelineId;
+        }
+        if (Command.MaterialId != CurrentMaterial && Command.MaterialId < Materials.size())
+        {
+            const FMaterial& Material = Materials[Command.MaterialId];
+            if (Material.Size > 0)
+            {
+                FVulkan::SetPushConstants(Material.PushConstants, Material.Size, MaterialPushConstantOffset);
+            }
+            CurrentMaterial = Command.MaterialId;
+        }
+        FVulkan::BindStreamResource(0, VertexBuffers[Command.VertexBufferId], 0);
+        if (Command.Uniforms.Size > 0)
+        {
+            FVulkan::BindUniform(Command.Uniforms);
+        }
+        FVulkan::DrawPrimitive(Command.BaseVertex, Command.VertexCount, Batch.InstanceCount, Batch.FirstInstance);
+    }
+}
+
+uint32_t FDrawList::GetDrawNum() const
+{
+    return static_cast<uint32_t>(Commands.size());
+}
+
+uint32_t FDrawList::GetBatchNum() const
+{
+    return static_cast<uint32_t>(Batches.size());
+}
+
+const std::vector<uint32_t>& FDrawList::GetSortedCommands() const
+{
+    return SortedCommands;
+}
@@ -0,0 +1,100 @@
+﻿#pragma once
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "RenderResources.h"
+#include "UniformStreamAllocator.h"
+#include "VertexInputs.h"
+
+// 64 bit draw sort key, the most expensive state change sits in the highest bits:
+// pipeline (12) | material (16) | vertex buffer (16) | view depth (20)
+struct FDrawSortKey
+{
+    static constexpr uint32_t PipelineBits = 12;
+    static constexpr uint32_t MaterialBits = 16;
+    static constexpr uint32_t VertexBufferBits = 16;
+    static constexpr uint32_t DepthBits = 20;
+
+    static uint64_t Make(uint32_t Pipeline, uint32_t Material, uint32_t VertexBuffer, float ViewDepth, bool bBackToFront = false);
+};
+
+struct FDrawCommand
+{
+    // Ids returned by the draw list this command is added to
+    uint32_t PipelineId = 0;
+    uint32_t MaterialId = 0;
+    uint32_t VertexBufferId = 0;
+    uint32_t BaseVertex = 0;
+    uint32_t VertexCount = 0;
+    uint32_t InstanceCount = 1;
+    // Per-draw uniforms, a zero size keeps whatever is bound
+    FUniformAllocation Uniforms;
+    float ViewDepth = 0.0f;
+    // Set by AddInstancedDraw, index into the list's instance data
+    uint32_t InstanceIndex = UINT32_MAX;
+
+    bool IsInstanced() const { return InstanceIndex != UINT32_MAX; }
+};
+
+// Collects a frame's draws, radix sorts them by state and records them with redundant binds skipped.
+// Ids are only valid until the next Reset.
+class FDrawList
+{
+public:
+    // Material push constants follow the 64 bytes of view constants
+    static constexpr uint32_t MaterialPushConstantOffset = 64;
+    static constexpr uint32_t MaxMaterialSize = 64;
+    static constexpr uint32_t InstanceStreamIndex = 1;
+
+    void Reset();
+    uint32_t AddPipeline(const FGraphicsPipelineInitializer& Initializer);
+    uint32_t AddMaterial(const void* PushConstants, uint32_t Size);
+    uint32_t AddVertexBuffer(const std::shared_ptr<FVulkanBuffer>& Buffer);
+    void AddDraw(const FDrawCommand& Command);
+    // Draws of the same mesh with the same pipeline and material are merged into one instanced draw.
+    // The pipeline's vertex input must read FInstanceData from InstanceStreamIndex.
+    void AddInstancedDraw(const FDrawCommand& Command, const FInstanceData& Instance);
+    // Translucent lists sort back to front inside a pipeline / material group
+    void SetBackToFront(bool bInBackToFront);
+
+    void Sort();
+    // Records the sorted draws into the graphics command buffer, must be inside a render pass
+    void Submit() const;
+
+    uint32_t GetDrawNum() const;
+    // Draw calls Submit records after instanced draws are merged, valid after Sort
+    uint32_t GetBatchNum() const;
+    // Command indices in submission order, valid after Sort
+    const std::vector<uint32_t>& GetSortedCommands() const;
+
+private:
+    void BuildBatches();
+
+private:
+    // A run of sorted commands recorded as a single draw
+    struct FDrawBatch
+    {
+        uint32_t CommandIndex;
+        uint32_t FirstInstance;
+        uint32_t InstanceCount;
+    };
+
+    struct FMaterial
+    {
+        uint8_t PushConstants[MaxMaterialSize];
+        uint32_t Size;
+    };
+    
+    std::vector<FGraphicsPipelineInitializer> Pipelines;
+    std::vector<FMaterial> Materials;
+    std::vector<std::shared_ptr<FVulkanBuffer>> VertexBuffers;
+    std::unordered_map<const FVulkanBuffer*, uint32_t> VertexBufferIds;
+    std::vector<FDrawCommand> Commands;
+    std::vector<uint64_t> SortKeys;
+    std::vector<uint32_t> SortedCommands;
+    std::vector<FInstanceData> Instances;
+    std::vector<FInstanceData> BatchedInstances;
+    std::vector<FDrawBatch> Batches;
+    bool bBackToFront = false;
+};
@@ -0,0 +1,178 @@
+﻿#include "FramePacer.h"
+#include <algorithm>
+#include <cmath>
+#include "Core/Platform.h"
+
+uint64_t FSystemFrameClock::GetMicroseconds() const
+{
+    return FPlatform::GetMicroseconds();
+}
+
+void FSystemFrameClock::SleepUntil(uint64_t Microseconds)
+{
+    // OS sleeps have ~1ms granularity, sleep the bulk and spin the last part
+    const uint64_t SpinThreshold = 2000;
+    uint64_t Now = GetMicroseconds();
+    while (Now + SpinThreshold < Microseconds)
+    {
+        FPlatform::SleepMicroseconds(Microseconds - Now - SpinThreshold);
+        Now = GetMicroseconds();
+    }
+
+    while (GetMicroseconds() < Microseconds)
+    {
+        FPlatform::CpuPause();
+    }
+}
+
+uint64_t FSimulatedFrameClock::GetMicroseconds() const
+{
+    return Now;
+}
+
+void FSimulatedFrameClock::SleepUntil(uint64_t Microseconds)
+{
+    Now = std::max(Now, Microseconds);
+}
+
+void FSimulatedFrameClock::Advance(uint64_t Microseconds)
+{
+    Now += Microseconds;
+}
+
+void FFrameTimeStats::AddSample(float Milliseconds)
+{
+    Samples[NextSample] = Milliseconds;
+    NextSample = (NextSample + 1) % WindowSize;
+    SampleNum = std::min(SampleNum + 1, static_cast<uint32_t>(WindowSize));
+}
+
+void FFrameTimeStats::Reset()
+{
+    NextSample = 0;
+    SampleNum = 0;
+}
+
+float FFrameTimeStats::GetPercentile(float Percentile) const
+{
+    if(SampleNum == 0)
+    {
+        return 0.0f;
+    }
+
+    // Nearest rank on a copy, the window is small and this runs once per stats query
+    std::copy(Samples.begin(), Samples.begin() + SampleNum, SortedSamples.begin());
+    const uint32_t Rank = std::clamp(static_cast<uint32_t>(std::ceil(Percentile / 100.0f * SampleNum)), 1u, SampleNum) - 1;
+    std::nth_element(SortedSamples.begin(), SortedSamples.begin() + Rank, SortedSamples.begin() + SampleNum);
+    return SortedSamples[Rank];
+}
+
+float FFrameTimeStats::GetAverage() const
+{
+    if(SampleNum == 0)
+    {
+        return 0.0f;
+    }
+
+    float Sum = 0.0f;
+    for (uint32_t i = 0; i < SampleNum; ++i)
+    {
+        Sum += Samples[i];
+    }
+    return Sum / SampleNum;
+}
+
+uint32_t FFrameTimeStats::GetSampleNum() const
+{
+    return SampleNum;
+}
+
+FFramePacer::FFramePacer(FFrameClock* InClock)
+{
+    Clock = InClock;
+}
+
+void FFramePacer::SetTargetFrameRate(float FramesPerSecond)
+{
+    TargetInterval = FramesPerSecond > 0.0f ? static_cast<uint64_t>(1000000.0f / FramesPerSecond) : 0;
+    bHasDeadline = false;
+}
+
+float FFramePacer::GetTargetFrameRate() const
+{
+    return TargetInterval > 0 ? 1000000.0f / TargetInterval : 0.0f;
+}
+
+void FFramePacer::SetSafetyMargin(uint64_t Microseconds)
+{
+    SafetyMargin = Microseconds;
+}
+
+uint64_t FFramePacer::WaitForNextFrame()
+{
+    const uint64_t PredictedWork = static_cast<uint64_t>(PredictedWorkTime) + SafetyMargin;
+    if(TargetInterval > 0)
+    {
+        const uint64_t Now = Clock->GetMicroseconds();
+
+        // A frame behind, pace from now instead of catching up with a burst of frames
+        if(!bHasDeadline || Now + PredictedWork > FrameDeadline + TargetInterval)
+        {
+            FrameDeadline = Now + PredictedWork;
+            bHasDeadline = true;
+        }
+
+        // Start as late as possible so the work ends right on the deadline, a shrinking prediction
+        // never stretches the frame past the target interval
+        uint64_t WakeTime = FrameDeadline > PredictedWork ? FrameDeadline - PredictedWork : 0;
+        if(FrameCount > 0)
+        {
+            WakeTime = std::min(WakeTime, LastFrameStart + TargetInterval);
+        }
+        if(WakeTime > Now)
+        {
+            Clock->SleepUntil(WakeTime);
+        }
+    }
+
+    FrameStart = Clock->GetMicroseconds();
+    if(FrameCount > 0)
+    {
+        FrameTimes.AddSample(static_cast<float>(FrameStart - LastFrameStart) / 1000.0f);
+    }
+    LastFrameStart = FrameStart;
+    FrameDeadline += TargetInterval;
+    FrameCount++;
+    return FrameStart;
+}
+
+void FFramePacer::EndFrame()
+{
+    const float WorkTime = static_cast<float>(Clock->GetMicroseconds() - FrameStart);
+    WorkTimes.AddSample(WorkTime / 1000.0f);
+
+    // Fast attack, slow decay, a spike moves the wake up earlier right away
+    PredictedWorkTime = WorkTime > PredictedWorkTime ? WorkTime : PredictedWorkTime * 0.9f + WorkTime * 0.1f;
+}
+
+FFramePacingStats FFramePacer::GetStats() const
+{
+    FFramePacingStats Stats;
+    Stats.P50 = FrameTimes.GetPercentile(50.0f);
+    Stats.P95 = FrameTimes.GetPercentile(95.0f);
+    Stats.P99 = FrameTimes.GetPercentile(99.0f);
+    Stats.Average = FrameTimes.GetAverage();
+    Stats.PredictedWorkTime = PredictedWorkTime / 1000.0f;
+    Stats.FrameCount = FrameCount;
+    return Stats;
+}
+
+const FFrameTimeStats& FFramePacer::GetFrameTimes() const
+{
+    return FrameTimes;
+}
+
+const FFrameTimeStats& FFramePacer::GetWorkTimes() const
+{
+    return WorkTimes;
+}
@@ -0,0 +1,99 @@
+﻿#pragma once
+#include <array>
+#include <cstdint>
+
+// Time source of the pacer, the simulated one lets the pacing logic run without real sleeps
+class FFrameClock
+{
+public:
+    virtual ~FFrameClock(){}
+    virtual uint64_t GetMicroseconds() const = 0;
+    virtual void SleepUntil(uint64_t Microseconds) = 0;
+};
+
+class FSystemFrameClock : public FFrameClock
+{
+public:
+    virtual uint64_t GetMicroseconds() const override;
+    virtual void SleepUntil(uint64_t Microseconds) override;
+};
+
+class FSimulatedFrameClock : public FFrameClock
+{
+public:
+    virtual uint64_t GetMicroseconds() const override;
+    virtual void SleepUntil(uint64_t Microseconds) override;
+    void Advance(uint64_t Microseconds);
+
+private:
+    uint64_t Now = 0;
+};
+
+// Rolling window of frame times in milliseconds
+class FFrameTimeStats
+{
+public:
+    enum
+    {
+        WindowSize = 240
+    };
+
+    void AddSample(float Milliseconds);
+    void Reset();
+    float GetPercentile(float Percentile) const;
+    float GetAverage() const;
+    uint32_t GetSampleNum() const;
+
+private:
+    std::array<float, WindowSize> Samples = {};
+    mutable std::array<float, WindowSize> SortedSamples = {};
+    uint32_t NextSample = 0;
+    uint32_t SampleNum = 0;
+};
+
+struct FFramePacingStats
+{
+    float P50 = 0.0f;
+    float P95 = 0.0f;
+    float P99 = 0.0f;
+    float Average = 0.0f;
+    float PredictedWorkTime = 0.0f;
+    uint64_t FrameCount = 0;
+};
+
+// Paces frames to a target rate, the wait is placed right before input sampling and sized so
+// the frame work ends on its deadline, input is as fresh as possible when the frame is presented
+class FFramePacer
+{
+public:
+    explicit FFramePacer(FFrameClock* InClock);
+
+    // 0 disables the limiter, frames still get measured
+    void SetTargetFrameRate(float FramesPerSecond);
+    float GetTargetFrameRate() const;
+    void SetSafetyMargin(uint64_t Microseconds);
+
+    // Call before pumping input, returns the frame start time
+    uint64_t WaitForNextFrame();
+    // Call once the frame is presented
+    void EndFrame();
+
+    FFramePacingStats GetStats() const;
+    const FFrameTimeStats& GetFrameTimes() const;
+    const FFrameTimeStats& GetWorkTimes() const;
+
+private:
+    FFrameClock* Clock = nullptr;
+    uint64_t TargetInterval = 0;
+    uint64_t SafetyMargin = 500;
+    uint64_t FrameDeadline = 0;
+    // Clock time 0 is a valid deadline, a new target rate drops the old one
+    bool bHasDeadline = false;
+    uint64_t FrameStart = 0;
+    uint64_t LastFrameStart = 0;
+    uint64_t FrameCount = 0;
+    float PredictedWorkTime = 0.0f;
+
+    FFrameTimeStats FrameTimes;
+    FFrameTimeStats WorkTimes;
+};
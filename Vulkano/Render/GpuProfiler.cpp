@@ -0,0 +1,171 @@
+﻿#include "GpuProfiler.h"
+#include "VulkanInterface.h"
+#include "Core/Assertion.h"
+#include "Core/VulkanoLog.h"
+
+FGpuProfiler::FFrameQueries                             FGpuProfiler::Frames[FramesInFlight];
+uint32_t                                                FGpuProfiler::CurrentFrame = 0;
+bool                                                    FGpuProfiler::bFrameActive = false;
+VkCommandBuffer                                         FGpuProfiler::CommandBuffer = VK_NULL_HANDLE;
+std::vector<uint32_t>                                   FGpuProfiler::OpenPasses;
+std::vector<std::chrono::steady_clock::time_point>      FGpuProfiler::OpenPassTimes;
+std::vector<FPassTiming>                                FGpuProfiler::LastFrameTimings;
+uint64_t                                                FGpuProfiler::LastFrameRetireValue = 0;
+double                                                  FGpuProfiler::TimestampPeriod = 0.0;
+uint64_t                                                FGpuProfiler::TimestampMask = 0;
+
+void FGpuProfiler::Init(uint32_t QueueFamilyIndex)
+{
+    VkPhysicalDeviceProperties Properties;
+    vkGetPhysicalDeviceProperties(FVulkan::GetPhysicalDevice(), &Properties);
+
+    uint32_t FamilyNum = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(FVulkan::GetPhysicalDevice(), &FamilyNum, nullptr);
+    std::vector<VkQueueFamilyProperties> Families(FamilyNum);
+    vkGetPhysicalDeviceQueueFamilyProperties(FVulkan::GetPhysicalDevice(), &FamilyNum, Families.data());
+    const uint32_t ValidBits = QueueFamilyIndex < FamilyNum ? Families[QueueFamilyIndex].timestampValidBits : 0;
+
+    // Without timestamps only the CPU recording times are reported
+    TimestampPeriod = ValidBits > 0 ? Properties.limits.timestampPeriod : 0.0;
+    TimestampMask = ValidBits >= 64 ? UINT64_MAX : (1ull << ValidBits) - 1;
+    if (!SupportsGpuTimings())
+    {
+        VK_LOG(LOG_WARNING, "Graphics queue has no timestamps, GPU pass timings are disabled");
+        return;
+    }
+
+    for (FFrameQueries& Frame : Frames)
+    {
+        VkQueryPoolCreateInfo QueryPoolCreateInfo{};
+        QueryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        QueryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        QueryPoolCreateInfo.queryCount = MaxPasses * 2;
+        if (vkCreateQueryPool(FVulkan::GetDevice(), &QueryPoolCreateInfo, nullptr, &Frame.QueryPool) != VK_SUCCESS)
+        {
+            fatal("FGpuProfiler::Init Fail creating timestamp query pool");
+        }
+    }
+}
+
+void FGpuProfiler::Release()
+{
+    for (FFrameQueries& Frame : Frames)
+    {
+        if (Frame.QueryPool != VK_NULL_HANDLE)
+        {
+            vkDestroyQueryPool(FVulkan::GetDevice(), Frame.QueryPool, nullptr);
+        }
+        Frame = FFrameQueries();
+    }
+    LastFrameTimings.clear();
+    bFrameActive = false;
+}
+
+bool FGpuProfiler::SupportsGpuTimings()
+{
+    return TimestampPeriod > 0.0;
+}
+
+void FGpuProfiler::BeginFrame(VkCommandBuffer InCommandBuffer, uint64_t RetireValue, uint64_t CompletedValue)
+{
+    ResolveFrames(CompletedValue);
+    checkf(OpenPasses.empty(), "FGpuProfiler::BeginFrame %zu passes were never ended", OpenPasses.size());
+
+    // A slot still in flight means the GPU is more than FramesInFlight behind, this frame goes unmeasured
+    CurrentFrame = (CurrentFrame + 1) % FramesInFlight;
+    FFrameQueries& Frame = Frames[CurrentFrame];
+    bFrameActive = !Frame.bPending;
+    if (!bFrameActive)
+    {
+        return;
+    }
+
+    CommandBuffer = InCommandBuffer;
+    Frame.RetireValue = RetireValue;
+    Frame.bPending = true;
+    Frame.Passes.clear();
+    if (Frame.QueryPool != VK_NULL_HANDLE)
+    {
+        vkCmdResetQueryPool(CommandBuffer, Frame.QueryPool, 0, MaxPasses * 2);
+    }
+}
+
+void FGpuProfiler::BeginPass(const char* Name)
+{
+    FFrameQueries& Frame = Frames[CurrentFrame];
+    if (!bFrameActive || Frame.Passes.size() >= MaxPasses)
+    {
+        // Keeps Begin and End balanced for passes that are not measured
+        OpenPasses.push_back(UINT32_MAX);
+        OpenPassTimes.push_back(std::chrono::steady_clock::now());
+        return;
+    }
+
+    const uint32_t PassIndex = static_cast<uint32_t>(Frame.Passes.size());
+    Frame.Passes.push_back({Name});
+    if (Frame.QueryPool != VK_NULL_HANDLE)
+    {
+        vkCmdWriteTimestamp(CommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, Frame.QueryPool, PassIndex * 2);
+    }
+    OpenPasses.push_back(PassIndex);
+    OpenPassTimes.push_back(std::chrono::steady_clock::now());
+}
+
+void FGpuProfiler::EndPass()
+{
+    check(!OpenPasses.empty());
+    const uint32_t PassIndex = OpenPasses.back();
+    const std::chrono::steady_clock::time_point BeginTime = OpenPassTimes.back();
+    OpenPasses.pop_back();
+    OpenPassTimes.pop_back();
+    if (PassIndex == UINT32_MAX)
+    {
+        return;
+    }
+
+    FFrameQueries& Frame = Frames[CurrentFrame];
+    if (Frame.QueryPool != VK_NULL_HANDLE)
+    {
+        vkCmdWriteTimestamp(CommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, Frame.QueryPool, PassIndex * 2 + 1);
+    }
+    Frame.Passes[PassIndex].CpuMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - BeginTime).count();
+}
+
+const std::vector<FPassTiming>& FGpuProfiler::GetLastFrameTimings()
+{
+    return LastFrameTimings;
+}
+
+uint64_t FGpuProfiler::GetLastFrameRetireValue()
+{
+    return LastFrameRetireValue;
+}
+
+void FGpuProfiler::ResolveFrames(uint64_t CompletedValue)
+{
+    // Oldest first so the last resolved frame is the newest
+    for (uint32_t Offset = 1; Offset <= FramesInFlight; ++Offset)
+    {
+        FFrameQueries& Frame = Frames[(CurrentFrame + Offset) % FramesInFlight];
+        if (!Frame.bPending || Frame.RetireValue > CompletedValue)
+        {
+            continue;
+        }
+        Frame.bPending = false;
+
+        if (Frame.QueryPool != VK_NULL_HANDLE && !Frame.Passes.empty())
+        {
+            const uint32_t QueryNum = static_cast<uint32_t>(Frame.Passes.size()) * 2;
+            uint64_t Timestamps[MaxPasses * 2] = {};
+            // The submission retired, every query is available and this never blocks
+            vkGetQueryPoolResults(FVulkan::GetDevice(), Frame.QueryPool, 0, QueryNum, sizeof(Timestamps), Timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+            for (uint32_t PassIndex = 0; PassIndex < Frame.Passes.size(); ++PassIndex)
+            {
+                const uint64_t Ticks = (Timestamps[PassIndex * 2 + 1] - Timestamps[PassIndex * 2]) & TimestampMask;
+                Frame.Passes[PassIndex].GpuMilliseconds = Ticks * TimestampPeriod / 1000000.0;
+            }
+        }
+        LastFrameTimings = Frame.Passes;
+        LastFrameRetireValue = Frame.RetireValue;
+    }
+}
@@ -0,0 +1,70 @@
+﻿#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "vulkan/vulkan_core.h"
+
+struct FPassTiming
+{
+    std::string Name;
+    double GpuMilliseconds = 0.0;
+    // Recording time on the render thread
+    double CpuMilliseconds = 0.0;
+};
+
+// Per pass timestamp queries on the graphics command buffer. Results are read without waiting
+// once the frame retires, so they lag the recording frame by the frames in flight.
+class FGpuProfiler
+{
+public:
+    enum
+    {
+        FramesInFlight = 3,
+        MaxPasses = 64
+    };
+
+    static void Init(uint32_t QueueFamilyIndex);
+    static void Release();
+    static bool SupportsGpuTimings();
+
+    // Called when the graphics command buffer starts recording, RetireValue is the value its submission signals
+    static void BeginFrame(VkCommandBuffer CommandBuffer, uint64_t RetireValue, uint64_t CompletedValue);
+    static void BeginPass(const char* Name);
+    static void EndPass();
+
+    // Timings of the most recent frame that retired
+    static const std::vector<FPassTiming>& GetLastFrameTimings();
+    static uint64_t GetLastFrameRetireValue();
+
+private:
+    static void ResolveFrames(uint64_t CompletedValue);
+
+private:
+    struct FFrameQueries
+    {
+        VkQueryPool QueryPool = VK_NULL_HANDLE;
+        uint64_t RetireValue = 0;
+        bool bPending = false;
+        std::vector<FPassTiming> Passes;
+    };
+
+    static FFrameQueries Frames[FramesInFlight];
+    static uint32_t CurrentFrame;
+    static bool bFrameActive;
+    static VkCommandBuffer CommandBuffer;
+    static std::vector<uint32_t> OpenPasses;
+    static std::vector<std::chrono::steady_clock::time_point> OpenPassTimes;
+    static std::vector<FPassTiming> LastFrameTimings;
+    static uint64_t LastFrameRetireValue;
+    static double TimestampPeriod;
+    static uint64_t TimestampMask;
+};
+
+// Times everything recorded in its scope as one pass
+class FGpuProfileScope
+{
+public:
+    explicit FGpuProfileScope(const char* Name) { FGpuProfiler::BeginPass(Name); }
+    ~FGpuProfileScope() { FGpuProfiler::EndPass(); }
+};
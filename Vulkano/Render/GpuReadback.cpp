@@ -0,0 +1,259 @@
+﻿#include "GpuReadback.h"
+#include <algorithm>
+#include "DeletionQueue.h"
+#include "VulkanInterface.h"
+#include "Core/Assertion.h"
+#include "Core/VulkanoLog.h"
+
+std::mutex                                      FGpuReadback::PoolMutex;
+std::vector<FGpuReadback::FReadbackBuffer>      FGpuReadback::Buffers;
+std::vector<std::weak_ptr<FReadbackRequest>>    FGpuReadback::PendingRequests;
+FReadbackStats                                  FGpuReadback::Stats;
+
+// Small readbacks share a size class instead of creating one buffer each
+static constexpr VkDeviceSize MinReadbackBufferSize = 64 * 1024;
+
+FReadbackRequest::~FReadbackRequest()
+{
+    if (BufferIndex != UINT32_MAX)
+    {
+        FGpuReadback::FreeBuffer(BufferIndex, RetireValue);
+    }
+}
+
+bool FReadbackFuture::IsValid() const
+{
+    return Request != nullptr;
+}
+
+bool FReadbackFuture::IsReady() const
+{
+    return Request && Request->bReady.load(std::memory_order_acquire);
+}
+
+bool FReadbackFuture::Wait(uint64_t Timeout) const
+{
+    if (!Request)
+    {
+        return false;
+    }
+    if (IsReady())
+    {
+        return true;
+    }
+    FVulkanQueue& Queue = FVulkan::GetQueue(EQueueType::Graphics);
+    if (!Queue.Wait(Request->RetireValue, Timeout))
+    {
+        return false;
+    }
+    FGpuReadback::ResolveCompleted(Queue.GetCompletedValue());
+    return IsReady();
+}
+
+const void* FReadbackFuture::GetData() const
+{
+    checkf(IsReady(), "FReadbackFuture::GetData readback is not resolved yet");
+    return FGpuReadback::GetMappedData(Request->BufferIndex);
+}
+
+uint64_t FReadbackFuture::GetSize() const
+{
+    return Request ? Request->Size : 0;
+}
+
+uint32_t FReadbackFuture::GetRowPitch() const
+{
+    return Request ? Request->RowPitch : 0;
+}
+
+void FReadbackFuture::Reset()
+{
+    Request.reset();
+}
+
+void FGpuReadback::Release()
+{
+    std::lock_guard<std::mutex> Lock(PoolMutex);
+    for (FReadbackBuffer& Buffer : Buffers)
+    {
+        // Outstanding futures keep their index, their data is gone with the device
+        FDeletionQueue::Enqueue(EDeferredResourceType::Buffer, Buffer.Buffer);
+        FDeletionQueue::Enqueue(EDeferredResourceType::Memory, Buffer.Memory);
+        Buffer = FReadbackBuffer();
+    }
+    PendingRequests.clear();
+    Stats.BufferNum = 0;
+    Stats.PoolBytes = 0;
+}
+
+FReadbackFuture FGpuReadback::Allocate(VkDeviceSize Size, uint32_t RowPitch, VkBuffer& OutBuffer)
+{
+    const uint64_t RetireValue = GetDeferredRetireValue();
+    const uint64_t CompletedValue = FVulkan::GetQueue(EQueueType::Graphics).GetCompletedValue();
+
+    std::lock_guard<std::mutex> Lock(PoolMutex);
+
+    // Smallest retired buffer that fits
+    uint32_t BufferIndex = UINT32_MAX;
+    for (uint32_t Index = 0; Index < Buffers.size(); ++Index)
+    {
+        const FReadbackBuffer& Buffer = Buffers[Index];
+        if (!Buffer.bInUse && Buffer.Buffer != VK_NULL_HANDLE && Buffer.RetireValue <= CompletedValue && Buffer.Size >= Size
+            && (BufferIndex == UINT32_MAX || Buffer.Size < Buffers[BufferIndex].Size))
+        {
+            BufferIndex = Index;
+        }
+    }
+    if (BufferIndex == UINT32_MAX)
+    {
+        VkDeviceSize BufferSize = MinReadbackBufferSize;
+        while (BufferSize < Size)
+        {
+            BufferSize *= 2;
+        }
+        BufferIndex = CreateReadbackBuffer(BufferSize);
+    }
+
+    FReadbackBuffer& Buffer = Buffers[BufferIndex];
+    Buffer.bInUse = true;
+    Buffer.RetireValue = RetireValue;
+    OutBuffer = Buffer.Buffer;
+
+    FReadbackFuture Future;
+    Future.Request = std::make_shared<FReadbackRequest>();
+    Future.Request->BufferIndex = BufferIndex;
+    Future.Request->Size = Size;
+    Future.Request->RowPitch = RowPitch;
+    Future.Request->RetireValue = RetireValue;
+    Future.Request->RequestTime = std::chrono::steady_clock::now();
+    PendingRequests.push_back(Future.Request);
+    Stats.Requests++;
+    return Future;
+}
+
+void FGpuReadback::ResolveCompleted(uint64_t CompletedValue)
+{
+    // Every request locked here stays referenced until the lock is released. A request whose last future
+    // was dropped meanwhile frees its buffer on destruction, which takes PoolMutex again
+    std::vector<std::shared_ptr<FReadbackRequest>> Locked;
+    std::lock_guard<std::mutex> Lock(PoolMutex);
+    Locked.reserve(PendingRequests.size());
+    const std::chrono::steady_clock::time_point Now = std::chrono::steady_clock::now();
+    auto It = std::remove_if(PendingRequests.begin(), PendingRequests.end(), [&](const std::weak_ptr<FReadbackRequest>& Pending)
+    {
+        Locked.push_back(Pending.lock());
+        FReadbackRequest* Request = Locked.back().get();
+        if (!Request)
+        {
+            return true;
+        }
+        if (Request->RetireValue > CompletedValue)
+        {
+            return false;
+        }
+
+        const FReadbackBuffer& Buffer = Buffers[Request->BufferIndex];
+        if (!Buffer.bCoherent)
+        {
+            VkMappedMemoryRange Range{};
+            Range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+            Range.memory = Buffer.Memory;
+            Range.offset = 0;
+            Range.size = VK_WHOLE_SIZE;
+            vkInvalidateMappedMemoryRanges(FVulkan::GetDevice(), 1, &Range);
+        }
+        Request->bReady.store(true, std::memory_order_release);
+        Stats.ResolvedBytes += Request->Size;
+        Stats.ResolveMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(Now - Request->RequestTime).count();
+        return true;
+    });
+    PendingRequests.erase(It, PendingRequests.end());
+}
+
+FReadbackStats FGpuReadback::GetStats()
+{
+    std::lock_guard<std::mutex> Lock(PoolMutex);
+    return Stats;
+}
+
+uint32_t FGpuReadback::CreateReadbackBuffer(VkDeviceSize Size)
+{
+    FReadbackBuffer Buffer;
+    Buffer.Size = Size;
+
+    VkBufferCreateInfo BufferCreateInfo{};
+    BufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    BufferCreateInfo.size = Size;
+    BufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    BufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(FVulkan::GetDevice(), &BufferCreateInfo, nullptr, &Buffer.Buffer) != VK_SUCCESS)
+    {
+        fatal("FGpuReadback::CreateReadbackBuffer Fail creating readback buffer size: %i", static_cast<int>(Size));
+    }
+
+    VkMemoryRequirements MemRequirements;
+    vkGetBufferMemoryRequirements(FVulkan::GetDevice(), Buffer.Buffer, &MemRequirements);
+
+    // Uncached memory reads are very slow on the CPU, take cached and invalidate if it isn't coherent
+    VkPhysicalDeviceMemoryProperties MemProperties;
+    vkGetPhysicalDeviceMemoryProperties(FVulkan::GetPhysicalDevice(), &MemProperties);
+    const VkMemoryPropertyFlags Preferred[] = {
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
+    uint32_t MemoryType = UINT32_MAX;
+    for (VkMemoryPropertyFlags Flags : Preferred)
+    {
+        for (uint32_t i = 0; i < MemProperties.memoryTypeCount && MemoryType == UINT32_MAX; i++)
+        {
+            if ((MemRequirements.memoryTypeBits & (1 << i)) && (MemProperties.memoryTypes[i].propertyFlags & Flags) == Flags)
+            {
+                MemoryType = i;
+            }
+        }
+        if (MemoryType != UINT32_MAX)
+        {
+            break;
+        }
+    }
+    checkf(MemoryType != UINT32_MAX, "FGpuReadback::CreateReadbackBuffer No host visible memory type");
+    Buffer.bCoherent = (MemProperties.memoryTypes[MemoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+    VkMemoryAllocateInfo MemoryAllocateInfo{};
+    MemoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    MemoryAllocateInfo.allocationSize = MemRequirements.size;
+    MemoryAllocateInfo.memoryTypeIndex = MemoryType;
+    if (vkAllocateMemory(FVulkan::GetDevice(), &MemoryAllocateInfo, nullptr, &Buffer.Memory) != VK_SUCCESS)
+    {
+        fatal("FGpuReadback::CreateReadbackBuffer Fail allocating readback memory size: %i", static_cast<int>(Size));
+    }
+    vkBindBufferMemory(FVulkan::GetDevice(), Buffer.Buffer, Buffer.Memory, 0);
+
+    void* Data = nullptr;
+    vkMapMemory(FVulkan::GetDevice(), Buffer.Memory, 0, VK_WHOLE_SIZE, 0, &Data);
+    Buffer.MappedData = static_cast<uint8_t*>(Data);
+
+    Stats.BufferNum++;
+    Stats.PoolBytes += Size;
+    VK_LOG(LOG_INFO, "Readback buffer created, byte size: %i, %s", static_cast<int>(Size), Buffer.bCoherent ? "coherent" : "cached");
+
+    Buffers.push_back(Buffer);
+    return static_cast<uint32_t>(Buffers.size() - 1);
+}
+
+void FGpuReadback::FreeBuffer(uint32_t BufferIndex, uint64_t RetireValue)
+{
+    std::lock_guard<std::mutex> Lock(PoolMutex);
+    if (BufferIndex < Buffers.size())
+    {
+        // Reused once RetireValue completes, a dropped future may still have its copy in flight
+        Buffers[BufferIndex].bInUse = false;
+        Buffers[BufferIndex].RetireValue = RetireValue;
+    }
+}
+
+const uint8_t* FGpuReadback::GetMappedData(uint32_t BufferIndex)
+{
+    std::lock_guard<std::mutex> Lock(PoolMutex);
+    return Buffers[BufferIndex].MappedData;
+}
@@ -0,0 +1,91 @@
+﻿#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "vulkan/vulkan_core.h"
+
+struct FReadbackRequest
+{
+    ~FReadbackRequest();
+
+    uint32_t BufferIndex = UINT32_MAX;
+    uint64_t Size = 0;
+    uint32_t RowPitch = 0;
+    // Graphics timeline value of the submission recording the copy
+    uint64_t RetireValue = 0;
+    std::chrono::steady_clock::time_point RequestTime;
+    std::atomic<bool> bReady{false};
+};
+
+// Handle to data on its way back from the GPU. Resolved by FGpuReadback::ResolveCompleted once the
+// recording submission retires, the data then stays readable until the last handle is dropped.
+class FReadbackFuture
+{
+public:
+    bool IsValid() const;
+    bool IsReady() const;
+    // Blocks on the graphics timeline once the recording frame is submitted, for headless captures and tools only
+    bool Wait(uint64_t Timeout = UINT64_MAX) const;
+    const void* GetData() const;
+    uint64_t GetSize() const;
+    // Bytes between rows of an image readback, rows are tightly packed
+    uint32_t GetRowPitch() const;
+    void Reset();
+
+private:
+    friend class FGpuReadback;
+    std::shared_ptr<FReadbackRequest> Request;
+};
+
+struct FReadbackStats
+{
+    uint64_t Requests = 0;
+    uint64_t ResolvedBytes = 0;
+    // Sum of request to resolve times, ResolvedBytes over it is the readback throughput
+    uint64_t ResolveMicroseconds = 0;
+    uint32_t BufferNum = 0;
+    uint64_t PoolBytes = 0;
+};
+
+// Pool of persistently mapped readback buffers, HOST_CACHED when the device has it so the CPU reads are fast.
+// A buffer goes back to the pool when its future is dropped and the GPU is done writing it.
+class FGpuReadback
+{
+public:
+    static void Release();
+
+    // Buffer to copy Size bytes into, valid for the graphics command buffer being recorded
+    static FReadbackFuture Allocate(VkDeviceSize Size, uint32_t RowPitch, VkBuffer& OutBuffer);
+    // Called once per frame with the graphics completed value, never waits
+    static void ResolveCompleted(uint64_t CompletedValue);
+    static FReadbackStats GetStats();
+
+private:
+    friend struct FReadbackRequest;
+    friend class FReadbackFuture;
+
+    static uint32_t CreateReadbackBuffer(VkDeviceSize Size);
+    static void FreeBuffer(uint32_t BufferIndex, uint64_t RetireValue);
+    static const uint8_t* GetMappedData(uint32_t BufferIndex);
+
+private:
+    struct FReadbackBuffer
+    {
+        VkBuffer Buffer = VK_NULL_HANDLE;
+        VkDeviceMemory Memory = VK_NULL_HANDLE;
+        uint8_t* MappedData = nullptr;
+        VkDeviceSize Size = 0;
+        bool bCoherent = false;
+        bool bInUse = false;
+        // The GPU may still write until this graphics value completes
+        uint64_t RetireValue = 0;
+    };
+
+    static std::mutex PoolMutex;
+    static std::vector<FReadbackBuffer> Buffers;
+    static std::vector<std::weak_ptr<FReadbackRequest>> PendingRequests;
+    static FReadbackStats Stats;
+};
@@ -0,0 +1,27 @@
+﻿#include "HeadlessWindow.h"
+
+FHeadlessWindow::FHeadlessWindow(const std::string& Title, int InWidth, int InHeight)
+    : FRenderWindow(Title, InWidth, InHeight)
+{
+}
+
+bool FHeadlessWindow::Init()
+{
+    return true;
+}
+
+bool FHeadlessWindow::PumpMessages()
+{
+    // Nothing can close it, headless runs end on their own
+    return true;
+}
+
+VkSurfaceKHR FHeadlessWindow::CreateSurface(VkInstance) const
+{
+    return VK_NULL_HANDLE;
+}
+
+EWindowBackend FHeadlessWindow::GetBackend() const
+{
+    return EWindowBackend::Headless;
+}
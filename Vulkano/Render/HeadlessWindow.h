@@ -0,0 +1,15 @@
+﻿#pragma once
+#include "RenderWindow.h"
+
+// Window without an OS window, for render farms and CI machines without a display.
+// The renderer draws into its offscreen targets and skips acquire and present
+class FHeadlessWindow : public FRenderWindow
+{
+public:
+    FHeadlessWindow(const std::string& Title, int InWidth, int InHeight);
+
+    virtual bool Init() override;
+    virtual bool PumpMessages() override;
+    virtual VkSurfaceKHR CreateSurface(VkInstance Instance) const override;
+    virtual EWindowBackend GetBackend() const override;
+};
@@ -0,0 +1,48 @@
+﻿#include "PipelineKeys.h"
+#include <tuple>
+
+FGraphicsPipelineKey FGraphicsPipelineKey::Create(VkShaderModule VertexShader, const std::string& VertexEntryPoint, VkShaderModule PixelShader, const std::string& PixelEntryPoint,
+    VkPrimitiveTopology Topology, const VkPipelineVertexInputStateCreateInfo& VertexInput, const FGraphicsPipelineState& State, const FRenderPass& RenderPass)
+{
+    FGraphicsPipelineKey Key;
+    Key.VertexShader = VertexShader;
+    Key.VertexEntryPoint = VertexEntryPoint;
+    Key.PixelShader = PixelShader;
+    Key.PixelEntryPoint = PixelEntryPoint;
+    Key.Topology = Topology;
+    Key.State = State;
+    Key.RenderPass = RenderPass.RenderPass;
+    Key.ColorFormats = RenderPass.ColorFormats;
+    Key.DepthFormat = RenderPass.DepthFormat;
+
+    // The counts go first so a binding can never read as an attribute
+    Key.VertexLayout.reserve(2 + VertexInput.vertexBindingDescriptionCount * 3 + VertexInput.vertexAttributeDescriptionCount * 4);
+    Key.VertexLayout.push_back(VertexInput.vertexBindingDescriptionCount);
+    Key.VertexLayout.push_back(VertexInput.vertexAttributeDescriptionCount);
+    for (uint32_t Index = 0; Index < VertexInput.vertexBindingDescriptionCount; ++Index)
+    {
+        const VkVertexInputBindingDescription& Binding = VertexInput.pVertexBindingDescriptions[Index];
+        Key.VertexLayout.insert(Key.VertexLayout.end(), {Binding.binding, Binding.stride, static_cast<uint32_t>(Binding.inputRate)});
+    }
+    for (uint32_t Index = 0; Index < VertexInput.vertexAttributeDescriptionCount; ++Index)
+    {
+        const VkVertexInputAttributeDescription& Attribute = VertexInput.pVertexAttributeDescriptions[Index];
+        Key.VertexLayout.insert(Key.VertexLayout.end(), {Attribute.location, Attribute.binding, static_cast<uint32_t>(Attribute.format), Attribute.offset});
+    }
+    return Key;
+}
+
+bool FGraphicsPipelineKey::operator<(const FGraphicsPipelineKey& Other) const
+{
+    return std::tie(VertexShader, VertexEntryPoint, PixelShader, PixelEntryPoint, Topology, VertexLayout,
+            State.PolygonMode, State.CullMode, State.FrontFace, State.bBlendEnable, State.bDepthTest, State.bDepthWrite, State.DepthCompareOp,
+            RenderPass, ColorFormats, DepthFormat) <
+        std::tie(Other.VertexShader, Other.VertexEntryPoint, Other.PixelShader, Other.PixelEntryPoint, Other.Topology, Other.VertexLayout,
+            Other.State.PolygonMode, Other.State.CullMode, Other.State.FrontFace, Other.State.bBlendEnable, Other.State.bDepthTest, Other.State.bDepthWrite, Other.State.DepthCompareOp,
+            Other.RenderPass, Other.ColorFormats, Other.DepthFormat);
+}
+
+bool FGraphicsPipelineKey::operator==(const FGraphicsPipelineKey& Other) const
+{
+    return !(*this < Other) && !(Other < *this);
+}
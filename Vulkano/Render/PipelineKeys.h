@@ -0,0 +1,30 @@
+﻿#pragma once
+#include <string>
+#include <vector>
+#include "RenderResources.h"
+#include "vulkan/vulkan_core.h"
+
+// Everything FVulkan::SetGraphicsPipeline creates a pipeline from. Shaders are keyed by module and entry point,
+// vertex layout and attachment formats by value, so equal state from different objects shares one VkPipeline.
+// Kept apart from the pipeline cache so keys can be tested without a device
+struct FGraphicsPipelineKey
+{
+    VkShaderModule VertexShader = VK_NULL_HANDLE;
+    std::string VertexEntryPoint;
+    VkShaderModule PixelShader = VK_NULL_HANDLE;
+    std::string PixelEntryPoint;
+    VkPrimitiveTopology Topology = VK_PRIMITIVE_TOPOLOGY_MAX_ENUM;
+    // Binding descriptions then attribute descriptions, field by field
+    std::vector<uint32_t> VertexLayout;
+    FGraphicsPipelineState State;
+    // Null with dynamic rendering, the formats alone decide compatibility then
+    VkRenderPass RenderPass = VK_NULL_HANDLE;
+    std::vector<VkFormat> ColorFormats;
+    VkFormat DepthFormat = VK_FORMAT_UNDEFINED;
+
+    static FGraphicsPipelineKey Create(VkShaderModule VertexShader, const std::string& VertexEntryPoint, VkShaderModule PixelShader, const std::string& PixelEntryPoint,
+        VkPrimitiveTopology Topology, const VkPipelineVertexInputStateCreateInfo& VertexInput, const FGraphicsPipelineState& State, const FRenderPass& RenderPass);
+
+    bool operator<(const FGraphicsPipelineKey& Other) const;
+    bool operator==(const FGraphicsPipelineKey& Other) const;
+};
@@ -0,0 +1,224 @@
+﻿#include "RegressionHarness.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <map>
+#include "VulkanInterface.h"
+#include "Core/Json.h"
+#include "Core/Paths.h"
+#include "Core/VulkanoLog.h"
+
+namespace
+{
+    glm::vec3 ReadVector(const FJsonValue& Json, const glm::vec3& Default)
+    {
+        if (Json.GetSize() != 3)
+        {
+            return Default;
+        }
+        return glm::vec3(static_cast<float>(Json[0].GetNumber()), static_cast<float>(Json[1].GetNumber()), static_cast<float>(Json[2].GetNumber()));
+    }
+
+    double Percentile(std::vector<double> Values, double Fraction)
+    {
+        if (Values.empty())
+        {
+            return 0.0;
+        }
+        const size_t Index = std::min(Values.size() - 1, static_cast<size_t>(Fraction * (Values.size() - 1) + 0.5));
+        std::nth_element(Values.begin(), Values.begin() + Index, Values.end());
+        return Values[Index];
+    }
+}
+
+bool FRegressionSettings::LoadScript(const std::string& FilePath, FRegressionSettings& OutSettings)
+{
+    if (!FPaths::FileExists(FilePath))
+    {
+        VK_LOG(LOG_ERROR, "Regression script %s not found", FilePath.c_str());
+        return false;
+    }
+
+    FJsonValue Script;
+    if (!FJsonValue::Parse(FPaths::LoadFileToString(FilePath), Script) || Script.GetType() != EJsonType::Object)
+    {
+        VK_LOG(LOG_ERROR, "Regression script %s is not a JSON object", FilePath.c_str());
+        return false;
+    }
+
+    // Relative paths are relative to the script
+    const std::filesystem::path ScriptDirectory = std::filesystem::path(FilePath).parent_path();
+    auto ReadPath = [&](const char* Key, const char* Default)
+    {
+        const std::string Value = Script.HasField(Key) ? Script.GetField(Key).GetString() : Default;
+        const std::filesystem::path Path(Value);
+        return (Path.is_absolute() ? Path : ScriptDirectory / Path).lexically_normal().string();
+    };
+
+    OutSettings = FRegressionSettings();
+    OutSettings.GoldenDirectory = ReadPath("golden_dir", "Goldens");
+    OutSettings.OutputDirectory = ReadPath("output_dir", "RegressionOutput");
+    OutSettings.HistoryPath = ReadPath("history", "PerfHistory.jsonl");
+    OutSettings.bUpdateGoldens = Script.GetField("update_goldens").GetBool(false);
+
+    FImageCompareThresholds& Image = OutSettings.ImageThresholds;
+    Image.MinPSNR = Script.GetField("min_psnr").GetNumber(Image.MinPSNR);
+    Image.MinSSIM = Script.GetField("min_ssim").GetNumber(Image.MinSSIM);
+    Image.PixelTolerance = static_cast<uint32_t>(Script.GetField("pixel_tolerance").GetNumber(Image.PixelTolerance));
+    Image.MaxDifferentPixelRatio = Script.GetField("max_different_pixels").GetNumber(Image.MaxDifferentPixelRatio);
+
+    FPerfThresholds& Perf = OutSettings.PerfThresholds;
+    Perf.MaxRegression = Script.GetField("max_regression").GetNumber(Perf.MaxRegression);
+    Perf.BaselineRuns = static_cast<uint32_t>(Script.GetField("baseline_runs").GetNumber(Perf.BaselineRuns));
+    Perf.MinPassMilliseconds = Script.GetField("min_pass_ms").GetNumber(Perf.MinPassMilliseconds);
+
+    const FJsonValue& Scenes = Script.GetField("scenes");
+    for (size_t Index = 0; Index < Scenes.GetSize(); ++Index)
+    {
+        const FJsonValue& SceneJson = Scenes[Index];
+        FRegressionScene& Scene = OutSettings.Scenes.emplace_back();
+        Scene.Name = SceneJson.GetField("name").GetString();
+        if (Scene.Name.empty())
+        {
+            Scene.Name = "Scene" + std::to_string(Index);
+        }
+        Scene.WarmupFrames = static_cast<uint32_t>(SceneJson.GetField("warmup").GetNumber(Scene.WarmupFrames));
+        Scene.FrameNum = std::max(1u, static_cast<uint32_t>(SceneJson.GetField("frames").GetNumber(Scene.FrameNum)));
+        Scene.CameraPosition = ReadVector(SceneJson.GetField("camera"), Scene.CameraPosition);
+        Scene.CameraTarget = ReadVector(SceneJson.GetField("target"), Scene.CameraTarget);
+        Scene.FieldOfView = static_cast<float>(SceneJson.GetField("fov").GetNumber(Scene.FieldOfView));
+    }
+
+    if (OutSettings.Scenes.empty())
+    {
+        VK_LOG(LOG_ERROR, "Regression script %s has no scenes", FilePath.c_str());
+        return false;
+    }
+    return true;
+}
+
+FRegressionHarness::FRegressionHarness(const FRegressionSettings& InSettings)
+    : Settings(InSettings)
+{
+    VkPhysicalDeviceProperties Properties;
+    vkGetPhysicalDeviceProperties(FVulkan::GetPhysicalDevice(), &Properties);
+    DeviceName = Properties.deviceName;
+
+    std::filesystem::create_directories(Settings.OutputDirectory);
+    std::filesystem::create_directories(Settings.GoldenDirectory);
+    History.Load(Settings.HistoryPath);
+    VK_LOG(LOG_INFO, "Regression run on [%s], %zu scenes, %zu history records", DeviceName.c_str(), Settings.Scenes.size(), History.GetRecords().size());
+}
+
+bool FRegressionHarness::EvaluateScene(const FRegressionScene& Scene, const FImage& Capture, const std::vector<FRegressionFrameSample>& Samples)
+{
+    // Both always run so a broken image still leaves its timings in the history
+    const bool bImagePassed = CompareImage(Scene, Capture);
+    const bool bTimingsPassed = CheckTimings(Scene, Samples);
+
+    SceneNum++;
+    if (!bImagePassed || !bTimingsPassed)
+    {
+        FailedSceneNum++;
+        return false;
+    }
+    return true;
+}
+
+bool FRegressionHarness::Finish() const
+{
+    if (FailedSceneNum > 0)
+    {
+        VK_LOG(LOG_ERROR, "Regression run failed, %u of %u scenes", FailedSceneNum, SceneNum);
+        return false;
+    }
+    VK_LOG(LOG_INFO, "Regression run passed, %u scenes", SceneNum);
+    return true;
+}
+
+bool FRegressionHarness::CompareImage(const FRegressionScene& Scene, const FImage& Capture)
+{
+    const std::string GoldenPath = (std::filesystem::path(Settings.GoldenDirectory) / (Scene.Name + ".tga")).string();
+    const std::string OutputPath = (std::filesystem::path(Settings.OutputDirectory) / Scene.Name).string();
+
+    if (Settings.bUpdateGoldens)
+    {
+        const bool bSaved = FImageCompare::SaveTga(GoldenPath, Capture);
+        VK_LOG(bSaved ? LOG_INFO : LOG_ERROR, "%s golden %s", bSaved ? "Updated" : "Failed writing", GoldenPath.c_str());
+        return bSaved;
+    }
+
+    FImage Golden;
+    if (!FImageDecoder::Decode(GoldenPath, Golden))
+    {
+        FImageCompare::SaveTga(OutputPath + "_capture.tga", Capture);
+        VK_LOG(LOG_ERROR, "%s: golden %s is missing, run with update_goldens to create it", Scene.Name.c_str(), GoldenPath.c_str());
+        return false;
+    }
+
+    FImage Diff;
+    const FImageCompareResult Result = FImageCompare::Compare(Golden, Capture, Settings.ImageThresholds, &Diff);
+    if (!Result.bSizeMatches)
+    {
+        FImageCompare::SaveTga(OutputPath + "_capture.tga", Capture);
+        VK_LOG(LOG_ERROR, "%s: capture is %ux%u, golden %ux%u", Scene.Name.c_str(), Capture.Width, Capture.Height, Golden.Width, Golden.Height);
+        return false;
+    }
+
+    VK_LOG(Result.bPassed ? LOG_INFO : LOG_ERROR, "%s: PSNR %.2f dB, SSIM %.4f, %llu pixels differ, max difference %u",
+        Scene.Name.c_str(), Result.PSNR, Result.SSIM, static_cast<unsigned long long>(Result.DifferentPixels), Result.MaxDifference);
+    if (!Result.bPassed)
+    {
+        FImageCompare::SaveTga(OutputPath + "_capture.tga", Capture);
+        FImageCompare::SaveTga(OutputPath + "_golden.tga", Golden);
+        FImageCompare::SaveTga(OutputPath + "_diff.tga", Diff);
+    }
+    return Result.bPassed;
+}
+
+bool FRegressionHarness::CheckTimings(const FRegressionScene& Scene, const std::vector<FRegressionFrameSample>& Samples)
+{
+    FPerfRecord Record;
+    Record.Scene = Scene.Name;
+    Record.Timestamp = FPerfHistory::MakeTimestamp();
+    Record.Device = DeviceName;
+    Record.FrameNum = static_cast<uint32_t>(Samples.size());
+
+    std::vector<double> FrameTimes;
+    std::vector<std::string> PassOrder;
+    std::map<std::string, std::vector<double>> GpuTimes;
+    std::map<std::string, std::vector<double>> CpuTimes;
+    for (const FRegressionFrameSample& Sample : Samples)
+    {
+        FrameTimes.push_back(Sample.FrameMilliseconds);
+        for (const FPassTiming& Pass : Sample.Passes)
+        {
+            if (GpuTimes.count(Pass.Name) == 0)
+            {
+                PassOrder.push_back(Pass.Name);
+            }
+            GpuTimes[Pass.Name].push_back(Pass.GpuMilliseconds);
+            CpuTimes[Pass.Name].push_back(Pass.CpuMilliseconds);
+        }
+    }
+
+    Record.FrameMilliseconds = Percentile(FrameTimes, 0.5);
+    Record.FrameP95Milliseconds = Percentile(FrameTimes, 0.95);
+    for (const std::string& Name : PassOrder)
+    {
+        Record.Passes.push_back({Name, Percentile(GpuTimes[Name], 0.5), Percentile(CpuTimes[Name], 0.5)});
+    }
+
+    const FPerfCheckResult Result = History.Check(Record, Settings.PerfThresholds);
+    for (const std::string& Regression : Result.Regressions)
+    {
+        VK_LOG(LOG_ERROR, "Perf regression %s", Regression.c_str());
+    }
+    VK_LOG(LOG_INFO, "%s: frame %.3f ms (p95 %.3f ms)%s", Scene.Name.c_str(), Record.FrameMilliseconds, Record.FrameP95Milliseconds, Result.bHasBaseline ? "" : ", no baseline yet");
+
+    if (!FPerfHistory::Append(Settings.HistoryPath, Record))
+    {
+        VK_LOG(LOG_WARNING, "Failed appending to perf history %s", Settings.HistoryPath.c_str());
+    }
+    return Result.bPassed;
+}
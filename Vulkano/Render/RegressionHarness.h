@@ -0,0 +1,64 @@
+﻿#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "GpuProfiler.h"
+#include "Engine/ImageCompare.h"
+#include "Engine/PerfHistory.h"
+#include "glm/glm.hpp"
+
+// Fixed camera the renderer draws for WarmupFrames + FrameNum frames, the last frame is captured
+struct FRegressionScene
+{
+    std::string Name;
+    uint32_t WarmupFrames = 10;
+    uint32_t FrameNum = 60;
+    glm::vec3 CameraPosition = glm::vec3(0.0f, 0.0f, 2.0f);
+    glm::vec3 CameraTarget = glm::vec3(0.0f);
+    float FieldOfView = 60.0f;
+};
+
+// Loaded from a JSON script, see FRegressionSettings::LoadScript
+struct FRegressionSettings
+{
+    std::string GoldenDirectory;
+    std::string OutputDirectory;
+    std::string HistoryPath;
+    // Captures replace the goldens instead of being compared
+    bool bUpdateGoldens = false;
+    FImageCompareThresholds ImageThresholds;
+    FPerfThresholds PerfThresholds;
+    std::vector<FRegressionScene> Scenes;
+
+    static bool LoadScript(const std::string& FilePath, FRegressionSettings& OutSettings);
+};
+
+// Timings of one measured frame
+struct FRegressionFrameSample
+{
+    double FrameMilliseconds = 0.0;
+    std::vector<FPassTiming> Passes;
+};
+
+// Judges what FRenderer::RunRegression captured: golden image comparison, then timings against the perf history.
+// Capture, golden and diff images of failed scenes are written to the output directory.
+class FRegressionHarness
+{
+public:
+    explicit FRegressionHarness(const FRegressionSettings& InSettings);
+
+    bool EvaluateScene(const FRegressionScene& Scene, const FImage& Capture, const std::vector<FRegressionFrameSample>& Samples);
+    // Logs the summary, true when every scene passed
+    bool Finish() const;
+
+private:
+    bool CompareImage(const FRegressionScene& Scene, const FImage& Capture);
+    bool CheckTimings(const FRegressionScene& Scene, const std::vector<FRegressionFrameSample>& Samples);
+
+private:
+    FRegressionSettings Settings;
+    FPerfHistory History;
+    std::string DeviceName;
+    uint32_t SceneNum = 0;
+    uint32_t FailedSceneNum = 0;
+};
@@ -0,0 +1,49 @@
+﻿#include "RenderPassKey.h"
+#include <tuple>
+#include "RenderResources.h"
+
+bool FRenderPassAttachmentKey::operator<(const FRenderPassAttachmentKey& Other) const
+{
+    return std::tie(Format, Samples, Load, Store, FinalLayout) < std::tie(Other.Format, Other.Samples, Other.Load, Other.Store, Other.FinalLayout);
+}
+
+bool FRenderPassAttachmentKey::operator==(const FRenderPassAttachmentKey& Other) const
+{
+    return !(*this < Other) && !(Other < *this);
+}
+
+FRenderPassKey FRenderPassKey::Create(const FRenderPassInfo& RenderPassInfo)
+{
+    FRenderPassKey Key;
+    for (const FRenderPassInfo::FColorAttachment& ColorTarget : RenderPassInfo.ColorRenderTargets)
+    {
+        if (ColorTarget.Target)
+        {
+            Key.ColorAttachments.push_back({ColorTarget.Target->Format, ColorTarget.Target->Samples, ColorTarget.Load, ColorTarget.Store,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL});
+        }
+    }
+
+    const FRenderPassInfo::FDepthStencilAttachment& DepthTarget = RenderPassInfo.DepthStencilRenderTarget;
+    if (DepthTarget.Target)
+    {
+        Key.DepthAttachment = {DepthTarget.Target->Format, DepthTarget.Target->Samples, DepthTarget.Load, DepthTarget.Store,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+    }
+    return Key;
+}
+
+bool FRenderPassKey::HasDepth() const
+{
+    return DepthAttachment.Format != VK_FORMAT_UNDEFINED;
+}
+
+bool FRenderPassKey::operator<(const FRenderPassKey& Other) const
+{
+    return std::tie(ColorAttachments, DepthAttachment) < std::tie(Other.ColorAttachments, Other.DepthAttachment);
+}
+
+bool FRenderPassKey::operator==(const FRenderPassKey& Other) const
+{
+    return !(*this < Other) && !(Other < *this);
+}
@@ -0,0 +1,34 @@
+﻿#pragma once
+#include <vector>
+#include "vulkan/vulkan_core.h"
+
+struct FRenderPassInfo;
+
+// One attachment description of a VkRenderPass
+struct FRenderPassAttachmentKey
+{
+    VkFormat Format = VK_FORMAT_UNDEFINED;
+    VkSampleCountFlagBits Samples = VK_SAMPLE_COUNT_1_BIT;
+    VkAttachmentLoadOp Load = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    VkAttachmentStoreOp Store = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    VkImageLayout FinalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    bool operator<(const FRenderPassAttachmentKey& Other) const;
+    bool operator==(const FRenderPassAttachmentKey& Other) const;
+};
+
+// Everything FVulkan creates a VkRenderPass from, named passes with equal keys share one.
+// Kept by value so two attachment layouts can never collide like a hash could
+struct FRenderPassKey
+{
+    std::vector<FRenderPassAttachmentKey> ColorAttachments;
+    // Format is VK_FORMAT_UNDEFINED without a depth target
+    FRenderPassAttachmentKey DepthAttachment;
+
+    // Targets end every pass in their read layout, color in shader read and depth in attachment layout
+    static FRenderPassKey Create(const FRenderPassInfo& RenderPassInfo);
+    bool HasDepth() const;
+
+    bool operator<(const FRenderPassKey& Other) const;
+    bool operator==(const FRenderPassKey& Other) const;
+};
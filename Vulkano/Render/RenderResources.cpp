@@ -1,11 +1,52 @@
 ﻿#include "RenderResources.h"
 
+#include <algorithm>
+#include "BindlessHeap.h"
+#include "DeletionQueue.h"
 #include "Shader.h"
 #include "VulkanInterface.h"
 #include "Core/Assertion.h"
 #include "Core/VulkanoLog.h"
 
 
+FTextureDesc FTextureDesc::Create2D(uint32_t Width, uint32_t Height, VkFormat Format, VkImageUsageFlags Usage, const std::string& Name)
+{
+    FTextureDesc Desc;
+    Desc.Width = Width;
+    Desc.Height = Height;
+    Desc.Format = Format;
+    Desc.Usage = Usage;
+    Desc.Name = Name;
+    return Desc;
+}
+
+FTextureDesc FTextureDesc::CreateCube(uint32_t Size, VkFormat Format, VkImageUsageFlags Usage, const std::string& Name)
+{
+    FTextureDesc Desc = Create2D(Size, Size, Format, Usage, Name);
+    Desc.Type = ETextureType::TextureCube;
+    return Desc;
+}
+
+FTextureDesc FTextureDesc::Create3D(uint32_t Width, uint32_t Height, uint32_t Depth, VkFormat Format, VkImageUsageFlags Usage, const std::string& Name)
+{
+    FTextureDesc Desc = Create2D(Width, Height, Format, Usage, Name);
+    Desc.Type = ETextureType::Texture3D;
+    Desc.Depth = Depth;
+    return Desc;
+}
+
+uint32_t FTextureDesc::GetFullMipLevels(uint32_t Width, uint32_t Height, uint32_t Depth)
+{
+    uint32_t Size = std::max(std::max(Width, Height), Depth);
+    uint32_t Levels = 1;
+    while (Size > 1)
+    {
+        Size >>= 1;
+        Levels++;
+    }
+    return Levels;
+}
+
 FVulkanTexture::FVulkanTexture()
 {
 }
@@ -24,26 +65,18 @@ bool FVulkanTexture::IsValid() const
 
 void FVulkanTexture::Release()
 {
-    // Destroy Image View
-    if (ImageView != VK_NULL_HANDLE)
+    // The GPU may still be sampling from this texture, destroy it once the current frame retires
+    if(BindlessIndex != UINT32_MAX)
     {
-        vkDestroyImageView(FVulkan::GetDevice(), ImageView, nullptr);
-        ImageView = VK_NULL_HANDLE;
-    }
-
-    // Destroy Image
-    if (Image != VK_NULL_HANDLE)
-    {
-        vkDestroyImage(FVulkan::GetDevice(), Image, nullptr);
-        Image = VK_NULL_HANDLE;
-    }
-
-    // Free Memory
-    if (ImageMemory != VK_NULL_HANDLE)
-    {
-        vkFreeMemory(FVulkan::GetDevice(), ImageMemory, nullptr);
-        ImageMemory = VK_NULL_HANDLE;
+        FBindlessHeap::Unregister(EBindlessType::SampledImage, BindlessIndex);
+        BindlessIndex = UINT32_MAX;
     }
+    FDeletionQueue::Enqueue(EDeferredResourceType::ImageView, ImageView);
+    FDeletionQueue::Enqueue(EDeferredResourceType::Image, Image);
+    FDeletionQueue::Enqueue(EDeferredResourceType::Memory, ImageMemory);
+    ImageView = VK_NULL_HANDLE;
+    Image = VK_NULL_HANDLE;
+    ImageMemory = VK_NULL_HANDLE;
 }
 
 bool FVulkanBuffer::IsValid() const
@@ -53,15 +86,15 @@ bool FVulkanBuffer::IsValid() const
 
 void FVulkanBuffer::Release()
 {
-    if(BufferMemory)
+    if(BindlessIndex != UINT32_MAX)
     {
-        vkDeviceWaitIdle(FVulkan::GetDevice());
-        vkFreeMemory(FVulkan::GetDevice(), BufferMemory, nullptr);
-        BufferMemory = VK_NULL_HANDLE;
-
-        vkDestroyBuffer(FVulkan::GetDevice(), Buffer, nullptr);
-        Buffer = VK_NULL_HANDLE;
+        FBindlessHeap::Unregister(EBindlessType::StorageBuffer, BindlessIndex);
+        BindlessIndex = UINT32_MAX;
     }
+    FDeletionQueue::Enqueue(EDeferredResourceType::Buffer, Buffer);
+    FDeletionQueue::Enqueue(EDeferredResourceType::Memory, BufferMemory);
+    Buffer = VK_NULL_HANDLE;
+    BufferMemory = VK_NULL_HANDLE;
 }
 
 uint32_t FVulkanBuffer::GetElemNum() const
@@ -89,9 +122,9 @@ void FGraphicsPipeline::Release()
 {
     if(Valid())
     {
-        vkDestroyPipeline(FVulkan::GetDevice(), GraphicsPipeline, nullptr);
+        // The layout is the shared bindless one, owned by FBindlessHeap
+        FDeletionQueue::Enqueue(EDeferredResourceType::Pipeline, GraphicsPipeline);
         GraphicsPipeline = VK_NULL_HANDLE;
-        vkDestroyPipelineLayout(FVulkan::GetDevice(), PipeLineLayout, nullptr);
         PipeLineLayout = VK_NULL_HANDLE;
     }
 }
@@ -101,6 +134,46 @@ const VkPipeline& FGraphicsPipeline::GetGraphicsPipeline() const
     return GraphicsPipeline;
 }
 
+FComputePipeline::FComputePipeline(const VkPipeline& Pipeline, const VkPipelineLayout& Layout, const VkDescriptorSetLayout& SetLayout)
+{
+    ComputePipeline = Pipeline;
+    PipeLineLayout = Layout;
+    DescriptorSetLayout = SetLayout;
+}
+
+bool FComputePipeline::Valid() const
+{
+    return ComputePipeline != VK_NULL_HANDLE;
+}
+
+void FComputePipeline::Release()
+{
+    if(Valid())
+    {
+        FDeletionQueue::Enqueue(EDeferredResourceType::Pipeline, ComputePipeline);
+        ComputePipeline = VK_NULL_HANDLE;
+        FDeletionQueue::Enqueue(EDeferredResourceType::PipelineLayout, PipeLineLayout);
+        PipeLineLayout = VK_NULL_HANDLE;
+        FDeletionQueue::Enqueue(EDeferredResourceType::DescriptorSetLayout, DescriptorSetLayout);
+        DescriptorSetLayout = VK_NULL_HANDLE;
+    }
+}
+
+const VkPipeline& FComputePipeline::GetComputePipeline() const
+{
+    return ComputePipeline;
+}
+
+const VkPipelineLayout& FComputePipeline::GetPipelineLayout() const
+{
+    return PipeLineLayout;
+}
+
+const VkDescriptorSetLayout& FComputePipeline::GetDescriptorSetLayout() const
+{
+    return DescriptorSetLayout;
+}
+
 FRenderPassInfo::FRenderPassInfo(std::vector<std::shared_ptr<FVulkanTexture>> RenderTargets, VkAttachmentLoadOp Load,
                                  VkAttachmentStoreOp Store, std::shared_ptr<FVulkanTexture> DepthStencil, VkAttachmentLoadOp StencilLoad,
                                  VkAttachmentStoreOp StencilStore)
@@ -124,17 +197,3 @@ FRenderPassInfo::FRenderPassInfo(std::vector<std::shared_ptr<FVulkanTexture>> Re
         DepthStencilRenderTarget.Target = DepthStencil;
     }
 }
-
-bool FRenderPass::Valid() const
-{
-    return RenderPass != VK_NULL_HANDLE;
-}
-
-void FRenderPass::Release() const
-{
-    if(Valid())
-    {
-        vkDestroyFramebuffer(FVulkan::GetDevice(), FrameBuffer, nullptr);
-        vkDestroyRenderPass(FVulkan::GetDevice(), RenderPass, nullptr);
-    }
-}
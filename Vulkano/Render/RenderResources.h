@@ -3,6 +3,7 @@
 #include <memory>
 #include <string>
 #include <vector>
+#include "RenderPassKey.h"
 #include "vulkan/vulkan_core.h"
 
 class FVertexInput;
@@ -21,6 +22,41 @@ public:
 };
 
 // Simple texture
+enum class ETextureType : uint8_t
+{
+    Texture2D,
+    Texture2DArray,
+    // Six layers per cube, ArrayLayers counts cubes
+    TextureCube,
+    TextureCubeArray,
+    Texture3D,
+};
+
+struct FTextureDesc
+{
+    ETextureType Type = ETextureType::Texture2D;
+    uint32_t Width = 1;
+    uint32_t Height = 1;
+    // Only for 3D textures
+    uint32_t Depth = 1;
+    // 0 creates the full chain down to 1x1
+    uint32_t MipLevels = 1;
+    uint32_t ArrayLayers = 1;
+    VkFormat Format = VK_FORMAT_UNDEFINED;
+    VkImageUsageFlags Usage = 0;
+    VkSampleCountFlagBits Samples = VK_SAMPLE_COUNT_1_BIT;
+    VkImageTiling Tiling = VK_IMAGE_TILING_OPTIMAL;
+    VkMemoryPropertyFlags MemoryFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    // 0 derives the view aspect from the format, depth-stencil formats view depth
+    VkImageAspectFlags AspectFlags = 0;
+    std::string Name = "Texture";
+
+    static FTextureDesc Create2D(uint32_t Width, uint32_t Height, VkFormat Format, VkImageUsageFlags Usage, const std::string& Name = "Texture");
+    static FTextureDesc CreateCube(uint32_t Size, VkFormat Format, VkImageUsageFlags Usage, const std::string& Name = "Texture");
+    static FTextureDesc Create3D(uint32_t Width, uint32_t Height, uint32_t Depth, VkFormat Format, VkImageUsageFlags Usage, const std::string& Name = "Texture");
+    static uint32_t GetFullMipLevels(uint32_t Width, uint32_t Height, uint32_t Depth = 1);
+};
+
 class FVulkanTexture : public FGPUResource
 {
 public:
@@ -31,11 +67,20 @@ public:
     
     uint32_t SizeX = 0;
     uint32_t SizeY = 0;
+    uint32_t SizeZ = 1;
+    uint32_t MipLevels = 1;
+    // Image layers, six per cube
+    uint32_t ArrayLayers = 1;
+    ETextureType Type = ETextureType::Texture2D;
+    VkSampleCountFlagBits Samples = VK_SAMPLE_COUNT_1_BIT;
+    VkImageAspectFlags AspectFlags = VK_IMAGE_ASPECT_COLOR_BIT;
     VkFormat Format = VK_FORMAT_UNDEFINED;
-    VkImageTiling ImageTilling = VK_IMAGE_TILING_LINEAR;
+    VkImageTiling ImageTilling = VK_IMAGE_TILING_OPTIMAL;
     VkImage Image = VK_NULL_HANDLE;
     VkDeviceMemory ImageMemory = VK_NULL_HANDLE;
     VkImageView ImageView = VK_NULL_HANDLE;
+    VkImageUsageFlags Usage = 0;
+    uint32_t BindlessIndex = UINT32_MAX;
 };
 
 using FVulkanTextureRef = std::shared_ptr<FVulkanTexture>;
@@ -51,6 +96,7 @@ public:
     
     VkBuffer Buffer = VK_NULL_HANDLE;
     VkDeviceMemory BufferMemory = VK_NULL_HANDLE;
+    uint32_t BindlessIndex = UINT32_MAX;
 
 private:
     uint32_t NumberOfElements = 0;
@@ -58,7 +104,8 @@ private:
 
 enum
 {
-    MaxRenderTargets = 8
+    MaxRenderTargets = 8,
+    MaxVertexStreams = 16
 };
 
 struct FRenderPassInfo
@@ -91,15 +138,35 @@ struct FRenderPassInfo
         VkAttachmentStoreOp StencilStore = VK_ATTACHMENT_STORE_OP_DONT_CARE);
 };
 
+// Attachment layout of a named pass, the VkRenderPass is shared between compatible passes and null with dynamic rendering
 class FRenderPass
 {
 public:
-    bool Valid() const;
-    void Release() const;
-    
     std::string RenderPassName;
     VkRenderPass RenderPass = VK_NULL_HANDLE;
-    VkFramebuffer FrameBuffer = VK_NULL_HANDLE;
+    std::vector<VkFormat> ColorFormats;
+    VkFormat DepthFormat = VK_FORMAT_UNDEFINED;
+    FRenderPassKey CompatibilityKey;
+};
+
+// Fixed function state of a graphics pipeline, depth is only read when the render pass has a depth target
+struct FGraphicsPipelineState
+{
+    VkPolygonMode PolygonMode = VK_POLYGON_MODE_FILL;
+    VkCullModeFlags CullMode = VK_CULL_MODE_BACK_BIT;
+    VkFrontFace FrontFace = VK_FRONT_FACE_CLOCKWISE;
+    // Alpha blending over the destination
+    bool bBlendEnable = false;
+    bool bDepthTest = false;
+    bool bDepthWrite = false;
+    VkCompareOp DepthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+    bool operator==(const FGraphicsPipelineState& Other) const
+    {
+        return PolygonMode == Other.PolygonMode && CullMode == Other.CullMode && FrontFace == Other.FrontFace &&
+            bBlendEnable == Other.bBlendEnable && bDepthTest == Other.bDepthTest && bDepthWrite == Other.bDepthWrite &&
+            DepthCompareOp == Other.DepthCompareOp;
+    }
 };
 
 struct FGraphicsPipelineInitializer
@@ -108,6 +175,7 @@ struct FGraphicsPipelineInitializer
     std::shared_ptr<FShader> PixelShader = nullptr;
     VkPrimitiveTopology PrimitiveTopology = VK_PRIMITIVE_TOPOLOGY_MAX_ENUM;
     std::shared_ptr<FVertexInput> VertexInput;
+    FGraphicsPipelineState State;
     FRenderPass* RenderPass = nullptr;
 };
 
@@ -124,3 +192,37 @@ private:
     VkPipeline GraphicsPipeline = VK_NULL_HANDLE;
     VkPipelineLayout PipeLineLayout = VK_NULL_HANDLE;
 };
+
+struct FComputePipelineInitializer
+{
+    std::shared_ptr<FShader> ComputeShader = nullptr;
+    // One descriptor per entry, the binding slot is the index in the array
+    std::vector<VkDescriptorType> Bindings;
+};
+
+class FComputePipeline
+{
+public:
+    FComputePipeline(const VkPipeline& Pipeline, const VkPipelineLayout& Layout, const VkDescriptorSetLayout& SetLayout);
+    bool Valid() const;
+    void Release();
+
+    const VkPipeline& GetComputePipeline() const;
+    const VkPipelineLayout& GetPipelineLayout() const;
+    const VkDescriptorSetLayout& GetDescriptorSetLayout() const;
+
+private:
+    VkPipeline ComputePipeline = VK_NULL_HANDLE;
+    VkPipelineLayout PipeLineLayout = VK_NULL_HANDLE;
+    VkDescriptorSetLayout DescriptorSetLayout = VK_NULL_HANDLE;
+};
+
+// Resources changing queue family, textures keep their layout through the transfer
+struct FQueueOwnershipTransfer
+{
+    std::vector<std::shared_ptr<FVulkanBuffer>> Buffers;
+    std::vector<std::shared_ptr<FVulkanTexture>> Textures;
+    VkImageLayout TextureLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    bool IsEmpty() const { return Buffers.empty() && Textures.empty(); }
+};
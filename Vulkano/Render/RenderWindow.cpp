@@ -1,6 +1,18 @@
 ﻿#include "RenderWindow.h"
-
-FRenderWindow* FRenderWindow::ThisWindow = nullptr;
+#include <cstdlib>
+#include <cstring>
+#include "HeadlessWindow.h"
+#include "Core/VulkanoLog.h"
+
+#ifdef _WIN32
+#include "Win32Window.h"
+#endif
+#ifdef VK_USE_PLATFORM_XCB_KHR
+#include "XcbWindow.h"
+#endif
+#ifdef VK_USE_PLATFORM_WAYLAND_KHR
+#include "WaylandWindow.h"
+#endif
 
 FRenderWindow::FRenderWindow(const std::string& Title, int InWidth, int InHeight)
 {
@@ -9,106 +21,100 @@ FRenderWindow::FRenderWindow(const std::string& Title, int InWidth, int InHeight
     WindowsName = Title;
 }
 
-LRESULT CALLBACK WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)						
-{																									
-	if (FRenderWindow::ThisWindow)																		
-	{																								
-		FRenderWindow::ThisWindow->HandleMessages(hWnd, uMsg, wParam, lParam);									
-	}																						
-	return (DefWindowProc(hWnd, uMsg, wParam, lParam));												
-}	
-
-void FRenderWindow::Init(HINSTANCE hinstance)
+std::unique_ptr<FRenderWindow> FRenderWindow::Create(EWindowBackend Backend, const std::string& Title, int InWidth, int InHeight)
 {
-    WindowInstance = hinstance;
-	WNDCLASSEX wndClass;
-
-	ThisWindow = this;
-
-	HICON hIcon = (HICON)LoadImage(
-		NULL, 
-		L"Resources/Vulkano.ico", 
-		IMAGE_ICON, 
-		GetSystemMetrics(SM_CXSMICON), 
-		GetSystemMetrics(SM_CYSMICON), 
-		LR_LOADFROMFILE | LR_SHARED
-	);
-
-	wndClass.cbSize = sizeof(WNDCLASSEX);
-	wndClass.style = CS_HREDRAW | CS_VREDRAW;
-	wndClass.lpfnWndProc = WndProc;
-	wndClass.cbClsExtra = 0;
-	wndClass.cbWndExtra = 0;
-	wndClass.hInstance = hinstance;
-	wndClass.hIcon = hIcon;
-	wndClass.hCursor = LoadCursor(NULL, IDC_ARROW);
-	wndClass.hbrBackground = (HBRUSH)GetStockObject(BLACK_BRUSH);
-	wndClass.lpszMenuName = NULL;
-	wndClass.lpszClassName = L"Vulkano";
-	wndClass.hIconSm = hIcon;
-
-	if (!RegisterClassEx(&wndClass))
-	{
-		printf("Could not register window class!");
-		fflush(stdout);
-		exit(1);
-	}
-
-	int screenWidth = GetSystemMetrics(SM_CXSCREEN);
-	int screenHeight = GetSystemMetrics(SM_CYSCREEN);
-	
-
-	DWORD dwExStyle = WS_EX_APPWINDOW | WS_EX_WINDOWEDGE;
-	DWORD dwStyle = WS_OVERLAPPEDWINDOW | WS_CLIPSIBLINGS | WS_CLIPCHILDREN;
-	
-	RECT windowRect = {
-		0L,
-		0L,
-		(long)Width,
-		(long)Height
-	};
+    switch (ResolveBackend(Backend))
+    {
+#ifdef _WIN32
+    case EWindowBackend::Win32:
+        return std::make_unique<FWin32Window>(Title, InWidth, InHeight);
+#endif
+#ifdef VK_USE_PLATFORM_XCB_KHR
+    case EWindowBackend::Xcb:
+        return std::make_unique<FXcbWindow>(Title, InWidth, InHeight);
+#endif
+#ifdef VK_USE_PLATFORM_WAYLAND_KHR
+    case EWindowBackend::Wayland:
+        return std::make_unique<FWaylandWindow>(Title, InWidth, InHeight);
+#endif
+    case EWindowBackend::Headless:
+        return std::make_unique<FHeadlessWindow>(Title, InWidth, InHeight);
+    default:
+        VK_LOG(LOG_ERROR, "Window backend %s is not compiled into this build", GetBackendName(Backend));
+        return nullptr;
+    }
+}
 
-	AdjustWindowRectEx(&windowRect, dwStyle, FALSE, dwExStyle);
-	
-	Window = CreateWindowExA(0,
-		WindowsName.c_str(),
-		WindowsName.c_str(),
-		dwStyle | WS_CLIPSIBLINGS | WS_CLIPCHILDREN,
-		0,
-		0,
-		windowRect.right - windowRect.left,
-		windowRect.bottom - windowRect.top,
-		NULL,
-		NULL,
-		hinstance,
-		NULL);
+EWindowBackend FRenderWindow::ResolveBackend(EWindowBackend Backend)
+{
+    if (Backend != EWindowBackend::Default)
+    {
+        return Backend;
+    }
+#if defined(_WIN32)
+    return EWindowBackend::Win32;
+#else
+#ifdef VK_USE_PLATFORM_WAYLAND_KHR
+    if (getenv("WAYLAND_DISPLAY"))
+    {
+        return EWindowBackend::Wayland;
+    }
+#endif
+#ifdef VK_USE_PLATFORM_XCB_KHR
+    if (getenv("DISPLAY"))
+    {
+        return EWindowBackend::Xcb;
+    }
+#endif
+    return EWindowBackend::Headless;
+#endif
+}
 
-	if (!Window)
-	{
-		printf("Could not create window!");
-		fflush(stdout);
-		exit(1);
-	}
+bool FRenderWindow::ParseBackend(const std::string& Name, EWindowBackend& OutBackend)
+{
+    const EWindowBackend Backends[] = {EWindowBackend::Default, EWindowBackend::Win32, EWindowBackend::Xcb, EWindowBackend::Wayland, EWindowBackend::Headless};
+    for (EWindowBackend Backend : Backends)
+    {
+        if (Name == GetBackendName(Backend))
+        {
+            OutBackend = Backend;
+            return true;
+        }
+    }
+    return false;
+}
 
-	// Center on screen
-	uint32_t x = (GetSystemMetrics(SM_CXSCREEN) - windowRect.right) / 2;
-	uint32_t y = (GetSystemMetrics(SM_CYSCREEN) - windowRect.bottom) / 2;
-	SetWindowPos(Window, 0, x, y, 0, 0, SWP_NOZORDER | SWP_NOSIZE);
+const char* FRenderWindow::GetBackendName(EWindowBackend Backend)
+{
+    switch (Backend)
+    {
+    case EWindowBackend::Default:   return "default";
+    case EWindowBackend::Win32:     return "win32";
+    case EWindowBackend::Xcb:       return "xcb";
+    case EWindowBackend::Wayland:   return "wayland";
+    case EWindowBackend::Headless:  return "headless";
+    }
+    return "unknown";
+}
 
-	ShowWindow(Window, SW_SHOW);
-	SetForegroundWindow(Window);
-	SetFocus(Window);
+std::vector<const char*> FRenderWindow::GetInstanceExtensions(EWindowBackend Backend)
+{
+    switch (ResolveBackend(Backend))
+    {
+    case EWindowBackend::Win32:
+        return {VK_KHR_SURFACE_EXTENSION_NAME, "VK_KHR_win32_surface"};
+    case EWindowBackend::Xcb:
+        return {VK_KHR_SURFACE_EXTENSION_NAME, "VK_KHR_xcb_surface"};
+    case EWindowBackend::Wayland:
+        return {VK_KHR_SURFACE_EXTENSION_NAME, "VK_KHR_wayland_surface"};
+    default:
+        return {};
+    }
 }
 
-void FRenderWindow::HandleMessages(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
+bool FRenderWindow::IsMinimized() const
 {
-	switch (uMsg)
-	{
-	case WM_CLOSE:
-		DestroyWindow(hwnd);
-		PostQuitMessage(0);
-		break; 
-	}
+    return bMinimized;
 }
 
 void FRenderWindow::Shutdown()
@@ -117,25 +123,31 @@ void FRenderWindow::Shutdown()
 
 std::string FRenderWindow::GetWindowName() const
 {
-	return WindowsName;
+    return WindowsName;
 }
 
-HINSTANCE FRenderWindow::GetHInstance() const
+int FRenderWindow::GetWidth() const
 {
-	return WindowInstance;
+    return Width;
 }
 
-HWND FRenderWindow::GetWindow() const
+int FRenderWindow::GetHeight() const
 {
-	return Window;
+    return Height;
 }
 
-int FRenderWindow::GetWidth() const
+bool FRenderWindow::ConsumeResize()
 {
-	return Width;
+    return bResized.exchange(false);
 }
 
-int FRenderWindow::GetHeight() const
+void FRenderWindow::OnResize(int NewWidth, int NewHeight)
 {
-	return Height;
+    if (NewWidth == Width && NewHeight == Height)
+    {
+        return;
+    }
+    Width = NewWidth;
+    Height = NewHeight;
+    bResized = true;
 }
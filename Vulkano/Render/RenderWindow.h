@@ -1,29 +1,61 @@
 ﻿#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <string>
-#include <Windows.h>
+#include <vector>
+#include "vulkan/vulkan_core.h"
 
+enum class EWindowBackend : uint8_t
+{
+    // Native backend of the platform, Wayland falls back to XCB when no compositor is running
+    Default,
+    Win32,
+    Xcb,
+    Wayland,
+    // No surface and no presentation, frames are only rendered to offscreen targets
+    Headless,
+};
+
+// OS window the renderer presents to, one implementation per windowing system
 class FRenderWindow
 {
 public:
-    FRenderWindow(const std::string& Title, int InWidth, int InHeight);
-    void Init(HINSTANCE hinstance);
-    void HandleMessages(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
-    void Shutdown();
+    virtual ~FRenderWindow(){}
+
+    // Backends not compiled into this build return nullptr
+    static std::unique_ptr<FRenderWindow> Create(EWindowBackend Backend, const std::string& Title, int InWidth, int InHeight);
+    static EWindowBackend ResolveBackend(EWindowBackend Backend);
+    static bool ParseBackend(const std::string& Name, EWindowBackend& OutBackend);
+    static const char* GetBackendName(EWindowBackend Backend);
+    // Surface extensions the instance has to be created with
+    static std::vector<const char*> GetInstanceExtensions(EWindowBackend Backend);
+
+    virtual bool Init() = 0;
+    // Handles the pending OS events without blocking, false once the window was closed
+    virtual bool PumpMessages() = 0;
+    virtual bool IsMinimized() const;
+    // VK_NULL_HANDLE for headless windows
+    virtual VkSurfaceKHR CreateSurface(VkInstance Instance) const = 0;
+    virtual EWindowBackend GetBackend() const = 0;
+    virtual void Shutdown();
 
-public:
-    static FRenderWindow* ThisWindow;
     std::string GetWindowName() const;
-    HINSTANCE GetHInstance() const;
-    HWND GetWindow() const;
     int GetWidth() const;
     int GetHeight() const;
+    // True once after the client area changed size
+    bool ConsumeResize();
 
-private:
-    std::string WindowsName;
-    int Width;
-    int Height;
-    bool bInit;
+protected:
+    FRenderWindow(const std::string& Title, int InWidth, int InHeight);
+    // Called from the message pump
+    void OnResize(int NewWidth, int NewHeight);
 
-    HINSTANCE WindowInstance;
-    HWND Window;
+protected:
+    std::string WindowsName;
+    // Written by the message pump, read by the render thread
+    std::atomic<int> Width;
+    std::atomic<int> Height;
+    std::atomic<bool> bResized{false};
+    std::atomic<bool> bMinimized{false};
 };
@@ -1,27 +1,78 @@
 ﻿#include "Renderer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <set>
 #include <sstream>
 
+#include "AsyncUpload.h"
+#include "DeletionQueue.h"
+#include "GpuProfiler.h"
+#include "RegressionHarness.h"
 #include "Shader.h"
 #include "VertexInputs.h"
 #include "VulkanInterface.h"
 #include "Core/Assertion.h"
+#include "Core/JobSystem.h"
+#include "Engine/FrustumCulling.h"
+#include "Engine/OcclusionCulling.h"
 #include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+// Bounded so an occluded window never hangs the loop, in nanoseconds
+static constexpr uint64_t PresentWaitTimeout = 100000000;
+// The update thread has no GPU to wait on, this keeps it from spinning a core
+static constexpr float UpdateFrameRate = 240.0f;
+// Regression runs step the simulation at a fixed rate so captures don't depend on the machine speed
+static constexpr float RegressionDeltaSeconds = 1.0f / 60.0f;
+// Cube grid behind the wall occluder, the outer columns stay visible around it
+static constexpr uint32_t SceneGridX = 8;
+static constexpr uint32_t SceneGridY = 5;
+
+// Unit cube centered on the origin, 6 faces of 2 triangles with a 0-1 UV per face
+static std::vector<FStaticMeshVertex> MakeCubeVertices()
+{
+	static const glm::vec3 Normals[6] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+	static const glm::vec2 Corners[6] = {{0, 0}, {1, 0}, {1, 1}, {0, 0}, {1, 1}, {0, 1}};
+
+	std::vector<FStaticMeshVertex> Vertices;
+	Vertices.reserve(36);
+	for (const glm::vec3& Normal : Normals)
+	{
+		const glm::vec3 Tangent = Normal.x != 0.0f ? glm::vec3(0, 0, Normal.x) : glm::vec3(Normal.y + Normal.z, 0, 0);
+		const glm::vec3 Bitangent = glm::cross(Normal, Tangent);
+		for (const glm::vec2& Corner : Corners)
+		{
+			FStaticMeshVertex& Vertex = Vertices.emplace_back();
+			Vertex.Position = 0.5f * Normal + (Corner.x - 0.5f) * Tangent + (Corner.y - 0.5f) * Bitangent;
+			Vertex.Normal = Normal;
+			Vertex.UV0 = Corner;
+			Vertex.Color = glm::vec3(1.0f);
+		}
+	}
+	return Vertices;
+}
 
 void FVulkanGBuffer::CreateGBuffer(VkExtent2D ViewSize)
 {
-	GBufferA = FVulkan::CreateTexture(
+	GBufferA = FVulkan::CreateTexture(FTextureDesc::Create2D(
 		ViewSize.width,
 		ViewSize.height,
 		VK_FORMAT_R8G8B8A8_SRGB,
 		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		"GBufferA");
+		"GBufferA"));
+	SceneDepth = FVulkan::CreateTexture(FTextureDesc::Create2D(
+		ViewSize.width,
+		ViewSize.height,
+		VK_FORMAT_D32_SFLOAT,
+		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+		"SceneDepth"));
 }
 
 void FVulkanGBuffer::ReleaseGBuffer()
 {
 	FVulkan::ReleaseTexture(GBufferA);
+	FVulkan::ReleaseTexture(SceneDepth);
 }
 
 FRenderer::FRenderer()
@@ -32,96 +83,353 @@ void FRenderer::Init(FRenderWindow* RenderWindow)
 {
     pRenderWindow = RenderWindow;
 	CreateSwapChain();
-	GBuffer.CreateGBuffer(ViewportSize);
+	UpdatePacer.SetTargetFrameRate(UpdateFrameRate);
+	OcclusionCuller.Init();
+	CreateSceneContent();
 	bInitialized = true;
 }
 
+void FRenderer::CreateSceneContent()
+{
+	const std::vector<FStaticMeshVertex> CubeVertices = MakeCubeVertices();
+	const VkDeviceSize ByteSize = sizeof(FStaticMeshVertex) * CubeVertices.size();
+	std::shared_ptr<FVulkanBuffer> CubeBuffer = FVulkan::CreateBuffer(
+		ByteSize,
+		static_cast<uint32_t>(CubeVertices.size()),
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		"SceneCubeBuffer");
+	const uint8_t* VertexBytes = reinterpret_cast<const uint8_t*>(CubeVertices.data());
+	FAsyncUpload::UploadBuffer(CubeBuffer, std::vector<uint8_t>(VertexBytes, VertexBytes + ByteSize));
+	FAsyncUpload::Flush();
+	const uint32_t CubeMesh = static_cast<uint32_t>(SceneMeshes.size());
+	SceneMeshes.push_back(CubeBuffer);
+
+	// The occluder only needs the 8 corners, the rasterizer does no winding cull
+	std::vector<glm::vec3> CubeCorners;
+	for (uint32_t Corner = 0; Corner < 8; ++Corner)
+	{
+		CubeCorners.emplace_back((Corner & 1) ? 0.5f : -0.5f, (Corner & 2) ? 0.5f : -0.5f, (Corner & 4) ? 0.5f : -0.5f);
+	}
+	const std::vector<uint32_t> CubeIndices = {
+		0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4,
+		2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5};
+	const uint32_t CubeOccluderMesh = OcclusionCuller.RegisterOccluderMesh(CubeCorners, CubeIndices);
+
+	const FBoundingBox CubeBounds = {glm::vec3(-0.5f), glm::vec3(0.5f)};
+	auto AddEntity = [&](const glm::vec3& Position, const glm::vec3& Scale)
+	{
+		const FEntityId Entity = Scene.CreateEntity(InvalidEntity, CubeBounds);
+		Scene.SetLocalTransform(Entity, Position, glm::quat(1.0f, 0.0f, 0.0f, 0.0f), Scale);
+		if (Entity >= EntityMeshes.size())
+		{
+			EntityMeshes.resize(Entity + 1, 0);
+		}
+		EntityMeshes[Entity] = CubeMesh;
+		return Entity;
+	};
+
+	const FEntityId Wall = AddEntity(glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(1.6f, 0.9f, 0.1f));
+	Occluders.push_back({Wall, CubeOccluderMesh});
+	for (uint32_t Y = 0; Y < SceneGridY; ++Y)
+	{
+		for (uint32_t X = 0; X < SceneGridX; ++X)
+		{
+			const glm::vec3 Position((X - (SceneGridX - 1) * 0.5f) * 0.6f, (Y - (SceneGridY - 1) * 0.5f) * 0.6f, -3.0f);
+			AddEntity(Position, glm::vec3(0.3f));
+		}
+	}
+}
+
+void FRenderer::ReleaseSceneContent()
+{
+	for (std::shared_ptr<FVulkanBuffer>& Mesh : SceneMeshes)
+	{
+		Mesh->Release();
+	}
+	SceneMeshes.clear();
+}
+
 void FRenderer::RenderLoop()
 {
-	MSG msg;
-	bool quitMessageReceived = false;
-	while (!quitMessageReceived)
+	// From here on Vulkan is only touched by the render thread, this thread pumps messages and updates the scene
+	bRenderThreadRunning = true;
+	RenderThread = std::thread(&FRenderer::RenderThreadLoop, this);
+
+	uint64_t LastUpdateTime = FrameClock.GetMicroseconds();
+	while (true)
 	{
-		while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
+		UpdatePacer.WaitForNextFrame();
+
+		if (!pRenderWindow->PumpMessages())
 		{
-			if (msg.message == WM_QUIT)
+			break;
+		}
+
+		const uint64_t UpdateTime = FrameClock.GetMicroseconds();
+		UpdateScene(SnapshotMailbox.GetWriteBuffer(), static_cast<float>(UpdateTime - LastUpdateTime) / 1000000.0f);
+		SnapshotMailbox.Publish();
+		LastUpdateTime = UpdateTime;
+		UpdatePacer.EndFrame();
+	}
+
+	bRenderThreadRunning = false;
+	RenderThread.join();
+}
+
+bool FRenderer::RunRegression(const FRegressionSettings& Settings)
+{
+	check(bInitialized && !bRenderThreadRunning);
+	FRegressionHarness Harness(Settings);
+
+	for (const FRegressionScene& SceneSettings : Settings.Scenes)
+	{
+		RegressionScene = &SceneSettings;
+		const uint32_t TotalFrameNum = SceneSettings.WarmupFrames + SceneSettings.FrameNum;
+		std::vector<FRegressionFrameSample> Samples;
+		uint64_t LastTimingsValue = FGpuProfiler::GetLastFrameRetireValue();
+		uint64_t LastFrameTime = FrameClock.GetMicroseconds();
+
+		for (uint32_t FrameNumber = 0; FrameNumber < TotalFrameNum; ++FrameNumber)
+		{
+			if (!pRenderWindow->PumpMessages())
+			{
+				RegressionScene = nullptr;
+				return false;
+			}
+
+			// Same waits as the render thread but no frame pacing, the measured frame time is the GPU bound one
+			FVulkan::WaitForPresent(SwapChain, LastPresentId, PresentWaitTimeout);
+			FVulkan::GetQueue(EQueueType::Graphics).Wait(LastFrameValue);
+
+			const uint64_t FrameTime = FrameClock.GetMicroseconds();
+			if (FrameNumber > SceneSettings.WarmupFrames)
 			{
-				quitMessageReceived = true;
-				break;
+				FRegressionFrameSample& Sample = Samples.emplace_back();
+				Sample.FrameMilliseconds = static_cast<double>(FrameTime - LastFrameTime) / 1000.0;
+				// Pass timings resolve a few frames late, each resolved frame is taken once
+				if (FGpuProfiler::GetLastFrameRetireValue() != LastTimingsValue)
+				{
+					LastTimingsValue = FGpuProfiler::GetLastFrameRetireValue();
+					Sample.Passes = FGpuProfiler::GetLastFrameTimings();
+				}
 			}
-			TranslateMessage(&msg);
-			DispatchMessage(&msg);
+			LastFrameTime = FrameTime;
+
+			UpdateScene(SnapshotMailbox.GetWriteBuffer(), RegressionDeltaSeconds);
+			SnapshotMailbox.Publish();
+			SnapshotMailbox.Acquire();
+			bCaptureNextFrame = FrameNumber + 1 == TotalFrameNum;
+			RenderFrame(SnapshotMailbox.GetReadBuffer());
 		}
-		
-		if (bInitialized && !IsIconic(pRenderWindow->GetWindow()))
+		bCaptureNextFrame = false;
+
+		FImage Capture;
+		if (CaptureReadback.IsValid() && CaptureReadback.Wait())
 		{
-			// Acquire the next image from the swapchain
-			uint32_t imageIndex;
-			vkAcquireNextImageKHR(FVulkan::GetDevice(), SwapChain, UINT64_MAX,  ImageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
-			vkWaitForFences(FVulkan::GetDevice(), 1, &Fence, VK_FALSE, UINT64_MAX);
-			vkResetFences(FVulkan::GetDevice(), 1, &Fence);  
-			
-			FVulkan::ResetGraphicsCommandBuffer();
-			
-			FRenderPassInfo RenderPassInfo({GBuffer.GBufferA});
-			FRenderPass* RenderPass = FVulkan::BeginRenderPass(RenderPassInfo, ViewportSize, "Render Quad");
+			// GBufferA is RGBA8, the readback rows are top to bottom like FImage
+			const uint8_t* Data = static_cast<const uint8_t*>(CaptureReadback.GetData());
+			Capture.Width = GBuffer.GBufferA->SizeX;
+			Capture.Height = GBuffer.GBufferA->SizeY;
+			Capture.Pixels.resize(static_cast<size_t>(Capture.Width) * Capture.Height * 4);
+			for (uint32_t Row = 0; Row < Capture.Height; ++Row)
 			{
-				std::shared_ptr<FDefaultVertexShader> VertexShader = FShaderCompiler::Get()->FindShader<FDefaultVertexShader>();
-				std::shared_ptr<FDefaultPixelShader> PixelShader = FShaderCompiler::Get()->FindShader<FDefaultPixelShader>();
-				
-				FGraphicsPipelineInitializer GraphicsPSOInit;
-				GraphicsPSOInit.VertexShader = VertexShader;
-				GraphicsPSOInit.PixelShader = PixelShader;
-				GraphicsPSOInit.PrimitiveTopology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
-				GraphicsPSOInit.VertexInput = VKGlobals::GSimpleVertexInput;
-				GraphicsPSOInit.RenderPass = RenderPass;
-				FVulkan::SetGraphicsPipeline(GraphicsPSOInit);
-
-				FVulkan::SetScissorRect(false, 0, 0, 0, 0);
-				FVulkan::SetViewport(0.0f, 0.0f, 0.0f, static_cast<float>(ViewportSize.width), static_cast<float>(ViewportSize.height), 1.0f);
-
-				FVulkan::BindStreamResource(0, VKGlobals::GQuadVertexBuffer, 0);
-				FVulkan::DrawPrimitive(0, VKGlobals::GQuadVertexBuffer->GetElemNum(), 1);
+				memcpy(&Capture.Pixels[static_cast<size_t>(Row) * Capture.Width * 4], Data + static_cast<size_t>(Row) * CaptureReadback.GetRowPitch(), Capture.Width * 4);
 			}
-			FVulkan::EndRenderPass();
-
-			// Copy to swap chain
-			FVulkan::TransitionBarrier(GBuffer.GBufferA, SwapChainTextures[imageIndex]);
-			FVulkan::CopyTexture(GBuffer.GBufferA, SwapChainTextures[imageIndex]);
-
-			/*FVulkan::EndGraphicsCommandBuffer();
-			
-			PresetImage();*/
-			vkEndCommandBuffer(FVulkan::GetGraphicsBuffer());
-
-			VkSubmitInfo submitInfo{};
-			submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-			
-			VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-			submitInfo.waitSemaphoreCount = 1;
-			submitInfo.pWaitSemaphores = &ImageAvailableSemaphore;
-			submitInfo.pWaitDstStageMask = waitStages;
-
-			submitInfo.commandBufferCount = 1;
-			submitInfo.pCommandBuffers = &FVulkan::GetGraphicsBuffer();
-			
-			submitInfo.signalSemaphoreCount = 1;
-			submitInfo.pSignalSemaphores = &RenderFinishedSemaphore;
-
-			vkQueueSubmit(FVulkan::GetGraphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE);
-
-			// Present the image
-			VkPresentInfoKHR presentInfo{};
-			presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-			presentInfo.waitSemaphoreCount = 1;
-			presentInfo.pWaitSemaphores = &RenderFinishedSemaphore;
-			
-			presentInfo.swapchainCount = 1;
-			presentInfo.pSwapchains = &SwapChain;
-			presentInfo.pImageIndices = &imageIndex;
-
-			vkQueuePresentKHR(FVulkan::GetPresentQueue(), &presentInfo);
 		}
+		else
+		{
+			VK_LOG(LOG_ERROR, "%s: the last frame was skipped, nothing was captured", SceneSettings.Name.c_str());
+		}
+		CaptureReadback.Reset();
+
+		Harness.EvaluateScene(SceneSettings, Capture, Samples);
+	}
+
+	RegressionScene = nullptr;
+	return Harness.Finish();
+}
+
+void FRenderer::RenderThreadLoop()
+{
+	while (bRenderThreadRunning)
+	{
+		if (!bInitialized || pRenderWindow->IsMinimized())
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+
+		// Every wait happens before the snapshot is picked so the frame starts from the freshest update.
+		// The previous frame owns the swap chain semaphores until it executes
+		FVulkan::WaitForPresent(SwapChain, LastPresentId, PresentWaitTimeout);
+		FVulkan::GetQueue(EQueueType::Graphics).Wait(LastFrameValue);
+		FramePacer.WaitForNextFrame();
+
+		// Never waits on the update thread, without a new snapshot the previous one is drawn again
+		SnapshotMailbox.Acquire();
+		RenderFrame(SnapshotMailbox.GetReadBuffer());
+	}
+}
+
+void FRenderer::UpdateScene(FRenderSnapshot& Snapshot, float DeltaSeconds)
+{
+	// The write slot holds a snapshot from two updates ago, every field gets rewritten
+	SimulationTime += DeltaSeconds;
+	UpdateFrame++;
+
+	const float Width = static_cast<float>(std::max(pRenderWindow->GetWidth(), 1));
+	const float Height = static_cast<float>(std::max(pRenderWindow->GetHeight(), 1));
+	Snapshot.UpdateFrame = UpdateFrame;
+	Snapshot.SimulationTime = SimulationTime;
+	Snapshot.DeltaSeconds = DeltaSeconds;
+	const glm::vec3 CameraPosition = RegressionScene ? RegressionScene->CameraPosition : glm::vec3(0.0f, 0.0f, 2.0f);
+	const glm::vec3 CameraTarget = RegressionScene ? RegressionScene->CameraTarget : glm::vec3(0.0f);
+	const float FieldOfView = RegressionScene ? RegressionScene->FieldOfView : 60.0f;
+	Snapshot.ViewMatrix = glm::lookAt(CameraPosition, CameraTarget, glm::vec3(0.0f, 1.0f, 0.0f));
+	Snapshot.ProjectionMatrix = glm::perspective(glm::radians(FieldOfView), Width / Height, 0.1f, 1000.0f);
+
+	Scene.UpdateWorldTransforms();
+	const glm::mat4 ViewProjection = Snapshot.ProjectionMatrix * Snapshot.ViewMatrix;
+	const FFrustum Frustum = FFrustum::FromViewProjection(ViewProjection);
+	FFrustumCulling::Cull(Frustum, Scene.GetWorldBounds(), ECullingVolume::Box, VisibleIndices);
+
+	// Culling runs before anything is recorded, the snapshot only carries the survivors
+	OcclusionCuller.BeginFrame(ViewProjection);
+	for (const FOccluderEntity& Occluder : Occluders)
+	{
+		OcclusionCuller.AddOccluder(Occluder.MeshId, Scene.GetWorldMatrix(Occluder.Entity));
+	}
+	if (OcclusionCuller.HasOccluders())
+	{
+		OcclusionCuller.Rasterize();
+		OcclusionCuller.FilterVisible(Scene.GetWorldBounds(), VisibleIndices);
+	}
+
+	const std::vector<glm::mat4>& WorldMatrices = Scene.GetWorldMatrices();
+	Snapshot.MeshDraws.clear();
+	for (uint32_t Index : VisibleIndices)
+	{
+		Snapshot.MeshDraws.push_back({EntityMeshes[Scene.GetEntity(Index)], WorldMatrices[Index]});
+	}
+}
+
+void FRenderer::RenderFrame(const FRenderSnapshot& Snapshot)
+{
+	FVulkan::ReleaseRetiredResources();
+
+	if (pRenderWindow->ConsumeResize() || bSwapChainDirty)
+	{
+		RecreateSwapChain();
+		if (bSwapChainDirty)
+		{
+			return;
+		}
+	}
+
+	// Acquire the next image from the swapchain, an out of date one is rebuilt next frame
+	const bool bPresent = SurfaceKHR != VK_NULL_HANDLE;
+	VkResult AcquireResult = VK_SUCCESS;
+	if (bPresent)
+	{
+		AcquireResult = vkAcquireNextImageKHR(FVulkan::GetDevice(), SwapChain, UINT64_MAX,  ImageAvailableSemaphore, VK_NULL_HANDLE, &FrameIndex);
+		if (AcquireResult == VK_ERROR_OUT_OF_DATE_KHR)
+		{
+			bSwapChainDirty = true;
+			return;
+		}
+	}
+	
+	FVulkan::ResetGraphicsCommandBuffer();
+	
+	FRenderPassInfo RenderPassInfo({GBuffer.GBufferA}, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE,
+		GBuffer.SceneDepth, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_DONT_CARE);
+	FRenderPass* RenderPass = FVulkan::BeginRenderPass(RenderPassInfo, ViewportSize, "BasePass");
+	{
+		FGpuProfileScope ProfileScope("BasePass");
+		std::shared_ptr<FDefaultPixelShader> PixelShader = FShaderCompiler::Get()->FindShader<FDefaultPixelShader>();
+		
+		FGraphicsPipelineInitializer GraphicsPSOInit;
+		GraphicsPSOInit.VertexShader = FShaderCompiler::Get()->FindShader<FDefaultVertexShader>();
+		GraphicsPSOInit.PixelShader = PixelShader;
+		GraphicsPSOInit.PrimitiveTopology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+		GraphicsPSOInit.VertexInput = VKGlobals::GSimpleVertexInput;
+		GraphicsPSOInit.RenderPass = RenderPass;
+
+		// The quad is a full screen background with no depth, scene meshes are depth tested over it.
+		// Cube winding is not tied to the front face setting, so no face culling
+		FGraphicsPipelineInitializer MeshPSOInit = GraphicsPSOInit;
+		MeshPSOInit.VertexShader = FShaderCompiler::Get()->FindShader<FInstancedStaticVertexShader>();
+		MeshPSOInit.PrimitiveTopology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		MeshPSOInit.VertexInput = VKGlobals::GInstancedStaticMeshVertexInput;
+		MeshPSOInit.State.CullMode = VK_CULL_MODE_NONE;
+		MeshPSOInit.State.bDepthTest = true;
+		MeshPSOInit.State.bDepthWrite = true;
+
+		FVulkan::SetScissorRect(false, 0, 0, 0, 0);
+		FVulkan::SetViewport(0.0f, 0.0f, 0.0f, static_cast<float>(ViewportSize.width), static_cast<float>(ViewportSize.height), 1.0f);
+
+		const glm::mat4 ViewProjection = Snapshot.ProjectionMatrix * Snapshot.ViewMatrix;
+		FVulkan::SetPushConstants(&ViewProjection, sizeof(ViewProjection));
+
+		DrawList.Reset();
+		FDrawCommand QuadDraw;
+		QuadDraw.PipelineId = DrawList.AddPipeline(GraphicsPSOInit);
+		QuadDraw.VertexBufferId = DrawList.AddVertexBuffer(VKGlobals::GQuadVertexBuffer);
+		QuadDraw.VertexCount = VKGlobals::GQuadVertexBuffer->GetElemNum();
+		DrawList.AddDraw(QuadDraw);
+
+		// Only what survived culling on the update thread is recorded
+		FDrawCommand MeshDraw;
+		MeshDraw.PipelineId = DrawList.AddPipeline(MeshPSOInit);
+		for (const FSceneMeshDraw& Draw : Snapshot.MeshDraws)
+		{
+			const std::shared_ptr<FVulkanBuffer>& Mesh = SceneMeshes[Draw.MeshId];
+			MeshDraw.VertexBufferId = DrawList.AddVertexBuffer(Mesh);
+			MeshDraw.VertexCount = Mesh->GetElemNum();
+			FInstanceData Instance;
+			Instance.WorldMatrix = Draw.WorldMatrix;
+			DrawList.AddInstancedDraw(MeshDraw, Instance);
+		}
+		DrawList.Sort();
+		DrawList.Submit();
+	}
+	FVulkan::EndRenderPass();
+
+	if (bCaptureNextFrame)
+	{
+		CaptureReadback = FVulkan::ReadbackTexture(GBuffer.GBufferA, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		bCaptureNextFrame = false;
+	}
+
+	if (!bPresent)
+	{
+		LastFrameValue = FVulkan::EndGraphicsCommandBuffer();
+		FVulkan::AdvanceFrame();
+		FramePacer.EndFrame();
+		return;
+	}
+
+	// Copy to swap chain
+	{
+		FGpuProfileScope ProfileScope("CopyToSwapChain");
+		FVulkan::TransitionBarrier(GBuffer.GBufferA, SwapChainTextures[FrameIndex]);
+		FVulkan::CopyTexture(GBuffer.GBufferA, SwapChainTextures[FrameIndex]);
+	}
+
+	FSubmitSemaphores Semaphores;
+	Semaphores.Wait = {ImageAvailableSemaphore};
+	Semaphores.WaitStages = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT};
+	Semaphores.Signal = {RenderFinishedSemaphore};
+	LastFrameValue = FVulkan::EndGraphicsCommandBuffer(Semaphores);
+	FVulkan::AdvanceFrame();
+
+	VkResult PresentResult = PresetImage(LastPresentId + 1);
+	LastPresentId++;
+	FramePacer.EndFrame();
+	if (AcquireResult == VK_SUBOPTIMAL_KHR || PresentResult == VK_SUBOPTIMAL_KHR || PresentResult == VK_ERROR_OUT_OF_DATE_KHR)
+	{
+		bSwapChainDirty = true;
 	}
 }
 
@@ -133,6 +441,12 @@ void FRenderer::Shutdown()
 	}
 	bInitialized = false;
 
+	// Make sure the GPU is done with the last frames before tearing down the swap chain,
+	// retired swap chains have to go before the surface
+	vkDeviceWaitIdle(FVulkan::GetDevice());
+	FDeletionQueue::Flush();
+	FJobSystem::Get()->Shutdown();
+
 	// This is released manually since the SwapChain owns the VkImages and the Memories
 	for(std::shared_ptr<FVulkanTexture>& Texture : SwapChainTextures)
 	{
@@ -165,92 +479,212 @@ void FRenderer::Shutdown()
 		vkDestroySemaphore(FVulkan::GetDevice(), RenderFinishedSemaphore, nullptr);
 	}
 
-	if(Fence != VK_NULL_HANDLE)
-	{
-		vkDestroyFence(FVulkan::GetDevice(), Fence, nullptr);
-	}
-
 	GBuffer.ReleaseGBuffer();
+	ReleaseSceneContent();
 }
 
 void FRenderer::CreateSwapChain()
 {
 	// Create swap chain
-	SurfaceKHR = FVulkan::CreateSurface(pRenderWindow->GetHInstance(), pRenderWindow->GetWindow());
-	if(SurfaceKHR != VK_NULL_HANDLE)
+	SurfaceKHR = pRenderWindow->CreateSurface(FVulkan::GetInstance());
+	if(SurfaceKHR == VK_NULL_HANDLE)
 	{
-		VK_LOG(LOG_INFO, "Creating Surface Win64");
+		VK_LOG(LOG_INFO, "No surface for %s window, rendering headless", FRenderWindow::GetBackendName(pRenderWindow->GetBackend()));
+		RecreateSwapChain();
+		return;
+	}
+	VK_LOG(LOG_INFO, "Creating Surface %s", FRenderWindow::GetBackendName(pRenderWindow->GetBackend()));
+
+	SurfaceFormat = ChooseSurfaceFormat();
+	PresentMode = ChoosePresentMode();
+	RecreateSwapChain();
+
+	// Create phores
+	VkSemaphoreCreateInfo SemaphoreCreateInfo = {};
+	SemaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	vkCreateSemaphore(FVulkan::GetDevice(), &SemaphoreCreateInfo, nullptr, &ImageAvailableSemaphore);
+	VkSemaphoreCreateInfo SemaphoreCreateInfo2 = {};
+	SemaphoreCreateInfo2.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	vkCreateSemaphore(FVulkan::GetDevice(), &SemaphoreCreateInfo2, nullptr, &RenderFinishedSemaphore);
+}
+
+void FRenderer::RecreateSwapChain()
+{
+	if(SurfaceKHR == VK_NULL_HANDLE)
+	{
+		ResizeViewport({static_cast<uint32_t>(std::max(pRenderWindow->GetWidth(), 1)), static_cast<uint32_t>(std::max(pRenderWindow->GetHeight(), 1))});
+		bSwapChainDirty = false;
+		return;
 	}
 
 	VkSurfaceCapabilitiesKHR SurfaceCapabilitiesKHR;
-    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(FVulkan::GetPhysicalDevice(), SurfaceKHR, &SurfaceCapabilitiesKHR);
-   
-    std::vector<VkSurfaceFormatKHR> surfaceFormats;
-    uint32_t surfaceFormatsCount;
-    vkGetPhysicalDeviceSurfaceFormatsKHR(FVulkan::GetPhysicalDevice(), SurfaceKHR, &surfaceFormatsCount, nullptr);
-    surfaceFormats.resize(surfaceFormatsCount);
-    vkGetPhysicalDeviceSurfaceFormatsKHR(FVulkan::GetPhysicalDevice(), SurfaceKHR, &surfaceFormatsCount, surfaceFormats.data());
+	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(FVulkan::GetPhysicalDevice(), SurfaceKHR, &SurfaceCapabilitiesKHR);
 
-    if(surfaceFormats[0].format != VK_FORMAT_B8G8R8A8_UNORM)
+	VkExtent2D NewSize = SurfaceCapabilitiesKHR.currentExtent;
+	if(NewSize.width == UINT32_MAX)
 	{
-        fatal("Failed creating swap chain, unsupported surface format");
+		NewSize.width = glm::clamp(static_cast<uint32_t>(pRenderWindow->GetWidth()), SurfaceCapabilitiesKHR.minImageExtent.width, SurfaceCapabilitiesKHR.maxImageExtent.width);
+		NewSize.height = glm::clamp(static_cast<uint32_t>(pRenderWindow->GetHeight()), SurfaceCapabilitiesKHR.minImageExtent.height, SurfaceCapabilitiesKHR.maxImageExtent.height);
 	}
-	
-    VkSurfaceFormatKHR SurfaceFormatKHR = surfaceFormats[0];
-    int width = pRenderWindow->GetWidth();
-    int height = pRenderWindow->GetHeight();
-    width = glm::clamp(width, static_cast<int>(SurfaceCapabilitiesKHR.minImageExtent.width), static_cast<int>(SurfaceCapabilitiesKHR.maxImageExtent.width));
-    height = glm::clamp(height, static_cast<int>(SurfaceCapabilitiesKHR.minImageExtent.height), static_cast<int>(SurfaceCapabilitiesKHR.maxImageExtent.height));
-    ViewportSize.width = width;
-    ViewportSize.height = height;
-
-    VkSwapchainCreateInfoKHR createInfo = {};
-    createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-    createInfo.surface = SurfaceKHR;
-    createInfo.minImageCount = SurfaceCapabilitiesKHR.minImageCount;
-    createInfo.imageFormat = SurfaceFormatKHR.format;
-    createInfo.imageColorSpace = SurfaceFormatKHR.colorSpace;
-    createInfo.imageExtent = ViewportSize;
-    createInfo.imageArrayLayers = 1;
-    createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+
+	// Nothing to present into, keep the old swap chain until the window gets a size again
+	if(NewSize.width == 0 || NewSize.height == 0)
+	{
+		bSwapChainDirty = true;
+		return;
+	}
+
+	if(!(SurfaceCapabilitiesKHR.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT))
+	{
+		fatal("FRenderer::RecreateSwapChain Surface does not support transfer destination images");
+	}
+
+	// One image more than the minimum so MAILBOX always has a free image to render to
+	uint32_t ImageCount = SurfaceCapabilitiesKHR.minImageCount + 1;
+	if(SurfaceCapabilitiesKHR.maxImageCount > 0)
+	{
+		ImageCount = std::min(ImageCount, SurfaceCapabilitiesKHR.maxImageCount);
+	}
+
+	VkSwapchainCreateInfoKHR createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+	createInfo.surface = SurfaceKHR;
+	createInfo.minImageCount = ImageCount;
+	createInfo.imageFormat = SurfaceFormat.format;
+	createInfo.imageColorSpace = SurfaceFormat.colorSpace;
+	createInfo.imageExtent = NewSize;
+	createInfo.imageArrayLayers = 1;
+	createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 	createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    createInfo.preTransform = SurfaceCapabilitiesKHR.currentTransform;
-    createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-    createInfo.presentMode = VK_PRESENT_MODE_FIFO_KHR;
-    createInfo.clipped = VK_TRUE;
+	createInfo.preTransform = SurfaceCapabilitiesKHR.currentTransform;
+	createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+	createInfo.presentMode = PresentMode;
+	createInfo.clipped = VK_TRUE;
+	createInfo.oldSwapchain = SwapChain;
+
+	VkSwapchainKHR NewSwapChain = VK_NULL_HANDLE;
+	if(vkCreateSwapchainKHR(FVulkan::GetDevice(), &createInfo, nullptr, &NewSwapChain) != VK_SUCCESS)
+	{
+		fatal("FRenderer::RecreateSwapChain Fail creating swap chain");
+	}
 
-    if(vkCreateSwapchainKHR(FVulkan::GetDevice(), &createInfo, nullptr, &SwapChain) != VK_SUCCESS)
-    {
-	    fatal("FVulkanSwapChain::CreateSwapChain Fail creating swap chain");
-    }
+	// The old swap chain may still be presenting, it goes away with the frame that follows
+	ReleaseSwapChainTextures();
+	FDeletionQueue::Enqueue(EDeferredResourceType::SwapChain, SwapChain);
+	SwapChain = NewSwapChain;
+	LastPresentId = 0;
 
 	uint32_t SwapChainImageCount = 0;
 	std::vector<VkImage> SwapChainImages;
-    vkGetSwapchainImagesKHR(FVulkan::GetDevice(), SwapChain, &SwapChainImageCount, nullptr);
-    SwapChainImages.resize(SwapChainImageCount);
-    vkGetSwapchainImagesKHR(FVulkan::GetDevice(), SwapChain, &SwapChainImageCount, SwapChainImages.data());
+	vkGetSwapchainImagesKHR(FVulkan::GetDevice(), SwapChain, &SwapChainImageCount, nullptr);
+	SwapChainImages.resize(SwapChainImageCount);
+	vkGetSwapchainImagesKHR(FVulkan::GetDevice(), SwapChain, &SwapChainImageCount, SwapChainImages.data());
 
-    for(uint32_t i = 0; i < SwapChainImages.size(); i++)
-    {
-        VkImageView NewView = FVulkan::CreateImageView(SwapChainImages[i], SurfaceFormatKHR.format, VK_IMAGE_ASPECT_COLOR_BIT);
-    	SwapChainTextures.push_back(std::make_shared<FVulkanTexture>(SwapChainImages[i], NewView, "SwapChainTexture"));
-    }
+	for(uint32_t i = 0; i < SwapChainImages.size(); i++)
+	{
+		VkImageView NewView = FVulkan::CreateImageView(SwapChainImages[i], SurfaceFormat.format, VK_IMAGE_ASPECT_COLOR_BIT);
+		std::shared_ptr<FVulkanTexture> Texture = std::make_shared<FVulkanTexture>(SwapChainImages[i], NewView, "SwapChainTexture");
+		Texture->SizeX = NewSize.width;
+		Texture->SizeY = NewSize.height;
+		Texture->Format = SurfaceFormat.format;
+		Texture->Usage = createInfo.imageUsage;
+		SwapChainTextures.push_back(Texture);
+	}
 
-	// Create phores
-	VkSemaphoreCreateInfo SemaphoreCreateInfo = {};
-	SemaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-	vkCreateSemaphore(FVulkan::GetDevice(), &SemaphoreCreateInfo, nullptr, &ImageAvailableSemaphore);
-	VkSemaphoreCreateInfo SemaphoreCreateInfo2 = {};
-	SemaphoreCreateInfo2.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-	vkCreateSemaphore(FVulkan::GetDevice(), &SemaphoreCreateInfo2, nullptr, &RenderFinishedSemaphore);
+	ResizeViewport(NewSize);
+
+	bSwapChainDirty = false;
+	VK_LOG(LOG_INFO, "Swap chain created %ix%i, images: %i, present mode: %i", ViewportSize.width, ViewportSize.height, SwapChainImageCount, static_cast<int>(PresentMode));
+}
+
+void FRenderer::ResizeViewport(VkExtent2D NewSize)
+{
+	// Targets that follow the view size
+	if(NewSize.width != ViewportSize.width || NewSize.height != ViewportSize.height)
+	{
+		ViewportSize = NewSize;
+		GBuffer.ReleaseGBuffer();
+		GBuffer.CreateGBuffer(ViewportSize);
+		FVulkan::ReleaseFrameBuffers();
+	}
+}
 
-	VkFenceCreateInfo FenceCreateInfo = {};
-	FenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	FenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-	if(vkCreateFence(FVulkan::GetDevice(), &FenceCreateInfo, nullptr, &Fence) != VK_SUCCESS)
+void FRenderer::ReleaseSwapChainTextures()
+{
+	// The SwapChain owns the VkImages and the Memories, only the views are ours
+	for(std::shared_ptr<FVulkanTexture>& Texture : SwapChainTextures)
 	{
-		fatal("FVulkanSwapChain::CreateFences Fail creating fences");
+		FDeletionQueue::Enqueue(EDeferredResourceType::ImageView, Texture->ImageView);
+		Texture->ImageView = VK_NULL_HANDLE;
 	}
+	SwapChainTextures.clear();
+}
+
+VkSurfaceFormatKHR FRenderer::ChooseSurfaceFormat() const
+{
+	std::vector<VkSurfaceFormatKHR> surfaceFormats;
+	uint32_t surfaceFormatsCount;
+	vkGetPhysicalDeviceSurfaceFormatsKHR(FVulkan::GetPhysicalDevice(), SurfaceKHR, &surfaceFormatsCount, nullptr);
+	surfaceFormats.resize(surfaceFormatsCount);
+	vkGetPhysicalDeviceSurfaceFormatsKHR(FVulkan::GetPhysicalDevice(), SurfaceKHR, &surfaceFormatsCount, surfaceFormats.data());
+
+	// The surface takes anything
+	if(surfaceFormatsCount == 1 && surfaceFormats[0].format == VK_FORMAT_UNDEFINED)
+	{
+		return {VK_FORMAT_B8G8R8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR};
+	}
+
+	// The GBuffer is copied into the swap chain, only 32 bit formats can be copy targets
+	const VkFormat PreferredFormats[] = {
+		VK_FORMAT_B8G8R8A8_UNORM,
+		VK_FORMAT_R8G8B8A8_UNORM,
+		VK_FORMAT_B8G8R8A8_SRGB,
+		VK_FORMAT_R8G8B8A8_SRGB,
+		VK_FORMAT_A2B10G10R10_UNORM_PACK32,
+	};
+	for(VkFormat Preferred : PreferredFormats)
+	{
+		for(const VkSurfaceFormatKHR& Format : surfaceFormats)
+		{
+			if(Format.format == Preferred && Format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR)
+			{
+				return Format;
+			}
+		}
+	}
+
+	fatal("FRenderer::ChooseSurfaceFormat No supported surface format, formats available: %i", surfaceFormatsCount);
+	return surfaceFormats[0];
+}
+
+VkPresentModeKHR FRenderer::ChoosePresentMode() const
+{
+	// FIFO is always there
+	if(bVSync)
+	{
+		return VK_PRESENT_MODE_FIFO_KHR;
+	}
+
+	std::vector<VkPresentModeKHR> PresentModes;
+	uint32_t PresentModesCount;
+	vkGetPhysicalDeviceSurfacePresentModesKHR(FVulkan::GetPhysicalDevice(), SurfaceKHR, &PresentModesCount, nullptr);
+	PresentModes.resize(PresentModesCount);
+	vkGetPhysicalDeviceSurfacePresentModesKHR(FVulkan::GetPhysicalDevice(), SurfaceKHR, &PresentModesCount, PresentModes.data());
+
+	const VkPresentModeKHR PreferredModes[] = {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR};
+	for(VkPresentModeKHR Preferred : PreferredModes)
+	{
+		if(std::find(PresentModes.begin(), PresentModes.end(), Preferred) != PresentModes.end())
+		{
+			return Preferred;
+		}
+	}
+	return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+FFramePacer& FRenderer::GetFramePacer()
+{
+	return FramePacer;
 }
 
 std::shared_ptr<FVulkanTexture> FRenderer::GetSwapChainTexture()
@@ -268,14 +702,20 @@ std::shared_ptr<FVulkanTexture> FRenderer::GetSwapChainTexture()
 	vkResetFences(FVulkan::GetDevice(), 1, &Fences[FrameIndex]);  */
 }
 
-void FRenderer::PresetImage() const
+VkResult FRenderer::PresetImage(uint64_t PresentId) const
 {
+	VkPresentIdKHR PresentIdInfo{};
+	PresentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+	PresentIdInfo.swapchainCount = 1;
+	PresentIdInfo.pPresentIds = &PresentId;
+
 	VkPresentInfoKHR presentInfo{};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+	presentInfo.pNext = FVulkan::SupportsPresentWait() ? &PresentIdInfo : nullptr;
 	presentInfo.waitSemaphoreCount = 1;
 	presentInfo.pWaitSemaphores = &RenderFinishedSemaphore;
 	presentInfo.swapchainCount = 1;
 	presentInfo.pSwapchains = &SwapChain;
 	presentInfo.pImageIndices = &FrameIndex;
-	vkQueuePresentKHR(FVulkan::GetPresentQueue(), &presentInfo);
+	return vkQueuePresentKHR(FVulkan::GetPresentQueue(), &presentInfo);
 }
@@ -1,10 +1,22 @@
 ﻿#pragma once
+#include <atomic>
+#include <thread>
 #include <vector>
 
+#include "DrawList.h"
+#include "FramePacer.h"
+#include "GpuReadback.h"
+#include "Core/TripleBuffer.h"
+#include "Engine/OcclusionCulling.h"
+#include "Engine/Scene.h"
+#include "glm/glm.hpp"
 #include "RenderWindow.h"
 #include "VulkanSwapChain.h"
 #include "vulkan/vulkan_core.h"
 
+struct FRegressionScene;
+struct FRegressionSettings;
+
 class FVulkanGBuffer
 {
 public:
@@ -15,8 +27,29 @@ public:
     FVulkanTextureRef GBufferB;
     FVulkanTextureRef GBufferC;
     FVulkanTextureRef GBufferD;
+    FVulkanTextureRef SceneDepth;
+};
+
+// Scene entity that survived culling, drawn as one instance of its mesh
+struct FSceneMeshDraw
+{
+    uint32_t MeshId = 0;
+    glm::mat4 WorldMatrix = glm::mat4(1.0f);
 };
 
+// Everything the render thread needs for one frame, only the update thread writes it
+struct FRenderSnapshot
+{
+    uint64_t UpdateFrame = 0;
+    double SimulationTime = 0.0;
+    float DeltaSeconds = 0.0f;
+    glm::mat4 ViewMatrix = glm::mat4(1.0f);
+    glm::mat4 ProjectionMatrix = glm::mat4(1.0f);
+    // Entities inside the view frustum and not hidden by occluders, the only scene meshes RenderFrame records
+    std::vector<FSceneMeshDraw> MeshDraws;
+};
+
+// The calling thread pumps messages and updates the scene, a render thread draws the latest snapshot
 class FRenderer
 {
 public:
@@ -24,24 +57,83 @@ public:
     void Init(FRenderWindow* RenderWindow);
     void RenderLoop();
     void Shutdown();
+    FFramePacer& GetFramePacer();
+    // Draws every scene of the script on the calling thread instead of RenderLoop, true when all captures and timings pass
+    bool RunRegression(const FRegressionSettings& Settings);
 
 private:
+    void RenderThreadLoop();
+    // Wall and cube grid the renderer draws, the wall is also the occluder. Vertex buffers are uploaded before the first frame
+    void CreateSceneContent();
+    void ReleaseSceneContent();
+    void UpdateScene(FRenderSnapshot& Snapshot, float DeltaSeconds);
+    void RenderFrame(const FRenderSnapshot& Snapshot);
     void CreateSwapChain();
+    // Builds a new swap chain from the current window size, the old one is retired once its last frame completes.
+    // Headless windows have no swap chain, only the view targets follow the window size
+    void RecreateSwapChain();
+    void ResizeViewport(VkExtent2D NewSize);
+    void ReleaseSwapChainTextures();
+    VkSurfaceFormatKHR ChooseSurfaceFormat() const;
+    VkPresentModeKHR ChoosePresentMode() const;
     std::shared_ptr<FVulkanTexture> GetSwapChainTexture();
-    void PresetImage() const; 
+    VkResult PresetImage(uint64_t PresentId) const; 
     
 private:
     bool bInitialized = false;
+    // Prefer MAILBOX/IMMEDIATE over FIFO, lowest latency but tears with IMMEDIATE
+    bool bVSync = false;
+    bool bSwapChainDirty = false;
     FRenderWindow* pRenderWindow = nullptr;
 
     VkSwapchainKHR SwapChain = VK_NULL_HANDLE;
     uint32_t FrameIndex = 0;
     VkSemaphore ImageAvailableSemaphore = VK_NULL_HANDLE;
     VkSemaphore RenderFinishedSemaphore = VK_NULL_HANDLE;
-    VkFence Fence;
+    // Graphics timeline value signaled by the last frame submission
+    uint64_t LastFrameValue = 0;
+    // VK_KHR_present_id of the last present on the current swap chain, 0 when none
+    uint64_t LastPresentId = 0;
+    // VK_NULL_HANDLE for headless windows, frames are rendered but never presented
     VkSurfaceKHR SurfaceKHR = VK_NULL_HANDLE;
+    VkSurfaceFormatKHR SurfaceFormat = {VK_FORMAT_UNDEFINED, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR};
+    VkPresentModeKHR PresentMode = VK_PRESENT_MODE_FIFO_KHR;
     VkExtent2D ViewportSize = {0, 0};
 
     std::vector<std::shared_ptr<FVulkanTexture>> SwapChainTextures;
     FVulkanGBuffer GBuffer;
+    FDrawList DrawList;
+    // Static mesh vertex buffers indexed by mesh id, read by the render thread only after Init
+    std::vector<std::shared_ptr<FVulkanBuffer>> SceneMeshes;
+
+    FSystemFrameClock FrameClock;
+    FFramePacer FramePacer{&FrameClock};
+
+    // Update thread state
+    FFramePacer UpdatePacer{&FrameClock};
+    FScene Scene;
+    // Mesh id of every entity, indexed by entity id
+    std::vector<uint32_t> EntityMeshes;
+    // Culling output in scene storage indices, rebuilt every update
+    std::vector<uint32_t> VisibleIndices;
+    // Scene entities rasterized as occluders, mesh ids come from the occlusion culler
+    struct FOccluderEntity
+    {
+        FEntityId Entity;
+        uint32_t MeshId;
+    };
+    std::vector<FOccluderEntity> Occluders;
+    FOcclusionCuller OcclusionCuller;
+    double SimulationTime = 0.0;
+    uint64_t UpdateFrame = 0;
+
+    std::thread RenderThread;
+    std::atomic<bool> bRenderThreadRunning{false};
+    TTripleBuffer<FRenderSnapshot> SnapshotMailbox;
+
+    // Regression runs only, the scene camera replaces the default one
+    const FRegressionScene* RegressionScene = nullptr;
+    // The next RenderFrame reads back GBufferA before the swap chain copy
+    bool bCaptureNextFrame = false;
+    FReadbackFuture CaptureReadback;
 };
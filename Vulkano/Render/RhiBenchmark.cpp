@@ -0,0 +1,1155 @@
+﻿#include "RhiBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <random>
+#include <thread>
+#include "AsyncUpload.h"
+#include "DrawList.h"
+#include "Shader.h"
+#include "UniformStreamAllocator.h"
+#include "VertexInputs.h"
+#include "VulkanInterface.h"
+#include "Core/Assertion.h"
+#include "Core/Json.h"
+#include "Core/Platform.h"
+#include "Core/VulkanoLog.h"
+#include "Engine/Bvh.h"
+#include "Engine/FrustumCulling.h"
+#include "Engine/OcclusionCulling.h"
+#include "Engine/PerfHistory.h"
+#include "Engine/Scene.h"
+#include "Engine/TextureCompression.h"
+#include "glm/gtc/matrix_transform.hpp"
+
+namespace
+{
+    constexpr uint32_t TargetSize = 256;
+    // Recorded commands per submission, keeps the command buffer size bounded for long runs
+    constexpr uint64_t RecordBatchSize = 4096;
+    constexpr uint64_t MaxIterations = 1000000000;
+
+    struct FBenchmarkResources
+    {
+        std::shared_ptr<FVulkanTexture> TargetA;
+        std::shared_ptr<FVulkanTexture> TargetB;
+        std::shared_ptr<FVulkanBuffer> VertexBuffers[2];
+        std::shared_ptr<FVulkanBuffer> UploadBuffer;
+        std::shared_ptr<FVulkanBuffer> UploadTarget;
+        FGraphicsPipelineInitializer PSOInit;
+    };
+    FBenchmarkResources Resources;
+
+    uint64_t GetRealNanoseconds()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    FRenderPassInfo MakeBenchmarkPassInfo()
+    {
+        return FRenderPassInfo({Resources.TargetA}, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE);
+    }
+
+    void LogReadbackThroughput(const char* CaseName, const FReadbackStats& StartStats)
+    {
+        // Request to resolve, what a caller polling IsReady once per frame sees
+        const FReadbackStats Stats = FGpuReadback::GetStats();
+        const uint64_t Bytes = Stats.ResolvedBytes - StartStats.ResolvedBytes;
+        const uint64_t Microseconds = Stats.ResolveMicroseconds - StartStats.ResolveMicroseconds;
+        VK_LOG(LOG_INFO, "%s resolved %llu requests, %.1f MB/s request to resolve, pool %u buffers %.1f MB", CaseName,
+            static_cast<unsigned long long>(Stats.Requests - StartStats.Requests), Microseconds > 0 ? static_cast<double>(Bytes) / static_cast<double>(Microseconds) : 0.0,
+            Stats.BufferNum, static_cast<double>(Stats.PoolBytes) / (1024.0 * 1024.0));
+    }
+
+    void RunUpdateBuffer(FBenchmarkState& State, size_t Size)
+    {
+        std::vector<uint8_t> Data(Size, 0x5a);
+        while (State.KeepRunning())
+        {
+            FVulkan::UpdateBuffer(Resources.UploadBuffer, Data.data(), Size);
+        }
+        State.SetBytesProcessed(State.GetIterations() * Size);
+    }
+
+    // Random boxes around a camera looking down -Z, about a third of them visible
+    void RunFrustumCull(FBenchmarkState& State, ECullingPath Path)
+    {
+        const ECullingPath PreviousPath = FFrustumCulling::GetPath();
+        FFrustumCulling::SetPath(Path);
+        if (FFrustumCulling::GetPath() != Path)
+        {
+            // Not supported by this CPU, reported as skipped
+            FFrustumCulling::SetPath(PreviousPath);
+            return;
+        }
+
+        constexpr uint32_t BoundsNum = 100000;
+        std::mt19937 Random(1);
+        std::uniform_real_distribution<float> Center(-100.0f, 100.0f);
+        std::uniform_real_distribution<float> Extent(0.1f, 2.0f);
+        FSceneBounds Bounds;
+        Bounds.Resize(BoundsNum);
+        for (uint32_t Index = 0; Index < BoundsNum; ++Index)
+        {
+            Bounds.CenterX[Index] = Center(Random);
+            Bounds.CenterY[Index] = Center(Random);
+            Bounds.CenterZ[Index] = Center(Random);
+            Bounds.ExtentX[Index] = Extent(Random);
+            Bounds.ExtentY[Index] = Extent(Random);
+            Bounds.ExtentZ[Index] = Extent(Random);
+            Bounds.Radius[Index] = glm::length(glm::vec3(Bounds.ExtentX[Index], Bounds.ExtentY[Index], Bounds.ExtentZ[Index]));
+        }
+        const FFrustum Frustum = FFrustum::FromViewProjection(glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 200.0f));
+
+        std::vector<uint32_t> Visible;
+        while (State.KeepRunning())
+        {
+            FFrustumCulling::Cull(Frustum, Bounds, ECullingVolume::Box, Visible);
+        }
+        State.SetItemsProcessed(State.GetIterations() * BoundsNum);
+        FFrustumCulling::SetPath(PreviousPath);
+    }
+
+    // Small boxes scattered through a 1km cube, shared by the BVH cases
+    const std::vector<FBoundingBox>& GetMillionPrimitives()
+    {
+        static const std::vector<FBoundingBox> Primitives = []()
+        {
+            std::mt19937 Random(1);
+            std::uniform_real_distribution<float> Position(-500.0f, 500.0f);
+            std::uniform_real_distribution<float> Size(0.5f, 2.0f);
+            std::vector<FBoundingBox> Boxes(1000000);
+            for (FBoundingBox& Box : Boxes)
+            {
+                Box.Min = glm::vec3(Position(Random), Position(Random), Position(Random));
+                Box.Max = Box.Min + glm::vec3(Size(Random), Size(Random), Size(Random));
+            }
+            return Boxes;
+        }();
+        return Primitives;
+    }
+
+    // Built on first use so the query cases don't pay the build on every run
+    const FBvh& GetMillionPrimitiveBvh()
+    {
+        static const FBvh Bvh = []()
+        {
+            FBvh Tree;
+            Tree.Build(GetMillionPrimitives());
+            return Tree;
+        }();
+        return Bvh;
+    }
+
+    // 100 walls of 200 triangles each between 15m and 60m in front of a camera looking down -Z
+    void SetupOccluders(FOcclusionCuller& Culler)
+    {
+        constexpr uint32_t GridSize = 10;
+        std::vector<glm::vec3> Positions;
+        std::vector<uint32_t> Indices;
+        for (uint32_t Y = 0; Y <= GridSize; ++Y)
+        {
+            for (uint32_t X = 0; X <= GridSize; ++X)
+            {
+                Positions.emplace_back(static_cast<float>(X) / GridSize - 0.5f, static_cast<float>(Y) / GridSize - 0.5f, 0.0f);
+            }
+        }
+        for (uint32_t Y = 0; Y < GridSize; ++Y)
+        {
+            for (uint32_t X = 0; X < GridSize; ++X)
+            {
+                const uint32_t Corner = Y * (GridSize + 1) + X;
+                Indices.insert(Indices.end(), {Corner, Corner + 1, Corner + GridSize + 2, Corner, Corner + GridSize + 2, Corner + GridSize + 1});
+            }
+        }
+
+        Culler.Init();
+        const uint32_t MeshId = Culler.RegisterOccluderMesh(Positions, Indices);
+        const glm::mat4 ViewProjection = glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 500.0f);
+        Culler.BeginFrame(ViewProjection);
+        std::mt19937 Random(4);
+        std::uniform_real_distribution<float> Unit(-1.0f, 1.0f);
+        for (uint32_t Wall = 0; Wall < 100; ++Wall)
+        {
+            const float Depth = 15.0f + 45.0f * (Unit(Random) * 0.5f + 0.5f);
+            const glm::vec3 Position(Unit(Random) * Depth * 0.6f, Unit(Random) * Depth * 0.3f, -Depth);
+            const glm::mat4 World = glm::scale(glm::translate(glm::mat4(1.0f), Position), glm::vec3(4.0f, 3.0f, 1.0f));
+            Culler.AddOccluder(MeshId, World);
+        }
+    }
+
+    // Pipeline, material and vertex buffer changes FDrawList::Submit would record for the draws in this order
+    uint32_t CountStateChanges(const std::vector<FDrawCommand>& Commands, const std::vector<uint32_t>& Order)
+    {
+        uint32_t Changes = 0;
+        const FDrawCommand* Previous = nullptr;
+        for (uint32_t Index : Order)
+        {
+            const FDrawCommand& Command = Commands[Index];
+            Changes += !Previous || Previous->PipelineId != Command.PipelineId ? 1 : 0;
+            Changes += !Previous || Previous->MaterialId != Command.MaterialId ? 1 : 0;
+            Changes += !Previous || Previous->VertexBufferId != Command.VertexBufferId ? 1 : 0;
+            Previous = &Command;
+        }
+        return Changes;
+    }
+
+    // Gradients, a repeating pattern and noise, so blocks range from flat to busy
+    const std::vector<uint8_t>& GetEncodeSourceImage()
+    {
+        static const std::vector<uint8_t> Pixels = []()
+        {
+            std::vector<uint8_t> Image(1024 * 1024 * 4);
+            std::mt19937 Random(7);
+            for (uint32_t Y = 0; Y < 1024; ++Y)
+            {
+                for (uint32_t X = 0; X < 1024; ++X)
+                {
+                    uint8_t* Pixel = &Image[(Y * 1024 + X) * 4];
+                    const float Pattern = std::sin(X * 0.05f) * std::cos(Y * 0.03f);
+                    const uint32_t Noise = Random() % 24;
+                    Pixel[0] = static_cast<uint8_t>(std::min(X / 4 + Noise, 255u));
+                    Pixel[1] = static_cast<uint8_t>(std::min(static_cast<uint32_t>(128.0f + 100.0f * Pattern) + Noise, 255u));
+                    Pixel[2] = static_cast<uint8_t>(std::min(Y / 4 + Noise / 2, 255u));
+                    Pixel[3] = static_cast<uint8_t>(Pattern > 0.0f ? 255 : 64 + Noise);
+                }
+            }
+            return Image;
+        }();
+        return Pixels;
+    }
+
+    // The channels the format stores, BC5 keeps red and green
+    double ComputeEncodePSNR(const std::vector<uint8_t>& Source, const std::vector<uint8_t>& Decoded, uint32_t ChannelNum)
+    {
+        uint64_t SquaredError = 0;
+        for (size_t Index = 0; Index < Source.size(); Index += 4)
+        {
+            for (uint32_t Channel = 0; Channel < ChannelNum; ++Channel)
+            {
+                const int32_t Difference = Source[Index + Channel] - Decoded[Index + Channel];
+                SquaredError += static_cast<uint64_t>(Difference * Difference);
+            }
+        }
+        const double MeanSquaredError = std::max(static_cast<double>(SquaredError) / (Source.size() / 4 * ChannelNum), 1e-10);
+        return 10.0 * std::log10(255.0 * 255.0 / MeanSquaredError);
+    }
+
+    void RunTextureEncode(FBenchmarkState& State, ETextureCompression Compression, uint32_t ChannelNum, const char* Name)
+    {
+        const std::vector<uint8_t>& Source = GetEncodeSourceImage();
+        std::vector<uint8_t> Compressed;
+        while (State.KeepRunning())
+        {
+            FTextureCompressor::CompressImage(Source.data(), 1024, 1024, Compression, Compressed);
+        }
+        State.SetItemsProcessed(State.GetIterations() * 1024 * 1024);
+        State.SetBytesProcessed(State.GetIterations() * Source.size());
+
+        std::vector<uint8_t> Decoded;
+        FTextureCompressor::DecompressImage(Compressed.data(), 1024, 1024, Compression, Decoded);
+        VK_LOG(LOG_INFO, "TextureEncode/%s PSNR %.2f dB", Name, ComputeEncodePSNR(Source, Decoded, ChannelNum));
+    }
+
+    void RunCompileShader(FBenchmarkState& State, const std::shared_ptr<FShader>& Shader)
+    {
+        std::vector<uint32_t> Spirv;
+        std::string ParseError;
+        while (State.KeepRunning())
+        {
+            Spirv.clear();
+            FShaderCompiler::Get()->CompileSpirv(*Shader, Spirv, ParseError);
+        }
+    }
+}
+
+FBenchmarkState::FBenchmarkState(uint64_t InMaxIterations)
+    : MaxIterations(InMaxIterations)
+{
+}
+
+bool FBenchmarkState::KeepRunning()
+{
+    if (!bStarted)
+    {
+        bStarted = true;
+        ResumeTiming();
+    }
+    if (Iteration < MaxIterations)
+    {
+        ++Iteration;
+        return true;
+    }
+    PauseTiming();
+    return false;
+}
+
+void FBenchmarkState::PauseTiming()
+{
+    if (bTiming)
+    {
+        RealNanoseconds += GetRealNanoseconds() - RealStart;
+        CpuNanoseconds += FPlatform::GetThreadCpuNanoseconds() - CpuStart;
+        bTiming = false;
+    }
+}
+
+void FBenchmarkState::ResumeTiming()
+{
+    if (!bTiming)
+    {
+        RealStart = GetRealNanoseconds();
+        CpuStart = FPlatform::GetThreadCpuNanoseconds();
+        bTiming = true;
+    }
+}
+
+void FBenchmarkState::SetItemsProcessed(uint64_t Items)
+{
+    ItemsProcessed = Items;
+}
+
+void FBenchmarkState::SetBytesProcessed(uint64_t Bytes)
+{
+    BytesProcessed = Bytes;
+}
+
+uint64_t FBenchmarkState::GetIterations() const
+{
+    return Iteration;
+}
+
+bool FRhiBenchmark::Run(const std::string& Filter, const std::string& OutputPath, double MinSeconds)
+{
+    static const FBenchmarkCase Cases[] =
+    {
+        {"CreateBuffer/64KB", &FRhiBenchmark::CreateBuffer, 256},
+        {"UpdateBuffer/4KB", &FRhiBenchmark::UpdateBufferSmall, 0},
+        {"UpdateBuffer/1MB", &FRhiBenchmark::UpdateBufferLarge, 0},
+        {"AsyncUpload/1MB", &FRhiBenchmark::AsyncUpload, 0},
+        {"Timeline/SubmitWait", &FRhiBenchmark::TimelineSubmitWait, 0},
+        {"Timeline/CrossQueueDependency", &FRhiBenchmark::TimelineCrossQueueDependency, 0},
+        {"Timeline/ConcurrentPolling", &FRhiBenchmark::TimelineConcurrentPolling, 0},
+        {"ReadbackTexture/256", &FRhiBenchmark::ReadbackTextureSmall, 0},
+        {"ReadbackTexture/2048", &FRhiBenchmark::ReadbackTextureLarge, 0},
+        {"ReadbackBuffer/64KB", &FRhiBenchmark::ReadbackBufferSmall, 0},
+        {"ReadbackBuffer/16MB", &FRhiBenchmark::ReadbackBufferLarge, 0},
+        {"UniformStream/Allocate256", &FRhiBenchmark::UniformStreamAllocate, 0},
+        {"GetOrCreateRenderPass/Cached", &FRhiBenchmark::GetOrCreateRenderPass, 0},
+        {"BeginEndRenderPass", &FRhiBenchmark::BeginEndRenderPass, 0},
+        {"SetGraphicsPipeline/Cached", &FRhiBenchmark::SetGraphicsPipeline, 0},
+        {"DrawPrimitive/SameStream", &FRhiBenchmark::DrawSameStream, 0},
+        {"DrawPrimitive/BindStreamResource", &FRhiBenchmark::DrawAlternatingStreams, 0},
+        {"TransitionBarrier", &FRhiBenchmark::TransitionBarrier, 0},
+        {"ShaderCompile/DefaultVertex", &FRhiBenchmark::CompileVertexShader, 0},
+        {"ShaderCompile/DefaultPixel", &FRhiBenchmark::CompilePixelShader, 0},
+        {"CreateShaderModule/DefaultPixel", &FRhiBenchmark::CreateShaderModule, 0},
+        {"SceneUpdate/100k", &FRhiBenchmark::SceneUpdate, 0},
+        {"FrustumCull/100k/Scalar", &FRhiBenchmark::FrustumCullScalar, 0},
+        {"FrustumCull/100k/SSE", &FRhiBenchmark::FrustumCullSSE, 0},
+        {"FrustumCull/100k/AVX2", &FRhiBenchmark::FrustumCullAVX2, 0},
+        {"Bvh/Build/1M", &FRhiBenchmark::BvhBuild, 0},
+        {"Bvh/Raycast/1M", &FRhiBenchmark::BvhRaycast, 0},
+        {"Bvh/QueryAabb/1M", &FRhiBenchmark::BvhQueryAabb, 0},
+        {"Bvh/QueryFrustum/1M", &FRhiBenchmark::BvhQueryFrustum, 0},
+        {"OcclusionCull/Rasterize/20kTris", &FRhiBenchmark::OcclusionRasterize, 0},
+        {"OcclusionCull/FilterVisible/100k", &FRhiBenchmark::OcclusionFilterVisible, 0},
+        {"DrawList/Sort/100k", &FRhiBenchmark::DrawListSort, 0},
+        {"TextureEncode/BC1/1024", &FRhiBenchmark::TextureEncodeBC1, 0},
+        {"TextureEncode/BC5/1024", &FRhiBenchmark::TextureEncodeBC5, 0},
+        {"TextureEncode/BC7/1024", &FRhiBenchmark::TextureEncodeBC7, 0},
+    };
+
+    CreateResources();
+    FVulkan::ResetGraphicsCommandBuffer();
+
+    std::vector<FBenchmarkResult> Results;
+    VK_LOG(LOG_INFO, "%-36s %14s %14s %12s", "Benchmark", "Time", "CPU", "Iterations");
+    for (const FBenchmarkCase& Case : Cases)
+    {
+        if (!Filter.empty() && std::string(Case.Name).find(Filter) == std::string::npos)
+        {
+            continue;
+        }
+        const FBenchmarkResult Result = RunCase(Case, MinSeconds);
+        if (Result.Iterations == 0)
+        {
+            VK_LOG(LOG_WARNING, "%-36s skipped", Case.Name);
+            continue;
+        }
+        Results.push_back(Result);
+        VK_LOG(LOG_INFO, "%-36s %11.1f ns %11.1f ns %12llu", Result.Name.c_str(), Result.RealNanoseconds, Result.CpuNanoseconds, static_cast<unsigned long long>(Result.Iterations));
+    }
+
+    ReleaseResources();
+    const uint64_t SubmitValue = FVulkan::EndGraphicsCommandBuffer();
+    FVulkan::AdvanceFrame();
+    FVulkan::GetQueue(EQueueType::Graphics).Wait(SubmitValue);
+    FVulkan::ReleaseRetiredResources();
+
+    if (Results.empty())
+    {
+        VK_LOG(LOG_ERROR, "No benchmark matches filter %s", Filter.c_str());
+        return false;
+    }
+    return OutputPath.empty() || WriteReport(OutputPath, Results);
+}
+
+FBenchmarkResult FRhiBenchmark::RunCase(const FBenchmarkCase& Case, double MinSeconds)
+{
+    // Grows the iteration count like Google Benchmark until one run takes MinSeconds
+    uint64_t Iterations = Case.FixedIterations > 0 ? Case.FixedIterations : 1;
+    while (true)
+    {
+        FBenchmarkState State(Iterations);
+        Case.Function(State);
+        State.PauseTiming();
+        // Every case leaves the command buffer recording outside a render pass with nothing pending
+        FlushGraphics();
+
+        const double Seconds = static_cast<double>(State.RealNanoseconds) / 1000000000.0;
+        if (State.Iteration == 0)
+        {
+            // The case bailed out before its loop
+            return FBenchmarkResult();
+        }
+        if (Case.FixedIterations > 0 || Seconds >= MinSeconds || Iterations >= MaxIterations)
+        {
+            FBenchmarkResult Result;
+            Result.Name = Case.Name;
+            Result.Iterations = State.Iteration;
+            Result.RealNanoseconds = static_cast<double>(State.RealNanoseconds) / static_cast<double>(State.Iteration);
+            Result.CpuNanoseconds = static_cast<double>(State.CpuNanoseconds) / static_cast<double>(State.Iteration);
+            Result.ItemsPerSecond = Seconds > 0.0 ? static_cast<double>(State.ItemsProcessed) / Seconds : 0.0;
+            Result.BytesPerSecond = Seconds > 0.0 ? static_cast<double>(State.BytesProcessed) / Seconds : 0.0;
+            return Result;
+        }
+
+        const double Multiplier = Seconds > 0.0 ? MinSeconds * 1.4 / Seconds : 10.0;
+        const double NextIterations = std::min(static_cast<double>(Iterations) * std::min(Multiplier, 10.0), static_cast<double>(MaxIterations));
+        Iterations = std::max(Iterations + 1, static_cast<uint64_t>(NextIterations));
+    }
+}
+
+bool FRhiBenchmark::WriteReport(const std::string& OutputPath, const std::vector<FBenchmarkResult>& Results)
+{
+    VkPhysicalDeviceProperties Properties;
+    vkGetPhysicalDeviceProperties(FVulkan::GetPhysicalDevice(), &Properties);
+
+    FJsonValue Context = FJsonValue::MakeObject();
+    Context.SetField("date", FPerfHistory::MakeTimestamp());
+    Context.SetField("executable", "Vulkano");
+    Context.SetField("device", Properties.deviceName);
+    Context.SetField("driver_version", Properties.driverVersion);
+    Context.SetField("api_version", Properties.apiVersion);
+#ifdef _DEBUG
+    Context.SetField("library_build_type", "debug");
+#else
+    Context.SetField("library_build_type", "release");
+#endif
+
+    FJsonValue Benchmarks = FJsonValue::MakeArray();
+    for (const FBenchmarkResult& Result : Results)
+    {
+        FJsonValue Json = FJsonValue::MakeObject();
+        Json.SetField("name", Result.Name);
+        Json.SetField("run_name", Result.Name);
+        Json.SetField("run_type", "iteration");
+        Json.SetField("iterations", Result.Iterations);
+        Json.SetField("real_time", Result.RealNanoseconds);
+        Json.SetField("cpu_time", Result.CpuNanoseconds);
+        Json.SetField("time_unit", "ns");
+        if (Result.ItemsPerSecond > 0.0)
+        {
+            Json.SetField("items_per_second", Result.ItemsPerSecond);
+        }
+        if (Result.BytesPerSecond > 0.0)
+        {
+            Json.SetField("bytes_per_second", Result.BytesPerSecond);
+        }
+        Benchmarks.Append(Json);
+    }
+
+    FJsonValue Report = FJsonValue::MakeObject();
+    Report.SetField("context", Context);
+    Report.SetField("benchmarks", Benchmarks);
+
+    std::ofstream File(OutputPath, std::ios::out | std::ios::trunc);
+    if (!File.is_open())
+    {
+        VK_LOG(LOG_ERROR, "Failed writing benchmark report %s", OutputPath.c_str());
+        return false;
+    }
+    File << Report.Serialize() << '\n';
+    VK_LOG(LOG_INFO, "Benchmark report written to %s", OutputPath.c_str());
+    return File.good();
+}
+
+void FRhiBenchmark::CreateResources()
+{
+    const VkImageUsageFlags TargetUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    Resources.TargetA = FVulkan::CreateTexture(FTextureDesc::Create2D(TargetSize, TargetSize, VK_FORMAT_R8G8B8A8_UNORM, TargetUsage, "BenchmarkTargetA"));
+    Resources.TargetB = FVulkan::CreateTexture(FTextureDesc::Create2D(TargetSize, TargetSize, VK_FORMAT_R8G8B8A8_UNORM, TargetUsage, "BenchmarkTargetB"));
+
+    // Degenerate triangles, the draw cases measure recording and the GPU has nothing to rasterize
+    const VkMemoryPropertyFlags HostMemory = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    const std::vector<FSimpleVertex> Vertices(6, FSimpleVertex{});
+    for (std::shared_ptr<FVulkanBuffer>& VertexBuffer : Resources.VertexBuffers)
+    {
+        VertexBuffer = FVulkan::CreateBuffer(sizeof(FSimpleVertex) * Vertices.size(), static_cast<uint32_t>(Vertices.size()), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, HostMemory, "BenchmarkVertexBuffer");
+        FVulkan::UpdateBuffer(VertexBuffer, Vertices.data(), sizeof(FSimpleVertex) * Vertices.size());
+    }
+    Resources.UploadBuffer = FVulkan::CreateBuffer(1024 * 1024, 1, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, HostMemory, "BenchmarkUploadBuffer");
+    Resources.UploadTarget = FVulkan::CreateBuffer(1024 * 1024, 1, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "BenchmarkUploadTarget");
+
+    Resources.PSOInit.VertexShader = FShaderCompiler::Get()->FindShader<FDefaultVertexShader>();
+    Resources.PSOInit.PixelShader = FShaderCompiler::Get()->FindShader<FDefaultPixelShader>();
+    Resources.PSOInit.PrimitiveTopology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    Resources.PSOInit.VertexInput = VKGlobals::GSimpleVertexInput;
+}
+
+void FRhiBenchmark::ReleaseResources()
+{
+    FVulkan::ReleaseTexture(Resources.TargetA);
+    FVulkan::ReleaseTexture(Resources.TargetB);
+    for (std::shared_ptr<FVulkanBuffer>& VertexBuffer : Resources.VertexBuffers)
+    {
+        VertexBuffer->Release();
+    }
+    Resources.UploadBuffer->Release();
+    Resources.UploadTarget->Release();
+    Resources = FBenchmarkResources();
+}
+
+void FRhiBenchmark::FlushGraphics()
+{
+    const uint64_t SubmitValue = FVulkan::EndGraphicsCommandBuffer();
+    FVulkan::AdvanceFrame();
+    FVulkan::GetQueue(EQueueType::Graphics).Wait(SubmitValue);
+    FVulkan::ReleaseRetiredResources();
+    FVulkan::ResetGraphicsCommandBuffer();
+}
+
+void FRhiBenchmark::BeginBenchmarkPass()
+{
+    Resources.PSOInit.RenderPass = FVulkan::BeginRenderPass(MakeBenchmarkPassInfo(), {TargetSize, TargetSize}, "BenchmarkPass");
+    FVulkan::SetScissorRect(false, 0, 0, 0, 0);
+    FVulkan::SetViewport(0.0f, 0.0f, 0.0f, static_cast<float>(TargetSize), static_cast<float>(TargetSize), 1.0f);
+}
+
+void FRhiBenchmark::RunReadbackTexture(FBenchmarkState& State, uint32_t Size)
+{
+    // A cleared pass leaves the target in shader read layout like the GBuffer captures
+    const VkImageUsageFlags Usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    std::shared_ptr<FVulkanTexture> Texture = FVulkan::CreateTexture(FTextureDesc::Create2D(Size, Size, VK_FORMAT_R8G8B8A8_UNORM, Usage, "BenchmarkReadbackTexture"));
+    FVulkan::BeginRenderPass(FRenderPassInfo({Texture}, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE), {Size, Size}, "BenchmarkReadbackPass");
+    FVulkan::EndRenderPass();
+    FlushGraphics();
+
+    const uint64_t Bytes = static_cast<uint64_t>(Size) * Size * 4;
+    std::vector<uint8_t> Data(Bytes);
+    const FReadbackStats StartStats = FGpuReadback::GetStats();
+    while (State.KeepRunning())
+    {
+        FReadbackFuture Future = FVulkan::ReadbackTexture(Texture, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        FlushGraphics();
+        checkf(Future.IsReady() && Future.GetSize() == Bytes, "ReadbackTexture/%u not resolved after its submission completed", Size);
+        memcpy(Data.data(), Future.GetData(), Bytes);
+    }
+    State.SetBytesProcessed(State.GetIterations() * Bytes);
+    LogReadbackThroughput("ReadbackTexture", StartStats);
+    FVulkan::ReleaseTexture(Texture);
+}
+
+void FRhiBenchmark::RunReadbackBuffer(FBenchmarkState& State, uint64_t Size)
+{
+    std::shared_ptr<FVulkanBuffer> Buffer = FVulkan::CreateBuffer(Size, 1, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "BenchmarkReadbackBuffer");
+
+    std::vector<uint8_t> Data(Size);
+    const FReadbackStats StartStats = FGpuReadback::GetStats();
+    while (State.KeepRunning())
+    {
+        FReadbackFuture Future = FVulkan::ReadbackBuffer(Buffer, 0, Size);
+        FlushGraphics();
+        checkf(Future.IsReady() && Future.GetSize() == Size, "ReadbackBuffer/%llu not resolved after its submission completed", static_cast<unsigned long long>(Size));
+        memcpy(Data.data(), Future.GetData(), Size);
+    }
+    State.SetBytesProcessed(State.GetIterations() * Size);
+    LogReadbackThroughput("ReadbackBuffer", StartStats);
+    Buffer->Release();
+}
+
+void FRhiBenchmark::CreateBuffer(FBenchmarkState& State)
+{
+    // Creation logs every buffer, the fixed iteration count keeps the output readable
+    while (State.KeepRunning())
+    {
+        std::shared_ptr<FVulkanBuffer> Buffer = FVulkan::CreateBuffer(64 * 1024, 1, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "BenchmarkBuffer");
+        Buffer->Release();
+    }
+}
+
+void FRhiBenchmark::UpdateBufferSmall(FBenchmarkState& State)
+{
+    RunUpdateBuffer(State, 4 * 1024);
+}
+
+void FRhiBenchmark::UpdateBufferLarge(FBenchmarkState& State)
+{
+    RunUpdateBuffer(State, 1024 * 1024);
+}
+
+void FRhiBenchmark::AsyncUpload(FBenchmarkState& State)
+{
+    // Whole round trip: staging, transfer queue copy and the acquire by the next graphics command buffer
+    const size_t Size = 1024 * 1024;
+    while (State.KeepRunning())
+    {
+        const uint64_t UploadId = FAsyncUpload::UploadBuffer(Resources.UploadTarget, std::vector<uint8_t>(Size, 0x5a));
+        while (!FAsyncUpload::IsReady(UploadId))
+        {
+            FAsyncUpload::Flush();
+            FlushGraphics();
+        }
+    }
+    State.SetBytesProcessed(State.GetIterations() * Size);
+}
+
+void FRhiBenchmark::TimelineSubmitWait(FBenchmarkState& State)
+{
+    // Empty submissions on the compute queue, graphics values are already promised to the recording command buffer
+    FVulkanQueue& Queue = FVulkan::GetQueue(EQueueType::Compute);
+    uint64_t LastCompleted = Queue.GetCompletedValue();
+    while (State.KeepRunning())
+    {
+        const uint64_t Value = Queue.Submit(nullptr, 0);
+        checkf(Queue.Wait(Value), "Timeline/SubmitWait wait for %llu failed", Value);
+        checkf(Queue.IsComplete(Value), "Timeline/SubmitWait %llu not complete after its wait", Value);
+        const uint64_t Completed = Queue.GetCompletedValue();
+        checkf(Completed >= Value && Completed >= LastCompleted, "Timeline/SubmitWait completed value went from %llu to %llu", LastCompleted, Completed);
+        LastCompleted = Completed;
+    }
+    State.SetItemsProcessed(State.GetIterations());
+}
+
+void FRhiBenchmark::TimelineCrossQueueDependency(FBenchmarkState& State)
+{
+    // Graphics waits on a compute submission, once graphics is done the compute value has to be complete too
+    FVulkanQueue& Compute = FVulkan::GetQueue(EQueueType::Compute);
+    FVulkanQueue& Graphics = FVulkan::GetQueue(EQueueType::Graphics);
+    while (State.KeepRunning())
+    {
+        Compute.Submit(nullptr, 0);
+        const FQueueSyncPoint SyncPoint = Compute.GetLastSyncPoint();
+        Graphics.AddDependency(SyncPoint, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+        FlushGraphics();
+        checkf(Compute.IsComplete(SyncPoint.Value), "Timeline/CrossQueueDependency graphics finished before compute value %llu", SyncPoint.Value);
+    }
+    State.SetItemsProcessed(State.GetIterations());
+}
+
+void FRhiBenchmark::TimelineConcurrentPolling(FBenchmarkState& State)
+{
+    // Two threads poll the cached completed value while this one submits and waits, nobody may see it go back
+    FVulkanQueue& Queue = FVulkan::GetQueue(EQueueType::Compute);
+    std::atomic<bool> bPolling{true};
+    auto Poll = [&Queue, &bPolling]()
+    {
+        uint64_t LastCompleted = 0;
+        while (bPolling.load(std::memory_order_relaxed))
+        {
+            const uint64_t Completed = Queue.GetCompletedValue();
+            checkf(Completed >= LastCompleted, "Timeline/ConcurrentPolling completed value went from %llu to %llu", LastCompleted, Completed);
+            LastCompleted = Completed;
+        }
+    };
+    std::thread Pollers[2] = {std::thread(Poll), std::thread(Poll)};
+
+    while (State.KeepRunning())
+    {
+        const uint64_t Value = Queue.Submit(nullptr, 0);
+        checkf(Queue.Wait(Value), "Timeline/ConcurrentPolling wait for %llu failed", Value);
+    }
+
+    bPolling = false;
+    for (std::thread& Poller : Pollers)
+    {
+        Poller.join();
+    }
+    checkf(Queue.GetCompletedValue() >= Queue.GetLastSubmittedValue(), "Timeline/ConcurrentPolling lost the last completed value");
+    State.SetItemsProcessed(State.GetIterations());
+}
+
+void FRhiBenchmark::ReadbackTextureSmall(FBenchmarkState& State)
+{
+    RunReadbackTexture(State, 256);
+}
+
+void FRhiBenchmark::ReadbackTextureLarge(FBenchmarkState& State)
+{
+    RunReadbackTexture(State, 2048);
+}
+
+void FRhiBenchmark::ReadbackBufferSmall(FBenchmarkState& State)
+{
+    RunReadbackBuffer(State, 64 * 1024);
+}
+
+void FRhiBenchmark::ReadbackBufferLarge(FBenchmarkState& State)
+{
+    RunReadbackBuffer(State, 16 * 1024 * 1024);
+}
+
+void FRhiBenchmark::UniformStreamAllocate(FBenchmarkState& State)
+{
+    // A typical per-draw block written through the persistent mapping, the region is recycled with every new command buffer
+    const uint32_t Size = 256;
+    const uint64_t AllocationsPerFrame = FUniformStreamAllocator::DefaultFrameSize / (2 * Size);
+    uint8_t Data[Size] = {};
+    while (State.KeepRunning())
+    {
+        const FUniformAllocation Allocation = FUniformStreamAllocator::Allocate(Size);
+        std::memcpy(Allocation.Data, Data, Size);
+        if (State.GetIterations() % AllocationsPerFrame == 0)
+        {
+            State.PauseTiming();
+            FlushGraphics();
+            State.ResumeTiming();
+        }
+    }
+    State.SetItemsProcessed(State.GetIterations());
+    State.SetBytesProcessed(State.GetIterations() * Size);
+}
+
+void FRhiBenchmark::GetOrCreateRenderPass(FBenchmarkState& State)
+{
+    const FRenderPassInfo RenderPassInfo = MakeBenchmarkPassInfo();
+    const std::string RenderPassName = "BenchmarkPass";
+    FVulkan::GetOrCreateRenderPass(RenderPassInfo, RenderPassName);
+    while (State.KeepRunning())
+    {
+        FVulkan::GetOrCreateRenderPass(RenderPassInfo, RenderPassName);
+    }
+}
+
+void FRhiBenchmark::BeginEndRenderPass(FBenchmarkState& State)
+{
+    while (State.KeepRunning())
+    {
+        BeginBenchmarkPass();
+        FVulkan::EndRenderPass();
+        if (State.GetIterations() % RecordBatchSize == 0)
+        {
+            State.PauseTiming();
+            FlushGraphics();
+            State.ResumeTiming();
+        }
+    }
+}
+
+void FRhiBenchmark::SetGraphicsPipeline(FBenchmarkState& State)
+{
+    // Only the first call binds, the rest is the PSO cache lookup and the elided bind
+    BeginBenchmarkPass();
+    while (State.KeepRunning())
+    {
+        FVulkan::SetGraphicsPipeline(Resources.PSOInit);
+    }
+    FVulkan::EndRenderPass();
+}
+
+void FRhiBenchmark::DrawSameStream(FBenchmarkState& State)
+{
+    BeginBenchmarkPass();
+    FVulkan::SetGraphicsPipeline(Resources.PSOInit);
+    const uint32_t VertexNum = Resources.VertexBuffers[0]->GetElemNum();
+    while (State.KeepRunning())
+    {
+        FVulkan::BindStreamResource(0, Resources.VertexBuffers[0], 0);
+        FVulkan::DrawPrimitive(0, VertexNum, 1);
+        if (State.GetIterations() % RecordBatchSize == 0)
+        {
+            State.PauseTiming();
+            FVulkan::EndRenderPass();
+            FlushGraphics();
+            BeginBenchmarkPass();
+            FVulkan::SetGraphicsPipeline(Resources.PSOInit);
+            State.ResumeTiming();
+        }
+    }
+    FVulkan::EndRenderPass();
+    State.SetItemsProcessed(State.GetIterations());
+}
+
+void FRhiBenchmark::DrawAlternatingStreams(FBenchmarkState& State)
+{
+    // A new vertex buffer every draw, nothing can be elided
+    BeginBenchmarkPass();
+    FVulkan::SetGraphicsPipeline(Resources.PSOInit);
+    const uint32_t VertexNum = Resources.VertexBuffers[0]->GetElemNum();
+    while (State.KeepRunning())
+    {
+        FVulkan::BindStreamResource(0, Resources.VertexBuffers[State.GetIterations() & 1], 0);
+        FVulkan::DrawPrimitive(0, VertexNum, 1);
+        if (State.GetIterations() % RecordBatchSize == 0)
+        {
+            State.PauseTiming();
+            FVulkan::EndRenderPass();
+            FlushGraphics();
+            BeginBenchmarkPass();
+            FVulkan::SetGraphicsPipeline(Resources.PSOInit);
+            State.ResumeTiming();
+        }
+    }
+    FVulkan::EndRenderPass();
+    State.SetItemsProcessed(State.GetIterations());
+}
+
+void FRhiBenchmark::TransitionBarrier(FBenchmarkState& State)
+{
+    // TransitionBarrier expects TargetA in shader read and TargetB in transfer source, both are put back every iteration
+    // so the recorded layouts stay valid. Each iteration is three vkCmdPipelineBarrier calls
+    VkImageMemoryBarrier Restore[2] = {};
+    for (VkImageMemoryBarrier& Barrier : Restore)
+    {
+        Barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        Barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        Barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        Barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    }
+    Restore[0].image = Resources.TargetA->Image;
+    Restore[0].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    Restore[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    Restore[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    Restore[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    Restore[1].image = Resources.TargetB->Image;
+    Restore[1].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    Restore[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    Restore[1].oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    Restore[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+    // TargetA is in shader read after any benchmark pass, TargetB starts undefined
+    BeginBenchmarkPass();
+    FVulkan::EndRenderPass();
+    VkImageMemoryBarrier Initial = Restore[1];
+    Initial.srcAccessMask = 0;
+    Initial.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    vkCmdPipelineBarrier(FVulkan::GetGraphicsBuffer(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &Initial);
+
+    while (State.KeepRunning())
+    {
+        FVulkan::TransitionBarrier(Resources.TargetA, Resources.TargetB);
+        vkCmdPipelineBarrier(FVulkan::GetGraphicsBuffer(), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 2, Restore);
+        if (State.GetIterations() % RecordBatchSize == 0)
+        {
+            State.PauseTiming();
+            FlushGraphics();
+            State.ResumeTiming();
+        }
+    }
+    State.SetItemsProcessed(State.GetIterations() * 3);
+}
+
+void FRhiBenchmark::CompileVertexShader(FBenchmarkState& State)
+{
+    RunCompileShader(State, FShaderCompiler::Get()->FindShader<FDefaultVertexShader>());
+}
+
+void FRhiBenchmark::CompilePixelShader(FBenchmarkState& State)
+{
+    RunCompileShader(State, FShaderCompiler::Get()->FindShader<FDefaultPixelShader>());
+}
+
+void FRhiBenchmark::CreateShaderModule(FBenchmarkState& State)
+{
+    std::shared_ptr<FShader> Source = FShaderCompiler::Get()->FindShader<FDefaultPixelShader>();
+    std::vector<uint32_t> Spirv;
+    std::string ParseError;
+    if (!FShaderCompiler::Get()->CompileSpirv(*Source, Spirv, ParseError))
+    {
+        VK_LOG(LOG_ERROR, "CreateShaderModule could not compile %s: %s", Source->GetSource().c_str(), ParseError.c_str());
+        return;
+    }
+
+    FShader Shader;
+    while (State.KeepRunning())
+    {
+        Shader.CreateModule(Spirv);
+        Shader.Release();
+    }
+}
+
+void FRhiBenchmark::SceneUpdate(FBenchmarkState& State)
+{
+    // 1000 roots with 9 children of 10 children each. Moving every root dirties the whole hierarchy
+    constexpr uint32_t RootNum = 1000;
+    FScene Scene;
+    Scene.Reserve(RootNum * 100);
+    std::vector<FEntityId> Roots;
+    for (uint32_t Root = 0; Root < RootNum; ++Root)
+    {
+        const FEntityId RootEntity = Scene.CreateEntity(InvalidEntity, {glm::vec3(-1.0f), glm::vec3(1.0f)});
+        Roots.push_back(RootEntity);
+        for (uint32_t Child = 0; Child < 9; ++Child)
+        {
+            const FEntityId ChildEntity = Scene.CreateEntity(RootEntity, {glm::vec3(-1.0f), glm::vec3(1.0f)});
+            Scene.SetLocalTransform(ChildEntity, glm::vec3(static_cast<float>(Child), 0.0f, 0.0f), glm::angleAxis(0.1f * Child, glm::vec3(0.0f, 1.0f, 0.0f)), glm::vec3(0.9f));
+            for (uint32_t Leaf = 0; Leaf < 10; ++Leaf)
+            {
+                const FEntityId LeafEntity = Scene.CreateEntity(ChildEntity, {glm::vec3(-0.5f), glm::vec3(0.5f)});
+                Scene.SetLocalPosition(LeafEntity, glm::vec3(0.0f, static_cast<float>(Leaf), 0.0f));
+            }
+        }
+    }
+    Scene.UpdateWorldTransforms();
+
+    float Offset = 0.0f;
+    while (State.KeepRunning())
+    {
+        Offset += 0.01f;
+        for (FEntityId Root : Roots)
+        {
+            Scene.SetLocalPosition(Root, glm::vec3(Offset, 0.0f, static_cast<float>(Root)));
+        }
+        Scene.UpdateWorldTransforms();
+    }
+    State.SetItemsProcessed(State.GetIterations() * Scene.GetEntityNum());
+}
+
+void FRhiBenchmark::FrustumCullScalar(FBenchmarkState& State)
+{
+    RunFrustumCull(State, ECullingPath::Scalar);
+}
+
+void FRhiBenchmark::FrustumCullSSE(FBenchmarkState& State)
+{
+    RunFrustumCull(State, ECullingPath::SSE);
+}
+
+void FRhiBenchmark::FrustumCullAVX2(FBenchmarkState& State)
+{
+    RunFrustumCull(State, ECullingPath::AVX2);
+}
+
+void FRhiBenchmark::BvhBuild(FBenchmarkState& State)
+{
+    const std::vector<FBoundingBox>& Primitives = GetMillionPrimitives();
+    FBvh Bvh;
+    while (State.KeepRunning())
+    {
+        Bvh.Build(Primitives);
+    }
+    State.SetItemsProcessed(State.GetIterations() * Primitives.size());
+}
+
+void FRhiBenchmark::BvhRaycast(FBenchmarkState& State)
+{
+    // Rays from inside the cube in random directions, most of them hit something within the first few hundred meters
+    const FBvh& Bvh = GetMillionPrimitiveBvh();
+    std::mt19937 Random(2);
+    std::uniform_real_distribution<float> Position(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> Unit(-1.0f, 1.0f);
+    std::vector<FBvhRay> Rays(4096);
+    for (FBvhRay& Ray : Rays)
+    {
+        Ray.Origin = glm::vec3(Position(Random), Position(Random), Position(Random));
+        Ray.Direction = glm::normalize(glm::vec3(Unit(Random), Unit(Random), Unit(Random)) + glm::vec3(0.0f, 0.0f, 0.01f));
+    }
+
+    uint64_t Hits = 0;
+    FBvhHit Hit;
+    while (State.KeepRunning())
+    {
+        Hits += Bvh.Raycast(Rays[State.GetIterations() % Rays.size()], Hit) ? 1 : 0;
+    }
+    State.SetItemsProcessed(State.GetIterations());
+    if (Hits == 0)
+    {
+        VK_LOG(LOG_WARNING, "Bvh/Raycast hit nothing");
+    }
+}
+
+void FRhiBenchmark::BvhQueryAabb(FBenchmarkState& State)
+{
+    // 20m boxes, a handful of primitives each
+    const FBvh& Bvh = GetMillionPrimitiveBvh();
+    std::mt19937 Random(3);
+    std::uniform_real_distribution<float> Position(-500.0f, 480.0f);
+    std::vector<FBoundingBox> Boxes(4096);
+    for (FBoundingBox& Box : Boxes)
+    {
+        Box.Min = glm::vec3(Position(Random), Position(Random), Position(Random));
+        Box.Max = Box.Min + glm::vec3(20.0f);
+    }
+
+    std::vector<uint32_t> Primitives;
+    while (State.KeepRunning())
+    {
+        Bvh.QueryAabb(Boxes[State.GetIterations() % Boxes.size()], Primitives);
+    }
+    State.SetItemsProcessed(State.GetIterations());
+}
+
+void FRhiBenchmark::BvhQueryFrustum(FBenchmarkState& State)
+{
+    // A 60 degree camera at the cube center with a 300m far plane, tens of thousands of primitives visible
+    const FBvh& Bvh = GetMillionPrimitiveBvh();
+    const glm::mat4 Projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 300.0f);
+    std::vector<FFrustum> Frustums;
+    for (uint32_t View = 0; View < 16; ++View)
+    {
+        const float Angle = glm::radians(22.5f * static_cast<float>(View));
+        Frustums.push_back(FFrustum::FromViewProjection(Projection * glm::lookAt(glm::vec3(0.0f), glm::vec3(std::cos(Angle), 0.0f, std::sin(Angle)), glm::vec3(0.0f, 1.0f, 0.0f))));
+    }
+
+    std::vector<uint32_t> Primitives;
+    uint64_t Visible = 0;
+    while (State.KeepRunning())
+    {
+        Bvh.QueryFrustum(Frustums[State.GetIterations() % Frustums.size()], Primitives);
+        Visible += Primitives.size();
+    }
+    State.SetItemsProcessed(Visible);
+}
+
+void FRhiBenchmark::OcclusionRasterize(FBenchmarkState& State)
+{
+    // Binning, tile rasterization and the max-depth pyramid for 20k occluder triangles
+    FOcclusionCuller Culler;
+    SetupOccluders(Culler);
+    while (State.KeepRunning())
+    {
+        Culler.Rasterize();
+    }
+    State.SetItemsProcessed(State.GetIterations() * 100 * 200);
+}
+
+void FRhiBenchmark::OcclusionFilterVisible(FBenchmarkState& State)
+{
+    // Candidates spread over the view behind and between the walls
+    FOcclusionCuller Culler;
+    SetupOccluders(Culler);
+    Culler.Rasterize();
+
+    constexpr uint32_t CandidateNum = 100000;
+    std::mt19937 Random(5);
+    std::uniform_real_distribution<float> Unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> Extent(0.2f, 2.0f);
+    FSceneBounds Bounds;
+    Bounds.Resize(CandidateNum);
+    std::vector<uint32_t> Candidates(CandidateNum);
+    for (uint32_t Index = 0; Index < CandidateNum; ++Index)
+    {
+        const float Depth = 20.0f + 180.0f * (Unit(Random) * 0.5f + 0.5f);
+        Bounds.CenterX[Index] = Unit(Random) * Depth * 0.6f;
+        Bounds.CenterY[Index] = Unit(Random) * Depth * 0.3f;
+        Bounds.CenterZ[Index] = -Depth;
+        Bounds.ExtentX[Index] = Extent(Random);
+        Bounds.ExtentY[Index] = Extent(Random);
+        Bounds.ExtentZ[Index] = Extent(Random);
+        Bounds.Radius[Index] = glm::length(glm::vec3(Bounds.ExtentX[Index], Bounds.ExtentY[Index], Bounds.ExtentZ[Index]));
+        Candidates[Index] = Index;
+    }
+
+    std::vector<uint32_t> Visible;
+    uint64_t VisibleNum = 0;
+    while (State.KeepRunning())
+    {
+        Visible = Candidates;
+        VisibleNum += Culler.FilterVisible(Bounds, Visible);
+    }
+    State.SetItemsProcessed(State.GetIterations() * CandidateNum);
+    VK_LOG(LOG_INFO, "OcclusionCull/FilterVisible kept %.1f%% of the candidates", 100.0 * static_cast<double>(VisibleNum) / static_cast<double>(State.GetIterations() * CandidateNum));
+}
+
+void FRhiBenchmark::DrawListSort(FBenchmarkState& State)
+{
+    // 100k draws of 1024 meshes spread over 16 pipelines, 256 materials and 64 vertex buffers, added in scene order.
+    // Nothing is submitted, so the pipelines and buffers are only ids. The upper 8 pipelines read the instance stream
+    constexpr uint32_t DrawNum = 100000;
+    constexpr uint32_t MeshNum = 1024;
+    FDrawList DrawList;
+    DrawList.Reset();
+    for (uint32_t Pipeline = 0; Pipeline < 16; ++Pipeline)
+    {
+        FGraphicsPipelineInitializer Initializer;
+        Initializer.VertexInput = Pipeline < 8 ? std::make_shared<FVertexInput>() : std::make_shared<FInstancedStaticVertexInput>();
+        Initializer.VertexInput->InitVertexInput(0);
+        DrawList.AddPipeline(Initializer);
+    }
+    for (uint32_t Material = 0; Material < 256; ++Material)
+    {
+        const glm::vec4 Color(static_cast<float>(Material) / 255.0f);
+        DrawList.AddMaterial(&Color, sizeof(Color));
+    }
+    for (uint32_t VertexBuffer = 0; VertexBuffer < 64; ++VertexBuffer)
+    {
+        DrawList.AddVertexBuffer(std::make_shared<FVulkanBuffer>());
+    }
+
+    std::mt19937 Random(6);
+    std::vector<FDrawCommand> Meshes(MeshNum);
+    for (FDrawCommand& Mesh : Meshes)
+    {
+        Mesh.PipelineId = Random() % 16;
+        Mesh.MaterialId = Random() % 256;
+        Mesh.VertexBufferId = Random() % 64;
+        Mesh.BaseVertex = (Random() % 1024) * 36;
+        Mesh.VertexCount = 36;
+    }
+    // Every other draw is an instance of a mesh, those merge into instanced draws after sorting
+    std::uniform_real_distribution<float> Depth(0.5f, 500.0f);
+    std::vector<FDrawCommand> Commands(DrawNum);
+    for (uint32_t Index = 0; Index < DrawNum; ++Index)
+    {
+        FDrawCommand& Command = Commands[Index];
+        Command = Meshes[Random() % MeshNum];
+        Command.ViewDepth = Depth(Random);
+        if (Index % 2 == 0)
+        {
+            Command.PipelineId %= 8;
+            DrawList.AddDraw(Command);
+        }
+        else
+        {
+            Command.PipelineId = Command.PipelineId % 8 + 8;
+            FInstanceData Instance;
+            Instance.MaterialIndex = Command.MaterialId;
+            DrawList.AddInstancedDraw(Command, Instance);
+        }
+    }
+
+    while (State.KeepRunning())
+    {
+        DrawList.Sort();
+    }
+    State.SetItemsProcessed(State.GetIterations() * DrawNum);
+
+    std::vector<uint32_t> SceneOrder(DrawNum);
+    for (uint32_t Index = 0; Index < DrawNum; ++Index)
+    {
+        SceneOrder[Index] = Index;
+    }
+    VK_LOG(LOG_INFO, "DrawList/Sort state changes %u unsorted, %u sorted, %u draw calls for %u draws",
+        CountStateChanges(Commands, SceneOrder), CountStateChanges(Commands, DrawList.GetSortedCommands()), DrawList.GetBatchNum(), DrawNum);
+}
+
+void FRhiBenchmark::TextureEncodeBC1(FBenchmarkState& State)
+{
+    RunTextureEncode(State, ETextureCompression::BC1, 3, "BC1");
+}
+
+void FRhiBenchmark::TextureEncodeBC5(FBenchmarkState& State)
+{
+    RunTextureEncode(State, ETextureCompression::BC5, 2, "BC5");
+}
+
+void FRhiBenchmark::TextureEncodeBC7(FBenchmarkState& State)
+{
+    RunTextureEncode(State, ETextureCompression::BC7, 4, "BC7");
+}
@@ -0,0 +1,113 @@
+﻿#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Per iteration times in nanoseconds, rates are zero when the case doesn't report them
+struct FBenchmarkResult
+{
+    std::string Name;
+    uint64_t Iterations = 0;
+    double RealNanoseconds = 0.0;
+    double CpuNanoseconds = 0.0;
+    double ItemsPerSecond = 0.0;
+    double BytesPerSecond = 0.0;
+};
+
+// Google Benchmark style loop state, while (State.KeepRunning()) { ... }.
+// The timers start with the first KeepRunning call so setup before the loop is not measured
+class FBenchmarkState
+{
+public:
+    explicit FBenchmarkState(uint64_t InMaxIterations);
+
+    bool KeepRunning();
+    // Work between these is excluded, like flushing a full command buffer
+    void PauseTiming();
+    void ResumeTiming();
+    void SetItemsProcessed(uint64_t Items);
+    void SetBytesProcessed(uint64_t Bytes);
+    uint64_t GetIterations() const;
+
+private:
+    friend class FRhiBenchmark;
+
+    uint64_t MaxIterations = 0;
+    uint64_t Iteration = 0;
+    bool bStarted = false;
+    bool bTiming = false;
+    uint64_t RealStart = 0;
+    uint64_t CpuStart = 0;
+    uint64_t RealNanoseconds = 0;
+    uint64_t CpuNanoseconds = 0;
+    uint64_t ItemsProcessed = 0;
+    uint64_t BytesProcessed = 0;
+};
+
+// Microbenchmarks of the FVulkan hot paths: resource creation and updates, render pass and pipeline cache lookups,
+// draw recording, barrier emission and shader compilation, plus the CPU side of the engine that feeds them.
+// Runs after device creation, without a window or renderer.
+class FRhiBenchmark
+{
+public:
+    // Runs the cases whose name contains Filter, all when empty. Each case repeats until it took MinSeconds.
+    // OutputPath gets Google Benchmark compatible JSON so results can be tracked with its tools
+    static bool Run(const std::string& Filter, const std::string& OutputPath, double MinSeconds = 0.5);
+
+private:
+    using FBenchmarkFunction = void(*)(FBenchmarkState&);
+    struct FBenchmarkCase
+    {
+        const char* Name;
+        FBenchmarkFunction Function;
+        // Fixed count for cases that log or allocate per iteration, 0 scales to MinSeconds
+        uint64_t FixedIterations;
+    };
+
+    static FBenchmarkResult RunCase(const FBenchmarkCase& Case, double MinSeconds);
+    static bool WriteReport(const std::string& OutputPath, const std::vector<FBenchmarkResult>& Results);
+    static void CreateResources();
+    static void ReleaseResources();
+    // Submits what was recorded, waits for it and starts a new command buffer
+    static void FlushGraphics();
+    static void BeginBenchmarkPass();
+    // Readback round trips: copy, submit, wait, resolve and the CPU read of the data
+    static void RunReadbackTexture(FBenchmarkState& State, uint32_t Size);
+    static void RunReadbackBuffer(FBenchmarkState& State, uint64_t Size);
+
+    static void CreateBuffer(FBenchmarkState& State);
+    static void UpdateBufferSmall(FBenchmarkState& State);
+    static void UpdateBufferLarge(FBenchmarkState& State);
+    static void AsyncUpload(FBenchmarkState& State);
+    static void TimelineSubmitWait(FBenchmarkState& State);
+    static void TimelineCrossQueueDependency(FBenchmarkState& State);
+    static void TimelineConcurrentPolling(FBenchmarkState& State);
+    static void ReadbackTextureSmall(FBenchmarkState& State);
+    static void ReadbackTextureLarge(FBenchmarkState& State);
+    static void ReadbackBufferSmall(FBenchmarkState& State);
+    static void ReadbackBufferLarge(FBenchmarkState& State);
+    static void UniformStreamAllocate(FBenchmarkState& State);
+    static void GetOrCreateRenderPass(FBenchmarkState& State);
+    static void BeginEndRenderPass(FBenchmarkState& State);
+    static void SetGraphicsPipeline(FBenchmarkState& State);
+    static void DrawSameStream(FBenchmarkState& State);
+    static void DrawAlternatingStreams(FBenchmarkState& State);
+    static void TransitionBarrier(FBenchmarkState& State);
+    static void CompileVertexShader(FBenchmarkState& State);
+    static void CompilePixelShader(FBenchmarkState& State);
+    static void CreateShaderModule(FBenchmarkState& State);
+    static void SceneUpdate(FBenchmarkState& State);
+    static void FrustumCullScalar(FBenchmarkState& State);
+    static void FrustumCullSSE(FBenchmarkState& State);
+    static void FrustumCullAVX2(FBenchmarkState& State);
+    static void BvhBuild(FBenchmarkState& State);
+    static void BvhRaycast(FBenchmarkState& State);
+    static void BvhQueryAabb(FBenchmarkState& State);
+    static void BvhQueryFrustum(FBenchmarkState& State);
+    static void OcclusionRasterize(FBenchmarkState& State);
+    static void OcclusionFilterVisible(FBenchmarkState& State);
+    static void DrawListSort(FBenchmarkState& State);
+    static void TextureEncodeBC1(FBenchmarkState& State);
+    static void TextureEncodeBC5(FBenchmarkState& State);
+    static void TextureEncodeBC7(FBenchmarkState& State);
+};
@@ -2,13 +2,10 @@
 #include "glslang/SPIRV/GlslangToSpv.h"
 #include "Core/Assertion.h"
 #include "Core/Paths.h"
-#include <dxcapi.h>
-#include <wrl.h>
+#include "Core/Platform.h"
 
 #include "VulkanInterface.h"
 
-using Microsoft::WRL::ComPtr;
-
 FShader::FShader()
 {
 }
@@ -244,8 +241,37 @@ void InitResources(TBuiltInResource& Resources)
 
 void FShaderCompiler::Compile(std::shared_ptr<FShader>& Shader)
 {
-	std::string ShaderDirectory = FPaths::GetShaderDirectory();
-	std::string FilePath = FPaths::GetShaderDirectory() + Shader->GetSource();
+	std::vector<uint32_t> spirv;
+	std::string ParseError;
+	if (!CompileSpirv(*Shader, spirv, ParseError))
+	{
+		if (ParseError.empty())
+		{
+			return;
+		}
+
+		std::string Message = "Shader compile error:\n";
+		Message += ParseError;
+		if(FPlatform::AskYesNo("Shader compilation retry", Message))
+		{
+			Compile(Shader);
+		}
+		else
+		{
+			fatal("Failing compiling shader, no retry was selected, terminating program");
+		}
+		return;
+	}
+
+	if(Shader->CreateModule(spirv))
+	{
+		VK_LOG(LOG_SUCCESS, "Compiled shader: %s", FPaths::GetFileName(Shader->GetSource()).c_str());
+	}
+}
+
+bool FShaderCompiler::CompileSpirv(const FShader& Shader, std::vector<uint32_t>& OutSpirv, std::string& OutParseError) const
+{
+	std::string FilePath = FPaths::GetShaderDirectory() + Shader.GetSource();
 	
 	if(!FPaths::FileExists(FilePath))
 	{
@@ -254,7 +280,7 @@ void FShaderCompiler::Compile(std::shared_ptr<FShader>& Shader)
 
 	std::string SourceCode = FPaths::LoadFileToString(FilePath);
 	const char* shaderStrings = SourceCode.c_str();
-	glslang::EShSource SourceType = Shader->GetCompilerType() == ECompilerType::GLSL ? glslang::EShSourceGlsl : glslang::EShSourceHlsl;
+	glslang::EShSource SourceType = Shader.GetCompilerType() == ECompilerType::GLSL ? glslang::EShSourceGlsl : glslang::EShSourceHlsl;
 
 	glslang::EShTargetClientVersion Version;
 	switch (FVulkan::GetMinorVersion())
@@ -272,29 +298,19 @@ void FShaderCompiler::Compile(std::shared_ptr<FShader>& Shader)
 		Version = glslang::EShTargetVulkan_1_3;
 	}
 	
-	glslang::TShader shader(Shader->GetShaderType());
+	glslang::TShader shader(Shader.GetShaderType());
 	shader.setEnvClient(glslang::EShClient::EShClientVulkan, Version);
 	shader.setEnvTarget(glslang::EShTargetSpv, glslang::EShTargetSpv_1_6);
 	shader.setStrings(&shaderStrings, 1);
-	shader.setEntryPoint(Shader->GetEntryPoint().c_str());
-	shader.setEnvInput(SourceType, Shader->GetShaderType(), glslang::EShClientVulkan, 460);
+	shader.setEntryPoint(Shader.GetEntryPoint().c_str());
+	shader.setEnvInput(SourceType, Shader.GetShaderType(), glslang::EShClientVulkan, 460);
 
 	TBuiltInResource Resources = {};
 	InitResources(Resources);
 	if (!shader.parse(&Resources , 460, true, EShMsgDefault))
 	{
-		std::string Message = "Shader compile error:\n";
-		Message += shader.getInfoLog();
-		int result = MessageBoxA(NULL, Message.c_str(), "Shader compilation retry", MB_ICONQUESTION | MB_YESNO);
-		if( result == IDYES)
-		{
-			Compile(Shader);
-		}
-		else
-		{
-			fatal("Failing compiling shader, no retry was selected, terminating program");
-		}
-		return;
+		OutParseError = shader.getInfoLog();
+		return false;
 	}
 
 	glslang::TProgram program;
@@ -303,13 +319,9 @@ void FShaderCompiler::Compile(std::shared_ptr<FShader>& Shader)
 	if (!program.link(EShMsgDefault))
 	{
 		VK_LOG(LOG_ERROR, "Shader link error: %s\n", program.getInfoLog());
-		return;
+		return false;
 	}
 
-	std::vector<uint32_t> spirv;
-	glslang::GlslangToSpv(*program.getIntermediate(Shader->GetShaderType()), spirv);
-	if(Shader->CreateModule(spirv))
-	{
-		VK_LOG(LOG_SUCCESS, "Compiled shader: %s", FPaths::GetFileName(FilePath).c_str());
-	}
+	glslang::GlslangToSpv(*program.getIntermediate(Shader.GetShaderType()), OutSpirv);
+	return true;
 }
@@ -3,6 +3,7 @@
 #include <string>
 #include <typeindex>
 #include <unordered_map>
+#include <vector>
 #include <glslang/Public/ShaderLang.h>
 #include "vulkan/vulkan_core.h"
 
@@ -45,6 +46,11 @@ public:
     virtual EShLanguage GetShaderType() const override { return EShLangVertex; }*/
 };
 
+// Static mesh vertices plus the FDrawList instance stream, reads FInstancedStaticVertexInput
+class FInstancedStaticVertexShader : public FShader
+{
+};
+
 class FDefaultPixelShader : public FShader
 {
 public:
@@ -68,6 +74,9 @@ public:
 
     template <typename Shader>
     std::shared_ptr<Shader> FindShader();
+    // Source to SPIR-V only, no module is created. A parse error is returned for the caller to report, link errors are logged
+    bool CompileSpirv(const FShader& Shader, std::vector<uint32_t>& OutSpirv, std::string& OutParseError) const;
+
 private:
     void Compile(std::shared_ptr<FShader>& Shader);
     
@@ -0,0 +1,98 @@
+﻿#include "StagingRing.h"
+#include <algorithm>
+
+void FStagingRing::Init(VkDeviceSize InSize, VkDeviceSize InAlignment)
+{
+    Size = InSize;
+    Alignment = InAlignment;
+    Head = 0;
+    Tail = 0;
+    bEmpty = true;
+}
+
+bool FStagingRing::Allocate(VkDeviceSize InSize, VkDeviceSize& OutOffset)
+{
+    if (IsOversized(InSize))
+    {
+        return false;
+    }
+    // Empty allocations still take space, a head that doesn't move would read as a full ring
+    const VkDeviceSize AlignedSize = (std::max<VkDeviceSize>(InSize, 1) + Alignment - 1) & ~(Alignment - 1);
+
+    if (bEmpty)
+    {
+        // Nothing is in use, starting over gives the largest piece
+        OutOffset = 0;
+    }
+    else if (Head == Tail)
+    {
+        return false;
+    }
+    else if (Head > Tail)
+    {
+        if (Head + AlignedSize <= Size)
+        {
+            OutOffset = Head;
+        }
+        else if (AlignedSize <= Tail)
+        {
+            // Wraps, the end of the ring stays unused until the tail passes it
+            OutOffset = 0;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    else if (Head + AlignedSize <= Tail)
+    {
+        OutOffset = Head;
+    }
+    else
+    {
+        return false;
+    }
+
+    if (bEmpty)
+    {
+        Tail = 0;
+        bEmpty = false;
+    }
+    Head = OutOffset + AlignedSize;
+    return true;
+}
+
+void FStagingRing::Release(VkDeviceSize End)
+{
+    Tail = End;
+    bEmpty = Tail == Head;
+}
+
+bool FStagingRing::IsOversized(VkDeviceSize InSize) const
+{
+    return InSize > Size;
+}
+
+bool FStagingRing::IsEmpty() const
+{
+    return bEmpty;
+}
+
+VkDeviceSize FStagingRing::GetHead() const
+{
+    return Head;
+}
+
+VkDeviceSize FStagingRing::GetSize() const
+{
+    return Size;
+}
+
+VkDeviceSize FStagingRing::GetUsedSize() const
+{
+    if (bEmpty)
+    {
+        return 0;
+    }
+    return Head > Tail ? Head - Tail : Size - Tail + Head;
+}
@@ -0,0 +1,32 @@
+﻿#pragma once
+#include "vulkan/vulkan_core.h"
+
+// Range bookkeeping of the FAsyncUpload staging ring. Allocations go out in submission order and come back
+// oldest first, each batch gives back everything up to the head it ended at.
+// Kept apart from the staging buffer so wrap and full cases can be tested without a device
+class FStagingRing
+{
+public:
+    // Size is a multiple of the power of two Alignment
+    void Init(VkDeviceSize InSize, VkDeviceSize InAlignment);
+    // Aligned offset of Size bytes, false when the free part of the ring can't hold them in one piece
+    bool Allocate(VkDeviceSize Size, VkDeviceSize& OutOffset);
+    // Frees everything allocated before End, the head after the last allocation of the oldest batch
+    void Release(VkDeviceSize End);
+    // Uploads bigger than the ring never fit, they need a staging buffer of their own
+    bool IsOversized(VkDeviceSize Size) const;
+
+    bool IsEmpty() const;
+    VkDeviceSize GetHead() const;
+    VkDeviceSize GetSize() const;
+    // Includes the end of the ring skipped by a wrap until the tail passes it
+    VkDeviceSize GetUsedSize() const;
+
+private:
+    VkDeviceSize Size = 0;
+    VkDeviceSize Alignment = 1;
+    VkDeviceSize Head = 0;
+    VkDeviceSize Tail = 0;
+    // Head == Tail is both the empty and the full ring
+    bool bEmpty = true;
+};
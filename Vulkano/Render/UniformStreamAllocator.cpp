@@ -0,0 +1,187 @@
+﻿#include "UniformStreamAllocator.h"
+#include "DeletionQueue.h"
+#include "VulkanInterface.h"
+#include "Core/Assertion.h"
+#include "Core/VulkanoLog.h"
+
+VkBuffer                                        FUniformStreamAllocator::Buffer = VK_NULL_HANDLE;
+VkDeviceMemory                                  FUniformStreamAllocator::BufferMemory = VK_NULL_HANDLE;
+uint8_t*                                        FUniformStreamAllocator::MappedData = nullptr;
+VkDescriptorPool                                FUniformStreamAllocator::DescriptorPool = VK_NULL_HANDLE;
+VkDescriptorSetLayout                           FUniformStreamAllocator::DescriptorSetLayout = VK_NULL_HANDLE;
+VkDescriptorSet                                 FUniformStreamAllocator::DescriptorSet = VK_NULL_HANDLE;
+FUniformStreamRegions                           FUniformStreamAllocator::Regions;
+
+void FUniformStreamAllocator::Init(uint32_t FrameSize)
+{
+    VkPhysicalDeviceProperties Properties;
+    vkGetPhysicalDeviceProperties(FVulkan::GetPhysicalDevice(), &Properties);
+    Regions.Init(FrameSize, Properties.limits);
+    const VkDeviceSize BufferSize = Regions.GetBufferSize();
+
+    VkBufferCreateInfo BufferCreateInfo{};
+    BufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    BufferCreateInfo.size = BufferSize;
+    BufferCreateInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    BufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(FVulkan::GetDevice(), &BufferCreateInfo, nullptr, &Buffer) != VK_SUCCESS)
+    {
+        fatal("FUniformStreamAllocator::Init Fail creating uniform buffer size: %i", static_cast<int>(BufferSize));
+    }
+
+    VkMemoryRequirements MemRequirements;
+    vkGetBufferMemoryRequirements(FVulkan::GetDevice(), Buffer, &MemRequirements);
+
+    VkMemoryAllocateInfo MemoryAllocateInfo{};
+    MemoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    MemoryAllocateInfo.allocationSize = MemRequirements.size;
+    MemoryAllocateInfo.memoryTypeIndex = FVulkan::FindMemoryType(FVulkan::GetPhysicalDevice(), MemRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (vkAllocateMemory(FVulkan::GetDevice(), &MemoryAllocateInfo, nullptr, &BufferMemory) != VK_SUCCESS)
+    {
+        fatal("FUniformStreamAllocator::Init Fail allocating uniform memory size: %i", static_cast<int>(BufferSize));
+    }
+    vkBindBufferMemory(FVulkan::GetDevice(), Buffer, BufferMemory, 0);
+
+    // Coherent memory stays mapped for the whole run, an allocation is just a pointer bump
+    void* Data = nullptr;
+    vkMapMemory(FVulkan::GetDevice(), BufferMemory, 0, VK_WHOLE_SIZE, 0, &Data);
+    MappedData = static_cast<uint8_t*>(Data);
+
+    VkDescriptorSetLayoutBinding Binding{};
+    Binding.binding = 0;
+    Binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    Binding.descriptorCount = 1;
+    Binding.stageFlags = VK_SHADER_STAGE_ALL;
+
+    VkDescriptorSetLayoutCreateInfo SetLayoutCreateInfo{};
+    SetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    SetLayoutCreateInfo.bindingCount = 1;
+    SetLayoutCreateInfo.pBindings = &Binding;
+    if(vkCreateDescriptorSetLayout(FVulkan::GetDevice(), &SetLayoutCreateInfo, nullptr, &DescriptorSetLayout) != VK_SUCCESS)
+    {
+        fatal("FUniformStreamAllocator::Init Fail creating uniform descriptor set layout");
+    }
+
+    VkDescriptorPoolSize PoolSize{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1};
+    VkDescriptorPoolCreateInfo PoolCreateInfo{};
+    PoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    PoolCreateInfo.maxSets = 1;
+    PoolCreateInfo.poolSizeCount = 1;
+    PoolCreateInfo.pPoolSizes = &PoolSize;
+    if(vkCreateDescriptorPool(FVulkan::GetDevice(), &PoolCreateInfo, nullptr, &DescriptorPool) != VK_SUCCESS)
+    {
+        fatal("FUniformStreamAllocator::Init Fail creating uniform descriptor pool");
+    }
+
+    VkDescriptorSetAllocateInfo AllocateInfo{};
+    AllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    AllocateInfo.descriptorPool = DescriptorPool;
+    AllocateInfo.descriptorSetCount = 1;
+    AllocateInfo.pSetLayouts = &DescriptorSetLayout;
+    if(vkAllocateDescriptorSets(FVulkan::GetDevice(), &AllocateInfo, &DescriptorSet) != VK_SUCCESS)
+    {
+        fatal("FUniformStreamAllocator::Init Fail allocating uniform descriptor set");
+    }
+
+    VkDescriptorBufferInfo BufferInfo{Buffer, 0, Regions.GetMaxAllocationSize()};
+    VkWriteDescriptorSet Write{};
+    Write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    Write.dstSet = DescriptorSet;
+    Write.dstBinding = 0;
+    Write.descriptorCount = 1;
+    Write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    Write.pBufferInfo = &BufferInfo;
+    vkUpdateDescriptorSets(FVulkan::GetDevice(), 1, &Write, 0, nullptr);
+
+    VK_LOG(LOG_INFO, "Uniform stream allocator created, frame size: %i, alignment: %i", Regions.GetFrameSize(), Regions.GetAlignment());
+}
+
+void FUniformStreamAllocator::Release()
+{
+    if(BufferMemory != VK_NULL_HANDLE)
+    {
+        vkUnmapMemory(FVulkan::GetDevice(), BufferMemory);
+        MappedData = nullptr;
+    }
+
+    FDeletionQueue::Enqueue(EDeferredResourceType::Buffer, Buffer);
+    FDeletionQueue::Enqueue(EDeferredResourceType::Memory, BufferMemory);
+    FDeletionQueue::Enqueue(EDeferredResourceType::DescriptorPool, DescriptorPool);
+    FDeletionQueue::Enqueue(EDeferredResourceType::DescriptorSetLayout, DescriptorSetLayout);
+    Buffer = VK_NULL_HANDLE;
+    BufferMemory = VK_NULL_HANDLE;
+    DescriptorPool = VK_NULL_HANDLE;
+    DescriptorSetLayout = VK_NULL_HANDLE;
+    DescriptorSet = VK_NULL_HANDLE;
+}
+
+void FUniformStreamAllocator::BeginFrame(uint64_t RetireValue)
+{
+    FVulkan::GetQueue(EQueueType::Graphics).Wait(Regions.BeginFrame(RetireValue));
+}
+
+FUniformAllocation FUniformStreamAllocator::Allocate(uint32_t Size)
+{
+    checkf(Size <= Regions.GetMaxAllocationSize(), "FUniformStreamAllocator::Allocate Allocation of %i bytes is bigger than the uniform range %i", Size, Regions.GetMaxAllocationSize());
+    return AllocateFromRegion(Size);
+}
+
+FUniformAllocation FUniformStreamAllocator::AllocateVertices(uint32_t Size)
+{
+    return AllocateFromRegion(Size);
+}
+
+FUniformAllocation FUniformStreamAllocator::AllocateStaging(uint32_t Size)
+{
+    return AllocateFromRegion(Size);
+}
+
+FUniformAllocation FUniformStreamAllocator::AllocateFromRegion(uint32_t Size)
+{
+    uint32_t Offset = 0;
+    if(!Regions.Allocate(Size, Offset))
+    {
+        fatal("FUniformStreamAllocator::Allocate Out of uniform memory for this frame, used: %i", GetFrameUsedSize());
+    }
+
+    FUniformAllocation Allocation;
+    Allocation.Data = MappedData + Offset;
+    Allocation.Offset = Offset;
+    Allocation.Size = Size;
+    return Allocation;
+}
+
+void FUniformStreamAllocator::Bind(VkCommandBuffer CommandBuffer, VkPipelineBindPoint BindPoint, VkPipelineLayout Layout, uint32_t SetIndex, const FUniformAllocation& Allocation)
+{
+    vkCmdBindDescriptorSets(CommandBuffer, BindPoint, Layout, SetIndex, 1, &DescriptorSet, 1, &Allocation.Offset);
+}
+
+uint32_t FUniformStreamAllocator::AlignOffset(uint32_t Offset, uint32_t InAlignment)
+{
+    return FUniformStreamRegions::AlignOffset(Offset, InAlignment);
+}
+
+VkBuffer FUniformStreamAllocator::GetBuffer()
+{
+    return Buffer;
+}
+
+const VkDescriptorSetLayout& FUniformStreamAllocator::GetDescriptorSetLayout()
+{
+    return DescriptorSetLayout;
+}
+
+uint32_t FUniformStreamAllocator::GetAlignment()
+{
+    return Regions.GetAlignment();
+}
+
+uint32_t FUniformStreamAllocator::GetMaxAllocationSize()
+{
+    return Regions.GetMaxAllocationSize();
+}
+
+uint32_t FUniformStreamAllocator::GetFrameUsedSize()
+{
+    return Regions.GetFrameUsedSize();
+}
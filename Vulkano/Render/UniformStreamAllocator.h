@@ -0,0 +1,59 @@
+﻿#pragma once
+#include <cstdint>
+#include "UniformStreamRegions.h"
+#include "vulkan/vulkan_core.h"
+
+struct FUniformAllocation
+{
+    void* Data = nullptr;
+    uint32_t Offset = 0;
+    uint32_t Size = 0;
+
+    bool IsValid() const { return Data != nullptr; }
+};
+
+// Persistently mapped linear allocator for per-draw uniforms, one region per frame in flight.
+// Every allocation is read through the same dynamic uniform descriptor, only the dynamic offset changes.
+// The buffer is also a vertex buffer so per-instance streams come from the same regions,
+// and a transfer source for per-frame uploads.
+class FUniformStreamAllocator
+{
+public:
+    enum
+    {
+        FramesInFlight = FUniformStreamRegions::FramesInFlight,
+        DefaultFrameSize = 16 * 1024 * 1024
+    };
+
+    static void Init(uint32_t FrameSize = DefaultFrameSize);
+    static void Release();
+
+    // Recycles the region used FramesInFlight frames ago, waits if the GPU is still reading it
+    static void BeginFrame(uint64_t RetireValue);
+    static FUniformAllocation Allocate(uint32_t Size);
+    // Vertex stream data, not limited by the uniform descriptor range
+    static FUniformAllocation AllocateVertices(uint32_t Size);
+    // Source of buffer to image copies recorded this frame
+    static FUniformAllocation AllocateStaging(uint32_t Size);
+    static void Bind(VkCommandBuffer CommandBuffer, VkPipelineBindPoint BindPoint, VkPipelineLayout Layout, uint32_t SetIndex, const FUniformAllocation& Allocation);
+
+    static uint32_t AlignOffset(uint32_t Offset, uint32_t Alignment);
+    static VkBuffer GetBuffer();
+    static const VkDescriptorSetLayout& GetDescriptorSetLayout();
+    static uint32_t GetAlignment();
+    static uint32_t GetMaxAllocationSize();
+    static uint32_t GetFrameUsedSize();
+
+private:
+    static FUniformAllocation AllocateFromRegion(uint32_t Size);
+
+private:
+    static VkBuffer Buffer;
+    static VkDeviceMemory BufferMemory;
+    static uint8_t* MappedData;
+    static VkDescriptorPool DescriptorPool;
+    static VkDescriptorSetLayout DescriptorSetLayout;
+    static VkDescriptorSet DescriptorSet;
+
+    static FUniformStreamRegions Regions;
+};
@@ -0,0 +1,74 @@
+﻿#include "UniformStreamRegions.h"
+#include <algorithm>
+
+void FUniformStreamRegions::Init(uint32_t FrameSize, const VkPhysicalDeviceLimits& Limits)
+{
+    Alignment = std::max(static_cast<uint32_t>(Limits.minUniformBufferOffsetAlignment), 16u);
+
+    // The descriptor range is fixed, dynamic offset + range has to stay inside the buffer
+    MaxAllocationSize = std::min(Limits.maxUniformBufferRange, 65536u);
+    FrameSize = AlignOffset(std::max(FrameSize, MaxAllocationSize), Alignment);
+
+    for (uint32_t i = 0; i < FramesInFlight; ++i)
+    {
+        Regions[i].Begin = FrameSize * i;
+        Regions[i].End = FrameSize * (i + 1);
+        Regions[i].RetireValue = 0;
+    }
+    CurrentRegion = 0;
+    Head = 0;
+}
+
+uint64_t FUniformStreamRegions::BeginFrame(uint64_t RetireValue)
+{
+    CurrentRegion = (CurrentRegion + 1) % FramesInFlight;
+    FFrameRegion& Region = Regions[CurrentRegion];
+    const uint64_t PreviousRetireValue = Region.RetireValue;
+    Region.RetireValue = RetireValue;
+    Head = Region.Begin;
+    return PreviousRetireValue;
+}
+
+bool FUniformStreamRegions::Allocate(uint32_t Size, uint32_t& OutOffset)
+{
+    const uint32_t Offset = AlignOffset(Head, Alignment);
+    // 64 bit so a huge Size can't wrap around the end check
+    if (static_cast<uint64_t>(Offset) + Size > Regions[CurrentRegion].End)
+    {
+        return false;
+    }
+    Head = Offset + Size;
+    OutOffset = Offset;
+    return true;
+}
+
+uint32_t FUniformStreamRegions::AlignOffset(uint32_t Offset, uint32_t InAlignment)
+{
+    // Vulkan guarantees power of two offset alignments
+    return (Offset + InAlignment - 1) & ~(InAlignment - 1);
+}
+
+uint32_t FUniformStreamRegions::GetAlignment() const
+{
+    return Alignment;
+}
+
+uint32_t FUniformStreamRegions::GetMaxAllocationSize() const
+{
+    return MaxAllocationSize;
+}
+
+uint32_t FUniformStreamRegions::GetFrameSize() const
+{
+    return Regions[0].End - Regions[0].Begin;
+}
+
+VkDeviceSize FUniformStreamRegions::GetBufferSize() const
+{
+    return static_cast<VkDeviceSize>(Regions[FramesInFlight - 1].End) + MaxAllocationSize;
+}
+
+uint32_t FUniformStreamRegions::GetFrameUsedSize() const
+{
+    return Head - Regions[CurrentRegion].Begin;
+}
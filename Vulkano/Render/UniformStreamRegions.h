@@ -0,0 +1,43 @@
+﻿#pragma once
+#include <cstdint>
+#include "vulkan/vulkan_core.h"
+
+// Offset bookkeeping of FUniformStreamAllocator, one linear region per frame in flight.
+// Kept apart from the buffer and its descriptor so the offsets can be tested without a device
+class FUniformStreamRegions
+{
+public:
+    enum
+    {
+        FramesInFlight = 3
+    };
+
+    // FrameSize is rounded up to the alignment and to at least one descriptor range
+    void Init(uint32_t FrameSize, const VkPhysicalDeviceLimits& Limits);
+    // Switches to the next region and returns the value its previous frame retires with, wait for it before writing
+    uint64_t BeginFrame(uint64_t RetireValue);
+    // Aligned offset of Size bytes in the current region, false when the region is full
+    bool Allocate(uint32_t Size, uint32_t& OutOffset);
+
+    static uint32_t AlignOffset(uint32_t Offset, uint32_t Alignment);
+    uint32_t GetAlignment() const;
+    uint32_t GetMaxAllocationSize() const;
+    uint32_t GetFrameSize() const;
+    // The regions plus one descriptor range, a dynamic offset + range has to stay inside the buffer
+    VkDeviceSize GetBufferSize() const;
+    uint32_t GetFrameUsedSize() const;
+
+private:
+    struct FFrameRegion
+    {
+        uint32_t Begin = 0;
+        uint32_t End = 0;
+        uint64_t RetireValue = 0;
+    };
+
+    FFrameRegion Regions[FramesInFlight];
+    uint32_t CurrentRegion = 0;
+    uint32_t Head = 0;
+    uint32_t Alignment = 256;
+    uint32_t MaxAllocationSize = 0;
+};
@@ -1,5 +1,7 @@
 ﻿#include "VertexInputs.h"
 
+#include <cstddef>
+#include "AsyncUpload.h"
 #include "RenderResources.h"
 #include "VulkanInterface.h"
 
@@ -20,17 +22,29 @@ void FVertexInput::InitVertexInput(uint32_t Binding)
     // If components make an actual vertex input, otherwise just pass an empty declaration
     if(!Components.empty())
     {
-        PipelineVertexInputStateCreateInfo.vertexBindingDescriptionCount = 1;
-        PipelineVertexInputStateCreateInfo.pVertexBindingDescriptions = &VertexInputBindingDescription;
+        BindingDescriptions.insert(BindingDescriptions.begin(), VertexInputBindingDescription);
+        PipelineVertexInputStateCreateInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(BindingDescriptions.size());
+        PipelineVertexInputStateCreateInfo.pVertexBindingDescriptions = BindingDescriptions.data();
         PipelineVertexInputStateCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(Components.size());
         PipelineVertexInputStateCreateInfo.pVertexAttributeDescriptions = Components.data();
     }
 }
 
+void FVertexInput::AddInstanceComponents(uint32_t Binding, uint32_t FirstLocation)
+{
+    for (uint32_t Column = 0; Column < 4; ++Column)
+    {
+        Components.push_back({FirstLocation + Column, Binding, VK_FORMAT_R32G32B32A32_SFLOAT, static_cast<uint32_t>(offsetof(FInstanceData, WorldMatrix) + sizeof(glm::vec4) * Column)});
+    }
+    Components.push_back({FirstLocation + 4, Binding, VK_FORMAT_R32_UINT, offsetof(FInstanceData, MaterialIndex)});
+    BindingDescriptions.push_back({Binding, sizeof(FInstanceData), VK_VERTEX_INPUT_RATE_INSTANCE});
+}
+
 namespace VKGlobals
 {
     std::shared_ptr<FSimpleVertexInput> GSimpleVertexInput = nullptr;
     std::shared_ptr<FStaticVertexInput> GStaticMeshVertexInput = nullptr;
+    std::shared_ptr<FInstancedStaticVertexInput> GInstancedStaticMeshVertexInput = nullptr;
     std::shared_ptr<FVulkanBuffer> GQuadVertexBuffer = nullptr;
     
     void InitGlobalResources()
@@ -40,6 +54,9 @@ namespace VKGlobals
         
         GStaticMeshVertexInput = std::make_unique<FStaticVertexInput>();
         GStaticMeshVertexInput->InitVertexInput(0);
+
+        GInstancedStaticMeshVertexInput = std::make_unique<FInstancedStaticVertexInput>();
+        GInstancedStaticMeshVertexInput->InitVertexInput(0);
         
         std::vector<FSimpleVertex> Vertices = {
             {{-1.0f, -1.0f}, {0.0f, 0.0f}},  // Bottom-left
@@ -51,20 +68,24 @@ namespace VKGlobals
             {{-1.0f, 1.0f}, {0.0f, 1.0f}}    // Top-left
         };
 
+        // Device local, the upload is acquired by the first graphics command buffer before anything draws it
         VkDeviceSize ByteSize = sizeof(FSimpleVertex) * Vertices.size();
         GQuadVertexBuffer = FVulkan::CreateBuffer(
             ByteSize,
             static_cast<uint32_t>(Vertices.size()),
-            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
             "SimpleQuadBuffer");
-        FVulkan::UpdateBuffer(GQuadVertexBuffer, Vertices.data(), ByteSize);
+        const uint8_t* VertexBytes = reinterpret_cast<const uint8_t*>(Vertices.data());
+        FAsyncUpload::UploadBuffer(GQuadVertexBuffer, std::vector<uint8_t>(VertexBytes, VertexBytes + ByteSize));
+        FAsyncUpload::Flush();
     }
 
     void CleanupGlobalResources()
     {
         GSimpleVertexInput.reset();
         GStaticMeshVertexInput.reset();
+        GInstancedStaticMeshVertexInput.reset();
         GQuadVertexBuffer->Release();
         GQuadVertexBuffer.reset();
     }
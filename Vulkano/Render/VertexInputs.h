@@ -21,6 +21,14 @@ public:
     glm::vec3 Color = glm::vec3(0);
 };
 
+// Per-instance stream of automatically instanced draws
+struct FInstanceData
+{
+    glm::mat4 WorldMatrix = glm::mat4(1.0f);
+    uint32_t MaterialIndex = 0;
+    uint32_t Padding[3] = {};
+};
+
 class FVertexInput
 {
 public:
@@ -31,7 +39,11 @@ public:
     VkVertexInputBindingDescription VertexInputBindingDescription;
 
 protected:
+    // FInstanceData at VK_VERTEX_INPUT_RATE_INSTANCE, the world matrix takes four locations then the material index
+    void AddInstanceComponents(uint32_t Binding, uint32_t FirstLocation);
+    
     std::vector<VkVertexInputAttributeDescription> Components;
+    std::vector<VkVertexInputBindingDescription> BindingDescriptions;
 };
 
 class FSimpleVertexInput : public FVertexInput
@@ -60,10 +72,22 @@ public:
     }
 };
 
+// Static mesh vertices on the given binding, FInstanceData on the next one
+class FInstancedStaticVertexInput : public FStaticVertexInput
+{
+public:
+    virtual void InitVertexInput(uint32_t Binding) override
+    {
+        AddInstanceComponents(Binding + 1, 4);
+        FStaticVertexInput::InitVertexInput(Binding);
+    }
+};
+
 namespace VKGlobals
 {
     extern std::shared_ptr<FSimpleVertexInput> GSimpleVertexInput;
     extern std::shared_ptr<FStaticVertexInput> GStaticMeshVertexInput;
+    extern std::shared_ptr<FInstancedStaticVertexInput> GInstancedStaticMeshVertexInput;
     extern std::shared_ptr<FVulkanBuffer> GQuadVertexBuffer;
 
     void InitGlobalResources();
@@ -0,0 +1,314 @@
+﻿#include "VirtualTexturing.h"
+
+#include <algorithm>
+#include <cstring>
+#include "BindlessHeap.h"
+#include "DeletionQueue.h"
+#include "VulkanInterface.h"
+#include "Core/Assertion.h"
+#include "Core/VulkanoLog.h"
+
+void FVirtualTextureRenderer::Init(const FVirtualTextureSettings& Settings, const FVirtualTextureStreamer::FPageLoader& Loader, uint32_t ViewWidth, uint32_t ViewHeight, uint32_t InFeedbackScale)
+{
+    System.Init(Settings, Loader);
+
+    const uint32_t SlotTexels = System.GetSlotTexels();
+    Atlas = FVulkan::CreateTexture(FTextureDesc::Create2D(
+        Settings.AtlasPagesX * SlotTexels,
+        Settings.AtlasPagesY * SlotTexels,
+        VK_FORMAT_R8G8B8A8_SRGB,
+        VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        "VirtualTextureAtlas"));
+
+    // Pages carry their own border, bilinear filtering never reads a neighbour slot
+    VkSamplerCreateInfo SamplerCreateInfo{};
+    SamplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    SamplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+    SamplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+    SamplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    SamplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    SamplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    SamplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    SamplerCreateInfo.maxLod = 0.0f;
+    if (vkCreateSampler(FVulkan::GetDevice(), &SamplerCreateInfo, nullptr, &AtlasSampler) != VK_SUCCESS)
+    {
+        fatal("FVirtualTextureRenderer::Init Fail creating atlas sampler");
+    }
+    AtlasSamplerIndex = FBindlessHeap::RegisterSampler(AtlasSampler);
+
+    FeedbackScale = std::max(1u, InFeedbackScale);
+    FeedbackWidth = std::max(1u, (ViewWidth + FeedbackScale - 1) / FeedbackScale);
+    FeedbackHeight = std::max(1u, (ViewHeight + FeedbackScale - 1) / FeedbackScale);
+    const VkDeviceSize FeedbackSize = static_cast<VkDeviceSize>(FeedbackWidth) * FeedbackHeight * sizeof(uint32_t);
+    for (FFeedbackBuffer& Feedback : FeedbackBuffers)
+    {
+        Feedback.Buffer = FVulkan::CreateBuffer(
+            FeedbackSize,
+            FeedbackWidth * FeedbackHeight,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            "VirtualTextureFeedback");
+        void* MappedData = nullptr;
+        vkMapMemory(FVulkan::GetDevice(), Feedback.Buffer->BufferMemory, 0, FeedbackSize, 0, &MappedData);
+        Feedback.MappedData = static_cast<const uint32_t*>(MappedData);
+        Feedback.SubmitValue = 0;
+        FVulkan::MakeBindless(Feedback.Buffer);
+    }
+
+    VK_LOG(LOG_INFO, "Virtual texturing atlas %ux%u slots of %u texels, feedback %ux%u", Settings.AtlasPagesX, Settings.AtlasPagesY, SlotTexels, FeedbackWidth, FeedbackHeight);
+}
+
+void FVirtualTextureRenderer::Release()
+{
+    System.Shutdown();
+    for (FPageTableTexture& PageTable : PageTables)
+    {
+        FVulkan::ReleaseTexture(PageTable.Texture);
+    }
+    PageTables.clear();
+    for (FFeedbackBuffer& Feedback : FeedbackBuffers)
+    {
+        if (Feedback.Buffer)
+        {
+            Feedback.Buffer->Release();
+            Feedback.Buffer.reset();
+        }
+        Feedback.MappedData = nullptr;
+        Feedback.SubmitValue = 0;
+    }
+    if (AtlasSamplerIndex != UINT32_MAX)
+    {
+        FBindlessHeap::Unregister(EBindlessType::Sampler, AtlasSamplerIndex);
+        AtlasSamplerIndex = UINT32_MAX;
+    }
+    FDeletionQueue::Enqueue(EDeferredResourceType::Sampler, AtlasSampler);
+    AtlasSampler = VK_NULL_HANDLE;
+    FVulkan::ReleaseTexture(Atlas);
+    bAtlasInitialized = false;
+}
+
+uint32_t FVirtualTextureRenderer::CreateVirtualTexture(uint32_t Width, uint32_t Height)
+{
+    const uint32_t TextureId = System.CreateVirtualTexture(Width, Height);
+    const FVirtualPageTable& PageTable = System.GetPageTable(TextureId);
+
+    FTextureDesc Desc = FTextureDesc::Create2D(
+        PageTable.GetPagesX(0),
+        PageTable.GetPagesY(0),
+        VK_FORMAT_R32_UINT,
+        VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        "VirtualTexturePageTable");
+    Desc.MipLevels = PageTable.GetMipLevels();
+
+    if (TextureId >= PageTables.size())
+    {
+        PageTables.resize(TextureId + 1);
+    }
+    PageTables[TextureId].Texture = FVulkan::CreateTexture(Desc);
+    PageTables[TextureId].bInitialized = false;
+    FVulkan::MakeBindless(PageTables[TextureId].Texture);
+    return TextureId;
+}
+
+void FVirtualTextureRenderer::DestroyVirtualTexture(uint32_t TextureId)
+{
+    System.DestroyVirtualTexture(TextureId);
+    FVulkan::ReleaseTexture(PageTables[TextureId].Texture);
+    PageTables[TextureId].bInitialized = false;
+}
+
+void FVirtualTextureRenderer::BeginFrame()
+{
+    ReadFeedback();
+
+    System.Update(Uploads);
+    UploadPages(Uploads);
+    UploadPageTables();
+
+    // Buffers still in flight are skipped, this frame then writes no feedback instead of waiting
+    CurrentFeedback = (CurrentFeedback + 1) % FeedbackBufferNum;
+    FFeedbackBuffer& Feedback = FeedbackBuffers[CurrentFeedback];
+    bFeedbackActive = Feedback.SubmitValue == 0;
+    if (!bFeedbackActive)
+    {
+        return;
+    }
+
+    VkCommandBuffer CommandBuffer = FVulkan::GetGraphicsBuffer();
+    vkCmdFillBuffer(CommandBuffer, Feedback.Buffer->Buffer, 0, VK_WHOLE_SIZE, FVirtualPageId::Invalid);
+
+    VkBufferMemoryBarrier Barrier{};
+    Barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    Barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    Barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    Barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    Barrier.buffer = Feedback.Buffer->Buffer;
+    Barrier.offset = 0;
+    Barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 1, &Barrier, 0, nullptr);
+}
+
+void FVirtualTextureRenderer::EndFrame()
+{
+    if (!bFeedbackActive)
+    {
+        return;
+    }
+
+    FFeedbackBuffer& Feedback = FeedbackBuffers[CurrentFeedback];
+    VkBufferMemoryBarrier Barrier{};
+    Barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    Barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    Barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    Barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    Barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    Barrier.buffer = Feedback.Buffer->Buffer;
+    Barrier.offset = 0;
+    Barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(FVulkan::GetGraphicsBuffer(), VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &Barrier, 0, nullptr);
+
+    Feedback.SubmitValue = FVulkan::GetQueue(EQueueType::Graphics).GetNextValue();
+    bFeedbackActive = false;
+}
+
+FVirtualTextureShaderParams FVirtualTextureRenderer::GetShaderParams(uint32_t TextureId) const
+{
+    check(System.IsValidTexture(TextureId));
+    const FVirtualTextureSettings& Settings = System.GetSettings();
+    const FVirtualPageTable& PageTable = System.GetPageTable(TextureId);
+
+    FVirtualTextureShaderParams Params;
+    Params.AtlasIndex = Atlas->BindlessIndex;
+    Params.PageTableIndex = PageTables[TextureId].Texture->BindlessIndex;
+    Params.SamplerIndex = AtlasSamplerIndex;
+    Params.FeedbackIndex = bFeedbackActive ? FeedbackBuffers[CurrentFeedback].Buffer->BindlessIndex : UINT32_MAX;
+    Params.TextureId = TextureId;
+    Params.PagesX = PageTable.GetPagesX(0);
+    Params.PagesY = PageTable.GetPagesY(0);
+    Params.MipLevels = PageTable.GetMipLevels();
+    Params.AtlasPagesX = Settings.AtlasPagesX;
+    Params.AtlasPagesY = Settings.AtlasPagesY;
+    Params.PageSize = Settings.PageSize;
+    Params.BorderSize = Settings.BorderSize;
+    Params.FeedbackWidth = FeedbackWidth;
+    Params.FeedbackHeight = FeedbackHeight;
+    Params.FeedbackScale = FeedbackScale;
+    return Params;
+}
+
+FVirtualTextureSystem& FVirtualTextureRenderer::GetSystem()
+{
+    return System;
+}
+
+void FVirtualTextureRenderer::ReadFeedback()
+{
+    // Oldest submission first so requests keep their frame order
+    const FVulkanQueue& GraphicsQueue = FVulkan::GetQueue(EQueueType::Graphics);
+    for (uint32_t Offset = 1; Offset <= FeedbackBufferNum; ++Offset)
+    {
+        FFeedbackBuffer& Feedback = FeedbackBuffers[(CurrentFeedback + Offset) % FeedbackBufferNum];
+        if (Feedback.SubmitValue != 0 && GraphicsQueue.IsComplete(Feedback.SubmitValue))
+        {
+            System.ProcessFeedback(Feedback.MappedData, static_cast<size_t>(FeedbackWidth) * FeedbackHeight);
+            Feedback.SubmitValue = 0;
+        }
+    }
+}
+
+void FVirtualTextureRenderer::UploadPages(std::vector<FVirtualPageUpload>& PageUploads)
+{
+    if (PageUploads.empty())
+    {
+        return;
+    }
+
+    const FVirtualTextureSettings& Settings = System.GetSettings();
+    const uint32_t SlotTexels = System.GetSlotTexels();
+    const uint32_t PageBytes = System.GetPageBytes();
+    FUniformAllocation Staging = FVulkan::AllocateStaging(PageBytes * static_cast<uint32_t>(PageUploads.size()));
+
+    std::vector<VkBufferImageCopy> Regions;
+    Regions.reserve(PageUploads.size());
+    for (size_t Index = 0; Index < PageUploads.size(); ++Index)
+    {
+        const FVirtualPageUpload& Upload = PageUploads[Index];
+        memcpy(static_cast<uint8_t*>(Staging.Data) + Index * PageBytes, Upload.Pixels.data(), PageBytes);
+
+        VkBufferImageCopy& Region = Regions.emplace_back();
+        Region = {};
+        Region.bufferOffset = Index * PageBytes;
+        Region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        Region.imageSubresource.layerCount = 1;
+        Region.imageOffset = {static_cast<int32_t>(Upload.Slot % Settings.AtlasPagesX * SlotTexels), static_cast<int32_t>(Upload.Slot / Settings.AtlasPagesX * SlotTexels), 0};
+        Region.imageExtent = {SlotTexels, SlotTexels, 1};
+    }
+
+    FVulkan::CopyStagingToTexture(Staging, Atlas, Regions, bAtlasInitialized ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    bAtlasInitialized = true;
+}
+
+void FVirtualTextureRenderer::UploadPageTables()
+{
+    std::vector<VkBufferImageCopy> Regions;
+    for (uint32_t TextureId = 0; TextureId < PageTables.size(); ++TextureId)
+    {
+        if (!System.IsValidTexture(TextureId))
+        {
+            continue;
+        }
+
+        // Only the dirty rectangle of each mip goes up, packed tightly in the staging memory
+        FVirtualPageTable& PageTable = System.GetPageTable(TextureId);
+        uint32_t StagingSize = 0;
+        for (uint32_t Mip = 0; Mip < PageTable.GetMipLevels(); ++Mip)
+        {
+            const FVirtualPageTable::FDirtyRect& Dirty = PageTable.GetDirtyRect(Mip);
+            if (!Dirty.IsEmpty())
+            {
+                StagingSize += (Dirty.MaxX - Dirty.MinX + 1) * (Dirty.MaxY - Dirty.MinY + 1) * sizeof(uint32_t);
+            }
+        }
+        if (StagingSize == 0)
+        {
+            continue;
+        }
+
+        FUniformAllocation Staging = FVulkan::AllocateStaging(StagingSize);
+        uint32_t* StagingData = static_cast<uint32_t*>(Staging.Data);
+        uint32_t StagingOffset = 0;
+        Regions.clear();
+        for (uint32_t Mip = 0; Mip < PageTable.GetMipLevels(); ++Mip)
+        {
+            const FVirtualPageTable::FDirtyRect& Dirty = PageTable.GetDirtyRect(Mip);
+            if (Dirty.IsEmpty())
+            {
+                continue;
+            }
+
+            const uint32_t Width = Dirty.MaxX - Dirty.MinX + 1;
+            const uint32_t Height = Dirty.MaxY - Dirty.MinY + 1;
+            const std::vector<uint32_t>& Level = PageTable.GetLevel(Mip);
+            for (uint32_t Y = 0; Y < Height; ++Y)
+            {
+                memcpy(StagingData + StagingOffset / sizeof(uint32_t) + Y * Width, &Level[static_cast<size_t>(Dirty.MinY + Y) * PageTable.GetPagesX(Mip) + Dirty.MinX], Width * sizeof(uint32_t));
+            }
+
+            VkBufferImageCopy& Region = Regions.emplace_back();
+            Region = {};
+            Region.bufferOffset = StagingOffset;
+            Region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            Region.imageSubresource.mipLevel = Mip;
+            Region.imageSubresource.layerCount = 1;
+            Region.imageOffset = {static_cast<int32_t>(Dirty.MinX), static_cast<int32_t>(Dirty.MinY), 0};
+            Region.imageExtent = {Width, Height, 1};
+            StagingOffset += Width * Height * sizeof(uint32_t);
+        }
+
+        FPageTableTexture& PageTableTexture = PageTables[TextureId];
+        FVulkan::CopyStagingToTexture(Staging, PageTableTexture.Texture, Regions, PageTableTexture.bInitialized ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        PageTableTexture.bInitialized = true;
+        PageTable.ClearDirty();
+    }
+}
@@ -0,0 +1,94 @@
+﻿#pragma once
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "RenderResources.h"
+#include "Engine/VirtualTexture.h"
+#include "vulkan/vulkan_core.h"
+
+// Push constant block read by Shaders/HLSL/VirtualTexture/VirtualTexture.hlsl, keep both in sync
+struct FVirtualTextureShaderParams
+{
+    uint32_t AtlasIndex = UINT32_MAX;
+    uint32_t PageTableIndex = UINT32_MAX;
+    uint32_t SamplerIndex = UINT32_MAX;
+    // UINT32_MAX when this frame writes no feedback
+    uint32_t FeedbackIndex = UINT32_MAX;
+    uint32_t TextureId = 0;
+    uint32_t PagesX = 0;
+    uint32_t PagesY = 0;
+    uint32_t MipLevels = 0;
+    uint32_t AtlasPagesX = 0;
+    uint32_t AtlasPagesY = 0;
+    uint32_t PageSize = 0;
+    uint32_t BorderSize = 0;
+    uint32_t FeedbackWidth = 0;
+    uint32_t FeedbackHeight = 0;
+    // Screen pixels per feedback entry on each axis
+    uint32_t FeedbackScale = 1;
+    uint32_t Padding = 0;
+};
+
+// GPU side of FVirtualTextureSystem: the page atlas, one R32_UINT page table texture per virtual texture
+// and the feedback buffers the material passes write page requests into.
+// Feedback is read back FeedbackBufferNum frames later without waiting on the GPU.
+class FVirtualTextureRenderer
+{
+public:
+    enum
+    {
+        FeedbackBufferNum = 3
+    };
+
+    // Feedback is written at ViewWidth / FeedbackScale x ViewHeight / FeedbackScale
+    void Init(const FVirtualTextureSettings& Settings, const FVirtualTextureStreamer::FPageLoader& Loader, uint32_t ViewWidth, uint32_t ViewHeight, uint32_t FeedbackScale = 8);
+    void Release();
+
+    // Width and Height should be multiples of the page size, sampling assumes page aligned mips
+    uint32_t CreateVirtualTexture(uint32_t Width, uint32_t Height);
+    void DestroyVirtualTexture(uint32_t TextureId);
+
+    // Reads back finished feedback, records page and page table uploads and clears this frame's feedback buffer.
+    // Call on the graphics command buffer before any pass that samples virtual textures.
+    void BeginFrame();
+    // Makes the feedback writes visible to the host, call before the graphics command buffer is submitted
+    void EndFrame();
+
+    FVirtualTextureShaderParams GetShaderParams(uint32_t TextureId) const;
+    FVirtualTextureSystem& GetSystem();
+
+private:
+    void ReadFeedback();
+    void UploadPages(std::vector<FVirtualPageUpload>& Uploads);
+    void UploadPageTables();
+
+private:
+    struct FFeedbackBuffer
+    {
+        std::shared_ptr<FVulkanBuffer> Buffer;
+        const uint32_t* MappedData = nullptr;
+        // Graphics timeline value of the submission that wrote it, 0 when nothing is pending
+        uint64_t SubmitValue = 0;
+    };
+
+    struct FPageTableTexture
+    {
+        std::shared_ptr<FVulkanTexture> Texture;
+        bool bInitialized = false;
+    };
+
+    FVirtualTextureSystem System;
+    std::shared_ptr<FVulkanTexture> Atlas;
+    VkSampler AtlasSampler = VK_NULL_HANDLE;
+    uint32_t AtlasSamplerIndex = UINT32_MAX;
+    bool bAtlasInitialized = false;
+    std::vector<FPageTableTexture> PageTables;
+    std::array<FFeedbackBuffer, FeedbackBufferNum> FeedbackBuffers;
+    uint32_t CurrentFeedback = 0;
+    bool bFeedbackActive = false;
+    uint32_t FeedbackWidth = 0;
+    uint32_t FeedbackHeight = 0;
+    uint32_t FeedbackScale = 1;
+    std::vector<FVirtualPageUpload> Uploads;
+};
@@ -2,16 +2,25 @@
 
 #include <set>
 #include <sstream>
+#include <tuple>
 #include <vector>
-#include <vulkan/vulkan_win32.h>
 
+#include "AsyncUpload.h"
+#include "BindlessHeap.h"
+#include "DeletionQueue.h"
+#include "DeviceSelection.h"
+#include "GpuProfiler.h"
+#include "GpuReadback.h"
+#include "RenderWindow.h"
 #include "Shader.h"
+#include "UniformStreamAllocator.h"
 #include "VertexInputs.h"
 #include "Core/Assertion.h"
 #include "Core/VulkanoLog.h"
 
-std::map<std::uint32_t, FRenderPass*>         FVulkan::RenderPasses;
-std::map<std::uint32_t, FGraphicsPipeline*>   FVulkan::PSOs;
+std::map<std::uint32_t, FRenderPass*>               FVulkan::RenderPasses;
+std::map<FGraphicsPipelineKey, FGraphicsPipeline*>  FVulkan::PSOs;
+std::map<std::uint32_t, FComputePipeline*>          FVulkan::ComputePSOs;
 
 
 VkInstance          FVulkan::Instance = { VK_NULL_HANDLE };
@@ -20,17 +29,44 @@ VkPhysicalDevice    FVulkan::PhysicalDevice = { VK_NULL_HANDLE };
 uint32_t            FVulkan::GraphicsIndex = UINT32_MAX;
 uint32_t            FVulkan::PresentIndex = UINT32_MAX;
 uint32_t            FVulkan::ComputeIndex = UINT32_MAX;
+uint32_t            FVulkan::TransferIndex = UINT32_MAX;
 VkQueue             FVulkan::GraphicsQueue = VK_NULL_HANDLE;
 VkQueue             FVulkan::PresentQueue = VK_NULL_HANDLE;
 VkQueue             FVulkan::ComputeQueue = VK_NULL_HANDLE;
+VkQueue             FVulkan::TransferQueue = VK_NULL_HANDLE;
 uint32_t            FVulkan::MajorVersion = UINT32_MAX;
 uint32_t            FVulkan::MinorVersion = UINT32_MAX;
+uint64_t            FVulkan::FrameNumber = 1;
+FVulkanQueue        FVulkan::Queues[static_cast<uint32_t>(EQueueType::Num)];
 VkCommandPool       FVulkan::GraphicsCommandPool = VK_NULL_HANDLE;
 VkCommandBuffer     FVulkan::GraphicsCommandBuffer = VK_NULL_HANDLE;
+uint64_t            FVulkan::GraphicsCommandBufferValue = 0;
+bool                FVulkan::bGraphicsRecording = false;
+VkDescriptorPool    FVulkan::GraphicsDescriptorPool = VK_NULL_HANDLE;
+VkCommandPool       FVulkan::ComputeCommandPool = VK_NULL_HANDLE;
+VkCommandBuffer     FVulkan::ComputeCommandBuffer = VK_NULL_HANDLE;
+uint64_t            FVulkan::ComputeCommandBufferValue = 0;
+bool                FVulkan::bAsyncComputeRecording = false;
+VkDescriptorPool    FVulkan::ComputeDescriptorPool = VK_NULL_HANDLE;
+FComputePipeline*   FVulkan::CurrentComputePipeline = nullptr;
+std::vector<FVulkan::FComputeBinding> FVulkan::PendingComputeBindings;
+bool                FVulkan::bDynamicRendering = false;
+std::map<FRenderPassKey, VkRenderPass> FVulkan::CompatibleRenderPasses;
+std::map<FVulkan::FFrameBufferKey, VkFramebuffer> FVulkan::FrameBuffers;
+std::array<VkImage, MaxRenderTargets> FVulkan::CurrentColorTargets;
+uint32_t            FVulkan::CurrentColorTargetNum = 0;
+VkPipeline          FVulkan::CurrentGraphicsPipeline = VK_NULL_HANDLE;
+std::array<VkBuffer, MaxVertexStreams> FVulkan::CurrentVertexBuffers;
+std::array<VkDeviceSize, MaxVertexStreams> FVulkan::CurrentVertexOffsets;
+uint32_t            FVulkan::CurrentUniformOffset = UINT32_MAX;
+FGraphicsBindStats  FVulkan::GraphicsBindStats;
 
 PFN_vkCreateDebugUtilsMessengerEXT  FVulkan::vkCreateDebugUtilsMessengerEXT;
 PFN_vkDestroyDebugUtilsMessengerEXT FVulkan::vkDestroyDebugUtilsMessengerEXT;
 VkDebugUtilsMessengerEXT            FVulkan::DebugUtilsMessenger;
+PFN_vkWaitForPresentKHR             FVulkan::vkWaitForPresentKHR = nullptr;
+bool                                FVulkan::bPresentWait = false;
+bool                                FVulkan::bImageCubeArray = false;
 
 VkBool32 VKAPI_CALL DebugVulkanCallback2(
             VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
@@ -71,42 +107,6 @@ VkBool32 VKAPI_CALL DebugVulkanCallback2(
     return VK_FALSE;
 }
 
-LRESULT CALLBACK DummyWndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam) {
-    return DefWindowProc(hWnd, message, wParam, lParam);
-}
-
-HWND FVulkan::CreateDummyWindow(HINSTANCE hInstance)
-{
-    WNDCLASS wc = {};
-    wc.lpfnWndProc = DummyWndProc;
-    wc.hInstance = hInstance;
-    wc.lpszClassName = L"DummyWindowClass";
-
-    RegisterClass(&wc);
-
-    HWND hWnd = CreateWindowExA(
-        0,                              // Optional window styles.
-        "DummyWindowClass",             // Window class
-        "Dummy Window",                 // Window text
-        WS_OVERLAPPEDWINDOW,            // Window style
-
-        // Size and position
-        CW_USEDEFAULT, CW_USEDEFAULT, CW_USEDEFAULT, CW_USEDEFAULT,
-
-        NULL,       // Parent window
-        NULL,       // Menu
-        hInstance,  // Instance handle
-        NULL        // Additional application data
-    );
-
-    if (hWnd == NULL)
-    {
-        checkf(0, "Failed to create dummy window");
-    }
-
-    return hWnd;
-}
-
 bool CheckValidationLayerSupport(const std::vector<const char*>& validationLayers) {
     uint32_t layerCount;
     vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
@@ -132,7 +132,7 @@ bool CheckValidationLayerSupport(const std::vector<const char*>& validationLayer
     return true;
 }
 
-void FVulkan::CreateVulkanInstance(const std::string& ApplicationName)
+void FVulkan::CreateVulkanInstance(const std::string& ApplicationName, EWindowBackend WindowBackend)
 {
     if(Instance != VK_NULL_HANDLE)
     {
@@ -155,8 +155,7 @@ void FVulkan::CreateVulkanInstance(const std::string& ApplicationName)
 #endif
 
     
-    std::vector<const char*> instanceExtensions = { VK_KHR_SURFACE_EXTENSION_NAME };
-    instanceExtensions.push_back("VK_KHR_win32_surface");
+    std::vector<const char*> instanceExtensions = FRenderWindow::GetInstanceExtensions(WindowBackend);
     instanceExtensions.push_back("VK_EXT_debug_utils");
     
     VkApplicationInfo appInfo = {};
@@ -216,7 +215,7 @@ void FVulkan::DestroyVulkanDebugLayer()
     }
 }
 
-void FVulkan::SelectPhysicalDevice()
+void FVulkan::SelectPhysicalDevice(VkSurfaceKHR Surface, const std::string& PreferredDevice)
 {
     std::vector<VkPhysicalDevice> PhysicalDevices;
     uint32_t physicalDeviceCount = 0;
@@ -225,21 +224,23 @@ void FVulkan::SelectPhysicalDevice()
     PhysicalDevices.resize(physicalDeviceCount);
     vkEnumeratePhysicalDevices(Instance, &physicalDeviceCount, PhysicalDevices.data());
 
-    if(!PhysicalDevices.empty())
+    std::vector<FPhysicalDeviceInfo> DeviceInfos;
+    for(VkPhysicalDevice Candidate : PhysicalDevices)
     {
-        PhysicalDevice = PhysicalDevices[0];
-        for(const auto& Devices : PhysicalDevices)
-        {
-            VkPhysicalDeviceProperties deviceProperties;
-            vkGetPhysicalDeviceProperties(Devices, &deviceProperties);
-            VK_LOG(LOG_INFO, "Selected device [%s] Type: %i API: %i", deviceProperties.deviceName, static_cast<int>(deviceProperties.deviceType), deviceProperties.apiVersion);
-        }
+        DeviceInfos.push_back(FDeviceSelector::Query(Candidate, Surface));
+    }
+
+    const int32_t Selected = FDeviceSelector::Select(DeviceInfos, PreferredDevice, Surface != VK_NULL_HANDLE);
+    if(Selected >= 0)
+    {
+        PhysicalDevice = PhysicalDevices[Selected];
+        VK_LOG(LOG_INFO, "Selected device [%s]", DeviceInfos[Selected].Name.c_str());
         return;
     }
-    checkf(0, "Failed selecting device");
+    checkf(0, "Failed selecting device, none of the %u devices is suitable", physicalDeviceCount);
 }
 
-void FVulkan::CreateVulkanDevice(HINSTANCE hInstance)
+void FVulkan::CreateVulkanDevice(const FRenderWindow& Window, const std::string& PreferredDevice)
 {
     if(Device != VK_NULL_HANDLE)
     {
@@ -247,7 +248,10 @@ void FVulkan::CreateVulkanDevice(HINSTANCE hInstance)
         return;
     }
     
-    SelectPhysicalDevice();
+    // Temporary surface of the real window, the renderer creates its own one for the swap chain
+    VkSurfaceKHR TempSurface = Window.CreateSurface(Instance);
+
+    SelectPhysicalDevice(TempSurface, PreferredDevice);
 
     std::vector<VkQueueFamilyProperties> QueueFamilyProps;
     uint32_t QueueCount;
@@ -256,10 +260,6 @@ void FVulkan::CreateVulkanDevice(HINSTANCE hInstance)
     QueueFamilyProps.resize(QueueCount);
     vkGetPhysicalDeviceQueueFamilyProperties(PhysicalDevice, &QueueCount, QueueFamilyProps.data());
 
-    
-    HWND DummyWindow = CreateDummyWindow(hInstance);
-    VkSurfaceKHR TempSurface = CreateSurface(hInstance, DummyWindow);
-
     int i = 0;
     for(const auto& queueFamily : QueueFamilyProps)
     {
@@ -269,36 +269,105 @@ void FVulkan::CreateVulkanDevice(HINSTANCE hInstance)
             GraphicsIndex = i;
         }
 
+        // Prefer a compute family without graphics so compute work can overlap rasterization
         if(queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT)
         {
-            ComputeIndex = i;
+            const bool bDedicated = !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT);
+            if(ComputeIndex == UINT32_MAX || bDedicated)
+            {
+                ComputeIndex = i;
+            }
         }
-            
 
-        VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(PhysicalDevice, i, TempSurface, &presentSupport);
-        if(queueFamily.queueCount > 0 && presentSupport)
+        // Transfer-only families are the copy engines, uploads on them overlap graphics and compute.
+        // Coarser image granularity would restrict the copy regions, those families are left alone
+        const VkExtent3D& Granularity = queueFamily.minImageTransferGranularity;
+        const bool bTransferOnly = (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT));
+        if(queueFamily.queueCount > 0 && bTransferOnly && Granularity.width == 1 && Granularity.height == 1 && Granularity.depth == 1 && TransferIndex == UINT32_MAX)
         {
-            PresentIndex = i;
+            TransferIndex = i;
         }
 
-        if(PresentIndex != UINT32_MAX && GraphicsIndex != UINT32_MAX && ComputeIndex != UINT32_MAX)
+
+        VkBool32 presentSupport = false;
+        if(TempSurface != VK_NULL_HANDLE)
+        {
+            vkGetPhysicalDeviceSurfaceSupportKHR(PhysicalDevice, i, TempSurface, &presentSupport);
+        }
+        if(queueFamily.queueCount > 0 && presentSupport)
         {
-            break;
+            PresentIndex = i;
         }
 
         i++;
     }
     
 
-    // Destroy temp surface
-    vkDestroySurfaceKHR(Instance, TempSurface, nullptr);
-    DestroyWindow(DummyWindow);
+    if(TransferIndex == UINT32_MAX)
+    {
+        // Copies stay on the graphics queue
+        TransferIndex = GraphicsIndex;
+    }
+
+    const bool bPresent = TempSurface != VK_NULL_HANDLE;
+    if(bPresent)
+    {
+        vkDestroySurfaceKHR(Instance, TempSurface, nullptr);
+    }
+    else
+    {
+        // Nothing is presented, the present queue aliases the graphics one
+        PresentIndex = GraphicsIndex;
+    }
+    if(PresentIndex == UINT32_MAX)
+    {
+        fatal("FVulkan::CreateVulkanDevice Selected device can't present to the window");
+    }
     
     std::vector<const char*> validationLayers;
-    const std::vector<const char*> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+    std::vector<const char*> deviceExtensions;
+    if(bPresent)
+    {
+        deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
+
+    uint32_t ExtensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(PhysicalDevice, nullptr, &ExtensionCount, nullptr);
+    std::vector<VkExtensionProperties> AvailableExtensions(ExtensionCount);
+    vkEnumerateDeviceExtensionProperties(PhysicalDevice, nullptr, &ExtensionCount, AvailableExtensions.data());
+    auto HasExtension_Lambda([&AvailableExtensions](const char* ExtensionName)
+    {
+        for(const VkExtensionProperties& Extension : AvailableExtensions)
+        {
+            if(strcmp(Extension.extensionName, ExtensionName) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    });
+
+    // Present wait is optional, the frame pacer falls back to CPU timing only
+    VkPhysicalDevicePresentIdFeaturesKHR PresentIdFeatures{};
+    PresentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    VkPhysicalDevicePresentWaitFeaturesKHR PresentWaitFeatures{};
+    PresentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+    if(bPresent && HasExtension_Lambda(VK_KHR_PRESENT_ID_EXTENSION_NAME) && HasExtension_Lambda(VK_KHR_PRESENT_WAIT_EXTENSION_NAME))
+    {
+        PresentIdFeatures.pNext = &PresentWaitFeatures;
+        VkPhysicalDeviceFeatures2 PresentFeatures{};
+        PresentFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        PresentFeatures.pNext = &PresentIdFeatures;
+        vkGetPhysicalDeviceFeatures2(PhysicalDevice, &PresentFeatures);
+        bPresentWait = PresentIdFeatures.presentId && PresentWaitFeatures.presentWait;
+    }
+    if(bPresentWait)
+    {
+        deviceExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+        deviceExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+    }
     
-    std::set<uint32_t> uniqueQueueFamilies = { GraphicsIndex, PresentIndex, ComputeIndex };
+    std::set<uint32_t> uniqueQueueFamilies = { GraphicsIndex, PresentIndex, ComputeIndex, TransferIndex };
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     float queuePriority = 1.0f;
 
@@ -315,8 +384,69 @@ void FVulkan::CreateVulkanDevice(HINSTANCE hInstance)
     VkPhysicalDeviceFeatures deviceFeatures = {};
     deviceFeatures.samplerAnisotropy = VK_TRUE;
 
+    // Timeline semaphores are the base of all the queue synchronization
+    VkPhysicalDeviceProperties DeviceProperties;
+    vkGetPhysicalDeviceProperties(PhysicalDevice, &DeviceProperties);
+    VkPhysicalDeviceVulkan13Features SupportedFeatures13{};
+    SupportedFeatures13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    VkPhysicalDeviceVulkan12Features SupportedFeatures12{};
+    SupportedFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    SupportedFeatures12.pNext = DeviceProperties.apiVersion >= VK_API_VERSION_1_3 ? &SupportedFeatures13 : nullptr;
+    VkPhysicalDeviceFeatures2 SupportedFeatures{};
+    SupportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    SupportedFeatures.pNext = &SupportedFeatures12;
+    vkGetPhysicalDeviceFeatures2(PhysicalDevice, &SupportedFeatures);
+    bImageCubeArray = SupportedFeatures.features.imageCubeArray == VK_TRUE;
+    deviceFeatures.imageCubeArray = bImageCubeArray ? VK_TRUE : VK_FALSE;
+    bDynamicRendering = DeviceProperties.apiVersion >= VK_API_VERSION_1_3 && SupportedFeatures13.dynamicRendering;
+    if(!bDynamicRendering && !SupportedFeatures12.imagelessFramebuffer)
+    {
+        fatal("FVulkan::CreateVulkanDevice Selected device supports neither dynamic rendering nor imageless frame buffers");
+    }
+
+    if(!SupportedFeatures12.timelineSemaphore)
+    {
+        fatal("FVulkan::CreateVulkanDevice Selected device does not support timeline semaphores");
+    }
+
+    // Every pipeline reads its resources through the bindless heap
+    if(!SupportedFeatures12.descriptorIndexing ||
+        !SupportedFeatures12.runtimeDescriptorArray ||
+        !SupportedFeatures12.descriptorBindingPartiallyBound ||
+        !SupportedFeatures12.descriptorBindingSampledImageUpdateAfterBind ||
+        !SupportedFeatures12.descriptorBindingStorageBufferUpdateAfterBind ||
+        !SupportedFeatures12.shaderSampledImageArrayNonUniformIndexing ||
+        !SupportedFeatures12.shaderStorageBufferArrayNonUniformIndexing)
+    {
+        fatal("FVulkan::CreateVulkanDevice Selected device does not support descriptor indexing");
+    }
+
+    VkPhysicalDeviceVulkan12Features deviceFeatures12{};
+    deviceFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    deviceFeatures12.timelineSemaphore = VK_TRUE;
+    deviceFeatures12.descriptorIndexing = VK_TRUE;
+    deviceFeatures12.runtimeDescriptorArray = VK_TRUE;
+    deviceFeatures12.descriptorBindingPartiallyBound = VK_TRUE;
+    deviceFeatures12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    deviceFeatures12.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+    deviceFeatures12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    deviceFeatures12.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+    deviceFeatures12.imagelessFramebuffer = bDynamicRendering ? VK_FALSE : VK_TRUE;
+
+    // Render passes go through vkCmdBeginRendering when available, no render pass or frame buffer objects
+    VkPhysicalDeviceVulkan13Features deviceFeatures13{};
+    deviceFeatures13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    deviceFeatures13.dynamicRendering = VK_TRUE;
+    deviceFeatures12.pNext = bDynamicRendering ? &deviceFeatures13 : nullptr;
+    deviceFeatures13.pNext = bPresentWait ? &PresentIdFeatures : nullptr;
+    if(bPresentWait && !bDynamicRendering)
+    {
+        deviceFeatures12.pNext = &PresentIdFeatures;
+    }
+
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext = &deviceFeatures12;
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.pEnabledFeatures = &deviceFeatures;
@@ -333,9 +463,22 @@ void FVulkan::CreateVulkanDevice(HINSTANCE hInstance)
 
     VK_LOG(LOG_INFO, "Logical device created");
 
+    if(bPresentWait)
+    {
+        vkWaitForPresentKHR = reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(Device, "vkWaitForPresentKHR"));
+        bPresentWait = vkWaitForPresentKHR != nullptr;
+    }
+    VK_LOG(LOG_INFO, "Present wait %s", bPresentWait ? "enabled" : "disabled");
+
     vkGetDeviceQueue(Device, GraphicsIndex, 0, &GraphicsQueue);
     vkGetDeviceQueue(Device, PresentIndex, 0, &PresentQueue);
     vkGetDeviceQueue(Device, ComputeIndex, 0, &ComputeQueue);
+    vkGetDeviceQueue(Device, TransferIndex, 0, &TransferQueue);
+
+    // Without a transfer-only family the transfer queue aliases graphics and FAsyncUpload never submits to it
+    Queues[static_cast<uint32_t>(EQueueType::Graphics)].Init(EQueueType::Graphics, GraphicsQueue, GraphicsIndex);
+    Queues[static_cast<uint32_t>(EQueueType::Compute)].Init(EQueueType::Compute, ComputeQueue, ComputeIndex);
+    Queues[static_cast<uint32_t>(EQueueType::Transfer)].Init(EQueueType::Transfer, TransferQueue, TransferIndex);
 
     // Create command pools and command buffers
     VkCommandPoolCreateInfo poolInfo{};
@@ -357,11 +500,40 @@ void FVulkan::CreateVulkanDevice(HINSTANCE hInstance)
         fatal("FVulkan::CreateVulkanDevice Fail creating Graphics command buffer");
     }
 
+    poolInfo.queueFamilyIndex = ComputeIndex;
+    if(vkCreateCommandPool(Device, &poolInfo, nullptr, &ComputeCommandPool) != VK_SUCCESS)
+    {
+        fatal("FVulkan::CreateVulkanDevice Fail creating Compute command pool");
+    }
+
+    allocInfo.commandPool = ComputeCommandPool;
+    if(vkAllocateCommandBuffers(Device, &allocInfo, &ComputeCommandBuffer) != VK_SUCCESS)
+    {
+        fatal("FVulkan::CreateVulkanDevice Fail creating Compute command buffer");
+    }
+
+    GraphicsDescriptorPool = CreateTransientDescriptorPool();
+    ComputeDescriptorPool = CreateTransientDescriptorPool();
+    FUniformStreamAllocator::Init();
+    FBindlessHeap::Init();
+    FGpuProfiler::Init(GraphicsIndex);
+    FAsyncUpload::Init();
+    VK_LOG(LOG_INFO, "Async compute %s, compute family: %i", SupportsAsyncCompute() ? "enabled" : "disabled", ComputeIndex);
+    VK_LOG(LOG_INFO, "Async transfer %s, transfer family: %i", SupportsAsyncTransfer() ? "enabled" : "disabled", TransferIndex);
+
     VKGlobals::InitGlobalResources();
 }
 
 void FVulkan::ExitVulkan()
 {
+    if(Device != VK_NULL_HANDLE)
+    {
+        vkDeviceWaitIdle(Device);
+    }
+
+    // Stops the upload thread, it may still have a transfer submission in flight
+    FAsyncUpload::Release();
+    
     for(auto& Elem : PSOs)
     {
         if(FGraphicsPipeline* It = Elem.second)
@@ -372,16 +544,30 @@ void FVulkan::ExitVulkan()
     }
     PSOs.clear();
 
-    for(auto& Elem : RenderPasses)
+    for(auto& Elem : ComputePSOs)
     {
-        if(FRenderPass* It = Elem.second)
+        if(FComputePipeline* It = Elem.second)
         {
             It->Release();
             delete It;
         }
     }
+    ComputePSOs.clear();
+
+    for(auto& Elem : RenderPasses)
+    {
+        delete Elem.second;
+    }
     RenderPasses.clear();
 
+    ReleaseFrameBuffers();
+
+    for(auto& Elem : CompatibleRenderPasses)
+    {
+        FDeletionQueue::Enqueue(EDeferredResourceType::RenderPass, Elem.second);
+    }
+    CompatibleRenderPasses.clear();
+
     // Destroy commands
     if(GraphicsCommandBuffer != VK_NULL_HANDLE)
     {
@@ -389,8 +575,32 @@ void FVulkan::ExitVulkan()
         vkDestroyCommandPool(Device, GraphicsCommandPool, nullptr);
         GraphicsCommandPool = VK_NULL_HANDLE;
     }
+
+    if(ComputeCommandBuffer != VK_NULL_HANDLE)
+    {
+        vkFreeCommandBuffers(Device, ComputeCommandPool, 1, &ComputeCommandBuffer);
+        vkDestroyCommandPool(Device, ComputeCommandPool, nullptr);
+        ComputeCommandPool = VK_NULL_HANDLE;
+    }
+
+    FDeletionQueue::Enqueue(EDeferredResourceType::DescriptorPool, GraphicsDescriptorPool);
+    FDeletionQueue::Enqueue(EDeferredResourceType::DescriptorPool, ComputeDescriptorPool);
+    GraphicsDescriptorPool = VK_NULL_HANDLE;
+    ComputeDescriptorPool = VK_NULL_HANDLE;
     
     VKGlobals::CleanupGlobalResources();
+    FBindlessHeap::Release();
+    FUniformStreamAllocator::Release();
+    FGpuReadback::Release();
+    FGpuProfiler::Release();
+
+    // Nothing is in flight anymore, drop every pending deferred release
+    FDeletionQueue::Flush();
+
+    for(FVulkanQueue& Queue : Queues)
+    {
+        Queue.Release();
+    }
     
     if (Device != VK_NULL_HANDLE)
     {
@@ -409,20 +619,6 @@ void FVulkan::ExitVulkan()
     VK_LOG(LOG_INFO, "Existing engine... return 1 success");
 }
 
-VkSurfaceKHR FVulkan::CreateSurface(HINSTANCE hInstance, HWND hwnd)
-{
-    VkSurfaceKHR SurfaceKHR;
-    VkWin32SurfaceCreateInfoKHR surfaceCreateInfo = {};
-    surfaceCreateInfo.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
-    surfaceCreateInfo.hinstance = hInstance;
-    surfaceCreateInfo.hwnd = hwnd;
-    if(vkCreateWin32SurfaceKHR(Instance, &surfaceCreateInfo, nullptr, &SurfaceKHR) != VK_SUCCESS)
-    {
-        checkf(0, "Fail creating surface");
-    }
-    return SurfaceKHR;
-}
-
 VkBool32 FVulkan::GetSupportedDepthFormat(VkFormat* depthFormat)
 {
     std::vector<VkFormat> depthFormats = {
@@ -457,6 +653,11 @@ VkQueue FVulkan::GetPresentQueue()
     return PresentQueue;
 }
 
+FVulkanQueue& FVulkan::GetQueue(EQueueType Type)
+{
+    return Queues[static_cast<uint32_t>(Type)];
+}
+
 VkCommandBuffer& FVulkan::GetGraphicsBuffer()
 {
     return GraphicsCommandBuffer;
@@ -525,6 +726,24 @@ uint32_t FVulkan::FindMemoryType(const VkPhysicalDevice& PhysicalDevice, uint32_
     return 0;
 }
 
+uint64_t FVulkan::GetFrameNumber()
+{
+    return FrameNumber;
+}
+
+void FVulkan::AdvanceFrame()
+{
+    FrameNumber++;
+}
+
+void FVulkan::ReleaseRetiredResources()
+{
+    const uint64_t CompletedValue = GetQueue(EQueueType::Graphics).GetCompletedValue();
+    FDeletionQueue::ReleaseRetired(CompletedValue);
+    FBindlessHeap::ReleaseRetired(CompletedValue);
+    FGpuReadback::ResolveCompleted(CompletedValue);
+}
+
 void FVulkan::CreateImage(uint32_t Width, uint32_t Height, VkFormat Format, VkImageTiling Tiling,
     VkImageUsageFlags ImageUsageFlags, VkMemoryPropertyFlags MemoryPropertyFlags, VkImage& Image,
     VkDeviceMemory& ImageMemory)
@@ -587,30 +806,154 @@ VkImageView FVulkan::CreateImageView(VkImage Image, VkFormat Format, VkImageAspe
     return imageView;
 }
 
-std::shared_ptr<FVulkanTexture> FVulkan::CreateTexture(uint32_t X, uint32_t Y, VkFormat Format, VkImageUsageFlags Flags, VkMemoryPropertyFlags MemoryFlags, const std::string& TextureName, VkImageTiling Tilling, VkImageAspectFlags AspectFlags)
+static VkFormatFeatureFlags GetRequiredFormatFeatures(VkImageUsageFlags Usage)
 {
-    std::shared_ptr<FVulkanTexture> Texture = std::make_shared<FVulkanTexture>();
-    Texture->Format = Format;
-    Texture->SizeX = X;
-    Texture->SizeY = Y;
-    Texture->ImageTilling = Tilling;
-    Texture->ResourceName = TextureName;
-    
+    VkFormatFeatureFlags Features = 0;
+    if (Usage & VK_IMAGE_USAGE_SAMPLED_BIT) Features |= VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+    if (Usage & VK_IMAGE_USAGE_STORAGE_BIT) Features |= VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT;
+    if (Usage & VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT) Features |= VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT;
+    if (Usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT) Features |= VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    if (Usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) Features |= VK_FORMAT_FEATURE_TRANSFER_SRC_BIT;
+    if (Usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT) Features |= VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+    return Features;
+}
+
+static VkImageAspectFlags GetFormatAspect(VkFormat Format)
+{
+    switch (Format)
+    {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+    case VK_FORMAT_D32_SFLOAT:
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+        // Views can only read one aspect of depth-stencil images, depth is the useful one
+        return VK_IMAGE_ASPECT_DEPTH_BIT;
+    case VK_FORMAT_S8_UINT:
+        return VK_IMAGE_ASPECT_STENCIL_BIT;
+    default:
+        return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+// Barriers on depth-stencil images have to name both aspects, unlike views
+static VkImageAspectFlags GetFormatBarrierAspect(VkFormat Format)
+{
+    switch (Format)
+    {
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    default:
+        return GetFormatAspect(Format);
+    }
+}
+
+// Bytes per texel of the aspect a readback copies, 0 for formats it doesn't handle
+static uint32_t GetReadbackTexelSize(VkFormat Format)
+{
+    switch (Format)
+    {
+    case VK_FORMAT_R8_UNORM:
+    case VK_FORMAT_R8_UINT:
+    case VK_FORMAT_S8_UINT:
+        return 1;
+    case VK_FORMAT_R8G8_UNORM:
+    case VK_FORMAT_R16_SFLOAT:
+    case VK_FORMAT_R16_UINT:
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+        return 2;
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+    case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+    case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+    case VK_FORMAT_R16G16_SFLOAT:
+    case VK_FORMAT_R32_SFLOAT:
+    case VK_FORMAT_R32_UINT:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+        return 4;
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+    case VK_FORMAT_R32G32_SFLOAT:
+        return 8;
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+std::shared_ptr<FVulkanTexture> FVulkan::CreateTexture(const FTextureDesc& Desc)
+{
+    const bool bCube = Desc.Type == ETextureType::TextureCube || Desc.Type == ETextureType::TextureCubeArray;
+    const bool b3D = Desc.Type == ETextureType::Texture3D;
+    const uint32_t Depth = b3D ? Desc.Depth : 1;
+    const uint32_t ArrayLayers = b3D ? 1 : Desc.ArrayLayers * (bCube ? 6 : 1);
+    const uint32_t MipLevels = Desc.MipLevels == 0 ? FTextureDesc::GetFullMipLevels(Desc.Width, Desc.Height, Depth) : Desc.MipLevels;
+    checkf(Desc.Width > 0 && Desc.Height > 0 && Depth > 0 && ArrayLayers > 0, "FVulkan::CreateTexture %s has an empty extent", Desc.Name.c_str());
+    checkf(MipLevels <= FTextureDesc::GetFullMipLevels(Desc.Width, Desc.Height, Depth), "FVulkan::CreateTexture %s has %u mips, more than its size allows", Desc.Name.c_str(), MipLevels);
+    checkf(Desc.Samples == VK_SAMPLE_COUNT_1_BIT || ((Desc.Type == ETextureType::Texture2D || Desc.Type == ETextureType::Texture2DArray) && MipLevels == 1),
+        "FVulkan::CreateTexture %s multisampled textures must be 2D without mips", Desc.Name.c_str());
+    checkf(!bCube || Desc.Width == Desc.Height, "FVulkan::CreateTexture cube %s must be square", Desc.Name.c_str());
+
+    // Every usage needs the matching format feature for the chosen tiling
+    VkFormatProperties FormatProperties;
+    vkGetPhysicalDeviceFormatProperties(PhysicalDevice, Desc.Format, &FormatProperties);
+    const VkFormatFeatureFlags Supported = Desc.Tiling == VK_IMAGE_TILING_OPTIMAL ? FormatProperties.optimalTilingFeatures : FormatProperties.linearTilingFeatures;
+    const VkFormatFeatureFlags Required = GetRequiredFormatFeatures(Desc.Usage);
+    if ((Supported & Required) != Required)
+    {
+        fatal("FVulkan::CreateTexture %s format %i lacks features 0x%x with %s tiling", Desc.Name.c_str(), Desc.Format, Required & ~Supported,
+            Desc.Tiling == VK_IMAGE_TILING_OPTIMAL ? "optimal" : "linear");
+    }
+
     VkImageCreateInfo ImageCreateInfo = {};
     ImageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    ImageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-    ImageCreateInfo.extent.width = X;
-    ImageCreateInfo.extent.height = Y;
-    ImageCreateInfo.extent.depth = 1;
-    ImageCreateInfo.mipLevels = 1;
-    ImageCreateInfo.arrayLayers = 1;
-    ImageCreateInfo.format = Format;
-    ImageCreateInfo.tiling = Tilling;
+    ImageCreateInfo.flags = bCube ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0;
+    ImageCreateInfo.imageType = b3D ? VK_IMAGE_TYPE_3D : VK_IMAGE_TYPE_2D;
+    ImageCreateInfo.extent.width = Desc.Width;
+    ImageCreateInfo.extent.height = Desc.Height;
+    ImageCreateInfo.extent.depth = Depth;
+    ImageCreateInfo.mipLevels = MipLevels;
+    ImageCreateInfo.arrayLayers = ArrayLayers;
+    ImageCreateInfo.format = Desc.Format;
+    ImageCreateInfo.tiling = Desc.Tiling;
     ImageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    ImageCreateInfo.usage = Flags;
-    ImageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    ImageCreateInfo.usage = Desc.Usage;
+    ImageCreateInfo.samples = Desc.Samples;
     ImageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
+    VkImageFormatProperties ImageFormatProperties;
+    const VkResult FormatResult = vkGetPhysicalDeviceImageFormatProperties(PhysicalDevice, Desc.Format, ImageCreateInfo.imageType, Desc.Tiling, Desc.Usage, ImageCreateInfo.flags, &ImageFormatProperties);
+    if (FormatResult != VK_SUCCESS || MipLevels > ImageFormatProperties.maxMipLevels || ArrayLayers > ImageFormatProperties.maxArrayLayers ||
+        !(ImageFormatProperties.sampleCounts & Desc.Samples) || Desc.Width > ImageFormatProperties.maxExtent.width ||
+        Desc.Height > ImageFormatProperties.maxExtent.height || Depth > ImageFormatProperties.maxExtent.depth)
+    {
+        fatal("FVulkan::CreateTexture %s %ux%ux%u, %u mips, %u layers, %i samples is not supported for format %i", Desc.Name.c_str(),
+            Desc.Width, Desc.Height, Depth, MipLevels, ArrayLayers, Desc.Samples, Desc.Format);
+    }
+
+    std::shared_ptr<FVulkanTexture> Texture = std::make_shared<FVulkanTexture>();
+    Texture->Format = Desc.Format;
+    Texture->SizeX = Desc.Width;
+    Texture->SizeY = Desc.Height;
+    Texture->SizeZ = Depth;
+    Texture->MipLevels = MipLevels;
+    Texture->ArrayLayers = ArrayLayers;
+    Texture->Type = Desc.Type;
+    Texture->Samples = Desc.Samples;
+    Texture->AspectFlags = Desc.AspectFlags != 0 ? Desc.AspectFlags : GetFormatAspect(Desc.Format);
+    Texture->ImageTilling = Desc.Tiling;
+    Texture->Usage = Desc.Usage;
+    Texture->ResourceName = Desc.Name;
+
     if (vkCreateImage(Device, &ImageCreateInfo, nullptr, &Texture->Image) != VK_SUCCESS)
     {
         checkf(0, "Fail creating texture");
@@ -622,7 +965,7 @@ std::shared_ptr<FVulkanTexture> FVulkan::CreateTexture(uint32_t X, uint32_t Y, V
     VkMemoryAllocateInfo MemoryAllocateInfo = {};
     MemoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
     MemoryAllocateInfo.allocationSize = MemRequirements.size;
-    MemoryAllocateInfo.memoryTypeIndex = FindMemoryType(PhysicalDevice, MemRequirements.memoryTypeBits, MemoryFlags);
+    MemoryAllocateInfo.memoryTypeIndex = FindMemoryType(PhysicalDevice, MemRequirements.memoryTypeBits, Desc.MemoryFlags);
 
     if (vkAllocateMemory(Device, &MemoryAllocateInfo, nullptr, &Texture->ImageMemory) != VK_SUCCESS)
     {
@@ -631,16 +974,27 @@ std::shared_ptr<FVulkanTexture> FVulkan::CreateTexture(uint32_t X, uint32_t Y, V
 
     vkBindImageMemory(Device, Texture->Image, Texture->ImageMemory, 0);
 
+    VkImageViewType ViewType = VK_IMAGE_VIEW_TYPE_2D;
+    switch (Desc.Type)
+    {
+    case ETextureType::Texture2D: ViewType = ArrayLayers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D; break;
+    case ETextureType::Texture2DArray: ViewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY; break;
+    case ETextureType::TextureCube: ViewType = ArrayLayers > 6 ? VK_IMAGE_VIEW_TYPE_CUBE_ARRAY : VK_IMAGE_VIEW_TYPE_CUBE; break;
+    case ETextureType::TextureCubeArray: ViewType = VK_IMAGE_VIEW_TYPE_CUBE_ARRAY; break;
+    case ETextureType::Texture3D: ViewType = VK_IMAGE_VIEW_TYPE_3D; break;
+    }
+    checkf(ViewType != VK_IMAGE_VIEW_TYPE_CUBE_ARRAY || bImageCubeArray, "FVulkan::CreateTexture cube array %s needs the imageCubeArray feature", Desc.Name.c_str());
+
     VkImageViewCreateInfo ImageViewCreateInfo = {};
     ImageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     ImageViewCreateInfo.image = Texture->Image;
-    ImageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    ImageViewCreateInfo.format = Format;
-    ImageViewCreateInfo.subresourceRange.aspectMask = AspectFlags;
+    ImageViewCreateInfo.viewType = ViewType;
+    ImageViewCreateInfo.format = Desc.Format;
+    ImageViewCreateInfo.subresourceRange.aspectMask = Texture->AspectFlags;
     ImageViewCreateInfo.subresourceRange.baseMipLevel = 0;
-    ImageViewCreateInfo.subresourceRange.levelCount = 1;
+    ImageViewCreateInfo.subresourceRange.levelCount = MipLevels;
     ImageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
-    ImageViewCreateInfo.subresourceRange.layerCount = 1;
+    ImageViewCreateInfo.subresourceRange.layerCount = ArrayLayers;
     
     if (vkCreateImageView(Device, &ImageViewCreateInfo, nullptr, &Texture->ImageView) != VK_SUCCESS)
     {
@@ -650,6 +1004,77 @@ std::shared_ptr<FVulkanTexture> FVulkan::CreateTexture(uint32_t X, uint32_t Y, V
     return Texture;
 }
 
+uint32_t FVulkan::MakeBindless(const std::shared_ptr<FVulkanTexture>& Texture, VkImageLayout Layout)
+{
+    check(Texture && Texture->IsValid());
+    if(Texture->BindlessIndex == UINT32_MAX)
+    {
+        Texture->BindlessIndex = FBindlessHeap::RegisterTexture(Texture->ImageView, Layout);
+    }
+    return Texture->BindlessIndex;
+}
+
+uint32_t FVulkan::MakeBindless(const std::shared_ptr<FVulkanBuffer>& Buffer)
+{
+    check(Buffer && Buffer->IsValid());
+    if(Buffer->BindlessIndex == UINT32_MAX)
+    {
+        Buffer->BindlessIndex = FBindlessHeap::RegisterBuffer(Buffer->Buffer);
+    }
+    return Buffer->BindlessIndex;
+}
+
+FUniformAllocation FVulkan::AllocateUniform(uint32_t Size)
+{
+    return FUniformStreamAllocator::Allocate(Size);
+}
+
+void FVulkan::BindUniform(const FUniformAllocation& Allocation)
+{
+    if(Allocation.Offset == CurrentUniformOffset)
+    {
+        GraphicsBindStats.ElidedBinds++;
+        return;
+    }
+    CurrentUniformOffset = Allocation.Offset;
+    GraphicsBindStats.UniformBinds++;
+    FUniformStreamAllocator::Bind(GraphicsCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, FBindlessHeap::GetPipelineLayout(), FBindlessHeap::UniformSetIndex, Allocation);
+}
+
+FUniformAllocation FVulkan::AllocateInstanceData(uint32_t Size)
+{
+    return FUniformStreamAllocator::AllocateVertices(Size);
+}
+
+void FVulkan::BindInstanceStream(int Index, const FUniformAllocation& Allocation)
+{
+    checkf(Index >= 0 && Index < MaxVertexStreams, "FVulkan::BindInstanceStream stream index %i out of range", Index);
+    VkBuffer Buffer = FUniformStreamAllocator::GetBuffer();
+    if(CurrentVertexBuffers[Index] == Buffer && CurrentVertexOffsets[Index] == Allocation.Offset)
+    {
+        GraphicsBindStats.ElidedBinds++;
+        return;
+    }
+    CurrentVertexBuffers[Index] = Buffer;
+    CurrentVertexOffsets[Index] = Allocation.Offset;
+    GraphicsBindStats.VertexBufferBinds++;
+
+    VkDeviceSize offsets[] = { Allocation.Offset };
+    vkCmdBindVertexBuffers(GraphicsCommandBuffer, Index, 1, &Buffer, offsets);
+}
+
+FUniformAllocation FVulkan::AllocateStaging(uint32_t Size)
+{
+    return FUniformStreamAllocator::AllocateStaging(Size);
+}
+
+void FVulkan::SetUniformData(const void* Data, uint32_t Size)
+{
+    FUniformAllocation Allocation = FUniformStreamAllocator::Allocate(Size);
+    memcpy(Allocation.Data, Data, Size);
+    BindUniform(Allocation);
+}
+
 void FVulkan::ReleaseTexture(std::shared_ptr<FVulkanTexture>& Texture)
 {
     if(!Texture)
@@ -711,30 +1136,85 @@ std::uint32_t GenerateUniqueId(const std::string& input)
     return static_cast<uint32_t>(std::hash<std::string>{}(input));
 }
 
+static bool HasStencilComponent(VkFormat Format)
+{
+    return Format == VK_FORMAT_D16_UNORM_S8_UINT || Format == VK_FORMAT_D24_UNORM_S8_UINT || Format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
+
+// Targets are left in shader read layout after every pass, a loaded target comes from there
+static VkImageLayout GetInitialLayout(VkAttachmentLoadOp Load, VkImageLayout ReadLayout)
+{
+    return Load == VK_ATTACHMENT_LOAD_OP_LOAD ? ReadLayout : VK_IMAGE_LAYOUT_UNDEFINED;
+}
+
+// Writes still in flight from the previous use of a layout, nothing to make available when the contents are dropped
+static VkAccessFlags GetLayoutWriteAccess(VkImageLayout Layout)
+{
+    switch(Layout)
+    {
+    case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+        return VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+        return VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+        return VK_ACCESS_SHADER_READ_BIT;
+    default:
+        return 0;
+    }
+}
+
 FRenderPass* FVulkan::BeginRenderPass(const FRenderPassInfo& RenderPassInfo, VkExtent2D ViewSize, const std::string& RenderPassName)
 {
-    FRenderPass* RenderPass = GetOrCreateRenderPass(RenderPassInfo, ViewSize, RenderPassName);
+    FRenderPass* RenderPass = GetOrCreateRenderPass(RenderPassInfo, RenderPassName);
+
+    // Remember the color targets, the end of the pass moves them to shader read
+    CurrentColorTargetNum = 0;
+    for(const FRenderPassInfo::FColorAttachment& ColorTarget : RenderPassInfo.ColorRenderTargets)
+    {
+        if(ColorTarget.Target)
+        {
+            CurrentColorTargets[CurrentColorTargetNum++] = ColorTarget.Target->Image;
+        }
+    }
+
+    if(bDynamicRendering)
+    {
+        BeginDynamicRendering(RenderPassInfo, ViewSize);
+        return RenderPass;
+    }
     
-    std::vector<VkClearValue> ClearValues;
+    std::array<VkClearValue, MaxRenderTargets + 1> ClearValues;
+    std::array<VkImageView, MaxRenderTargets + 1> Attachments;
+    uint32_t AttachmentNum = 0;
     for(const FRenderPassInfo::FColorAttachment& ColorTarget : RenderPassInfo.ColorRenderTargets)
     {
-        VkClearValue& Elem = ClearValues.emplace_back();
-        Elem.color = ColorTarget.ClearColor;
+        if(ColorTarget.Target)
+        {
+            ClearValues[AttachmentNum].color = ColorTarget.ClearColor;
+            Attachments[AttachmentNum++] = ColorTarget.Target->ImageView;
+        }
     }
 
     if(RenderPassInfo.DepthStencilRenderTarget.Target)
     {
-        VkClearValue& Elem = ClearValues.emplace_back();
-        Elem.depthStencil = RenderPassInfo.DepthStencilRenderTarget.StencilClearColor;
+        ClearValues[AttachmentNum].depthStencil = RenderPassInfo.DepthStencilRenderTarget.StencilClearColor;
+        Attachments[AttachmentNum++] = RenderPassInfo.DepthStencilRenderTarget.Target->ImageView;
     }
+
+    // Imageless frame buffer, views are given here so render target switches don't need a new one
+    VkRenderPassAttachmentBeginInfo AttachmentBeginInfo{};
+    AttachmentBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_ATTACHMENT_BEGIN_INFO;
+    AttachmentBeginInfo.attachmentCount = AttachmentNum;
+    AttachmentBeginInfo.pAttachments = Attachments.data();
     
     VkRenderPassBeginInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.pNext = &AttachmentBeginInfo;
     renderPassInfo.renderPass = RenderPass->RenderPass;
-    renderPassInfo.framebuffer = RenderPass->FrameBuffer;
+    renderPassInfo.framebuffer = GetOrCreateFrameBuffer(RenderPass, RenderPassInfo, ViewSize);
     renderPassInfo.renderArea.offset = {0, 0};
     renderPassInfo.renderArea.extent = ViewSize;
-    renderPassInfo.clearValueCount = static_cast<uint32_t>(ClearValues.size());
+    renderPassInfo.clearValueCount = AttachmentNum;
     renderPassInfo.pClearValues = ClearValues.data();
     
     vkCmdBeginRenderPass(GraphicsCommandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
@@ -742,49 +1222,158 @@ FRenderPass* FVulkan::BeginRenderPass(const FRenderPassInfo& RenderPassInfo, VkE
     return RenderPass;
 }
 
-FRenderPass* FVulkan::GetOrCreateRenderPass(const FRenderPassInfo& RenderPassInfo,  VkExtent2D ViewSize, const std::string& RenderPassName)
+void FVulkan::BeginDynamicRendering(const FRenderPassInfo& RenderPassInfo, VkExtent2D ViewSize)
 {
+    std::array<VkImageMemoryBarrier, MaxRenderTargets + 1> Barriers;
+    std::array<VkRenderingAttachmentInfo, MaxRenderTargets> ColorAttachments;
+    uint32_t BarrierNum = 0;
+    uint32_t ColorAttachmentNum = 0;
+
+    auto SetupBarrier_Lambda([&Barriers, &BarrierNum](VkImage Image, VkImageLayout OldLayout, VkImageLayout NewLayout, VkImageAspectFlags Aspect, VkAccessFlags SrcAccess, VkAccessFlags DstAccess)
+    {
+        VkImageMemoryBarrier& Barrier = Barriers[BarrierNum++];
+        Barrier = {};
+        Barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        Barrier.srcAccessMask = SrcAccess;
+        Barrier.dstAccessMask = DstAccess;
+        Barrier.oldLayout = OldLayout;
+        Barrier.newLayout = NewLayout;
+        Barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        Barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        Barrier.image = Image;
+        Barrier.subresourceRange = {Aspect, 0, 1, 0, 1};
+    });
+
+    for(const FRenderPassInfo::FColorAttachment& ColorTarget : RenderPassInfo.ColorRenderTargets)
+    {
+        if(!ColorTarget.Target)
+        {
+            continue;
+        }
+
+        const VkImageLayout OldLayout = GetInitialLayout(ColorTarget.Load, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        SetupBarrier_Lambda(
+            ColorTarget.Target->Image,
+            OldLayout,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            VK_IMAGE_ASPECT_COLOR_BIT,
+            GetLayoutWriteAccess(OldLayout),
+            VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+
+        VkRenderingAttachmentInfo& Attachment = ColorAttachments[ColorAttachmentNum++];
+        Attachment = {};
+        Attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        Attachment.imageView = ColorTarget.Target->ImageView;
+        Attachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        Attachment.loadOp = ColorTarget.Load;
+        Attachment.storeOp = ColorTarget.Store;
+        Attachment.clearValue.color = ColorTarget.ClearColor;
+    }
+
+    VkRenderingAttachmentInfo DepthAttachment{};
+    const FRenderPassInfo::FDepthStencilAttachment& DepthTarget = RenderPassInfo.DepthStencilRenderTarget;
+    const bool bHasStencil = DepthTarget.Target && HasStencilComponent(DepthTarget.Target->Format);
+    if(DepthTarget.Target)
+    {
+        // A loaded depth target stays in attachment layout between passes, the last pass's depth writes are what we wait on
+        const VkImageLayout OldLayout = GetInitialLayout(DepthTarget.Load, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+        SetupBarrier_Lambda(
+            DepthTarget.Target->Image,
+            OldLayout,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            VK_IMAGE_ASPECT_DEPTH_BIT | (bHasStencil ? VK_IMAGE_ASPECT_STENCIL_BIT : 0),
+            GetLayoutWriteAccess(OldLayout),
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+
+        DepthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        DepthAttachment.imageView = DepthTarget.Target->ImageView;
+        DepthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        DepthAttachment.loadOp = DepthTarget.Load;
+        DepthAttachment.storeOp = DepthTarget.Store;
+        DepthAttachment.clearValue.depthStencil = DepthTarget.StencilClearColor;
+    }
+
+    vkCmdPipelineBarrier(
+        GraphicsCommandBuffer,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+        0,
+        0, nullptr,
+        0, nullptr,
+        BarrierNum, Barriers.data());
+
+    VkRenderingInfo RenderingInfo{};
+    RenderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+    RenderingInfo.renderArea.offset = {0, 0};
+    RenderingInfo.renderArea.extent = ViewSize;
+    RenderingInfo.layerCount = 1;
+    RenderingInfo.colorAttachmentCount = ColorAttachmentNum;
+    RenderingInfo.pColorAttachments = ColorAttachments.data();
+    RenderingInfo.pDepthAttachment = DepthTarget.Target ? &DepthAttachment : nullptr;
+    RenderingInfo.pStencilAttachment = bHasStencil ? &DepthAttachment : nullptr;
+    vkCmdBeginRendering(GraphicsCommandBuffer, &RenderingInfo);
+}
+
+FRenderPass* FVulkan::GetOrCreateRenderPass(const FRenderPassInfo& RenderPassInfo, const std::string& RenderPassName)
+{
+    FRenderPassKey CompatibilityKey = FRenderPassKey::Create(RenderPassInfo);
     uint32_t PassId = GenerateUniqueId(RenderPassName);
     auto it = RenderPasses.find(PassId);
-    if (it != RenderPasses.end())
+    if (it != RenderPasses.end() && it->second->CompatibilityKey == CompatibilityKey)
+    {
+        return it->second;
+    }
+
+    FRenderPass* RenderPass = it != RenderPasses.end() ? it->second : new FRenderPass();
+    RenderPass->RenderPassName = RenderPassName;
+    RenderPass->CompatibilityKey = std::move(CompatibilityKey);
+    RenderPass->ColorFormats.clear();
+    for(const FRenderPassInfo::FColorAttachment& ColorTarget : RenderPassInfo.ColorRenderTargets)
+    {
+        if(ColorTarget.Target)
+        {
+            RenderPass->ColorFormats.push_back(ColorTarget.Target->Format);
+        }
+    }
+    RenderPass->DepthFormat = RenderPassInfo.DepthStencilRenderTarget.Target ? RenderPassInfo.DepthStencilRenderTarget.Target->Format : VK_FORMAT_UNDEFINED;
+    RenderPass->RenderPass = bDynamicRendering ? VK_NULL_HANDLE : GetOrCreateCompatibleRenderPass(RenderPass->CompatibilityKey);
+
+    RenderPasses[PassId] = RenderPass;
+    VK_LOG(LOG_SUCCESS, "Creating render pass: %s", RenderPassName.c_str());
+    return RenderPass;
+}
+
+VkRenderPass FVulkan::GetOrCreateCompatibleRenderPass(const FRenderPassKey& CompatibilityKey)
+{
+    auto it = CompatibleRenderPasses.find(CompatibilityKey);
+    if (it != CompatibleRenderPasses.end())
     {
-        return it->second; // Return the shared_ptr to FRenderPass
+        return it->second;
     }
 
-    auto SetupAttachment_Lambda([](VkAttachmentDescription& Attach, VkAttachmentLoadOp LoadOp, VkAttachmentStoreOp StoreOp, VkFormat Format, VkImageLayout FinalLayout)
+    auto SetupAttachment_Lambda([](VkAttachmentDescription& Attach, const FRenderPassAttachmentKey& AttachmentKey)
     {
-        Attach.samples = VK_SAMPLE_COUNT_1_BIT;
-        Attach.loadOp = LoadOp;
-        Attach.storeOp = StoreOp;
+        Attach.samples = AttachmentKey.Samples;
+        Attach.loadOp = AttachmentKey.Load;
+        Attach.storeOp = AttachmentKey.Store;
         Attach.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         Attach.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        Attach.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        Attach.finalLayout = FinalLayout;
-        Attach.format = Format;
+        Attach.initialLayout = GetInitialLayout(AttachmentKey.Load, AttachmentKey.FinalLayout);
+        Attach.finalLayout = AttachmentKey.FinalLayout;
+        Attach.format = AttachmentKey.Format;
     });
 
     std::vector<VkAttachmentDescription> AttachmentDescriptions;
     std::vector<VkAttachmentReference> ColorReferences;
-    std::vector<VkImageView> Attachments;
-    for (uint32_t i = 0; i < RenderPassInfo.ColorRenderTargets.size(); ++i)
+    for (const FRenderPassAttachmentKey& ColorAttachment : CompatibilityKey.ColorAttachments)
     {
-        if(!RenderPassInfo.ColorRenderTargets[i].Target)
-        {
-            continue;
-        }
-        
         VkAttachmentDescription& Attach = AttachmentDescriptions.emplace_back();
-        SetupAttachment_Lambda(
-            Attach,
-            RenderPassInfo.ColorRenderTargets[i].Load,
-            RenderPassInfo.ColorRenderTargets[i].Store,
-            RenderPassInfo.ColorRenderTargets[i].Target->Format,
-            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        Attach = {};
+        SetupAttachment_Lambda(Attach, ColorAttachment);
         
         VkAttachmentReference& Reference = ColorReferences.emplace_back();
-        Reference.attachment = i;
+        Reference.attachment = static_cast<uint32_t>(AttachmentDescriptions.size()) - 1;
         Reference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-        Attachments.push_back(RenderPassInfo.ColorRenderTargets[i].Target->ImageView);
     }
 
     VkSubpassDescription subpass = {};
@@ -792,21 +1381,15 @@ FRenderPass* FVulkan::GetOrCreateRenderPass(const FRenderPassInfo& RenderPassInf
     subpass.pColorAttachments = ColorReferences.data();
     subpass.colorAttachmentCount = static_cast<uint32_t>(ColorReferences.size());
     
-    if(RenderPassInfo.DepthStencilRenderTarget.Target)
+    VkAttachmentReference depthReference = {};
+    if(CompatibilityKey.HasDepth())
     {
-        VkAttachmentReference depthReference = {};
         VkAttachmentDescription& Attach = AttachmentDescriptions.emplace_back();
-        SetupAttachment_Lambda(
-            Attach,
-            RenderPassInfo.DepthStencilRenderTarget.Load,
-            RenderPassInfo.DepthStencilRenderTarget.Store,
-            RenderPassInfo.DepthStencilRenderTarget.Target->Format,
-            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+        Attach = {};
+        SetupAttachment_Lambda(Attach, CompatibilityKey.DepthAttachment);
         depthReference.attachment = static_cast<uint32_t>(AttachmentDescriptions.size()) - 1;
         depthReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
         subpass.pDepthStencilAttachment = &depthReference;
-
-        Attachments.push_back(RenderPassInfo.DepthStencilRenderTarget.Target->ImageView);
     }
 
     VkRenderPassCreateInfo renderPassInfo = {};
@@ -817,32 +1400,101 @@ FRenderPass* FVulkan::GetOrCreateRenderPass(const FRenderPassInfo& RenderPassInf
     renderPassInfo.pSubpasses = &subpass;
 
     VkRenderPass RenderPass = VK_NULL_HANDLE;
-    if(vkCreateRenderPass(Device, &renderPassInfo, nullptr, &RenderPass) == VK_SUCCESS)
+    if(vkCreateRenderPass(Device, &renderPassInfo, nullptr, &RenderPass) != VK_SUCCESS)
     {
-        FRenderPass* NewRenderPass = new FRenderPass();
-        NewRenderPass->RenderPassName = RenderPassName;
-        NewRenderPass->RenderPass = RenderPass;
-        
-        VkFramebufferCreateInfo framebufferInfo = {};
-        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        framebufferInfo.renderPass = NewRenderPass->RenderPass;
-        framebufferInfo.attachmentCount = static_cast<uint32_t>(Attachments.size());
-        framebufferInfo.pAttachments = Attachments.data();
-        framebufferInfo.width = ViewSize.width;
-        framebufferInfo.height = ViewSize.height;
-        framebufferInfo.layers = 1;
-
-        if (vkCreateFramebuffer(GetDevice(), &framebufferInfo, nullptr, &NewRenderPass->FrameBuffer) != VK_SUCCESS)
+        fatal("FVulkan::GetOrCreateCompatibleRenderPass Fail creating render pass with %zu color attachments", CompatibilityKey.ColorAttachments.size());
+    }
+
+    CompatibleRenderPasses[CompatibilityKey] = RenderPass;
+    return RenderPass;
+}
+
+VkFramebuffer FVulkan::GetOrCreateFrameBuffer(const FRenderPass* RenderPass, const FRenderPassInfo& RenderPassInfo, VkExtent2D ViewSize)
+{
+    // Imageless frame buffers only depend on the attachment description, not on the views
+    std::array<const FVulkanTexture*, MaxRenderTargets + 1> Targets;
+    uint32_t TargetNum = 0;
+    for(const FRenderPassInfo::FColorAttachment& ColorTarget : RenderPassInfo.ColorRenderTargets)
+    {
+        if(ColorTarget.Target)
         {
-            fatal("Failed to create framebuffer %s", RenderPassName.c_str());
+            Targets[TargetNum++] = ColorTarget.Target.get();
         }
+    }
+    if(RenderPassInfo.DepthStencilRenderTarget.Target)
+    {
+        Targets[TargetNum++] = RenderPassInfo.DepthStencilRenderTarget.Target.get();
+    }
+
+    FFrameBufferKey Key{};
+    Key.CompatibilityKey = RenderPass->CompatibilityKey;
+    Key.Width = ViewSize.width;
+    Key.Height = ViewSize.height;
+    Key.TargetNum = TargetNum;
+    for (uint32_t i = 0; i < TargetNum; ++i)
+    {
+        Key.Usages[i] = Targets[i]->Usage;
+        Key.Formats[i] = Targets[i]->Format;
+    }
+
+    auto it = FrameBuffers.find(Key);
+    if (it != FrameBuffers.end())
+    {
+        return it->second;
+    }
+
+    std::array<VkFramebufferAttachmentImageInfo, MaxRenderTargets + 1> AttachmentImageInfos;
+    for (uint32_t i = 0; i < TargetNum; ++i)
+    {
+        VkFramebufferAttachmentImageInfo& ImageInfo = AttachmentImageInfos[i];
+        ImageInfo = {};
+        ImageInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_ATTACHMENT_IMAGE_INFO;
+        ImageInfo.usage = Targets[i]->Usage;
+        ImageInfo.width = ViewSize.width;
+        ImageInfo.height = ViewSize.height;
+        ImageInfo.layerCount = 1;
+        ImageInfo.viewFormatCount = 1;
+        ImageInfo.pViewFormats = &Targets[i]->Format;
+    }
+
+    VkFramebufferAttachmentsCreateInfo AttachmentsCreateInfo{};
+    AttachmentsCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_ATTACHMENTS_CREATE_INFO;
+    AttachmentsCreateInfo.attachmentImageInfoCount = TargetNum;
+    AttachmentsCreateInfo.pAttachmentImageInfos = AttachmentImageInfos.data();
+
+    VkFramebufferCreateInfo framebufferInfo = {};
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.pNext = &AttachmentsCreateInfo;
+    framebufferInfo.flags = VK_FRAMEBUFFER_CREATE_IMAGELESS_BIT;
+    framebufferInfo.renderPass = RenderPass->RenderPass;
+    framebufferInfo.attachmentCount = TargetNum;
+    framebufferInfo.width = ViewSize.width;
+    framebufferInfo.height = ViewSize.height;
+    framebufferInfo.layers = 1;
+
+    VkFramebuffer FrameBuffer = VK_NULL_HANDLE;
+    if (vkCreateFramebuffer(GetDevice(), &framebufferInfo, nullptr, &FrameBuffer) != VK_SUCCESS)
+    {
+        fatal("Failed to create framebuffer %s", RenderPass->RenderPassName.c_str());
+    }
+
+    FrameBuffers[Key] = FrameBuffer;
+    return FrameBuffer;
+}
 
-        RenderPasses[PassId] = NewRenderPass;
-        VK_LOG(LOG_SUCCESS, "Creating render pass: %s", RenderPassName.c_str());
-        return NewRenderPass;
+void FVulkan::ReleaseFrameBuffers()
+{
+    for(auto& Elem : FrameBuffers)
+    {
+        FDeletionQueue::Enqueue(EDeferredResourceType::Framebuffer, Elem.second);
     }
+    FrameBuffers.clear();
+}
 
-    fatal("Fail creating render pass %s", RenderPassName.c_str());
+bool FVulkan::FFrameBufferKey::operator<(const FFrameBufferKey& Other) const
+{
+    return std::tie(CompatibilityKey, Width, Height, TargetNum, Usages, Formats) <
+        std::tie(Other.CompatibilityKey, Other.Width, Other.Height, Other.TargetNum, Other.Usages, Other.Formats);
 }
 
 FGraphicsPipeline* FVulkan::SetGraphicsPipeline(const FGraphicsPipelineInitializer& PSOInitializer)
@@ -853,14 +1505,23 @@ FGraphicsPipeline* FVulkan::SetGraphicsPipeline(const FGraphicsPipelineInitializ
         fatal("FVulkan::SetGraphicsPipeline Failed creating graphics pipelines, invalid shader or render pass");
     }
 
-    // Will use the same id as the render pass
-    uint32_t Id = GenerateUniqueId(PSOInitializer.RenderPass->RenderPassName);
-    auto it = PSOs.find(Id);
+    if(!PSOInitializer.VertexInput)
+    {
+        fatal("FVulkan::SetGraphicsPipeline No valid vertex input creating the graphics pipeline");
+    }
+
+    // Keyed on the whole initializer, passes with the same attachments share pipelines
+    const FGraphicsPipelineKey Key = FGraphicsPipelineKey::Create(
+        PSOInitializer.VertexShader->GetShader(), PSOInitializer.VertexShader->GetEntryPoint(),
+        PSOInitializer.PixelShader->GetShader(), PSOInitializer.PixelShader->GetEntryPoint(),
+        PSOInitializer.PrimitiveTopology, PSOInitializer.VertexInput->GetInputVertexState(), PSOInitializer.State, *PSOInitializer.RenderPass);
+    auto it = PSOs.find(Key);
     if (it != PSOs.end())
     {
-        vkCmdBindPipeline(GraphicsCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, it->second->GetGraphicsPipeline());
+        BindGraphicsPipeline(it->second->GetGraphicsPipeline());
         return it->second;
     }
+    const FGraphicsPipelineState& State = PSOInitializer.State;
 
     std::vector<VkPipelineShaderStageCreateInfo> ShaderStages;
     VkPipelineShaderStageCreateInfo& VertexStageInfo = ShaderStages.emplace_back();
@@ -889,10 +1550,10 @@ FGraphicsPipeline* FVulkan::SetGraphicsPipeline(const FGraphicsPipelineInitializ
     rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
     rasterizer.depthClampEnable = VK_FALSE;
     rasterizer.rasterizerDiscardEnable = VK_FALSE;
-    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.polygonMode = State.PolygonMode;
     rasterizer.lineWidth = 1.0f;
-    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-    rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+    rasterizer.cullMode = State.CullMode;
+    rasterizer.frontFace = State.FrontFace;
     rasterizer.depthBiasEnable = VK_FALSE;
 
     VkPipelineMultisampleStateCreateInfo multisampling{};
@@ -902,7 +1563,13 @@ FGraphicsPipeline* FVulkan::SetGraphicsPipeline(const FGraphicsPipelineInitializ
 
     VkPipelineColorBlendAttachmentState colorBlendAttachment{};
     colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    colorBlendAttachment.blendEnable = VK_FALSE;
+    colorBlendAttachment.blendEnable = State.bBlendEnable ? VK_TRUE : VK_FALSE;
+    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
 
     VkPipelineColorBlendStateCreateInfo colorBlending{};
     colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
@@ -925,24 +1592,26 @@ FGraphicsPipeline* FVulkan::SetGraphicsPipeline(const FGraphicsPipelineInitializ
     dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
     dynamicState.pDynamicStates = dynamicStates.data();
 
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 0;
-    pipelineLayoutInfo.pushConstantRangeCount = 0;
+    // All graphics pipelines share the bindless layout so the heap stays bound across pipeline changes
+    VkPipelineLayout PipeLineLayout = FBindlessHeap::GetPipelineLayout();
 
-    VkPipelineLayout PipeLineLayout = VK_NULL_HANDLE;
-    if (vkCreatePipelineLayout(FVulkan::GetDevice(), &pipelineLayoutInfo, nullptr, &PipeLineLayout) != VK_SUCCESS)
-    {
-        fatal("FVulkan::SetGraphicsPipeline Failed creating pipeline layout");
-    }
+    const FRenderPass* RenderPass = PSOInitializer.RenderPass;
+    VkPipelineDepthStencilStateCreateInfo DepthStencil{};
+    DepthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    DepthStencil.depthTestEnable = State.bDepthTest ? VK_TRUE : VK_FALSE;
+    DepthStencil.depthWriteEnable = State.bDepthWrite ? VK_TRUE : VK_FALSE;
+    DepthStencil.depthCompareOp = State.DepthCompareOp;
 
-    if(!PSOInitializer.VertexInput)
-    {
-        fatal("FVulkan::SetGraphicsPipeline No valid vertex input creating the graphics pipeline");
-    }
+    VkPipelineRenderingCreateInfo RenderingCreateInfo{};
+    RenderingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    RenderingCreateInfo.colorAttachmentCount = static_cast<uint32_t>(RenderPass->ColorFormats.size());
+    RenderingCreateInfo.pColorAttachmentFormats = RenderPass->ColorFormats.data();
+    RenderingCreateInfo.depthAttachmentFormat = RenderPass->DepthFormat;
+    RenderingCreateInfo.stencilAttachmentFormat = HasStencilComponent(RenderPass->DepthFormat) ? RenderPass->DepthFormat : VK_FORMAT_UNDEFINED;
 
     VkGraphicsPipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = bDynamicRendering ? &RenderingCreateInfo : nullptr;
     pipelineInfo.stageCount = static_cast<uint32_t>(ShaderStages.size());
     pipelineInfo.pStages = ShaderStages.data();
     pipelineInfo.pVertexInputState = &PSOInitializer.VertexInput->GetInputVertexState();
@@ -950,11 +1619,11 @@ FGraphicsPipeline* FVulkan::SetGraphicsPipeline(const FGraphicsPipelineInitializ
     pipelineInfo.pViewportState = &viewportState;
     pipelineInfo.pRasterizationState = &rasterizer;
     pipelineInfo.pMultisampleState = &multisampling;
-    pipelineInfo.pDepthStencilState = nullptr; // Optional
+    pipelineInfo.pDepthStencilState = RenderPass->DepthFormat != VK_FORMAT_UNDEFINED ? &DepthStencil : nullptr;
     pipelineInfo.pColorBlendState = &colorBlending;
     pipelineInfo.pDynamicState = &dynamicState;
     pipelineInfo.layout = PipeLineLayout;
-    pipelineInfo.renderPass = PSOInitializer.RenderPass->RenderPass;
+    pipelineInfo.renderPass = RenderPass->RenderPass;
     pipelineInfo.subpass = 0;
 
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
@@ -967,26 +1636,54 @@ FGraphicsPipeline* FVulkan::SetGraphicsPipeline(const FGraphicsPipelineInitializ
     }
 
     FGraphicsPipeline* NewGraphics = new FGraphicsPipeline(GraphicsPipeline, PipeLineLayout);
-    PSOs[Id] = NewGraphics;
+    PSOs[Key] = NewGraphics;
     VK_LOG(LOG_SUCCESS, "Creating graphics PSO render pass: %s", PSOInitializer.RenderPass->RenderPassName.c_str());
 
-    vkCmdBindPipeline(GraphicsCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, NewGraphics->GetGraphicsPipeline());
+    BindGraphicsPipeline(NewGraphics->GetGraphicsPipeline());
     
     return NewGraphics;
 }
 
+void FVulkan::BindGraphicsPipeline(VkPipeline Pipeline)
+{
+    if(Pipeline == CurrentGraphicsPipeline)
+    {
+        GraphicsBindStats.ElidedBinds++;
+        return;
+    }
+    CurrentGraphicsPipeline = Pipeline;
+    GraphicsBindStats.PipelineBinds++;
+    vkCmdBindPipeline(GraphicsCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, Pipeline);
+}
+
 void FVulkan::BindStreamResource(int Index, std::shared_ptr<FVulkanBuffer> Buffer, uint64_t Offset)
 {
     if(Buffer)
     {
+        checkf(Index >= 0 && Index < MaxVertexStreams, "FVulkan::BindStreamResource stream index %i out of range", Index);
+        if(CurrentVertexBuffers[Index] == Buffer->Buffer && CurrentVertexOffsets[Index] == Offset)
+        {
+            GraphicsBindStats.ElidedBinds++;
+            return;
+        }
+        CurrentVertexBuffers[Index] = Buffer->Buffer;
+        CurrentVertexOffsets[Index] = Offset;
+        GraphicsBindStats.VertexBufferBinds++;
+        
         VkDeviceSize offsets[] = { Offset };
         vkCmdBindVertexBuffers(GraphicsCommandBuffer, Index, 1, &Buffer->Buffer, offsets);
     }
 }
 
-void FVulkan::DrawPrimitive(uint32_t BaseVertexIndex, uint32_t VertexCount, uint32_t NumInstances)
+void FVulkan::DrawPrimitive(uint32_t BaseVertexIndex, uint32_t VertexCount, uint32_t NumInstances, uint32_t FirstInstance)
 {
-    vkCmdDraw(GraphicsCommandBuffer, VertexCount, NumInstances, BaseVertexIndex, 0);
+    vkCmdDraw(GraphicsCommandBuffer, VertexCount, NumInstances, BaseVertexIndex, FirstInstance);
+}
+
+void FVulkan::SetPushConstants(const void* Data, uint32_t Size, uint32_t Offset)
+{
+    checkf(Offset + Size <= FBindlessHeap::MaxPushConstantSize, "FVulkan::SetPushConstants Push constants out of range %i", Offset + Size);
+    vkCmdPushConstants(GraphicsCommandBuffer, FBindlessHeap::GetPipelineLayout(), VK_SHADER_STAGE_ALL, Offset, Size, Data);
 }
 
 void FVulkan::SetScissorRect(bool bEnabled, int32_t MinX, int32_t MinY, uint32_t MaxX, uint32_t MaxY)
@@ -1014,29 +1711,82 @@ void FVulkan::SetViewport(float MinX, float MinY, float MinZ, float MaxX, float
 
 void FVulkan::EndRenderPass()
 {
-    vkCmdEndRenderPass(GraphicsCommandBuffer);
+    if(!bDynamicRendering)
+    {
+        vkCmdEndRenderPass(GraphicsCommandBuffer);
+        return;
+    }
+
+    vkCmdEndRendering(GraphicsCommandBuffer);
+
+    // Same final layout the render pass fallback declares for its color attachments
+    std::array<VkImageMemoryBarrier, MaxRenderTargets> Barriers;
+    for (uint32_t i = 0; i < CurrentColorTargetNum; ++i)
+    {
+        VkImageMemoryBarrier& Barrier = Barriers[i];
+        Barrier = {};
+        Barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        Barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        Barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        Barrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        Barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        Barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        Barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        Barrier.image = CurrentColorTargets[i];
+        Barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    }
+
+    vkCmdPipelineBarrier(
+        GraphicsCommandBuffer,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0,
+        0, nullptr,
+        0, nullptr,
+        CurrentColorTargetNum, Barriers.data());
+    CurrentColorTargetNum = 0;
 }
 
 void FVulkan::ResetGraphicsCommandBuffer()
 {
+    // The command buffer can only be recycled once its last submission executed
+    GetQueue(EQueueType::Graphics).Wait(GraphicsCommandBufferValue);
     vkResetCommandBuffer(GraphicsCommandBuffer, 0);
+    vkResetDescriptorPool(Device, GraphicsDescriptorPool, 0);
 
     VkCommandBufferBeginInfo beginInfo{};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     vkBeginCommandBuffer(GraphicsCommandBuffer, &beginInfo);
+    bGraphicsRecording = true;
+
+    // A fresh command buffer has nothing bound
+    CurrentGraphicsPipeline = VK_NULL_HANDLE;
+    CurrentVertexBuffers.fill(VK_NULL_HANDLE);
+    CurrentVertexOffsets.fill(0);
+    CurrentUniformOffset = UINT32_MAX;
+    GraphicsBindStats = {};
+
+    // Update-after-bind, the heap is bound once and descriptors written later are still seen at submit
+    FBindlessHeap::Bind(GraphicsCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS);
+    FUniformStreamAllocator::BeginFrame(GetQueue(EQueueType::Graphics).GetNextValue());
+    FGpuProfiler::BeginFrame(GraphicsCommandBuffer, GetQueue(EQueueType::Graphics).GetNextValue(), GetQueue(EQueueType::Graphics).GetCompletedValue());
+
+    // Uploads finished on the transfer queue are usable by everything recorded after this
+    FAsyncUpload::AcquireCompleted();
 }
 
-void FVulkan::EndGraphicsCommandBuffer()
+FGraphicsBindStats FVulkan::GetGraphicsBindStats()
 {
-    vkEndCommandBuffer(GraphicsCommandBuffer);
-
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &GraphicsCommandBuffer;
+    return GraphicsBindStats;
+}
 
-    vkQueueSubmit(GraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(GraphicsQueue); 
+uint64_t FVulkan::EndGraphicsCommandBuffer(const FSubmitSemaphores& Semaphores)
+{
+    vkEndCommandBuffer(GraphicsCommandBuffer);
+    bGraphicsRecording = false;
+    FBindlessHeap::FlushUpdates();
+    GraphicsCommandBufferValue = GetQueue(EQueueType::Graphics).Submit(&GraphicsCommandBuffer, 1, Semaphores);
+    return GraphicsCommandBufferValue;
 }
 
 void FVulkan::TransitionBarrier(const std::shared_ptr<FVulkanTexture> Input, const std::shared_ptr<FVulkanTexture> TransitionTo)
@@ -1045,7 +1795,7 @@ void FVulkan::TransitionBarrier(const std::shared_ptr<FVulkanTexture> Input, con
     barrier1.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
     barrier1.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
     barrier1.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-    barrier1.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier1.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
     barrier1.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
     barrier1.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
     barrier1.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
@@ -1117,3 +1867,489 @@ void FVulkan::CopyTexture(const std::shared_ptr<FVulkanTexture> Source, const st
     );
 }
 
+void FVulkan::CopyStagingToTexture(const FUniformAllocation& Staging, const std::shared_ptr<FVulkanTexture>& Texture, const std::vector<VkBufferImageCopy>& Regions, VkImageLayout OldLayout, VkImageLayout NewLayout)
+{
+    check(Staging.IsValid() && Texture && Texture->IsValid());
+    if(Regions.empty())
+    {
+        return;
+    }
+
+    VkImageMemoryBarrier Barrier{};
+    Barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    Barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    Barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    Barrier.oldLayout = OldLayout;
+    Barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    Barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    Barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    Barrier.image = Texture->Image;
+    Barrier.subresourceRange.aspectMask = GetFormatBarrierAspect(Texture->Format);
+    Barrier.subresourceRange.baseMipLevel = 0;
+    Barrier.subresourceRange.levelCount = Texture->MipLevels;
+    Barrier.subresourceRange.baseArrayLayer = 0;
+    Barrier.subresourceRange.layerCount = Texture->ArrayLayers;
+    vkCmdPipelineBarrier(GraphicsCommandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &Barrier);
+
+    std::vector<VkBufferImageCopy> CopyRegions = Regions;
+    for(VkBufferImageCopy& Region : CopyRegions)
+    {
+        Region.bufferOffset += Staging.Offset;
+    }
+    vkCmdCopyBufferToImage(GraphicsCommandBuffer, FUniformStreamAllocator::GetBuffer(), Texture->Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(CopyRegions.size()), CopyRegions.data());
+
+    Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    Barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    Barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    Barrier.newLayout = NewLayout;
+    vkCmdPipelineBarrier(GraphicsCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &Barrier);
+}
+
+
+FReadbackFuture FVulkan::ReadbackTexture(const std::shared_ptr<FVulkanTexture>& Texture, VkImageLayout Layout, uint32_t MipLevel, uint32_t ArrayLayer)
+{
+    check(Texture && Texture->IsValid());
+    checkf(Texture->Usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT, "FVulkan::ReadbackTexture %s was created without TRANSFER_SRC usage", Texture->ResourceName.c_str());
+    checkf(MipLevel < Texture->MipLevels && ArrayLayer < Texture->ArrayLayers, "FVulkan::ReadbackTexture %s subresource out of range", Texture->ResourceName.c_str());
+    checkf(Texture->Samples == VK_SAMPLE_COUNT_1_BIT, "FVulkan::ReadbackTexture %s is multisampled, resolve it first", Texture->ResourceName.c_str());
+    const uint32_t TexelSize = GetReadbackTexelSize(Texture->Format);
+    checkf(TexelSize != 0, "FVulkan::ReadbackTexture %s format %i is not supported", Texture->ResourceName.c_str(), Texture->Format);
+
+    const uint32_t Width = std::max(1u, Texture->SizeX >> MipLevel);
+    const uint32_t Height = std::max(1u, Texture->SizeY >> MipLevel);
+    const uint32_t Depth = std::max(1u, Texture->SizeZ >> MipLevel);
+    const VkImageAspectFlags Aspect = GetFormatAspect(Texture->Format);
+
+    VkBuffer TargetBuffer = VK_NULL_HANDLE;
+    FReadbackFuture Future = FGpuReadback::Allocate(static_cast<VkDeviceSize>(Width) * Height * Depth * TexelSize, Width * TexelSize, TargetBuffer);
+
+    VkImageMemoryBarrier Barrier{};
+    Barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    Barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+    Barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    Barrier.oldLayout = Layout;
+    Barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    Barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    Barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    Barrier.image = Texture->Image;
+    // The copy reads one aspect, the layout transition has to cover all of them
+    Barrier.subresourceRange.aspectMask = GetFormatBarrierAspect(Texture->Format);
+    Barrier.subresourceRange.baseMipLevel = MipLevel;
+    Barrier.subresourceRange.levelCount = 1;
+    Barrier.subresourceRange.baseArrayLayer = ArrayLayer;
+    Barrier.subresourceRange.layerCount = 1;
+    vkCmdPipelineBarrier(GraphicsCommandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &Barrier);
+
+    VkBufferImageCopy Region{};
+    Region.bufferOffset = 0;
+    Region.imageSubresource.aspectMask = Aspect;
+    Region.imageSubresource.mipLevel = MipLevel;
+    Region.imageSubresource.baseArrayLayer = ArrayLayer;
+    Region.imageSubresource.layerCount = 1;
+    Region.imageExtent = {Width, Height, Depth};
+    vkCmdCopyImageToBuffer(GraphicsCommandBuffer, Texture->Image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, TargetBuffer, 1, &Region);
+
+    Barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    Barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    Barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    Barrier.newLayout = Layout;
+    vkCmdPipelineBarrier(GraphicsCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &Barrier);
+
+    VkBufferMemoryBarrier HostBarrier{};
+    HostBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    HostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    HostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    HostBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    HostBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    HostBarrier.buffer = TargetBuffer;
+    HostBarrier.offset = 0;
+    HostBarrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(GraphicsCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &HostBarrier, 0, nullptr);
+    return Future;
+}
+
+FReadbackFuture FVulkan::ReadbackBuffer(const std::shared_ptr<FVulkanBuffer>& Buffer, VkDeviceSize Offset, VkDeviceSize Size)
+{
+    check(Buffer && Buffer->IsValid() && Size > 0);
+
+    VkBuffer TargetBuffer = VK_NULL_HANDLE;
+    FReadbackFuture Future = FGpuReadback::Allocate(Size, 0, TargetBuffer);
+
+    VkBufferMemoryBarrier Barrier{};
+    Barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    Barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+    Barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    Barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    Barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    Barrier.buffer = Buffer->Buffer;
+    Barrier.offset = Offset;
+    Barrier.size = Size;
+    vkCmdPipelineBarrier(GraphicsCommandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &Barrier, 0, nullptr);
+
+    VkBufferCopy Region{};
+    Region.srcOffset = Offset;
+    Region.dstOffset = 0;
+    Region.size = Size;
+    vkCmdCopyBuffer(GraphicsCommandBuffer, Buffer->Buffer, TargetBuffer, 1, &Region);
+
+    Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    Barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    Barrier.buffer = TargetBuffer;
+    Barrier.offset = 0;
+    Barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(GraphicsCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &Barrier, 0, nullptr);
+    return Future;
+}
+
+VkDescriptorPool FVulkan::CreateTransientDescriptorPool()
+{
+    std::vector<VkDescriptorPoolSize> PoolSizes = {
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4096},
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1024},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1024},
+        {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1024},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1024},
+    };
+
+    VkDescriptorPoolCreateInfo PoolCreateInfo{};
+    PoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    PoolCreateInfo.maxSets = 1024;
+    PoolCreateInfo.poolSizeCount = static_cast<uint32_t>(PoolSizes.size());
+    PoolCreateInfo.pPoolSizes = PoolSizes.data();
+
+    VkDescriptorPool Pool = VK_NULL_HANDLE;
+    if(vkCreateDescriptorPool(Device, &PoolCreateInfo, nullptr, &Pool) != VK_SUCCESS)
+    {
+        fatal("FVulkan::CreateTransientDescriptorPool Fail creating descriptor pool");
+    }
+    return Pool;
+}
+
+VkCommandBuffer FVulkan::GetCommandBuffer(EQueueType Type)
+{
+    return Type == EQueueType::Compute && bAsyncComputeRecording ? ComputeCommandBuffer : GraphicsCommandBuffer;
+}
+
+VkCommandBuffer FVulkan::GetComputeCommandBuffer()
+{
+    return GetCommandBuffer(EQueueType::Compute);
+}
+
+FComputePipeline* FVulkan::SetComputePipeline(const FComputePipelineInitializer& PSOInitializer)
+{
+    if(!PSOInitializer.ComputeShader || !PSOInitializer.ComputeShader->IsCompiled())
+    {
+        fatal("FVulkan::SetComputePipeline Failed creating compute pipeline, invalid shader");
+    }
+
+    PendingComputeBindings.clear();
+
+    uint32_t Id = GenerateUniqueId(PSOInitializer.ComputeShader->GetSource() + PSOInitializer.ComputeShader->GetEntryPoint());
+    auto it = ComputePSOs.find(Id);
+    if (it != ComputePSOs.end())
+    {
+        CurrentComputePipeline = it->second;
+        vkCmdBindPipeline(GetComputeCommandBuffer(), VK_PIPELINE_BIND_POINT_COMPUTE, CurrentComputePipeline->GetComputePipeline());
+        return CurrentComputePipeline;
+    }
+
+    std::vector<VkDescriptorSetLayoutBinding> LayoutBindings;
+    for (uint32_t i = 0; i < PSOInitializer.Bindings.size(); ++i)
+    {
+        VkDescriptorSetLayoutBinding& LayoutBinding = LayoutBindings.emplace_back();
+        LayoutBinding.binding = i;
+        LayoutBinding.descriptorType = PSOInitializer.Bindings[i];
+        LayoutBinding.descriptorCount = 1;
+        LayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo SetLayoutCreateInfo{};
+    SetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    SetLayoutCreateInfo.bindingCount = static_cast<uint32_t>(LayoutBindings.size());
+    SetLayoutCreateInfo.pBindings = LayoutBindings.data();
+
+    VkDescriptorSetLayout SetLayout = VK_NULL_HANDLE;
+    if(vkCreateDescriptorSetLayout(Device, &SetLayoutCreateInfo, nullptr, &SetLayout) != VK_SUCCESS)
+    {
+        fatal("FVulkan::SetComputePipeline Failed creating descriptor set layout");
+    }
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &SetLayout;
+
+    VkPipelineLayout PipeLineLayout = VK_NULL_HANDLE;
+    if (vkCreatePipelineLayout(Device, &pipelineLayoutInfo, nullptr, &PipeLineLayout) != VK_SUCCESS)
+    {
+        fatal("FVulkan::SetComputePipeline Failed creating pipeline layout");
+    }
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = PSOInitializer.ComputeShader->GetShader();
+    pipelineInfo.stage.pName = PSOInitializer.ComputeShader->GetEntryPoint().c_str();
+    pipelineInfo.layout = PipeLineLayout;
+
+    VkPipeline ComputePipeline = VK_NULL_HANDLE;
+    if (vkCreateComputePipelines(Device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &ComputePipeline) != VK_SUCCESS)
+    {
+        fatal("FVulkan::SetComputePipeline failed to create compute pipeline");
+    }
+
+    CurrentComputePipeline = new FComputePipeline(ComputePipeline, PipeLineLayout, SetLayout);
+    ComputePSOs[Id] = CurrentComputePipeline;
+    VK_LOG(LOG_SUCCESS, "Creating compute PSO: %s", PSOInitializer.ComputeShader->GetSource().c_str());
+
+    vkCmdBindPipeline(GetComputeCommandBuffer(), VK_PIPELINE_BIND_POINT_COMPUTE, CurrentComputePipeline->GetComputePipeline());
+    return CurrentComputePipeline;
+}
+
+void FVulkan::SetComputeBuffer(uint32_t Binding, const std::shared_ptr<FVulkanBuffer>& Buffer, uint64_t Offset, uint64_t Range)
+{
+    if(Buffer)
+    {
+        FComputeBinding& Elem = PendingComputeBindings.emplace_back();
+        Elem.Binding = Binding;
+        Elem.Type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        Elem.BufferInfo = {Buffer->Buffer, Offset, Range};
+        Elem.ImageInfo = {};
+    }
+}
+
+void FVulkan::SetComputeTexture(uint32_t Binding, const std::shared_ptr<FVulkanTexture>& Texture, VkImageLayout Layout)
+{
+    if(Texture)
+    {
+        FComputeBinding& Elem = PendingComputeBindings.emplace_back();
+        Elem.Binding = Binding;
+        Elem.Type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        Elem.BufferInfo = {};
+        Elem.ImageInfo = {VK_NULL_HANDLE, Texture->ImageView, Layout};
+    }
+}
+
+void FVulkan::FlushComputeBindings()
+{
+    if(!CurrentComputePipeline)
+    {
+        fatal("FVulkan::Dispatch No compute pipeline set");
+    }
+
+    if(PendingComputeBindings.empty())
+    {
+        return;
+    }
+
+    // Sets are transient, the pool is reset together with the command buffer that used them
+    VkDescriptorSetAllocateInfo AllocateInfo{};
+    AllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    AllocateInfo.descriptorPool = bAsyncComputeRecording ? ComputeDescriptorPool : GraphicsDescriptorPool;
+    AllocateInfo.descriptorSetCount = 1;
+    AllocateInfo.pSetLayouts = &CurrentComputePipeline->GetDescriptorSetLayout();
+
+    VkDescriptorSet DescriptorSet = VK_NULL_HANDLE;
+    if(vkAllocateDescriptorSets(Device, &AllocateInfo, &DescriptorSet) != VK_SUCCESS)
+    {
+        fatal("FVulkan::Dispatch Transient descriptor pool exhausted");
+    }
+
+    std::vector<VkWriteDescriptorSet> Writes;
+    Writes.reserve(PendingComputeBindings.size());
+    for(const FComputeBinding& Elem : PendingComputeBindings)
+    {
+        VkWriteDescriptorSet& Write = Writes.emplace_back();
+        Write = {};
+        Write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        Write.dstSet = DescriptorSet;
+        Write.dstBinding = Elem.Binding;
+        Write.descriptorCount = 1;
+        Write.descriptorType = Elem.Type;
+        Write.pBufferInfo = Elem.Type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER ? &Elem.BufferInfo : nullptr;
+        Write.pImageInfo = Elem.Type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE ? &Elem.ImageInfo : nullptr;
+    }
+    vkUpdateDescriptorSets(Device, static_cast<uint32_t>(Writes.size()), Writes.data(), 0, nullptr);
+    vkCmdBindDescriptorSets(GetComputeCommandBuffer(), VK_PIPELINE_BIND_POINT_COMPUTE, CurrentComputePipeline->GetPipelineLayout(), 0, 1, &DescriptorSet, 0, nullptr);
+    PendingComputeBindings.clear();
+}
+
+void FVulkan::Dispatch(uint32_t GroupCountX, uint32_t GroupCountY, uint32_t GroupCountZ)
+{
+    FlushComputeBindings();
+    vkCmdDispatch(GetComputeCommandBuffer(), GroupCountX, GroupCountY, GroupCountZ);
+}
+
+void FVulkan::DispatchIndirect(const std::shared_ptr<FVulkanBuffer>& ArgumentBuffer, uint64_t Offset)
+{
+    if(ArgumentBuffer)
+    {
+        FlushComputeBindings();
+        vkCmdDispatchIndirect(GetComputeCommandBuffer(), ArgumentBuffer->Buffer, Offset);
+    }
+}
+
+bool FVulkan::SupportsAsyncCompute()
+{
+    return ComputeIndex != GraphicsIndex;
+}
+
+bool FVulkan::SupportsAsyncTransfer()
+{
+    return TransferIndex != GraphicsIndex;
+}
+
+bool FVulkan::SupportsDynamicRendering()
+{
+    return bDynamicRendering;
+}
+
+bool FVulkan::SupportsPresentWait()
+{
+    return bPresentWait;
+}
+
+bool FVulkan::WaitForPresent(VkSwapchainKHR SwapChain, uint64_t PresentId, uint64_t Timeout)
+{
+    if(!bPresentWait || PresentId == 0)
+    {
+        return true;
+    }
+    return vkWaitForPresentKHR(Device, SwapChain, PresentId, Timeout) == VK_SUCCESS;
+}
+
+void FVulkan::BeginAsyncCompute(const FQueueOwnershipTransfer& Inputs)
+{
+    if(!SupportsAsyncCompute())
+    {
+        // Same queue, a barrier against previous graphics work is all we need
+        VkMemoryBarrier Barrier{};
+        Barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        Barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+        Barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(GraphicsCommandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &Barrier, 0, nullptr, 0, nullptr);
+        return;
+    }
+
+    GetQueue(EQueueType::Compute).Wait(ComputeCommandBufferValue);
+    vkResetCommandBuffer(ComputeCommandBuffer, 0);
+    vkResetDescriptorPool(Device, ComputeDescriptorPool, 0);
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(ComputeCommandBuffer, &beginInfo);
+    bAsyncComputeRecording = true;
+
+    // Inputs were released by graphics work that is already submitted, never wait on the frame being recorded
+    if(!Inputs.IsEmpty())
+    {
+        AcquireQueueOwnership(EQueueType::Graphics, EQueueType::Compute, Inputs);
+    }
+    GetQueue(EQueueType::Compute).AddDependency(GetQueue(EQueueType::Graphics).GetLastSyncPoint(), VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+}
+
+FQueueSyncPoint FVulkan::EndAsyncCompute(const FQueueOwnershipTransfer& Outputs, VkPipelineStageFlags GraphicsWaitStage)
+{
+    CurrentComputePipeline = nullptr;
+    PendingComputeBindings.clear();
+
+    if(!bAsyncComputeRecording)
+    {
+        VkMemoryBarrier Barrier{};
+        Barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        Barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        Barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+        vkCmdPipelineBarrier(GraphicsCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, GraphicsWaitStage, 0, 1, &Barrier, 0, nullptr, 0, nullptr);
+        return {EQueueType::Graphics, GetQueue(EQueueType::Graphics).GetNextValue()};
+    }
+
+    if(!Outputs.IsEmpty())
+    {
+        ReleaseQueueOwnership(EQueueType::Compute, EQueueType::Graphics, Outputs);
+    }
+
+    vkEndCommandBuffer(ComputeCommandBuffer);
+    bAsyncComputeRecording = false;
+    FBindlessHeap::FlushUpdates();
+    ComputeCommandBufferValue = GetQueue(EQueueType::Compute).Submit(&ComputeCommandBuffer, 1);
+
+    // Graphics only stalls at the stage that consumes the results, earlier stages keep overlapping
+    FQueueSyncPoint SyncPoint = GetQueue(EQueueType::Compute).GetLastSyncPoint();
+    GetQueue(EQueueType::Graphics).AddDependency(SyncPoint, GraphicsWaitStage);
+    if(!Outputs.IsEmpty())
+    {
+        checkf(bGraphicsRecording, "FVulkan::EndAsyncCompute Outputs can only be acquired while the graphics command buffer is recording");
+        AcquireQueueOwnership(EQueueType::Compute, EQueueType::Graphics, Outputs);
+    }
+    return SyncPoint;
+}
+
+void FVulkan::ReleaseQueueOwnership(EQueueType Source, EQueueType Target, const FQueueOwnershipTransfer& Resources)
+{
+    RecordOwnershipBarrier(GetCommandBuffer(Source), Source, Target, Resources, true);
+}
+
+void FVulkan::AcquireQueueOwnership(EQueueType Source, EQueueType Target, const FQueueOwnershipTransfer& Resources)
+{
+    RecordOwnershipBarrier(GetCommandBuffer(Target), Source, Target, Resources, false);
+}
+
+void FVulkan::RecordOwnershipBarrier(VkCommandBuffer CommandBuffer, EQueueType Source, EQueueType Target, const FQueueOwnershipTransfer& Resources, bool bRelease)
+{
+    const uint32_t SourceFamily = GetQueue(Source).GetFamilyIndex();
+    const uint32_t TargetFamily = GetQueue(Target).GetFamilyIndex();
+    if(SourceFamily == TargetFamily)
+    {
+        return;
+    }
+
+    // Release only needs the source writes done, acquire makes them visible on the target
+    const VkAccessFlags SrcAccess = bRelease ? VK_ACCESS_MEMORY_WRITE_BIT : 0;
+    const VkAccessFlags DstAccess = bRelease ? 0 : VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+    std::vector<VkBufferMemoryBarrier> BufferBarriers;
+    for(const std::shared_ptr<FVulkanBuffer>& Buffer : Resources.Buffers)
+    {
+        VkBufferMemoryBarrier& Barrier = BufferBarriers.emplace_back();
+        Barrier = {};
+        Barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        Barrier.srcAccessMask = SrcAccess;
+        Barrier.dstAccessMask = DstAccess;
+        Barrier.srcQueueFamilyIndex = SourceFamily;
+        Barrier.dstQueueFamilyIndex = TargetFamily;
+        Barrier.buffer = Buffer->Buffer;
+        Barrier.offset = 0;
+        Barrier.size = VK_WHOLE_SIZE;
+    }
+
+    std::vector<VkImageMemoryBarrier> ImageBarriers;
+    for(const std::shared_ptr<FVulkanTexture>& Texture : Resources.Textures)
+    {
+        VkImageMemoryBarrier& Barrier = ImageBarriers.emplace_back();
+        Barrier = {};
+        Barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        Barrier.srcAccessMask = SrcAccess;
+        Barrier.dstAccessMask = DstAccess;
+        Barrier.oldLayout = Resources.TextureLayout;
+        Barrier.newLayout = Resources.TextureLayout;
+        Barrier.srcQueueFamilyIndex = SourceFamily;
+        Barrier.dstQueueFamilyIndex = TargetFamily;
+        Barrier.image = Texture->Image;
+        Barrier.subresourceRange.aspectMask = GetFormatBarrierAspect(Texture->Format);
+        Barrier.subresourceRange.baseMipLevel = 0;
+        Barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+        Barrier.subresourceRange.baseArrayLayer = 0;
+        Barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+    }
+
+    vkCmdPipelineBarrier(
+        CommandBuffer,
+        bRelease ? VK_PIPELINE_STAGE_ALL_COMMANDS_BIT : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        bRelease ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        0,
+        0, nullptr,
+        static_cast<uint32_t>(BufferBarriers.size()), BufferBarriers.data(),
+        static_cast<uint32_t>(ImageBarriers.size()), ImageBarriers.data());
+}
@@ -1,25 +1,43 @@
 ﻿#pragma once
+#include <array>
 #include <map>
 #include <string>
 #include <vector>
 #include "vulkan/vulkan_core.h"
+#include "GpuReadback.h"
+#include "PipelineKeys.h"
 #include "RenderResources.h"
-#include <Windows.h>
+#include "UniformStreamAllocator.h"
+#include "VulkanQueue.h"
+
+class FRenderWindow;
+enum class EWindowBackend : uint8_t;
+
+// Binds issued and skipped on the graphics command buffer since it was last reset
+struct FGraphicsBindStats
+{
+    uint32_t PipelineBinds = 0;
+    uint32_t VertexBufferBinds = 0;
+    uint32_t UniformBinds = 0;
+    uint32_t ElidedBinds = 0;
+};
 
 class FVulkan
 {
 public:
-    static HWND CreateDummyWindow(HINSTANCE hInstance);
-    static void CreateVulkanInstance(const std::string& ApplicationName);
+    // Enables the surface extensions of the window backend the device will present to
+    static void CreateVulkanInstance(const std::string& ApplicationName, EWindowBackend WindowBackend);
     static void CreateVulkanDebugLayer();
     static void DestroyVulkanDebugLayer();
-    static void CreateVulkanDevice(HINSTANCE hInstance);
+    // The present family is picked against the window surface, headless windows get a device without swap chain support.
+    // PreferredDevice is a device name or UUID overriding the scored pick, see FDeviceSelector
+    static void CreateVulkanDevice(const FRenderWindow& Window, const std::string& PreferredDevice = "");
     static void ExitVulkan();
     
-    static VkSurfaceKHR CreateSurface(HINSTANCE hInstance, HWND hwnd);
     static VkBool32 GetSupportedDepthFormat(VkFormat* depthFormat);
     static VkQueue GetGraphicsQueue();
     static VkQueue GetPresentQueue();
+    static FVulkanQueue& GetQueue(EQueueType Type);
     static VkCommandBuffer& GetGraphicsBuffer();
 
     static std::vector<std::string> GetSupportedExtensions();
@@ -29,37 +47,99 @@ public:
     static uint32_t GetMajorVersion();
     static uint32_t GetMinorVersion();
     static uint32_t FindMemoryType(const VkPhysicalDevice& PhysicalDevice, uint32_t TypeFilter, VkMemoryPropertyFlags MemoryPropertyFlags);
+
+    // Frame tracking, resources released while recording are destroyed once the graphics timeline passes them
+    static uint64_t GetFrameNumber();
+    static void AdvanceFrame();
+    static void ReleaseRetiredResources();
     
     // Resources
     static void CreateImage(uint32_t Width, uint32_t Height, VkFormat Format, VkImageTiling Tiling, VkImageUsageFlags ImageUsageFlags, VkMemoryPropertyFlags MemoryPropertyFlags, VkImage& Image, VkDeviceMemory& ImageMemory);
     static VkImageView CreateImageView(VkImage Image, VkFormat Format, VkImageAspectFlags AspectFlags);
     
-    static std::shared_ptr<FVulkanTexture> CreateTexture(uint32_t X, uint32_t Y, VkFormat Format, VkImageUsageFlags Flags, VkMemoryPropertyFlags MemoryFlags, const std::string& TextureName = "Texture", VkImageTiling Tilling = VK_IMAGE_TILING_LINEAR, VkImageAspectFlags AspectFlags = VK_IMAGE_ASPECT_COLOR_BIT);
+    // Validated against the format features and image limits of the physical device, fatal when unsupported
+    static std::shared_ptr<FVulkanTexture> CreateTexture(const FTextureDesc& Desc);
     static void ReleaseTexture(std::shared_ptr<FVulkanTexture>& Texture);
     
     static std::shared_ptr<FVulkanBuffer> CreateBuffer(VkDeviceSize BufferSize, uint32_t ElemNumber, VkBufferUsageFlags BufferUsage, VkMemoryPropertyFlags MemoryProperties, const std::string& BufferName = "Buffer");
     static void UpdateBuffer(const std::shared_ptr<FVulkanBuffer>& Buffer, const void* BufferData, size_t BufferSize);
 
+    // Bindless, the returned index is what shaders read through push constants
+    static uint32_t MakeBindless(const std::shared_ptr<FVulkanTexture>& Texture, VkImageLayout Layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    static uint32_t MakeBindless(const std::shared_ptr<FVulkanBuffer>& Buffer);
+
+    // Per-draw uniforms, streamed from this frame's region and bound with a dynamic offset
+    static FUniformAllocation AllocateUniform(uint32_t Size);
+    static void BindUniform(const FUniformAllocation& Allocation);
+    static void SetUniformData(const void* Data, uint32_t Size);
+    // Per-instance vertex streams, streamed from the same frame region as the uniforms
+    static FUniformAllocation AllocateInstanceData(uint32_t Size);
+    static void BindInstanceStream(int Index, const FUniformAllocation& Allocation);
+    static FUniformAllocation AllocateStaging(uint32_t Size);
+    // Region buffer offsets are relative to the staging allocation, the whole texture moves from OldLayout to NewLayout
+    static void CopyStagingToTexture(const FUniformAllocation& Staging, const std::shared_ptr<FVulkanTexture>& Texture, const std::vector<VkBufferImageCopy>& Regions, VkImageLayout OldLayout, VkImageLayout NewLayout);
+
+    static bool SupportsDynamicRendering();
+    // VK_KHR_present_id + VK_KHR_present_wait, lets the frame pacer block until a present is on screen
+    static bool SupportsPresentWait();
+    static bool WaitForPresent(VkSwapchainKHR SwapChain, uint64_t PresentId, uint64_t Timeout);
     static FRenderPass* BeginRenderPass(const FRenderPassInfo& RenderPassInfo, VkExtent2D ViewSize, const std::string& RenderPassName);
+    // Frame buffers are created per view size, call when the view size changes so the old ones don't pile up
+    static void ReleaseFrameBuffers();
     static FGraphicsPipeline* SetGraphicsPipeline(const FGraphicsPipelineInitializer& PSOInitializer);
     static void BindStreamResource(int Index, std::shared_ptr<FVulkanBuffer> Buffer, uint64_t Offset);
-    static void DrawPrimitive(uint32_t BaseVertexIndex, uint32_t VertexCount, uint32_t NumInstances);
+    static void DrawPrimitive(uint32_t BaseVertexIndex, uint32_t VertexCount, uint32_t NumInstances, uint32_t FirstInstance = 0);
+    static void SetPushConstants(const void* Data, uint32_t Size, uint32_t Offset = 0);
     static void SetScissorRect(bool bEnabled, int32_t MinX, int32_t MinY, uint32_t MaxX, uint32_t MaxY);
     static void SetViewport(float MinX, float MinY, float MinZ, float MaxX, float MaxY, float MaxZ);
     static void EndRenderPass();
     static void ResetGraphicsCommandBuffer();
-    static void EndGraphicsCommandBuffer();
+    static FGraphicsBindStats GetGraphicsBindStats();
+    static uint64_t EndGraphicsCommandBuffer(const FSubmitSemaphores& Semaphores = {});
     static void TransitionBarrier(const std::shared_ptr<FVulkanTexture> Input, const std::shared_ptr<FVulkanTexture> TransitionTo);
     static void CopyTexture(const std::shared_ptr<FVulkanTexture> Source, const std::shared_ptr<FVulkanTexture> Target);
+    // Copies into a pooled readback buffer, the future resolves once this frame's submission retires.
+    // The texture needs TRANSFER_SRC usage and is returned to Layout afterwards
+    static FReadbackFuture ReadbackTexture(const std::shared_ptr<FVulkanTexture>& Texture, VkImageLayout Layout, uint32_t MipLevel = 0, uint32_t ArrayLayer = 0);
+    static FReadbackFuture ReadbackBuffer(const std::shared_ptr<FVulkanBuffer>& Buffer, VkDeviceSize Offset, VkDeviceSize Size);
+
+    // Compute, commands go to the async compute command buffer between Begin/EndAsyncCompute, otherwise inline on graphics
+    static FComputePipeline* SetComputePipeline(const FComputePipelineInitializer& PSOInitializer);
+    static void SetComputeBuffer(uint32_t Binding, const std::shared_ptr<FVulkanBuffer>& Buffer, uint64_t Offset = 0, uint64_t Range = VK_WHOLE_SIZE);
+    static void SetComputeTexture(uint32_t Binding, const std::shared_ptr<FVulkanTexture>& Texture, VkImageLayout Layout = VK_IMAGE_LAYOUT_GENERAL);
+    static void Dispatch(uint32_t GroupCountX, uint32_t GroupCountY, uint32_t GroupCountZ);
+    static void DispatchIndirect(const std::shared_ptr<FVulkanBuffer>& ArgumentBuffer, uint64_t Offset);
+    static bool SupportsAsyncCompute();
+    // A transfer-only queue family exists, FAsyncUpload copies on it from its own thread
+    static bool SupportsAsyncTransfer();
+    static void BeginAsyncCompute(const FQueueOwnershipTransfer& Inputs = {});
+    static FQueueSyncPoint EndAsyncCompute(const FQueueOwnershipTransfer& Outputs = {}, VkPipelineStageFlags GraphicsWaitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    static void ReleaseQueueOwnership(EQueueType Source, EQueueType Target, const FQueueOwnershipTransfer& Resources);
+    static void AcquireQueueOwnership(EQueueType Source, EQueueType Target, const FQueueOwnershipTransfer& Resources);
 
 
 private:
-    static FRenderPass* GetOrCreateRenderPass(const FRenderPassInfo& RenderPassInfo,  VkExtent2D ViewSize, const std::string& RenderPassName);
-    static void SelectPhysicalDevice();
+    // Benchmarks the private cache lookups directly
+    friend class FRhiBenchmark;
+    // Records the transfer side ownership release on its own command buffers
+    friend class FAsyncUpload;
+
+    static FRenderPass* GetOrCreateRenderPass(const FRenderPassInfo& RenderPassInfo, const std::string& RenderPassName);
+    static VkRenderPass GetOrCreateCompatibleRenderPass(const FRenderPassKey& CompatibilityKey);
+    static VkFramebuffer GetOrCreateFrameBuffer(const FRenderPass* RenderPass, const FRenderPassInfo& RenderPassInfo, VkExtent2D ViewSize);
+    static void BeginDynamicRendering(const FRenderPassInfo& RenderPassInfo, VkExtent2D ViewSize);
+    static void BindGraphicsPipeline(VkPipeline Pipeline);
+    static void SelectPhysicalDevice(VkSurfaceKHR Surface, const std::string& PreferredDevice);
+    static VkCommandBuffer GetCommandBuffer(EQueueType Type);
+    static VkCommandBuffer GetComputeCommandBuffer();
+    static VkDescriptorPool CreateTransientDescriptorPool();
+    static void FlushComputeBindings();
+    static void RecordOwnershipBarrier(VkCommandBuffer CommandBuffer, EQueueType Source, EQueueType Target, const FQueueOwnershipTransfer& Resources, bool bRelease);
     
 private:
     static std::map<std::uint32_t, FRenderPass*> RenderPasses;
-    static std::map<std::uint32_t, FGraphicsPipeline*> PSOs;
+    static std::map<FGraphicsPipelineKey, FGraphicsPipeline*> PSOs;
+    static std::map<std::uint32_t, FComputePipeline*> ComputePSOs;
 
     static VkInstance Instance;
     static VkDevice Device;
@@ -68,15 +148,68 @@ private:
     static PFN_vkCreateDebugUtilsMessengerEXT vkCreateDebugUtilsMessengerEXT;
     static PFN_vkDestroyDebugUtilsMessengerEXT vkDestroyDebugUtilsMessengerEXT;
     static VkDebugUtilsMessengerEXT DebugUtilsMessenger;
+    static PFN_vkWaitForPresentKHR vkWaitForPresentKHR;
+    static bool bPresentWait;
+    // Cube array views need the optional imageCubeArray feature
+    static bool bImageCubeArray;
 
     static uint32_t GraphicsIndex;
     static uint32_t ComputeIndex;
     static uint32_t PresentIndex;
+    static uint32_t TransferIndex;
     static VkQueue GraphicsQueue;
     static VkQueue PresentQueue;
     static VkQueue ComputeQueue;
+    static VkQueue TransferQueue;
     static uint32_t MajorVersion;
     static uint32_t MinorVersion;
+    static uint64_t FrameNumber;
+    static FVulkanQueue Queues[static_cast<uint32_t>(EQueueType::Num)];
     static VkCommandPool GraphicsCommandPool;
     static VkCommandBuffer GraphicsCommandBuffer;
+    static uint64_t GraphicsCommandBufferValue;
+    static bool bGraphicsRecording;
+    static VkDescriptorPool GraphicsDescriptorPool;
+
+    static VkCommandPool ComputeCommandPool;
+    static VkCommandBuffer ComputeCommandBuffer;
+    static uint64_t ComputeCommandBufferValue;
+    static bool bAsyncComputeRecording;
+    static VkDescriptorPool ComputeDescriptorPool;
+
+    struct FComputeBinding
+    {
+        uint32_t Binding;
+        VkDescriptorType Type;
+        VkDescriptorBufferInfo BufferInfo;
+        VkDescriptorImageInfo ImageInfo;
+    };
+    static FComputePipeline* CurrentComputePipeline;
+    static std::vector<FComputeBinding> PendingComputeBindings;
+
+    // Render passes, dynamic rendering when supported, otherwise render passes shared by attachment layout
+    static bool bDynamicRendering;
+    static std::map<FRenderPassKey, VkRenderPass> CompatibleRenderPasses;
+    // Everything an imageless frame buffer is created from
+    struct FFrameBufferKey
+    {
+        FRenderPassKey CompatibilityKey;
+        uint32_t Width;
+        uint32_t Height;
+        uint32_t TargetNum;
+        std::array<VkImageUsageFlags, MaxRenderTargets + 1> Usages;
+        std::array<VkFormat, MaxRenderTargets + 1> Formats;
+
+        bool operator<(const FFrameBufferKey& Other) const;
+    };
+    static std::map<FFrameBufferKey, VkFramebuffer> FrameBuffers;
+    static std::array<VkImage, MaxRenderTargets> CurrentColorTargets;
+    static uint32_t CurrentColorTargetNum;
+
+    // State already recorded into the graphics command buffer, binding it again is skipped
+    static VkPipeline CurrentGraphicsPipeline;
+    static std::array<VkBuffer, MaxVertexStreams> CurrentVertexBuffers;
+    static std::array<VkDeviceSize, MaxVertexStreams> CurrentVertexOffsets;
+    static uint32_t CurrentUniformOffset;
+    static FGraphicsBindStats GraphicsBindStats;
 };
@@ -0,0 +1,246 @@
+﻿#include "VulkanQueue.h"
+#include <algorithm>
+#include "VulkanInterface.h"
+#include "Core/Assertion.h"
+
+void FTimelineSemaphore::Create(uint64_t InitialValue)
+{
+    VkSemaphoreTypeCreateInfo TypeCreateInfo{};
+    TypeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    TypeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    TypeCreateInfo.initialValue = InitialValue;
+
+    VkSemaphoreCreateInfo SemaphoreCreateInfo{};
+    SemaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    SemaphoreCreateInfo.pNext = &TypeCreateInfo;
+
+    if(vkCreateSemaphore(FVulkan::GetDevice(), &SemaphoreCreateInfo, nullptr, &Semaphore) != VK_SUCCESS)
+    {
+        fatal("FTimelineSemaphore::Create Fail creating timeline semaphore");
+    }
+    CachedCompletedValue = InitialValue;
+}
+
+void FTimelineSemaphore::Release()
+{
+    if(IsValid())
+    {
+        vkDestroySemaphore(FVulkan::GetDevice(), Semaphore, nullptr);
+        Semaphore = VK_NULL_HANDLE;
+    }
+}
+
+bool FTimelineSemaphore::IsValid() const
+{
+    return Semaphore != VK_NULL_HANDLE;
+}
+
+uint64_t FTimelineSemaphore::GetCompletedValue() const
+{
+    uint64_t Value = 0;
+    if(vkGetSemaphoreCounterValue(FVulkan::GetDevice(), Semaphore, &Value) == VK_SUCCESS)
+    {
+        return UpdateCompletedValue(Value);
+    }
+    return CachedCompletedValue.load(std::memory_order_acquire);
+}
+
+uint64_t FTimelineSemaphore::UpdateCompletedValue(uint64_t Value) const
+{
+    // Two threads can read the counter at different times, only ever raise the cached value
+    uint64_t Cached = CachedCompletedValue.load(std::memory_order_relaxed);
+    while(Value > Cached && !CachedCompletedValue.compare_exchange_weak(Cached, Value, std::memory_order_release, std::memory_order_relaxed))
+    {
+    }
+    return std::max(Value, Cached);
+}
+
+bool FTimelineSemaphore::IsComplete(uint64_t Value) const
+{
+    if(Value <= CachedCompletedValue.load(std::memory_order_acquire))
+    {
+        return true;
+    }
+    return GetCompletedValue() >= Value;
+}
+
+bool FTimelineSemaphore::Wait(uint64_t Value, uint64_t Timeout) const
+{
+    if(Value <= CachedCompletedValue.load(std::memory_order_acquire))
+    {
+        return true;
+    }
+
+    VkSemaphoreWaitInfo WaitInfo{};
+    WaitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    WaitInfo.semaphoreCount = 1;
+    WaitInfo.pSemaphores = &Semaphore;
+    WaitInfo.pValues = &Value;
+    if(vkWaitSemaphores(FVulkan::GetDevice(), &WaitInfo, Timeout) != VK_SUCCESS)
+    {
+        return false;
+    }
+
+    UpdateCompletedValue(Value);
+    return true;
+}
+
+void FTimelineSemaphore::Signal(uint64_t Value)
+{
+    VkSemaphoreSignalInfo SignalInfo{};
+    SignalInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO;
+    SignalInfo.semaphore = Semaphore;
+    SignalInfo.value = Value;
+    vkSignalSemaphore(FVulkan::GetDevice(), &SignalInfo);
+}
+
+const VkSemaphore& FTimelineSemaphore::GetSemaphore() const
+{
+    return Semaphore;
+}
+
+void FVulkanQueue::Init(EQueueType InType, VkQueue InQueue, uint32_t InFamilyIndex)
+{
+    Type = InType;
+    Queue = InQueue;
+    FamilyIndex = InFamilyIndex;
+    LastSubmittedValue = 0;
+    Timeline.Create(0);
+}
+
+void FVulkanQueue::Release()
+{
+    Timeline.Release();
+    PendingWaits.clear();
+    Queue = VK_NULL_HANDLE;
+}
+
+void FVulkanQueue::AddDependency(const FQueueSyncPoint& SyncPoint, VkPipelineStageFlags WaitStage)
+{
+    // Waiting on our own timeline is implicit, submissions on a queue already execute in order
+    if(SyncPoint.Queue == Type || SyncPoint.Value == 0)
+    {
+        return;
+    }
+
+    const FVulkanQueue& Other = FVulkan::GetQueue(SyncPoint.Queue);
+    if(Other.IsComplete(SyncPoint.Value))
+    {
+        return;
+    }
+
+    for(FPendingWait& Wait : PendingWaits)
+    {
+        if(Wait.Semaphore == Other.GetTimeline().GetSemaphore())
+        {
+            Wait.Value = std::max(Wait.Value, SyncPoint.Value);
+            Wait.Stage |= WaitStage;
+            return;
+        }
+    }
+    PendingWaits.push_back({Other.GetTimeline().GetSemaphore(), SyncPoint.Value, WaitStage});
+}
+
+uint64_t FVulkanQueue::Submit(const VkCommandBuffer* CommandBuffers, uint32_t NumCommandBuffers, const FSubmitSemaphores& Semaphores)
+{
+    const uint64_t SignalValue = LastSubmittedValue + 1;
+
+    // Binary semaphores go first, their timeline values are ignored by the driver
+    std::vector<VkSemaphore> WaitSemaphores = Semaphores.Wait;
+    std::vector<VkPipelineStageFlags> WaitStages = Semaphores.WaitStages;
+    std::vector<uint64_t> WaitValues(WaitSemaphores.size(), 0);
+    for(const FPendingWait& Wait : PendingWaits)
+    {
+        WaitSemaphores.push_back(Wait.Semaphore);
+        WaitStages.push_back(Wait.Stage);
+        WaitValues.push_back(Wait.Value);
+    }
+    PendingWaits.clear();
+
+    std::vector<VkSemaphore> SignalSemaphores = Semaphores.Signal;
+    std::vector<uint64_t> SignalValues(SignalSemaphores.size(), 0);
+    SignalSemaphores.push_back(Timeline.GetSemaphore());
+    SignalValues.push_back(SignalValue);
+
+    VkTimelineSemaphoreSubmitInfo TimelineSubmitInfo{};
+    TimelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    TimelineSubmitInfo.waitSemaphoreValueCount = static_cast<uint32_t>(WaitValues.size());
+    TimelineSubmitInfo.pWaitSemaphoreValues = WaitValues.data();
+    TimelineSubmitInfo.signalSemaphoreValueCount = static_cast<uint32_t>(SignalValues.size());
+    TimelineSubmitInfo.pSignalSemaphoreValues = SignalValues.data();
+
+    VkSubmitInfo SubmitInfo{};
+    SubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    SubmitInfo.pNext = &TimelineSubmitInfo;
+    SubmitInfo.waitSemaphoreCount = static_cast<uint32_t>(WaitSemaphores.size());
+    SubmitInfo.pWaitSemaphores = WaitSemaphores.data();
+    SubmitInfo.pWaitDstStageMask = WaitStages.data();
+    SubmitInfo.commandBufferCount = NumCommandBuffers;
+    SubmitInfo.pCommandBuffers = CommandBuffers;
+    SubmitInfo.signalSemaphoreCount = static_cast<uint32_t>(SignalSemaphores.size());
+    SubmitInfo.pSignalSemaphores = SignalSemaphores.data();
+
+    if(vkQueueSubmit(Queue, 1, &SubmitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+    {
+        fatal("FVulkanQueue::Submit Fail submitting to queue %i", static_cast<int>(Type));
+    }
+
+    LastSubmittedValue = SignalValue;
+    return SignalValue;
+}
+
+bool FVulkanQueue::IsComplete(uint64_t Value) const
+{
+    return Timeline.IsComplete(Value);
+}
+
+bool FVulkanQueue::Wait(uint64_t Value, uint64_t Timeout) const
+{
+    checkf(Value <= LastSubmittedValue, "FVulkanQueue::Wait Waiting on value %llu that was never submitted", Value);
+    return Timeline.Wait(Value, Timeout);
+}
+
+bool FVulkanQueue::WaitIdle(uint64_t Timeout) const
+{
+    return Timeline.Wait(LastSubmittedValue, Timeout);
+}
+
+FQueueSyncPoint FVulkanQueue::GetLastSyncPoint() const
+{
+    return {Type, LastSubmittedValue};
+}
+
+uint64_t FVulkanQueue::GetLastSubmittedValue() const
+{
+    return LastSubmittedValue;
+}
+
+uint64_t FVulkanQueue::GetNextValue() const
+{
+    return LastSubmittedValue + 1;
+}
+
+uint64_t FVulkanQueue::GetCompletedValue() const
+{
+    return Timeline.GetCompletedValue();
+}
+
+const FTimelineSemaphore& FVulkanQueue::GetTimeline() const
+{
+    return Timeline;
+}
+
+VkQueue FVulkanQueue::GetQueue() const
+{
+    return Queue;
+}
+
+uint32_t FVulkanQueue::GetFamilyIndex() const
+{
+    return FamilyIndex;
+}
+
+EQueueType FVulkanQueue::GetType() const
+{
+    return Type;
+}
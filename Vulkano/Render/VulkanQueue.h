@@ -0,0 +1,91 @@
+﻿#pragma once
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "vulkan/vulkan_core.h"
+
+enum class EQueueType : uint8_t
+{
+    Graphics,
+    Compute,
+    Transfer,
+    Num
+};
+
+// A point on a queue timeline, work is complete once the queue semaphore reaches Value
+struct FQueueSyncPoint
+{
+    EQueueType Queue = EQueueType::Graphics;
+    uint64_t Value = 0;
+};
+
+// Binary semaphores attached to a submission, needed to talk with the swap chain
+struct FSubmitSemaphores
+{
+    std::vector<VkSemaphore> Wait;
+    std::vector<VkPipelineStageFlags> WaitStages;
+    std::vector<VkSemaphore> Signal;
+};
+
+class FTimelineSemaphore
+{
+public:
+    void Create(uint64_t InitialValue = 0);
+    void Release();
+    bool IsValid() const;
+
+    uint64_t GetCompletedValue() const;
+    bool IsComplete(uint64_t Value) const;
+    bool Wait(uint64_t Value, uint64_t Timeout = UINT64_MAX) const;
+    void Signal(uint64_t Value);
+    const VkSemaphore& GetSemaphore() const;
+
+private:
+    // Raises the cached value to Value unless another thread already stored a larger one, returns the result
+    uint64_t UpdateCompletedValue(uint64_t Value) const;
+
+    VkSemaphore Semaphore = VK_NULL_HANDLE;
+    // Last value read back from the driver, lets polling skip the query for old values.
+    // Atomic since the transfer timeline is polled from the upload thread and the render thread
+    mutable std::atomic<uint64_t> CachedCompletedValue{0};
+};
+
+// Wraps a VkQueue with a monotonically increasing timeline, every submission signals the next value
+class FVulkanQueue
+{
+public:
+    void Init(EQueueType InType, VkQueue InQueue, uint32_t InFamilyIndex);
+    void Release();
+
+    // Next submission on this queue waits for SyncPoint at the given stage
+    void AddDependency(const FQueueSyncPoint& SyncPoint, VkPipelineStageFlags WaitStage);
+    uint64_t Submit(const VkCommandBuffer* CommandBuffers, uint32_t NumCommandBuffers, const FSubmitSemaphores& Semaphores = {});
+
+    bool IsComplete(uint64_t Value) const;
+    bool Wait(uint64_t Value, uint64_t Timeout = UINT64_MAX) const;
+    bool WaitIdle(uint64_t Timeout = UINT64_MAX) const;
+
+    FQueueSyncPoint GetLastSyncPoint() const;
+    uint64_t GetLastSubmittedValue() const;
+    uint64_t GetNextValue() const;
+    uint64_t GetCompletedValue() const;
+    const FTimelineSemaphore& GetTimeline() const;
+    VkQueue GetQueue() const;
+    uint32_t GetFamilyIndex() const;
+    EQueueType GetType() const;
+
+private:
+    struct FPendingWait
+    {
+        VkSemaphore Semaphore;
+        uint64_t Value;
+        VkPipelineStageFlags Stage;
+    };
+
+    EQueueType Type = EQueueType::Graphics;
+    VkQueue Queue = VK_NULL_HANDLE;
+    uint32_t FamilyIndex = UINT32_MAX;
+    FTimelineSemaphore Timeline;
+    uint64_t LastSubmittedValue = 0;
+    std::vector<FPendingWait> PendingWaits;
+};
@@ -1,15 +1,16 @@
 ﻿#include "VulkanSwapChain.h"
 #include <vector>
 #include <glm/common.hpp>
+#include "RenderWindow.h"
 #include "VulkanInterface.h"
 #include "Core/Assertion.h"
 
-void FVulkanSwapChain::CreateSwapChain(HINSTANCE hInstance, HWND hwnd, int SizeX, int SizeY)
+void FVulkanSwapChain::CreateSwapChain(const FRenderWindow& Window, int SizeX, int SizeY)
 {
-	SurfaceKHR = FVulkan::CreateSurface(hInstance, hwnd);
+	SurfaceKHR = Window.CreateSurface(FVulkan::GetInstance());
 	if(SurfaceKHR != VK_NULL_HANDLE)
 	{
-		VK_LOG(LOG_INFO, "Creating Surface Win64");
+		VK_LOG(LOG_INFO, "Creating Surface %s", FRenderWindow::GetBackendName(Window.GetBackend()));
 	}
 	
     vkGetPhysicalDeviceSurfaceCapabilitiesKHR(FVulkan::GetPhysicalDevice(), SurfaceKHR, &SurfaceCapabilitiesKHR);
@@ -217,15 +218,12 @@ void FVulkanSwapChain::AcquireNextImage()
 
 void FVulkanSwapChain::SetupDepthStencil()
 {
-	DepthStencil = FVulkan::CreateTexture(
+	DepthStencil = FVulkan::CreateTexture(FTextureDesc::Create2D(
 		ViewportSize.width,
 		ViewportSize.height,
 		VK_FORMAT_D32_SFLOAT_S8_UINT,
 		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		"DepthStencil",
-		VK_IMAGE_TILING_OPTIMAL,
-		VK_IMAGE_ASPECT_DEPTH_BIT);
+		"DepthStencil"));
 }
 
 void FVulkanSwapChain::CreateRenderPass()
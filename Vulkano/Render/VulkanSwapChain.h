@@ -2,12 +2,13 @@
 #include <vector>
 #include "RenderResources.h"
 #include "vulkan/vulkan_core.h"
-#include "Windows.h"
+
+class FRenderWindow;
 
 class FVulkanSwapChain
 {
 public:
-    void CreateSwapChain(HINSTANCE hInstance, HWND hwnd, int SizeX, int SizeY);
+    void CreateSwapChain(const FRenderWindow& Window, int SizeX, int SizeY);
     void DestroySwapChain();
     void AcquireNextImage();
 
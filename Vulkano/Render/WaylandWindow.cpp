@@ -0,0 +1,189 @@
+﻿#include "WaylandWindow.h"
+#include <cstring>
+#include <poll.h>
+#include <wayland-client.h>
+#include "xdg-shell-client-protocol.h"
+#include <vulkan/vulkan_wayland.h>
+#include "Core/VulkanoLog.h"
+
+FWaylandWindow::FWaylandWindow(const std::string& Title, int InWidth, int InHeight)
+    : FRenderWindow(Title, InWidth, InHeight)
+{
+}
+
+FWaylandWindow::~FWaylandWindow()
+{
+    Shutdown();
+}
+
+bool FWaylandWindow::Init()
+{
+    // Only the first events of each interface are handled, newer protocol versions add events that are left null
+    static const wl_registry_listener RegistryListener = {OnRegistryGlobal, OnRegistryGlobalRemove};
+    static const xdg_wm_base_listener WmBaseListener = {OnWmBasePing};
+    static const xdg_surface_listener SurfaceListener = {OnSurfaceConfigure};
+    static const xdg_toplevel_listener ToplevelListener = {OnToplevelConfigure, OnToplevelClose};
+
+    Display = wl_display_connect(nullptr);
+    if (!Display)
+    {
+        VK_LOG(LOG_ERROR, "Could not connect to the Wayland compositor");
+        return false;
+    }
+
+    Registry = wl_display_get_registry(Display);
+    wl_registry_add_listener(Registry, &RegistryListener, this);
+    wl_display_roundtrip(Display);
+    if (!Compositor || !WmBase)
+    {
+        VK_LOG(LOG_ERROR, "Wayland compositor does not expose wl_compositor and xdg_wm_base");
+        Shutdown();
+        return false;
+    }
+    xdg_wm_base_add_listener(WmBase, &WmBaseListener, this);
+
+    Surface = wl_compositor_create_surface(Compositor);
+    ShellSurface = xdg_wm_base_get_xdg_surface(WmBase, Surface);
+    xdg_surface_add_listener(ShellSurface, &SurfaceListener, this);
+    Toplevel = xdg_surface_get_toplevel(ShellSurface);
+    xdg_toplevel_add_listener(Toplevel, &ToplevelListener, this);
+    xdg_toplevel_set_title(Toplevel, WindowsName.c_str());
+    xdg_toplevel_set_app_id(Toplevel, WindowsName.c_str());
+
+    // No buffer may be attached before the first configure
+    wl_surface_commit(Surface);
+    while (!bConfigured && wl_display_dispatch(Display) != -1)
+    {
+    }
+    return bConfigured;
+}
+
+bool FWaylandWindow::PumpMessages()
+{
+    // Non blocking read, the update thread must never wait on the compositor
+    while (wl_display_prepare_read(Display) != 0)
+    {
+        wl_display_dispatch_pending(Display);
+    }
+    wl_display_flush(Display);
+
+    pollfd Descriptor = {wl_display_get_fd(Display), POLLIN, 0};
+    if (poll(&Descriptor, 1, 0) > 0)
+    {
+        wl_display_read_events(Display);
+    }
+    else
+    {
+        wl_display_cancel_read(Display);
+    }
+
+    if (wl_display_dispatch_pending(Display) == -1)
+    {
+        bQuit = true;
+    }
+    return !bQuit;
+}
+
+VkSurfaceKHR FWaylandWindow::CreateSurface(VkInstance Instance) const
+{
+    VkSurfaceKHR SurfaceKHR = VK_NULL_HANDLE;
+    VkWaylandSurfaceCreateInfoKHR SurfaceCreateInfo = {};
+    SurfaceCreateInfo.sType = VK_STRUCTURE_TYPE_WAYLAND_SURFACE_CREATE_INFO_KHR;
+    SurfaceCreateInfo.display = Display;
+    SurfaceCreateInfo.surface = Surface;
+    if (vkCreateWaylandSurfaceKHR(Instance, &SurfaceCreateInfo, nullptr, &SurfaceKHR) != VK_SUCCESS)
+    {
+        VK_LOG(LOG_ERROR, "Fail creating Wayland surface");
+    }
+    return SurfaceKHR;
+}
+
+EWindowBackend FWaylandWindow::GetBackend() const
+{
+    return EWindowBackend::Wayland;
+}
+
+void FWaylandWindow::Shutdown()
+{
+    if (Toplevel)
+    {
+        xdg_toplevel_destroy(Toplevel);
+        Toplevel = nullptr;
+    }
+    if (ShellSurface)
+    {
+        xdg_surface_destroy(ShellSurface);
+        ShellSurface = nullptr;
+    }
+    if (Surface)
+    {
+        wl_surface_destroy(Surface);
+        Surface = nullptr;
+    }
+    if (WmBase)
+    {
+        xdg_wm_base_destroy(WmBase);
+        WmBase = nullptr;
+    }
+    if (Compositor)
+    {
+        wl_compositor_destroy(Compositor);
+        Compositor = nullptr;
+    }
+    if (Registry)
+    {
+        wl_registry_destroy(Registry);
+        Registry = nullptr;
+    }
+    if (Display)
+    {
+        wl_display_disconnect(Display);
+        Display = nullptr;
+    }
+}
+
+void FWaylandWindow::OnRegistryGlobal(void* Data, wl_registry* Registry, uint32_t Name, const char* Interface, uint32_t Version)
+{
+    FWaylandWindow* Window = static_cast<FWaylandWindow*>(Data);
+    if (strcmp(Interface, wl_compositor_interface.name) == 0)
+    {
+        Window->Compositor = static_cast<wl_compositor*>(wl_registry_bind(Registry, Name, &wl_compositor_interface, 4 < Version ? 4 : Version));
+    }
+    else if (strcmp(Interface, xdg_wm_base_interface.name) == 0)
+    {
+        Window->WmBase = static_cast<xdg_wm_base*>(wl_registry_bind(Registry, Name, &xdg_wm_base_interface, 1));
+    }
+}
+
+void FWaylandWindow::OnRegistryGlobalRemove(void* Data, wl_registry* Registry, uint32_t Name)
+{
+}
+
+void FWaylandWindow::OnWmBasePing(void* Data, xdg_wm_base* WmBase, uint32_t Serial)
+{
+    xdg_wm_base_pong(WmBase, Serial);
+}
+
+void FWaylandWindow::OnSurfaceConfigure(void* Data, xdg_surface* Surface, uint32_t Serial)
+{
+    FWaylandWindow* Window = static_cast<FWaylandWindow*>(Data);
+    xdg_surface_ack_configure(Surface, Serial);
+    if (Window->PendingWidth > 0 && Window->PendingHeight > 0)
+    {
+        Window->OnResize(Window->PendingWidth, Window->PendingHeight);
+    }
+    Window->bConfigured = true;
+}
+
+void FWaylandWindow::OnToplevelConfigure(void* Data, xdg_toplevel* Toplevel, int32_t NewWidth, int32_t NewHeight, wl_array* States)
+{
+    // Zero means the client picks, the window keeps its size
+    FWaylandWindow* Window = static_cast<FWaylandWindow*>(Data);
+    Window->PendingWidth = NewWidth;
+    Window->PendingHeight = NewHeight;
+}
+
+void FWaylandWindow::OnToplevelClose(void* Data, xdg_toplevel* Toplevel)
+{
+    static_cast<FWaylandWindow*>(Data)->bQuit = true;
+}
@@ -0,0 +1,48 @@
+﻿#pragma once
+#include "RenderWindow.h"
+
+struct wl_display;
+struct wl_registry;
+struct wl_compositor;
+struct wl_surface;
+struct xdg_wm_base;
+struct xdg_surface;
+struct xdg_toplevel;
+struct wl_array;
+
+// Wayland toplevel through xdg-shell, the protocol code is generated by wayland-scanner at build time.
+// Wayland has no minimized state, the compositor simply stops releasing swap chain images
+class FWaylandWindow : public FRenderWindow
+{
+public:
+    FWaylandWindow(const std::string& Title, int InWidth, int InHeight);
+    virtual ~FWaylandWindow() override;
+
+    virtual bool Init() override;
+    virtual bool PumpMessages() override;
+    virtual VkSurfaceKHR CreateSurface(VkInstance Instance) const override;
+    virtual EWindowBackend GetBackend() const override;
+    virtual void Shutdown() override;
+
+private:
+    static void OnRegistryGlobal(void* Data, wl_registry* Registry, uint32_t Name, const char* Interface, uint32_t Version);
+    static void OnRegistryGlobalRemove(void* Data, wl_registry* Registry, uint32_t Name);
+    static void OnWmBasePing(void* Data, xdg_wm_base* WmBase, uint32_t Serial);
+    static void OnSurfaceConfigure(void* Data, xdg_surface* Surface, uint32_t Serial);
+    static void OnToplevelConfigure(void* Data, xdg_toplevel* Toplevel, int32_t NewWidth, int32_t NewHeight, wl_array* States);
+    static void OnToplevelClose(void* Data, xdg_toplevel* Toplevel);
+
+private:
+    wl_display* Display = nullptr;
+    wl_registry* Registry = nullptr;
+    wl_compositor* Compositor = nullptr;
+    xdg_wm_base* WmBase = nullptr;
+    wl_surface* Surface = nullptr;
+    xdg_surface* ShellSurface = nullptr;
+    xdg_toplevel* Toplevel = nullptr;
+    // Size of the last toplevel configure, applied when the surface configure acknowledges it. 0 keeps the current size
+    int PendingWidth = 0;
+    int PendingHeight = 0;
+    bool bConfigured = false;
+    bool bQuit = false;
+};
@@ -0,0 +1,174 @@
+﻿#include "Win32Window.h"
+#include <vulkan/vulkan_win32.h>
+#include "Core/VulkanoLog.h"
+
+FWin32Window* FWin32Window::ThisWindow = nullptr;
+
+FWin32Window::FWin32Window(const std::string& Title, int InWidth, int InHeight)
+    : FRenderWindow(Title, InWidth, InHeight)
+{
+}
+
+LRESULT CALLBACK WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)						
+{																									
+	if (FWin32Window::ThisWindow)																		
+	{																								
+		FWin32Window::ThisWindow->HandleMessages(hWnd, uMsg, wParam, lParam);									
+	}																						
+	return (DefWindowProc(hWnd, uMsg, wParam, lParam));												
+}	
+
+bool FWin32Window::Init()
+{
+	HINSTANCE hinstance = GetModuleHandle(NULL);
+	WindowInstance = hinstance;
+	WNDCLASSEX wndClass;
+
+	ThisWindow = this;
+
+	HICON hIcon = (HICON)LoadImage(
+		NULL, 
+		L"Resources/Vulkano.ico", 
+		IMAGE_ICON, 
+		GetSystemMetrics(SM_CXSMICON), 
+		GetSystemMetrics(SM_CYSMICON), 
+		LR_LOADFROMFILE | LR_SHARED
+	);
+
+	wndClass.cbSize = sizeof(WNDCLASSEX);
+	wndClass.style = CS_HREDRAW | CS_VREDRAW;
+	wndClass.lpfnWndProc = WndProc;
+	wndClass.cbClsExtra = 0;
+	wndClass.cbWndExtra = 0;
+	wndClass.hInstance = hinstance;
+	wndClass.hIcon = hIcon;
+	wndClass.hCursor = LoadCursor(NULL, IDC_ARROW);
+	wndClass.hbrBackground = (HBRUSH)GetStockObject(BLACK_BRUSH);
+	wndClass.lpszMenuName = NULL;
+	wndClass.lpszClassName = L"Vulkano";
+	wndClass.hIconSm = hIcon;
+
+	if (!RegisterClassEx(&wndClass))
+	{
+		VK_LOG(LOG_ERROR, "Could not register window class!");
+		return false;
+	}
+
+	int screenWidth = GetSystemMetrics(SM_CXSCREEN);
+	int screenHeight = GetSystemMetrics(SM_CYSCREEN);
+	
+
+	DWORD dwExStyle = WS_EX_APPWINDOW | WS_EX_WINDOWEDGE;
+	DWORD dwStyle = WS_OVERLAPPEDWINDOW | WS_CLIPSIBLINGS | WS_CLIPCHILDREN;
+	
+	RECT windowRect = {
+		0L,
+		0L,
+		(long)Width,
+		(long)Height
+	};
+
+	AdjustWindowRectEx(&windowRect, dwStyle, FALSE, dwExStyle);
+	
+	Window = CreateWindowExA(0,
+		WindowsName.c_str(),
+		WindowsName.c_str(),
+		dwStyle | WS_CLIPSIBLINGS | WS_CLIPCHILDREN,
+		0,
+		0,
+		windowRect.right - windowRect.left,
+		windowRect.bottom - windowRect.top,
+		NULL,
+		NULL,
+		hinstance,
+		NULL);
+
+	if (!Window)
+	{
+		VK_LOG(LOG_ERROR, "Could not create window!");
+		return false;
+	}
+
+	// Center on screen
+	uint32_t x = (GetSystemMetrics(SM_CXSCREEN) - windowRect.right) / 2;
+	uint32_t y = (GetSystemMetrics(SM_CYSCREEN) - windowRect.bottom) / 2;
+	SetWindowPos(Window, 0, x, y, 0, 0, SWP_NOZORDER | SWP_NOSIZE);
+
+	ShowWindow(Window, SW_SHOW);
+	SetForegroundWindow(Window);
+	SetFocus(Window);
+	return true;
+}
+
+void FWin32Window::HandleMessages(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
+{
+	switch (uMsg)
+	{
+	case WM_CLOSE:
+		DestroyWindow(hwnd);
+		PostQuitMessage(0);
+		break; 
+	case WM_SIZE:
+		// Minimized windows report a zero size, the renderer skips frames until it is restored
+		if (wParam != SIZE_MINIMIZED)
+		{
+			OnResize(LOWORD(lParam), HIWORD(lParam));
+		}
+		break;
+	}
+}
+
+bool FWin32Window::PumpMessages()
+{
+	MSG msg;
+	while (!bQuit && PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
+	{
+		if (msg.message == WM_QUIT)
+		{
+			bQuit = true;
+			break;
+		}
+		TranslateMessage(&msg);
+		DispatchMessage(&msg);
+	}
+	return !bQuit;
+}
+
+bool FWin32Window::IsMinimized() const
+{
+	return IsIconic(Window);
+}
+
+VkSurfaceKHR FWin32Window::CreateSurface(VkInstance Instance) const
+{
+	VkSurfaceKHR SurfaceKHR = VK_NULL_HANDLE;
+	VkWin32SurfaceCreateInfoKHR surfaceCreateInfo = {};
+	surfaceCreateInfo.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
+	surfaceCreateInfo.hinstance = WindowInstance;
+	surfaceCreateInfo.hwnd = Window;
+	if (vkCreateWin32SurfaceKHR(Instance, &surfaceCreateInfo, nullptr, &SurfaceKHR) != VK_SUCCESS)
+	{
+		VK_LOG(LOG_ERROR, "Fail creating Win32 surface");
+	}
+	return SurfaceKHR;
+}
+
+EWindowBackend FWin32Window::GetBackend() const
+{
+	return EWindowBackend::Win32;
+}
+
+void FWin32Window::Shutdown()
+{
+	ThisWindow = nullptr;
+}
+
+HINSTANCE FWin32Window::GetHInstance() const
+{
+	return WindowInstance;
+}
+
+HWND FWin32Window::GetWindow() const
+{
+	return Window;
+}
@@ -0,0 +1,28 @@
+﻿#pragma once
+#include "RenderWindow.h"
+#include <Windows.h>
+
+class FWin32Window : public FRenderWindow
+{
+public:
+    FWin32Window(const std::string& Title, int InWidth, int InHeight);
+
+    virtual bool Init() override;
+    virtual bool PumpMessages() override;
+    virtual bool IsMinimized() const override;
+    virtual VkSurfaceKHR CreateSurface(VkInstance Instance) const override;
+    virtual EWindowBackend GetBackend() const override;
+    virtual void Shutdown() override;
+
+    void HandleMessages(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
+    HINSTANCE GetHInstance() const;
+    HWND GetWindow() const;
+
+public:
+    static FWin32Window* ThisWindow;
+
+private:
+    HINSTANCE WindowInstance = NULL;
+    HWND Window = NULL;
+    bool bQuit = false;
+};
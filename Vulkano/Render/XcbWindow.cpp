@@ -0,0 +1,153 @@
+﻿#include "XcbWindow.h"
+#include <cstdlib>
+#include <cstring>
+#include <vulkan/vulkan_xcb.h>
+#include "Core/VulkanoLog.h"
+
+namespace
+{
+    xcb_atom_t InternAtom(xcb_connection_t* Connection, const char* Name)
+    {
+        xcb_intern_atom_cookie_t Cookie = xcb_intern_atom(Connection, 0, static_cast<uint16_t>(strlen(Name)), Name);
+        xcb_intern_atom_reply_t* Reply = xcb_intern_atom_reply(Connection, Cookie, nullptr);
+        const xcb_atom_t Atom = Reply ? Reply->atom : static_cast<xcb_atom_t>(XCB_ATOM_NONE);
+        free(Reply);
+        return Atom;
+    }
+}
+
+FXcbWindow::FXcbWindow(const std::string& Title, int InWidth, int InHeight)
+    : FRenderWindow(Title, InWidth, InHeight)
+{
+}
+
+FXcbWindow::~FXcbWindow()
+{
+    Shutdown();
+}
+
+bool FXcbWindow::Init()
+{
+    int ScreenIndex = 0;
+    Connection = xcb_connect(nullptr, &ScreenIndex);
+    if (xcb_connection_has_error(Connection))
+    {
+        VK_LOG(LOG_ERROR, "Could not connect to the X server");
+        xcb_disconnect(Connection);
+        Connection = nullptr;
+        return false;
+    }
+
+    xcb_screen_iterator_t ScreenIterator = xcb_setup_roots_iterator(xcb_get_setup(Connection));
+    for (int Index = 0; Index < ScreenIndex; ++Index)
+    {
+        xcb_screen_next(&ScreenIterator);
+    }
+    const xcb_screen_t* Screen = ScreenIterator.data;
+
+    const uint32_t ValueMask = XCB_CW_BACK_PIXEL | XCB_CW_EVENT_MASK;
+    const uint32_t Values[] = {Screen->black_pixel, XCB_EVENT_MASK_STRUCTURE_NOTIFY | XCB_EVENT_MASK_EXPOSURE};
+
+    // Centered like the Win32 window, the window manager may still place it elsewhere
+    const int16_t X = static_cast<int16_t>((Screen->width_in_pixels - GetWidth()) / 2);
+    const int16_t Y = static_cast<int16_t>((Screen->height_in_pixels - GetHeight()) / 2);
+    Window = xcb_generate_id(Connection);
+    xcb_create_window(Connection, XCB_COPY_FROM_PARENT, Window, Screen->root, X, Y,
+        static_cast<uint16_t>(GetWidth()), static_cast<uint16_t>(GetHeight()), 0,
+        XCB_WINDOW_CLASS_INPUT_OUTPUT, Screen->root_visual, ValueMask, Values);
+
+    xcb_change_property(Connection, XCB_PROP_MODE_REPLACE, Window, XCB_ATOM_WM_NAME, XCB_ATOM_STRING, 8,
+        static_cast<uint32_t>(WindowsName.size()), WindowsName.c_str());
+
+    // Ask the window manager for a close message instead of killing the connection
+    const xcb_atom_t ProtocolsAtom = InternAtom(Connection, "WM_PROTOCOLS");
+    DeleteWindowAtom = InternAtom(Connection, "WM_DELETE_WINDOW");
+    xcb_change_property(Connection, XCB_PROP_MODE_REPLACE, Window, ProtocolsAtom, XCB_ATOM_ATOM, 32, 1, &DeleteWindowAtom);
+
+    xcb_map_window(Connection, Window);
+    xcb_flush(Connection);
+    return true;
+}
+
+bool FXcbWindow::PumpMessages()
+{
+    while (!bQuit)
+    {
+        xcb_generic_event_t* Event = xcb_poll_for_event(Connection);
+        if (!Event)
+        {
+            break;
+        }
+        HandleEvent(Event);
+        free(Event);
+    }
+
+    if (xcb_connection_has_error(Connection))
+    {
+        bQuit = true;
+    }
+    return !bQuit;
+}
+
+void FXcbWindow::HandleEvent(const xcb_generic_event_t* Event)
+{
+    switch (Event->response_type & 0x7f)
+    {
+    case XCB_CLIENT_MESSAGE:
+    {
+        const xcb_client_message_event_t* Message = reinterpret_cast<const xcb_client_message_event_t*>(Event);
+        if (Message->data.data32[0] == DeleteWindowAtom)
+        {
+            bQuit = true;
+        }
+        break;
+    }
+    case XCB_CONFIGURE_NOTIFY:
+    {
+        const xcb_configure_notify_event_t* Configure = reinterpret_cast<const xcb_configure_notify_event_t*>(Event);
+        OnResize(Configure->width, Configure->height);
+        break;
+    }
+    case XCB_UNMAP_NOTIFY:
+        // Iconified windows are unmapped, the renderer skips frames until it is mapped again
+        bMinimized = true;
+        break;
+    case XCB_MAP_NOTIFY:
+        bMinimized = false;
+        break;
+    case XCB_DESTROY_NOTIFY:
+        bQuit = true;
+        break;
+    }
+}
+
+VkSurfaceKHR FXcbWindow::CreateSurface(VkInstance Instance) const
+{
+    VkSurfaceKHR SurfaceKHR = VK_NULL_HANDLE;
+    VkXcbSurfaceCreateInfoKHR SurfaceCreateInfo = {};
+    SurfaceCreateInfo.sType = VK_STRUCTURE_TYPE_XCB_SURFACE_CREATE_INFO_KHR;
+    SurfaceCreateInfo.connection = Connection;
+    SurfaceCreateInfo.window = Window;
+    if (vkCreateXcbSurfaceKHR(Instance, &SurfaceCreateInfo, nullptr, &SurfaceKHR) != VK_SUCCESS)
+    {
+        VK_LOG(LOG_ERROR, "Fail creating XCB surface");
+    }
+    return SurfaceKHR;
+}
+
+EWindowBackend FXcbWindow::GetBackend() const
+{
+    return EWindowBackend::Xcb;
+}
+
+void FXcbWindow::Shutdown()
+{
+    if (!Connection)
+    {
+        return;
+    }
+    xcb_destroy_window(Connection, Window);
+    xcb_disconnect(Connection);
+    Connection = nullptr;
+    Window = 0;
+}
@@ -0,0 +1,26 @@
+﻿#pragma once
+#include "RenderWindow.h"
+#include <xcb/xcb.h>
+
+// X11 window through XCB
+class FXcbWindow : public FRenderWindow
+{
+public:
+    FXcbWindow(const std::string& Title, int InWidth, int InHeight);
+    virtual ~FXcbWindow() override;
+
+    virtual bool Init() override;
+    virtual bool PumpMessages() override;
+    virtual VkSurfaceKHR CreateSurface(VkInstance Instance) const override;
+    virtual EWindowBackend GetBackend() const override;
+    virtual void Shutdown() override;
+
+private:
+    void HandleEvent(const xcb_generic_event_t* Event);
+
+private:
+    xcb_connection_t* Connection = nullptr;
+    xcb_window_t Window = 0;
+    xcb_atom_t DeleteWindowAtom = 0;
+    bool bQuit = false;
+};
@@ -0,0 +1,27 @@
+﻿// FInstancedStaticVertexInput, binding 0 is FStaticMeshVertex and binding 1 the FDrawList instance stream
+
+struct FViewConstants
+{
+    float4x4 ViewProjection;
+};
+
+[[vk::push_constant]] ConstantBuffer<FViewConstants> View;
+
+void main(
+    [[vk::location(0)]] float3 InPosition : ATTRIBUTE0,
+    [[vk::location(1)]] float3 InNormal : ATTRIBUTE1,
+    [[vk::location(2)]] float2 InUV : ATTRIBUTE2,
+    [[vk::location(3)]] float3 InColor : ATTRIBUTE3,
+    [[vk::location(4)]] float4 InWorld0 : ATTRIBUTE4,
+    [[vk::location(5)]] float4 InWorld1 : ATTRIBUTE5,
+    [[vk::location(6)]] float4 InWorld2 : ATTRIBUTE6,
+    [[vk::location(7)]] float4 InWorld3 : ATTRIBUTE7,
+    [[vk::location(8)]] uint InMaterialIndex : ATTRIBUTE8,
+    out float2 OutUV : TEXCOORD0,
+    out float4 OutPosition : SV_POSITION)
+{
+    // The instance stream holds the world matrix columns
+    const float4 WorldPosition = InWorld0 * InPosition.x + InWorld1 * InPosition.y + InWorld2 * InPosition.z + InWorld3;
+    OutPosition = mul(View.ViewProjection, WorldPosition);
+    OutUV = InUV;
+}
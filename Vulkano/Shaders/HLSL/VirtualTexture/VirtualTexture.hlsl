@@ -0,0 +1,90 @@
+﻿// Virtual texture sampling and page feedback, included by material shaders.
+// FVirtualTextureParams mirrors FVirtualTextureShaderParams in Render/VirtualTexturing.h
+
+[[vk::binding(0, 0)]] Texture2D VTTextures[];
+[[vk::binding(0, 0)]] Texture2D<uint> VTPageTables[];
+[[vk::binding(1, 0)]] RWStructuredBuffer<uint> VTFeedbackBuffers[];
+[[vk::binding(2, 0)]] SamplerState VTSamplers[];
+
+static const uint VTInvalid = 0xFFFFFFFF;
+
+struct FVirtualTextureParams
+{
+    uint AtlasIndex;
+    uint PageTableIndex;
+    uint SamplerIndex;
+    uint FeedbackIndex;
+    uint TextureId;
+    uint PagesX;
+    uint PagesY;
+    uint MipLevels;
+    uint AtlasPagesX;
+    uint AtlasPagesY;
+    uint PageSize;
+    uint BorderSize;
+    uint FeedbackWidth;
+    uint FeedbackHeight;
+    uint FeedbackScale;
+    uint Padding;
+};
+
+// Mip the hardware would pick for a texture of PagesX * PageSize texels
+float VTComputeMip(FVirtualTextureParams Params, float2 UV)
+{
+    const float2 TextureSize = float2(Params.PagesX, Params.PagesY) * Params.PageSize;
+    const float2 DX = ddx(UV) * TextureSize;
+    const float2 DY = ddy(UV) * TextureSize;
+    const float MaxLengthSquared = max(dot(DX, DX), dot(DY, DY));
+    return clamp(0.5 * log2(max(MaxLengthSquared, 1e-8)), 0.0, float(Params.MipLevels - 1));
+}
+
+uint2 VTGetPage(FVirtualTextureParams Params, float2 UV, uint Mip)
+{
+    const uint2 Pages = max(uint2(Params.PagesX, Params.PagesY) >> Mip, uint2(1, 1));
+    return min(uint2(saturate(UV) * Pages), Pages - 1);
+}
+
+// Same packing as FVirtualPageId::Pack
+uint VTPackPageId(uint Texture, uint Mip, uint2 Page)
+{
+    return (Page.x & 0x3FF) | ((Page.y & 0x3FF) << 10) | ((Mip & 0xF) << 20) | ((Texture & 0xFF) << 24);
+}
+
+// One pixel of every FeedbackScale x FeedbackScale block writes, the others are skipped
+void VTWriteFeedback(FVirtualTextureParams Params, float2 UV, uint2 PixelPosition)
+{
+    const uint Mip = uint(VTComputeMip(Params, UV));
+    if (Params.FeedbackIndex == VTInvalid || any(PixelPosition % Params.FeedbackScale != 0))
+    {
+        return;
+    }
+
+    const uint2 FeedbackPosition = PixelPosition / Params.FeedbackScale;
+    if (FeedbackPosition.x < Params.FeedbackWidth && FeedbackPosition.y < Params.FeedbackHeight)
+    {
+        const uint PageId = VTPackPageId(Params.TextureId, Mip, VTGetPage(Params, UV, Mip));
+        VTFeedbackBuffers[NonUniformResourceIndex(Params.FeedbackIndex)][FeedbackPosition.y * Params.FeedbackWidth + FeedbackPosition.x] = PageId;
+    }
+}
+
+// Samples the finest resident page covering UV, Fallback when not even the last mip is resident yet
+float4 VTSample(FVirtualTextureParams Params, float2 UV, float4 Fallback)
+{
+    const uint Mip = uint(VTComputeMip(Params, UV));
+    const uint Entry = VTPageTables[NonUniformResourceIndex(Params.PageTableIndex)].Load(int3(VTGetPage(Params, UV, Mip), Mip));
+    if (Entry == VTInvalid)
+    {
+        return Fallback;
+    }
+
+    // Entry is slot (24) | mip (8), see FVirtualPageTable::MakeEntry
+    const uint Slot = Entry & 0xFFFFFF;
+    const uint EntryMip = Entry >> 24;
+    const float2 Pages = float2(max(uint2(Params.PagesX, Params.PagesY) >> EntryMip, uint2(1, 1)));
+    const float2 InPage = frac(saturate(UV) * Pages - 1e-5);
+
+    const uint SlotTexels = Params.PageSize + 2 * Params.BorderSize;
+    const float2 SlotOrigin = float2(Slot % Params.AtlasPagesX, Slot / Params.AtlasPagesX) * SlotTexels + Params.BorderSize;
+    const float2 AtlasUV = (SlotOrigin + InPage * Params.PageSize) / (float2(Params.AtlasPagesX, Params.AtlasPagesY) * SlotTexels);
+    return VTTextures[NonUniformResourceIndex(Params.AtlasIndex)].SampleLevel(VTSamplers[NonUniformResourceIndex(Params.SamplerIndex)], AtlasUV, 0);
+}
@@ -0,0 +1,161 @@
+﻿#include "TestFramework.h"
+
+#include "Render/DeviceSelection.h"
+
+namespace
+{
+    // A device that meets every requirement, with one graphics family that can present
+    FPhysicalDeviceInfo MakeDevice(const char* Name, VkPhysicalDeviceType Type, uint64_t HeapMiB, uint8_t UUIDByte)
+    {
+        FPhysicalDeviceInfo Info;
+        Info.Name = Name;
+        Info.UUID.fill(UUIDByte);
+        Info.Type = Type;
+        Info.ApiVersion = VK_API_VERSION_1_3;
+        Info.DeviceLocalHeapSize = HeapMiB << 20;
+        Info.Extensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+        Info.QueueFamilies.push_back({VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT, 1, true});
+        Info.bTimelineSemaphore = true;
+        Info.bDescriptorIndexing = true;
+        Info.bDynamicRendering = true;
+        Info.bImagelessFramebuffer = true;
+        Info.bSamplerAnisotropy = true;
+        return Info;
+    }
+
+    // Enumeration order of a hybrid laptop with a software rasterizer installed, the best device comes last
+    std::vector<FPhysicalDeviceInfo> MakeHybridLaptop()
+    {
+        std::vector<FPhysicalDeviceInfo> Devices;
+        Devices.push_back(MakeDevice("llvmpipe (LLVM 15.0.7, 256 bits)", VK_PHYSICAL_DEVICE_TYPE_CPU, 64 * 1024, 0x11));
+        // Integrated devices report the shared system memory, more than the discrete card has
+        Devices.push_back(MakeDevice("Intel(R) UHD Graphics 770", VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU, 32 * 1024, 0x22));
+        Devices.push_back(MakeDevice("NVIDIA GeForce RTX 3060 Laptop GPU", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 6 * 1024, 0x33));
+        Devices.push_back(MakeDevice("NVIDIA GeForce RTX 4080 Laptop GPU", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 12 * 1024, 0x44));
+        Devices.back().QueueFamilies.push_back({VK_QUEUE_TRANSFER_BIT, 2, false});
+        return Devices;
+    }
+}
+
+TEST_CASE(DeviceSelection, BestDiscreteDeviceWins)
+{
+    const std::vector<FPhysicalDeviceInfo> Devices = MakeHybridLaptop();
+    TEST_CHECK(FDeviceSelector::Select(Devices, "", true) == 3);
+    TEST_CHECK(FDeviceSelector::Select(Devices, "", false) == 3);
+
+    // Type decides before memory, then the larger heap, then capabilities like a copy engine
+    const int64_t Cpu = FDeviceSelector::Score(Devices[0], true).Score;
+    const int64_t Integrated = FDeviceSelector::Score(Devices[1], true).Score;
+    const int64_t SmallDiscrete = FDeviceSelector::Score(Devices[2], true).Score;
+    const int64_t LargeDiscrete = FDeviceSelector::Score(Devices[3], true).Score;
+    TEST_CHECK(Cpu < Integrated && Integrated < SmallDiscrete && SmallDiscrete < LargeDiscrete);
+
+    FPhysicalDeviceInfo SameHeap = Devices[2];
+    SameHeap.DeviceLocalHeapSize = Devices[3].DeviceLocalHeapSize;
+    TEST_CHECK(FDeviceSelector::Score(SameHeap, true).Score < LargeDiscrete);
+
+    // Equal scores keep the enumeration order
+    const std::vector<FPhysicalDeviceInfo> Twins = {Devices[2], Devices[2]};
+    TEST_CHECK(FDeviceSelector::Select(Twins, "", true) == 0);
+}
+
+TEST_CASE(DeviceSelection, OverrideByNameAndUUID)
+{
+    const std::vector<FPhysicalDeviceInfo> Devices = MakeHybridLaptop();
+    TEST_CHECK(FDeviceSelector::Select(Devices, "intel", true) == 1);
+    TEST_CHECK(FDeviceSelector::Select(Devices, "RTX 3060", true) == 2);
+    // A substring shared by several devices picks the first suitable one in enumeration order
+    TEST_CHECK(FDeviceSelector::Select(Devices, "nvidia", true) == 2);
+
+    const std::string UUID = FDeviceSelector::FormatUUID(Devices[0].UUID);
+    TEST_CHECK(UUID == "11111111-1111-1111-1111-111111111111");
+    TEST_CHECK(FDeviceSelector::Select(Devices, UUID, true) == 0);
+
+    std::array<uint8_t, VK_UUID_SIZE> MixedUUID = {};
+    for (size_t Index = 0; Index < MixedUUID.size(); ++Index)
+    {
+        MixedUUID[Index] = static_cast<uint8_t>(0xa0 + Index);
+    }
+    std::vector<FPhysicalDeviceInfo> WithMixedUUID = Devices;
+    WithMixedUUID[1].UUID = MixedUUID;
+    TEST_CHECK(FDeviceSelector::FormatUUID(MixedUUID) == "a0a1a2a3-a4a5-a6a7-a8a9-aaabacadaeaf");
+    TEST_CHECK(FDeviceSelector::Select(WithMixedUUID, "A0A1A2A3-A4A5-A6A7-A8A9-AAABACADAEAF", true) == 1);
+}
+
+TEST_CASE(DeviceSelection, UnsuitablePreferredFallsBack)
+{
+    std::vector<FPhysicalDeviceInfo> Devices = MakeHybridLaptop();
+    Devices[1].bTimelineSemaphore = false;
+    const FDeviceScore Score = FDeviceSelector::Score(Devices[1], true);
+    TEST_CHECK(!Score.bSuitable && Score.Reason == "no timeline semaphores");
+    TEST_CHECK(FDeviceSelector::Select(Devices, "intel", true) == 3);
+    TEST_CHECK(FDeviceSelector::Select(Devices, "no such device", true) == 3);
+
+    // Every requirement CreateVulkanDevice enforces rejects the device on its own
+    const FPhysicalDeviceInfo Good = MakeDevice("Good", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 8192, 0x55);
+    TEST_CHECK(FDeviceSelector::Score(Good, true).bSuitable);
+    FPhysicalDeviceInfo Bad = Good;
+    Bad.ApiVersion = VK_API_VERSION_1_1;
+    TEST_CHECK(!FDeviceSelector::Score(Bad, false).bSuitable);
+    Bad = Good;
+    Bad.QueueFamilies = {{VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT, 1, true}};
+    TEST_CHECK(!FDeviceSelector::Score(Bad, false).bSuitable);
+    Bad = Good;
+    Bad.QueueFamilies[0].QueueCount = 0;
+    TEST_CHECK(!FDeviceSelector::Score(Bad, false).bSuitable);
+    Bad = Good;
+    Bad.bDescriptorIndexing = false;
+    TEST_CHECK(!FDeviceSelector::Score(Bad, false).bSuitable);
+    Bad = Good;
+    Bad.bDynamicRendering = false;
+    Bad.bImagelessFramebuffer = false;
+    TEST_CHECK(!FDeviceSelector::Score(Bad, false).bSuitable);
+    Bad = Good;
+    Bad.bSamplerAnisotropy = false;
+    TEST_CHECK(!FDeviceSelector::Score(Bad, false).bSuitable);
+
+    // Either render pass path is enough
+    FPhysicalDeviceInfo Imageless = Good;
+    Imageless.bDynamicRendering = false;
+    TEST_CHECK(FDeviceSelector::Score(Imageless, false).bSuitable);
+
+    std::vector<FPhysicalDeviceInfo> NothingSuitable = {Bad, Bad};
+    TEST_CHECK(FDeviceSelector::Select(NothingSuitable, "", false) == -1);
+    TEST_CHECK(FDeviceSelector::Select({}, "", false) == -1);
+}
+
+TEST_CASE(DeviceSelection, PresentRequirementsDependOnWindow)
+{
+    // A compute card without display outputs next to a weaker card that can present
+    FPhysicalDeviceInfo Headless = MakeDevice("Tesla T4", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 16 * 1024, 0x66);
+    Headless.QueueFamilies[0].bPresent = false;
+    Headless.Extensions.clear();
+    const FPhysicalDeviceInfo Display = MakeDevice("Radeon RX 6400", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 4 * 1024, 0x77);
+    const std::vector<FPhysicalDeviceInfo> Devices = {Headless, Display};
+
+    TEST_CHECK(!FDeviceSelector::Score(Headless, true).bSuitable);
+    TEST_CHECK(FDeviceSelector::Score(Headless, false).bSuitable);
+    TEST_CHECK(FDeviceSelector::Select(Devices, "", true) == 1);
+    TEST_CHECK(FDeviceSelector::Select(Devices, "", false) == 0);
+
+    // Present support without the swap chain extension is not enough either
+    FPhysicalDeviceInfo NoSwapChain = Display;
+    NoSwapChain.Extensions.clear();
+    TEST_CHECK(!FDeviceSelector::Score(NoSwapChain, true).bSuitable);
+
+    // Presenting from a separate family works but ranks below presenting from the graphics family
+    FPhysicalDeviceInfo SeparatePresent = Display;
+    SeparatePresent.QueueFamilies[0].bPresent = false;
+    SeparatePresent.QueueFamilies.push_back({VK_QUEUE_TRANSFER_BIT, 1, true});
+    TEST_CHECK(FDeviceSelector::Score(SeparatePresent, true).bSuitable);
+    const int64_t SeparateWindowBonus = FDeviceSelector::Score(SeparatePresent, true).Score - FDeviceSelector::Score(SeparatePresent, false).Score;
+    const int64_t GraphicsWindowBonus = FDeviceSelector::Score(Display, true).Score - FDeviceSelector::Score(Display, false).Score;
+    TEST_CHECK(SeparateWindowBonus < GraphicsWindowBonus);
+
+    // Present wait only counts with a window
+    FPhysicalDeviceInfo PresentWait = Display;
+    PresentWait.Extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+    PresentWait.Extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+    TEST_CHECK(FDeviceSelector::Score(PresentWait, true).Score > FDeviceSelector::Score(Display, true).Score);
+    TEST_CHECK(FDeviceSelector::Score(PresentWait, false).Score == FDeviceSelector::Score(Display, false).Score);
+}
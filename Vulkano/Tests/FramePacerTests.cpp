@@ -0,0 +1,150 @@
+﻿#include "TestFramework.h"
+
+#include <vector>
+#include "Render/FramePacer.h"
+
+namespace
+{
+    // 100 fps on the simulated clock, everything below is in microseconds
+    constexpr uint64_t Interval = 10000;
+    constexpr uint64_t Margin = 500;
+
+    struct FPacedFrame
+    {
+        uint64_t Start = 0;
+        uint64_t Work = 0;
+    };
+
+    // Runs one frame per entry of Work, the clock advances by the work between WaitForNextFrame and EndFrame
+    std::vector<FPacedFrame> RunFrames(FFramePacer& Pacer, FSimulatedFrameClock& Clock, const std::vector<uint64_t>& Work)
+    {
+        std::vector<FPacedFrame> Frames;
+        for (uint64_t FrameWork : Work)
+        {
+            FPacedFrame& Frame = Frames.emplace_back();
+            Frame.Start = Pacer.WaitForNextFrame();
+            Frame.Work = FrameWork;
+            Clock.Advance(FrameWork);
+            Pacer.EndFrame();
+        }
+        return Frames;
+    }
+}
+
+TEST_CASE(FramePacer, HoldsTargetInterval)
+{
+    FSimulatedFrameClock Clock;
+    FFramePacer Pacer(&Clock);
+    Pacer.SetTargetFrameRate(100.0f);
+    Pacer.SetSafetyMargin(Margin);
+    const std::vector<FPacedFrame> Frames = RunFrames(Pacer, Clock, std::vector<uint64_t>(60, 2000));
+
+    // The first frame has no prediction yet, from the second one on every start is one interval apart
+    for (size_t Index = 2; Index < Frames.size(); ++Index)
+    {
+        TEST_CHECKF(Frames[Index].Start - Frames[Index - 1].Start == Interval, "frame %zu started %llu after the previous one",
+            Index, static_cast<unsigned long long>(Frames[Index].Start - Frames[Index - 1].Start));
+    }
+
+    // The clock starts at 0, the first frame still counts as the previous start of the second
+    TEST_CHECK(Pacer.GetFrameTimes().GetSampleNum() == Frames.size() - 1);
+    TEST_CHECK(Pacer.GetStats().FrameCount == Frames.size());
+    TEST_CHECK(Pacer.GetStats().P50 == 10.0f);
+}
+
+TEST_CASE(FramePacer, ResumesAfterSlowFrame)
+{
+    FSimulatedFrameClock Clock;
+    FFramePacer Pacer(&Clock);
+    Pacer.SetTargetFrameRate(100.0f);
+    Pacer.SetSafetyMargin(Margin);
+    std::vector<uint64_t> Work(30, 2000);
+    Work[10] = 35000;
+    const std::vector<FPacedFrame> Frames = RunFrames(Pacer, Clock, Work);
+
+    // The frame after the slow one starts right away instead of waiting for a missed deadline
+    TEST_CHECK(Frames[11].Start == Frames[10].Start + Work[10]);
+
+    // No burst of short frames to catch up, pacing picks up from the late frame
+    for (size_t Index = 12; Index < Frames.size(); ++Index)
+    {
+        TEST_CHECKF(Frames[Index].Start - Frames[Index - 1].Start == Interval, "frame %zu started %llu after the previous one",
+            Index, static_cast<unsigned long long>(Frames[Index].Start - Frames[Index - 1].Start));
+    }
+}
+
+TEST_CASE(FramePacer, WakesForPredictedWork)
+{
+    FSimulatedFrameClock Clock;
+    FFramePacer Pacer(&Clock);
+    Pacer.SetTargetFrameRate(100.0f);
+    Pacer.SetSafetyMargin(Margin);
+    std::vector<uint64_t> Work(20, 2000);
+    Work.resize(40, 6000);
+    const std::vector<FPacedFrame> Frames = RunFrames(Pacer, Clock, Work);
+
+    // The first deadline is the margin, every frame's work plus the margin ends on a later one
+    for (size_t Index = 2; Index < Frames.size(); ++Index)
+    {
+        if (Index == 20)
+        {
+            // The 6ms spike was not predicted, this frame still woke for 2ms
+            continue;
+        }
+        const uint64_t Offset = (Frames[Index].Start + Frames[Index].Work) % Interval;
+        TEST_CHECKF(Offset == 0, "frame %zu ends %llu off its deadline", Index, static_cast<unsigned long long>(Offset));
+    }
+
+    // Fast attack, the wake moves earlier by the extra work right after the spike
+    TEST_CHECK(Frames[21].Start - Frames[20].Start == Interval - (Work[20] - Work[19]));
+    TEST_CHECK(Pacer.GetStats().PredictedWorkTime == 6.0f);
+}
+
+TEST_CASE(FramePacer, UnlimitedMeasuresOnly)
+{
+    FSimulatedFrameClock Clock;
+    FFramePacer Pacer(&Clock);
+    Pacer.SetTargetFrameRate(0.0f);
+    const std::vector<FPacedFrame> Frames = RunFrames(Pacer, Clock, {1000, 3000, 2000});
+    TEST_CHECK(Frames[0].Start == 0 && Frames[1].Start == 1000 && Frames[2].Start == 4000);
+    TEST_CHECK(Pacer.GetFrameTimes().GetSampleNum() == 2);
+}
+
+TEST_CASE(FramePacer, Percentiles)
+{
+    // Nearest rank over 1..100 ms, added out of order
+    FFrameTimeStats Stats;
+    for (uint32_t Sample = 0; Sample < 100; ++Sample)
+    {
+        Stats.AddSample(static_cast<float>((Sample * 37) % 100 + 1));
+    }
+    TEST_CHECK(Stats.GetSampleNum() == 100);
+    TEST_CHECK(Stats.GetPercentile(50.0f) == 50.0f);
+    TEST_CHECK(Stats.GetPercentile(95.0f) == 95.0f);
+    TEST_CHECK(Stats.GetPercentile(99.0f) == 99.0f);
+    TEST_CHECK(Stats.GetPercentile(100.0f) == 100.0f);
+    TEST_CHECK(Stats.GetPercentile(0.0f) == 1.0f);
+    TEST_CHECK(Stats.GetAverage() == 50.5f);
+
+    Stats.Reset();
+    TEST_CHECK(Stats.GetSampleNum() == 0 && Stats.GetPercentile(50.0f) == 0.0f);
+}
+
+TEST_CASE(FramePacer, PercentilesKeepTheLatestWindow)
+{
+    // The window keeps the last WindowSize samples, the slow ones added first fall out
+    FFrameTimeStats Stats;
+    for (uint32_t Sample = 0; Sample < 60; ++Sample)
+    {
+        Stats.AddSample(100.0f);
+    }
+    for (uint32_t Sample = 0; Sample < FFrameTimeStats::WindowSize; ++Sample)
+    {
+        Stats.AddSample(Sample % 10 == 0 ? 20.0f : 10.0f);
+    }
+    TEST_CHECK(Stats.GetSampleNum() == FFrameTimeStats::WindowSize);
+    TEST_CHECK(Stats.GetPercentile(50.0f) == 10.0f);
+    TEST_CHECK(Stats.GetPercentile(95.0f) == 20.0f);
+    TEST_CHECK(Stats.GetPercentile(99.0f) == 20.0f);
+    TEST_CHECK(Stats.GetAverage() == 11.0f);
+}
@@ -0,0 +1,178 @@
+﻿#include "TestFramework.h"
+
+#include <random>
+#include "Engine/FrustumCulling.h"
+#include "glm/gtc/matrix_transform.hpp"
+
+namespace
+{
+    // Same as the CullBatchSize slices of FFrustumCulling::Cull
+    constexpr uint32_t CullBatchSize = 16384;
+
+    const char* GetPathName(ECullingPath Path)
+    {
+        switch (Path)
+        {
+        case ECullingPath::AVX2:
+            return "AVX2";
+        case ECullingPath::SSE:
+            return "SSE";
+        default:
+            return "Scalar";
+        }
+    }
+
+    // About half of the bounds straddle or leave the frustum, so every lane mask pattern shows up
+    FSceneBounds MakeRandomBounds(std::mt19937& Random, uint32_t Num)
+    {
+        std::uniform_real_distribution<float> Center(-60.0f, 60.0f);
+        std::uniform_real_distribution<float> Extent(0.0f, 4.0f);
+        FSceneBounds Bounds;
+        Bounds.Resize(Num);
+        for (uint32_t Index = 0; Index < Num; ++Index)
+        {
+            Bounds.CenterX[Index] = Center(Random);
+            Bounds.CenterY[Index] = Center(Random);
+            Bounds.CenterZ[Index] = Center(Random);
+            Bounds.ExtentX[Index] = Extent(Random);
+            Bounds.ExtentY[Index] = Extent(Random);
+            Bounds.ExtentZ[Index] = Extent(Random);
+            Bounds.Radius[Index] = glm::length(glm::vec3(Bounds.ExtentX[Index], Bounds.ExtentY[Index], Bounds.ExtentZ[Index]));
+        }
+        return Bounds;
+    }
+
+    FFrustum MakeRandomFrustum(std::mt19937& Random)
+    {
+        std::uniform_real_distribution<float> Unit(-1.0f, 1.0f);
+        const glm::vec3 Eye(Unit(Random) * 20.0f, Unit(Random) * 20.0f, Unit(Random) * 20.0f);
+        const glm::vec3 Target(Unit(Random) * 5.0f, Unit(Random) * 5.0f, Unit(Random) * 5.0f);
+        const glm::mat4 Projection = glm::perspective(glm::radians(60.0f + 30.0f * Unit(Random)), 16.0f / 9.0f, 0.1f, 80.0f);
+        return FFrustum::FromViewProjection(Projection * glm::lookAt(Eye, Target, glm::vec3(0.0f, 1.0f, 0.0f)));
+    }
+
+    // Runs Cull on every path the CPU has and compares the lists with the scalar one
+    void CheckPathsAgree(const FFrustum& Frustum, const FSceneBounds& Bounds, ECullingVolume Volume)
+    {
+        const uint32_t Num = static_cast<uint32_t>(Bounds.Num());
+        std::vector<uint32_t> Expected;
+        FFrustumCulling::SetPath(ECullingPath::Scalar);
+        const uint32_t ExpectedCount = FFrustumCulling::Cull(Frustum, Bounds, Volume, Expected);
+        TEST_CHECK(ExpectedCount == Expected.size());
+        for (size_t Index = 1; Index < Expected.size(); ++Index)
+        {
+            TEST_CHECKF(Expected[Index - 1] < Expected[Index], "Scalar path is not ascending at %zu of %u bounds", Index, Num);
+        }
+
+        for (ECullingPath Path : {ECullingPath::SSE, ECullingPath::AVX2})
+        {
+            FFrustumCulling::SetPath(Path);
+            if (FFrustumCulling::GetPath() != Path)
+            {
+                continue;
+            }
+            std::vector<uint32_t> Visible;
+            const uint32_t Count = FFrustumCulling::Cull(Frustum, Bounds, Volume, Visible);
+            TEST_CHECKF(Count == ExpectedCount && Visible == Expected, "%s path kept %u of %u %s bounds, scalar kept %u", GetPathName(Path), Count, Num,
+                Volume == ECullingVolume::Sphere ? "sphere" : "box", ExpectedCount);
+        }
+    }
+}
+
+TEST_CASE(FrustumCulling, ScalarMatchesPlaneTests)
+{
+    // A few hand placed bounds against an axis aligned frustum looking down -Z
+    const FFrustum Frustum = FFrustum::FromViewProjection(glm::perspective(glm::radians(90.0f), 1.0f, 1.0f, 100.0f));
+    FSceneBounds Bounds;
+    Bounds.Resize(4);
+    const glm::vec3 Centers[4] = {{0.0f, 0.0f, -10.0f}, {0.0f, 0.0f, 10.0f}, {14.0f, 0.0f, -10.0f}, {0.0f, 0.0f, -100.5f}};
+    for (uint32_t Index = 0; Index < 4; ++Index)
+    {
+        Bounds.CenterX[Index] = Centers[Index].x;
+        Bounds.CenterY[Index] = Centers[Index].y;
+        Bounds.CenterZ[Index] = Centers[Index].z;
+        Bounds.ExtentX[Index] = Bounds.ExtentY[Index] = Bounds.ExtentZ[Index] = 1.0f;
+        Bounds.Radius[Index] = std::sqrt(3.0f);
+    }
+
+    FFrustumCulling::SetPath(ECullingPath::Scalar);
+    std::vector<uint32_t> Visible;
+    FFrustumCulling::Cull(Frustum, Bounds, ECullingVolume::Box, Visible);
+    // Behind the camera and right of the 45 degree side plane are out, the box crossing the far plane is in
+    TEST_CHECK((Visible == std::vector<uint32_t>{0, 3}));
+}
+
+TEST_CASE(FrustumCulling, SimdPathsMatchScalarOnTails)
+{
+    // Every remainder of the 8 and 4 wide loops, including bounds that only hit the scalar tail
+    std::mt19937 Random(1);
+    for (uint32_t Num = 1; Num <= 40; ++Num)
+    {
+        for (uint32_t Round = 0; Round < 8; ++Round)
+        {
+            const FSceneBounds Bounds = MakeRandomBounds(Random, Num);
+            const FFrustum Frustum = MakeRandomFrustum(Random);
+            CheckPathsAgree(Frustum, Bounds, ECullingVolume::Box);
+            CheckPathsAgree(Frustum, Bounds, ECullingVolume::Sphere);
+        }
+    }
+}
+
+TEST_CASE(FrustumCulling, SimdPathsMatchScalarAcrossBatches)
+{
+    // Several CullBatchSize slices with tails that are not multiples of 4 or 8, the packing memmove has to close every gap
+    std::mt19937 Random(2);
+    const uint32_t Nums[] = {CullBatchSize - 3, CullBatchSize, CullBatchSize + 5, 2 * CullBatchSize + 13, 3 * CullBatchSize + 7, 5 * CullBatchSize + 1};
+    for (uint32_t Num : Nums)
+    {
+        const FSceneBounds Bounds = MakeRandomBounds(Random, Num);
+        for (uint32_t Round = 0; Round < 3; ++Round)
+        {
+            const FFrustum Frustum = MakeRandomFrustum(Random);
+            CheckPathsAgree(Frustum, Bounds, ECullingVolume::Box);
+            CheckPathsAgree(Frustum, Bounds, ECullingVolume::Sphere);
+        }
+    }
+}
+
+TEST_CASE(FrustumCulling, EmptyAndFullyVisibleBatches)
+{
+    // All visible and all culled slices next to each other, the counts of the packed slices go to both extremes
+    const uint32_t Num = 4 * CullBatchSize + 11;
+    FSceneBounds Bounds;
+    Bounds.Resize(Num);
+    for (uint32_t Index = 0; Index < Num; ++Index)
+    {
+        const bool bInside = (Index / CullBatchSize) % 2 == 0;
+        Bounds.CenterX[Index] = 0.0f;
+        Bounds.CenterY[Index] = 0.0f;
+        Bounds.CenterZ[Index] = bInside ? -10.0f : 10.0f;
+        Bounds.ExtentX[Index] = Bounds.ExtentY[Index] = Bounds.ExtentZ[Index] = 0.5f;
+        Bounds.Radius[Index] = 0.9f;
+    }
+    const FFrustum Frustum = FFrustum::FromViewProjection(glm::perspective(glm::radians(90.0f), 1.0f, 1.0f, 100.0f));
+
+    for (ECullingPath Path : {ECullingPath::Scalar, ECullingPath::SSE, ECullingPath::AVX2})
+    {
+        FFrustumCulling::SetPath(Path);
+        if (FFrustumCulling::GetPath() != Path)
+        {
+            continue;
+        }
+        std::vector<uint32_t> Visible;
+        const uint32_t Count = FFrustumCulling::Cull(Frustum, Bounds, ECullingVolume::Box, Visible);
+        uint32_t Expected = 0;
+        bool bMatch = Count == 2 * CullBatchSize + 11;
+        for (uint32_t Index = 0; Index < Num && bMatch; ++Index)
+        {
+            if ((Index / CullBatchSize) % 2 == 0)
+            {
+                bMatch = Expected < Count && Visible[Expected++] == Index;
+            }
+        }
+        TEST_CHECKF(bMatch, "%s path packed %u visible bounds wrong", GetPathName(Path), Count);
+    }
+
+    std::vector<uint32_t> Visible;
+    TEST_CHECK(FFrustumCulling::Cull(Frustum, FSceneBounds(), ECullingVolume::Box, Visible) == 0 && Visible.empty());
+}
@@ -0,0 +1,127 @@
+﻿#include "TestFramework.h"
+
+#include <cmath>
+#include "Engine/ImageCompare.h"
+
+namespace
+{
+    // Diagonal gradient with a bright square in the middle, enough structure for SSIM
+    FImage MakeImage(uint32_t Width, uint32_t Height)
+    {
+        FImage Image;
+        Image.Width = Width;
+        Image.Height = Height;
+        Image.Pixels.resize(static_cast<size_t>(Width) * Height * 4);
+        for (uint32_t Y = 0; Y < Height; ++Y)
+        {
+            for (uint32_t X = 0; X < Width; ++X)
+            {
+                uint8_t* Pixel = &Image.Pixels[(static_cast<size_t>(Y) * Width + X) * 4];
+                const bool bSquare = X >= Width / 4 && X < Width * 3 / 4 && Y >= Height / 4 && Y < Height * 3 / 4;
+                Pixel[0] = bSquare ? 230 : static_cast<uint8_t>(X * 160 / Width);
+                Pixel[1] = bSquare ? 220 : static_cast<uint8_t>(Y * 160 / Height);
+                Pixel[2] = static_cast<uint8_t>((X + Y) * 80 / (Width + Height));
+                Pixel[3] = 255;
+            }
+        }
+        return Image;
+    }
+
+    FImage AddOffset(const FImage& Source, int32_t Offset)
+    {
+        FImage Image = Source;
+        for (size_t Index = 0; Index < Image.Pixels.size(); Index += 4)
+        {
+            for (uint32_t Channel = 0; Channel < 3; ++Channel)
+            {
+                const int32_t Value = Image.Pixels[Index + Channel] + Offset;
+                Image.Pixels[Index + Channel] = static_cast<uint8_t>(Value < 0 ? 0 : (Value > 255 ? 255 : Value));
+            }
+        }
+        return Image;
+    }
+}
+
+TEST_CASE(ImageCompare, Identical)
+{
+    const FImage Golden = MakeImage(64, 48);
+    FImage Diff;
+    const FImageCompareResult Result = FImageCompare::Compare(Golden, Golden, FImageCompareThresholds(), &Diff);
+    TEST_CHECK(Result.bSizeMatches);
+    TEST_CHECK(Result.bPassed);
+    TEST_CHECK(std::isinf(Result.PSNR));
+    TEST_CHECKF(std::abs(Result.SSIM - 1.0) < 1e-9, "SSIM %f", Result.SSIM);
+    TEST_CHECK(Result.MaxDifference == 0);
+    TEST_CHECK(Result.DifferentPixels == 0);
+
+    // The diff image matches the input size, black with opaque alpha
+    TEST_CHECK(Diff.Width == Golden.Width && Diff.Height == Golden.Height && Diff.Pixels.size() == Golden.Pixels.size());
+    bool bDiffBlack = true;
+    for (size_t Index = 0; Index < Diff.Pixels.size(); Index += 4)
+    {
+        bDiffBlack &= Diff.Pixels[Index] == 0 && Diff.Pixels[Index + 1] == 0 && Diff.Pixels[Index + 2] == 0 && Diff.Pixels[Index + 3] == 255;
+    }
+    TEST_CHECK(bDiffBlack);
+}
+
+TEST_CASE(ImageCompare, SmallOffsetWithinTolerance)
+{
+    const FImage Golden = MakeImage(64, 48);
+    const FImage Image = AddOffset(Golden, 1);
+    const FImageCompareResult Result = FImageCompare::Compare(Golden, Image, FImageCompareThresholds());
+    TEST_CHECK(Result.bSizeMatches);
+    TEST_CHECK(Result.MaxDifference == 1);
+    TEST_CHECK(Result.DifferentPixels == 0);
+    // An error of 1 on every channel is 20 * log10(255), about 48 dB
+    TEST_CHECKF(std::abs(Result.PSNR - 20.0 * std::log10(255.0)) < 1e-6, "PSNR %f", Result.PSNR);
+    TEST_CHECK(Result.bPassed);
+}
+
+TEST_CASE(ImageCompare, LargeOffsetFails)
+{
+    const FImage Golden = MakeImage(64, 48);
+    const FImage Image = AddOffset(Golden, 20);
+    FImage Diff;
+    const FImageCompareResult Result = FImageCompare::Compare(Golden, Image, FImageCompareThresholds(), &Diff);
+    TEST_CHECK(Result.bSizeMatches);
+    TEST_CHECK(Result.MaxDifference == 20);
+    TEST_CHECK(Result.DifferentPixels > 0);
+    TEST_CHECKF(Result.PSNR < FImageCompareThresholds().MinPSNR, "PSNR %f", Result.PSNR);
+    TEST_CHECK(!Result.bPassed);
+    // Differences are scaled up in the diff image
+    TEST_CHECK(Diff.Pixels[0] == 160);
+}
+
+TEST_CASE(ImageCompare, IsolatedPixelsFailPixelRatio)
+{
+    const FImage Golden = MakeImage(64, 48);
+    FImage Image = Golden;
+    for (uint32_t Index = 0; Index < 8; ++Index)
+    {
+        Image.Pixels[static_cast<size_t>(Index) * 97 * 4] ^= 0x80;
+    }
+
+    FImageCompareThresholds Thresholds;
+    const FImageCompareResult Result = FImageCompare::Compare(Golden, Image, Thresholds);
+    TEST_CHECK(Result.DifferentPixels == 8);
+    TEST_CHECK(!Result.bPassed);
+
+    Thresholds.MaxDifferentPixelRatio = 0.01;
+    Thresholds.MinPSNR = 0.0;
+    Thresholds.MinSSIM = 0.0;
+    TEST_CHECK(FImageCompare::Compare(Golden, Image, Thresholds).bPassed);
+}
+
+TEST_CASE(ImageCompare, SizeMismatch)
+{
+    const FImage Golden = MakeImage(64, 48);
+    const FImage Image = MakeImage(48, 64);
+    const FImageCompareResult Result = FImageCompare::Compare(Golden, Image, FImageCompareThresholds());
+    TEST_CHECK(!Result.bSizeMatches);
+    TEST_CHECK(!Result.bPassed);
+    TEST_CHECK(FImageCompare::ComputePSNR(Golden, Image) == 0.0);
+    TEST_CHECK(FImageCompare::ComputeSSIM(Golden, Image) == 0.0);
+
+    // An empty golden, no capture saved yet, never passes
+    TEST_CHECK(!FImageCompare::Compare(FImage(), FImage(), FImageCompareThresholds()).bPassed);
+}
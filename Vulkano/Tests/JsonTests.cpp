@@ -0,0 +1,106 @@
+﻿#include "TestFramework.h"
+
+#include <cmath>
+#include <limits>
+#include <string>
+#include "Core/Json.h"
+
+TEST_CASE(Json, RoundTrip)
+{
+    FJsonValue Passes = FJsonValue::MakeArray();
+    Passes.Append(FJsonValue(1.5));
+    Passes.Append(FJsonValue(true));
+    Passes.Append(FJsonValue());
+
+    FJsonValue Document = FJsonValue::MakeObject();
+    Document.SetField("scene", "Sponza \"lit\"\n\ttab\\");
+    Document.SetField("frames", 240u);
+    Document.SetField("frame_ms", 16.6667);
+    Document.SetField("negative", -3);
+    Document.SetField("bytes", static_cast<uint64_t>(1) << 40);
+    Document.SetField("passes", Passes);
+    Document.SetField("empty", FJsonValue::MakeObject());
+
+    const std::string Text = Document.Serialize();
+    TEST_CHECKF(Text.find('\n') == std::string::npos, "serialized document spans lines: %s", Text.c_str());
+
+    FJsonValue Parsed;
+    TEST_CHECKF(FJsonValue::Parse(Text, Parsed), "failed parsing %s", Text.c_str());
+    TEST_CHECK(Parsed.GetType() == EJsonType::Object);
+    TEST_CHECK(Parsed.GetField("scene").GetString() == "Sponza \"lit\"\n\ttab\\");
+    TEST_CHECK(Parsed.GetField("frames").GetNumber() == 240.0);
+    TEST_CHECK(Parsed.GetField("frame_ms").GetNumber() == 16.6667);
+    TEST_CHECK(Parsed.GetField("negative").GetNumber() == -3.0);
+    TEST_CHECK(Parsed.GetField("bytes").GetNumber() == static_cast<double>(static_cast<uint64_t>(1) << 40));
+    TEST_CHECK(Parsed.GetField("empty").GetType() == EJsonType::Object);
+    TEST_CHECK(Parsed.GetField("empty").GetFields().empty());
+
+    const FJsonValue& ParsedPasses = Parsed.GetField("passes");
+    TEST_CHECK(ParsedPasses.GetSize() == 3);
+    TEST_CHECK(ParsedPasses[0].GetNumber() == 1.5);
+    TEST_CHECK(ParsedPasses[1].GetBool());
+    TEST_CHECK(ParsedPasses[2].IsNull());
+
+    // Serializing the parsed document again gives the same text, fields are ordered by key
+    TEST_CHECK(Parsed.Serialize() == Text);
+}
+
+TEST_CASE(Json, ParsesWhitespaceAndEscapes)
+{
+    FJsonValue Parsed;
+    TEST_CHECK(FJsonValue::Parse(" {\r\n\t\"a\" : [ 1 , 2e3 ] , \"b\" : \"\\u00e9\\/\" } ", Parsed));
+    TEST_CHECK(Parsed.GetField("a")[1].GetNumber() == 2000.0);
+    TEST_CHECK(Parsed.GetField("b").GetString() == "\xC3\xA9/");
+}
+
+TEST_CASE(Json, MissingFieldsReadAsNull)
+{
+    FJsonValue Parsed;
+    TEST_CHECK(FJsonValue::Parse("{\"a\":1}", Parsed));
+    TEST_CHECK(!Parsed.HasField("b"));
+    TEST_CHECK(Parsed.GetField("b").IsNull());
+    TEST_CHECK(Parsed.GetField("b").GetNumber(7.0) == 7.0);
+    TEST_CHECK(Parsed.GetField("b").GetString().empty());
+}
+
+TEST_CASE(Json, NonFiniteNumbersWriteNull)
+{
+    FJsonValue Document = FJsonValue::MakeArray();
+    Document.Append(FJsonValue(std::numeric_limits<double>::infinity()));
+    Document.Append(FJsonValue(std::nan("")));
+    TEST_CHECK(Document.Serialize() == "[null,null]");
+}
+
+TEST_CASE(Json, RejectsMalformedInput)
+{
+    const char* Malformed[] =
+    {
+        "",
+        "   ",
+        "{",
+        "[1, 2",
+        "{\"a\" 1}",
+        "{\"a\":1,}",
+        "{a:1}",
+        "[1,]",
+        "\"unterminated",
+        "\"bad escape \\q\"",
+        "\"short \\u12\"",
+        "tru",
+        "nul",
+        "-",
+        "{} trailing",
+        "[1] [2]",
+    };
+    for (const char* Text : Malformed)
+    {
+        FJsonValue Parsed(1.0);
+        TEST_CHECKF(!FJsonValue::Parse(Text, Parsed), "accepted malformed input '%s'", Text);
+        TEST_CHECKF(Parsed.IsNull(), "malformed input '%s' left a value behind", Text);
+    }
+
+    // Nesting deeper than the parser allows fails instead of overflowing the stack
+    const std::string Deep = std::string(1000, '[') + std::string(1000, ']');
+    FJsonValue Parsed;
+    TEST_CHECK(!FJsonValue::Parse(Deep, Parsed));
+}
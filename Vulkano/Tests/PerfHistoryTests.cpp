@@ -0,0 +1,167 @@
+﻿#include "TestFramework.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include "Engine/PerfHistory.h"
+
+namespace
+{
+    FPerfRecord MakeRecord(const std::string& Scene, double FrameMilliseconds, double PassMilliseconds)
+    {
+        FPerfRecord Record;
+        Record.Scene = Scene;
+        Record.Timestamp = "2026-01-01T00:00:00Z";
+        Record.Device = "TestDevice";
+        Record.FrameNum = 120;
+        Record.FrameMilliseconds = FrameMilliseconds;
+        Record.FrameP95Milliseconds = FrameMilliseconds * 1.2;
+        Record.Passes.push_back({"BasePass", PassMilliseconds, PassMilliseconds * 0.5});
+        return Record;
+    }
+
+    // History file in the temp directory, removed again when the test is done
+    class FScopedHistoryFile
+    {
+    public:
+        explicit FScopedHistoryFile(const char* Name)
+            : Path((std::filesystem::temp_directory_path() / Name).string())
+        {
+            std::filesystem::remove(Path);
+        }
+        ~FScopedHistoryFile()
+        {
+            std::filesystem::remove(Path);
+        }
+
+        const std::string Path;
+    };
+}
+
+TEST_CASE(PerfHistory, AppendAndLoad)
+{
+    FScopedHistoryFile File("VulkanoPerfHistoryAppend.jsonl");
+    FPerfHistory History;
+    TEST_CHECK(!History.Load(File.Path));
+    TEST_CHECK(History.GetRecords().empty());
+
+    TEST_CHECK(FPerfHistory::Append(File.Path, MakeRecord("Sponza", 10.0, 4.0)));
+    TEST_CHECK(FPerfHistory::Append(File.Path, MakeRecord("Bistro", 12.5, 6.0)));
+    {
+        // Blank and malformed lines are skipped, the rest of the file still loads
+        std::ofstream Stream(File.Path, std::ios::out | std::ios::app);
+        Stream << "\n{\"scene\": \n";
+    }
+    TEST_CHECK(FPerfHistory::Append(File.Path, MakeRecord("Sponza", 11.0, 4.5)));
+
+    TEST_CHECK(History.Load(File.Path));
+    const std::vector<FPerfRecord>& Records = History.GetRecords();
+    TEST_CHECK(Records.size() == 3);
+    if (Records.size() == 3)
+    {
+        TEST_CHECK(Records[1].Scene == "Bistro");
+        TEST_CHECK(Records[1].Device == "TestDevice");
+        TEST_CHECK(Records[1].Timestamp == "2026-01-01T00:00:00Z");
+        TEST_CHECK(Records[1].FrameNum == 120);
+        TEST_CHECK(Records[1].FrameMilliseconds == 12.5);
+        TEST_CHECK(Records[1].FrameP95Milliseconds == 12.5 * 1.2);
+        TEST_CHECK(Records[1].Passes.size() == 1 && Records[1].Passes[0].Name == "BasePass" && Records[1].Passes[0].GpuMilliseconds == 6.0);
+        TEST_CHECK(Records[2].FrameMilliseconds == 11.0);
+    }
+}
+
+TEST_CASE(PerfHistory, NoBaseline)
+{
+    FScopedHistoryFile File("VulkanoPerfHistoryNoBaseline.jsonl");
+    TEST_CHECK(FPerfHistory::Append(File.Path, MakeRecord("Bistro", 10.0, 4.0)));
+    FPerfRecord OtherDevice = MakeRecord("Sponza", 10.0, 4.0);
+    OtherDevice.Device = "OtherDevice";
+    TEST_CHECK(FPerfHistory::Append(File.Path, OtherDevice));
+
+    FPerfHistory History;
+    TEST_CHECK(History.Load(File.Path));
+
+    // Only earlier runs of the same scene on the same device are a baseline
+    const FPerfCheckResult Result = History.Check(MakeRecord("Sponza", 100.0, 40.0), FPerfThresholds());
+    TEST_CHECK(!Result.bHasBaseline);
+    TEST_CHECK(Result.bPassed);
+    TEST_CHECK(Result.Regressions.empty());
+}
+
+TEST_CASE(PerfHistory, RegressionThreshold)
+{
+    FScopedHistoryFile File("VulkanoPerfHistoryThreshold.jsonl");
+    for (double Frame : {9.0, 10.0, 10.0, 11.0, 50.0})
+    {
+        TEST_CHECK(FPerfHistory::Append(File.Path, MakeRecord("Sponza", Frame, 4.0)));
+    }
+    FPerfHistory History;
+    TEST_CHECK(History.Load(File.Path));
+
+    FPerfThresholds Thresholds;
+    Thresholds.MaxRegression = 0.1;
+    Thresholds.BaselineRuns = 5;
+
+    // The baseline is the median frame time, 10 ms, the slow outlier run doesn't move it
+    FPerfCheckResult Result = History.Check(MakeRecord("Sponza", 10.9, 4.3), Thresholds);
+    TEST_CHECK(Result.bHasBaseline);
+    TEST_CHECKF(Result.bPassed, "%s", Result.Regressions.empty() ? "" : Result.Regressions[0].c_str());
+    TEST_CHECK(Result.Regressions.empty());
+
+    Result = History.Check(MakeRecord("Sponza", 11.2, 4.0), Thresholds);
+    TEST_CHECK(Result.bHasBaseline);
+    TEST_CHECK(!Result.bPassed);
+    TEST_CHECK(Result.Regressions.size() == 1 && Result.Regressions[0].find("Sponza frame") == 0);
+
+    // Passes are held to the same threshold against their own median
+    Result = History.Check(MakeRecord("Sponza", 10.0, 4.5), Thresholds);
+    TEST_CHECK(!Result.bPassed);
+    TEST_CHECK(Result.Regressions.size() == 1 && Result.Regressions[0].find("pass BasePass GPU") != std::string::npos);
+
+    // Faster runs always pass
+    Result = History.Check(MakeRecord("Sponza", 5.0, 1.0), Thresholds);
+    TEST_CHECK(Result.bPassed);
+}
+
+TEST_CASE(PerfHistory, BaselineUsesNewestRuns)
+{
+    FScopedHistoryFile File("VulkanoPerfHistoryNewest.jsonl");
+    for (double Frame : {20.0, 20.0, 20.0, 10.0, 10.0})
+    {
+        TEST_CHECK(FPerfHistory::Append(File.Path, MakeRecord("Sponza", Frame, 4.0)));
+    }
+    FPerfHistory History;
+    TEST_CHECK(History.Load(File.Path));
+
+    // The older slow runs are out of a two run baseline
+    FPerfThresholds Thresholds;
+    Thresholds.BaselineRuns = 2;
+    TEST_CHECK(!History.Check(MakeRecord("Sponza", 15.0, 4.0), Thresholds).bPassed);
+    Thresholds.BaselineRuns = 5;
+    TEST_CHECK(History.Check(MakeRecord("Sponza", 15.0, 4.0), Thresholds).bPassed);
+}
+
+TEST_CASE(PerfHistory, IgnoresPassesBelowMinimum)
+{
+    FScopedHistoryFile File("VulkanoPerfHistoryMinimum.jsonl");
+    for (uint32_t Run = 0; Run < 3; ++Run)
+    {
+        TEST_CHECK(FPerfHistory::Append(File.Path, MakeRecord("Sponza", 10.0, 0.01)));
+    }
+    FPerfHistory History;
+    TEST_CHECK(History.Load(File.Path));
+
+    FPerfThresholds Thresholds;
+    Thresholds.MinPassMilliseconds = 0.05;
+
+    // A pass that was below the noise floor in the baseline never fails, even at many times its old cost
+    FPerfCheckResult Result = History.Check(MakeRecord("Sponza", 10.0, 0.04), Thresholds);
+    TEST_CHECK(Result.bHasBaseline);
+    TEST_CHECKF(Result.bPassed, "%s", Result.Regressions.empty() ? "" : Result.Regressions[0].c_str());
+
+    // With the floor lowered the same pass counts and is reported
+    Thresholds.MinPassMilliseconds = 0.0;
+    Result = History.Check(MakeRecord("Sponza", 10.0, 0.04), Thresholds);
+    TEST_CHECK(!Result.bPassed);
+    TEST_CHECK(Result.Regressions.size() == 1 && Result.Regressions[0].find("pass BasePass GPU") != std::string::npos);
+}
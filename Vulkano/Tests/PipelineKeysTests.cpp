@@ -0,0 +1,169 @@
+﻿#include "TestFramework.h"
+
+#include <iterator>
+#include <map>
+#include "Render/PipelineKeys.h"
+
+// FVulkan::SetGraphicsPipeline looks its PSOs up by FGraphicsPipelineKey, these build keys from mocked handles
+// and vertex layouts like FSimpleVertexInput and FInstancedStaticVertexInput declare them
+namespace
+{
+    template <typename THandle>
+    THandle MakeHandle(uintptr_t Value)
+    {
+        return reinterpret_cast<THandle>(Value);
+    }
+
+    struct FTestVertexInput
+    {
+        std::vector<VkVertexInputBindingDescription> Bindings;
+        std::vector<VkVertexInputAttributeDescription> Attributes;
+
+        VkPipelineVertexInputStateCreateInfo GetState() const
+        {
+            VkPipelineVertexInputStateCreateInfo State{};
+            State.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+            State.vertexBindingDescriptionCount = static_cast<uint32_t>(Bindings.size());
+            State.pVertexBindingDescriptions = Bindings.data();
+            State.vertexAttributeDescriptionCount = static_cast<uint32_t>(Attributes.size());
+            State.pVertexAttributeDescriptions = Attributes.data();
+            return State;
+        }
+    };
+
+    // Position and UV on binding 0
+    FTestVertexInput MakeSimpleInput()
+    {
+        FTestVertexInput Input;
+        Input.Bindings = {{0, 16, VK_VERTEX_INPUT_RATE_VERTEX}};
+        Input.Attributes = {{0, 0, VK_FORMAT_R32G32_SFLOAT, 0}, {1, 0, VK_FORMAT_R32G32_SFLOAT, 8}};
+        return Input;
+    }
+
+    // Static mesh vertices on binding 0, the world matrix and material index per instance on binding 1
+    FTestVertexInput MakeInstancedInput()
+    {
+        FTestVertexInput Input;
+        Input.Bindings = {{0, 44, VK_VERTEX_INPUT_RATE_VERTEX}, {1, 80, VK_VERTEX_INPUT_RATE_INSTANCE}};
+        Input.Attributes = {
+            {0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0}, {1, 0, VK_FORMAT_R32G32B32_SFLOAT, 12}, {2, 0, VK_FORMAT_R32G32_SFLOAT, 24}, {3, 0, VK_FORMAT_R32G32B32_SFLOAT, 32},
+            {4, 1, VK_FORMAT_R32G32B32A32_SFLOAT, 0}, {5, 1, VK_FORMAT_R32G32B32A32_SFLOAT, 16}, {6, 1, VK_FORMAT_R32G32B32A32_SFLOAT, 32},
+            {7, 1, VK_FORMAT_R32G32B32A32_SFLOAT, 48}, {8, 1, VK_FORMAT_R32_UINT, 64},
+        };
+        return Input;
+    }
+
+    FRenderPass MakePass(VkRenderPass Handle)
+    {
+        FRenderPass Pass;
+        Pass.RenderPassName = "Render Quad";
+        Pass.RenderPass = Handle;
+        Pass.ColorFormats = {VK_FORMAT_R8G8B8A8_SRGB};
+        Pass.DepthFormat = VK_FORMAT_D32_SFLOAT;
+        return Pass;
+    }
+
+    FGraphicsPipelineKey MakeKey(uintptr_t VertexShader, const FTestVertexInput& Input, VkPrimitiveTopology Topology, const FRenderPass& Pass,
+        const FGraphicsPipelineState& State = {}, const std::string& PixelEntryPoint = "main")
+    {
+        return FGraphicsPipelineKey::Create(MakeHandle<VkShaderModule>(VertexShader), "main", MakeHandle<VkShaderModule>(100), PixelEntryPoint,
+            Topology, Input.GetState(), State, Pass);
+    }
+}
+
+TEST_CASE(PipelineKeys, InitializersOnOnePassGetTheirOwnPipelines)
+{
+    // The quad and the instanced meshes of the base pass, a PSO cache like FVulkan's behind them
+    const FRenderPass Pass = MakePass(MakeHandle<VkRenderPass>(7));
+    const FGraphicsPipelineKey Quad = MakeKey(1, MakeSimpleInput(), VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP, Pass);
+    FGraphicsPipelineState DepthState;
+    DepthState.bDepthTest = true;
+    DepthState.bDepthWrite = true;
+    const FGraphicsPipelineKey Instanced = MakeKey(2, MakeInstancedInput(), VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, Pass, DepthState);
+    TEST_CHECK(!(Quad == Instanced));
+
+    std::map<FGraphicsPipelineKey, VkPipeline> PSOs;
+    uintptr_t NextPipeline = 1;
+    auto FindOrCreate = [&PSOs, &NextPipeline](const FGraphicsPipelineKey& Key)
+    {
+        auto It = PSOs.find(Key);
+        return It != PSOs.end() ? It->second : PSOs[Key] = MakeHandle<VkPipeline>(NextPipeline++);
+    };
+    const VkPipeline QuadPipeline = FindOrCreate(Quad);
+    const VkPipeline InstancedPipeline = FindOrCreate(Instanced);
+    TEST_CHECK(QuadPipeline != InstancedPipeline);
+    TEST_CHECK(FindOrCreate(Quad) == QuadPipeline && FindOrCreate(Instanced) == InstancedPipeline);
+    TEST_CHECK(PSOs.size() == 2);
+}
+
+TEST_CASE(PipelineKeys, EveryInitializerFieldCounts)
+{
+    const FRenderPass Pass = MakePass(MakeHandle<VkRenderPass>(7));
+    const FTestVertexInput Simple = MakeSimpleInput();
+    const FGraphicsPipelineKey Base = MakeKey(1, Simple, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, Pass);
+
+    // Same shaders, stride, per instance rate, attribute format and offset
+    FTestVertexInput Stride = Simple;
+    Stride.Bindings[0].stride = 20;
+    FTestVertexInput Rate = Simple;
+    Rate.Bindings[0].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+    FTestVertexInput Format = Simple;
+    Format.Attributes[1].format = VK_FORMAT_R16G16_SFLOAT;
+    FTestVertexInput Location = Simple;
+    Location.Attributes[1].location = 2;
+    FGraphicsPipelineState Cull;
+    Cull.CullMode = VK_CULL_MODE_NONE;
+    FGraphicsPipelineState Blend;
+    Blend.bBlendEnable = true;
+    FGraphicsPipelineState Depth;
+    Depth.bDepthTest = true;
+    FGraphicsPipelineState Compare;
+    Compare.DepthCompareOp = VK_COMPARE_OP_GREATER;
+    FRenderPass Formats = Pass;
+    Formats.ColorFormats[0] = VK_FORMAT_R16G16B16A16_SFLOAT;
+    FRenderPass NoDepth = Pass;
+    NoDepth.DepthFormat = VK_FORMAT_UNDEFINED;
+    FRenderPass OtherPass = Pass;
+    OtherPass.RenderPass = MakeHandle<VkRenderPass>(8);
+
+    const FGraphicsPipelineKey Variants[] = {
+        MakeKey(2, Simple, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, Pass),
+        MakeKey(1, Simple, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, Pass, {}, "MainPS"),
+        MakeKey(1, Simple, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP, Pass),
+        MakeKey(1, Stride, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, Pass),
+        MakeKey(1, Rate, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, Pass),
+        MakeKey(1, Format, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, Pass),
+        MakeKey(1, Location, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, Pass),
+        MakeKey(1, Simple, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, Pass, Cull),
+        MakeKey(1, Simple, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, Pass, Blend),
+        MakeKey(1, Simple, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, Pass, Depth),
+        MakeKey(1, Simple, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, Pass, Compare),
+        MakeKey(1, Simple, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, Formats),
+        MakeKey(1, Simple, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, NoDepth),
+        MakeKey(1, Simple, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, OtherPass),
+    };
+    std::map<FGraphicsPipelineKey, uint32_t> Keys;
+    Keys[Base] = 0;
+    uint32_t Index = 1;
+    for (const FGraphicsPipelineKey& Variant : Variants)
+    {
+        TEST_CHECKF(!(Variant == Base), "variant %u keys like the base initializer", Index);
+        Keys[Variant] = Index++;
+    }
+    TEST_CHECK(Keys.size() == std::size(Variants) + 1);
+}
+
+TEST_CASE(PipelineKeys, EqualStateSharesAPipeline)
+{
+    // Separate vertex input objects and passes with the same layout are one pipeline
+    const FTestVertexInput First = MakeInstancedInput();
+    const FTestVertexInput Second = MakeInstancedInput();
+    FRenderPass Pass = MakePass(VK_NULL_HANDLE);
+    FRenderPass OtherPass = Pass;
+    OtherPass.RenderPassName = "Translucency";
+    TEST_CHECK(MakeKey(1, First, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, Pass) == MakeKey(1, Second, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, OtherPass));
+
+    // An empty declaration is a layout of its own
+    const FTestVertexInput Empty;
+    TEST_CHECK(!(MakeKey(1, Empty, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, Pass) == MakeKey(1, First, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, Pass)));
+}
@@ -0,0 +1,99 @@
+﻿#include "TestFramework.h"
+
+#include <algorithm>
+#include <random>
+#include "Core/RadixSort.h"
+
+namespace
+{
+    // Sorts Num keys drawn by MakeKey with both RadixSort and std::stable_sort, values carry the input index
+    // so any reordering of equal keys shows up as a mismatch
+    template <typename FMakeKey>
+    bool MatchesStableSort(uint32_t Num, FMakeKey MakeKey)
+    {
+        std::vector<uint64_t> Keys(Num);
+        std::vector<uint32_t> Values(Num);
+        for (uint32_t Index = 0; Index < Num; ++Index)
+        {
+            Keys[Index] = MakeKey();
+            Values[Index] = Index;
+        }
+
+        std::vector<uint32_t> Expected = Values;
+        std::stable_sort(Expected.begin(), Expected.end(), [&Keys](uint32_t A, uint32_t B) { return Keys[A] < Keys[B]; });
+        const std::vector<uint64_t> InputKeys = Keys;
+
+        RadixSort(Keys, Values);
+        if (Keys.size() != Num || Values != Expected)
+        {
+            return false;
+        }
+        for (uint32_t Index = 0; Index < Num; ++Index)
+        {
+            if (Keys[Index] != InputKeys[Expected[Index]])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Below, at and above the parallel threshold, and a count that leaves the last chunk short
+    const uint32_t TestSizes[] = {0, 1, 2, 3, 255, 4096, 65535, 65536, 65537, 3 * 32768 + 17, 250000};
+}
+
+TEST_CASE(RadixSort, RandomKeysMatchStableSort)
+{
+    std::mt19937_64 Random(1);
+    for (uint32_t Num : TestSizes)
+    {
+        TEST_CHECKF(MatchesStableSort(Num, [&Random]() { return Random(); }), "random keys, %u elements", Num);
+    }
+}
+
+TEST_CASE(RadixSort, DuplicateKeysStayInInputOrder)
+{
+    std::mt19937_64 Random(2);
+    for (uint32_t Num : TestSizes)
+    {
+        // A few distinct values spread over every byte, every pass runs and most keys are equal
+        TEST_CHECKF(MatchesStableSort(Num, [&Random]() { return (Random() % 7) * 0x0123456789abcdefull; }), "7 distinct keys, %u elements", Num);
+    }
+}
+
+TEST_CASE(RadixSort, ConstantDigitsSkipPasses)
+{
+    std::mt19937_64 Random(3);
+    // Only some bytes vary, so the first pass that runs is not pass 0 and passes in between are skipped
+    const uint64_t Masks[] = {0xff00000000000000ull, 0x0000ff0000ff0000ull, 0x00000000000000ffull, 0x0f0000ff00000f00ull};
+    for (uint64_t Mask : Masks)
+    {
+        for (uint32_t Num : TestSizes)
+        {
+            TEST_CHECKF(MatchesStableSort(Num, [&Random, Mask]() { return (Random() & Mask) | 0x1000100010001000ull; }),
+                "mask %016llx, %u elements", static_cast<unsigned long long>(Mask), Num);
+        }
+    }
+
+    // Every pass skipped, the input order is the stable order
+    for (uint32_t Num : TestSizes)
+    {
+        TEST_CHECKF(MatchesStableSort(Num, []() { return 0x5a5a5a5a5a5a5a5aull; }), "constant keys, %u elements", Num);
+    }
+}
+
+TEST_CASE(RadixSort, DrawSortKeyLayout)
+{
+    // Keys shaped like FDrawSortKey: few pipelines and materials in the high bits, depth in the low 20
+    std::mt19937_64 Random(4);
+    for (uint32_t Num : TestSizes)
+    {
+        TEST_CHECKF(MatchesStableSort(Num, [&Random]()
+        {
+            const uint64_t Pipeline = Random() % 16;
+            const uint64_t Material = Random() % 256;
+            const uint64_t VertexBuffer = Random() % 64;
+            return (Pipeline << 52) | (Material << 36) | (VertexBuffer << 20) | (Random() & 0xfffff);
+        }), "draw keys, %u elements", Num);
+    }
+}
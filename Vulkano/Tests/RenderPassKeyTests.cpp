@@ -0,0 +1,55 @@
+﻿#include "TestFramework.h"
+
+#include <map>
+#include "Render/RenderPassKey.h"
+
+// FVulkan keeps its compatible VkRenderPasses in a map of FRenderPassKey, these keys are what FRenderPassKey::Create
+// makes of a GBuffer pass with a color and a depth target
+namespace
+{
+    FRenderPassKey MakeBasePassKey()
+    {
+        FRenderPassKey Key;
+        Key.ColorAttachments.push_back({VK_FORMAT_R8G8B8A8_SRGB, VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL});
+        Key.DepthAttachment = {VK_FORMAT_D32_SFLOAT, VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+        return Key;
+    }
+}
+
+TEST_CASE(RenderPassKey, EveryAttachmentFieldCounts)
+{
+    std::vector<FRenderPassKey> Keys(12, MakeBasePassKey());
+    Keys[1].ColorAttachments[0].Format = VK_FORMAT_R8G8B8A8_UNORM;
+    Keys[2].ColorAttachments[0].Samples = VK_SAMPLE_COUNT_4_BIT;
+    Keys[3].ColorAttachments[0].Load = VK_ATTACHMENT_LOAD_OP_LOAD;
+    Keys[4].ColorAttachments[0].Store = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    Keys[5].ColorAttachments[0].FinalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    Keys[6].DepthAttachment.Format = VK_FORMAT_D24_UNORM_S8_UINT;
+    Keys[7].DepthAttachment.Samples = VK_SAMPLE_COUNT_4_BIT;
+    Keys[8].DepthAttachment.Load = VK_ATTACHMENT_LOAD_OP_LOAD;
+    Keys[9].DepthAttachment.Store = VK_ATTACHMENT_STORE_OP_STORE;
+    Keys[10].DepthAttachment = {};
+    Keys[11].ColorAttachments.push_back(Keys[11].ColorAttachments[0]);
+
+    // Each variant gets its own render pass, the base key finds its own again
+    std::map<FRenderPassKey, uint32_t> RenderPasses;
+    for (uint32_t Index = 0; Index < Keys.size(); ++Index)
+    {
+        TEST_CHECKF(RenderPasses.emplace(Keys[Index], Index).second, "key %u shares a render pass with an earlier one", Index);
+    }
+    TEST_CHECK(RenderPasses.find(MakeBasePassKey())->second == 0);
+}
+
+TEST_CASE(RenderPassKey, EqualKeysShareARenderPass)
+{
+    const FRenderPassKey Key = MakeBasePassKey();
+    const FRenderPassKey Same = MakeBasePassKey();
+    TEST_CHECK(Key == Same && !(Key < Same) && !(Same < Key));
+    TEST_CHECK(Key.HasDepth());
+
+    FRenderPassKey ColorOnly = Key;
+    ColorOnly.DepthAttachment = {};
+    TEST_CHECK(!ColorOnly.HasDepth() && !(ColorOnly == Key));
+}
@@ -0,0 +1,179 @@
+﻿#include "TestFramework.h"
+
+#include <random>
+#include "Engine/Scene.h"
+#include "glm/gtc/matrix_transform.hpp"
+
+namespace
+{
+    struct FReferenceEntity
+    {
+        FEntityId Parent = InvalidEntity;
+        glm::vec3 Position = glm::vec3(0.0f);
+        glm::quat Rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+        glm::vec3 Scale = glm::vec3(1.0f);
+        FBoundingBox Bounds;
+    };
+
+    // Naive recursive evaluation, every entity walks up to its root through plain glm matrix products
+    glm::mat4 GetReferenceWorld(const std::vector<FReferenceEntity>& Entities, FEntityId Entity)
+    {
+        const FReferenceEntity& Reference = Entities[Entity];
+        const glm::mat4 Local = glm::translate(glm::mat4(1.0f), Reference.Position) * glm::mat4_cast(Reference.Rotation) * glm::scale(glm::mat4(1.0f), Reference.Scale);
+        return Reference.Parent == InvalidEntity ? Local : GetReferenceWorld(Entities, Reference.Parent) * Local;
+    }
+
+    bool IsNear(float Value, float Expected)
+    {
+        return std::abs(Value - Expected) <= 1e-4f * std::max(1.0f, std::abs(Expected));
+    }
+
+    FReferenceEntity MakeRandomEntity(std::mt19937& Random, FEntityId Parent)
+    {
+        std::uniform_real_distribution<float> Position(-10.0f, 10.0f);
+        std::uniform_real_distribution<float> Unit(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> Scale(0.5f, 1.5f);
+        std::uniform_real_distribution<float> Size(0.0f, 2.0f);
+
+        FReferenceEntity Entity;
+        Entity.Parent = Parent;
+        Entity.Position = glm::vec3(Position(Random), Position(Random), Position(Random));
+        Entity.Rotation = glm::normalize(glm::quat(Unit(Random), Unit(Random), Unit(Random), Unit(Random) + 1.5f));
+        Entity.Scale = glm::vec3(Scale(Random), Scale(Random), Scale(Random));
+        const glm::vec3 Min(Position(Random), Position(Random), Position(Random));
+        Entity.Bounds.Min = Min;
+        Entity.Bounds.Max = Min + glm::vec3(Size(Random), Size(Random), Size(Random));
+        return Entity;
+    }
+
+    void CheckAgainstReference(const FScene& Scene, const std::vector<FReferenceEntity>& Entities)
+    {
+        const FSceneBounds& Bounds = Scene.GetWorldBounds();
+        uint32_t MatrixMismatches = 0;
+        uint32_t BoundsMismatches = 0;
+        for (FEntityId Entity = 0; Entity < Entities.size(); ++Entity)
+        {
+            const glm::mat4 Expected = GetReferenceWorld(Entities, Entity);
+            const glm::mat4& World = Scene.GetWorldMatrix(Entity);
+            for (int Column = 0; Column < 4; ++Column)
+            {
+                for (int Row = 0; Row < 4; ++Row)
+                {
+                    MatrixMismatches += IsNear(World[Column][Row], Expected[Column][Row]) ? 0 : 1;
+                }
+            }
+
+            // Arvo's world box of the reference matrix
+            const FBoundingBox& Local = Entities[Entity].Bounds;
+            const glm::vec3 Center = (Local.Min + Local.Max) * 0.5f;
+            const glm::vec3 Extent = (Local.Max - Local.Min) * 0.5f;
+            const glm::vec3 ExpectedCenter = glm::vec3(Expected * glm::vec4(Center, 1.0f));
+            const glm::vec3 ExpectedExtent = glm::abs(glm::vec3(Expected[0])) * Extent.x + glm::abs(glm::vec3(Expected[1])) * Extent.y + glm::abs(glm::vec3(Expected[2])) * Extent.z;
+            const uint32_t Index = Scene.GetIndex(Entity);
+            const bool bBoundsMatch =
+                IsNear(Bounds.CenterX[Index], ExpectedCenter.x) && IsNear(Bounds.CenterY[Index], ExpectedCenter.y) && IsNear(Bounds.CenterZ[Index], ExpectedCenter.z) &&
+                IsNear(Bounds.ExtentX[Index], ExpectedExtent.x) && IsNear(Bounds.ExtentY[Index], ExpectedExtent.y) && IsNear(Bounds.ExtentZ[Index], ExpectedExtent.z) &&
+                IsNear(Bounds.Radius[Index], glm::length(ExpectedExtent));
+            BoundsMismatches += bBoundsMatch ? 0 : 1;
+        }
+        TEST_CHECKF(MatrixMismatches == 0, "%u world matrix elements differ from the recursive reference", MatrixMismatches);
+        TEST_CHECKF(BoundsMismatches == 0, "%u world bounds differ from the recursive reference", BoundsMismatches);
+    }
+
+    // Parents are picked among the existing entities, so roots created late leave the storage out of depth order
+    void BuildRandomHierarchy(std::mt19937& Random, uint32_t Num, FScene& Scene, std::vector<FReferenceEntity>& Entities)
+    {
+        std::uniform_int_distribution<uint32_t> Percent(0, 99);
+        for (uint32_t Index = 0; Index < Num; ++Index)
+        {
+            FEntityId Parent = InvalidEntity;
+            if (!Entities.empty() && Percent(Random) >= 10)
+            {
+                // Biased towards recent entities to get deep chains as well as wide levels
+                const uint32_t Window = std::min<uint32_t>(static_cast<uint32_t>(Entities.size()), Percent(Random) < 50 ? 4u : UINT32_MAX);
+                Parent = static_cast<FEntityId>(Entities.size() - 1 - std::uniform_int_distribution<uint32_t>(0, Window - 1)(Random));
+            }
+            const FReferenceEntity Entity = MakeRandomEntity(Random, Parent);
+            const FEntityId Id = Scene.CreateEntity(Parent, Entity.Bounds);
+            Scene.SetLocalTransform(Id, Entity.Position, Entity.Rotation, Entity.Scale);
+            Entities.push_back(Entity);
+        }
+    }
+}
+
+TEST_CASE(Scene, RandomHierarchyMatchesRecursiveReference)
+{
+    for (uint32_t Seed = 1; Seed <= 8; ++Seed)
+    {
+        std::mt19937 Random(Seed);
+        FScene Scene;
+        std::vector<FReferenceEntity> Entities;
+        BuildRandomHierarchy(Random, 2000 * Seed, Scene, Entities);
+        Scene.UpdateWorldTransforms();
+        CheckAgainstReference(Scene, Entities);
+    }
+}
+
+TEST_CASE(Scene, PartialUpdatesPropagateToChildren)
+{
+    std::mt19937 Random(42);
+    FScene Scene;
+    std::vector<FReferenceEntity> Entities;
+    BuildRandomHierarchy(Random, 20000, Scene, Entities);
+    Scene.UpdateWorldTransforms();
+
+    // Only a few entities change each round, the untouched subtrees must keep their matrices
+    std::uniform_int_distribution<uint32_t> Pick(0, static_cast<uint32_t>(Entities.size()) - 1);
+    for (uint32_t Round = 0; Round < 4; ++Round)
+    {
+        for (uint32_t Change = 0; Change < 64; ++Change)
+        {
+            const FEntityId Entity = Pick(Random);
+            const FReferenceEntity Changed = MakeRandomEntity(Random, Entities[Entity].Parent);
+            switch (Change % 4)
+            {
+            case 0:
+                Entities[Entity].Position = Changed.Position;
+                Scene.SetLocalPosition(Entity, Changed.Position);
+                break;
+            case 1:
+                Entities[Entity].Rotation = Changed.Rotation;
+                Scene.SetLocalRotation(Entity, Changed.Rotation);
+                break;
+            case 2:
+                Entities[Entity].Scale = Changed.Scale;
+                Scene.SetLocalScale(Entity, Changed.Scale);
+                break;
+            default:
+                Entities[Entity].Bounds = Changed.Bounds;
+                Scene.SetLocalBounds(Entity, Changed.Bounds);
+                break;
+            }
+        }
+        // Late roots and children force SortByDepth between updates
+        BuildRandomHierarchy(Random, 100, Scene, Entities);
+        Scene.UpdateWorldTransforms();
+        CheckAgainstReference(Scene, Entities);
+    }
+}
+
+TEST_CASE(Scene, StorageIsSortedByDepth)
+{
+    std::mt19937 Random(7);
+    FScene Scene;
+    std::vector<FReferenceEntity> Entities;
+    BuildRandomHierarchy(Random, 5000, Scene, Entities);
+    Scene.UpdateWorldTransforms();
+
+    uint32_t Violations = 0;
+    for (FEntityId Entity = 0; Entity < Entities.size(); ++Entity)
+    {
+        TEST_CHECK(Scene.GetEntity(Scene.GetIndex(Entity)) == Entity);
+        TEST_CHECK(Scene.GetParent(Entity) == Entities[Entity].Parent);
+        if (Entities[Entity].Parent != InvalidEntity)
+        {
+            Violations += Scene.GetIndex(Entities[Entity].Parent) < Scene.GetIndex(Entity) ? 0 : 1;
+        }
+    }
+    TEST_CHECKF(Violations == 0, "%u parents are stored after their children", Violations);
+}
@@ -0,0 +1,183 @@
+﻿#include "TestFramework.h"
+
+#include <deque>
+#include <random>
+#include "Render/StagingRing.h"
+
+namespace
+{
+    // 16 slots of the alignment, small enough that every case reaches the end of the ring
+    constexpr VkDeviceSize RingSize = 4096;
+    constexpr VkDeviceSize RingAlignment = 256;
+
+    struct FRange
+    {
+        VkDeviceSize Begin = 0;
+        VkDeviceSize End = 0;
+    };
+
+    // A batch of FAsyncUpload, the ring gets back everything up to the head after its last allocation
+    struct FTestBatch
+    {
+        std::vector<FRange> Ranges;
+        VkDeviceSize End = 0;
+    };
+}
+
+TEST_CASE(StagingRing, AlignsOffsets)
+{
+    FStagingRing Ring;
+    Ring.Init(RingSize, RingAlignment);
+    VkDeviceSize Offset = 1;
+    TEST_CHECK(Ring.Allocate(1, Offset) && Offset == 0);
+    TEST_CHECK(Ring.Allocate(300, Offset) && Offset == 256);
+    TEST_CHECK(Ring.Allocate(256, Offset) && Offset == 768);
+    // Nothing to copy still takes a slot, the head has to move
+    TEST_CHECK(Ring.Allocate(0, Offset) && Offset == 1024);
+    TEST_CHECK(Ring.GetHead() == 1280 && Ring.GetUsedSize() == 1280);
+}
+
+TEST_CASE(StagingRing, ExactFill)
+{
+    FStagingRing Ring;
+    Ring.Init(RingSize, RingAlignment);
+    VkDeviceSize Offset = 1;
+    TEST_CHECK(Ring.Allocate(RingSize, Offset) && Offset == 0);
+    TEST_CHECK(!Ring.IsEmpty() && Ring.GetUsedSize() == RingSize);
+    TEST_CHECK(!Ring.Allocate(1, Offset));
+    Ring.Release(Ring.GetHead());
+    TEST_CHECK(Ring.IsEmpty() && Ring.GetUsedSize() == 0);
+
+    // Filled by slots, head ends at the tail and reads as full rather than empty
+    for (VkDeviceSize Slot = 0; Slot < RingSize / RingAlignment; ++Slot)
+    {
+        TEST_CHECK(Ring.Allocate(RingAlignment, Offset) && Offset == Slot * RingAlignment);
+    }
+    TEST_CHECK(Ring.GetHead() == RingSize && Ring.GetUsedSize() == RingSize);
+    TEST_CHECK(!Ring.Allocate(1, Offset));
+
+    // An empty ring starts over, the whole size fits again wherever the head was
+    Ring.Release(RingSize);
+    TEST_CHECK(Ring.Allocate(RingSize, Offset) && Offset == 0);
+}
+
+TEST_CASE(StagingRing, WrapsBehindTail)
+{
+    FStagingRing Ring;
+    Ring.Init(RingSize, RingAlignment);
+    VkDeviceSize Offset = 0;
+    TEST_CHECK(Ring.Allocate(1536, Offset) && Offset == 0);
+    const VkDeviceSize FirstEnd = Ring.GetHead();
+    TEST_CHECK(Ring.Allocate(1536, Offset) && Offset == 1536);
+    const VkDeviceSize SecondEnd = Ring.GetHead();
+
+    // 1024 left at the end, the start is still in use
+    TEST_CHECK(!Ring.Allocate(1536, Offset));
+    Ring.Release(FirstEnd);
+
+    // Doesn't fit at the end, wraps into the range the first batch gave back and fills it exactly
+    TEST_CHECK(Ring.Allocate(1536, Offset) && Offset == 0);
+    TEST_CHECK(Ring.GetHead() == FirstEnd && Ring.GetUsedSize() == RingSize);
+    TEST_CHECK(!Ring.Allocate(1, Offset));
+    const VkDeviceSize ThirdEnd = Ring.GetHead();
+
+    // The skipped end only comes back once the tail passes it
+    Ring.Release(SecondEnd);
+    TEST_CHECK(Ring.GetUsedSize() == RingSize - SecondEnd + ThirdEnd);
+    TEST_CHECK(Ring.Allocate(1024, Offset) && Offset == 1536);
+    TEST_CHECK(!Ring.Allocate(1024, Offset));
+    TEST_CHECK(Ring.Allocate(512, Offset) && Offset == 2560);
+    Ring.Release(ThirdEnd);
+    TEST_CHECK(Ring.Allocate(1024, Offset) && Offset == 3072);
+    Ring.Release(Ring.GetHead());
+    TEST_CHECK(Ring.IsEmpty());
+}
+
+TEST_CASE(StagingRing, WrapNeedsRoomBeforeTail)
+{
+    FStagingRing Ring;
+    Ring.Init(RingSize, RingAlignment);
+    VkDeviceSize Offset = 0;
+    Ring.Allocate(1024, Offset);
+    const VkDeviceSize FirstEnd = Ring.GetHead();
+    Ring.Allocate(2048, Offset);
+    Ring.Release(FirstEnd);
+
+    // 1024 free at either end, 1280 fits in neither
+    TEST_CHECK(!Ring.Allocate(1280, Offset));
+    TEST_CHECK(Ring.GetHead() == 3072 && Ring.GetUsedSize() == 2048);
+    TEST_CHECK(Ring.Allocate(1024, Offset) && Offset == 3072);
+    TEST_CHECK(Ring.Allocate(1024, Offset) && Offset == 0);
+}
+
+TEST_CASE(StagingRing, OversizedNeverFits)
+{
+    FStagingRing Ring;
+    Ring.Init(RingSize, RingAlignment);
+    TEST_CHECK(!Ring.IsOversized(RingSize));
+    TEST_CHECK(Ring.IsOversized(RingSize + 1));
+
+    // Not even in an empty ring, and the failed attempt leaves it untouched
+    VkDeviceSize Offset = 0;
+    TEST_CHECK(!Ring.Allocate(RingSize + 1, Offset));
+    TEST_CHECK(Ring.IsEmpty() && Ring.GetHead() == 0);
+    TEST_CHECK(Ring.Allocate(512, Offset) && Offset == 0);
+    TEST_CHECK(!Ring.Allocate(RingSize + 1, Offset));
+    TEST_CHECK(Ring.GetHead() == 512 && Ring.GetUsedSize() == 512);
+}
+
+TEST_CASE(StagingRing, RandomBatchesNeverOverlap)
+{
+    FStagingRing Ring;
+    Ring.Init(RingSize, RingAlignment);
+    std::mt19937 Random(5);
+    std::deque<FTestBatch> InFlight;
+    FTestBatch Current;
+    for (uint32_t Step = 0; Step < 20000; ++Step)
+    {
+        const VkDeviceSize Size = 1 + Random() % (RingSize / 2);
+        VkDeviceSize Offset = 0;
+        if (Ring.Allocate(Size, Offset))
+        {
+            TEST_CHECKF(Offset % RingAlignment == 0 && Offset + Size <= RingSize, "step %u offset %llu size %llu", Step,
+                static_cast<unsigned long long>(Offset), static_cast<unsigned long long>(Size));
+            bool bOverlaps = false;
+            for (const FTestBatch& Batch : InFlight)
+            {
+                for (const FRange& Range : Batch.Ranges)
+                {
+                    bOverlaps |= Offset < Range.End && Range.Begin < Offset + Size;
+                }
+            }
+            for (const FRange& Range : Current.Ranges)
+            {
+                bOverlaps |= Offset < Range.End && Range.Begin < Offset + Size;
+            }
+            TEST_CHECKF(!bOverlaps, "step %u offset %llu overlaps a range in use", Step, static_cast<unsigned long long>(Offset));
+            Current.Ranges.push_back({Offset, Offset + Size});
+            Current.End = Ring.GetHead();
+        }
+        else
+        {
+            // Like SubmitRequests, submit what is recorded or retire the oldest batch
+            TEST_CHECKF(!Current.Ranges.empty() || !InFlight.empty(), "step %u size %llu failed on an empty ring", Step, static_cast<unsigned long long>(Size));
+            if (!Current.Ranges.empty())
+            {
+                InFlight.push_back(std::move(Current));
+                Current = FTestBatch();
+            }
+            else
+            {
+                Ring.Release(InFlight.front().End);
+                InFlight.pop_front();
+            }
+        }
+
+        // Batches also finish while others record
+        if (!InFlight.empty() && Random() % 4 == 0)
+        {
+            Ring.Release(InFlight.front().End);
+            InFlight.pop_front();
+        }
+    }
+}
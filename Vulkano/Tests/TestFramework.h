@@ -0,0 +1,50 @@
+﻿#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Core/VulkanoLog.h"
+
+// Self registering CPU tests of the engine code, built into VulkanoTests. A failed TEST_CHECK logs
+// and fails the case, the case keeps running so one run reports every broken check
+class FTestRegistry
+{
+public:
+    using FTestFunction = void(*)();
+
+    static bool Register(const char* Name, FTestFunction Function);
+    // Runs the cases whose "Suite.Name" contains Filter, all when empty. Returns the number of failed cases
+    static uint32_t Run(const std::string& Filter);
+    static void ReportFailure(const char* File, int Line, const char* Expression);
+
+private:
+    struct FTestCase
+    {
+        const char* Name;
+        FTestFunction Function;
+    };
+
+    static std::vector<FTestCase>& GetCases();
+
+private:
+    static uint32_t CaseFailures;
+};
+
+#define TEST_CASE(Suite, Name) \
+    static void Suite##_##Name(); \
+    static const bool Suite##_##Name##_Registered = FTestRegistry::Register(#Suite "." #Name, &Suite##_##Name); \
+    static void Suite##_##Name()
+
+#define TEST_CHECK(condition) \
+    do { \
+    if (!(condition)) { \
+    FTestRegistry::ReportFailure(__FILE__, __LINE__, #condition); \
+    } \
+    } while (false)
+
+#define TEST_CHECKF(condition, text, ...) \
+    do { \
+    if (!(condition)) { \
+    FTestRegistry::ReportFailure(__FILE__, __LINE__, #condition); \
+    VK_LOG(LOG_ERROR, text, ##__VA_ARGS__); \
+    } \
+    } while (false)
@@ -0,0 +1,65 @@
+﻿#include "TestFramework.h"
+
+#include "Core/JobSystem.h"
+
+uint32_t FTestRegistry::CaseFailures = 0;
+
+bool FTestRegistry::Register(const char* Name, FTestFunction Function)
+{
+    GetCases().push_back({Name, Function});
+    return true;
+}
+
+uint32_t FTestRegistry::Run(const std::string& Filter)
+{
+    uint32_t RunNum = 0;
+    uint32_t FailedNum = 0;
+    for (const FTestCase& Case : GetCases())
+    {
+        if (!Filter.empty() && std::string(Case.Name).find(Filter) == std::string::npos)
+        {
+            continue;
+        }
+        CaseFailures = 0;
+        Case.Function();
+        ++RunNum;
+        if (CaseFailures > 0)
+        {
+            ++FailedNum;
+            VK_LOG(LOG_ERROR, "%s failed %u checks", Case.Name, CaseFailures);
+        }
+        else
+        {
+            VK_LOG(LOG_INFO, "%s passed", Case.Name);
+        }
+    }
+
+    if (RunNum == 0)
+    {
+        VK_LOG(LOG_ERROR, "No test matches filter %s", Filter.c_str());
+        return 1;
+    }
+    VK_LOG(FailedNum == 0 ? LOG_SUCCESS : LOG_ERROR, "%u of %u tests passed", RunNum - FailedNum, RunNum);
+    return FailedNum;
+}
+
+void FTestRegistry::ReportFailure(const char* File, int Line, const char* Expression)
+{
+    ++CaseFailures;
+    VK_LOG(LOG_ERROR, "%s(%d): check failed: %s", File, Line, Expression);
+}
+
+std::vector<FTestRegistry::FTestCase>& FTestRegistry::GetCases()
+{
+    // Function local so registration from other translation units doesn't depend on initialization order
+    static std::vector<FTestCase> Cases;
+    return Cases;
+}
+
+// VulkanoTests [Filter], ctest runs one suite per test file
+int main(int argc, char* argv[])
+{
+    const uint32_t FailedNum = FTestRegistry::Run(argc > 1 ? argv[1] : "");
+    FJobSystem::Get()->Shutdown();
+    return FailedNum == 0 ? 0 : 1;
+}
@@ -0,0 +1,147 @@
+﻿#include "TestFramework.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include "Engine/TextureCompression.h"
+
+namespace
+{
+    // Smooth gradients with a little per pixel variation, roughly what albedo textures look like
+    std::vector<uint8_t> MakeGradientImage(uint32_t Width, uint32_t Height)
+    {
+        std::vector<uint8_t> Pixels(static_cast<size_t>(Width) * Height * 4);
+        for (uint32_t Y = 0; Y < Height; ++Y)
+        {
+            for (uint32_t X = 0; X < Width; ++X)
+            {
+                uint8_t* Pixel = &Pixels[(static_cast<size_t>(Y) * Width + X) * 4];
+                const uint32_t Noise = (X * 7 + Y * 13) % 5;
+                Pixel[0] = static_cast<uint8_t>(X * 255 / Width + Noise);
+                Pixel[1] = static_cast<uint8_t>(Y * 255 / Height);
+                Pixel[2] = static_cast<uint8_t>(128 + 100 * std::sin(0.1 * (X + Y)));
+                Pixel[3] = static_cast<uint8_t>(255 - (X + Y) * 200 / (Width + Height));
+            }
+        }
+        return Pixels;
+    }
+
+    // Over the first ChannelNum channels, the ones the format stores
+    double ComputePSNR(const std::vector<uint8_t>& A, const std::vector<uint8_t>& B, uint32_t ChannelNum)
+    {
+        uint64_t SquaredError = 0;
+        for (size_t Index = 0; Index < A.size(); Index += 4)
+        {
+            for (uint32_t Channel = 0; Channel < ChannelNum; ++Channel)
+            {
+                const int32_t Difference = A[Index + Channel] - B[Index + Channel];
+                SquaredError += static_cast<uint64_t>(Difference * Difference);
+            }
+        }
+        if (SquaredError == 0)
+        {
+            return 99.0;
+        }
+        const double MeanSquaredError = static_cast<double>(SquaredError) / (A.size() / 4 * ChannelNum);
+        return 10.0 * std::log10(255.0 * 255.0 / MeanSquaredError);
+    }
+
+    struct FFormatCase
+    {
+        ETextureCompression Compression;
+        const char* Name;
+        uint32_t ChannelNum;
+        double MinPSNR;
+    };
+
+    // About 1.5 dB under what the encoders reach on the steeper 37x21 gradient
+    const FFormatCase FormatCases[] = {
+        {ETextureCompression::BC1, "BC1", 3, 31.0},
+        {ETextureCompression::BC3, "BC3", 4, 32.0},
+        {ETextureCompression::BC4, "BC4", 1, 46.0},
+        {ETextureCompression::BC5, "BC5", 2, 46.0},
+        {ETextureCompression::BC7, "BC7", 4, 33.0},
+    };
+}
+
+TEST_CASE(TextureCompression, GradientRoundTripQuality)
+{
+    // 37x21 leaves partial blocks on the right and bottom edge
+    const uint32_t Sizes[][2] = {{64, 64}, {37, 21}};
+    for (const auto& Size : Sizes)
+    {
+        const std::vector<uint8_t> Source = MakeGradientImage(Size[0], Size[1]);
+        for (const FFormatCase& Case : FormatCases)
+        {
+            std::vector<uint8_t> Compressed;
+            std::vector<uint8_t> Decoded;
+            FTextureCompressor::CompressImage(Source.data(), Size[0], Size[1], Case.Compression, Compressed);
+            TEST_CHECK(Compressed.size() == ((Size[0] + 3) / 4) * ((Size[1] + 3) / 4) * FTextureCompressor::GetBlockBytes(Case.Compression));
+            FTextureCompressor::DecompressImage(Compressed.data(), Size[0], Size[1], Case.Compression, Decoded);
+            TEST_CHECK(Decoded.size() == Source.size());
+
+            const double PSNR = ComputePSNR(Source, Decoded, Case.ChannelNum);
+            TEST_CHECKF(PSNR >= Case.MinPSNR, "%s %ux%u PSNR %.2f dB, expected at least %.1f", Case.Name, Size[0], Size[1], PSNR, Case.MinPSNR);
+        }
+    }
+}
+
+TEST_CASE(TextureCompression, SolidBlocks)
+{
+    const uint8_t Colors[][4] = {{0, 0, 0, 255}, {255, 255, 255, 0}, {200, 17, 93, 128}, {1, 254, 127, 3}};
+    for (const auto& Color : Colors)
+    {
+        uint8_t Pixels[16 * 4];
+        for (uint32_t Pixel = 0; Pixel < 16; ++Pixel)
+        {
+            memcpy(&Pixels[Pixel * 4], Color, 4);
+        }
+        for (const FFormatCase& Case : FormatCases)
+        {
+            std::vector<uint8_t> Compressed;
+            std::vector<uint8_t> Decoded;
+            FTextureCompressor::CompressImage(Pixels, 4, 4, Case.Compression, Compressed);
+            FTextureCompressor::DecompressImage(Compressed.data(), 4, 4, Case.Compression, Decoded);
+
+            // Single channel blocks are exact, 565 endpoints lose up to 3 bits and BC7 endpoints one
+            int32_t MaxDifference = 0;
+            for (uint32_t Pixel = 0; Pixel < 16; ++Pixel)
+            {
+                for (uint32_t Channel = 0; Channel < Case.ChannelNum; ++Channel)
+                {
+                    MaxDifference = std::max(MaxDifference, std::abs(Decoded[Pixel * 4 + Channel] - Color[Channel]));
+                }
+            }
+            const bool bSingleChannelOnly = Case.Compression == ETextureCompression::BC4 || Case.Compression == ETextureCompression::BC5;
+            const int32_t Tolerance = bSingleChannelOnly ? 0 : Case.Compression == ETextureCompression::BC7 ? 1 : 4;
+            TEST_CHECKF(MaxDifference <= Tolerance, "%s solid %u %u %u %u off by %d", Case.Name, Color[0], Color[1], Color[2], Color[3], MaxDifference);
+        }
+    }
+}
+
+TEST_CASE(TextureCompression, DecodesUnusedChannelsLikeASampler)
+{
+    const std::vector<uint8_t> Source = MakeGradientImage(8, 8);
+    std::vector<uint8_t> Compressed;
+    std::vector<uint8_t> Decoded;
+    FTextureCompressor::CompressImage(Source.data(), 8, 8, ETextureCompression::BC5, Compressed);
+    FTextureCompressor::DecompressImage(Compressed.data(), 8, 8, ETextureCompression::BC5, Decoded);
+    bool bDefaults = true;
+    for (size_t Index = 0; Index < Decoded.size(); Index += 4)
+    {
+        bDefaults &= Decoded[Index + 2] == 0 && Decoded[Index + 3] == 255;
+    }
+    TEST_CHECK(bDefaults);
+
+    // Color0 <= Color1 selects the three color mode, index 3 is transparent black
+    const uint16_t Color0 = 0x001f;
+    const uint16_t Color1 = 0xf800;
+    const uint32_t IndexBits = 0xe4e4e4e4;
+    uint8_t Block[8];
+    memcpy(Block, &Color0, 2);
+    memcpy(Block + 2, &Color1, 2);
+    memcpy(Block + 4, &IndexBits, 4);
+    FTextureCompressor::DecompressImage(Block, 4, 4, ETextureCompression::BC1, Decoded);
+    const uint8_t Expected[4][4] = {{0, 0, 255, 255}, {255, 0, 0, 255}, {127, 0, 127, 255}, {0, 0, 0, 0}};
+    TEST_CHECK(memcmp(&Decoded[0], Expected, sizeof(Expected)) == 0);
+}
@@ -0,0 +1,143 @@
+﻿#include "TestFramework.h"
+
+#include <algorithm>
+#include <random>
+#include "Render/UniformStreamRegions.h"
+
+// FUniformStreamAllocator::Allocate, AllocateVertices and AllocateStaging all take their offsets from FUniformStreamRegions,
+// these run its bookkeeping against mocked device limits
+namespace
+{
+    enum class EAllocationKind : uint8_t
+    {
+        Uniform,
+        Vertices,
+        Staging,
+    };
+
+    VkPhysicalDeviceLimits MakeLimits(VkDeviceSize MinOffsetAlignment, uint32_t MaxUniformRange)
+    {
+        VkPhysicalDeviceLimits Limits{};
+        Limits.minUniformBufferOffsetAlignment = MinOffsetAlignment;
+        Limits.maxUniformBufferRange = MaxUniformRange;
+        return Limits;
+    }
+
+    // Sizes like the callers use: small uniform blocks, per-instance streams and texture uploads
+    uint32_t MakeRandomSize(std::mt19937& Random, EAllocationKind Kind, uint32_t MaxAllocationSize)
+    {
+        switch (Kind)
+        {
+        case EAllocationKind::Uniform:
+            return std::uniform_int_distribution<uint32_t>(1, std::min(MaxAllocationSize, 1024u))(Random);
+        case EAllocationKind::Vertices:
+            return 12 * std::uniform_int_distribution<uint32_t>(1, 4096)(Random);
+        default:
+            return std::uniform_int_distribution<uint32_t>(1, 256 * 1024)(Random);
+        }
+    }
+}
+
+TEST_CASE(UniformStreamAllocator, OffsetsAreAlignedAcrossRegionWraps)
+{
+    const VkDeviceSize MinAlignments[] = {1, 4, 16, 64, 256};
+    const uint32_t MaxRanges[] = {16384, 65536, 1u << 27};
+    std::mt19937 Random(1);
+    for (VkDeviceSize MinAlignment : MinAlignments)
+    {
+        for (uint32_t MaxRange : MaxRanges)
+        {
+            FUniformStreamRegions Regions;
+            Regions.Init(4 * 1024 * 1024 + 3, MakeLimits(MinAlignment, MaxRange));
+            const uint32_t Alignment = std::max(static_cast<uint32_t>(MinAlignment), 16u);
+            const uint32_t FrameSize = Regions.GetFrameSize();
+            TEST_CHECK(Regions.GetAlignment() == Alignment);
+            TEST_CHECK(FrameSize % Alignment == 0 && FrameSize >= 4 * 1024 * 1024 + 3);
+            TEST_CHECK(Regions.GetMaxAllocationSize() == std::min(MaxRange, 65536u));
+
+            uint32_t Misaligned = 0;
+            uint32_t OutsideRegion = 0;
+            uint32_t Overlapping = 0;
+            uint32_t PastBuffer = 0;
+            // Three times around the regions, every frame fills its region until an allocation fails
+            for (uint32_t Frame = 0; Frame < 3 * FUniformStreamRegions::FramesInFlight; ++Frame)
+            {
+                if (Frame > 0)
+                {
+                    Regions.BeginFrame(Frame);
+                }
+                const uint32_t RegionBegin = FrameSize * (Frame % FUniformStreamRegions::FramesInFlight);
+                const uint32_t RegionEnd = RegionBegin + FrameSize;
+                uint32_t PreviousEnd = RegionBegin;
+                for (uint32_t Allocation = 0; ; ++Allocation)
+                {
+                    const EAllocationKind Kind = static_cast<EAllocationKind>(Allocation % 3);
+                    const uint32_t Size = MakeRandomSize(Random, Kind, Regions.GetMaxAllocationSize());
+                    uint32_t Offset = 0;
+                    if (!Regions.Allocate(Size, Offset))
+                    {
+                        TEST_CHECK(FUniformStreamRegions::AlignOffset(PreviousEnd, Alignment) + static_cast<uint64_t>(Size) > RegionEnd);
+                        break;
+                    }
+                    Misaligned += Offset % Alignment == 0 ? 0 : 1;
+                    OutsideRegion += Offset >= RegionBegin && Offset + Size <= RegionEnd ? 0 : 1;
+                    Overlapping += Offset >= PreviousEnd ? 0 : 1;
+                    // Uniform blocks are read through a descriptor range of MaxAllocationSize at the dynamic offset
+                    if (Kind == EAllocationKind::Uniform)
+                    {
+                        PastBuffer += Offset + static_cast<VkDeviceSize>(Regions.GetMaxAllocationSize()) <= Regions.GetBufferSize() ? 0 : 1;
+                    }
+                    PreviousEnd = Offset + Size;
+                    TEST_CHECK(Regions.GetFrameUsedSize() == PreviousEnd - RegionBegin);
+                }
+            }
+            TEST_CHECKF(Misaligned == 0, "%u offsets are not multiples of %u", Misaligned, Alignment);
+            TEST_CHECKF(OutsideRegion == 0, "%u allocations leave their frame region", OutsideRegion);
+            TEST_CHECKF(Overlapping == 0, "%u allocations overlap the previous one", Overlapping);
+            TEST_CHECKF(PastBuffer == 0, "%u uniform ranges reach past the buffer", PastBuffer);
+        }
+    }
+}
+
+TEST_CASE(UniformStreamAllocator, BeginFrameReturnsRetireValueOfReusedRegion)
+{
+    FUniformStreamRegions Regions;
+    Regions.Init(65536, MakeLimits(256, 65536));
+    // Frame 0 uses region 0 from Init on, the first reuse of each region has nothing to wait for
+    TEST_CHECK(Regions.BeginFrame(11) == 0);
+    TEST_CHECK(Regions.BeginFrame(12) == 0);
+    TEST_CHECK(Regions.BeginFrame(13) == 0);
+    TEST_CHECK(Regions.BeginFrame(14) == 11);
+    TEST_CHECK(Regions.BeginFrame(15) == 12);
+    TEST_CHECK(Regions.BeginFrame(16) == 13);
+    TEST_CHECK(Regions.BeginFrame(17) == 14);
+}
+
+TEST_CASE(UniformStreamAllocator, ExactFillAndOverflow)
+{
+    FUniformStreamRegions Regions;
+    Regions.Init(65536, MakeLimits(64, 65536));
+    const uint32_t FrameSize = Regions.GetFrameSize();
+    TEST_CHECK(FrameSize == 65536);
+    TEST_CHECK(Regions.GetBufferSize() == 4ull * 65536);
+
+    for (uint32_t Frame = 0; Frame < 4; ++Frame)
+    {
+        if (Frame > 0)
+        {
+            Regions.BeginFrame(Frame);
+        }
+        const uint32_t RegionBegin = FrameSize * (Frame % FUniformStreamRegions::FramesInFlight);
+        uint32_t Offset = 0;
+        TEST_CHECK(!Regions.Allocate(FrameSize + 1, Offset));
+        TEST_CHECK(!Regions.Allocate(UINT32_MAX, Offset));
+        TEST_CHECK(Regions.GetFrameUsedSize() == 0);
+
+        // An odd size followed by the rest of the region up to the last byte
+        TEST_CHECK(Regions.Allocate(100, Offset) && Offset == RegionBegin);
+        TEST_CHECK(Regions.Allocate(FrameSize - 128, Offset) && Offset == RegionBegin + 128);
+        TEST_CHECK(Regions.GetFrameUsedSize() == FrameSize);
+        TEST_CHECK(!Regions.Allocate(1, Offset));
+        TEST_CHECK(Regions.GetFrameUsedSize() == FrameSize);
+    }
+}
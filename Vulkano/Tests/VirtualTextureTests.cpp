@@ -0,0 +1,214 @@
+﻿#include "TestFramework.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include "Engine/VirtualTexture.h"
+
+namespace
+{
+    // Loader that records the order pages were requested in, the streamer loads its queue first in first out
+    struct FRecordingLoader
+    {
+        std::mutex Mutex;
+        std::vector<uint32_t> Loaded;
+
+        FVirtualTextureStreamer::FPageLoader MakeLoader()
+        {
+            return [this](uint32_t PageId, uint8_t* OutPixels)
+            {
+                OutPixels[0] = static_cast<uint8_t>(PageId);
+                std::lock_guard<std::mutex> Lock(Mutex);
+                Loaded.push_back(PageId);
+                return true;
+            };
+        }
+
+        std::vector<uint32_t> GetLoaded()
+        {
+            std::lock_guard<std::mutex> Lock(Mutex);
+            return Loaded;
+        }
+    };
+
+    // Ends frames until ResidentNum pages are resident, the streamer finishes loads on its own thread
+    bool UpdateUntilResident(FVirtualTextureSystem& System, uint32_t ResidentNum, std::vector<FVirtualPageUpload>& OutUploads)
+    {
+        OutUploads.clear();
+        std::vector<FVirtualPageUpload> Uploads;
+        for (uint32_t Attempt = 0; Attempt < 2000; ++Attempt)
+        {
+            System.Update(Uploads);
+            for (FVirtualPageUpload& Upload : Uploads)
+            {
+                OutUploads.push_back(std::move(Upload));
+            }
+            if (System.GetStats().ResidentPages == ResidentNum && System.GetStats().InFlightPages == 0)
+            {
+                return true;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return false;
+    }
+
+    FVirtualTextureSettings MakeSettings(uint32_t AtlasPagesX, uint32_t AtlasPagesY, uint32_t MaxRequestsPerFrame)
+    {
+        FVirtualTextureSettings Settings;
+        Settings.PageSize = 16;
+        Settings.BorderSize = 1;
+        Settings.AtlasPagesX = AtlasPagesX;
+        Settings.AtlasPagesY = AtlasPagesY;
+        Settings.MaxRequestsPerFrame = MaxRequestsPerFrame;
+        return Settings;
+    }
+}
+
+TEST_CASE(VirtualTexture, CacheEvictsLeastRecentlyUsed)
+{
+    FVirtualPageCache Cache;
+    Cache.Init(4);
+    uint32_t Evicted = 0;
+    // Free slots go out from slot 0 up
+    TEST_CHECK(Cache.Allocate(10, 1, Evicted) == 0 && Evicted == FVirtualPageId::Invalid);
+    TEST_CHECK(Cache.Allocate(11, 1, Evicted) == 1);
+    TEST_CHECK(Cache.Allocate(12, 1, Evicted) == 2);
+    TEST_CHECK(Cache.Allocate(13, 1, Evicted) == 3);
+    TEST_CHECK(Cache.GetResidentNum() == 4);
+
+    // Used order is now 11, 13, 10, 12
+    Cache.Touch(Cache.Find(10), 2);
+    Cache.Touch(Cache.Find(12), 3);
+    TEST_CHECK(Cache.Allocate(20, 4, Evicted) == 1 && Evicted == 11);
+    TEST_CHECK(Cache.Find(11) == FVirtualPageCache::InvalidSlot && Cache.Find(20) == 1);
+    TEST_CHECK(Cache.Allocate(21, 4, Evicted) == 3 && Evicted == 13);
+    TEST_CHECK(Cache.Allocate(22, 5, Evicted) == 0 && Evicted == 10);
+
+    // Touching the least recently used page moves it behind the rest
+    Cache.Touch(Cache.Find(12), 5);
+    TEST_CHECK(Cache.Allocate(23, 6, Evicted) == 1 && Evicted == 20);
+
+    // Everything left was used in the current frame, nothing is evicted
+    TEST_CHECK(Cache.Allocate(24, 4, Evicted) == FVirtualPageCache::InvalidSlot && Evicted == FVirtualPageId::Invalid);
+    TEST_CHECK(Cache.GetResidentNum() == 4);
+}
+
+TEST_CASE(VirtualTexture, CacheKeepsLockedAndReusesFreed)
+{
+    FVirtualPageCache Cache;
+    Cache.Init(3);
+    uint32_t Evicted = 0;
+    const uint32_t Locked = Cache.Allocate(1, 1, Evicted);
+    Cache.Lock(Locked);
+    Cache.Allocate(2, 2, Evicted);
+    Cache.Allocate(3, 3, Evicted);
+
+    // The locked page is the oldest but is skipped
+    TEST_CHECK(Cache.Allocate(4, 10, Evicted) != Locked && Evicted == 2);
+    TEST_CHECK(Cache.Allocate(5, 11, Evicted) != Locked && Evicted == 3);
+    TEST_CHECK(Cache.Allocate(6, 12, Evicted) != Locked && Evicted == 4);
+    TEST_CHECK(Cache.Find(1) == Locked);
+
+    // A freed slot is taken before anything is evicted
+    const uint32_t Freed = Cache.Find(5);
+    Cache.Free(5);
+    TEST_CHECK(Cache.GetResidentNum() == 2 && Cache.GetPageId(Freed) == FVirtualPageId::Invalid);
+    TEST_CHECK(Cache.Allocate(7, 13, Evicted) == Freed && Evicted == FVirtualPageId::Invalid);
+    TEST_CHECK(Cache.Allocate(8, 14, Evicted) != Locked && Evicted == 6);
+}
+
+TEST_CASE(VirtualTexture, FeedbackBecomesCoarseFirstRequests)
+{
+    FRecordingLoader Loader;
+    FVirtualTextureSystem System;
+    System.Init(MakeSettings(4, 2, 4), Loader.MakeLoader());
+    // 8x8 pages, mips of 8, 4, 2 and 1 pages a side
+    const uint32_t Texture = System.CreateVirtualTexture(128, 128);
+    const FVirtualPageTable& PageTable = System.GetPageTable(Texture);
+    TEST_CHECK(PageTable.GetMipLevels() == 4);
+
+    // Creating the texture streams the coarsest mip, every entry falls back to it
+    std::vector<FVirtualPageUpload> Uploads;
+    TEST_CHECK(UpdateUntilResident(System, 1, Uploads));
+    TEST_CHECK(Uploads.size() == 1 && Uploads[0].Pixels[0] == static_cast<uint8_t>(FVirtualPageId::Pack(Texture, 3, 0, 0)));
+    TEST_CHECK(FVirtualPageTable::GetEntryMip(PageTable.GetEntry(0, 5, 6)) == 3);
+    TEST_CHECK(Loader.GetLoaded().size() == 1);
+
+    // Duplicates, empty pixels, resident pages and pages outside any texture are dropped
+    const uint32_t Fine[3] = {FVirtualPageId::Pack(Texture, 0, 1, 1), FVirtualPageId::Pack(Texture, 0, 2, 2), FVirtualPageId::Pack(Texture, 0, 7, 7)};
+    const uint32_t Feedback[] = {
+        Fine[0], FVirtualPageId::Invalid, Fine[1], Fine[0], FVirtualPageId::Pack(Texture, 3, 0, 0),
+        FVirtualPageId::Pack(Texture, 1, 0, 0), FVirtualPageId::Pack(Texture + 1, 0, 0, 0), FVirtualPageId::Pack(Texture, 0, 8, 0),
+        Fine[2], FVirtualPageId::Pack(Texture, 2, 0, 0), FVirtualPageId::Invalid, Fine[1],
+    };
+    System.ProcessFeedback(Feedback, std::size(Feedback));
+    TEST_CHECK(System.GetStats().RequestedPages == 5);
+
+    // Only MaxRequestsPerFrame go out, coarse mips first
+    TEST_CHECK(UpdateUntilResident(System, 5, Uploads));
+    std::vector<uint32_t> Loaded = Loader.GetLoaded();
+    TEST_CHECK(Loaded.size() == 5);
+    if (Loaded.size() == 5)
+    {
+        TEST_CHECK(Loaded[1] == FVirtualPageId::Pack(Texture, 2, 0, 0));
+        TEST_CHECK(Loaded[2] == FVirtualPageId::Pack(Texture, 1, 0, 0));
+        TEST_CHECK(FVirtualPageId::GetMip(Loaded[3]) == 0 && FVirtualPageId::GetMip(Loaded[4]) == 0 && Loaded[3] != Loaded[4]);
+        TEST_CHECK(std::count(Fine, Fine + 3, Loaded[3]) == 1 && std::count(Fine, Fine + 3, Loaded[4]) == 1);
+    }
+    TEST_CHECK(Uploads.size() == 4);
+    // Mip 1 page (0, 0) covers mip 0 pages 0..1, mip 2 page (0, 0) covers 0..3
+    TEST_CHECK(FVirtualPageTable::GetEntryMip(PageTable.GetEntry(0, 0, 1)) == 1);
+    TEST_CHECK(FVirtualPageTable::GetEntryMip(PageTable.GetEntry(0, 3, 0)) == 2);
+    TEST_CHECK(FVirtualPageTable::GetEntryMip(PageTable.GetEntry(0, 4, 4)) == 3);
+
+    // The same feedback again only requests the fine page that didn't fit last frame
+    System.ProcessFeedback(Feedback, std::size(Feedback));
+    TEST_CHECK(System.GetStats().RequestedPages == 1);
+    TEST_CHECK(UpdateUntilResident(System, 6, Uploads));
+    Loaded = Loader.GetLoaded();
+    TEST_CHECK(Loaded.size() == 6 && std::count(Loaded.begin(), Loaded.end(), Loaded.back()) == 1);
+    for (const uint32_t PageId : Fine)
+    {
+        TEST_CHECK(FVirtualPageTable::GetEntryMip(PageTable.GetEntry(0, FVirtualPageId::GetX(PageId), FVirtualPageId::GetY(PageId))) == 0);
+    }
+}
+
+TEST_CASE(VirtualTexture, EvictionFallsBackToCoarserPage)
+{
+    FRecordingLoader Loader;
+    FVirtualTextureSystem System;
+    // One slot for the locked fallback and three for streamed pages
+    System.Init(MakeSettings(2, 2, 16), Loader.MakeLoader());
+    const uint32_t Texture = System.CreateVirtualTexture(64, 64);
+    const FVirtualPageTable& PageTable = System.GetPageTable(Texture);
+    std::vector<FVirtualPageUpload> Uploads;
+    TEST_CHECK(UpdateUntilResident(System, 1, Uploads));
+
+    // Streamed one frame after another, page 0 is the oldest
+    for (uint32_t X = 0; X < 3; ++X)
+    {
+        const uint32_t PageId = FVirtualPageId::Pack(Texture, 0, X, 0);
+        System.ProcessFeedback(&PageId, 1);
+        TEST_CHECK(UpdateUntilResident(System, 2 + X, Uploads));
+    }
+    TEST_CHECK(System.GetStats().Evictions == 0);
+
+    // Page 0 is seen again, page 1 becomes the least recently used
+    const uint32_t Seen = FVirtualPageId::Pack(Texture, 0, 0, 0);
+    System.ProcessFeedback(&Seen, 1);
+    System.Update(Uploads);
+
+    const uint32_t NewPage = FVirtualPageId::Pack(Texture, 0, 3, 3);
+    System.ProcessFeedback(&NewPage, 1);
+    TEST_CHECK(UpdateUntilResident(System, 4, Uploads));
+    TEST_CHECK(System.GetStats().Evictions == 1);
+    TEST_CHECK(FVirtualPageTable::GetEntryMip(PageTable.GetEntry(0, 1, 0)) == PageTable.GetMipLevels() - 1);
+    TEST_CHECK(FVirtualPageTable::GetEntryMip(PageTable.GetEntry(0, 0, 0)) == 0);
+    TEST_CHECK(FVirtualPageTable::GetEntryMip(PageTable.GetEntry(0, 2, 0)) == 0);
+    TEST_CHECK(FVirtualPageTable::GetEntryMip(PageTable.GetEntry(0, 3, 3)) == 0);
+
+    // The slot of the evicted page was reused for the new one
+    TEST_CHECK(Uploads.size() == 1 && FVirtualPageTable::GetEntrySlot(PageTable.GetEntry(0, 3, 3)) == Uploads[0].Slot);
+}
@@ -1,37 +1,123 @@
-#pragma once
+﻿#include <algorithm>
+#include <cstdlib>
 #include <iostream>
-#include <Windows.h>
+#include <string>
+#include "Render/RegressionHarness.h"
 #include "Render/Renderer.h"
 #include "Render/RenderWindow.h"
+#include "Render/RhiBenchmark.h"
 #include "Render/Shader.h"
 #include "Render/VulkanInterface.h"
+#include "Core/VulkanoLog.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+// Value of -Switch=<value> on the command line, quoted values may contain spaces
+static bool GetSwitchValue(const std::string& CommandLine, const std::string& Switch, std::string& OutValue)
+{
+    const std::string Prefix = Switch + "=";
+    const size_t SwitchStart = CommandLine.find(Prefix);
+    if (SwitchStart == std::string::npos)
+    {
+        return false;
+    }
 
-int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int)									
+    size_t ValueStart = SwitchStart + Prefix.size();
+    const bool bQuoted = ValueStart < CommandLine.size() && CommandLine[ValueStart] == '"';
+    ValueStart += bQuoted ? 1 : 0;
+    const size_t ValueEnd = CommandLine.find(bQuoted ? '"' : ' ', ValueStart);
+    OutValue = CommandLine.substr(ValueStart, ValueEnd == std::string::npos ? std::string::npos : ValueEnd - ValueStart);
+    return true;
+}
+
+// Shared by WinMain and main, CommandLine holds the arguments without the executable
+static int RunVulkano(const std::string& CommandLine)
 {
+    // -regression=<script.json> draws the scripted scenes, checks them and exits with 0 when everything passed
+    std::string ScriptPath;
+    FRegressionSettings RegressionSettings;
+    const bool bRegression = GetSwitchValue(CommandLine, "-regression", ScriptPath);
+    if (bRegression && !FRegressionSettings::LoadScript(ScriptPath, RegressionSettings))
+    {
+        return 1;
+    }
+
+    // -benchmark runs the RHI microbenchmarks and exits, with optional -benchmark_filter=, -benchmark_out= and -benchmark_min_time=
+    const bool bBenchmark = CommandLine.find("-benchmark") != std::string::npos;
+
+    // -window=win32|xcb|wayland|headless, the benchmarks never present
+    std::string BackendName;
+    EWindowBackend WindowBackend = EWindowBackend::Default;
+    if (GetSwitchValue(CommandLine, "-window", BackendName) && !FRenderWindow::ParseBackend(BackendName, WindowBackend))
+    {
+        VK_LOG(LOG_ERROR, "Unknown window backend %s", BackendName.c_str());
+        return 1;
+    }
+    WindowBackend = FRenderWindow::ResolveBackend(bBenchmark ? EWindowBackend::Headless : WindowBackend);
+
+    // Create window, the device is picked against its surface
+    std::unique_ptr<FRenderWindow> RenderWindow = FRenderWindow::Create(WindowBackend, "Vulkano", 1920, 1080);
+    if (!RenderWindow || !RenderWindow->Init())
+    {
+        return 1;
+    }
+
+    // -gpu=<name or uuid> overrides the device scoring, the name matches as a substring. VULKANO_GPU does the same for farm machines
+    std::string PreferredDevice;
+    if (!GetSwitchValue(CommandLine, "-gpu", PreferredDevice) && getenv("VULKANO_GPU"))
+    {
+        PreferredDevice = getenv("VULKANO_GPU");
+    }
+
     // Initialize vulkan
-    FVulkan::CreateVulkanInstance("Vulkano");
+    FVulkan::CreateVulkanInstance("Vulkano", WindowBackend);
 #ifdef _DEBUG
     FVulkan::CreateVulkanDebugLayer();
 #endif
-    FVulkan::CreateVulkanDevice(hInstance);
+    FVulkan::CreateVulkanDevice(*RenderWindow, PreferredDevice);
 
     // Compile all default shaders
     FShaderCompiler::Get()->AddShader<FDefaultVertexShader>(HLSL, "/HLSL/Defaults/DefaultVertex.hlsl", "main", EShLangVertex);
+    FShaderCompiler::Get()->AddShader<FInstancedStaticVertexShader>(HLSL, "/HLSL/Defaults/InstancedStaticVertex.hlsl", "main", EShLangVertex);
     FShaderCompiler::Get()->AddShader<FDefaultPixelShader>(HLSL, "/HLSL/Defaults/DefaultPixel.hlsl", "main", EShLangFragment);
     FShaderCompiler::Get()->CompileShaders();
 
-    // Create window and attach renderer
-    FRenderWindow RenderWindow("Vulkano", 1920, 1080);
-    RenderWindow.Init(hInstance);
+    if (bBenchmark)
+    {
+        std::string Filter, OutputPath, MinTime;
+        GetSwitchValue(CommandLine, "-benchmark_filter", Filter);
+        GetSwitchValue(CommandLine, "-benchmark_out", OutputPath);
+        const double MinSeconds = GetSwitchValue(CommandLine, "-benchmark_min_time", MinTime) ? std::max(0.01, atof(MinTime.c_str())) : 0.5;
+        const bool bPassed = FRhiBenchmark::Run(Filter, OutputPath, MinSeconds);
+
+        FShaderCompiler::Get()->CleanUpShaders();
+#ifdef _DEBUG
+        FVulkan::DestroyVulkanDebugLayer();
+#endif
+        FVulkan::ExitVulkan();
+        RenderWindow->Shutdown();
+        return bPassed ? 0 : 1;
+    }
+
+    // Attach renderer
     FRenderer Renderer;
-    Renderer.Init(&RenderWindow);
+    Renderer.Init(RenderWindow.get());
 
     // Draw me papu!
-    Renderer.RenderLoop();
+    int ExitCode = 1;
+    if (bRegression)
+    {
+        ExitCode = Renderer.RunRegression(RegressionSettings) ? 0 : 1;
+    }
+    else
+    {
+        Renderer.RenderLoop();
+    }
 
     // Party is over
     Renderer.Shutdown();
-    RenderWindow.Shutdown();
 
     // Destroy all shaders
     FShaderCompiler::Get()->CleanUpShaders();
@@ -40,5 +126,34 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int)
     FVulkan::DestroyVulkanDebugLayer();
 #endif
     FVulkan::ExitVulkan();
-    return 1;																						
+    RenderWindow->Shutdown();
+    return ExitCode;
 }
+
+#ifdef _WIN32
+int APIENTRY WinMain(HINSTANCE, HINSTANCE, LPSTR lpCmdLine, int)									
+{
+    return RunVulkano(lpCmdLine ? lpCmdLine : "");
+}
+#else
+int main(int argc, char** argv)
+{
+    // Rebuilt the way Windows hands it to WinMain so the switches parse the same
+    std::string CommandLine;
+    for (int Index = 1; Index < argc; ++Index)
+    {
+        const std::string Argument = argv[Index];
+        const size_t Equals = Argument.find('=');
+        CommandLine += Index > 1 ? " " : "";
+        if (Argument.find(' ') != std::string::npos && Equals != std::string::npos)
+        {
+            CommandLine += Argument.substr(0, Equals + 1) + "\"" + Argument.substr(Equals + 1) + "\"";
+        }
+        else
+        {
+            CommandLine += Argument;
+        }
+    }
+    return RunVulkano(CommandLine);
+}
+#endif